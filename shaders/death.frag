@@ -97,8 +97,11 @@ void main(){
   base = mix(base, base_color.rgb, base_color.a);
 
   // Normals.
-  vec3 tex_normal_tangentspace = normalize(texture(bump_map_sampler, 
-    vec2(in_data.UV.x, in_data.UV.y)).rgb * 2.0 - 1.0);
+  // Z is rebuilt from x and y, so BC5 normal maps only store those.
+  vec2 tex_normal_xy = texture(bump_map_sampler, 
+    vec2(in_data.UV.x, in_data.UV.y)).rg * 2.0 - 1.0;
+  vec3 tex_normal_tangentspace = normalize(vec3(tex_normal_xy, 
+    sqrt(max(0.0, 1.0 - dot(tex_normal_xy, tex_normal_xy)))));
 
   vec3 n = tex_normal_tangentspace;
   vec3 l = in_data.light_dir_tangentspace;
@@ -14,22 +14,27 @@ in VertexData {
 // Output data
 layout(location = 0) out vec4 color;
 
-uniform mat4 V;
 uniform sampler2D texture_sampler;
 uniform sampler2D bump_map_sampler;
 uniform sampler2D specular_sampler;
 uniform int enable_bump_map;
-uniform vec3 light_direction;
-uniform vec3 lighting_color;
-uniform float outdoors;
-uniform vec3 camera_pos;
-uniform vec3 player_pos;
-uniform float light_radius;
 uniform float specular_component;
 uniform float metallic_component;
 uniform float normal_strength;
 uniform vec4 base_color;
 
+layout(std140) uniform FrameUniforms {
+  mat4 V;
+  mat4 P;
+  mat4 VP;
+  mat4 shadow_matrices[3];
+  vec4 camera_pos;
+  vec4 player_pos;
+  vec4 light_direction; // w is the light radius.
+  vec4 lighting_color;
+  vec4 frame_params; // Time, outdoors and in dungeon.
+};
+
 struct PointLight {    
   vec3 position;
   float quadratic;  
@@ -42,8 +47,8 @@ uniform PointLight point_lights[NUM_POINT_LIGHTS];
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 frag_pos, 
   vec3 material_diffuse) {
 
-  vec3 light_direction = normalize(light.position - frag_pos);
-  vec3 light_cameraspace = (V * vec4(light_direction, 0.0)).xyz;
+  vec3 light_dir = normalize(light.position - frag_pos);
+  vec3 light_cameraspace = (V * vec4(light_dir, 0.0)).xyz;
   vec3 light_tangentspace = in_data.TBN * light_cameraspace;
 
   vec3 l = normalize(light_tangentspace);
@@ -83,8 +88,11 @@ void main(){
   base = mix(base, base_color.rgb, base_color.a);
 
   // Normals.
-  vec3 tex_normal_tangentspace = normalize(texture(bump_map_sampler, 
-    vec2(in_data.UV.x, in_data.UV.y)).rgb * 2.0 - 1.0);
+  // Z is rebuilt from x and y, so BC5 normal maps only store those.
+  vec2 tex_normal_xy = texture(bump_map_sampler, 
+    vec2(in_data.UV.x, in_data.UV.y)).rg * 2.0 - 1.0;
+  vec3 tex_normal_tangentspace = normalize(vec3(tex_normal_xy, 
+    sqrt(max(0.0, 1.0 - dot(tex_normal_xy, tex_normal_xy)))));
 
   vec3 n = tex_normal_tangentspace;
   vec3 l = in_data.light_dir_tangentspace;
@@ -109,7 +117,7 @@ void main(){
   vec3 specfresnel = fresnel_factor(specular_color, max(0.001, dot(n, e)));
   vec3 reflected = cos_alpha * specfresnel;
 
-  float sun_intensity = 1.0 * (1.0 + clamp(dot(light_direction, vec3(0, 1, 0)), 0, 1)) / 2.0;
+  float sun_intensity = 1.0 * (1.0 + clamp(dot(light_direction.xyz, vec3(0, 1, 0)), 0, 1)) / 2.0;
   vec3 ambient_color = sun_intensity * base;
   vec3 diffuse = 0.5 * sun_intensity * base; // Ambient.
   diffuse += cos_theta * mix(base, vec3(0.0), metallic_component);
@@ -121,8 +129,8 @@ void main(){
   //   out_color += CalcPointLight(point_lights[i], n, in_data.position, base);
   // }
 
-  float d = distance(player_pos, in_data.position);
-  float depth = clamp(d / light_radius, 0, 1);
+  float d = distance(player_pos.xyz, in_data.position);
+  float depth = clamp(d / light_direction.w, 0, 1);
   vec3 fog_color = vec3(0, 0, 0);
   out_color = mix(out_color, fog_color, depth);
 
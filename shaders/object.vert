@@ -18,12 +18,22 @@ out VertexData {
 // Values that stay constant for the whole mesh.
 uniform mat4 MVP;
 uniform mat4 M;
-uniform mat4 V;
 uniform mat3 MV3x3;
 
 uniform int enable_bump_map;
-uniform vec3 light_direction;
-uniform vec3 player_pos;
+
+// Values that stay constant for the whole frame.
+layout(std140) uniform FrameUniforms {
+  mat4 V;
+  mat4 P;
+  mat4 VP;
+  mat4 shadow_matrices[3];
+  vec4 camera_pos;
+  vec4 player_pos;
+  vec4 light_direction; // w is the light radius.
+  vec4 lighting_color;
+  vec4 frame_params; // Time, outdoors and in dungeon.
+};
 
 void main(){
   out_data.UV = vertexUV;
@@ -44,7 +54,7 @@ void main(){
   vec3 vertex_pos_cameraspace = (V * vec4(vertex_pos_worldspace, 1)).xyz;
   vec3 eye_dir_cameraspace = normalize(-vertex_pos_cameraspace);
 
-  vec3 light_pos_worldspace = player_pos + vec3(0, 5, 0);
+  vec3 light_pos_worldspace = player_pos.xyz + vec3(0, 5, 0);
   // vec3 light_pos_worldspace = vertex_pos_worldspace + light_direction;
 
   vec3 light_pos_cameraspace = (V * vec4(light_pos_worldspace, 1)).xyz;
@@ -0,0 +1,68 @@
+#version 330 core
+
+// Input vertex data, different for all executions of this shader.
+layout(location = 0) in vec3 vertexPosition_modelspace;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal_modelspace;
+layout(location = 3) in vec3 vertexTangent_modelspace;
+layout(location = 4) in vec3 vertexBitangent_modelspace;
+
+// Model matrix of the instance, one column per location.
+layout(location = 7) in mat4 M;
+
+out VertexData {
+  vec3 position;
+  vec2 UV;
+  vec3 light_dir_tangentspace;
+  vec3 eye_dir_tangentspace;
+  mat3 TBN;
+} out_data;
+
+// Values that stay constant for all instances.
+uniform int enable_bump_map;
+
+// Values that stay constant for the whole frame.
+layout(std140) uniform FrameUniforms {
+  mat4 V;
+  mat4 P;
+  mat4 VP;
+  mat4 shadow_matrices[3];
+  vec4 camera_pos;
+  vec4 player_pos;
+  vec4 light_direction; // w is the light radius.
+  vec4 lighting_color;
+  vec4 frame_params; // Time, outdoors and in dungeon.
+};
+
+void main(){
+  mat3 MV3x3 = mat3(V * M);
+
+  out_data.UV = vertexUV;
+  vec4 position = vec4(vertexPosition_modelspace, 1.0);
+  gl_Position = VP * M * position;
+
+  vec3 tangent_cameraspace = normalize(MV3x3 * normalize(vertexTangent_modelspace));
+  vec3 bitangent_cameraspace = normalize(MV3x3 * normalize(vertexBitangent_modelspace));
+  vec3 normal_cameraspace = normalize(MV3x3 * normalize(vertexNormal_modelspace));
+
+  out_data.TBN = transpose(mat3(
+    tangent_cameraspace,
+    bitangent_cameraspace,
+    normal_cameraspace
+  ));
+
+  vec3 vertex_pos_worldspace = (M * position).xyz;
+  vec3 vertex_pos_cameraspace = (V * vec4(vertex_pos_worldspace, 1)).xyz;
+  vec3 eye_dir_cameraspace = normalize(-vertex_pos_cameraspace);
+
+  vec3 light_pos_worldspace = player_pos.xyz + vec3(0, 5, 0);
+  // vec3 light_pos_worldspace = vertex_pos_worldspace + light_direction;
+
+  vec3 light_pos_cameraspace = (V * vec4(light_pos_worldspace, 1)).xyz;
+  vec3 light_dir_cameraspace = normalize(light_pos_cameraspace - vertex_pos_cameraspace);
+
+  out_data.eye_dir_tangentspace =  normalize(out_data.TBN * eye_dir_cameraspace);
+  out_data.light_dir_tangentspace = normalize(out_data.TBN * light_dir_cameraspace);
+
+  out_data.position = vec3(M * position);
+}
@@ -317,7 +317,7 @@ void Draw2D::DrawImage(const string& texture, GLfloat x, GLfloat y,
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glUseProgram(shader_id);
 
-  static float u_time = glfwGetTime();
+  static float u_time = GetTime();
   glUniform1f(GetUniformId(shader_id, "u_time"), u_time);
 
   // vector<vec3> vertices = {
@@ -5,15 +5,12 @@
 const float kMinDistance = 500.0f;
 
 AI::AI(shared_ptr<Resources> resources, shared_ptr<Monsters> monsters) 
-  : resources_(resources), monsters_(monsters) {
-  CreateThreads();
+  : resources_(resources), monsters_(monsters), job_system_(GetJobSystem()),
+    ai_jobs_(make_shared<JobCounter>()) {
 }
 
 AI::~AI() {
-  terminate_ = true;
-  for (int i = 0; i < kMaxThreads; i++) {
-    ai_threads_[i].join();
-  }
+  job_system_->Wait(ai_jobs_);
 }
 
 vec3 GetTilePosition(const ivec2& tile) {
@@ -25,7 +22,7 @@ vec3 GetTilePosition(const ivec2& tile) {
 void AI::ChangeState(ObjPtr obj, AiState state) {
   obj->ai_state = state;
   // obj->frame = 0;
-  obj->state_changed_at = glfwGetTime();
+  obj->state_changed_at = GetTime();
 }
 
 ObjPtr AI::GetClosestUnit(ObjPtr spider) {
@@ -170,7 +167,7 @@ void AI::Chase(ObjPtr spider) {
   vec3 dir = player->position - spider->position;
 
   if (spider->GetAsset()->name == "spider" || spider->GetAsset()->name == "demon-vine" || spider->GetAsset()->name == "cephalid" || spider->GetAsset()->name == "metal-eye") {
-    int dice = rand() % 3; 
+    int dice = Random(0, 3); 
     if (length(dir) > 100 && dice < 2) {
       vec3 next_pos = spider->position + normalize(dir) * 50.0f;
       spider->actions.push(make_shared<MoveAction>(next_pos));
@@ -190,7 +187,7 @@ void AI::Chase(ObjPtr spider) {
     }
   }
 
-  if (glfwGetTime() > spider->state_changed_at + 20) {
+  if (GetTime() > spider->state_changed_at + 20) {
     spider->actions = {};
     spider->actions.push(make_shared<ChangeStateAction>(WANDER));
   }
@@ -264,7 +261,7 @@ bool AI::ProcessStatus(ObjPtr spider) {
             skull->torque = cross(normalize(skull->speed), vec3(1, 1, 0)) * 5.0f;
             spider->ai_state = IDLE;
             spider->ClearActions();
-            spider->cooldowns["rebirth"] = glfwGetTime() + 10.0f;
+            spider->cooldowns["rebirth"] = GetTime() + 10.0f;
             spider->created_obj = skull;
             spider->always_cull = true;
             spider->life = 100.0f;
@@ -358,12 +355,12 @@ bool AI::ProcessDefendAction(ObjPtr creature, shared_ptr<DefendAction> action) {
   if (!action->started) {
     if (!creature->CanUseAbility("defend")) return true;
     action->started = true;
-    action->until = glfwGetTime() + 0.5f;
+    action->until = GetTime() + 0.5f;
 
     if (creature->GetAsset()->name == "goblin_chieftain") {
-      creature->cooldowns["defend"] = glfwGetTime() + 1.5;
+      creature->cooldowns["defend"] = GetTime() + 1.5;
     } else {
-      creature->cooldowns["defend"] = glfwGetTime() + 2;
+      creature->cooldowns["defend"] = GetTime() + 2;
     }
 
     creature->AddTemporaryStatus(make_shared<InvulnerableStatus>(1.0f, 20.0f));
@@ -431,12 +428,12 @@ bool AI::ProcessTeleportAction(ObjPtr creature,
   resources_->ChangeObjectAnimation(creature, "Armature|walking");
 
   if (!action->started) {
-    creature->cooldowns["teleport"] = glfwGetTime() + 10;
+    creature->cooldowns["teleport"] = GetTime() + 10;
     action->started = true;
-    action->channel_until = glfwGetTime() + 0.5;
+    action->channel_until = GetTime() + 0.5;
   }
 
-  if (glfwGetTime() < action->channel_until) {
+  if (GetTime() < action->channel_until) {
     resources_->CreateParticleEffect(1, creature->position + vec3(0, 3, 0), 
       vec3(0, 1, 0), vec3(1.0, 1.0, 1.0), 1.0, 24.0f, 15.0f, "fireball");          
   } else {
@@ -468,7 +465,7 @@ bool AI::ProcessFireballAction(ObjPtr creature,
     cout << "dir: " << dir << endl;
 
     resources_->CastFireball(creature, dir);
-    creature->cooldowns["fireball"] = glfwGetTime() + 10;
+    creature->cooldowns["fireball"] = GetTime() + 10;
   }
   return false;
 }
@@ -494,7 +491,7 @@ bool AI::ImpAttack(ObjPtr creature,
    
     vec3 dir = normalize(target - pos);
     resources_->CastImpFire(creature, pos, dir);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.0;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.0;
   }
   return false;
 }
@@ -538,13 +535,14 @@ bool AI::BeholderAttack(ObjPtr creature,
   vec3 pos = s.center;
 
   vec3 v = creature->forward * (0.1f + float(60 - action->until) / 2.0f) - vec3(0, 3, 0);
+  vector<vec3> directions;
   for (int i = 0; i < 4; i++) {
     float random_noise = Random(-5, 6) * 0.01f;
     vec3 v2 = rotate(v, random_noise, vec3(0, 1, 0));
     if (i < 2) v2.y += 0.2f;
-
-    resources_->CastMagmaRay(creature, creature->position, normalize(v2), bones[i]);
+    directions.push_back(normalize(v2));
   }
+  resources_->CastMagmaRays(creature, directions, bones);
   
   return false;
 }
@@ -616,7 +614,7 @@ bool AI::ProcessParalysisAction(ObjPtr creature,
    
     vec3 dir = normalize(target - pos);
     resources_->CastParalysis(creature, target);
-    creature->cooldowns["paralysis"] = glfwGetTime() + 1.5;
+    creature->cooldowns["paralysis"] = GetTime() + 1.5;
   }
   return false;
 }
@@ -647,7 +645,7 @@ bool AI::ProcessFlyLoopAction(ObjPtr creature,
     action->circle_center.y = std::min(45.0f, action->circle_center.y);
     action->circle_center.y = std::max(22.0f, action->circle_center.y);
     
-    action->until = glfwGetTime() + action->duration;
+    action->until = GetTime() + action->duration;
     action->right = Random(0, 2) == 0;
     action->started = true;
   }
@@ -677,7 +675,7 @@ bool AI::ProcessFlyLoopAction(ObjPtr creature,
     creature->speed += normalize(to_player) * creature->current_speed * 2.0f;
   }
 
-  if (glfwGetTime() > action->until) {
+  if (GetTime() > action->until) {
     return true;
   }
   return false;
@@ -764,7 +762,7 @@ bool AI::WhiteSpineAttack(ObjPtr creature,
       resources_->CastMissile(creature, creature->position, MISSILE_HORN, dir_, 
         missile_speed);
     }
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
   }
   return false;
 }
@@ -791,7 +789,7 @@ bool AI::SkirmisherAttack(ObjPtr creature,
 
     resources_->CastMissile(creature, creature->position + vec3(0, 3, 0),  
       MISSILE_GLAIVE, dir, missile_speed);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
   }
   return false;
 }
@@ -820,7 +818,7 @@ bool AI::GlaiveMasterAttack(ObjPtr creature,
 
     resources_->CastMissile(creature, creature->position + vec3(0, 3, 0),  
       MISSILE_GLAIVE, dir, missile_speed);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 2.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 2.5;
 
     for (int i = 0; i < num_missiles; i++) {
       vec3 p2 = creature->position + dir * 200.0f;
@@ -861,7 +859,7 @@ bool AI::LittleStagAttack(ObjPtr creature,
     if (creature->GetAsset()->name == "little_stag") {
       resources_->CastShotgun(creature, creature->position + vec3(0, 3, 0), dir);
     }
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
   }
   return false;
 }
@@ -872,12 +870,12 @@ bool AI::BlackMageAttack(ObjPtr creature,
 
   if (!action->initiated) {
     action->initiated = true;
-    action->until = glfwGetTime() + 1.0f;
+    action->until = GetTime() + 1.0f;
     resources_->ChangeObjectAnimation(creature, "Armature|idle", true,
       TRANSITION_FINISH_ANIMATION);
   }
 
-  if (glfwGetTime() > action->until) {
+  if (GetTime() > action->until) {
     resources_->ChangeObjectAnimation(creature, "Armature|attack");
   } else {
     resources_->CreateParticleEffect(1, creature->position, 
@@ -901,7 +899,7 @@ bool AI::BlackMageAttack(ObjPtr creature,
 
     resources_->CastMissile(creature, creature->position + vec3(0, 3, 0),  
       MISSILE_IMP_FIRE, dir, missile_speed);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 3.0;
+    creature->cooldowns["ranged-attack"] = GetTime() + 3.0;
   }
   return false;
 }
@@ -956,7 +954,7 @@ bool AI::ScorpionAttack(ObjPtr creature,
     vec3 p2 = creature->position + dir * 200.0f;
     resources_->CastMissile(creature, creature->position + vec3(0, 2, 0), 
       MISSILE_BOUNCYBALL, dir, missile_speed);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
 
     shared_ptr<Mesh> mesh = resources_->GetMesh(creature);
     int bone_id = mesh->bones_to_ids["muzzle_bone"];
@@ -1024,7 +1022,7 @@ bool AI::ShooterBugAttack(ObjPtr creature,
       dir, missile_speed);
 
     if (!action->no_cooldown) {
-      creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+      creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
     }
 
     resources_->CreateParticleEffect(10, s.center,
@@ -1083,7 +1081,7 @@ bool AI::RedMetalEyeAttack(ObjPtr creature,
     resources_->CastMissile(creature, 
       creature->position + vec3(0, 2, 0), MISSILE_RED_METAL_EYE, dir, 
       missile_speed);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
 
     shared_ptr<Mesh> mesh = resources_->GetMesh(creature);
     int bone_id = mesh->bones_to_ids["muzzle_bone"];
@@ -1143,7 +1141,7 @@ bool AI::MetalEyeAttack(ObjPtr creature,
     vec3 p2 = creature->position + dir * 200.0f;
     resources_->CastMissile(creature, creature->position + vec3(0, 2, 0), MISSILE_BOUNCYBALL, 
       dir, missile_speed);
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 1.5;
+    creature->cooldowns["ranged-attack"] = GetTime() + 1.5;
 
     shared_ptr<Mesh> mesh = resources_->GetMesh(creature);
     int bone_id = mesh->bones_to_ids["muzzle_bone"];
@@ -1187,7 +1185,7 @@ bool AI::WraithAttack(ObjPtr creature,
       resources_->CastMissile(creature, s.center, MISSILE_HORN, dir, missile_speed);
     }
 
-    creature->cooldowns["ranged-attack"] = glfwGetTime() + 2.0;
+    creature->cooldowns["ranged-attack"] = GetTime() + 2.0;
   }
   return false;
 }
@@ -1441,10 +1439,10 @@ bool AI::ProcessMoveAction(ObjPtr spider, vec3 destination) {
 
 bool AI::ProcessMoveAction(ObjPtr spider, shared_ptr<MoveAction> action) {
   if (spider->GetPhysicsBehavior() == PHYSICS_FLY) {
-    if (glfwGetTime() > action->issued_at + 0.5f) {
+    if (GetTime() > action->issued_at + 0.5f) {
       return true;
     }
-  } else if (glfwGetTime() > action->issued_at + 2.0f) {
+  } else if (GetTime() > action->issued_at + 2.0f) {
     spider->actions.push(make_shared<RandomMoveAction>());
     return true;
   }
@@ -1455,7 +1453,7 @@ bool AI::ProcessMoveAction(ObjPtr spider, shared_ptr<MoveAction> action) {
 bool AI::ProcessIdleAction(ObjPtr spider, shared_ptr<IdleAction> action) {
   resources_->ChangeObjectAnimation(spider, action->animation);
   float time_to_end = action->issued_at + action->duration;
-  double current_time = glfwGetTime();
+  double current_time = GetTime();
   if (current_time > time_to_end) {
     return true;
   }
@@ -1694,16 +1692,16 @@ bool AI::ProcessRedMetalSpinAction(ObjPtr spider,
 
   if (!action->started) {
     action->started = true;
-    action->shot_countdown = glfwGetTime() + 1;
-    action->shot_2_countdown = glfwGetTime() + 1.5;
+    action->shot_countdown = GetTime() + 1;
+    action->shot_2_countdown = GetTime() + 1.5;
   }
 
-  if (glfwGetTime() > action->shot_countdown + 2) {
-    spider->cooldowns["spin"] = glfwGetTime() + 8;
+  if (GetTime() > action->shot_countdown + 2) {
+    spider->cooldowns["spin"] = GetTime() + 8;
     return true;
   }
 
-  if (glfwGetTime() > action->shot_countdown && !action->shot) {
+  if (GetTime() > action->shot_countdown && !action->shot) {
     action->shot = true;
 
     float rotation = 0.0f;
@@ -1725,7 +1723,7 @@ bool AI::ProcessRedMetalSpinAction(ObjPtr spider,
     }
   }
 
-  if (glfwGetTime() > action->shot_2_countdown && !action->shot_2) {
+  if (GetTime() > action->shot_2_countdown && !action->shot_2) {
     action->shot_2 = true;
 
     float rotation = 0.5f * 6.28f / 18.0f;
@@ -1765,13 +1763,13 @@ bool AI::ProcessFrogJumpAction(ObjPtr spider,
     action->finished_rotating = true;
 
     if (spider->GetAsset()->name == "red_frog") {
-      action->chanel_until = glfwGetTime() + 0.5;
+      action->chanel_until = GetTime() + 0.5;
     } else {
-      action->chanel_until = glfwGetTime() + 1.0;
+      action->chanel_until = GetTime() + 1.0;
     }
   }
 
-  if (glfwGetTime() < action->chanel_until) {
+  if (GetTime() < action->chanel_until) {
     resources_->CreateParticleEffect(1, spider->position + vec3(0, 3, 0), 
       vec3(0, 1, 0), vec3(1.0, 1.0, 1.0), 1.0, 24.0f, 15.0f, "fireball");          
     return false;
@@ -1808,17 +1806,17 @@ bool AI::ProcessChargeAction(ObjPtr spider,
     }
     action->finished_rotating = true;
 
-    action->channel_until = glfwGetTime() + 1;
+    action->channel_until = GetTime() + 1;
   }
 
-  if (glfwGetTime() < action->channel_until) {
+  if (GetTime() < action->channel_until) {
     resources_->CreateParticleEffect(1, spider->position + vec3(0, 3, 0), 
       vec3(0, 1, 0), vec3(1.0, 1.0, 1.0), 1.0, 24.0f, 15.0f, "fireball");          
     return false;
   }
 
   if (!action->damage_dealt) {
-    spider->cooldowns["charge"] = glfwGetTime() + 10;
+    spider->cooldowns["charge"] = GetTime() + 10;
     resources_->ChangeObjectAnimation(spider, "Armature|walking");
     spider->frame = 0;
     vec3 v = resources_->GetPlayer()->position - spider->position;
@@ -1861,17 +1859,17 @@ bool AI::ProcessTrampleAction(ObjPtr spider,
     }
     action->finished_rotating = true;
 
-    action->channel_until = glfwGetTime() + 1;
+    action->channel_until = GetTime() + 1;
   }
 
-  if (glfwGetTime() < action->channel_until) {
+  if (GetTime() < action->channel_until) {
     resources_->CreateParticleEffect(1, spider->position + vec3(0, 3, 0), 
       vec3(0, 1, 0), vec3(1.0, 1.0, 1.0), 1.0, 24.0f, 15.0f, "fireball");          
     return false;
   }
 
   if (!action->damage_dealt) {
-    spider->cooldowns["trample"] = glfwGetTime() + 5;
+    spider->cooldowns["trample"] = GetTime() + 5;
     resources_->ChangeObjectAnimation(spider, "Armature|walking");
     spider->frame = 0;
 
@@ -1921,13 +1919,13 @@ bool AI::ProcessSpiderEggAction(ObjPtr spider,
     p->offset = vec3(0);
     p->associated_bone = 23;
 
-    action->channel_end = glfwGetTime() + 4.0f;
+    action->channel_end = GetTime() + 4.0f;
     action->created_particle_effect = true;
   }
 
-  if (glfwGetTime() > action->channel_end) {
+  if (GetTime() > action->channel_end) {
     resources_->CastSpiderEgg(spider);
-    spider->cooldowns["spider-egg"] = glfwGetTime() + 3;
+    spider->cooldowns["spider-egg"] = GetTime() + 3;
     return true;
   }
 
@@ -1970,11 +1968,11 @@ bool AI::ProcessWormBreedAction(ObjPtr spider,
     p->offset = vec3(0);
     p->associated_bone = 23;
 
-    action->channel_end = glfwGetTime() + 5.0f;
+    action->channel_end = GetTime() + 5.0f;
     action->created_particle_effect = true;
   }
 
-  if (glfwGetTime() > action->channel_end) {
+  if (GetTime() > action->channel_end) {
     resources_->CastWormBreed(spider);
     return true;
   }
@@ -2002,7 +2000,7 @@ bool AI::ProcessSpiderWebAction(ObjPtr creature,
     vec3 dir = CalculateMissileDirectionToHitTarget(creature->position,
       action->target, 2.0);
     resources_->CastSpiderWebShot(creature, dir);
-    creature->cooldowns["spider-web"] = glfwGetTime() + 5;
+    creature->cooldowns["spider-web"] = GetTime() + 5;
   }
   return false;
 }
@@ -2059,7 +2057,7 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
   ObjPtr player = resources_->GetPlayer();
   ivec2 player_tile = dungeon.GetDungeonTile(player->position);
 
-  float current_time = glfwGetTime();
+  float current_time = GetTime();
   if (spider->cooldowns.find(action->ability) != spider->cooldowns.end()) {
     if (spider->cooldowns[action->ability] > current_time) {
       return true;
@@ -2085,31 +2083,31 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
       configs->summoned_creatures++;
       if (--num_summons == 0) break;
     }
-    spider->cooldowns["summon-spiderling"] = glfwGetTime() + 15;
+    spider->cooldowns["summon-spiderling"] = GetTime() + 15;
   } else if (action->ability == "haste") {
     spider->AddTemporaryStatus(make_shared<HasteStatus>(2.0, 5.0f, 1));
-    spider->cooldowns["haste"] = glfwGetTime() + 10;
+    spider->cooldowns["haste"] = GetTime() + 10;
   } else if (action->ability == "invisibility") {
     spider->AddTemporaryStatus(make_shared<InvisibilityStatus>(10.0f, 1));
     resources_->CreateParticleEffect(1, spider->position, 
       vec3(0, 1, 0), vec3(1.0, 1.0, 1.0), 7.0, 32.0f, 3.0f);
-    spider->cooldowns["invisibility"] = glfwGetTime() + 60;
+    spider->cooldowns["invisibility"] = GetTime() + 60;
   } else if (action->ability == "hook") {
     resources_->CastHook(spider, spider->position, 
       normalize(player->position - spider->position));
-    spider->cooldowns["hook"] = glfwGetTime() + 10;
+    spider->cooldowns["hook"] = GetTime() + 10;
   } else if (action->ability == "acid-arrow") {
     resources_->CastAcidArrow(spider, spider->position, 
       normalize(player->position - spider->position));
-    spider->cooldowns["acid-arrow"] = glfwGetTime() + 1;
+    spider->cooldowns["acid-arrow"] = GetTime() + 1;
   } else if (action->ability == "lightning-ray") {
     resources_->CastMagmaRay(spider, spider->position, 
       normalize(player->position - spider->position - vec3(0, 3, 0)));
-    spider->cooldowns["lightning-ray"] = glfwGetTime() - 1;
+    spider->cooldowns["lightning-ray"] = GetTime() - 1;
   } else if (action->ability == "blinding-ray") {
     resources_->CastBlindingRay(spider, spider->position, 
       normalize(player->position - spider->position - vec3(0, 3, 0)));
-    spider->cooldowns["blinding-ray"] = glfwGetTime() + 20;
+    spider->cooldowns["blinding-ray"] = GetTime() + 20;
   } else if (action->ability == "teleport-back") {
     for (int i = 0; i < 100; i++) {
       int off_x = Random(-2, 2);
@@ -2121,7 +2119,7 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
       player->position = tile_pos;
       break;
     }
-    spider->cooldowns["teleport-back"] = glfwGetTime() + 20;
+    spider->cooldowns["teleport-back"] = GetTime() + 20;
   } else if (action->ability == "confusion-mushroom") {
     int cur_room = dungeon.GetRoom(spider_tile);
     int player_room = dungeon.GetRoom(player_tile);
@@ -2130,7 +2128,7 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
       // TODO: add confusion status.
       player->AddTemporaryStatus(make_shared<PoisonStatus>(1.0f, 20.0f, 1));
     }
-    spider->cooldowns["confusion-mushroom"] = glfwGetTime() + 30;
+    spider->cooldowns["confusion-mushroom"] = GetTime() + 30;
   } else if (action->ability == "mold-poison") {
     int cur_room = dungeon.GetRoom(spider_tile);
     for (int x = -5; x <= 5; x++) {
@@ -2151,7 +2149,7 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
     }
 
     // spider->AddTemporaryStatus(make_shared<PoisonStatus>(2.0, 5.0f, 1));
-    spider->cooldowns["mold-poison"] = glfwGetTime() + 10;
+    spider->cooldowns["mold-poison"] = GetTime() + 10;
   } else if (action->ability == "summon-worm") {
     if (configs->summoned_creatures > 10) return true;
     for (int tries = 0; tries < 100; tries++) {
@@ -2171,9 +2169,9 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
     }
     
     if (spider->GetAsset()->name == "worm_king") {
-      spider->cooldowns["summon-worm"] = glfwGetTime() + 5;
+      spider->cooldowns["summon-worm"] = GetTime() + 5;
     } else {
-      spider->cooldowns["summon-worm"] = glfwGetTime() + 30;
+      spider->cooldowns["summon-worm"] = GetTime() + 30;
     }
   } else if (action->ability == "spider-web") {
     ObjPtr player = resources_->GetObjectByName("player");
@@ -2186,10 +2184,10 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
       web->life = 100.0f;
       pos += forward * 10.0f;
     }
-    spider->cooldowns["spider-web"] = glfwGetTime() + 5;
+    spider->cooldowns["spider-web"] = GetTime() + 5;
   } else if (action->ability == "jump") {
     spider->AddTemporaryStatus(make_shared<HasteStatus>(2.0, 5.0f, 1));
-    spider->cooldowns["haste"] = glfwGetTime() + 10;
+    spider->cooldowns["haste"] = GetTime() + 10;
   } else if (action->ability == "string-attack") {
     ObjPtr player = resources_->GetObjectByName("player");
     vec3 dir = normalize((player->position + vec3(0, -3.0f, 0)) - spider->position);
@@ -2197,7 +2195,7 @@ bool AI::ProcessUseAbilityAction(ObjPtr spider,
     // spider->cooldowns["string-attack"] = glfwGetTime() + 1;
 
     // TODO: set duration for cast ability.
-    if (glfwGetTime() > action->issued_at + 2) {
+    if (GetTime() > action->issued_at + 2) {
       return true;
     } else {
       return false;
@@ -2587,7 +2585,7 @@ void AI::ProcessPlayerAction(ObjPtr player) {
     case ACTION_WAIT: {
       shared_ptr<WaitAction> wait_action =  
         static_pointer_cast<WaitAction>(action);
-      if (glfwGetTime() > wait_action->until) {
+      if (GetTime() > wait_action->until) {
         player->actions.pop();
       }
       break;
@@ -2629,20 +2627,18 @@ void AI::RunAiInOctreeNode(shared_ptr<OctreeNode> node) {
   const vec3& player_pos = resources_->GetPlayer()->position;
   for (int i = 0; i < 3; i++) {
     if ((player_pos[i] - node->center[i]) > 
-      node->half_dimensions[i] + kMinDistance) {
+      node->loose_half_dimensions[i] + kMinDistance) {
       return;
     }
   }
 
   resources_->Lock();
-  for (auto [id, obj] : node->creatures) {
+  for (ObjPtr obj : node->creatures) {
     if (obj->type != GAME_OBJ_DEFAULT) continue;
     if (obj->GetAsset()->type != ASSET_CREATURE) continue;
     if (obj->being_placed) continue;
     if (obj->distance > kMinDistance) continue;
-    ai_mutex_.lock();
-    ai_tasks_.push(obj);
-    ai_mutex_.unlock();
+    ai_tasks_.push_back(obj);
   }
   resources_->Unlock();
   
@@ -2660,91 +2656,41 @@ void AI::Run() {
     return;
   }
 
+  ai_tasks_.clear();
   RunAiInOctreeNode(resources_->GetOctreeRoot());
+  job_system_->Run([this] () {
+    ScopedRandomStream random_stream(RANDOM_AI);
+    for (ObjPtr obj : ai_tasks_) {
+      ProcessUnitAi(obj);
+    }
+  }, ai_jobs_);
+
   ProcessPlayerAction(resources_->GetPlayer());
 
   resources_->GetDungeon().CalculateVisibility(
     resources_->GetPlayer()->position);
 
-  // Async.
-  while (!ai_tasks_.empty() || running_tasks_ > 0) {
-    this_thread::sleep_for(chrono::microseconds(200));
-  }
+  job_system_->Wait(ai_jobs_);
 
+#ifndef HEADLESS
   glfwMakeContextCurrent(resources_->GetWindow());
-  return;
-
-  // Sync.
-  // while (!ai_tasks_.empty()) {
-  //   auto& obj = ai_tasks_.front();
-  //   ai_tasks_.pop();
-  //   running_tasks_++;
-  //   ai_mutex_.unlock();
-
-  //   // TODO: maybe should go to physics.
-  //   // if (dot(obj->up, vec3(0, 1, 0)) < 0) {
-  //   //   obj->up = vec3(0, 1, 0);
-  //   // }
-
-  //   // Check status. If taking hit, dying, poisoned, etc.
-  //   if (ProcessStatus(obj)) {
-  //     ProcessNextAction(obj);
-  //   }
-
-  //   string ai_script = obj->GetAsset()->ai_script;
-  //   if (!ai_script.empty()) {
-  //     resources_->CallStrFn(ai_script, obj->name);
-  //   }
-
-  //   ai_mutex_.lock();
-  //   running_tasks_--;
-  //   ai_mutex_.unlock();
-  // }
+#endif
 }
 
-void AI::ProcessUnitAiAsync() {
-  while (!terminate_) {
-    ai_mutex_.lock();
-    if (ai_tasks_.empty()) {
-      ai_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(1));
-      continue;
-    }
-
-    auto& obj = ai_tasks_.front();
-    ai_tasks_.pop();
-    running_tasks_++;
-    ai_mutex_.unlock();
-
-    ivec2 tile = resources_->GetDungeon().GetDungeonTile(obj->position);
-    if (!resources_->GetDungeon().IsValidTile(tile)) {
-      if (obj->GetAsset()->name != "big_beholder") {
-        ai_mutex_.lock();
-        running_tasks_--;
-        ai_mutex_.unlock();
-      }
-      continue;
-    }
-
-    // Check status. If taking hit, dying, poisoned, etc.
-    if (ProcessStatus(obj)) {
-      ProcessNextAction(obj);
-    }
-
-    // string ai_script = obj->GetAsset()->ai_script;
-    // if (!ai_script.empty()) {
-    //   resources_->CallStrFn(ai_script, obj->name);
-    // }
-    monsters_->RunMonsterAi(obj);
-
-    ai_mutex_.lock();
-    running_tasks_--;
-    ai_mutex_.unlock();
+void AI::ProcessUnitAi(ObjPtr obj) {
+  ivec2 tile = resources_->GetDungeon().GetDungeonTile(obj->position);
+  if (!resources_->GetDungeon().IsValidTile(tile)) {
+    return;
   }
-}
 
-void AI::CreateThreads() {
-  for (int i = 0; i < kMaxThreads; i++) {
-    ai_threads_.push_back(thread(&AI::ProcessUnitAiAsync, this));
+  // Check status. If taking hit, dying, poisoned, etc.
+  if (ProcessStatus(obj)) {
+    ProcessNextAction(obj);
   }
+
+  // string ai_script = obj->GetAsset()->ai_script;
+  // if (!ai_script.empty()) {
+  //   resources_->CallStrFn(ai_script, obj->name);
+  // }
+  monsters_->RunMonsterAi(obj);
 }
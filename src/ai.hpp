@@ -6,19 +6,18 @@
 #include <random>
 #include "resources.hpp"
 #include "monsters.hpp"
+#include "job_system.hpp"
 
 class AI {
   shared_ptr<Resources> resources_;
   std::default_random_engine generator_;
   shared_ptr<Monsters> monsters_ = nullptr;
  
-  // Parallelism. 
-  bool terminate_ = false;
-  const int kMaxThreads = 1; // 16.
-  vector<thread> ai_threads_;
-  mutex ai_mutex_;
-  queue<ObjPtr> ai_tasks_;
-  int running_tasks_ = 0;
+  // Parallelism. Creatures are processed in order by a single job because
+  // the unit AI is not thread safe.
+  shared_ptr<JobSystem> job_system_;
+  shared_ptr<JobCounter> ai_jobs_;
+  vector<ObjPtr> ai_tasks_;
 
   int dungeon_visibility_[40][40];
   ivec2 last_player_pos = ivec2(-1, -1);
@@ -128,8 +127,7 @@ class AI {
   void ProcessPlayerAction(ObjPtr player);
 
   void RunAiInOctreeNode(shared_ptr<OctreeNode> node);
-  void ProcessUnitAiAsync();
-  void CreateThreads();
+  void ProcessUnitAi(ObjPtr obj);
   vec3 FindSideMove(ObjPtr unit);
 
  public:
@@ -0,0 +1,465 @@
+#include "bvh.hpp"
+#include "ray_packet.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stack>
+
+namespace {
+
+const int kNumBins = 16;
+
+// Leaves never hold more triangles than this, even if splitting is not
+// cheaper according to the heuristic.
+const int kMaxLeafSize = 16;
+
+// Deeper than this the build splits at the median, which bounds the
+// traversal stack.
+const int kMaxSahDepth = 48;
+const int kStackSize = 128;
+
+const uint32_t kBvhMagic = 0x31485642; // "BVH1"
+const uint32_t kBvhVersion = 1;
+
+struct BvhHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_nodes;
+  uint32_t num_triangles;
+};
+
+float SurfaceArea(const vec3& min, const vec3& max) {
+  vec3 d = max - min;
+  return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool IntersectRayBox(const vec3& p, const vec3& inv_d, const vec3& min,
+  const vec3& max, float max_t, float& t_near) {
+  float t0 = 0.0f;
+  float t1 = max_t;
+  for (int axis = 0; axis < 3; axis++) {
+    float t_min = (min[axis] - p[axis]) * inv_d[axis];
+    float t_max = (max[axis] - p[axis]) * inv_d[axis];
+    if (t_min > t_max) std::swap(t_min, t_max);
+    t0 = std::max(t0, t_min);
+    t1 = std::min(t1, t_max);
+    if (t0 > t1) return false;
+  }
+  t_near = t0;
+  return true;
+}
+
+float SquaredDistancePointBox(const vec3& p, const vec3& min,
+  const vec3& max) {
+  float distance = 0.0f;
+  for (int axis = 0; axis < 3; axis++) {
+    float v = p[axis];
+    if (v < min[axis]) distance += (min[axis] - v) * (min[axis] - v);
+    if (v > max[axis]) distance += (v - max[axis]) * (v - max[axis]);
+  }
+  return distance;
+}
+
+bool OverlapsBox(const vec3& min1, const vec3& max1, const vec3& min2,
+  const vec3& max2) {
+  for (int axis = 0; axis < 3; axis++) {
+    if (min1[axis] > max2[axis] || min2[axis] > max1[axis]) return false;
+  }
+  return true;
+}
+
+} // namespace
+
+Bvh::Bvh(const vector<Polygon>& polygons, int max_leaf_size) {
+  vector<BvhTriangle> triangles;
+  for (const Polygon& polygon : polygons) {
+    const vector<vec3>& v = polygon.vertices;
+    for (size_t i = 2; i < v.size(); i++) {
+      triangles.push_back({ v[0], v[i - 1], v[i], polygon.normal });
+    }
+  }
+  if (triangles.empty()) return;
+
+  vector<BuildEntry> entries(triangles.size());
+  for (size_t i = 0; i < triangles.size(); i++) {
+    const BvhTriangle& t = triangles[i];
+    entries[i].min = glm::min(t.a, glm::min(t.b, t.c));
+    entries[i].max = glm::max(t.a, glm::max(t.b, t.c));
+    entries[i].centroid = (entries[i].min + entries[i].max) * 0.5f;
+    entries[i].triangle = i;
+  }
+
+  nodes_.reserve(2 * triangles.size());
+  triangles_.reserve(triangles.size());
+  BuildNode(triangles, entries, 0, entries.size(), 0,
+    std::max(1, std::min(max_leaf_size, kMaxLeafSize)));
+  nodes_.shrink_to_fit();
+}
+
+int Bvh::BuildNode(const vector<BvhTriangle>& triangles,
+  vector<BuildEntry>& entries, int begin, int end, int depth,
+  int max_leaf_size) {
+  const int node_index = nodes_.size();
+  nodes_.push_back(BvhNode());
+
+  vec3 min = entries[begin].min, max = entries[begin].max;
+  vec3 centroid_min = entries[begin].centroid;
+  vec3 centroid_max = entries[begin].centroid;
+  for (int i = begin + 1; i < end; i++) {
+    min = glm::min(min, entries[i].min);
+    max = glm::max(max, entries[i].max);
+    centroid_min = glm::min(centroid_min, entries[i].centroid);
+    centroid_max = glm::max(centroid_max, entries[i].centroid);
+  }
+  nodes_[node_index].min = min;
+  nodes_[node_index].max = max;
+
+  const int n = end - begin;
+  int mid = -1;
+  if (n > max_leaf_size && depth < kMaxSahDepth) {
+    // Binned SAH: cost of a split is proportional to the number of
+    // triangles on each side times the surface area of its bounds.
+    float best_cost = n * SurfaceArea(min, max);
+    int best_axis = -1, best_bin = -1;
+    for (int axis = 0; axis < 3; axis++) {
+      float extent = centroid_max[axis] - centroid_min[axis];
+      if (extent <= 0.0f) continue;
+
+      int counts[kNumBins] = {};
+      vec3 bin_min[kNumBins], bin_max[kNumBins];
+      for (int i = begin; i < end; i++) {
+        int bin = std::min(kNumBins - 1, int(kNumBins *
+          (entries[i].centroid[axis] - centroid_min[axis]) / extent));
+        if (counts[bin]++ == 0) {
+          bin_min[bin] = entries[i].min;
+          bin_max[bin] = entries[i].max;
+        } else {
+          bin_min[bin] = glm::min(bin_min[bin], entries[i].min);
+          bin_max[bin] = glm::max(bin_max[bin], entries[i].max);
+        }
+      }
+
+      // Right to left sweep stores the cost of the right side of each split.
+      float right_cost[kNumBins];
+      int right_count = 0;
+      vec3 right_min, right_max;
+      for (int bin = kNumBins - 1; bin > 0; bin--) {
+        if (counts[bin] > 0) {
+          right_min = (right_count == 0) ? bin_min[bin] :
+            glm::min(right_min, bin_min[bin]);
+          right_max = (right_count == 0) ? bin_max[bin] :
+            glm::max(right_max, bin_max[bin]);
+          right_count += counts[bin];
+        }
+        right_cost[bin] = (right_count == 0) ? 0.0f :
+          right_count * SurfaceArea(right_min, right_max);
+      }
+
+      int left_count = 0;
+      vec3 left_min, left_max;
+      for (int bin = 0; bin < kNumBins - 1; bin++) {
+        if (counts[bin] > 0) {
+          left_min = (left_count == 0) ? bin_min[bin] :
+            glm::min(left_min, bin_min[bin]);
+          left_max = (left_count == 0) ? bin_max[bin] :
+            glm::max(left_max, bin_max[bin]);
+          left_count += counts[bin];
+        }
+        if (left_count == 0 || left_count == n) continue;
+
+        float cost = left_count * SurfaceArea(left_min, left_max) +
+          right_cost[bin + 1];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = bin;
+        }
+      }
+    }
+
+    if (best_axis != -1) {
+      const float extent = centroid_max[best_axis] - centroid_min[best_axis];
+      auto it = std::partition(entries.begin() + begin, entries.begin() + end,
+        [&] (const BuildEntry& e) {
+          int bin = std::min(kNumBins - 1, int(kNumBins *
+            (e.centroid[best_axis] - centroid_min[best_axis]) / extent));
+          return bin <= best_bin;
+        });
+      mid = it - entries.begin();
+    } else if (n > kMaxLeafSize) {
+      // Splitting does not pay off but the leaf would be too big.
+      mid = -2;
+    }
+  } else if (n > max_leaf_size) {
+    mid = -2;
+  }
+
+  if (mid == -2) {
+    int axis = 0;
+    vec3 extent = centroid_max - centroid_min;
+    if (extent.y > extent[axis]) axis = 1;
+    if (extent.z > extent[axis]) axis = 2;
+    mid = begin + n / 2;
+    std::nth_element(entries.begin() + begin, entries.begin() + mid,
+      entries.begin() + end, [axis] (const BuildEntry& a,
+      const BuildEntry& b) { return a.centroid[axis] < b.centroid[axis]; });
+  }
+
+  if (mid == -1) {
+    nodes_[node_index].right_or_first = triangles_.size();
+    nodes_[node_index].num_triangles = n;
+    for (int i = begin; i < end; i++) {
+      triangles_.push_back(triangles[entries[i].triangle]);
+    }
+    return node_index;
+  }
+
+  BuildNode(triangles, entries, begin, mid, depth + 1, max_leaf_size);
+  int right = BuildNode(triangles, entries, mid, end, depth + 1,
+    max_leaf_size);
+  nodes_[node_index].right_or_first = right;
+  nodes_[node_index].num_triangles = 0;
+  return node_index;
+}
+
+// Moller-Trumbore, both faces.
+bool Bvh::IntersectRayTriangle(const vec3& p, const vec3& d,
+  const BvhTriangle& triangle, float& t) const {
+  vec3 e1 = triangle.b - triangle.a;
+  vec3 e2 = triangle.c - triangle.a;
+  vec3 pvec = cross(d, e2);
+  float det = dot(e1, pvec);
+  if (abs(det) < 1e-8f) return false;
+
+  float inv_det = 1.0f / det;
+  vec3 tvec = p - triangle.a;
+  float u = dot(tvec, pvec) * inv_det;
+  if (u < 0.0f || u > 1.0f) return false;
+
+  vec3 qvec = cross(tvec, e1);
+  float v = dot(d, qvec) * inv_det;
+  if (v < 0.0f || u + v > 1.0f) return false;
+
+  t = dot(e2, qvec) * inv_det;
+  return t >= 0.0f;
+}
+
+bool Bvh::IntersectRay(const vec3& p, const vec3& d, float& t, vec3& q,
+  const vec3& base_position) const {
+  if (nodes_.empty()) return false;
+
+  const vec3 local_p = p - base_position;
+  vec3 inv_d;
+  for (int axis = 0; axis < 3; axis++) {
+    inv_d[axis] = (d[axis] != 0.0f) ? 1.0f / d[axis] : 1e30f;
+  }
+
+  float closest_t = numeric_limits<float>::max();
+  int to_visit[kStackSize];
+  int num_to_visit = 0;
+  to_visit[num_to_visit++] = 0;
+  while (num_to_visit > 0) {
+    int node_index = to_visit[--num_to_visit];
+    const BvhNode& node = nodes_[node_index];
+    float t_near;
+    if (!IntersectRayBox(local_p, inv_d, node.min, node.max, closest_t,
+      t_near)) {
+      continue;
+    }
+
+    if (node.IsLeaf()) {
+      for (int i = 0; i < node.num_triangles; i++) {
+        float triangle_t;
+        if (IntersectRayTriangle(local_p, d,
+          triangles_[node.right_or_first + i], triangle_t) &&
+          triangle_t < closest_t) {
+          closest_t = triangle_t;
+        }
+      }
+      continue;
+    }
+
+    // The nearest child goes on top of the stack.
+    int left = node_index + 1;
+    int right = node.right_or_first;
+    float t_left, t_right;
+    bool hit_left = IntersectRayBox(local_p, inv_d, nodes_[left].min,
+      nodes_[left].max, closest_t, t_left);
+    bool hit_right = IntersectRayBox(local_p, inv_d, nodes_[right].min,
+      nodes_[right].max, closest_t, t_right);
+    if (hit_left && hit_right && t_left < t_right) {
+      to_visit[num_to_visit++] = right;
+      to_visit[num_to_visit++] = left;
+    } else {
+      if (hit_left) to_visit[num_to_visit++] = left;
+      if (hit_right) to_visit[num_to_visit++] = right;
+    }
+  }
+
+  if (closest_t == numeric_limits<float>::max()) return false;
+  q = p + d * closest_t;
+  t = length(q - p);
+  return true;
+}
+
+void Bvh::IntersectRays(RayPacket& packet) const {
+  if (nodes_.empty()) return;
+
+  // Children are ordered by the direction of the first ray, which works
+  // well when the rays in a packet are roughly coherent.
+  const vec3 d = packet.GetDirection(0);
+
+  int to_visit[kStackSize];
+  int num_to_visit = 0;
+  to_visit[num_to_visit++] = 0;
+  while (num_to_visit > 0) {
+    int node_index = to_visit[--num_to_visit];
+    const BvhNode& node = nodes_[node_index];
+    if (!IntersectRayPacketAABB(packet, node.min, node.max)) continue;
+
+    if (node.IsLeaf()) {
+      IntersectRayPacketTriangles(packet, &triangles_[node.right_or_first],
+        node.num_triangles, node.right_or_first);
+      continue;
+    }
+
+    int left = node_index + 1;
+    int right = node.right_or_first;
+    vec3 left_center = nodes_[left].min + nodes_[left].max;
+    vec3 right_center = nodes_[right].min + nodes_[right].max;
+    if (dot(left_center - right_center, d) < 0.0f) {
+      to_visit[num_to_visit++] = right;
+      to_visit[num_to_visit++] = left;
+    } else {
+      to_visit[num_to_visit++] = left;
+      to_visit[num_to_visit++] = right;
+    }
+  }
+}
+
+void Bvh::FindTriangles(const BoundingSphere& s,
+  vector<int>& triangles) const {
+  if (nodes_.empty()) return;
+
+  const float radius2 = s.radius * s.radius;
+  int to_visit[kStackSize];
+  int num_to_visit = 0;
+  to_visit[num_to_visit++] = 0;
+  while (num_to_visit > 0) {
+    int node_index = to_visit[--num_to_visit];
+    const BvhNode& node = nodes_[node_index];
+    if (SquaredDistancePointBox(s.center, node.min, node.max) > radius2) {
+      continue;
+    }
+
+    if (!node.IsLeaf()) {
+      to_visit[num_to_visit++] = node.right_or_first;
+      to_visit[num_to_visit++] = node_index + 1;
+      continue;
+    }
+
+    for (int i = 0; i < node.num_triangles; i++) {
+      const BvhTriangle& t = triangles_[node.right_or_first + i];
+      vec3 min = glm::min(t.a, glm::min(t.b, t.c));
+      vec3 max = glm::max(t.a, glm::max(t.b, t.c));
+      if (SquaredDistancePointBox(s.center, min, max) <= radius2) {
+        triangles.push_back(node.right_or_first + i);
+      }
+    }
+  }
+}
+
+void Bvh::FindTriangles(const AABB& aabb, vector<int>& triangles) const {
+  if (nodes_.empty()) return;
+
+  const vec3 aabb_min = aabb.point;
+  const vec3 aabb_max = aabb.point + aabb.dimensions;
+  int to_visit[kStackSize];
+  int num_to_visit = 0;
+  to_visit[num_to_visit++] = 0;
+  while (num_to_visit > 0) {
+    int node_index = to_visit[--num_to_visit];
+    const BvhNode& node = nodes_[node_index];
+    if (!OverlapsBox(aabb_min, aabb_max, node.min, node.max)) continue;
+
+    if (!node.IsLeaf()) {
+      to_visit[num_to_visit++] = node.right_or_first;
+      to_visit[num_to_visit++] = node_index + 1;
+      continue;
+    }
+
+    for (int i = 0; i < node.num_triangles; i++) {
+      const BvhTriangle& t = triangles_[node.right_or_first + i];
+      vec3 min = glm::min(t.a, glm::min(t.b, t.c));
+      vec3 max = glm::max(t.a, glm::max(t.b, t.c));
+      if (OverlapsBox(aabb_min, aabb_max, min, max)) {
+        triangles.push_back(node.right_or_first + i);
+      }
+    }
+  }
+}
+
+Polygon Bvh::GetPolygon(int i) const {
+  const BvhTriangle& t = triangles_[i];
+  Polygon polygon;
+  polygon.vertices = { t.a, t.b, t.c };
+  polygon.normal = t.normal;
+  return polygon;
+}
+
+AABB Bvh::GetAABB() const {
+  if (nodes_.empty()) return AABB(vec3(0), vec3(0));
+  return AABB(nodes_[0].min, nodes_[0].max - nodes_[0].min);
+}
+
+size_t Bvh::GetMemoryUsage() const {
+  return sizeof(Bvh) + nodes_.capacity() * sizeof(BvhNode) +
+    triangles_.capacity() * sizeof(BvhTriangle);
+}
+
+void Bvh::Save(ostream& os) const {
+  BvhHeader header { kBvhMagic, kBvhVersion, uint32_t(nodes_.size()),
+    uint32_t(triangles_.size()) };
+  os.write((const char*) &header, sizeof(BvhHeader));
+  os.write((const char*) nodes_.data(), nodes_.size() * sizeof(BvhNode));
+  os.write((const char*) triangles_.data(),
+    triangles_.size() * sizeof(BvhTriangle));
+}
+
+void Bvh::Load(istream& is) {
+  BvhHeader header;
+  is.read((char*) &header, sizeof(BvhHeader));
+  if (!is || header.magic != kBvhMagic) {
+    throw runtime_error("Invalid BVH data");
+  }
+  if (header.version != kBvhVersion) {
+    throw runtime_error("Unsupported BVH version " +
+      to_string(header.version));
+  }
+
+  nodes_.resize(header.num_nodes);
+  triangles_.resize(header.num_triangles);
+  is.read((char*) nodes_.data(), nodes_.size() * sizeof(BvhNode));
+  is.read((char*) triangles_.data(), triangles_.size() * sizeof(BvhTriangle));
+  if (!is) throw runtime_error("Truncated BVH data");
+}
+
+shared_ptr<Bvh> ConstructBvhFromAABBTree(shared_ptr<AABBTreeNode> node) {
+  vector<Polygon> polygons;
+  stack<shared_ptr<AABBTreeNode>> nodes;
+  if (node) nodes.push(node);
+  while (!nodes.empty()) {
+    shared_ptr<AABBTreeNode> current = nodes.top();
+    nodes.pop();
+    if (current->has_polygon) {
+      polygons.push_back(current->polygon);
+      continue;
+    }
+    if (current->lft) nodes.push(current->lft);
+    if (current->rgt) nodes.push(current->rgt);
+  }
+
+  if (polygons.empty()) return nullptr;
+  return make_shared<Bvh>(polygons);
+}
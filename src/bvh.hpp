@@ -0,0 +1,88 @@
+#ifndef __BVH_HPP__
+#define __BVH_HPP__
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "util.hpp"
+
+using namespace std;
+using namespace glm;
+
+struct RayPacket;
+
+// Nodes are laid out depth first: the left child of an internal node is the
+// next node and the right child is at right_or_first. Leaves point to a
+// contiguous range of triangles.
+struct BvhNode {
+  vec3 min;
+  int right_or_first;
+  vec3 max;
+  int num_triangles;
+
+  bool IsLeaf() const { return num_triangles > 0; }
+};
+
+struct BvhTriangle {
+  vec3 a, b, c;
+  vec3 normal;
+};
+
+// Flat bounding volume hierarchy over the triangles of a collision mesh,
+// built with the surface area heuristic. It replaces the pointer based
+// AABBTreeNode for queries: one array of 32 byte nodes and one array of
+// triangles, traversed with a small stack instead of recursion.
+class Bvh {
+  vector<BvhNode> nodes_;
+  vector<BvhTriangle> triangles_;
+
+  struct BuildEntry {
+    vec3 min, max, centroid;
+    int triangle;
+  };
+
+  int BuildNode(const vector<BvhTriangle>& triangles,
+    vector<BuildEntry>& entries, int begin, int end, int depth,
+    int max_leaf_size);
+  bool IntersectRayTriangle(const vec3& p, const vec3& d,
+    const BvhTriangle& triangle, float& t) const;
+
+ public:
+  Bvh() {}
+
+  // Polygons with more than three vertices are split in triangle fans.
+  Bvh(const vector<Polygon>& polygons, int max_leaf_size = 4);
+
+  // Closest hit of the ray p + t*d. As with IntersectRayAABBTree, the mesh
+  // is offset by base_position and t is the distance from p to q.
+  bool IntersectRay(const vec3& p, const vec3& d, float& t, vec3& q,
+    const vec3& base_position = vec3(0)) const;
+
+  // Packet version of IntersectRay with the rays in the mesh space. Rays
+  // that hit a triangle before their t get a shorter t and its index.
+  void IntersectRays(RayPacket& packet) const;
+
+  // Appends the triangles whose bounds touch the sphere or box, given in the
+  // mesh space.
+  void FindTriangles(const BoundingSphere& s, vector<int>& triangles) const;
+  void FindTriangles(const AABB& aabb, vector<int>& triangles) const;
+
+  const BvhTriangle& GetTriangle(int i) const { return triangles_[i]; }
+  Polygon GetPolygon(int i) const;
+  AABB GetAABB() const;
+
+  int GetNumNodes() const { return nodes_.size(); }
+  int GetNumTriangles() const { return triangles_.size(); }
+  size_t GetMemoryUsage() const;
+
+  // Binary format: header, nodes and triangles as they are in memory. Load
+  // throws if the data was not written by Save.
+  void Save(ostream& os) const;
+  void Load(istream& is);
+};
+
+// The polygons in the leaves of a tree loaded from xml.
+shared_ptr<Bvh> ConstructBvhFromAABBTree(shared_ptr<AABBTreeNode> node);
+
+#endif // __BVH_HPP__
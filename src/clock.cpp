@@ -0,0 +1,45 @@
+#include "clock.hpp"
+
+#include <chrono>
+#ifndef HEADLESS
+#include <GLFW/glfw3.h>
+#endif
+
+namespace {
+
+shared_ptr<Clock> gClock = make_shared<SystemClock>();
+
+} // namespace
+
+double SystemClock::GetTime() {
+#ifdef HEADLESS
+  static const auto start = chrono::steady_clock::now();
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+#else
+  return glfwGetTime();
+#endif
+}
+
+FixedStepClock::FixedStepClock(double step, double start_time)
+  : time_(start_time), step_(step) {
+}
+
+double FixedStepClock::GetTime() {
+  return time_.load();
+}
+
+void FixedStepClock::Tick() {
+  time_.store(time_.load() + step_);
+}
+
+void SetClock(shared_ptr<Clock> clock) {
+  gClock = clock;
+}
+
+shared_ptr<Clock> GetClock() {
+  return gClock;
+}
+
+double GetTime() {
+  return gClock->GetTime();
+}
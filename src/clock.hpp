@@ -0,0 +1,42 @@
+#ifndef __CLOCK_HPP__
+#define __CLOCK_HPP__
+
+#include <atomic>
+#include <memory>
+
+using namespace std;
+
+// Every subsystem reads the current time through GetTime() instead of calling
+// glfwGetTime() directly, so the simulation can be driven by a fixed timestep
+// when running without a window.
+class Clock {
+ public:
+  virtual ~Clock() {}
+  virtual double GetTime() = 0;
+};
+
+// Wall clock time in seconds. Uses GLFW's timer when a window exists.
+class SystemClock : public Clock {
+ public:
+  double GetTime();
+};
+
+// Time only moves when Tick() is called. Readers in worker threads see the
+// time of the last completed tick.
+class FixedStepClock : public Clock {
+  atomic<double> time_;
+  double step_;
+
+ public:
+  FixedStepClock(double step, double start_time = 0.0);
+
+  double GetTime();
+  double GetStep() { return step_; }
+  void Tick();
+};
+
+void SetClock(shared_ptr<Clock> clock);
+shared_ptr<Clock> GetClock();
+double GetTime();
+
+#endif // __CLOCK_HPP__
@@ -745,8 +745,9 @@ shared_ptr<SphereTreeNode> ConstructSphereTreeFromPolygons(
 // AABB tree.
 void SortPolygonsAndAABB(
   vector<pair<Polygon, AABB>>& polygons_and_aabb, int i, int j) {
-  float s[3], s2[3];
-  for (auto& [polygon, aabb] : polygons_and_aabb) {
+  float s[3] = {}, s2[3] = {};
+  for (int k = i; k <= j; k++) {
+    const AABB& aabb = polygons_and_aabb[k].second;
     for (int axis = 0; axis < 3; axis++) {
       s[axis] += aabb.point[axis];
       s2[axis] += aabb.point[axis] * aabb.point[axis];
@@ -755,8 +756,7 @@ void SortPolygonsAndAABB(
 
   float variances[3];
   for (int axis = 0; axis < 3; axis++) {
-    variances[axis] = s2[axis] - s[axis] * s[axis] /  
-      polygons_and_aabb.size();
+    variances[axis] = s2[axis] - s[axis] * s[axis] / (j - i + 1);
   }
 
   int sort_axis = 0;
@@ -789,11 +789,15 @@ shared_ptr<AABBTreeNode> ConstructAABBTreeFromPolygonsAndAABB(
 
   SortPolygonsAndAABB(polygons_and_aabb, i, j);
 
-  vector<Polygon> polygons;
-  for (int k = i; k <= j; k++) {
-    polygons.push_back(polygons_and_aabb[k].first);
+  // The union of the polygon boxes, without copying the polygons.
+  vec3 min_v = polygons_and_aabb[i].second.point;
+  vec3 max_v = min_v + polygons_and_aabb[i].second.dimensions;
+  for (int k = i + 1; k <= j; k++) {
+    const AABB& aabb = polygons_and_aabb[k].second;
+    min_v = glm::min(min_v, aabb.point);
+    max_v = glm::max(max_v, aabb.point + aabb.dimensions);
   }
-  node->aabb = GetAABBFromPolygons(polygons);
+  node->aabb = AABB(min_v, max_v - min_v);
 
   int mid = (i + j) / 2;
   node->lft = 
@@ -805,7 +809,10 @@ shared_ptr<AABBTreeNode> ConstructAABBTreeFromPolygonsAndAABB(
 
 shared_ptr<AABBTreeNode> ConstructAABBTreeFromPolygons(
   const vector<Polygon>& polygons) {
+  if (polygons.empty()) return nullptr;
+
   vector<pair<Polygon, AABB>> polygons_and_aabb;
+  polygons_and_aabb.reserve(polygons.size());
   for (const Polygon& polygon : polygons) {
     AABB aabb = GetAABBFromPolygons(polygon);
     polygons_and_aabb.push_back({ polygon, aabb });
@@ -3,6 +3,23 @@
 
 #include <chrono>
 
+namespace {
+
+// Arena of the collision buffer owned by the job running on this thread.
+thread_local FrameArena* tCollisionArena = nullptr;
+
+} // namespace
+
+// Collision records live in the frame arena when created inside a collision
+// job. The shared_ptr does not own the record, it is destroyed when the
+// arena is reset at the start of the next Collide.
+template <class T, class... Args>
+shared_ptr<T> NewCollision(Args&&... args) {
+  if (!tCollisionArena) return make_shared<T>(forward<Args>(args)...);
+  return shared_ptr<T>(shared_ptr<T>(), 
+    tCollisionArena->New<T>(forward<Args>(args)...));
+}
+
 vector<vector<CollisionPair>> kAllowedCollisionPairs {
   // Sphere / Bones / Quick Sphere / Perfect / OBB /  AABB / Terrain / Ray
   { CP_SS,    CP_SB,  CP_SQ,         CP_SP,    CP_SO, CP_SA, CP_ST, CP_SR }, // Sphere 
@@ -16,16 +33,12 @@ vector<vector<CollisionPair>> kAllowedCollisionPairs {
 };
 
 CollisionResolver::CollisionResolver(
-  shared_ptr<Resources> asset_catalog) : resources_(asset_catalog) {
-  CreateThreads();
+  shared_ptr<Resources> asset_catalog) : resources_(asset_catalog),
+  job_system_(GetJobSystem()), collide_jobs_(make_shared<JobCounter>()) {
 }
 
 CollisionResolver::~CollisionResolver() {
-  terminate_ = true;
-  for (int i = 0; i < kMaxThreads; i++) {
-    find_threads_[i].join();
-    test_threads_[i].join();
-  }
+  job_system_->Wait(collide_jobs_);
 }
 
 // TODO: better to have a list: ignore_collision_from [id1, id2, id3]
@@ -61,11 +74,13 @@ void GetTerrainPolygons(shared_ptr<Resources> resources,
     vec3(pos.x + k, 0, pos.y + k)
   };
 
-  vector<vec3> normals(4);
-  for (int i = 0; i < 4; i++) {
-    v[i].y = resources->GetHeightMap().GetTerrainHeight(
-      vec2(v[i].x, v[i].z), &normals[i]);
-  }
+  vector<vec2> positions(4);
+  for (int i = 0; i < 4; i++) positions[i] = vec2(v[i].x, v[i].z);
+
+  vector<float> heights;
+  vector<vec3> normals;
+  resources->GetHeightMap().GetTerrainHeights(positions, heights, &normals);
+  for (int i = 0; i < 4; i++) v[i].y = heights[i];
 
   // Top triangle.
   Polygon polygon;
@@ -132,20 +147,71 @@ bool CollisionResolver::IsPairCollidable(ObjPtr obj1, ObjPtr obj2) {
   return true;
 }
 
-void CollisionResolver::ProcessTentativePair(ObjPtr obj1, ObjPtr obj2) {
+CollisionResolver::CollisionBuffer* 
+CollisionResolver::AcquireCollisionBuffer() {
+  lock_guard<mutex> lock(collision_buffers_mutex_);
+  if (free_collision_buffers_.empty()) {
+    collision_buffers_.push_back(make_unique<CollisionBuffer>());
+    return collision_buffers_.back().get();
+  }
+
+  CollisionBuffer* buffer = free_collision_buffers_.back();
+  free_collision_buffers_.pop_back();
+  return buffer;
+}
+
+void CollisionResolver::ReleaseCollisionBuffer(CollisionBuffer* buffer) {
+  lock_guard<mutex> lock(collision_buffers_mutex_);
+  free_collision_buffers_.push_back(buffer);
+}
+
+void CollisionResolver::ResetCollisionBuffers() {
+  for (auto& buffer : collision_buffers_) {
+    buffer->collisions.clear();
+    buffer->arena.Reset();
+  }
+}
+
+void CollisionResolver::MergeCollisionBuffers() {
+  for (auto& buffer : collision_buffers_) {
+    buffer->max_collisions = std::max(buffer->max_collisions, 
+      buffer->collisions.size());
+    for (ColPtr& c : buffer->collisions) {
+      collisions_.push(c);
+    }
+  }
+}
+
+void CollisionResolver::RunCollisionJobs(int n, int batch_size,
+  function<void(int, CollisionBuffer&)> fn) {
+  unsigned int random_seed = NextRandomSeed(RANDOM_COLLISION);
+  for (int i = 0; i < n; i += batch_size) {
+    int batch_end = std::min(i + batch_size, n);
+    job_system_->Run([this, fn, i, batch_end, random_seed] () {
+      ScopedRandomEngine random_engine(random_seed, i);
+      CollisionBuffer* buffer = AcquireCollisionBuffer();
+      FrameArena* prev_arena = tCollisionArena;
+      tCollisionArena = &buffer->arena;
+      for (int j = i; j < batch_end; j++) fn(j, *buffer);
+      tCollisionArena = prev_arena;
+      ReleaseCollisionBuffer(buffer);
+    }, collide_jobs_);
+  }
+}
+
+void CollisionResolver::ProcessTentativePair(ObjPtr obj1, ObjPtr obj2,
+  CollisionBuffer& buffer) {
   vector<ColPtr> collisions = CollideObjects(obj1, obj2);
   for (auto& c : collisions) {
     TestCollision(c);
     if (c->collided) {
-      find_mutex_.lock();
-      collisions_.push(c);
-      find_mutex_.unlock();
+      buffer.collisions.push_back(c);
     }
   }
 }
 
 void CollisionResolver::Collide() {
-  double start_time = glfwGetTime();
+  double start_time = GetTime();
 
   in_dungeon_ = resources_->GetConfigs()->render_scene == "dungeon" ||
     resources_->GetConfigs()->render_scene == "arena";
@@ -154,45 +220,34 @@ void CollisionResolver::Collide() {
     resources_->GetPlayer()->can_jump = false;
   }
 
-  find_mutex_.lock();
   ClearMetrics();
+  ResetCollisionBuffers();
   UpdateObjectPositions();
-  running_find_tasks_ = 0;
-  running_test_tasks_ = 0;
-  if (!resources_->GetConfigs()->disable_collision)
-    find_tasks_.push(resources_->GetOctreeRoot());
-  find_mutex_.unlock();
 
   if (resources_->GetConfigs()->disable_collision) {
     return;
   }
 
+  // Pairs are tested in jobs while the terrain pairs are queued.
+  FindCollisions();
+
   // Collision with the terrain.
+  vector<ObjPtr> terrain_objs;
   for (ObjPtr obj1 : resources_->GetMovingObjects()) {
     if (!obj1->IsCollidable()) continue;
     if (obj1->IsFixed()) continue;
 
     obj1->touching_the_ground = false;
-
-    find_mutex_.lock();
-    tentative_pairs_.push({ obj1, nullptr });
-    find_mutex_.unlock();
+    terrain_objs.push_back(obj1);
   }
 
-  // Test tentative pairs async.
-  while (true) {
-    find_mutex_.lock();
-    if (!find_tasks_.empty() || running_find_tasks_ > 0 ||
-    !tentative_pairs_.empty() || running_test_tasks_ > 0) {
-      find_mutex_.unlock();
-      this_thread::sleep_for(chrono::microseconds(100));
-      continue;
-    }
-    find_mutex_.unlock();
-    break;
-  }
+  RunCollisionJobs(terrain_objs.size(), 8, 
+    [&] (int i, CollisionBuffer& buffer) {
+    ProcessTentativePair(terrain_objs[i], nullptr, buffer);
+  });
+  job_system_->Wait(collide_jobs_);
+  MergeCollisionBuffers();
 
-  find_mutex_.lock();
   ResolveCollisions();
   ProcessInContactWith();
 
@@ -241,7 +296,6 @@ void CollisionResolver::Collide() {
     obj->target_position = obj->position;
     resources_->UpdateObjectPosition(obj);
   }
-  find_mutex_.unlock();
 
   // PrintMetrics();
 
@@ -258,14 +312,34 @@ void CollisionResolver::ClearMetrics() {
 }
 
 void CollisionResolver::PrintMetrics() {
+  SweepAndPruneMetrics metrics = broadphase_.GetMetrics();
+
+  // High-water marks of the collision buffers.
+  size_t max_collisions = 0, max_memory_usage = 0, capacity = 0;
+  int max_allocations = 0;
+  for (auto& buffer : collision_buffers_) {
+    const FrameArenaMetrics& arena_metrics = buffer->arena.GetMetrics();
+    max_collisions += buffer->max_collisions;
+    max_allocations += arena_metrics.max_allocations;
+    max_memory_usage += arena_metrics.max_memory_usage;
+    capacity += arena_metrics.capacity;
+  }
+
   cout << "# Perfect collisions: " << perfect_collision_tests_ << endl;
+  cout << "# Collision buffers: " << collision_buffers_.size() << endl;
+  cout << "# Max buffered collisions: " << max_collisions << endl;
+  cout << "# Max collision records: " << max_allocations << " (" 
+       << max_memory_usage << " of " << capacity << " bytes)" << endl;
+  cout << "# Broadphase proxies: " << metrics.num_proxies << endl;
+  cout << "# Broadphase pairs: " << metrics.num_pairs << endl;
+  cout << "# Broadphase swaps: " << metrics.num_swaps << endl;
 }
 
 void CollisionResolver::UpdateObjectPositions() {
   const auto& configs = resources_->GetConfigs();
   vec3 player_pos = resources_->GetPlayer()->position;
 
-  start_time_ = glfwGetTime();
+  start_time_ = GetTime();
   vector<ObjPtr>& objs = resources_->GetMovingObjects();
   for (ObjPtr obj : objs) {
     obj->in_contact_with = nullptr;
@@ -287,103 +361,119 @@ void CollisionResolver::UpdateObjectPositions() {
   }
 }
 
-void CollisionResolver::CollideAlongAxis(shared_ptr<OctreeNode> octree_node,
-  shared_ptr<GameObject> obj) {
-  while (octree_node && octree_node->axis == -1) {
-    octree_node = octree_node->parent;
-  }
-  if (!octree_node) throw runtime_error("Invalid octree node");
-
-  int axis = octree_node->axis;
-  if (axis == -1) throw runtime_error("Invalid axis");
-
+void GetBroadphaseBounds(ObjPtr obj, vec3& min, vec3& max) {
   BoundingSphere s;
   if (obj->type == GAME_OBJ_MISSILE) {
+    // Covers the whole movement so fast missiles do not tunnel.
     s.center = obj->prev_position + 0.5f*(obj->position - obj->prev_position);
     s.radius = 0.5f * length(obj->prev_position - obj->position) + 
       obj->GetBoundingSphere().radius;
   } else {
     s = obj->GetTransformedBoundingSphere();
   }
+  min = s.center - vec3(s.radius);
+  max = s.center + vec3(s.radius);
+}
+
+void CollisionResolver::UpdateStaticProxies() {
+  int version = resources_->GetStaticObjectsVersion();
+  if (version == static_objects_version_) return;
+  static_objects_version_ = version;
+
+  // The root lists every static object in the octree. Most of them are the
+  // same after a regeneration (e.g. a door opened), so only the differences
+  // touch the broadphase.
+  shared_ptr<OctreeNode> root = resources_->GetOctreeRoot();
+  for (const SortedStaticObj& static_obj : root->static_objects) {
+    ObjPtr obj = static_obj.obj;
+
+    // Objects that can move are tracked as moving objects.
+    if (obj->IsMovingObject()) continue;
+    if (!obj->IsCollidable()) continue;
 
-  float radius = s.radius;
-  float start = s.center[axis] - radius;
-  float end = s.center[axis] + radius;
+    const AABB& aabb = obj->GetAABB();
+    vec3 min = obj->position + aabb.point;
+    vec3 max = min + aabb.dimensions;
 
-  // Perform binary search to find the first obj after or equal to start.
-  vector<SortedStaticObj>& static_objects = octree_node->static_objects;
-  int idx = static_objects.size();
-  int l = 0; int r = static_objects.size() - 1;
-  while (l <= r) {
-    int mid = (l + r) / 2; 
+    auto it = broadphase_proxies_.find(obj->id);
+    if (it == broadphase_proxies_.end()) {
+      int handle = broadphase_.AddProxy(obj->id, min, max, true);
+      broadphase_proxies_[obj->id] = { obj, handle, true, version };
+      continue;
+    }
 
-    if (static_objects[mid].end < start) {
-      l = mid + 1; 
-    } else { 
-      idx = mid; 
-      r = mid - 1; 
-    } 
+    it->second.frame = version;
+    broadphase_.UpdateProxy(it->second.handle, min, max);
   }
 
-  idx = 0;
-  for (int i = idx; i < static_objects.size(); i++) {
-    const SortedStaticObj& static_obj = static_objects[i];
-    if (static_obj.start > end) break;
-    if (static_obj.end < start) continue;
-    if (!static_obj.obj->IsCollidable()) continue;
-     
-    find_mutex_.lock();
-    tentative_pairs_.push({ obj, static_obj.obj });
-    find_mutex_.unlock();
+  for (auto it = broadphase_proxies_.begin(); 
+    it != broadphase_proxies_.end();) {
+    if (!it->second.is_static || it->second.frame == version) {
+      ++it;
+      continue;
+    }
+    broadphase_.RemoveProxy(it->second.handle);
+    it = broadphase_proxies_.erase(it);
   }
 }
 
-void CollisionResolver::FindCollisions(shared_ptr<OctreeNode> octree_node) {
-  if (!octree_node || octree_node->updated_at < start_time_) return;
+void CollisionResolver::UpdateMovingProxies() {
+  broadphase_frame_++;
+  for (ObjPtr obj : resources_->GetMovingObjects()) {
+    if (!obj->IsCollidable()) continue;
 
-  AABB aabb = AABB(octree_node->center - octree_node->half_dimensions, 
-    octree_node->half_dimensions * 2.0f);
+    vec3 min, max;
+    GetBroadphaseBounds(obj, min, max);
 
-  // vec3 player_pos = resources_->GetPlayer()->position;
-  // vec3 closest = ClosestPtPointAABB(player_pos, aabb);
+    auto it = broadphase_proxies_.find(obj->id);
+    if (it == broadphase_proxies_.end()) {
+      int handle = broadphase_.AddProxy(obj->id, min, max);
+      broadphase_proxies_[obj->id] = { obj, handle, false, broadphase_frame_ };
+      continue;
+    }
 
-  resources_->Lock();
-  for (auto [id, obj1] : octree_node->moving_objs) {
-    if (!obj1->IsCollidable()) continue;
-    CollideAlongAxis(octree_node, obj1);
+    it->second.frame = broadphase_frame_;
+    broadphase_.UpdateProxy(it->second.handle, min, max);
   }
 
-  vector<ObjPtr> objs = {};
-  shared_ptr<OctreeNode> parent = octree_node->parent;
-  while (parent != nullptr) {
-    for (auto [id, obj] : parent->moving_objs) {
-      if (!obj->IsCollidable()) continue;
-      objs.push_back(obj);
+  // Objects that were removed or stopped being collidable.
+  for (auto it = broadphase_proxies_.begin(); 
+    it != broadphase_proxies_.end();) {
+    if (it->second.is_static || it->second.frame == broadphase_frame_) {
+      ++it;
+      continue;
     }
-    parent = parent->parent;
+    broadphase_.RemoveProxy(it->second.handle);
+    it = broadphase_proxies_.erase(it);
   }
-  
-  for (auto [id, obj1] : octree_node->moving_objs) {
-    if (!obj1->IsCollidable()) continue;
+}
 
-    for (int i = 0; i < objs.size(); i++) {
-      shared_ptr<GameObject> obj2 = objs[i];
-      if (obj1->id == obj2->id) continue;
-      if (!obj2->IsCollidable()) continue;
-       
-      find_mutex_.lock();
-      tentative_pairs_.push({ obj1, obj2 });
-      find_mutex_.unlock();
-    }
-    objs.push_back(obj1);
-  }
+void CollisionResolver::FindCollisions() {
+  resources_->Lock();
+  UpdateStaticProxies();
+  UpdateMovingProxies();
+  broadphase_.Commit();
   resources_->Unlock();
-  
-  for (int i = 0; i < 8; i++) {
-    find_mutex_.lock();
-    find_tasks_.push(octree_node->children[i]);
-    find_mutex_.unlock();
-  }
+
+  broadphase_.GetPairs(broadphase_pairs_);
+  RunCollisionJobs(broadphase_pairs_.size(), 16, 
+    [this] (int i, CollisionBuffer& buffer) {
+    const BroadphaseProxy& proxy1 = 
+      broadphase_proxies_.at(broadphase_pairs_[i].first);
+    const BroadphaseProxy& proxy2 = 
+      broadphase_proxies_.at(broadphase_pairs_[i].second);
+
+    // Static proxies are only refreshed when the static objects change, so
+    // an object may have stopped being collidable since.
+    if (!proxy1.obj->IsCollidable() || !proxy2.obj->IsCollidable()) return;
+
+    // Static objects always go second, as in the allowed pairs table.
+    if (proxy1.is_static) {
+      ProcessTentativePair(proxy2.obj, proxy1.obj, buffer);
+    } else {
+      ProcessTentativePair(proxy1.obj, proxy2.obj, buffer);
+    }
+  });
 }
 
 // void CollisionResolver::FindRayCollisions(shared_ptr<OctreeNode> octree_node) {
@@ -499,7 +589,7 @@ void Merge(vector<ColPtr>& collisions, vector<shared_ptr<T>> collisions2) {
 
 // Sphere - Sphere.
 vector<shared_ptr<CollisionSS>> GetCollisionsSS(ObjPtr obj1, ObjPtr obj2) {
-  return { make_shared<CollisionSS>(obj1, obj2) };
+  return { NewCollision<CollisionSS>(obj1, obj2) };
 }
 
 // Sphere - Bones.
@@ -507,46 +597,44 @@ vector<shared_ptr<CollisionSB>> GetCollisionsSB(ObjPtr obj1, ObjPtr obj2) {
   vector<shared_ptr<CollisionSB>> collisions;
   for (const auto& [bone_id, bone] : obj2->bones) {
     if (!bone.collidable) continue;
-    collisions.push_back(make_shared<CollisionSB>(obj1, obj2, bone_id));
+    collisions.push_back(NewCollision<CollisionSB>(obj1, obj2, bone_id));
   }
   return collisions;
 }
 
-// Sphere - Perfect.
-vector<shared_ptr<CollisionSP>> GetCollisionsSPAux(shared_ptr<AABBTreeNode> node, ObjPtr obj1, 
-  ObjPtr obj2) {
-  if (!node) {
-    return {};
-  }
+// Calls fn for every polygon of the perfect collision mesh of obj2 whose
+// bounds touch the sphere s, given in world coordinates.
+template <class Fn>
+void ForEachPerfectPolygon(ObjPtr obj2, const BoundingSphere& s, Fn fn) {
+  thread_local vector<int> triangles;
+  BoundingSphere local_s = s;
+  local_s.center = s.center - obj2->position;
 
-  BoundingSphere s = obj1->GetTransformedBoundingSphere();
-  if (!TestSphereAABB(s, node->aabb + obj2->position)) return {};
+  auto find_polygons = [&] (const shared_ptr<Bvh>& bvh) {
+    if (!bvh) return;
+    triangles.clear();
+    bvh->FindTriangles(local_s, triangles);
+    for (int i : triangles) fn(bvh->GetPolygon(i));
+  };
 
-  if (!node->has_polygon) {
-    vector<shared_ptr<CollisionSP>> cols = GetCollisionsSPAux(node->lft, obj1, obj2);
-    vector<shared_ptr<CollisionSP>> rgt_cols = GetCollisionsSPAux(node->rgt, obj1, obj2);
-    cols.insert(cols.end(), rgt_cols.begin(), rgt_cols.end());
-    return cols;
+  if (obj2->bvh) {
+    find_polygons(obj2->bvh);
+    return;
   }
 
-  return { make_shared<CollisionSP>(obj1, obj2, node->polygon) };
+  if (!obj2->asset_group) return;
+  for (shared_ptr<GameAsset> asset : obj2->asset_group->assets) {
+    if (asset) find_polygons(asset->bvh);
+  }
 }
 
+// Sphere - Perfect.
 vector<shared_ptr<CollisionSP>> GetCollisionsSP(ObjPtr obj1, ObjPtr obj2) {
   vector<shared_ptr<CollisionSP>> cols;
-
-  if (obj2->aabb_tree) {
-    cols = GetCollisionsSPAux(obj2->aabb_tree, obj1, obj2);
-  } else {
-    if (!obj2->asset_group) return {};
-    for (int i = 0; i < obj2->asset_group->assets.size(); i++) {
-      shared_ptr<GameAsset> asset = obj2->asset_group->assets[i];
-      if (!asset) continue;
-      vector<shared_ptr<CollisionSP>> aux = 
-        GetCollisionsSPAux(asset->aabb_tree, obj1, obj2);
-      cols.insert(cols.end(), aux.begin(), aux.end());
-    }
-  }
+  ForEachPerfectPolygon(obj2, obj1->GetTransformedBoundingSphere(),
+    [&] (const Polygon& polygon) {
+      cols.push_back(NewCollision<CollisionSP>(obj1, obj2, polygon));
+    });
   return cols;
 }
 
@@ -555,7 +643,7 @@ vector<shared_ptr<CollisionST>> GetCollisionsST(ObjPtr obj1,
   shared_ptr<Resources> resources, bool in_dungeon) {
   vector<shared_ptr<CollisionST>> cols;
   if (in_dungeon) {
-    cols.push_back(make_shared<CollisionST>(obj1, Polygon()));
+    cols.push_back(NewCollision<CollisionST>(obj1, Polygon()));
     return cols;
   } 
 
@@ -564,7 +652,7 @@ vector<shared_ptr<CollisionST>> GetCollisionsST(ObjPtr obj1,
     polygons);
 
   for (const auto& polygon : polygons) {
-    cols.push_back(make_shared<CollisionST>(obj1, polygon));
+    cols.push_back(NewCollision<CollisionST>(obj1, polygon));
   }
   return cols;
 }
@@ -578,7 +666,7 @@ vector<shared_ptr<CollisionSO>> GetCollisionsSO(ObjPtr obj1, ObjPtr obj2) {
     return {};
   }
 
-  return { make_shared<CollisionSO>(obj1, obj2) };
+  return { NewCollision<CollisionSO>(obj1, obj2) };
 }
 
 // Bones - Bones.
@@ -595,7 +683,7 @@ vector<shared_ptr<CollisionBB>> GetCollisionsBB(ObjPtr obj1, ObjPtr obj2) {
     if (!bone1.collidable) continue;
     for (const auto& [bone_id_2, bone2] : obj2->bones) {
       if (!bone2.collidable) continue;
-      collisions.push_back(make_shared<CollisionBB>(obj1, obj2, bone_id_1, 
+      collisions.push_back(NewCollision<CollisionBB>(obj1, obj2, bone_id_1, 
         bone_id_2));
     }
   }
@@ -603,50 +691,18 @@ vector<shared_ptr<CollisionBB>> GetCollisionsBB(ObjPtr obj1, ObjPtr obj2) {
 }
 
 // Bones - Perfect.
-vector<shared_ptr<CollisionBP>> GetCollisionsBPAux(
-  shared_ptr<AABBTreeNode> node, ObjPtr obj1, ObjPtr obj2) {
-  if (!node) {
-    return {};
-  }
-
-  BoundingSphere s = obj1->GetTransformedBoundingSphere();
-  if (!TestSphereAABB(s, node->aabb + obj2->position)) return {};
-
-  if (!node->has_polygon) {
-    vector<shared_ptr<CollisionBP>> cols = GetCollisionsBPAux(node->lft, obj1, obj2);
-    vector<shared_ptr<CollisionBP>> rgt_cols = GetCollisionsBPAux(node->rgt, obj1, obj2);
-    cols.insert(cols.end(), rgt_cols.begin(), rgt_cols.end());
-    return cols;
-  }
-
+vector<shared_ptr<CollisionBP>> GetCollisionsBP(ObjPtr obj1, ObjPtr obj2) {
   vector<shared_ptr<CollisionBP>> cols;
-  for (const auto& [bone_id, bone] : obj1->bones) {
-    if (!bone.collidable) continue;
-    cols.push_back(make_shared<CollisionBP>(obj1, obj2, bone_id, node->polygon));
-  }
+  ForEachPerfectPolygon(obj2, obj1->GetTransformedBoundingSphere(),
+    [&] (const Polygon& polygon) {
+      for (const auto& [bone_id, bone] : obj1->bones) {
+        if (!bone.collidable) continue;
+        cols.push_back(NewCollision<CollisionBP>(obj1, obj2, bone_id, polygon));
+      }
+    });
   return cols;
 }
 
-vector<shared_ptr<CollisionBP>> GetCollisionsBP(ObjPtr obj1, ObjPtr obj2) {
-  vector<shared_ptr<CollisionBP>> collisions;
-
-  if (obj2->aabb_tree) {
-    vector<shared_ptr<CollisionBP>> cols = 
-      GetCollisionsBPAux(obj2->aabb_tree, obj1, obj2);
-    collisions.insert(collisions.end(), cols.begin(), cols.end());
-  } else {
-    if (!obj2->asset_group) return {};
-    for (int i = 0; i < obj2->asset_group->assets.size(); i++) {
-      shared_ptr<GameAsset> asset = obj2->asset_group->assets[i];
-      if (!asset) continue;
-      vector<shared_ptr<CollisionBP>> tmp_cols = 
-        GetCollisionsBPAux(asset->aabb_tree, obj1, obj2);
-      collisions.insert(collisions.end(), tmp_cols.begin(), tmp_cols.end());
-    }
-  }
-  return collisions;
-}
-
 // Bones - OBB.
 vector<shared_ptr<CollisionBO>> GetCollisionsBO(ObjPtr obj1, ObjPtr obj2) {
   BoundingSphere s1 = obj1->GetTransformedBoundingSphere();
@@ -660,7 +716,7 @@ vector<shared_ptr<CollisionBO>> GetCollisionsBO(ObjPtr obj1, ObjPtr obj2) {
   vector<shared_ptr<CollisionBO>> cols;
   for (const auto& [bone_id, bone] : obj1->bones) {
     if (!bone.collidable) continue;
-    cols.push_back(make_shared<CollisionBO>(obj1, obj2, bone_id));
+    cols.push_back(NewCollision<CollisionBO>(obj1, obj2, bone_id));
   }
   return cols;
 }
@@ -672,7 +728,7 @@ vector<shared_ptr<CollisionBT>> GetCollisionsBT(ObjPtr obj1,
     vector<shared_ptr<CollisionBT>> cols;
     for (const auto& [bone_id, bone] : obj1->bones) {
       if (!bone.collidable) continue;
-      cols.push_back(make_shared<CollisionBT>(obj1, bone_id, Polygon()));
+      cols.push_back(NewCollision<CollisionBT>(obj1, bone_id, Polygon()));
     }
     return cols;
   }
@@ -692,7 +748,7 @@ vector<shared_ptr<CollisionBT>> GetCollisionsBT(ObjPtr obj1,
   for (const auto& polygon : polygons) {
     for (const auto& [bone_id, bone] : obj1->bones) {
       if (!bone.collidable) continue;
-      cols.push_back(make_shared<CollisionBT>(obj1, bone_id, polygon));
+      cols.push_back(NewCollision<CollisionBT>(obj1, bone_id, polygon));
     }
     break;
   }
@@ -712,50 +768,21 @@ vector<shared_ptr<CollisionQS>> GetCollisionsQS(ObjPtr obj1, ObjPtr obj2) {
     return {};
   }
 
-  return { make_shared<CollisionQS>(obj1, obj2) };
+  return { NewCollision<CollisionQS>(obj1, obj2) };
 }
 
 // Quick Sphere - Perfect.
-vector<shared_ptr<CollisionQP>> GetCollisionsQPAux(shared_ptr<AABBTreeNode> node, 
-  const BoundingSphere& s, ObjPtr obj1, ObjPtr obj2) {
-  if (!node) {
-    return {};
-  }
-
-  // TODO: moving sphere against AABB.
-  if (!TestSphereAABB(s, node->aabb + obj2->position)) {
-    return {};
-  }
-
-  if (!node->has_polygon) {
-    vector<shared_ptr<CollisionQP>> cols = GetCollisionsQPAux(node->lft, s, obj1, obj2);
-    vector<shared_ptr<CollisionQP>> rgt_cols = GetCollisionsQPAux(node->rgt, s, obj1, obj2);
-    cols.insert(cols.end(), rgt_cols.begin(), rgt_cols.end());
-    return cols;
-  }
-
-  return { make_shared<CollisionQP>(obj1, obj2, node->polygon) };
-}
-
 vector<shared_ptr<CollisionQP>> GetCollisionsQP(ObjPtr obj1, ObjPtr obj2) {
   BoundingSphere s;
   s.center = obj1->prev_position + 0.5f*(obj1->position - obj1->prev_position);
   s.radius = 0.5f * length(obj1->prev_position - obj1->position) + 
     obj1->GetBoundingSphere().radius;
 
+  // TODO: moving sphere against AABB.
   vector<shared_ptr<CollisionQP>> cols;
-  if (obj2->aabb_tree) {
-    cols = GetCollisionsQPAux(obj2->aabb_tree, s, obj1, obj2);
-  } else {  
-    if (!obj2->asset_group) return {};
-    for (int i = 0; i < obj2->asset_group->assets.size(); i++) {
-      shared_ptr<GameAsset> asset = obj2->asset_group->assets[i];
-      if (!asset) continue;
-      vector<shared_ptr<CollisionQP>> aux = 
-        GetCollisionsQPAux(asset->aabb_tree, s, obj1, obj2);
-      cols.insert(cols.end(), aux.begin(), aux.end());
-    }
-  }
+  ForEachPerfectPolygon(obj2, s, [&] (const Polygon& polygon) {
+    cols.push_back(NewCollision<CollisionQP>(obj1, obj2, polygon));
+  });
   return cols;
 }
 
@@ -777,12 +804,12 @@ vector<shared_ptr<CollisionQB>> GetCollisionsQB(ObjPtr obj1, ObjPtr obj2) {
   if (obj2->asset_group != nullptr && obj2->GetAsset()->name == "red_metal_eye") {
     for (const auto& [bone_id, bone] : obj2->bones) {
       if (bone.name == "muzzle_bone") {
-        collisions.push_back(make_shared<CollisionQB>(obj1, obj2, bone_id));
+        collisions.push_back(NewCollision<CollisionQB>(obj1, obj2, bone_id));
       }
     }
     for (const auto& [bone_id, bone] : obj2->bones) {
       if (bone.name != "muzzle_bone") {
-        collisions.push_back(make_shared<CollisionQB>(obj1, obj2, bone_id));
+        collisions.push_back(NewCollision<CollisionQB>(obj1, obj2, bone_id));
       }
     }
   } else if (obj2->asset_group != nullptr && obj2->GetAsset()->name == "broodmother_body") {
@@ -790,20 +817,20 @@ vector<shared_ptr<CollisionQB>> GetCollisionsQB(ObjPtr obj1, ObjPtr obj2) {
       if (bone.name == "ball1" ||
           bone.name == "ball2" ||
           bone.name == "ball3") {
-        collisions.push_back(make_shared<CollisionQB>(obj1, obj2, bone_id));
+        collisions.push_back(NewCollision<CollisionQB>(obj1, obj2, bone_id));
       }
     }
     for (const auto& [bone_id, bone] : obj2->bones) {
       if (bone.name != "ball1" &&
           bone.name != "ball2" &&
           bone.name != "ball3") {
-        collisions.push_back(make_shared<CollisionQB>(obj1, obj2, bone_id));
+        collisions.push_back(NewCollision<CollisionQB>(obj1, obj2, bone_id));
       }
     }
   } else {
     for (const auto& [bone_id, bone] : obj2->bones) {
       if (!bone.collidable) continue;
-      collisions.push_back(make_shared<CollisionQB>(obj1, obj2, bone_id));
+      collisions.push_back(NewCollision<CollisionQB>(obj1, obj2, bone_id));
     }
   }
   return collisions;
@@ -811,7 +838,7 @@ vector<shared_ptr<CollisionQB>> GetCollisionsQB(ObjPtr obj1, ObjPtr obj2) {
 
 // Quick Sphere - Terrain.
 vector<shared_ptr<CollisionQT>> GetCollisionsQT(ObjPtr obj1) {
-  return { make_shared<CollisionQT>(obj1) };
+  return { NewCollision<CollisionQT>(obj1) };
 }
 
 vector<shared_ptr<CollisionQO>> GetCollisionsQO(ObjPtr obj1, ObjPtr obj2) {
@@ -826,53 +853,25 @@ vector<shared_ptr<CollisionQO>> GetCollisionsQO(ObjPtr obj1, ObjPtr obj2) {
     return {};
   }
 
-  return { make_shared<CollisionQO>(obj1, obj2) };
+  return { NewCollision<CollisionQO>(obj1, obj2) };
 }
 
 // OBB - Perfect.
-vector<shared_ptr<CollisionOP>> GetCollisionsOPAux(shared_ptr<AABBTreeNode> node, ObjPtr obj1, 
-  ObjPtr obj2) {
-  if (!node) {
-    return {};
-  }
-
-  BoundingSphere s = obj1->GetTransformedBoundingSphere();
-  if (!TestSphereAABB(s, node->aabb + obj2->position)) return {};
-
-  if (!node->has_polygon) {
-    vector<shared_ptr<CollisionOP>> cols = GetCollisionsOPAux(node->lft, obj1, obj2);
-    vector<shared_ptr<CollisionOP>> rgt_cols = GetCollisionsOPAux(node->rgt, obj1, obj2);
-    cols.insert(cols.end(), rgt_cols.begin(), rgt_cols.end());
-    return cols;
-  }
-
-  return { make_shared<CollisionOP>(obj1, obj2, node->polygon) };
-}
-
 vector<shared_ptr<CollisionOP>> GetCollisionsOP(ObjPtr obj1, ObjPtr obj2) {
   vector<shared_ptr<CollisionOP>> cols;
-
-  if (obj2->aabb_tree) {
-    cols = GetCollisionsOPAux(obj2->aabb_tree, obj1, obj2);
-  } else {
-    if (!obj2->asset_group) return {};
-    for (int i = 0; i < obj2->asset_group->assets.size(); i++) {
-      shared_ptr<GameAsset> asset = obj2->asset_group->assets[i];
-      if (!asset) continue;
-      vector<shared_ptr<CollisionOP>> aux = 
-        GetCollisionsOPAux(asset->aabb_tree, obj1, obj2);
-      cols.insert(cols.end(), aux.begin(), aux.end());
-    }
-  }
+  ForEachPerfectPolygon(obj2, obj1->GetTransformedBoundingSphere(),
+    [&] (const Polygon& polygon) {
+      cols.push_back(NewCollision<CollisionOP>(obj1, obj2, polygon));
+    });
   return cols;
 }
 
 vector<shared_ptr<CollisionOT>> GetCollisionsOT(ObjPtr obj1, 
   shared_ptr<Resources> resources, bool in_dungeon) {
   if (in_dungeon) {
-    return { make_shared<CollisionOT>(obj1, Polygon()) };
+    return { NewCollision<CollisionOT>(obj1, Polygon()) };
   }
-  // return { make_shared<CollisionOT>(obj1, Polygon()) };
+  // return { NewCollision<CollisionOT>(obj1, Polygon()) };
 
   vector<Polygon> polygons;
   GetTerrainPolygons(resources, vec2(obj1->position.x, obj1->position.z), 
@@ -880,7 +879,7 @@ vector<shared_ptr<CollisionOT>> GetCollisionsOT(ObjPtr obj1,
 
   vector<shared_ptr<CollisionOT>> cols;
   for (const auto& polygon : polygons) {
-    cols.push_back(make_shared<CollisionOT>(obj1, polygon));
+    cols.push_back(NewCollision<CollisionOT>(obj1, polygon));
   }
   return cols;
 }
@@ -894,7 +893,7 @@ vector<shared_ptr<CollisionOO>> GetCollisionsOO(ObjPtr obj1, ObjPtr obj2) {
     return {};
   }
 
-  return { make_shared<CollisionOO>(obj1, obj2) };
+  return { NewCollision<CollisionOO>(obj1, obj2) };
 }
 
 void CollisionResolver::FindCollisionsWithTerrain(
@@ -939,19 +938,19 @@ void CollisionResolver::FindCollisionsWithDungeon(
         for (const auto& [bone_id, bone] : obj1->bones) {
           if (bone.name != "muzzle_bone") {
             if (!bone.collidable) continue;
-            collisions.push_back(make_shared<CollisionBA>(obj1, aabb, bone_id));
+            collisions.push_back(NewCollision<CollisionBA>(obj1, aabb, bone_id));
           }
         }
       } else {
         for (const auto& [bone_id, bone] : obj1->bones) {
           if (!bone.collidable) continue;
-          collisions.push_back(make_shared<CollisionBA>(obj1, aabb, bone_id));
+          collisions.push_back(NewCollision<CollisionBA>(obj1, aabb, bone_id));
         }
       }
     } else if (obj1->GetCollisionType() == COL_QUICK_SPHERE) {
-      collisions.push_back(make_shared<CollisionQA>(obj1, aabb));
+      collisions.push_back(NewCollision<CollisionQA>(obj1, aabb));
     } else if (obj1->GetCollisionType() == COL_OBB) {
-      collisions.push_back(make_shared<CollisionOA>(obj1, aabb));
+      collisions.push_back(NewCollision<CollisionOA>(obj1, aabb));
     }
     return;
   }
@@ -990,12 +989,12 @@ void CollisionResolver::FindCollisionsWithDungeon(
       if (obj1->GetCollisionType() == COL_BONES) {
         for (const auto& [bone_id, bone] : obj1->bones) {
           if (!bone.collidable) continue;
-          collisions.push_back(make_shared<CollisionBA>(obj1, aabb, bone_id));
+          collisions.push_back(NewCollision<CollisionBA>(obj1, aabb, bone_id));
         }
       } else if (obj1->GetCollisionType() == COL_QUICK_SPHERE) {
-        collisions.push_back(make_shared<CollisionQA>(obj1, aabb));
+        collisions.push_back(NewCollision<CollisionQA>(obj1, aabb));
       } else if (obj1->GetCollisionType() == COL_OBB) {
-        collisions.push_back(make_shared<CollisionOA>(obj1, aabb));
+        collisions.push_back(NewCollision<CollisionOA>(obj1, aabb));
       }
     }
   }
@@ -1088,7 +1087,8 @@ void FillCollisionBlankFields(ColPtr c) {
   }
 }
 
-void CollisionResolver::TestCollisionsWithTerrain() {
+void CollisionResolver::TestCollisionsWithTerrain(
+  CollisionBuffer& buffer) {
   vector<ColPtr> collisions;
 
   Dungeon& dungeon = resources_->GetDungeon();
@@ -1112,15 +1112,14 @@ void CollisionResolver::TestCollisionsWithTerrain() {
   for (auto& c : collisions) {
     TestCollision(c);
     if (c->collided) {
-      find_mutex_.lock();
-      collisions_.push(c);
+      buffer.collisions.push_back(c);
       c->obj1->touching_the_ground = true;
-      find_mutex_.unlock();
     }
   }
 }
 
-void CollisionResolver::TestCollisionsWithDungeon() {
+void CollisionResolver::TestCollisionsWithDungeon(
+  CollisionBuffer& buffer) {
   Dungeon& dungeon = resources_->GetDungeon();
 
   shared_ptr<Player> player = resources_->GetPlayer();
@@ -1158,19 +1157,19 @@ void CollisionResolver::TestCollisionsWithDungeon() {
             for (const auto& [bone_id, bone] : obj1->bones) {
               if (bone.name != "muzzle_bone") {
                 if (!bone.collidable) continue;
-                collisions.push_back(make_shared<CollisionBA>(obj1, aabb, bone_id));
+                collisions.push_back(NewCollision<CollisionBA>(obj1, aabb, bone_id));
               }
             }
           } else {
             for (const auto& [bone_id, bone] : obj1->bones) {
               if (!bone.collidable) continue;
-              collisions.push_back(make_shared<CollisionBA>(obj1, aabb, bone_id));
+              collisions.push_back(NewCollision<CollisionBA>(obj1, aabb, bone_id));
             }
           }
         } else if (obj1->GetCollisionType() == COL_QUICK_SPHERE) {
-          collisions.push_back(make_shared<CollisionQA>(obj1, aabb));
+          collisions.push_back(NewCollision<CollisionQA>(obj1, aabb));
         } else if (obj1->GetCollisionType() == COL_OBB) {
-          collisions.push_back(make_shared<CollisionOA>(obj1, aabb));
+          collisions.push_back(NewCollision<CollisionOA>(obj1, aabb));
         }
       }
     }
@@ -1180,9 +1179,7 @@ void CollisionResolver::TestCollisionsWithDungeon() {
   for (auto& c : collisions) {
     TestCollision(c);
     if (c->collided) {
-      find_mutex_.lock();
-      collisions_.push(c);
-      find_mutex_.unlock();
+      buffer.collisions.push_back(c);
     }
   }
 }
@@ -1468,6 +1465,7 @@ void CollisionResolver::TestCollisionBT(shared_ptr<CollisionBT> c) {
   }
 
   static vector<vec2> sample_offsets {
+    { 0, 0 },
     { 2, -2 },
     { -2, 2 },
     { 2, 2 },
@@ -1475,17 +1473,22 @@ void CollisionResolver::TestCollisionBT(shared_ptr<CollisionBT> c) {
   };
 
   vec2 obj1_pos = vec2(c->obj1->position.x, c->obj1->position.z);
-  float h = resources_->GetHeightMap().GetTerrainHeight(
-    obj1_pos, &normal);
+  vector<vec2> positions;
+  for (const vec2& offset : sample_offsets) {
+    positions.push_back(obj1_pos + offset);
+  }
 
-  vec3 avg_normal = normal * 0.2f;
-  for (int i = 0; i < 4; i++) {
-    h += resources_->GetHeightMap().GetTerrainHeight(
-      obj1_pos + sample_offsets[i], &normal);
-    avg_normal += normal * 0.2f;
+  vector<float> heights;
+  vector<vec3> normals;
+  resources_->GetHeightMap().GetTerrainHeights(positions, heights, &normals);
+
+  float h = 0.0f;
+  normal = vec3(0);
+  for (int i = 0; i < 5; i++) {
+    h += heights[i];
+    normal += normals[i] * 0.2f;
   }
   h *= 0.2f;
-  normal = avg_normal;
 
   if (c->obj1->position.y < h - 10) {
     c->collided = true;
@@ -1589,7 +1592,12 @@ void CollisionResolver::TestCollisionQT(shared_ptr<CollisionQT> c) {
     return;
   }
 
-  float h = resources_->GetHeightMap().GetTerrainHeight(vec2(s.center.x, s.center.z), &c->normal);
+  // Spheres above the highest point of their tile cannot touch it.
+  HeightMap& height_map = resources_->GetHeightMap();
+  vec2 pos = vec2(s.center.x, s.center.z);
+  if (s.center.y - s.radius > height_map.GetMaxTerrainHeight(pos)) return;
+
+  float h = height_map.GetTerrainHeight(pos, &c->normal);
   if ((s.center.y - s.radius) < h) {
     c->displacement_vector = vec3(0, h - (s.center.y - s.radius), 0);
     c->point_of_contact = s.center;
@@ -2229,11 +2237,6 @@ void CollisionResolver::ProcessInContactWith() {
     }
     if (!obj->IsPlayer()) continue;
 
-    auto& [obj1, obj2] = tentative_pairs_.front();
-    tentative_pairs_.pop();
-    running_test_tasks_++;
-    find_mutex_.unlock();
-
     float inertia = 1.0f;
     // float inertia = 1.0f / obj->in_contact_with->GetMass();
     mat4 rotation_matrix = rotate(
@@ -2241,10 +2244,6 @@ void CollisionResolver::ProcessInContactWith() {
       length(obj->in_contact_with->torque) * inertia,
       normalize(obj->in_contact_with->torque)
     );
-
-    find_mutex_.lock();
-    running_test_tasks_--;
-    find_mutex_.unlock();
   }
 }
 
@@ -2422,7 +2421,7 @@ void CollisionResolver::CreatePillarOnCollision(ColPtr c) {
   if (!displacing_obj->CanUseAbility("pillar")) return;
   if (!displaced_obj->IsCreature()) return;
 
-  displacing_obj->cooldowns["pillar"] = glfwGetTime() + 5;
+  displacing_obj->cooldowns["pillar"] = GetTime() + 5;
 
   resources_->CastMagicPillar(displacing_obj);
 }
@@ -2469,7 +2468,7 @@ void CollisionResolver::FrogJump(ColPtr c) {
   displaced_obj->DealDamage(displacing_obj, 1.0f, -v, 
     /*take_hit_animation=*/false);
 
-  displacing_obj->cooldowns["frog-jump-dmg"] = glfwGetTime() + 2;
+  displacing_obj->cooldowns["frog-jump-dmg"] = GetTime() + 2;
 }
 
 void CollisionResolver::WhiteSpineTrample(ColPtr c) {
@@ -2498,7 +2497,7 @@ void CollisionResolver::WhiteSpineTrample(ColPtr c) {
   displaced_obj->DealDamage(displacing_obj, 1.0f, -v, 
     /*take_hit_animation=*/false);
 
-  displacing_obj->cooldowns["trample-dmg"] = glfwGetTime() + 2;
+  displacing_obj->cooldowns["trample-dmg"] = GetTime() + 2;
 }
 
 void CollisionResolver::BeholderEyeCollision(ColPtr c) {
@@ -2547,7 +2546,7 @@ void CollisionResolver::BeholderEyeCollision(ColPtr c) {
   displaced_obj->DealDamage(displacing_obj, 1.0f, -v, 
     /*take_hit_animation=*/false);
 
-  displacing_obj->cooldowns["trample-dmg"] = glfwGetTime() + 2;
+  displacing_obj->cooldowns["trample-dmg"] = GetTime() + 2;
 }
 
 void CollisionResolver::ResolveCollisions() {
@@ -2602,53 +2601,3 @@ void CollisionResolver::ResolveCollisions() {
   }   
 }
 
-void CollisionResolver::FindCollisionsAsync() {
-  while (!terminate_) {
-    find_mutex_.lock();
-    if (find_tasks_.empty()) {
-      find_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(1));
-      continue;
-    }
-
-    shared_ptr<OctreeNode> node = find_tasks_.front();
-    find_tasks_.pop();
-    running_find_tasks_++;
-    find_mutex_.unlock();
-
-    FindCollisions(node);
-
-    find_mutex_.lock();
-    running_find_tasks_--;
-    find_mutex_.unlock();
-  }
-}
-
-void CollisionResolver::ProcessTentativePairAsync() {
-  while (!terminate_) {
-    find_mutex_.lock();
-    if (tentative_pairs_.empty()) {
-      find_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(1));
-      continue;
-    }
-
-    auto& [obj1, obj2] = tentative_pairs_.front();
-    tentative_pairs_.pop();
-    running_test_tasks_++;
-    find_mutex_.unlock();
-
-    ProcessTentativePair(obj1, obj2);
-
-    find_mutex_.lock();
-    running_test_tasks_--;
-    find_mutex_.unlock();
-  }
-}
-
-void CollisionResolver::CreateThreads() {
-  for (int i = 0; i < kMaxThreads; i++) {
-    find_threads_.push_back(thread(&CollisionResolver::FindCollisionsAsync, this));
-    test_threads_.push_back(thread(&CollisionResolver::ProcessTentativePairAsync, this));
-  }
-}
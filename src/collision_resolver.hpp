@@ -2,6 +2,9 @@
 #define __COLLISION_RESOLVER_HPP__
 
 #include "resources.hpp"
+#include "job_system.hpp"
+#include "sweep_and_prune.hpp"
+#include "frame_arena.hpp"
 
 #include <thread>
 #include <mutex>
@@ -291,26 +294,45 @@ class CollisionResolver {
   int num_objects_tested_ = 0;
   int perfect_collision_tests_ = 0;
 
-  // Parallelism.
-  bool terminate_ = false;
-  const int kMaxThreads = 16;
-  vector<thread> find_threads_;
-  vector<thread> test_threads_;
+  // Broadphase. Static objects are reinserted when the octree is regenerated,
+  // moving objects are updated every frame.
+  struct BroadphaseProxy {
+    ObjPtr obj;
+    int handle;
+    bool is_static;
 
-  int running_find_tasks_ = 0;
-  int running_test_tasks_ = 0;
-  queue<shared_ptr<OctreeNode>> find_tasks_;
+    // Last frame (static objects version for static objects) in which the
+    // object was seen.
+    int frame;
+  };
+  SweepAndPrune broadphase_;
+  unordered_map<int, BroadphaseProxy> broadphase_proxies_;
+  vector<pair<int, int>> broadphase_pairs_;
+  int static_objects_version_ = -1;
+  int broadphase_frame_ = 0;
+
+  // Collision records and the collisions found by a job go to a buffer that
+  // the job owns while it runs, so jobs neither lock nor hit the heap per
+  // collision. Buffers are merged into collisions_ once per frame and reset
+  // at the start of the next Collide.
+  struct CollisionBuffer {
+    FrameArena arena;
+    vector<ColPtr> collisions;
+    size_t max_collisions = 0;
+  };
+  vector<unique_ptr<CollisionBuffer>> collision_buffers_;
+  vector<CollisionBuffer*> free_collision_buffers_;
+  mutex collision_buffers_mutex_;
 
-  mutex test_mutex_;
-  mutex find_mutex_;
-  queue<tuple<ObjPtr, ObjPtr>> tentative_pairs_;
+  // Parallelism.
+  shared_ptr<JobSystem> job_system_;
+  shared_ptr<JobCounter> collide_jobs_;
 
   void ClearMetrics();
   void PrintMetrics();
 
   // Aux methods.
   bool IsPairCollidable(ObjPtr obj1, ObjPtr obj2);
-  void CollideAlongAxis(shared_ptr<OctreeNode> octree_node, ObjPtr obj);
 
   void TestCollisionSS(shared_ptr<CollisionSS> c);
   void TestCollisionSB(shared_ptr<CollisionSB> c);
@@ -360,10 +382,12 @@ class CollisionResolver {
   vector<ColPtr> CollideObjects(ObjPtr obj1, ObjPtr obj2);
 
   void UpdateObjectPositions();
-  void FindCollisions(shared_ptr<OctreeNode> octree_node);
+  void UpdateStaticProxies();
+  void UpdateMovingProxies();
+  void FindCollisions();
 
-  void TestCollisionsWithDungeon();
-  void TestCollisionsWithTerrain();
+  void TestCollisionsWithDungeon(CollisionBuffer& buffer);
+  void TestCollisionsWithTerrain(CollisionBuffer& buffer);
   void FindCollisionsWithTerrain(vector<ColPtr>& collisions, ObjPtr obj);
   void FindCollisionsWithDungeon(vector<ColPtr>& collisions, ObjPtr obj);
   void ResolveMissileCollision(ColPtr c);
@@ -371,11 +395,17 @@ class CollisionResolver {
   void ResolveCollisions();
   void ProcessInContactWith();
 
-  void ProcessTentativePair(ObjPtr obj1, ObjPtr obj2);
+  CollisionBuffer* AcquireCollisionBuffer();
+  void ReleaseCollisionBuffer(CollisionBuffer* buffer);
+  void ResetCollisionBuffers();
+  void MergeCollisionBuffers();
+
+  // Calls fn(i, buffer) for i in [0, n) in collide jobs.
+  void RunCollisionJobs(int n, int batch_size,
+    function<void(int, CollisionBuffer&)> fn);
+  void ProcessTentativePair(ObjPtr obj1, ObjPtr obj2,
+    CollisionBuffer& buffer);
 
-  void FindCollisionsAsync();
-  void ProcessTentativePairAsync();
-  void CreateThreads();
   void ApplyTorque(ColPtr c);
   void ApplyImpulse(ColPtr c);
   void ResolveCollisionWithFixedObject(ColPtr c);
@@ -0,0 +1,342 @@
+#include "compressed_animation.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// The three smallest components of a unit quaternion are within
+// [-sqrt(1/2), sqrt(1/2)].
+const float kQuatRange = 0.70710678f;
+const int kQuatMax = (1 << 15) - 1;
+const int kMaxFrames = 65535;
+
+void Decompose(const mat4& m, vec3& translation, quat& rotation,
+  vec3& scale) {
+  translation = vec3(m[3].x, m[3].y, m[3].z);
+  vec3 axes[3];
+  for (int i = 0; i < 3; i++) {
+    axes[i] = vec3(m[i].x, m[i].y, m[i].z);
+    scale[i] = length(axes[i]);
+  }
+  if (dot(cross(axes[0], axes[1]), axes[2]) < 0.0f) scale.x = -scale.x;
+
+  mat3 rotation_matrix;
+  for (int i = 0; i < 3; i++) {
+    rotation_matrix[i] = (abs(scale[i]) > 1e-8f) ? axes[i] / scale[i] :
+      vec3(i == 0, i == 1, i == 2);
+  }
+  rotation = normalize(quat_cast(rotation_matrix));
+}
+
+mat4 Compose(const vec3& translation, const quat& rotation,
+  const vec3& scale) {
+  mat4 m = mat4_cast(rotation);
+  m[0] = m[0] * scale.x;
+  m[1] = m[1] * scale.y;
+  m[2] = m[2] * scale.z;
+  m[3] = vec4(translation, 1.0f);
+  return m;
+}
+
+float GetMaxDifference(const mat4& a, const mat4& b) {
+  float d = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 3; j++) d = std::max(d, abs(a[i][j] - b[i][j]));
+  }
+  return d;
+}
+
+vec3 Lerp(const vec3& a, const vec3& b, float t) {
+  return a + (b - a) * t;
+}
+
+quat Nlerp(const quat& a, quat b, float t) {
+  if (dot(a, b) < 0.0f) b = -b;
+  return normalize(a * (1.0f - t) + b * t);
+}
+
+float GetDistance(const vec3& a, const vec3& b) {
+  return length(a - b);
+}
+
+float GetAngle(const quat& a, const quat& b) {
+  double d = std::min(1.0, std::abs(double(dot(a, b))));
+  return float(2.0 * acos(d));
+}
+
+// Returns the frames to keep so that interpolating between them stays
+// within the tolerance of the original values. The kept values may differ
+// from the original ones, like quantized rotations.
+template <class T, class LerpFn, class ErrorFn>
+vector<int> ReduceKeys(const vector<T>& values, const vector<T>& original,
+  float tolerance, LerpFn lerp, ErrorFn error) {
+  int n = values.size();
+  bool constant = true;
+  for (int k = 0; k < n && constant; k++) {
+    constant = error(values[0], original[k]) <= tolerance;
+  }
+  if (constant) return { 0 };
+
+  vector<int> keys { 0 };
+  int last = 0;
+  for (int j = 2; j < n; j++) {
+    for (int k = last + 1; k < j; k++) {
+      float t = float(k - last) / (j - last);
+      if (error(lerp(values[last], values[j], t), original[k]) > tolerance) {
+        keys.push_back(j - 1);
+        last = j - 1;
+        break;
+      }
+    }
+  }
+  keys.push_back(n - 1);
+  return keys;
+}
+
+// Index of the key before the frame, so that frame is between keys i and
+// i + 1, and the interpolation factor between them.
+int FindKey(const uint16_t* frames, int num_keys, float frame, float& t) {
+  int i = std::upper_bound(frames, frames + num_keys, frame) - frames - 1;
+  i = std::max(0, std::min(i, num_keys - 2));
+  t = (frame - frames[i]) / float(frames[i + 1] - frames[i]);
+  t = std::max(0.0f, std::min(t, 1.0f));
+  return i;
+}
+
+} // namespace
+
+QuantizedQuat QuantizeQuat(const quat& q) {
+  float c[4] = { q.x, q.y, q.z, q.w };
+  int largest = 0;
+  for (int i = 1; i < 4; i++) {
+    if (abs(c[i]) > abs(c[largest])) largest = i;
+  }
+
+  // q and -q are the same rotation, so the largest can be positive.
+  float sign = (c[largest] < 0.0f) ? -1.0f : 1.0f;
+  uint64_t bits = largest;
+  int shift = 2;
+  for (int i = 0; i < 4; i++) {
+    if (i == largest) continue;
+    float v = std::max(-kQuatRange, std::min(c[i] * sign, kQuatRange));
+    uint64_t n = uint64_t(round((v / kQuatRange * 0.5f + 0.5f) * kQuatMax));
+    bits |= n << shift;
+    shift += 15;
+  }
+
+  QuantizedQuat result;
+  for (int i = 0; i < 3; i++) {
+    result.bits[i] = (bits >> (16 * i)) & 0xffff;
+  }
+  return result;
+}
+
+quat DequantizeQuat(const QuantizedQuat& q) {
+  uint64_t bits = uint64_t(q.bits[0]) | (uint64_t(q.bits[1]) << 16) |
+    (uint64_t(q.bits[2]) << 32);
+  int largest = bits & 3;
+  int shift = 2;
+  float c[4];
+  float sum = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    if (i == largest) continue;
+    float n = float((bits >> shift) & kQuatMax);
+    c[i] = (n / kQuatMax * 2.0f - 1.0f) * kQuatRange;
+    sum += c[i] * c[i];
+    shift += 15;
+  }
+  c[largest] = sqrt(std::max(0.0f, 1.0f - sum));
+  return normalize(quat(c[3], c[0], c[1], c[2]));
+}
+
+CompressedAnimation::CompressedAnimation(const Animation& animation,
+  const AnimationCompressionParams& params) {
+  num_frames_ = animation.keyframes.size();
+  if (num_frames_ > kMaxFrames) {
+    throw runtime_error("Animation " + animation.name + " has too many " +
+      "frames to compress");
+  }
+
+  int num_joints = 0;
+  for (const Keyframe& keyframe : animation.keyframes) {
+    num_joints = std::max(num_joints, int(keyframe.transforms.size()));
+  }
+  joints_.resize(num_joints);
+
+  for (int joint = 0; joint < num_joints; joint++) {
+    vector<mat4> matrices(num_frames_);
+    vector<vec3> translations(num_frames_), scales(num_frames_);
+    vector<quat> rotations(num_frames_), quantized_rotations(num_frames_);
+    float decomposition_error = 0.0f;
+    for (int frame = 0; frame < num_frames_; frame++) {
+      const vector<mat4>& transforms = animation.keyframes[frame].transforms;
+      mat4& m = matrices[frame];
+      m = (size_t(joint) < transforms.size()) ? transforms[joint] :
+        mat4(1.0f);
+      Decompose(m, translations[frame], rotations[frame], scales[frame]);
+      quantized_rotations[frame] =
+        DequantizeQuat(QuantizeQuat(rotations[frame]));
+      decomposition_error = std::max(decomposition_error, GetMaxDifference(
+        m, Compose(translations[frame], rotations[frame], scales[frame])));
+    }
+
+    JointTracks& tracks = joints_[joint];
+    if (decomposition_error > params.decomposition_tolerance) {
+      tracks.matrix.first_key = matrices_.size();
+      tracks.matrix.num_keys = num_frames_;
+      matrices_.insert(matrices_.end(), matrices.begin(), matrices.end());
+      continue;
+    }
+
+    tracks.translation.first_key = translations_.size();
+    for (int frame : ReduceKeys(translations, translations,
+      params.translation_tolerance, Lerp, GetDistance)) {
+      translation_frames_.push_back(frame);
+      translations_.push_back(translations[frame]);
+    }
+    tracks.translation.num_keys = translations_.size() -
+      tracks.translation.first_key;
+
+    tracks.rotation.first_key = rotations_.size();
+    for (int frame : ReduceKeys(quantized_rotations, rotations,
+      params.rotation_tolerance, Nlerp, GetAngle)) {
+      rotation_frames_.push_back(frame);
+      rotations_.push_back(QuantizeQuat(rotations[frame]));
+    }
+    tracks.rotation.num_keys = rotations_.size() - tracks.rotation.first_key;
+
+    tracks.scale.first_key = scales_.size();
+    for (int frame : ReduceKeys(scales, scales, params.scale_tolerance, Lerp,
+      GetDistance)) {
+      scale_frames_.push_back(frame);
+      scales_.push_back(scales[frame]);
+    }
+    tracks.scale.num_keys = scales_.size() - tracks.scale.first_key;
+  }
+
+  translation_frames_.shrink_to_fit();
+  translations_.shrink_to_fit();
+  rotation_frames_.shrink_to_fit();
+  rotations_.shrink_to_fit();
+  scale_frames_.shrink_to_fit();
+  scales_.shrink_to_fit();
+  matrices_.shrink_to_fit();
+}
+
+int CompressedAnimation::GetNumKeys() const {
+  return translations_.size() + rotations_.size() + scales_.size() +
+    matrices_.size();
+}
+
+mat4 CompressedAnimation::Sample(int joint, float frame) const {
+  frame = std::max(0.0f, std::min(frame, float(num_frames_ - 1)));
+  const JointTracks& tracks = joints_[joint];
+
+  if (tracks.matrix.num_keys > 0) {
+    const mat4* matrices = &matrices_[tracks.matrix.first_key];
+    int i = int(frame);
+    if (i + 1 == num_frames_) return matrices[i];
+    float t = frame - i;
+    mat4 m;
+    for (int c = 0; c < 4; c++) {
+      m[c] = matrices[i][c] + (matrices[i + 1][c] - matrices[i][c]) * t;
+    }
+    return m;
+  }
+
+  float t;
+  vec3 translation = translations_[tracks.translation.first_key];
+  if (tracks.translation.num_keys > 1) {
+    int i = tracks.translation.first_key + FindKey(
+      &translation_frames_[tracks.translation.first_key],
+      tracks.translation.num_keys, frame, t);
+    translation = Lerp(translations_[i], translations_[i + 1], t);
+  }
+
+  quat rotation = DequantizeQuat(rotations_[tracks.rotation.first_key]);
+  if (tracks.rotation.num_keys > 1) {
+    int i = tracks.rotation.first_key + FindKey(
+      &rotation_frames_[tracks.rotation.first_key],
+      tracks.rotation.num_keys, frame, t);
+    rotation = Nlerp(DequantizeQuat(rotations_[i]),
+      DequantizeQuat(rotations_[i + 1]), t);
+  }
+
+  vec3 scale = scales_[tracks.scale.first_key];
+  if (tracks.scale.num_keys > 1) {
+    int i = tracks.scale.first_key + FindKey(
+      &scale_frames_[tracks.scale.first_key], tracks.scale.num_keys, frame,
+      t);
+    scale = Lerp(scales_[i], scales_[i + 1], t);
+  }
+  return Compose(translation, rotation, scale);
+}
+
+void CompressedAnimation::Sample(float frame, vector<mat4>& transforms) const {
+  transforms.resize(joints_.size());
+  for (size_t joint = 0; joint < joints_.size(); joint++) {
+    transforms[joint] = Sample(joint, frame);
+  }
+}
+
+size_t CompressedAnimation::GetMemoryUsage() const {
+  return sizeof(CompressedAnimation) +
+    joints_.capacity() * sizeof(JointTracks) +
+    translation_frames_.capacity() * sizeof(uint16_t) +
+    translations_.capacity() * sizeof(vec3) +
+    rotation_frames_.capacity() * sizeof(uint16_t) +
+    rotations_.capacity() * sizeof(QuantizedQuat) +
+    scale_frames_.capacity() * sizeof(uint16_t) +
+    scales_.capacity() * sizeof(vec3) +
+    matrices_.capacity() * sizeof(mat4);
+}
+
+size_t GetBakedMemoryUsage(const Animation& animation) {
+  size_t size = sizeof(Animation) +
+    animation.keyframes.capacity() * sizeof(Keyframe);
+  for (const Keyframe& keyframe : animation.keyframes) {
+    size += keyframe.transforms.capacity() * sizeof(mat4);
+  }
+  return size;
+}
+
+int GetNumFrames(const Animation& animation) {
+  if (animation.compressed) return animation.compressed->GetNumFrames();
+  return animation.keyframes.size();
+}
+
+mat4 SampleAnimation(const Animation& animation, int joint, float frame) {
+  if (animation.compressed) {
+    if (joint < 0 || joint >= animation.compressed->GetNumJoints() ||
+      animation.compressed->GetNumFrames() == 0) {
+      return mat4(1.0f);
+    }
+    return animation.compressed->Sample(joint, frame);
+  }
+
+  int i = int(frame);
+  if (i < 0 || i >= int(animation.keyframes.size())) return mat4(1.0f);
+  const vector<mat4>& transforms = animation.keyframes[i].transforms;
+  if (joint < 0 || joint >= int(transforms.size())) return mat4(1.0f);
+  return transforms[joint];
+}
+
+void SampleAnimation(const Animation& animation, float frame,
+  vector<mat4>& transforms) {
+  if (animation.compressed) {
+    if (animation.compressed->GetNumFrames() == 0) {
+      transforms.clear();
+      return;
+    }
+    animation.compressed->Sample(frame, transforms);
+    return;
+  }
+
+  int i = int(frame);
+  if (i < 0 || i >= int(animation.keyframes.size())) {
+    transforms.clear();
+    return;
+  }
+  transforms = animation.keyframes[i].transforms;
+}
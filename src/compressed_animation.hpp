@@ -0,0 +1,92 @@
+#ifndef __COMPRESSED_ANIMATION_HPP__
+#define __COMPRESSED_ANIMATION_HPP__
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "util.hpp"
+
+using namespace std;
+using namespace glm;
+
+// Largest error allowed when dropping keys, in model units for
+// translations, radians for rotations and relative to 1 for scales.
+struct AnimationCompressionParams {
+  float translation_tolerance = 0.001f;
+  float rotation_tolerance = 0.001f;
+  float scale_tolerance = 0.001f;
+
+  // Largest difference between an element of a baked transform and of its
+  // translation, rotation and scale rebuilt into a matrix. Joints above it,
+  // like sheared ones, keep all their baked transforms.
+  float decomposition_tolerance = 0.001f;
+};
+
+// Unit quaternion in 48 bits: the index of the largest component in 2 bits
+// and the other three in 15 bits each. The largest component is rebuilt
+// from the others, so the sign of the quaternion is not kept.
+struct QuantizedQuat {
+  uint16_t bits[3];
+};
+
+QuantizedQuat QuantizeQuat(const quat& q);
+quat DequantizeQuat(const QuantizedQuat& q);
+
+// Baked joint transforms split into translation, rotation and scale tracks.
+// Keys that can be interpolated from their neighbours within the tolerance
+// are dropped, and rotations are quantized. Sampling interpolates between
+// keys, so frames may be fractional.
+class CompressedAnimation {
+  struct Track {
+    uint32_t first_key = 0;
+    uint32_t num_keys = 0;
+  };
+
+  // Joints that don't split into translation, rotation and scale have a
+  // matrix track with a key per frame instead.
+  struct JointTracks {
+    Track translation;
+    Track rotation;
+    Track scale;
+    Track matrix;
+  };
+
+  int num_frames_ = 0;
+  vector<JointTracks> joints_;
+
+  // Keys of all the tracks with their frames.
+  vector<uint16_t> translation_frames_;
+  vector<vec3> translations_;
+  vector<uint16_t> rotation_frames_;
+  vector<QuantizedQuat> rotations_;
+  vector<uint16_t> scale_frames_;
+  vector<vec3> scales_;
+  vector<mat4> matrices_;
+
+ public:
+  CompressedAnimation(const Animation& animation,
+    const AnimationCompressionParams& params = AnimationCompressionParams());
+
+  int GetNumFrames() const { return num_frames_; }
+  int GetNumJoints() const { return joints_.size(); }
+  int GetNumKeys() const;
+
+  // Frames are clamped to [0, num_frames - 1].
+  mat4 Sample(int joint, float frame) const;
+  void Sample(float frame, vector<mat4>& transforms) const;
+
+  size_t GetMemoryUsage() const;
+};
+
+// Memory used by the baked keyframes of the animation.
+size_t GetBakedMemoryUsage(const Animation& animation);
+
+// Work with baked and compressed animations. Baked animations snap to the
+// previous frame.
+int GetNumFrames(const Animation& animation);
+mat4 SampleAnimation(const Animation& animation, int joint, float frame);
+void SampleAnimation(const Animation& animation, float frame,
+  vector<mat4>& transforms);
+
+#endif // __COMPRESSED_ANIMATION_HPP__
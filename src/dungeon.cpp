@@ -4,8 +4,9 @@
 #include <queue>
 #include <vector>
 
-Dungeon::Dungeon() {
-  CreateThreads();
+Dungeon::Dungeon() : path_store_(kDungeonSize, kPathStoreBudget,
+  [this] (const ivec2& dest) { return CalculatePathsToTile(dest); }),
+  planner_(this, kDungeonSize, kDungeonSize / kDungeonCells) {
 
   char_map_[1] = '|';
   char_map_[2] = '-';
@@ -95,33 +96,6 @@ Dungeon::Dungeon() {
     relevance[i] = new int[kDungeonSize];
   }
 
-  dungeon_path_ = new int***[kDungeonSize];
-  min_distance_ = new float***[kDungeonSize];
-  for (int i = 0; i < kDungeonSize; ++i) {
-    dungeon_path_[i] = new int**[kDungeonSize];
-    min_distance_[i] = new float**[kDungeonSize];
-    for (int j = 0; j < kDungeonSize; ++j) {
-      dungeon_path_[i][j] = new int*[kDungeonSize];
-      min_distance_[i][j] = new float*[kDungeonSize];
-      for (int k = 0; k < kDungeonSize; ++k) {
-        dungeon_path_[i][j][k] = new int[kDungeonSize];
-        min_distance_[i][j][k] = new float[kDungeonSize];
-      }
-    }
-  }
-
-  new_dungeon_path_ = new int***[kDungeonSize];
-  for (int i = 0; i < kDungeonSize; ++i) {
-    new_dungeon_path_[i] = new int**[kDungeonSize];
-    for (int j = 0; j < kDungeonSize; ++j) {
-      new_dungeon_path_[i][j] = new int*[kDungeonSize];
-      for (int k = 0; k < kDungeonSize; ++k) {
-        new_dungeon_path_[i][j][k] = new int[kDungeonSize];
-      }
-    }
-  }
-
-
   chambers_ = new char*[kDungeonCells];
   for (int i = 0; i < kDungeonCells; i++) {
     chambers_[i] = new char[kDungeonCells];
@@ -611,6 +585,9 @@ void Dungeon::PrintRooms() {
 
 void Dungeon::PrintPathfindingMap(const vec3& player_position) {
   ivec2 tile = GetDungeonTile(player_position);
+  if (!IsValidTile(tile)) return;
+
+  shared_ptr<const FlowField> flow_field = path_store_.Get(tile);
 
   vector<string> arrows { "↘", "↓", "↙", "→", "•", "←", "↗", "↑", "↖", "◦" };
 
@@ -625,7 +602,7 @@ void Dungeon::PrintPathfindingMap(const vec3& player_position) {
       if (code == ' ' || code == 'o' || code == 'O' || code == 'g' || 
         code == 'G' || code == 'd' || code == 'D' || code == '<') { 
         code = MonstersAndObjs(x, y);
-        int path_code = dungeon_path_[tile.x][tile.y][x][y];
+        int path_code = flow_field->GetCode(ivec2(x, y));
         cout << arrows[path_code] << " ";
       } else {
         cout << code << " ";
@@ -1975,17 +1952,8 @@ using TileMinHeap = priority_queue<tuple<ivec2, float, float, ivec2>,
 }; // End of namespace;
 
 void Dungeon::ClearDungeonPaths() {
-  for (int i = 0; i < kDungeonSize; i++) {
-    for (int j = 0; j < kDungeonSize; j++) {
-      for (int k = 0; k < kDungeonSize; k++) {
-        for (int l = 0; l < kDungeonSize; l++) {
-          dungeon_path_[i][j][k][l] = 9;
-          min_distance_[i][j][k][l] = 9999999;
-          new_dungeon_path_[i][j][k][l] = 9;
-        }
-      }
-    }
-  }
+  path_store_.Clear();
+  planner_.Invalidate();
 }
 
 bool Dungeon::IsRoomTile(const ivec2& tile) {
@@ -2226,38 +2194,22 @@ bool Dungeon::IsTileNextToDoor(const ivec2& tile) {
   return false;
 }
 
-void Dungeon::CalculatePathsToTile(const ivec2& dest, const ivec2& last) {
-  if (!IsTileClear(dest)) return;
-
-  // bool fast_calculate = false;
-  // if (last.x != 0 && last.y != 0) {
-  //   fast_calculate = true;
-  //   for (int k = 0; k < kDungeonSize; k++) {
-  //     for (int l = 0; l < kDungeonSize; l++) {
-  //       new_dungeon_path_[dest.x][dest.y][k][l] = new_dungeon_path_[last.x][last.y][k][l];
-  //     }
-  //   }
-  // }
+shared_ptr<FlowField> Dungeon::CalculatePathsToTile(const ivec2& dest) {
+  shared_ptr<FlowField> flow_field = make_shared<FlowField>(dest, 
+    kDungeonSize);
+  if (!IsTileClear(dest)) return flow_field;
 
-  for (int k = 0; k < kDungeonSize; ++k) {
-    for (int l = 0; l < kDungeonSize; ++l) {
-      min_distance_[dest.x][dest.y][k][l] = 9999999;
-      new_dungeon_path_[dest.x][dest.y][k][l] = 9;
-    }
-  }
+  vector<uint8_t>& codes = flow_field->codes;
+  vector<float>& distances = flow_field->distances;
 
   TileMinHeap tile_heap;
   tile_heap.push({ dest, 0.0f, 0.0f, ivec2(0, 0) });
   while (!tile_heap.empty()) {
     const auto [tile, distance, NOT_USED, off] = tile_heap.top(); 
-    min_distance_[dest.x][dest.y][tile.x][tile.y] = distance;
-
-    int code = OffsetToCode(off);
-    new_dungeon_path_[dest.x][dest.y][tile.x][tile.y] = code;
+    distances[tile.x * kDungeonSize + tile.y] = distance;
+    codes[tile.x * kDungeonSize + tile.y] = OffsetToCode(off);
     tile_heap.pop();
 
-    // if (fast_calculate && dungeon_path_[last.x][last.y][tile.x][tile.y] == code) continue;
-
     int move_type = -1;
     for (int off_y = -1; off_y < 2; off_y++) {
       for (int off_x = -1; off_x < 2; off_x++) {
@@ -2267,29 +2219,26 @@ void Dungeon::CalculatePathsToTile(const ivec2& dest, const ivec2& last) {
         ivec2 next_tile = tile + ivec2(off_x, off_y);
         if (!IsTileClear(tile, next_tile)) continue;
 
-        if (pow(dest.x - next_tile.x, 2) + pow(dest.y - next_tile.y, 2) > 400.0f) {
+        if (pow(dest.x - next_tile.x, 2) + pow(dest.y - next_tile.y, 2) > 
+          kMaxPathRadius * kMaxPathRadius) {
           continue; 
         }
       
         const float cost = move_to_cost_[move_type];
         const float new_distance  = distance + cost;
 
-        const float min_distance = min_distance_[dest.x][dest.y][next_tile.x][next_tile.y];
+        const float min_distance = 
+          distances[next_tile.x * kDungeonSize + next_tile.y];
 
         // Change these two to get min paths instead of possible paths.
-        if (min_distance != 9999999) continue;
+        if (min_distance != kNoPathDistance) continue;
         // if (new_distance >= min_distance) continue;
 
         tile_heap.push({ next_tile, new_distance, 0.0f, ivec2(off_x, off_y) });
       }
     }
   }
-
-  for (int k = 0; k < kDungeonSize; ++k) {
-    for (int l = 0; l < kDungeonSize; ++l) {
-      dungeon_path_[dest.x][dest.y][k][l] = new_dungeon_path_[dest.x][dest.y][k][l];
-    }
-  }
+  return flow_field;
 }
 
 int DistanceHeuristic(const ivec2& a, const ivec2& b) {
@@ -2309,6 +2258,11 @@ vec3 Dungeon::GetPathToTile(const vec3& start, const vec3& end) {
     return vec3(0);
   }
 
+  // Scratch flow field for this search only.
+  FlowField flow_field(dest_tile, kDungeonSize);
+  vector<uint8_t>& codes = flow_field.codes;
+  vector<float>& distances = flow_field.distances;
+
   TileMinHeap tile_heap; // Open list.
   tile_heap.push({ source_tile, 0.0f, 0.0f, ivec2(0, 0) });
 
@@ -2321,10 +2275,8 @@ vec3 Dungeon::GetPathToTile(const vec3& start, const vec3& end) {
     }
 
     const auto [tile, h_distance, distance, off] = tile_heap.top(); 
-    min_distance_[dest_tile.x][dest_tile.y][tile.x][tile.y] = distance;
-
-    int code = OffsetToCode(off);
-    dungeon_path_[dest_tile.x][dest_tile.y][tile.x][tile.y] = code;
+    distances[tile.x * kDungeonSize + tile.y] = distance;
+    codes[tile.x * kDungeonSize + tile.y] = OffsetToCode(off);
     tile_heap.pop();
 
     short key = tile.x * kDungeonSize + tile.y;
@@ -2335,7 +2287,7 @@ vec3 Dungeon::GetPathToTile(const vec3& start, const vec3& end) {
 
     // Reached the destination.
     if (tile.x == dest_tile.x && tile.y == dest_tile.y) {
-      int code = dungeon_path_[dest_tile.x][dest_tile.y][source_tile.x][source_tile.y];
+      int code = flow_field.GetCode(source_tile);
       const ivec2 tile_offset = code_to_offset_[code];
       const ivec2 next_tile = source_tile + tile_offset;
 
@@ -2357,22 +2309,15 @@ vec3 Dungeon::GetPathToTile(const vec3& start, const vec3& end) {
         const float cost = move_to_cost_[move_type];
         const float new_distance  = distance + cost;
 
-        float min_distance = min_distance_[dest_tile.x][dest_tile.y][next_tile.x][next_tile.y];
-        if (min_distance > 0 && invert_distance_) {
-          min_distance = -9999999.0f;
-        } else if (min_distance < 0 && !invert_distance_) {
-          min_distance = 9999999.0f;
-        }
-
-        if (!invert_distance_ && new_distance >= min_distance) {
-          continue;
-        } else if (invert_distance_ && new_distance <= min_distance) {
+        float min_distance = flow_field.GetDistance(next_tile);
+        if (new_distance >= min_distance) {
           continue;
         }
 
         // Get inverse movement.
-        dungeon_path_[dest_tile.x][dest_tile.y][next_tile.x][next_tile.y] = OffsetToCode(ivec2(-off_x, -off_y));
-        min_distance_[dest_tile.x][dest_tile.y][next_tile.x][next_tile.y] = new_distance;
+        codes[next_tile.x * kDungeonSize + next_tile.y] = 
+          OffsetToCode(ivec2(-off_x, -off_y));
+        distances[next_tile.x * kDungeonSize + next_tile.y] = new_distance;
 
         int h = DistanceHeuristic(next_tile, dest_tile);
         tile_heap.push({ next_tile, new_distance + h, new_distance, ivec2(off_x, off_y) });
@@ -2382,43 +2327,10 @@ vec3 Dungeon::GetPathToTile(const vec3& start, const vec3& end) {
    return vec3(0);
 }
 
-void Dungeon::CalculateAllPaths() {
-  double start_time = glfwGetTime();
-
-  ClearDungeonPaths();
-
-  ivec2 last = ivec2(0, 0);
-  for (int i = 0; i < kDungeonSize; i++) {
-    for (int j = 0; j < kDungeonSize; j++) {
-      calculate_path_mutex_.lock();
-      ivec2 tile = ivec2(i, j);
-      if (IsTileClear(tile)) {
-        calculate_path_tasks_.push(tile);
-      }
-      calculate_path_mutex_.unlock();
-    }
-  }
-
-  int num_tasks = calculate_path_tasks_.size();
-
-  while (!calculate_path_tasks_.empty() || running_calculate_path_tasks_ > 0) {
-    this_thread::sleep_for(chrono::microseconds(200));
-  }
-
-  double elapsed_time = glfwGetTime() - start_time;
-  cout << "CalculateAllPaths took " << elapsed_time << " seconds" << endl;
-}
-
-void Dungeon::CalculateAllPathsAsync(const ivec2& tile) {
-  for (int i = tile.x-8; i < tile.x+8; i++) {
-    for (int j = tile.y-8; j < tile.y+8; j++) {
-      if (!IsValidTile(ivec2(i, j))) continue;
-
-      calculate_path_mutex_.lock();
-      calculate_path_tasks_.push(ivec2(i, j));
-      calculate_path_mutex_.unlock();
-    }
-  }
+void Dungeon::InvalidatePaths(const ivec2& tile) {
+  // Any flow field that reaches this tile may route through it.
+  path_store_.Invalidate(tile, kMaxPathRadius);
+  planner_.Invalidate();
 }
 
 void Dungeon::CalculateRelevance() {
@@ -2433,12 +2345,16 @@ void Dungeon::CalculateRelevance() {
     if (downstairs.x != -1) break;
   }
   downstairs.x--;
+  if (!IsValidTile(downstairs)) return;
 
+  // Uses the distance from each tile to the stairs, so only the flow field
+  // towards the stairs is needed.
+  shared_ptr<const FlowField> flow_field = path_store_.Get(downstairs);
   for (int i = -20; i < 20; i++) {
     for (int j = -20; j < 20; j++) {
       ivec2 t = downstairs + ivec2(i, j);
       if (!IsValidTile(t)) continue;
-      float distance = min_distance_[t.x][t.y][downstairs.x][downstairs.y];
+      float distance = flow_field->GetDistance(t);
       relevance[t.x][t.y] = int(distance);
     }
   }
@@ -2491,6 +2407,8 @@ ivec2 Dungeon::IsReachableThroughDoor(const vec3& source, const vec3& dest) {
     return ivec2(-1, -1);
   }
 
+  shared_ptr<const FlowField> dest_field = path_store_.Get(dest_tile);
+
   ivec2 best_door = ivec2(-1, -1);
   float min_distance = 9999999;
   for (auto& d : doors_) {
@@ -2514,14 +2432,17 @@ ivec2 Dungeon::IsReachableThroughDoor(const vec3& source, const vec3& dest) {
       }
     }
 
-    int code1 = dungeon_path_[x1][y1][source_tile.x][source_tile.y];
-    if (code1 == 9 || code1 == 4) continue;
+    if (!IsValidTile(ivec2(x1, y1)) || !IsValidTile(ivec2(x2, y2))) continue;
 
-    int code2 = dungeon_path_[dest_tile.x][dest_tile.y][x2][y2];
+    int code2 = dest_field->GetCode(ivec2(x2, y2));
     if (code2 == 9 || code2 == 4) continue;
 
-    int dist = min_distance_[dest_tile.x][dest_tile.y][x2][y2] + 
-      min_distance_[x1][y1][source_tile.x][source_tile.y];
+    shared_ptr<const FlowField> door_field = path_store_.Get(ivec2(x1, y1));
+    int code1 = door_field->GetCode(source_tile);
+    if (code1 == 9 || code1 == 4) continue;
+
+    int dist = dest_field->GetDistance(ivec2(x2, y2)) + 
+      door_field->GetDistance(source_tile);
     
     if (dist < min_distance) {
       best_door = d;
@@ -2543,16 +2464,24 @@ vec3 Dungeon::GetNextMove(const vec3& source, const vec3& dest,
     return vec3(0);
   }
 
-  int code = dungeon_path_[dest_tile.x][dest_tile.y][source_tile.x][source_tile.y];
-  min_distance = min_distance_[dest_tile.x][dest_tile.y][source_tile.x][source_tile.y];
+  shared_ptr<const FlowField> dest_field = path_store_.Get(dest_tile);
+  int code = dest_field->GetCode(source_tile);
+  min_distance = dest_field->GetDistance(source_tile);
 
   const ivec2 tile_offset = code_to_offset_[code];
   ivec2 next_tile = source_tile + tile_offset;
 
   if (code == 4 || code == 9) { // No path found from source to dest.
-    // If distance is more than 20 tiles, then it is too distant anyways.
-    if (pow(dest.x - source.x, 2) + pow(dest.y - source.y, 2) > 400.0f) {
-      return vec3(0);
+    // Beyond the flow field radius, plan through the chamber graph.
+    const ivec2 offset = dest_tile - source_tile;
+    if (offset.x * offset.x + offset.y * offset.y > 
+      kMaxPathRadius * kMaxPathRadius) {
+      next_tile = planner_.GetNextTile(source_tile, dest_tile);
+      if (next_tile == source_tile || !IsTileClear(next_tile)) {
+        return vec3(0);
+      }
+      min_distance = length(vec2(dest_tile - source_tile));
+      return GetTilePosition(next_tile);
     }
 
     int best_code = -1;
@@ -2565,14 +2494,19 @@ vec3 Dungeon::GetNextMove(const vec3& source, const vec3& dest,
         int y = ((source_tile.y + dest_tile.y) / 2) + j;
         if (x < 0 || y < 0 || x >= kDungeonSize || y >= kDungeonSize) continue;
 
-        int code1 = dungeon_path_[x][y][source_tile.x][source_tile.y];
-        if (code1 == 9 || code1 == 4) continue;
+        // Fields towards walls would be empty, so skip them before paying
+        // for the calculation.
+        if (!IsTileClear(ivec2(x, y))) continue;
 
-        int code2 = dungeon_path_[dest_tile.x][dest_tile.y][x][y];
+        int code2 = dest_field->GetCode(ivec2(x, y));
         if (code2 == 9 || code2 == 4) continue;
 
-        int dist = min_distance_[dest_tile.x][dest_tile.y][x][y] + 
-          min_distance_[x][y][source_tile.x][source_tile.y];
+        shared_ptr<const FlowField> field = path_store_.Get(ivec2(x, y));
+        int code1 = field->GetCode(source_tile);
+        if (code1 == 9 || code1 == 4) continue;
+
+        int dist = dest_field->GetDistance(ivec2(x, y)) + 
+          field->GetDistance(source_tile);
      
         if (dist < min_distance) {
           best_code = code1;
@@ -3201,34 +3135,6 @@ void Dungeon::LoadLevelDataFromXml(const string& filename) {
   }
 }
 
-void Dungeon::CalculatePathsAsync() {
-  while (!terminate_) {
-    calculate_path_mutex_.lock();
-    if (calculate_path_tasks_.empty()) {
-      calculate_path_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(200));
-      continue;
-    }
-
-    ivec2 tile = calculate_path_tasks_.front();
-    calculate_path_tasks_.pop();
-    running_calculate_path_tasks_++;
-    calculate_path_mutex_.unlock();
-
-    CalculatePathsToTile(tile, ivec2(0, 0));
-
-    calculate_path_mutex_.lock();
-    running_calculate_path_tasks_--;
-    calculate_path_mutex_.unlock();
-  }
-}
-
-void Dungeon::CreateThreads() {
-  for (int i = 0; i < kMaxThreads; i++) {
-    calculate_path_threads_.push_back(thread(&Dungeon::CalculatePathsAsync, this));
-  }
-}
-
 void Dungeon::Reveal() {
   for (int i = 0; i < kDungeonSize; ++i) {
     for (int j = 0; j < kDungeonSize; ++j) {
@@ -3259,12 +3165,14 @@ vector<ivec2> Dungeon::GetPath(const vec3& start, const vec3& end) {
     return {};
   }
 
+  shared_ptr<const FlowField> flow_field = path_store_.Get(dest_tile);
+
   vector<ivec2> path;
   ivec2 cur_tile = source_tile;
   for (int i = 0; i < 100; i++) {
 
     path.push_back(cur_tile);
-    int code = dungeon_path_[dest_tile.x][dest_tile.y][cur_tile.x][cur_tile.y];
+    int code = flow_field->GetCode(cur_tile);
     if (code == 9) return {};
 
     const ivec2 tile_offset = code_to_offset_[code];
@@ -3298,7 +3206,8 @@ bool Dungeon::GetFlag(int x, int y, int flag) {
 }
 
 void Dungeon::ClearPaths() {
-  invert_distance_ = !invert_distance_;
+  path_store_.Clear();
+  planner_.Invalidate();
 }
 
 int Dungeon::GetRandomChestLoot(int dungeon_level) {
@@ -3347,7 +3256,7 @@ bool Dungeon::LoadDungeonFromFile(const string& filename) {
   f.close();
 
   GenerateAsciiDungeon();
-  CalculateAllPaths();
+  ClearDungeonPaths();
   PrintMap();
 
   // CalculateRelevance();
@@ -3393,7 +3302,7 @@ void Dungeon::GenerateDungeon(int dungeon_level, int random_num) {
   // random_num = -916558998;
 
   initialized_ = true;
-  srand(random_num);
+  SeedRandom(random_num);
   cout << "Dungeon seed: " << random_num << endl;
 
   const int min_area = level_data_[current_level_].dungeon_area;
@@ -3451,8 +3360,7 @@ void Dungeon::GenerateDungeon(int dungeon_level, int random_num) {
   GenerateAsciiDungeon();
   PrintMap();
 
-  cout << "Calculating paths..." << endl;
-  CalculateAllPaths();
+  ClearDungeonPaths();
   CalculateRelevance();
 }
 
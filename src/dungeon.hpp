@@ -6,10 +6,18 @@
 #include <glm/glm.hpp>
 #include <unordered_map>
 #include <queue>
+#include "path_store.hpp"
+#include "hpa.hpp"
 
 using namespace std;
 using namespace glm;
 
+// Flow fields only extend this many tiles from their destination.
+const int kMaxPathRadius = 20;
+
+// Default memory budget for cached flow fields (about 1900 destinations).
+const size_t kPathStoreBudget = 64 * 1024 * 1024;
+
 struct Room {
   bool dark = false;
   bool has_stairs;
@@ -133,9 +141,11 @@ class Dungeon {
   int vr1_, vr2_, vr3_;
   int hr1_, hr2_, hr3_;
 
-  int**** dungeon_path_;
-  int**** new_dungeon_path_;
-  float**** min_distance_;
+  // Flow fields are calculated when a monster first paths to a tile.
+  PathStore path_store_;
+
+  // Plans paths that are too long for the flow fields.
+  HpaPlanner planner_;
 
   char** chambers_;
 
@@ -161,12 +171,6 @@ class Dungeon {
     1.4f, 1.0f, 1.4f
   };
 
-  mutex calculate_path_mutex_;
-  bool terminate_ = false;
-  const int kMaxThreads = 16;
-  queue<ivec2> calculate_path_tasks_;
-  int running_calculate_path_tasks_ = 0;
-  vector<thread> calculate_path_threads_;
   int task_counter_ = 0;
 
   void DrawRoom(int x, int y, int w, int h, int add_flags, int code = 1);
@@ -202,7 +206,7 @@ class Dungeon {
   void PlaceTraps();
   void GenerateAsciiDungeon();
 
-  void CalculatePathsToTile(const ivec2& tile, const ivec2& last);
+  shared_ptr<FlowField> CalculatePathsToTile(const ivec2& dest);
 
   void CastRay(const vec2& player_pos, const vec2& ray);
   bool EmptyAdjacent(const ivec2& tile);
@@ -225,8 +229,6 @@ class Dungeon {
   int GetIntCode(const char c);
   vector<vector<int>> RotateMiniset(vector<vector<int>> mat, int rotations);
 
-  bool invert_distance_ = false;
-
  public:
   Dungeon();
   ~Dungeon();
@@ -234,7 +236,8 @@ class Dungeon {
   void PrintMap();
   void PrintRooms();
 
-  int**** GetDungeonPath() { return dungeon_path_; }
+  PathStore& GetPathStore() { return path_store_; }
+  HpaPlanner& GetPlanner() { return planner_; }
   char** GetDarkness();
 
   vec3 GetNextMove(const vec3& source, const vec3& dest, float& min_distance);
@@ -265,7 +268,6 @@ class Dungeon {
   void SetDoorOpen(const ivec2& tile);
   void SetDoorClosed(const ivec2& tile);
   bool IsInitialized() { return initialized_; }
-  void CalculateAllPaths();
   void CalculateRelevance();
   void Clear();
   void ClearDungeonPaths();
@@ -286,8 +288,6 @@ class Dungeon {
   unordered_map<int, LevelData>& GetLevelData() { return level_data_; }
   void LoadLevelDataFromXml(const string& filename);
 
-  void CalculatePathsAsync();
-  void CreateThreads();
   void Reveal();
   int GetMonsterGroup(const ivec2& tile);
   int GetRelevance(const ivec2& tile);
@@ -301,7 +301,7 @@ class Dungeon {
   bool GetFlag(int x, int y, int flag);
   vec3 GetPathToTile(const vec3& start, const vec3& end);
   void ClearPaths();
-  void CalculateAllPathsAsync(const ivec2& tile);
+  void InvalidatePaths(const ivec2& tile);
   bool IsReachable(const vec3& source, const vec3& dest);
   ivec2 IsReachableThroughDoor(const vec3& source, const vec3& dest);
   void PrintPathfindingMap(const vec3& position);
@@ -29,6 +29,8 @@ Engine::Engine(
     player_input_(player_input), 
     window_(window), window_width_(window_width), 
     window_height_(window_height) {
+  simulation_ = make_shared<Simulation>(resources_, collision_resolver_, ai_,
+    physics_);
 }
 
 // TODO: move this elsewhere.
@@ -70,6 +72,10 @@ void Engine::RunCommand(string command) {
     configs->draw_dungeon = true;
   } else if (result[0] == "nodrawdungeon") {
     configs->draw_dungeon = false;
+  } else if (result[0] == "occlusion") {
+    configs->occlusion_culling = true;
+  } else if (result[0] == "noocclusion") {
+    configs->occlusion_culling = false;
   } else if (result[0] == "pathfinding") {
     int x = boost::lexical_cast<int>(result[1]);
     int y = boost::lexical_cast<int>(result[2]);
@@ -263,7 +269,7 @@ void Engine::RunCommand(string command) {
         resources_->DeleteAllObjects();
         resources_->CreateDungeon(false);
         vec3 pos = dungeon.GetTilePosition(ivec2(6, 6));
-        configs->wave_reset_timer = glfwGetTime() + 5.0f;
+        configs->wave_reset_timer = GetTime() + 5.0f;
 
         resources_->GetPlayer()->ChangePosition(pos);
         resources_->GetConfigs()->render_scene = "arena";
@@ -407,7 +413,7 @@ bool Engine::ProcessGameInput() {
       Dungeon& dungeon = resources_->GetDungeon();
 
       // TODO: all of this should go into a class player.
-      if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           text_editor_->Enable();
     
@@ -460,21 +466,21 @@ bool Engine::ProcessGameInput() {
           resources_->SetGameState(STATE_EDITOR);
         }
         throttle_counter_ = 20;
-      } else if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_I) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           inventory_->Enable(window);
           resources_->SetGameState(STATE_INVENTORY);
         }
         throttle_counter_ = 10;
         return false;
-      } else if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_O) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           inventory_->Enable(window, INVENTORY_SPELLBOOK);
           resources_->SetGameState(STATE_INVENTORY);
         }
         throttle_counter_ = 10;
         return false;
-      } else if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_M) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           EnableMap();
           inventory_->Enable(window, INVENTORY_MAP);
@@ -482,7 +488,7 @@ bool Engine::ProcessGameInput() {
         }
         throttle_counter_ = 10;
         return false;
-      } else if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           configs->brush_size-=10;
           if (configs->brush_size < 0) {
@@ -490,7 +496,7 @@ bool Engine::ProcessGameInput() {
           }
         }
         throttle_counter_ = 4;
-      } else if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           configs->brush_size += 10;
           if (configs->brush_size > 1000) {
@@ -503,7 +509,7 @@ bool Engine::ProcessGameInput() {
 
       shared_ptr<CurrentDialog> current_dialog = resources_->GetCurrentDialog();
       if (current_dialog->enabled) {
-        glfwSetCursorPos(window_, 0, 0);
+        SetInputCursorPos(window_, 0, 0);
         inventory_->Enable(window, INVENTORY_DIALOG);
         resources_->SetGameState(STATE_INVENTORY);
       }
@@ -516,18 +522,18 @@ bool Engine::ProcessGameInput() {
       return true;
     }
     case STATE_MAP: {
-      if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_M) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           resources_->SetGameState(STATE_GAME);
           inventory_->Disable();
-          glfwSetCursorPos(window_, 0, 0);
+          SetInputCursorPos(window_, 0, 0);
         }
         throttle_counter_ = 20;
       }
       return true;
     }
     case STATE_INVENTORY: {
-      if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_I) == GLFW_PRESS) {
         if (throttle_counter_ < 0) {
           inventory_->Disable();
         }
@@ -718,10 +724,7 @@ void Engine::BeforeFrame() {
 
     switch (resources_->GetGameState()) {
       case STATE_GAME: {
-        physics_->Run();
-        collision_resolver_->Collide();
-        ai_->Run();
-        resources_->RunPeriodicEvents();
+        simulation_->Step();
         break;
       }
       case STATE_MAP: {
@@ -748,7 +751,7 @@ void Engine::Run() {
   // Start threads.
   // periodic_events_thread_ = thread(&Engine::RunPeriodicEventsAsync, this);
 
-  glfwSetCursorPos(window_, 0, 0);
+  SetInputCursorPos(window_, 0, 0);
 
   shared_ptr<Configs> configs = resources_->GetConfigs();
   resources_->LoadGame("config.xml", false);
@@ -763,7 +766,7 @@ void Engine::Run() {
       resources_->DeleteAllObjects();
       resources_->CreateDungeon(false);
       vec3 pos = dungeon.GetTilePosition(ivec2(6, 6));
-      configs->wave_reset_timer = glfwGetTime() + 5.0f;
+      configs->wave_reset_timer = GetTime() + 5.0f;
 
       resources_->GetPlayer()->ChangePosition(pos);
       resources_->GetConfigs()->render_scene = "arena";
@@ -783,13 +786,18 @@ void Engine::Run() {
   }
   // Arena.
 
+  shared_ptr<Replay> replay = GetReplay();
+
   int frames = 0;
-  double next_print_time = glfwGetTime();
-  double last_time = glfwGetTime();
+  double next_print_time = GetTime();
+  double last_time = GetTime();
   do {
+    if (replay && !replay->BeginFrame(window_)) {
+      break;
+    }
     frames++;
 
-    double current_time = glfwGetTime();
+    double current_time = GetTime();
     delta_time_ = current_time - last_time;
     if (current_time >= next_print_time) { 
       cout << 1000.0 / double(frames) << " ms / frame" << endl;
@@ -809,10 +817,18 @@ void Engine::Run() {
     renderer_->SetCamera(c);
     AfterFrame();
 
+    if (replay) {
+      replay->EndFrame(simulation_->GetStateHash());
+    }
+
     glfwSwapBuffers(window_);
     glfwPollEvents();
   } while (glfwWindowShouldClose(window_) == 0);
 
+  if (replay) {
+    replay->PrintSummary();
+  }
+
   // Cleanup VBO and shader.
   resources_->Cleanup();
   glfwTerminate();
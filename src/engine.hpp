@@ -9,6 +9,8 @@
 #include "player.hpp"
 #include "inventory.hpp"
 #include "game_screen.hpp"
+#include "simulation.hpp"
+#include "replay.hpp"
 
 #include <thread>
 #include <mutex>
@@ -28,6 +30,7 @@ class Engine {
   shared_ptr<AI> ai_ = nullptr;
   shared_ptr<Physics> physics_ = nullptr;
   shared_ptr<PlayerInput> player_input_ = nullptr;
+  shared_ptr<Simulation> simulation_ = nullptr;
   ObjPtr line_obj_ = nullptr;
 
   float delta_time_ = 0.0f;
@@ -511,82 +511,46 @@ void FbxLoad(const std::string& filename, FbxData& data) {
   ExtractAnimations(scene, &data);
 }
 
-void LoadFbxData(const std::string& filename, Mesh& m, FbxData& data, bool calculate_bs) {
-  data.name = filename;
-  FbxLoad(filename, data);
-
-  m.polygons = data.raw_mesh.polygons;
-
-  GLuint buffers[8];
-  glGenBuffers(8, buffers);
-
-  vector<vec3> vertices;
-  vector<unsigned int> indices;
-  for (int i = 0; i < data.raw_mesh.indices.size(); i++) {
-    vertices.push_back(data.raw_mesh.vertices[data.raw_mesh.indices[i]]);
-    indices.push_back(i);
+void BuildMeshData(const FbxData& data, MeshData& mesh_data) {
+  const RawMesh& raw_mesh = data.raw_mesh;
+  mesh_data = MeshData();
+  mesh_data.polygons = raw_mesh.polygons;
+  mesh_data.bounding_sphere = GetAssetBoundingSphere(mesh_data.polygons);
+
+  // UVs and normals are already given per corner.
+  int num_corners = raw_mesh.indices.size();
+  for (int i = 0; i < num_corners; i++) {
+    mesh_data.vertices.push_back(raw_mesh.vertices[raw_mesh.indices[i]]);
   }
-  m.num_indices = indices.size();
-
-  glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
-  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), 
-    &vertices[0], GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
-  glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.uvs.size() * sizeof(vec2), 
-    &data.raw_mesh.uvs[0], GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
-  glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.normals.size() * sizeof(vec3), 
-    &data.raw_mesh.normals[0], GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[3]); 
-  glBufferData(
-    GL_ELEMENT_ARRAY_BUFFER, 
-    indices.size() * sizeof(unsigned int), 
-    &indices[0], 
-    GL_STATIC_DRAW
-  );
-
-  glGenVertexArrays(1, &m.vao_);
-  glBindVertexArray(m.vao_);
-
-  int num_slots = 6;
-  BindBuffer(buffers[0], 0, 3);
-  BindBuffer(buffers[1], 1, 2);
-  BindBuffer(buffers[2], 2, 3);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[3]);
+  mesh_data.uvs = raw_mesh.uvs;
+  mesh_data.normals = raw_mesh.normals;
+  mesh_data.uvs.resize(num_corners, vec2(0));
+  mesh_data.normals.resize(num_corners, vec3(0, 1, 0));
 
   // Compute tangents and bitangents.
+  const vector<vec3>& vertices = mesh_data.vertices;
+  const vector<vec2>& uvs = mesh_data.uvs;
+  const vector<vec3>& normals = mesh_data.normals;
   vector<vec3> tangents(vertices.size());
   vector<vec3> bitangents(vertices.size());
-  for (int i = 0; i < vertices.size(); i += 3) {
+  for (int i = 0; i + 2 < vertices.size(); i += 3) {
     vec3 delta_pos1 = vertices[i+1] - vertices[i+0];
     vec3 delta_pos2 = vertices[i+2] - vertices[i+0];
-    vec2 delta_uv1 = data.raw_mesh.uvs[i+1] - data.raw_mesh.uvs[i+0];
-    vec2 delta_uv2 = data.raw_mesh.uvs[i+2] - data.raw_mesh.uvs[i+0];
+    vec2 delta_uv1 = uvs[i+1] - uvs[i+0];
+    vec2 delta_uv2 = uvs[i+2] - uvs[i+0];
 
     float r = 1.0f / (delta_uv1.x * delta_uv2.y - delta_uv1.y * delta_uv2.x);
     vec3 tangent = normalize((delta_pos1 * delta_uv2.y - delta_pos2 * delta_uv1.y) * r);
     vec3 bitangent = normalize((delta_pos2 * delta_uv1.x - delta_pos1 * delta_uv2.x) * r);
 
-    vec3 normal = (data.raw_mesh.normals[i] + data.raw_mesh.normals[i+1] + data.raw_mesh.normals[i+2]) / 3.0f;
-    // vec3 normal = data.raw_mesh.normals[i];
+    vec3 normal = (normals[i] + normals[i+1] + normals[i+2]) / 3.0f;
     vec3 face_normal = normalize(cross(tangent, bitangent));
     if (dot(normal, face_normal) < 0) face_normal = -face_normal;
 
-    // bitangent = cross(normal, tangent);
-    // cout << "Actual face normal: " << face_normal << endl;
-    // cout << "Normal: " << data.raw_mesh.normals[i] << endl;
-    // cout << "Normal 1: " << data.raw_mesh.normals[i+1] << endl;
-    // cout << "Normal 2: " << data.raw_mesh.normals[i+2] << endl;
-    // cout << "Normalized n: " << normal << endl;
-
     quat target_rotation = RotationBetweenVectors(face_normal, normal);
     mat4 rotation_matrix = mat4_cast(target_rotation);
-    // cout << "tangent: " << tangent << endl;
-    // cout << "bitangent: " << bitangent << endl;
     tangent = vec3(rotation_matrix * vec4(tangent, 1.0));
     bitangent = vec3(rotation_matrix * vec4(bitangent, 1.0));
-    // cout << "tangent A: " << tangent << endl;
-    // cout << "bitangent A: " << bitangent << endl;
 
     tangents[i+0] = tangent;
     tangents[i+1] = tangent;
@@ -596,92 +560,39 @@ void LoadFbxData(const std::string& filename, Mesh& m, FbxData& data, bool calcu
     bitangents[i+2] = bitangent;
   }
 
-  if (!data.raw_mesh.tangents.empty()) {
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[4]);
-    glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.tangents.size() * sizeof(vec3), 
-      &data.raw_mesh.tangents[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[5]);
-    glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.binormals.size() * sizeof(vec3), 
-      &data.raw_mesh.binormals[0], GL_STATIC_DRAW);
+  if (!raw_mesh.tangents.empty()) {
+    mesh_data.tangents = raw_mesh.tangents;
+    mesh_data.bitangents = raw_mesh.binormals;
+    mesh_data.tangents.resize(num_corners, vec3(0));
+    mesh_data.bitangents.resize(num_corners, vec3(0));
   } else {
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[4]);
-    glBufferData(GL_ARRAY_BUFFER, tangents.size() * sizeof(vec3), 
-      &tangents[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[5]);
-    glBufferData(GL_ARRAY_BUFFER, bitangents.size() * sizeof(vec3), 
-      &bitangents[0], GL_STATIC_DRAW);
+    mesh_data.tangents = tangents;
+    mesh_data.bitangents = bitangents;
   }
 
-  BindBuffer(buffers[4], 3, 3);
-  BindBuffer(buffers[5], 4, 3);
-
-  vector<ivec3> bone_ids;
-  vector<vec3> bone_weights;
-  if (!data.raw_mesh.bone_ids.empty()) {
-    for (int i = 0; i < data.raw_mesh.indices.size(); i++) {
-      bone_ids.push_back(data.raw_mesh.bone_ids[data.raw_mesh.indices[i]]);
-      bone_weights.push_back(data.raw_mesh.bone_weights[data.raw_mesh.indices[i]]);
+  if (!raw_mesh.bone_ids.empty()) {
+    for (int i = 0; i < num_corners; i++) {
+      mesh_data.bone_ids.push_back(raw_mesh.bone_ids[raw_mesh.indices[i]]);
+      mesh_data.bone_weights.push_back(
+        raw_mesh.bone_weights[raw_mesh.indices[i]]);
     }
-
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[6]);
-    glBufferData(GL_ARRAY_BUFFER, bone_ids.size() * sizeof(glm::ivec3), 
-      &bone_ids[0], GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, buffers[7]);
-    glBufferData(GL_ARRAY_BUFFER, bone_weights.size() * sizeof(glm::vec3), 
-      &bone_weights[0], GL_STATIC_DRAW);
-
-    num_slots += 2;
-    BindBuffer(buffers[6], 5, 3);
-    BindBuffer(buffers[7], 6, 3);
-  }
-
-  glBindVertexArray(0);
-  for (int slot = 0; slot < num_slots; slot++) {
-    glDisableVertexAttribArray(slot);
-  }
-
-  m.bounding_sphere = GetAssetBoundingSphere(m.polygons);
-
-  // Animations.
-  if (data.raw_mesh.animations.empty()) {
-    return;
-  }
-
-  for (const Animation& animation : data.raw_mesh.animations) {
-    m.animations[animation.name] = animation;
-
-    // Calculate BS.
-    // if (!calculate_bs) continue;
-    // for (int frame = 0; frame < m.animations[animation.name].keyframes.size(); frame++) {
-    //   vector<vec3> vertices;
-
-    //   for (int j = 0; j < m.polygons.size(); j++) {
-    //     Polygon& p = m.polygons[j];
-    //     for (int k = 0; k < 3; k++) {
-    //       vec3 pos = p.vertices[k];
-    //       vec3 vertex = vec3(0);
-    //       unsigned int index = p.indices[k];
-    //       for (int n = 0; n < 3; n++) {
-    //         int bone_id = bone_ids[index][n];
-    //         if (bone_id == -1) continue;
-    //         float weight = bone_weights[index][n];
-
-    //         mat4 joint_transform = animation.keyframes[frame].transforms[bone_id];
-    //         vertex += vec3(joint_transform * vec4(pos, 1.0)) * weight;
-    //       }
-    //       vertices.push_back(vertex);
-    //     }
-    //   }
-    //   m.animations[animation.name].keyframes[frame].bounding_sphere =
-    //     GetBoundingSphereFromVertices(vertices);
-    // }
-    // cout << "Extracted animation 2: " << animation.name << endl;
   }
+  WeldVertices(mesh_data);
 
+  mesh_data.animations = raw_mesh.animations;
   for (int i = 0; i < data.joints.size(); i++) {
     auto& joint = data.joints[i];
-    if (!joint) continue;
-    m.bones_to_ids[data.joints[i]->name] = i;
-    m.global_bindpose_inverse[i] = data.joints[i]->global_bindpose_inverse;
+    mesh_data.bone_names.push_back(joint ? joint->name : "");
+    mesh_data.global_bindpose_inverse.push_back(
+      joint ? joint->global_bindpose_inverse : mat4(1.0));
   }
 }
+
+void LoadFbxData(const std::string& filename, Mesh& m, FbxData& data, bool calculate_bs) {
+  data.name = filename;
+  FbxLoad(filename, data);
+
+  MeshData mesh_data;
+  BuildMeshData(data, mesh_data);
+  CreateMesh(mesh_data, m);
+}
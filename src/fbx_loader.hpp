@@ -22,6 +22,7 @@
 #include <unordered_map>
 #include <unordered_set>
 #include "util.hpp"
+#include "mesh_cache.hpp"
 
 using namespace std;
 using namespace glm;
@@ -56,6 +57,10 @@ struct FbxData {
 };
 
 void FbxLoad(const std::string& filename, FbxData& data);
+
+// De-indexes the corners, computes the tangents and welds the corners back
+// into unique vertices, as uploaded by CreateMesh or saved to the cache.
+void BuildMeshData(const FbxData& data, MeshData& mesh_data);
 void LoadFbxData(const std::string& filename, Mesh& m, FbxData& data, bool calculate_bs = false);
 
 #endif // __FBX_LOADER_H__
@@ -0,0 +1,60 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+FrameArena::FrameArena(size_t chunk_size) : chunk_size_(chunk_size) {
+}
+
+FrameArena::~FrameArena() {
+  Reset();
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment) {
+  while (true) {
+    if (chunk_ < chunks_.size()) {
+      // Aligns the address rather than the offset, since alignments larger
+      // than the one of new[] are allowed.
+      uintptr_t base = (uintptr_t) chunks_[chunk_].get();
+      size_t start = ((base + offset_ + alignment - 1) & ~(alignment - 1)) -
+        base;
+      if (start + size <= chunk_sizes_[chunk_]) {
+        offset_ = start + size;
+        metrics_.num_allocations++;
+        metrics_.memory_usage += size;
+        metrics_.max_allocations = std::max(metrics_.max_allocations,
+          metrics_.num_allocations);
+        metrics_.max_memory_usage = std::max(metrics_.max_memory_usage,
+          metrics_.memory_usage);
+        return chunks_[chunk_].get() + start;
+      }
+
+      // Chunks are kept between frames, so try the next one before growing.
+      if (chunk_ + 1 < chunks_.size()) {
+        chunk_++;
+        offset_ = 0;
+        continue;
+      }
+    }
+
+    // new[] memory is aligned for any fundamental type.
+    size_t chunk_size = std::max(chunk_size_, size + alignment);
+    chunks_.push_back(unique_ptr<char[]>(new char[chunk_size]));
+    chunk_sizes_.push_back(chunk_size);
+    metrics_.capacity += chunk_size;
+    chunk_ = chunks_.size() - 1;
+    offset_ = 0;
+  }
+}
+
+void FrameArena::Reset() {
+  for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it) {
+    it->fn(it->ptr);
+  }
+  destructors_.clear();
+
+  chunk_ = 0;
+  offset_ = 0;
+  metrics_.num_allocations = 0;
+  metrics_.memory_usage = 0;
+}
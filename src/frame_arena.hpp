@@ -0,0 +1,67 @@
+#ifndef __FRAME_ARENA_HPP__
+#define __FRAME_ARENA_HPP__
+
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+struct FrameArenaMetrics {
+  int num_allocations = 0;
+  size_t memory_usage = 0;
+  size_t capacity = 0;
+
+  // Highest values seen since the arena was created.
+  int max_allocations = 0;
+  size_t max_memory_usage = 0;
+};
+
+// Bump allocator for objects that only live until the end of a frame. Memory
+// is kept in chunks that are reused after Reset, so once the arena has grown
+// to the frame's high-water mark it stops hitting the heap. Objects that need
+// a destructor have it called on Reset. Not thread safe: use one arena per
+// thread.
+class FrameArena {
+  struct Destructor {
+    void* ptr;
+    void (*fn)(void*);
+  };
+
+  size_t chunk_size_;
+  vector<unique_ptr<char[]>> chunks_;
+  vector<size_t> chunk_sizes_;
+  size_t chunk_ = 0;
+  size_t offset_ = 0;
+  vector<Destructor> destructors_;
+  FrameArenaMetrics metrics_;
+
+ public:
+  FrameArena(size_t chunk_size = 64 * 1024);
+  ~FrameArena();
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  void* Allocate(size_t size, size_t alignment);
+
+  template <class T, class... Args>
+  T* New(Args&&... args) {
+    T* obj = new (Allocate(sizeof(T), alignof(T))) T(forward<Args>(args)...);
+    if (!is_trivially_destructible<T>::value) {
+      destructors_.push_back({ obj, [] (void* ptr) {
+        static_cast<T*>(ptr)->~T();
+      }});
+    }
+    return obj;
+  }
+
+  // Destroys every object and rewinds to the first chunk.
+  void Reset();
+
+  const FrameArenaMetrics& GetMetrics() { return metrics_; }
+};
+
+#endif // __FRAME_ARENA_HPP__
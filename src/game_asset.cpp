@@ -392,6 +392,7 @@ void GameAsset::CalculateCollisionData() {
     }
     case COL_PERFECT: {
       aabb_tree = ConstructAABBTreeFromPolygons(collision_hull);
+      bvh = make_shared<Bvh>(collision_hull);
       break;
     }
     default: {
@@ -589,6 +590,7 @@ void GameAsset::LoadCollisionData(pugi::xml_node& xml) {
     aabb_tree = make_shared<AABBTreeNode>();
     const pugi::xml_node& node_xml = aabb_tree_xml.child("node");
     LoadAssetCollisionDataAux(aabb_tree, node_xml);
+    bvh = ConstructBvhFromAABBTree(aabb_tree);
   }
 
   const pugi::xml_node& bones_xml = xml.child("bones");
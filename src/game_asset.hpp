@@ -3,6 +3,7 @@
 
 #include "util.hpp"
 #include "collision.hpp"
+#include "bvh.hpp"
 
 #include <exception>
 #include <iostream>
@@ -81,6 +82,7 @@ class GameAsset : public enable_shared_from_this<GameAsset> {
   OBB obb;
   ConvexHull convex_hull;
   shared_ptr<AABBTreeNode> aabb_tree = nullptr;
+  shared_ptr<Bvh> bvh = nullptr;
 
   // Skeleton.
   unordered_map<int, string> bone_to_mesh_name; // TODO: think of something better.
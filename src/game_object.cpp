@@ -1,5 +1,6 @@
 #include "game_object.hpp"
 #include "resources.hpp"
+#include "compressed_animation.hpp"
 
 void GameObject::Load(const string& in_name, const string& asset_name, 
   const vec3& in_position) {
@@ -156,6 +157,17 @@ BoundingSphere GameObject::GetTransformedBoundingSphere() {
   return s;
 }
 
+GameObject::~GameObject() {
+  UnlinkFromOctree();
+}
+
+void GameObject::UnlinkFromOctree() {
+  for (int i = 0; i < kNumOctreeLists; i++) {
+    if (octree_links[i].list) octree_links[i].list->erase(this);
+  }
+  octree_node = nullptr;
+}
+
 shared_ptr<GameAsset> GameObject::GetAsset() {
   if (!asset_group) {
     throw runtime_error(string("No asset group for object ") + name);
@@ -396,8 +408,8 @@ OBB GameObject::GetTransformedOBB() {
       }
 
       const Animation& animation = mesh_ptr->animations[animation_name];
-      if (animation.keyframes.size() > 0) {
-        if (frame >= animation.keyframes.size()) {
+      if (GetNumFrames(animation) > 0) {
+        if (frame >= GetNumFrames(animation)) {
           throw runtime_error(string("Frame ") + 
             boost::lexical_cast<string>(frame) + " outside scope" + 
             " in GameObject:181 for mesh " + mesh_name +
@@ -405,7 +417,7 @@ OBB GameObject::GetTransformedOBB() {
         }
 
         int bone_id = 0;
-        joint_transform = animation.keyframes[frame].transforms[bone_id];
+        joint_transform = SampleAnimation(animation, bone_id, frame);
       }
     }
   }
@@ -424,7 +436,7 @@ OBB GameObject::GetTransformedOBB() {
 }
 
 void GameObject::ToXml(pugi::xml_node& parent) {
-  double time = glfwGetTime();
+  double time = GetTime();
   string ms = boost::lexical_cast<string>(time);
 
   pugi::xml_node node;
@@ -549,7 +561,7 @@ ObjPtr CreateGameObj(Resources* resources, const string& asset_name) {
     }
   }
 
-  obj->created_at = glfwGetTime();
+  obj->created_at = GetTime();
   return obj;
 }
 
@@ -1101,6 +1113,7 @@ void GameObject::CalculateCollisionData() {
 
       aabb = GetAABBFromPolygons(collision_hull);
       aabb_tree = ConstructAABBTreeFromPolygons(collision_hull);
+      bvh = make_shared<Bvh>(collision_hull);
       break;
     }
     default:
@@ -1188,6 +1201,7 @@ void GameObject::LoadCollisionData(pugi::xml_node& xml) {
     aabb_tree = make_shared<AABBTreeNode>();
     const pugi::xml_node& node_xml = aabb_tree_xml.child("node");
     LoadCollisionDataAux(aabb_tree, node_xml);
+    bvh = ConstructBvhFromAABBTree(aabb_tree);
   }
 
   const pugi::xml_node& bones_xml = xml.child("bones");
@@ -1228,7 +1242,7 @@ shared_ptr<Mesh> GameObject::GetMesh() {
 int GameObject::GetNumFramesInCurrentAnimation() {
   shared_ptr<Mesh> mesh = GetMesh();
   const Animation& animation = mesh->animations[active_animation];
-  return animation.keyframes.size();
+  return GetNumFrames(animation);
 }
 
 void GameObject::ChangePosition(const vec3& pos) {
@@ -1350,7 +1364,7 @@ bool GameObject::HasTemporaryStatus(Status status) {
     return false;
   }
 
-  double cur_time = glfwGetTime();
+  double cur_time = GetTime();
   if (cur_time > t_status->issued_at + t_status->duration) {
     return false;
   }
@@ -1384,8 +1398,8 @@ void GameObject::DealDamage(ObjPtr attacker, float damage, vec3 normal,
     return;
   }
 
-  if (IsPlayer() && configs->shield_of_protection && glfwGetTime() > configs->shield_of_protection_cooldown) {
-    configs->shield_of_protection_cooldown = glfwGetTime() + 60.0f;
+  if (IsPlayer() && configs->shield_of_protection && GetTime() > configs->shield_of_protection_cooldown) {
+    configs->shield_of_protection_cooldown = GetTime() + 60.0f;
     return;
   }
 
@@ -1648,7 +1662,7 @@ void GameObject::PopAction() {
   prev_action = actions.front();
   actions.pop();
   if (!actions.empty()) {
-    actions.front()->issued_at = glfwGetTime();
+    actions.front()->issued_at = GetTime();
   }
   resources_->Unlock();
 }
@@ -1670,7 +1684,7 @@ bool GameObject::CanCollideWithPlayer() {
 }
 
 bool GameObject::CanUseAbility(const string& ability) {
-  float current_time = glfwGetTime();
+  float current_time = GetTime();
   if (cooldowns.find(ability) != cooldowns.end()) {
     if (cooldowns[ability] > current_time) {
       return false;
@@ -3,6 +3,7 @@
 
 #include <set>
 #include "game_asset.hpp"
+#include "symbol.hpp"
 
 struct OctreeNode;
 struct StabbingTreeNode;
@@ -12,6 +13,25 @@ struct Action;
 struct TemporaryStatus;
 class Resources;
 class Region;
+class GameObject;
+class ObjectList;
+
+// The lists of an octree node that an object can be linked into.
+enum OctreeListType {
+  OCTREE_OBJECTS = 0,
+  OCTREE_MOVING_OBJS,
+  OCTREE_CREATURES,
+  OCTREE_LIGHTS,
+  OCTREE_ITEMS
+};
+
+const int kNumOctreeLists = 5;
+
+struct OctreeLink {
+  GameObject* prev = nullptr;
+  GameObject* next = nullptr;
+  ObjectList* list = nullptr;
+};
 
 class GameObject : public enable_shared_from_this<GameObject> {
  protected:
@@ -23,6 +43,9 @@ class GameObject : public enable_shared_from_this<GameObject> {
 
   int id;
   string name;
+
+  // Interned name, set when the object is added to Resources.
+  Symbol name_symbol;
   shared_ptr<GameAssetGroup> asset_group = nullptr;
   vec3 position;
   vec3 prev_position = vec3(0, 0, 0);
@@ -77,6 +100,9 @@ class GameObject : public enable_shared_from_this<GameObject> {
   shared_ptr<Region> current_region = nullptr;
   shared_ptr<OctreeNode> octree_node;
 
+  // Links for the lists of octree_node, indexed by OctreeListType.
+  OctreeLink octree_links[kNumOctreeLists];
+
   // Mostly useful for skeleton. May be good to have a hierarchy of nodes.
   shared_ptr<GameObject> parent;
 
@@ -171,6 +197,9 @@ class GameObject : public enable_shared_from_this<GameObject> {
   GameObject(Resources* resources, GameObjectType type) 
     : resources_(resources), type(type) {
   }
+  ~GameObject();
+
+  void UnlinkFromOctree();
 
   shared_ptr<GameAsset> GetAsset();
   shared_ptr<GameAssetGroup> GetAssetGroup();
@@ -226,6 +255,7 @@ class GameObject : public enable_shared_from_this<GameObject> {
   BoundingSphere bounding_sphere = BoundingSphere(vec3(0.0), 0.0);
   AABB aabb = AABB(vec3(0.0), vec3(0.0));
   shared_ptr<AABBTreeNode> aabb_tree = nullptr;
+  shared_ptr<Bvh> bvh = nullptr;
   OBB obb;
   ConvexHull collision_hull; // TODO: should be removed.
 
@@ -421,7 +451,7 @@ struct TemporaryStatus {
 
   TemporaryStatus(Status status, float duration, int strength) : 
     status(status), duration(duration), strength(strength) {
-    issued_at = glfwGetTime();
+    issued_at = GetTime();
   }
 };
 
@@ -528,7 +558,7 @@ struct Action {
   float issued_at;
 
   Action(ActionType type) : type(type) {
-    issued_at = glfwGetTime();
+    issued_at = GetTime();
   }
 };
 
@@ -11,17 +11,17 @@ GameScreen::GameScreen(shared_ptr<Resources> asset_catalog,
 
 void GameScreen::UpdateMouse(GLFWwindow* window) {
   double x_pos, y_pos;
-  glfwGetCursorPos(window, &x_pos, &y_pos);
+  GetInputCursorPos(window, &x_pos, &y_pos);
   mouse_x_ = x_pos;
   mouse_y_ = y_pos;
 
-  lft_click_ = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-  rgt_click_ = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+  lft_click_ = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+  rgt_click_ = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
   if (mouse_x_ < 0) mouse_x_ = 0; 
   if (mouse_x_ > kWindowWidth - 1) mouse_x_ = kWindowWidth - 1; 
   if (mouse_y_ < 0) mouse_y_ = 0; 
   if (mouse_y_ > kWindowHeight) mouse_y_ = kWindowHeight; 
-  glfwSetCursorPos(window, mouse_x_, mouse_y_); 
+  SetInputCursorPos(window, mouse_x_, mouse_y_); 
 }
 
 bool GameScreen::IsMouseInRectangle(int left, int right, int bottom, int top) {
@@ -36,7 +36,7 @@ bool GameScreen::IsMouseInCircle(const ivec2& pos, float circle) {
 void GameScreen::ProcessInput() {
   UpdateMouse(window_);
 
-  if (glfwGetKey(window_, GLFW_KEY_SPACE) == GLFW_PRESS ||
+  if (GetInputKey(window_, GLFW_KEY_SPACE) == GLFW_PRESS ||
     (IsMouseInRectangle(200, 300, 300, 200) && lft_click_)) {
     resources_->RestartGame();
     resources_->SetGameState(STATE_GAME);
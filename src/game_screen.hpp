@@ -3,6 +3,7 @@
 
 #include "2d.hpp"
 #include "resources.hpp"
+#include "replay.hpp"
 
 using namespace std;
 using namespace glm;
@@ -1,89 +1,340 @@
 #include "util.hpp"
 #include "height_map.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t kHeightMapMagic = 0x50414d48; // "HMAP"
+const uint32_t kHeightMapVersion = 1;
+const size_t kTileAlignment = 4096;
+const size_t kTileBytes = kHeightMapTileSize * kHeightMapTileSize * 3;
+
+// GetHeightNoise is -200 plus a 100 high gaussian and three octaves.
+const float kMaxNoiseHeight = 102.0f;
+const vec2 kNoiseCenter = vec2(11768, 7687);
+
+struct HeightMapHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t tile_size;
+  uint32_t num_tiles;
+  uint32_t padding;
+};
+
+// Offset from the start of the file and the range of the heights of the
+// tile, including the first row and column of the next tiles.
+struct HeightMapTileEntry {
+  uint64_t offset;
+  float min_height;
+  float max_height;
+};
+
+float DecodeHeight(const unsigned char* point) {
+  unsigned short h = (point[0] << 8) + point[1];
+  return float(h - 8192) / 32.0f;
+}
+
+int FloorDiv(int a, int b) {
+  return (a >= 0) ? a / b : -((-a - 1) / b) - 1;
+}
+
+// Shifted as unsigned, since shifting a negative value is undefined.
+uint64_t GetCacheKey(ivec2 tile) {
+  return (uint64_t(uint32_t(tile.x)) << 32) | uint32_t(tile.y);
+}
+
+size_t Align(size_t offset) {
+  return (offset + kTileAlignment - 1) / kTileAlignment * kTileAlignment;
+}
+
+void ConvertLegacyHeightMap(const string& legacy_filename,
+  const string& filename) {
+  FILE* f = fopen(legacy_filename.c_str(), "rb");
+  if (!f) {
+    throw runtime_error("Couldn't open height map " + legacy_filename);
+  }
+
+  vector<unsigned char> points(size_t(kHeightMapSize) * kHeightMapSize * 3);
+  size_t num_bytes = fread(points.data(), sizeof(unsigned char), 
+    points.size(), f);
+  fclose(f);
+  if (num_bytes != points.size()) {
+    throw runtime_error("Truncated height map " + legacy_filename);
+  }
+  SaveTiledHeightMap(filename, points.data(), kHeightMapSize);
+}
+
+} // namespace
+
+void SaveTiledHeightMap(const string& filename, const unsigned char* points,
+  int size) {
+  HeightMapHeader header;
+  memset(&header, 0, sizeof(HeightMapHeader));
+  header.magic = kHeightMapMagic;
+  header.version = kHeightMapVersion;
+  header.size = size;
+  header.tile_size = kHeightMapTileSize;
+  header.num_tiles = (size + kHeightMapTileSize - 1) / kHeightMapTileSize;
+
+  const int num_tiles = header.num_tiles;
+  vector<HeightMapTileEntry> entries(num_tiles * num_tiles);
+  size_t offset = Align(sizeof(HeightMapHeader) + 
+    entries.size() * sizeof(HeightMapTileEntry));
+  for (int ty = 0; ty < num_tiles; ty++) {
+    for (int tx = 0; tx < num_tiles; tx++) {
+      HeightMapTileEntry& entry = entries[ty * num_tiles + tx];
+      entry.offset = offset;
+      entry.min_height = numeric_limits<float>::max();
+      entry.max_height = -numeric_limits<float>::max();
+      offset += Align(kTileBytes);
+
+      int x1 = std::min((tx + 1) * kHeightMapTileSize, size - 1);
+      int y1 = std::min((ty + 1) * kHeightMapTileSize, size - 1);
+      for (int y = ty * kHeightMapTileSize; y <= y1; y++) {
+        for (int x = tx * kHeightMapTileSize; x <= x1; x++) {
+          float h = DecodeHeight(&points[(size_t(y) * size + x) * 3]);
+          entry.min_height = std::min(entry.min_height, h);
+          entry.max_height = std::max(entry.max_height, h);
+        }
+      }
+    }
+  }
+
+  AtomicWriteFile(filename, [&] (ostream& os) {
+    string bytes(Align(sizeof(HeightMapHeader) + 
+      entries.size() * sizeof(HeightMapTileEntry)), '\0');
+    memcpy(&bytes[0], &header, sizeof(HeightMapHeader));
+    memcpy(&bytes[sizeof(HeightMapHeader)], entries.data(), 
+      entries.size() * sizeof(HeightMapTileEntry));
+    os.write(bytes.data(), bytes.size());
+
+    // Points past the edge of the map are zero.
+    vector<unsigned char> tile(Align(kTileBytes));
+    for (int ty = 0; ty < num_tiles; ty++) {
+      for (int tx = 0; tx < num_tiles; tx++) {
+        fill(tile.begin(), tile.end(), 0);
+        int x0 = tx * kHeightMapTileSize;
+        int width = std::min(kHeightMapTileSize, size - x0);
+        for (int y = 0; y < kHeightMapTileSize; y++) {
+          int hm_y = ty * kHeightMapTileSize + y;
+          if (hm_y >= size) break;
+          memcpy(&tile[y * kHeightMapTileSize * 3], 
+            &points[(size_t(hm_y) * size + x0) * 3], width * 3);
+        }
+        os.write((const char*) tile.data(), tile.size());
+      }
+    }
+  });
+}
+
 HeightMap::HeightMap(const string& filename) : filename_(filename) {
   Load();
 }
 
 void HeightMap::Load() {
   cout << "Started loading height map" << endl;
-  FILE* f = fopen(filename_.c_str(), "rb");
-  if (!f) {
-    throw runtime_error("Couldn't open height map " + string(filename_));
+  struct stat st;
+  if (stat(filename_.c_str(), &st) != 0) {
+    const string legacy_filename = ReplaceExtension(filename_, ".dat");
+    cout << "Converting " << legacy_filename << " to a tiled height map" 
+      << endl;
+    ConvertLegacyHeightMap(legacy_filename, filename_);
+  }
+
+  file_ = make_unique<MappedFile>(filename_);
+  HeightMapHeader header;
+  if (file_->size() < sizeof(HeightMapHeader)) {
+    throw runtime_error("Invalid height map " + filename_);
+  }
+  memcpy(&header, file_->data(), sizeof(HeightMapHeader));
+  if (header.magic != kHeightMapMagic || 
+    header.version != kHeightMapVersion ||
+    header.tile_size != kHeightMapTileSize || 
+    header.num_tiles != (header.size + kHeightMapTileSize - 1) / 
+    kHeightMapTileSize) {
+    throw runtime_error("Invalid height map " + filename_);
+  }
+
+  size_ = header.size;
+  num_tiles_ = header.num_tiles;
+  const size_t num_entries = size_t(num_tiles_) * num_tiles_;
+  if (file_->size() < sizeof(HeightMapHeader) + 
+    num_entries * sizeof(HeightMapTileEntry)) {
+    throw runtime_error("Truncated height map " + filename_);
+  }
+
+  const char* entries = file_->data() + sizeof(HeightMapHeader);
+  tiles_.resize(num_entries);
+  for (int i = 0; i < num_entries; i++) {
+    HeightMapTileEntry entry;
+    memcpy(&entry, entries + i * sizeof(HeightMapTileEntry), 
+      sizeof(HeightMapTileEntry));
+    if (entry.offset > file_->size() || 
+      kTileBytes > file_->size() - entry.offset) {
+      throw runtime_error("Truncated height map " + filename_);
+    }
+    tiles_[i].data = (const unsigned char*) file_->data() + entry.offset;
+    tiles_[i].offset = entry.offset;
+    tiles_[i].min_height = entry.min_height;
+    tiles_[i].max_height = entry.max_height;
   }
 
-  int num_points = kHeightMapSize * kHeightMapSize;
-  int num_bytes = fread(compressed_height_map_, sizeof(unsigned char), 
-    num_points * 3, f);
+  edited_tiles_.clear();
+  resident_tiles_.clear();
+  {
+    unique_lock<shared_mutex> lock(cache_mutex_);
+    cache_tiles_.clear();
+    cache_order_.clear();
+  }
+  stream_center_ = ivec2(-1, -1);
   cout << "Ended loading height map" << endl;
 }
 
 void HeightMap::Save() {
-  string s = filename_;
-  FILE* f = fopen(s.c_str(), "wb");
-  if (!f) {
-    throw runtime_error(string("File ") + filename_ + " does not exist.");
+  vector<unsigned char> points(size_t(size_) * size_ * 3);
+  for (int y = 0; y < size_; y++) {
+    for (int x = 0; x < size_; x++) {
+      memcpy(&points[(size_t(y) * size_ + x) * 3], GetPoint(x, y), 3);
+    }
   }
+  SaveTiledHeightMap(filename_, points.data(), size_);
 
-  fwrite(compressed_height_map_, sizeof(unsigned char), 48000000, f);
-  fclose(f);
+  // Maps the new file, which has the edits.
+  Load();
 }
 
-float HeightMap::GetTerrainHeight(float x, float y) {
-  ivec2 top_left = ivec2(x, y);
+const unsigned char* HeightMap::GetPoint(int hm_x, int hm_y) {
+  const Tile& tile = tiles_[(hm_y / kHeightMapTileSize) * num_tiles_ + 
+    hm_x / kHeightMapTileSize];
+  return &tile.data[((hm_y % kHeightMapTileSize) * kHeightMapTileSize + 
+    hm_x % kHeightMapTileSize) * 3];
+}
 
-  TerrainPoint p[4];
-  p[0] = GetTerrainPoint(top_left.x, top_left.y);
-  p[1] = GetTerrainPoint(top_left.x, top_left.y + 1.1);
-  p[2] = GetTerrainPoint(top_left.x + 1.1, top_left.y + 1.1);
-  p[3] = GetTerrainPoint(top_left.x + 1.1, top_left.y);
+void HeightMap::StreamTiles(vec2 pos, int radius) {
+  vec2 hm_pos = pos - vec2(kWorldCenter.x, kWorldCenter.z) + 
+    vec2(size_ / 2);
+  ivec2 center = ivec2(floor(hm_pos / float(kHeightMapTileSize)));
+  if (center == stream_center_) return;
+  stream_center_ = center;
+
+  unordered_set<int> needed_tiles;
+  for (int ty = center.y - radius; ty <= center.y + radius; ty++) {
+    for (int tx = center.x - radius; tx <= center.x + radius; tx++) {
+      if (tx < 0 || ty < 0 || tx >= num_tiles_ || ty >= num_tiles_) continue;
+      needed_tiles.insert(ty * num_tiles_ + tx);
+    }
+  }
 
-  float v[4];
-  v[0] = p[0].height;
-  v[1] = p[1].height;
-  v[2] = p[2].height;
-  v[3] = p[3].height;
+  for (int tile : resident_tiles_) {
+    if (needed_tiles.count(tile) > 0) continue;
+    file_->Evict(tiles_[tile].offset, kTileBytes);
+  }
 
-  vec2 tile_v = vec2(x, y) - vec2(top_left);
+  for (int tile : needed_tiles) {
+    if (resident_tiles_.count(tile) > 0) continue;
+    file_->Prefetch(tiles_[tile].offset, kTileBytes);
+  }
+  resident_tiles_ = move(needed_tiles);
+}
 
-  // Top triangle.
-  float height;
-  if (tile_v.x + tile_v.y < 1.0f) {
-    height = v[0] + tile_v.x * (v[3] - v[0]) + tile_v.y * (v[1] - v[0]);
+float HeightMap::GetMaxTerrainHeight(vec2 pos) {
+  int hm_x = int(pos.x) - kWorldCenter.x + size_ / 2;
+  int hm_y = int(pos.y) - kWorldCenter.z + size_ / 2;
 
-  // Bottom triangle.
-  } else {
-    tile_v = vec2(1.0f) - tile_v; 
-    height = v[2] + tile_v.x * (v[1] - v[2]) + tile_v.y * (v[3] - v[2]);
+  // Points outside the map are noise blended with zero.
+  if (hm_x < 0 || hm_y < 0 || hm_x + 1 >= size_ || hm_y + 1 >= size_) {
+    return std::max(0.0f, kMaxNoiseHeight);
+  }
+
+  int tx = hm_x / kHeightMapTileSize;
+  int ty = hm_y / kHeightMapTileSize;
+  const Tile& tile = tiles_[ty * num_tiles_ + tx];
+
+  // The noise weight grows with the distance to the noise center, so it is
+  // largest at the farthest corner of the tile.
+  vec2 corner_min = vec2(tx, ty) * float(kHeightMapTileSize) + 
+    vec2(kWorldCenter.x, kWorldCenter.z) - vec2(size_ / 2);
+  vec2 corner_max = corner_min + vec2(kHeightMapTileSize + 1);
+  vec2 farthest = vec2(
+    (kNoiseCenter.x - corner_min.x > corner_max.x - kNoiseCenter.x) ? 
+      corner_min.x : corner_max.x,
+    (kNoiseCenter.y - corner_min.y > corner_max.y - kNoiseCenter.y) ? 
+      corner_min.y : corner_max.y);
+  if (GetNoiseWeight(farthest.x, farthest.y) > 0.0f) {
+    return std::max(tile.max_height, kMaxNoiseHeight);
   }
-  return height;
+  return tile.max_height;
 }
 
-float HeightMap::GetTerrainHeight(vec2 pos, vec3* normal) {
+float HeightMap::InterpolateHeight(const HeightSampler& sampler, vec2 pos,
+  vec3* normal) {
   ivec2 top_left = ivec2(pos.x, pos.y);
 
-  TerrainPoint p[4];
-  p[0] = GetTerrainPoint(top_left.x, top_left.y);
-  p[1] = GetTerrainPoint(top_left.x, top_left.y + 1.1);
-  p[2] = GetTerrainPoint(top_left.x + 1.1, top_left.y + 1.1);
-  p[3] = GetTerrainPoint(top_left.x + 1.1, top_left.y);
+  float v[4];
+  v[0] = sampler.Get(top_left.x, top_left.y);
+  v[1] = sampler.Get(top_left.x, top_left.y + 1);
+  v[2] = sampler.Get(top_left.x + 1, top_left.y + 1);
+  v[3] = sampler.Get(top_left.x + 1, top_left.y);
 
-  const float& h0 = p[0].height;
-  const float& h1 = p[1].height;
-  const float& h2 = p[2].height;
-  const float& h3 = p[3].height;
+  vec2 tile_v = pos - vec2(top_left);
 
   // Top triangle.
-  vec2 tile_v = pos - vec2(top_left);
   if (tile_v.x + tile_v.y < 1.0f) {
-    *normal = p[0].normal;
-    return h0 + tile_v.x * (h3 - h0) + tile_v.y * (h1 - h0);
+    if (normal) *normal = GetNormal(sampler, top_left.x, top_left.y);
+    return v[0] + tile_v.x * (v[3] - v[0]) + tile_v.y * (v[1] - v[0]);
 
   // Bottom triangle.
   } else {
-    *normal = p[2].normal;
+    if (normal) *normal = GetNormal(sampler, top_left.x + 1, top_left.y + 1);
     tile_v = vec2(1.0f) - tile_v; 
-    return h2 + tile_v.x * (h1 - h2) + tile_v.y * (h3 - h2);
+    return v[2] + tile_v.x * (v[1] - v[2]) + tile_v.y * (v[3] - v[2]);
+  }
+}
+
+vec3 HeightMap::GetNormal(const HeightSampler& sampler, int x, int y) {
+  vec3 a = vec3(x    , sampler.Get(x, y), y    );
+  vec3 b = vec3(x + 1, sampler.Get(x + 1, y), y    );
+  vec3 c = vec3(x    , sampler.Get(x, y + 1), y + 1);
+  return normalize(cross(c - a, b - a));
+}
+
+float HeightMap::GetTerrainHeight(float x, float y) {
+  shared_lock<shared_mutex> lock(cache_mutex_, defer_lock);
+  HeightSampler sampler = GetSampler(ivec2(x, y), true, lock);
+  return InterpolateHeight(sampler, vec2(x, y), nullptr);
+}
+
+float HeightMap::GetTerrainHeight(vec2 pos, vec3* normal) {
+  shared_lock<shared_mutex> lock(cache_mutex_, defer_lock);
+  HeightSampler sampler = GetSampler(ivec2(pos.x, pos.y), true, lock);
+  return InterpolateHeight(sampler, pos, normal);
+}
+
+void HeightMap::GetTerrainHeights(const vector<vec2>& positions,
+  vector<float>& heights, vector<vec3>* normals) {
+  heights.resize(positions.size());
+  if (normals) normals->resize(positions.size());
+
+  // Nearby positions share a cache tile, so the lookup is only done when
+  // the tile changes.
+  shared_lock<shared_mutex> lock(cache_mutex_, defer_lock);
+  HeightSampler sampler = { this, nullptr };
+  ivec2 current_tile;
+  for (int i = 0; i < positions.size(); i++) {
+    ivec2 top_left = ivec2(positions[i].x, positions[i].y);
+    ivec2 tile = GetCacheTileCoords(top_left);
+    if (!sampler.tile || tile != current_tile) {
+      if (lock.owns_lock()) lock.unlock();
+      sampler = GetSampler(top_left, true, lock);
+      current_tile = tile;
+    }
+    heights[i] = InterpolateHeight(sampler, positions[i], 
+      normals ? &(*normals)[i] : nullptr);
   }
 }
 
@@ -99,64 +350,169 @@ float HeightMap::GetHeightNoise(float x, float y) {
            100.0f * noise_.noise(1000 + x * 0.0001, 1000 + y * 0.0001);
 }
 
-TerrainPoint HeightMap::GetTerrainPoint(int x, int y, bool calculate_normal) {
-  int hm_x = x - kWorldCenter.x;
-  int hm_y = y - kWorldCenter.z;
+// Same as GetHeightNoise for each point, with each octave evaluated for
+// all the points at once.
+void HeightMap::GetHeightNoise(const float* x, const float* y, int count,
+  float* out) {
+  vector<float> u(count), v(count), n0(count), n1(count), n2(count);
+  for (int i = 0; i < count; i++) {
+    u[i] = x[i] * 0.001f;
+    v[i] = y[i] * 0.001f;
+  }
+  noise_.noise(u.data(), v.data(), count, n0.data());
+
+  for (int i = 0; i < count; i++) {
+    u[i] = 2000 + x[i] * 0.01;
+    v[i] = 2000 + y[i] * 0.01;
+  }
+  noise_.noise(u.data(), v.data(), count, n1.data());
+
+  for (int i = 0; i < count; i++) {
+    u[i] = 1000 + x[i] * 0.0001;
+    v[i] = 1000 + y[i] * 0.0001;
+  }
+  noise_.noise(u.data(), v.data(), count, n2.data());
+
+  for (int i = 0; i < count; i++) {
+    float h = -200.0f;
+    if (abs(x[i] + y[i]) > 0.1f) {
+      h += 100.0f * exp(-((x[i] * x[i]) / 2 + (y[i] * y[i]) / 2));
+    }
+    out[i] = h + 100.0f * n0[i] + 2.0f * n1[i] + 100.0f * n2[i];
+  }
+}
 
-  float x_ = x - 11768;
-  float y_ = y - 7687;
-  float alpha_noise = sqrt(x_ * x_ + y_ * y_ + 1.0f) / (kHeightMapSize / 2.0f);
+// Far from the noise center the map fades into the noise.
+float HeightMap::GetNoiseWeight(float x, float y) {
+  float x_ = x - kNoiseCenter.x;
+  float y_ = y - kNoiseCenter.y;
+  float alpha_noise = sqrt(x_ * x_ + y_ * y_ + 1.0f) / (size_ / 2.0f);
   const float min_k = 0.5f;
   const float max_k = 1.0f;
+  return (clamp(alpha_noise, min_k, max_k) - min_k) / (max_k - min_k);
+}
 
-  alpha_noise = (clamp(alpha_noise, min_k, max_k) - min_k) / (max_k - min_k);
-  float h_noise = GetHeightNoise(x_, y_);
+float HeightMap::GetMapHeight(int x, int y) {
+  int hm_x = x - kWorldCenter.x + size_ / 2;
+  int hm_y = y - kWorldCenter.z + size_ / 2;
+  if (hm_x < 0 || hm_y < 0 || hm_x >= size_ || hm_y >= size_) return 0.0f;
+  return DecodeHeight(GetPoint(hm_x, hm_y));
+}
 
-  hm_x += kHeightMapSize / 2;
-  hm_y += kHeightMapSize / 2;
+float HeightMap::ComputeHeight(int x, int y) {
+  float h = GetMapHeight(x, y);
 
-  TerrainPoint p;
-  if (hm_x < 0 || hm_y < 0 || hm_x >= kHeightMapSize || 
-      hm_y >= kHeightMapSize) {
-    float n = 10; 
-    vec3 v_1 = vec3(hm_x + 0, GetHeightNoise(x + 0, y + 0), y + 0);
-    vec3 v_2 = vec3(hm_x + 0, GetHeightNoise(x + 0, y + n), y + n);
-    vec3 v_3 = vec3(hm_x + n, GetHeightNoise(x + n, y + n), y + n);
-    vec3 v_4 = vec3(hm_x + n, GetHeightNoise(x + n, y + 0), y + 0);
-
-    vec3 a = v_2 - v_1;
-    vec3 b = v_3 - v_1;
-    p.normal = cross(a, b);
-    p.blending = vec3(1.0f, 0, 0);
-  } else {
-    int index = hm_x + hm_y * kHeightMapSize;
+  // Most of the map is not blended, so the noise is often skipped.
+  float alpha_noise = GetNoiseWeight(x, y);
+  if (alpha_noise == 0.0f) return h;
 
-    unsigned short h;
-    unsigned char b1 = compressed_height_map_[3*index];
-    unsigned char b2 = compressed_height_map_[3*index+1];
-    unsigned char b3 = compressed_height_map_[3*index+2];
-    h = (b1 << 8) + b2;
+  float h_noise = GetHeightNoise(x - kNoiseCenter.x, y - kNoiseCenter.y);
+  return alpha_noise * h_noise + (1 - alpha_noise) * h;
+}
+
+ivec2 HeightMap::GetCacheTileCoords(ivec2 point) {
+  return ivec2(FloorDiv(point.x, kHeightCacheTileSize), 
+    FloorDiv(point.y, kHeightCacheTileSize));
+}
 
-    p.height = float(h - 8192) / 32.0f;
-    p.tile = b3;
+void HeightMap::BakeCacheTile(ivec2 tile) {
+  unique_ptr<CacheTile> cache_tile = make_unique<CacheTile>();
+  cache_tile->origin = tile * kHeightCacheTileSize;
+  cache_tile->heights.resize(kHeightCacheStride * kHeightCacheStride);
+
+  // The noise of the blended points is evaluated in one batch, the same
+  // way ComputeHeight blends it.
+  vector<int> blended;
+  vector<float> alphas, noise_x, noise_y;
+  for (int y = 0; y < kHeightCacheStride; y++) {
+    for (int x = 0; x < kHeightCacheStride; x++) {
+      const int world_x = cache_tile->origin.x + x;
+      const int world_y = cache_tile->origin.y + y;
+      const int i = y * kHeightCacheStride + x;
+      cache_tile->heights[i] = GetMapHeight(world_x, world_y);
+
+      float alpha_noise = GetNoiseWeight(world_x, world_y);
+      if (alpha_noise == 0.0f) continue;
+      blended.push_back(i);
+      alphas.push_back(alpha_noise);
+      noise_x.push_back(world_x - kNoiseCenter.x);
+      noise_y.push_back(world_y - kNoiseCenter.y);
+    }
+  }
+
+  vector<float> h_noise(blended.size());
+  GetHeightNoise(noise_x.data(), noise_y.data(), blended.size(),
+    h_noise.data());
+  for (int k = 0; k < blended.size(); k++) {
+    float& h = cache_tile->heights[blended[k]];
+    h = alphas[k] * h_noise[k] + (1 - alphas[k]) * h;
+  }
 
+  unique_lock<shared_mutex> lock(cache_mutex_);
+  const uint64_t key = GetCacheKey(tile);
+  if (cache_tiles_.find(key) != cache_tiles_.end()) return;
+  cache_tiles_[key] = move(cache_tile);
+  cache_order_.push_back(key);
+
+  // Evicts the oldest tiles, which are usually the farthest from the player.
+  while (cache_order_.size() > kMaxHeightCacheTiles) {
+    cache_tiles_.erase(cache_order_.front());
+    cache_order_.pop_front();
+  }
+}
+
+HeightMap::HeightSampler HeightMap::GetSampler(ivec2 point, bool bake,
+  shared_lock<shared_mutex>& lock) {
+  if (!cache_enabled_) return { this, nullptr };
+
+  const uint64_t key = GetCacheKey(GetCacheTileCoords(point));
+  lock.lock();
+  while (true) {
+    auto it = cache_tiles_.find(key);
+    if (it != cache_tiles_.end()) return { this, it->second.get() };
+    if (!bake) return { this, nullptr };
+
+    lock.unlock();
+    BakeCacheTile(GetCacheTileCoords(point));
+    lock.lock();
+  }
+}
+
+void HeightMap::EnableCache(bool enable) {
+  unique_lock<shared_mutex> lock(cache_mutex_);
+  cache_enabled_ = enable;
+  cache_tiles_.clear();
+  cache_order_.clear();
+}
+
+int HeightMap::GetNumCacheTiles() {
+  shared_lock<shared_mutex> lock(cache_mutex_);
+  return cache_tiles_.size();
+}
+
+// The clipmap samples the coarse levels one point per cache tile, so
+// terrain points only use the tiles that are already baked.
+TerrainPoint HeightMap::GetTerrainPoint(int x, int y, bool calculate_normal) {
+  int hm_x = x - kWorldCenter.x + size_ / 2;
+  int hm_y = y - kWorldCenter.z + size_ / 2;
+
+  TerrainPoint p;
+  if (hm_x < 0 || hm_y < 0 || hm_x >= size_ || hm_y >= size_) {
+    p.blending = vec3(1.0f, 0, 0);
+  } else {
+    p.tile = GetPoint(hm_x, hm_y)[2];
     p.blending = vec3(0, 0, 0);
     if (p.tile > 0 && p.tile < 4) {
       p.blending[p.tile-1] = 1.0f;
     }
-
-    if (!calculate_normal) {
-      return p;
-    }
-
-    vec3 a = vec3(x    , p.height, y    );
-    vec3 b = vec3(x + 1, GetTerrainPoint(x+1, y, false).height, y    );
-    vec3 c = vec3(x    , GetTerrainPoint(x, y+1, false).height, y + 1);
-    p.normal = normalize(cross(c - a, b - a));
   }
 
-  p.height = alpha_noise * h_noise + (1 - alpha_noise) * p.height;
-  // p.height = alpha_noise * 50.0f;
+  shared_lock<shared_mutex> lock(cache_mutex_, defer_lock);
+  HeightSampler sampler = GetSampler(ivec2(x, y), false, lock);
+  p.height = sampler.Get(x, y);
+  if (calculate_normal) {
+    p.normal = GetNormal(sampler, x, y);
+  }
   return p;
 }
 
@@ -164,21 +520,60 @@ void HeightMap::SetTerrainPoint(int x, int y,
   const TerrainPoint& terrain_point) {
   int hm_x = x - kWorldCenter.x;
   int hm_y = y - kWorldCenter.z;
-  hm_x += kHeightMapSize / 2;
-  hm_y += kHeightMapSize / 2;
+  hm_x += size_ / 2;
+  hm_y += size_ / 2;
 
-  if (hm_x < 0 || hm_y < 0 || 
-    hm_x >= kHeightMapSize-1 || hm_y >= kHeightMapSize-1) {
+  if (hm_x < 0 || hm_y < 0 || hm_x >= size_ - 1 || hm_y >= size_ - 1) {
     return;
   }
 
-  int index = hm_x + hm_y * kHeightMapSize;
+  int tx = hm_x / kHeightMapTileSize;
+  int ty = hm_y / kHeightMapTileSize;
+  int tile = ty * num_tiles_ + tx;
+  auto it = edited_tiles_.find(tile);
+  if (it == edited_tiles_.end()) {
+    it = edited_tiles_.emplace(tile, vector<unsigned char>(tiles_[tile].data,
+      tiles_[tile].data + kTileBytes)).first;
+    tiles_[tile].data = it->second.data();
+  }
 
   int h2 = terrain_point.height * 32;
   if (h2 < -8192) h2 = -8192;
   if (h2 >= 57344) h2 = 57343;
   unsigned short compressed_h = (unsigned short) h2 + 8192;
-  compressed_height_map_[3*index] = (unsigned char) (compressed_h >> 8);
-  compressed_height_map_[3*index+1] = (unsigned char) (compressed_h & 255);
-  compressed_height_map_[3*index+2] = (unsigned char) terrain_point.tile;
+
+  unsigned char* point = &it->second[((hm_y % kHeightMapTileSize) * 
+    kHeightMapTileSize + hm_x % kHeightMapTileSize) * 3];
+  point[0] = (unsigned char) (compressed_h >> 8);
+  point[1] = (unsigned char) (compressed_h & 255);
+  point[2] = (unsigned char) terrain_point.tile;
+
+  // Cache tiles overlap by two rows and columns.
+  {
+    unique_lock<shared_mutex> lock(cache_mutex_);
+    for (int dy = 0; dy <= 2; dy++) {
+      for (int dx = 0; dx <= 2; dx++) {
+        const uint64_t key = GetCacheKey(GetCacheTileCoords(
+          ivec2(x - dx, y - dy)));
+        if (!cache_tiles_.erase(key)) continue;
+
+        // Otherwise the stale entry would evict the tile once it is baked
+        // again.
+        cache_order_.erase(remove(cache_order_.begin(), cache_order_.end(),
+          key), cache_order_.end());
+      }
+    }
+  }
+
+  // The first row and column of a tile also bound the previous tiles.
+  const float h = DecodeHeight(point);
+  bool first_x = tx > 0 && hm_x % kHeightMapTileSize == 0;
+  bool first_y = ty > 0 && hm_y % kHeightMapTileSize == 0;
+  for (int dy = first_y ? -1 : 0; dy <= 0; dy++) {
+    for (int dx = first_x ? -1 : 0; dx <= 0; dx++) {
+      Tile& t = tiles_[(ty + dy) * num_tiles_ + tx + dx];
+      t.min_height = std::min(t.min_height, h);
+      t.max_height = std::max(t.max_height, h);
+    }
+  }
 }
@@ -1,7 +1,27 @@
 #ifndef __HEIGHT_MAP_HPP__
 #define __HEIGHT_MAP_HPP__
 
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "mapped_file.hpp"
 #include "simplex_noise.hpp"
+#include "util.hpp"
+
+// Points per side of a height map tile. Tiles are paged in from the mapped
+// file as they are touched.
+const int kHeightMapTileSize = 256;
+
+// Points per side of a tile of the height cache, which holds the heights
+// with the noise detail. The tiles store two more rows and columns, so the
+// heights and the normals of a query never need a second tile.
+const int kHeightCacheTileSize = 64;
+const int kHeightCacheStride = kHeightCacheTileSize + 2;
+const int kMaxHeightCacheTiles = 1024; // 17 KB each.
 
 struct TerrainPoint {
   float height = 0.0;
@@ -15,20 +35,114 @@ struct TerrainPoint {
   TerrainPoint(float height) : height(height) {}
 };
 
+// Writes a tiled height map from size x size points of 3 bytes, row by row:
+// a 16 bit height followed by the terrain type.
+void SaveTiledHeightMap(const string& filename, const unsigned char* points,
+  int size);
+
+// The map is stored in square tiles aligned to pages, each with the range of
+// its heights. The file is memory mapped, so only the tiles that are read
+// are loaded, and StreamTiles keeps the tiles around the player resident.
+// If the file is missing, it is converted from the old untiled map with the
+// same name and the extension ".dat".
 class HeightMap {
+  // Points either into the mapping or into an edited copy.
+  struct Tile {
+    const unsigned char* data;
+    size_t offset;
+    float min_height;
+    float max_height;
+  };
+
   const string filename_;
-  unsigned char compressed_height_map_[48000000]; // 48 MB.
+  unique_ptr<MappedFile> file_;
+  int size_ = 0;
+  int num_tiles_ = 0;
+  vector<Tile> tiles_;
+
+  // The mapping is read only, so edited tiles are copied out of it.
+  unordered_map<int, vector<unsigned char>> edited_tiles_;
+
+  ivec2 stream_center_ = ivec2(-1, -1);
+  unordered_set<int> resident_tiles_;
+
+  struct CacheTile {
+    ivec2 origin;
+    vector<float> heights;
+  };
+
+  // Heights come from a cache tile if there is one, or are computed.
+  struct HeightSampler {
+    HeightMap* height_map;
+    const CacheTile* tile;
+
+    float Get(int x, int y) const {
+      if (!tile) return height_map->ComputeHeight(x, y);
+      return tile->heights[(y - tile->origin.y) * kHeightCacheStride + 
+        x - tile->origin.x];
+    }
+  };
+
+  // Queries run on the physics jobs, so tiles are read with a shared lock
+  // and baked without holding it.
+  shared_mutex cache_mutex_;
+  unordered_map<uint64_t, unique_ptr<CacheTile>> cache_tiles_;
+  deque<uint64_t> cache_order_;
+  bool cache_enabled_ = true;
+
   SimplexNoise noise_;
 
   void Load();
   float GetHeightNoise(float x, float y);
+  void GetHeightNoise(const float* x, const float* y, int count, float* out);
+  float GetNoiseWeight(float x, float y);
+  const unsigned char* GetPoint(int hm_x, int hm_y);
+
+  // Height of a point in the map, without the noise. Zero outside the map.
+  float GetMapHeight(int x, int y);
+
+  // Final height of a point, with the noise detail.
+  float ComputeHeight(int x, int y);
+
+  ivec2 GetCacheTileCoords(ivec2 point);
+  void BakeCacheTile(ivec2 tile);
+
+  // Locks the cache and returns a sampler for the tile of the point. The
+  // tile is baked if it is missing and bake is true.
+  HeightSampler GetSampler(ivec2 point, bool bake,
+    shared_lock<shared_mutex>& lock);
+  float InterpolateHeight(const HeightSampler& sampler, vec2 pos,
+    vec3* normal);
+  vec3 GetNormal(const HeightSampler& sampler, int x, int y);
 
  public:
   HeightMap(const string& filename);
 
   void Save();
+
+  int GetSize() { return size_; }
+  int GetNumResidentTiles() { return resident_tiles_.size(); }
+
+  // Prefetches the tiles within radius tiles of the position and lets the
+  // OS drop the rest. Cheap when the position stays in the same tile.
+  void StreamTiles(vec2 pos, int radius = 2);
+
+  // Upper bound of the terrain height anywhere in the tile that contains
+  // the position, for rejecting objects that are far above the ground.
+  float GetMaxTerrainHeight(vec2 pos);
+
   float GetTerrainHeight(float, float);
   float GetTerrainHeight(vec2 pos, vec3* normal);
+
+  // Same as GetTerrainHeight for each position. Faster when nearby
+  // positions are grouped.
+  void GetTerrainHeights(const vector<vec2>& positions,
+    vector<float>& heights, vector<vec3>* normals = nullptr);
+
+  // Without the cache every query evaluates the noise. Also clears it.
+  void EnableCache(bool enable);
+  int GetNumCacheTiles();
+
   TerrainPoint GetTerrainPoint(int x, int y, bool calculate_normal=true);
   void SetTerrainPoint(int x, int y, const TerrainPoint& terrain_point);
 };
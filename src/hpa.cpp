@@ -0,0 +1,366 @@
+#include "hpa.hpp"
+#include "dungeon.hpp"
+
+#include <chrono>
+#include <queue>
+
+namespace {
+
+const float kInfinity = 9999999;
+
+// Runs of passable border tiles at least this long get an entrance at each
+// end instead of a single one in the middle.
+const int kMinDoubleEntranceRun = 6;
+
+float OctileDistance(const ivec2& a, const ivec2& b) {
+  int dx = abs(a.x - b.x);
+  int dy = abs(a.y - b.y);
+  return std::min(dx, dy) * 1.4f + abs(dx - dy) * 1.0f;
+}
+
+typedef priority_queue<pair<float, int>, vector<pair<float, int>>,
+  greater<pair<float, int>>> MinHeap;
+
+} // namespace
+
+bool HpaPlanner::Bounds::Contains(const ivec2& tile) const {
+  return tile.x >= min.x && tile.x <= max.x && tile.y >= min.y &&
+    tile.y <= max.y;
+}
+
+HpaPlanner::HpaPlanner(Dungeon* dungeon, int size, int cluster_size)
+  : dungeon_(dungeon), size_(size), cluster_size_(cluster_size) {
+  num_clusters_ = (size_ + cluster_size_ - 1) / cluster_size_;
+}
+
+void HpaPlanner::Invalidate() {
+  lock_guard<mutex> lock(mutex_);
+  dirty_ = true;
+}
+
+int HpaPlanner::GetCluster(const ivec2& tile) {
+  return (tile.x / cluster_size_) * num_clusters_ + tile.y / cluster_size_;
+}
+
+HpaPlanner::Bounds HpaPlanner::GetClusterBounds(int cluster) {
+  Bounds bounds;
+  bounds.min = ivec2(cluster / num_clusters_, cluster % num_clusters_) *
+    cluster_size_;
+  bounds.max = glm::min(bounds.min + ivec2(cluster_size_ - 1),
+    ivec2(size_ - 1));
+  return bounds;
+}
+
+int HpaPlanner::AddNode(const ivec2& tile) {
+  int cluster = GetCluster(tile);
+  for (int i : cluster_nodes_[cluster]) {
+    if (nodes_[i].tile == tile) return i;
+  }
+
+  nodes_.push_back({ tile, cluster, {} });
+  cluster_nodes_[cluster].push_back(nodes_.size() - 1);
+  return nodes_.size() - 1;
+}
+
+void HpaPlanner::AddEdge(int node1, int node2, float cost) {
+  nodes_[node1].edges.push_back({ node2, cost });
+  metrics_.num_edges++;
+}
+
+void HpaPlanner::AddEntrances(int cluster, bool horizontal) {
+  Bounds bounds = GetClusterBounds(cluster);
+
+  // The border between the clusters is the last column (or row) of
+  // the cluster and the first of its neighbour.
+  ivec2 step = horizontal ? ivec2(0, 1) : ivec2(1, 0);
+  ivec2 across = horizontal ? ivec2(1, 0) : ivec2(0, 1);
+  ivec2 start = horizontal ? ivec2(bounds.max.x, bounds.min.y) :
+    ivec2(bounds.min.x, bounds.max.y);
+  int length = horizontal ? bounds.max.y - bounds.min.y + 1 :
+    bounds.max.x - bounds.min.x + 1;
+
+  int run_start = -1;
+  for (int i = 0; i <= length; i++) {
+    bool passable = false;
+    if (i < length) {
+      ivec2 tile = start + step * i;
+      ivec2 next_tile = tile + across;
+      passable = dungeon_->IsTileClear(tile, next_tile) &&
+        dungeon_->IsTileClear(next_tile, tile);
+    }
+
+    if (passable) {
+      if (run_start == -1) run_start = i;
+      continue;
+    }
+    if (run_start == -1) continue;
+
+    int run_end = i - 1;
+    vector<int> entrances;
+    if (run_end - run_start + 1 >= kMinDoubleEntranceRun) {
+      entrances = { run_start, run_end };
+    } else {
+      entrances = { (run_start + run_end) / 2 };
+    }
+
+    for (int e : entrances) {
+      ivec2 tile = start + step * e;
+      int node1 = AddNode(tile);
+      int node2 = AddNode(tile + across);
+      AddEdge(node1, node2, 1.0f);
+      AddEdge(node2, node1, 1.0f);
+    }
+    run_start = -1;
+  }
+}
+
+void HpaPlanner::ConnectClusterNodes(int cluster) {
+  Bounds bounds = GetClusterBounds(cluster);
+  const int height = bounds.max.y - bounds.min.y + 1;
+
+  vector<float> distances;
+  vector<int> parents;
+  for (int i : cluster_nodes_[cluster]) {
+    SearchTiles(nodes_[i].tile, bounds, false, distances, parents);
+    for (int j : cluster_nodes_[cluster]) {
+      if (i == j) continue;
+      const ivec2 offset = nodes_[j].tile - bounds.min;
+      float distance = distances[offset.x * height + offset.y];
+      if (distance < kInfinity) {
+        AddEdge(i, j, distance);
+      }
+    }
+  }
+}
+
+void HpaPlanner::Build() {
+  double start_time = chrono::duration<double>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+
+  nodes_.clear();
+  cluster_nodes_.assign(num_clusters_ * num_clusters_, {});
+  metrics_ = HpaMetrics();
+
+  for (int x = 0; x < num_clusters_; x++) {
+    for (int y = 0; y < num_clusters_; y++) {
+      int cluster = x * num_clusters_ + y;
+      if (x + 1 < num_clusters_) {
+        AddEntrances(cluster, true);
+      }
+      if (y + 1 < num_clusters_) {
+        AddEntrances(cluster, false);
+      }
+    }
+  }
+
+  for (size_t cluster = 0; cluster < cluster_nodes_.size(); cluster++) {
+    ConnectClusterNodes(cluster);
+  }
+
+  metrics_.num_clusters = cluster_nodes_.size();
+  metrics_.num_nodes = nodes_.size();
+  metrics_.memory_usage = nodes_.size() * sizeof(HpaNode) +
+    metrics_.num_edges * sizeof(pair<int, float>) +
+    nodes_.size() * sizeof(int);
+  metrics_.build_time = chrono::duration<double>(
+    chrono::steady_clock::now().time_since_epoch()).count() - start_time;
+  dirty_ = false;
+}
+
+void HpaPlanner::SearchTiles(const ivec2& start, const Bounds& bounds,
+  bool reverse, vector<float>& distances, vector<int>& parents) {
+  const int width = bounds.max.x - bounds.min.x + 1;
+  const int height = bounds.max.y - bounds.min.y + 1;
+  distances.assign(width * height, kInfinity);
+  parents.assign(width * height, -1);
+  if (!bounds.Contains(start)) return;
+
+  auto index = [&] (const ivec2& tile) {
+    return (tile.x - bounds.min.x) * height + (tile.y - bounds.min.y);
+  };
+
+  MinHeap heap;
+  distances[index(start)] = 0.0f;
+  heap.push({ 0.0f, index(start) });
+  while (!heap.empty()) {
+    auto [distance, i] = heap.top();
+    heap.pop();
+    if (distance > distances[i]) continue;
+
+    ivec2 tile = bounds.min + ivec2(i / height, i % height);
+    for (int off_x = -1; off_x < 2; off_x++) {
+      for (int off_y = -1; off_y < 2; off_y++) {
+        if (off_x == 0 && off_y == 0) continue;
+
+        ivec2 next_tile = tile + ivec2(off_x, off_y);
+        if (!bounds.Contains(next_tile)) continue;
+
+        bool clear = (reverse) ? dungeon_->IsTileClear(next_tile, tile) :
+          dungeon_->IsTileClear(tile, next_tile);
+        if (!clear) continue;
+
+        float new_distance = distance +
+          ((off_x != 0 && off_y != 0) ? 1.4f : 1.0f);
+        int j = index(next_tile);
+        if (new_distance >= distances[j]) continue;
+
+        distances[j] = new_distance;
+        parents[j] = i;
+        heap.push({ new_distance, j });
+      }
+    }
+  }
+}
+
+vector<ivec2> HpaPlanner::FindAbstractPath(const ivec2& source,
+  const ivec2& dest) {
+  const int source_cluster = GetCluster(source);
+  const int dest_cluster = GetCluster(dest);
+  const Bounds source_bounds = GetClusterBounds(source_cluster);
+  const Bounds dest_bounds = GetClusterBounds(dest_cluster);
+  const int source_height = source_bounds.max.y - source_bounds.min.y + 1;
+  const int dest_height = dest_bounds.max.y - dest_bounds.min.y + 1;
+
+  // Connects source and dest to the entrances of their clusters.
+  vector<float> source_distances, dest_distances;
+  vector<int> parents;
+  SearchTiles(source, source_bounds, false, source_distances, parents);
+  SearchTiles(dest, dest_bounds, true, dest_distances, parents);
+
+  auto source_distance = [&] (const ivec2& tile) {
+    ivec2 offset = tile - source_bounds.min;
+    return source_distances[offset.x * source_height + offset.y];
+  };
+  auto dest_distance = [&] (const ivec2& tile) {
+    ivec2 offset = tile - dest_bounds.min;
+    return dest_distances[offset.x * dest_height + offset.y];
+  };
+
+  // A* where the last two indices are source and dest.
+  const int start = nodes_.size();
+  const int goal = nodes_.size() + 1;
+  vector<float> g(nodes_.size() + 2, kInfinity);
+  vector<int> came_from(nodes_.size() + 2, -1);
+  vector<bool> closed(nodes_.size() + 2, false);
+
+  auto tile_of = [&] (int node) {
+    if (node == start) return source;
+    if (node == goal) return dest;
+    return nodes_[node].tile;
+  };
+
+  MinHeap heap;
+  auto relax = [&] (int from, int to, float cost) {
+    if (cost >= kInfinity || closed[to]) return;
+    float new_g = g[from] + cost;
+    if (new_g >= g[to]) return;
+    g[to] = new_g;
+    came_from[to] = from;
+    heap.push({ new_g + OctileDistance(tile_of(to), dest), to });
+  };
+
+  g[start] = 0.0f;
+  heap.push({ OctileDistance(source, dest), start });
+  while (!heap.empty()) {
+    int node = heap.top().second;
+    heap.pop();
+    if (closed[node]) continue;
+    closed[node] = true;
+    if (node == goal) break;
+
+    if (node == start) {
+      for (int i : cluster_nodes_[source_cluster]) {
+        relax(start, i, source_distance(nodes_[i].tile));
+      }
+      if (source_cluster == dest_cluster) {
+        relax(start, goal, source_distance(dest));
+      }
+      continue;
+    }
+
+    for (auto& [next_node, cost] : nodes_[node].edges) {
+      relax(node, next_node, cost);
+    }
+    if (nodes_[node].cluster == dest_cluster) {
+      relax(node, goal, dest_distance(nodes_[node].tile));
+    }
+  }
+
+  if (!closed[goal]) return {};
+
+  vector<ivec2> waypoints;
+  for (int node = goal; node != start; node = came_from[node]) {
+    waypoints.push_back(tile_of(node));
+  }
+  reverse(waypoints.begin(), waypoints.end());
+  return waypoints;
+}
+
+vector<ivec2> HpaPlanner::RefineSegment(const ivec2& start,
+  const ivec2& end) {
+  // Segments stay inside one cluster or cross into a neighbor.
+  Bounds bounds1 = GetClusterBounds(GetCluster(start));
+  Bounds bounds2 = GetClusterBounds(GetCluster(end));
+  Bounds bounds = { glm::min(bounds1.min, bounds2.min),
+    glm::max(bounds1.max, bounds2.max) };
+  const int height = bounds.max.y - bounds.min.y + 1;
+
+  vector<float> distances;
+  vector<int> parents;
+  SearchTiles(start, bounds, false, distances, parents);
+
+  ivec2 offset = end - bounds.min;
+  int i = offset.x * height + offset.y;
+  if (distances[i] >= kInfinity) return {};
+
+  vector<ivec2> path;
+  for (; parents[i] != -1; i = parents[i]) {
+    path.push_back(bounds.min + ivec2(i / height, i % height));
+  }
+  reverse(path.begin(), path.end());
+  return path;
+}
+
+vector<ivec2> HpaPlanner::GetWaypoints(const ivec2& source,
+  const ivec2& dest) {
+  lock_guard<mutex> lock(mutex_);
+  if (dirty_) Build();
+  if (!dungeon_->IsValidTile(source) || !dungeon_->IsValidTile(dest)) {
+    return {};
+  }
+  return FindAbstractPath(source, dest);
+}
+
+vector<ivec2> HpaPlanner::GetPath(const ivec2& source, const ivec2& dest) {
+  vector<ivec2> waypoints = GetWaypoints(source, dest);
+  if (waypoints.empty()) return {};
+
+  lock_guard<mutex> lock(mutex_);
+  vector<ivec2> path { source };
+  for (const ivec2& waypoint : waypoints) {
+    if (waypoint == path.back()) continue;
+    vector<ivec2> segment = RefineSegment(path.back(), waypoint);
+    if (segment.empty()) return {};
+    path.insert(path.end(), segment.begin(), segment.end());
+  }
+  return path;
+}
+
+ivec2 HpaPlanner::GetNextTile(const ivec2& source, const ivec2& dest) {
+  vector<ivec2> waypoints = GetWaypoints(source, dest);
+
+  lock_guard<mutex> lock(mutex_);
+  for (const ivec2& waypoint : waypoints) {
+    if (waypoint == source) continue;
+    vector<ivec2> segment = RefineSegment(source, waypoint);
+    if (segment.empty()) return source;
+    return segment[0];
+  }
+  return source;
+}
+
+HpaMetrics HpaPlanner::GetMetrics() {
+  lock_guard<mutex> lock(mutex_);
+  if (dirty_) Build();
+  return metrics_;
+}
@@ -0,0 +1,89 @@
+#ifndef __HPA_HPP__
+#define __HPA_HPP__
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+class Dungeon;
+
+// Entrance tile on the border of a cluster. Edges to nodes of the same
+// cluster store the tile path cost inside the cluster, edges to the node on
+// the other side of the border cost one step.
+struct HpaNode {
+  ivec2 tile;
+  int cluster;
+  vector<pair<int, float>> edges;
+};
+
+struct HpaMetrics {
+  int num_clusters = 0;
+  int num_nodes = 0;
+  int num_edges = 0;
+  size_t memory_usage = 0;
+  double build_time = 0.0;
+};
+
+// Hierarchical path planner (HPA*) over the dungeon chambers. Each chamber
+// cell of the dungeon generator is a cluster; entrances are the passable
+// runs of tiles across the border of two neighboring chambers. Queries plan
+// on the graph of entrances and only search tiles inside the clusters they
+// need, so paths are not limited by the flow field radius.
+class HpaPlanner {
+  Dungeon* dungeon_;
+  int size_;
+  int cluster_size_;
+  int num_clusters_;
+
+  mutex mutex_;
+  bool dirty_ = true;
+  vector<HpaNode> nodes_;
+  vector<vector<int>> cluster_nodes_;
+  HpaMetrics metrics_;
+
+  struct Bounds {
+    ivec2 min;
+    ivec2 max;
+    bool Contains(const ivec2& tile) const;
+  };
+
+  int GetCluster(const ivec2& tile);
+  Bounds GetClusterBounds(int cluster);
+  void Build();
+  void AddEntrances(int cluster, bool horizontal);
+  int AddNode(const ivec2& tile);
+  void AddEdge(int node1, int node2, float cost);
+  void ConnectClusterNodes(int cluster);
+
+  // Dijkstra over the tiles inside bounds. With reverse, distances are from
+  // each tile to start instead of from start.
+  void SearchTiles(const ivec2& start, const Bounds& bounds, bool reverse,
+    vector<float>& distances, vector<int>& parents);
+
+  vector<ivec2> RefineSegment(const ivec2& start, const ivec2& end);
+  vector<ivec2> FindAbstractPath(const ivec2& source, const ivec2& dest);
+
+ public:
+  HpaPlanner(Dungeon* dungeon, int size, int cluster_size);
+
+  // The graph is rebuilt on the next query.
+  void Invalidate();
+
+  // Entrance tiles to go through, ending with dest. Empty if there is no
+  // path.
+  vector<ivec2> GetWaypoints(const ivec2& source, const ivec2& dest);
+
+  // Tile by tile path from source to dest, including both.
+  vector<ivec2> GetPath(const ivec2& source, const ivec2& dest);
+
+  // Only refines the first segment. Returns source when there is no path.
+  ivec2 GetNextTile(const ivec2& source, const ivec2& dest);
+
+  HpaMetrics GetMetrics();
+};
+
+#endif // __HPA_HPP__
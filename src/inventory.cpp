@@ -39,17 +39,17 @@ int Inventory::WhichItem(const int item_matrix[10][5], int x, int y,
 
 void Inventory::UpdateMouse(GLFWwindow* window) {
   double x_pos, y_pos;
-  glfwGetCursorPos(window, &x_pos, &y_pos);
+  GetInputCursorPos(window, &x_pos, &y_pos);
   mouse_x_ = x_pos;
   mouse_y_ = y_pos;
 
-  lft_click_ = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-  rgt_click_ = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+  lft_click_ = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+  rgt_click_ = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
   if (mouse_x_ < 0) mouse_x_ = 0; 
   if (mouse_x_ > kWindowWidth - 1) mouse_x_ = kWindowWidth - 1; 
   if (mouse_y_ < 0) mouse_y_ = 0; 
   if (mouse_y_ > kWindowHeight) mouse_y_ = kWindowHeight; 
-  glfwSetCursorPos(window, mouse_x_, mouse_y_); 
+  SetInputCursorPos(window, mouse_x_, mouse_y_); 
 }
 
 bool Inventory::IsMouseInRectangle(int left, int right, int bottom, int top) {
@@ -873,9 +873,9 @@ void Inventory::NextPhrase(GLFWwindow* window, const string& next_phrase_name) {
       enabled = false; 
       shared_ptr<CurrentDialog> current_dialog = resources_->GetCurrentDialog();
       current_dialog->enabled = false;
-      glfwSetCursorPos(window_, 0, 0);
+      SetInputCursorPos(window_, 0, 0);
       
-      glfwSetCursorPos(window, 0, 0);
+      SetInputCursorPos(window, 0, 0);
       resources_->SetGameState(STATE_GAME);
     }
   } else {
@@ -902,19 +902,19 @@ void Inventory::DrawDialog(GLFWwindow* window) {
   int num_options = cur_phrase.options.size();
 
   ObjPtr npc = current_dialog->npc;
-  if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS && throttle_ < 0) {
+  if (GetInputKey(window, GLFW_KEY_S) == GLFW_PRESS && throttle_ < 0) {
     throttle_ = 10;
 
     if (num_options > 0) {
       if (++cursor_pos_ > num_options - 1) cursor_pos_ = 0;
     }
-  } else if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && throttle_ < 0) {
+  } else if (GetInputKey(window, GLFW_KEY_W) == GLFW_PRESS && throttle_ < 0) {
     throttle_ = 10;
 
     if (num_options > 0) {
       if (--cursor_pos_ < 0) cursor_pos_ = num_options - 1;
     }
-  } else if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS && throttle_ < 0) {
+  } else if (GetInputKey(window, GLFW_KEY_ENTER) == GLFW_PRESS && throttle_ < 0) {
     if (num_options > 0) {
       if (cursor_pos_ > cur_phrase.options.size()) {
         throw runtime_error("Dialog option beyond scope.");
@@ -1020,23 +1020,23 @@ void Inventory::DrawSpellSelectionInterface(const Camera& camera, int win_x, int
   // }
 
   // if (throttle_ < 0) {
-  //   if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
+  //   if (GetInputKey(window, GLFW_KEY_W) == GLFW_PRESS) {
   //     throttle_ = 15;
   //     spell_selection_cursor_ += ivec2(0, -1);
-  //   } else if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+  //   } else if (GetInputKey(window, GLFW_KEY_S) == GLFW_PRESS) {
   //     throttle_ = 15;
   //     spell_selection_cursor_ += ivec2(0, +1);
-  //   } else if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
+  //   } else if (GetInputKey(window, GLFW_KEY_A) == GLFW_PRESS) {
   //     throttle_ = 15;
   //     spell_selection_cursor_ += ivec2(-1, 0);
-  //   } else if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
+  //   } else if (GetInputKey(window, GLFW_KEY_D) == GLFW_PRESS) {
   //     throttle_ = 15;
   //     spell_selection_cursor_ += ivec2(+1, 0);
-  //   } else if (glfwGetKey(window, GLFW_KEY_ENTER) == GLFW_PRESS ||
-  //     glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+  //   } else if (GetInputKey(window, GLFW_KEY_ENTER) == GLFW_PRESS ||
+  //     GetInputKey(window, GLFW_KEY_E) == GLFW_PRESS) {
   //     throttle_ = 15;
   //     Disable();
-  //     glfwSetCursorPos(window, 0, 0);
+  //     SetInputCursorPos(window, 0, 0);
   //     resources_->SetGameState(STATE_GAME);
 
   //     if (selected_spell) {
@@ -1051,7 +1051,7 @@ void Inventory::DrawSpellSelectionInterface(const Camera& camera, int win_x, int
 }
 
 void Inventory::UpdateAnimations() {
-  float seconds = glfwGetTime() - inventory_animation_start_;
+  float seconds = GetTime() - inventory_animation_start_;
   if (seconds <= inventory_animation_duration_) {
     float x = clamp(seconds / inventory_animation_duration_, 0, 1);
     float y = 1 / (1 + exp(10 * (0.5 - x)));
@@ -1060,7 +1060,7 @@ void Inventory::UpdateAnimations() {
     inventory_pos_ += (inventory_pos_target_ - inventory_pos_) * y;
   }
 
-  seconds = glfwGetTime() - item_description_screen_animation_start_;
+  seconds = GetTime() - item_description_screen_animation_start_;
   if (seconds <= item_description_screen_animation_duration_) {
     float x = clamp(seconds / item_description_screen_animation_duration_, 0, 1);
     float y = 1 / (1 + exp(10 * (0.5 - x)));
@@ -1069,7 +1069,7 @@ void Inventory::UpdateAnimations() {
     item_description_screen_pos_ += (item_description_screen_pos_target_ - item_description_screen_pos_) * y;
   }
 
-  seconds = glfwGetTime() - spellbook_animation_start_;
+  seconds = GetTime() - spellbook_animation_start_;
   if (seconds <= spellbook_animation_duration_) {
     float x = clamp(seconds / spellbook_animation_duration_, 0, 1);
     float y = 1 / (1 + exp(10 * (0.5 - x)));
@@ -1078,7 +1078,7 @@ void Inventory::UpdateAnimations() {
     spellbook_pos_ += (spellbook_pos_target_ - spellbook_pos_) * y;
   }
 
-  seconds = glfwGetTime() - spell_description_animation_start_;
+  seconds = GetTime() - spell_description_animation_start_;
   if (seconds <= spell_description_animation_duration_) {
     float x = clamp(seconds / spell_description_animation_duration_, 0, 1);
     float y = 1 / (1 + exp(10 * (0.5 - x)));
@@ -1087,7 +1087,7 @@ void Inventory::UpdateAnimations() {
     spell_description_pos_ += (spell_description_pos_target_ - spell_description_pos_) * y;
   }
 
-  seconds = glfwGetTime() - store_animation_start_;
+  seconds = GetTime() - store_animation_start_;
   if (seconds <= store_animation_duration_) {
     float x = clamp(seconds / store_animation_duration_, 0, 1);
     float y = 1 / (1 + exp(10 * (0.5 - x)));
@@ -1102,11 +1102,11 @@ void Inventory::UpdateAnimations() {
     u_time_ += 0.0166666667f;
   } 
 
-  if (closing > 0.0 && glfwGetTime() > closing) {
+  if (closing > 0.0 && GetTime() > closing) {
     enabled = false; 
     shared_ptr<CurrentDialog> current_dialog = resources_->GetCurrentDialog();
     current_dialog->enabled = false;
-    glfwSetCursorPos(window_, 0, 0);
+    SetInputCursorPos(window_, 0, 0);
   }
 
   if (u_time_ > 0.999f) {
@@ -1132,7 +1132,7 @@ void Inventory::DrawMap() {
     map_drag_origin_ = ivec2(0, 0);
   }
 
-  if (glfwGetTime() < show_map_after_) {
+  if (GetTime() < show_map_after_) {
     return;
   }
 
@@ -1294,7 +1294,7 @@ void Inventory::Draw(const Camera& camera, int win_x, int win_y,
 
 void Inventory::Enable(GLFWwindow* window, InventoryState state) { 
   closing = 0.0f;
-  glfwSetCursorPos(window, 640 - 32, 400 + 32);
+  SetInputCursorPos(window, 640 - 32, 400 + 32);
   enabled = true; 
   state_ = state; 
   spell_selection_cursor_ = ivec2(5, 5);
@@ -1303,56 +1303,56 @@ void Inventory::Enable(GLFWwindow* window, InventoryState state) {
   inventory_pos_ = vec2(-572, 0);
   inventory_pos_start_ = vec2(-572, 0);
   inventory_pos_target_ = vec2(0, 0);
-  inventory_animation_start_ = glfwGetTime();
+  inventory_animation_start_ = GetTime();
 
   item_description_screen_pos_ = vec2(-900, 609);
   item_description_screen_pos_start_ = vec2(-900, 609);
   item_description_screen_pos_target_ = vec2(0, 0);
-  item_description_screen_animation_start_ = glfwGetTime();
+  item_description_screen_animation_start_ = GetTime();
 
   spellbook_pos_ = vec2(-900, 0);
   spellbook_pos_start_ = vec2(-900, 0);
   spellbook_pos_target_ = vec2(0, 0);
-  spellbook_animation_start_ = glfwGetTime();
+  spellbook_animation_start_ = GetTime();
 
   spell_description_pos_ = vec2(-900, 0);
   spell_description_pos_start_ = vec2(-900, 0);
   spell_description_pos_target_ = vec2(0, 0);
-  spell_description_animation_start_ = glfwGetTime();
+  spell_description_animation_start_ = GetTime();
 
   store_pos_ = vec2(-1160, 0);
   store_pos_start_ = vec2(-1160, 0);
   store_pos_target_ = vec2(0, 0);
-  store_animation_start_ = glfwGetTime();
+  store_animation_start_ = GetTime();
 
-  show_map_after_ = glfwGetTime() + 0.5;
+  show_map_after_ = GetTime() + 0.5;
   u_time_ = 0.0f;
 }
 
 void Inventory::Disable() { 
   if (closing > 0) return;
 
-  closing = glfwGetTime() + 1.0f;
+  closing = GetTime() + 1.0f;
 
   inventory_pos_start_ = inventory_pos_;
   inventory_pos_target_ = vec2(-575, 0);
-  inventory_animation_start_ = glfwGetTime();
+  inventory_animation_start_ = GetTime();
 
   item_description_screen_pos_start_ = item_description_screen_pos_;
   item_description_screen_pos_target_ = vec2(-900, 609);
-  item_description_screen_animation_start_ = glfwGetTime();
+  item_description_screen_animation_start_ = GetTime();
 
   spellbook_pos_start_ = spellbook_pos_;
   spellbook_pos_target_ = vec2(-900, 0);
-  spellbook_animation_start_ = glfwGetTime();
+  spellbook_animation_start_ = GetTime();
 
   spell_description_pos_start_ = spell_description_pos_;
   spell_description_pos_target_ = vec2(-900, 0);
-  spell_description_animation_start_ = glfwGetTime();
+  spell_description_animation_start_ = GetTime();
 
   store_pos_start_ = store_pos_;
   store_pos_target_ = vec2(-1160, 0);
-  store_animation_start_ = glfwGetTime();
+  store_animation_start_ = GetTime();
 
   u_time_ = 1.0f;
 }
@@ -0,0 +1,203 @@
+#include "job_system.hpp"
+
+namespace {
+
+// Set on worker threads so jobs started from inside a job go to the
+// worker's own deque.
+thread_local JobSystem* tJobSystem = nullptr;
+thread_local int tWorkerIndex = -1;
+
+mutex gJobSystemMutex;
+shared_ptr<JobSystem> gJobSystem = nullptr;
+
+} // namespace
+
+JobSystem::JobSystem(int num_workers) : terminate_(false), num_queued_(0),
+  num_sleeping_(0) {
+  if (num_workers <= 0) {
+    num_workers = max(1, int(thread::hardware_concurrency()) - 1);
+  }
+
+  for (int i = 0; i <= num_workers; i++) {
+    queues_.push_back(make_unique<JobQueue>());
+  }
+
+  for (int i = 0; i < num_workers; i++) {
+    workers_.push_back(thread(&JobSystem::WorkerLoop, this, i));
+  }
+}
+
+// Jobs that are still queued are dropped.
+JobSystem::~JobSystem() {
+  terminate_ = true;
+  WakeUp(true);
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+int JobSystem::GetQueueIndex() {
+  if (tJobSystem == this) return tWorkerIndex;
+  return queues_.size() - 1;
+}
+
+void JobSystem::WakeUp(bool all) {
+  if (num_sleeping_ == 0) return;
+
+  // Taking the lock guarantees a thread that is about to sleep either sees
+  // the new state or is already waiting when we notify.
+  { lock_guard<mutex> lock(sleep_mutex_); }
+  if (all) {
+    wake_.notify_all();
+  } else {
+    wake_.notify_one();
+  }
+}
+
+void JobSystem::Push(Entry entry) {
+  JobQueue& queue = *queues_[GetQueueIndex()];
+  queue.entries_mutex.lock();
+  queue.entries.push_back(move(entry));
+  queue.entries_mutex.unlock();
+
+  num_queued_++;
+  WakeUp(false);
+}
+
+bool JobSystem::Pop(int queue_index, Entry& entry) {
+  JobQueue& queue = *queues_[queue_index];
+  lock_guard<mutex> lock(queue.entries_mutex);
+  if (queue.entries.empty()) return false;
+
+  // Workers take their newest job, the shared queue is first in first out.
+  if (queue_index == int(queues_.size()) - 1) {
+    entry = move(queue.entries.front());
+    queue.entries.pop_front();
+  } else {
+    entry = move(queue.entries.back());
+    queue.entries.pop_back();
+  }
+  return true;
+}
+
+bool JobSystem::Steal(int queue_index, Entry& entry) {
+  const int num_workers = queues_.size() - 1;
+  for (int i = 1; i <= num_workers; i++) {
+    int victim = (queue_index + i) % num_workers;
+    if (victim == queue_index) continue;
+
+    JobQueue& queue = *queues_[victim];
+    lock_guard<mutex> lock(queue.entries_mutex);
+    if (queue.entries.empty()) continue;
+
+    entry = move(queue.entries.front());
+    queue.entries.pop_front();
+    return true;
+  }
+  return false;
+}
+
+bool JobSystem::RunOne() {
+  const int queue_index = GetQueueIndex();
+  const int shared_index = queues_.size() - 1;
+
+  Entry entry;
+  if (!Pop(queue_index, entry) &&
+      (queue_index == shared_index || !Pop(shared_index, entry)) &&
+      !Steal(queue_index, entry)) {
+    return false;
+  }
+
+  num_queued_--;
+  entry.job();
+  Finish(entry.counter);
+  return true;
+}
+
+void JobSystem::Finish(shared_ptr<JobCounter> counter) {
+  if (!counter) return;
+  if (--counter->count_ > 0) return;
+
+  vector<pair<Job, shared_ptr<JobCounter>>> continuations;
+  counter->mutex_.lock();
+  continuations.swap(counter->continuations_);
+  counter->mutex_.unlock();
+
+  for (auto& [job, continuation_counter] : continuations) {
+    Push({ move(job), continuation_counter });
+  }
+
+  // Threads waiting on this counter sleep on the same condition variable.
+  WakeUp(true);
+}
+
+void JobSystem::WorkerLoop(int worker_index) {
+  tJobSystem = this;
+  tWorkerIndex = worker_index;
+
+  while (!terminate_) {
+    if (RunOne()) continue;
+
+    unique_lock<mutex> lock(sleep_mutex_);
+    num_sleeping_++;
+    wake_.wait(lock, [this] { return num_queued_ > 0 || terminate_; });
+    num_sleeping_--;
+  }
+}
+
+void JobSystem::Run(Job job, shared_ptr<JobCounter> counter) {
+  if (counter) counter->count_++;
+  Push({ move(job), counter });
+}
+
+void JobSystem::RunAfter(shared_ptr<JobCounter> dependency, Job job,
+  shared_ptr<JobCounter> counter) {
+  if (counter) counter->count_++;
+
+  dependency->mutex_.lock();
+  if (dependency->count_ > 0) {
+    dependency->continuations_.push_back({ move(job), counter });
+    dependency->mutex_.unlock();
+    return;
+  }
+  dependency->mutex_.unlock();
+
+  Push({ move(job), counter });
+}
+
+void JobSystem::ParallelFor(int begin, int end, int batch_size,
+  function<void(int)> fn, shared_ptr<JobCounter> counter) {
+  batch_size = max(1, batch_size);
+  for (int i = begin; i < end; i += batch_size) {
+    int batch_end = min(i + batch_size, end);
+    Run([fn, i, batch_end] () {
+      for (int j = i; j < batch_end; j++) fn(j);
+    }, counter);
+  }
+}
+
+void JobSystem::Wait(shared_ptr<JobCounter> counter) {
+  while (counter->count_ > 0) {
+    if (RunOne()) continue;
+
+    unique_lock<mutex> lock(sleep_mutex_);
+    num_sleeping_++;
+    wake_.wait(lock, [this, &counter] {
+      return counter->count_ == 0 || num_queued_ > 0 || terminate_;
+    });
+    num_sleeping_--;
+  }
+}
+
+void SetJobSystem(shared_ptr<JobSystem> job_system) {
+  lock_guard<mutex> lock(gJobSystemMutex);
+  gJobSystem = job_system;
+}
+
+shared_ptr<JobSystem> GetJobSystem() {
+  lock_guard<mutex> lock(gJobSystemMutex);
+  if (!gJobSystem) {
+    gJobSystem = make_shared<JobSystem>();
+  }
+  return gJobSystem;
+}
@@ -0,0 +1,94 @@
+#ifndef __JOB_SYSTEM_HPP__
+#define __JOB_SYSTEM_HPP__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef function<void()> Job;
+
+// Number of jobs started with this counter that have not finished yet. A
+// counter that is used as a dependency of RunAfter should not get new jobs
+// until it reaches zero.
+class JobCounter {
+  atomic<int> count_;
+  mutex mutex_;
+  vector<pair<Job, shared_ptr<JobCounter>>> continuations_;
+
+  friend class JobSystem;
+
+ public:
+  JobCounter() : count_(0) {}
+
+  int Get() { return count_.load(); }
+  bool IsDone() { return count_.load() == 0; }
+};
+
+// Engine-wide pool of worker threads. Each worker owns a deque: it pushes and
+// pops its own jobs at the back and steals from the front of the other
+// deques when it runs dry. Threads that are not workers (the main thread)
+// push to a shared queue and run jobs themselves while they wait on a
+// counter. Idle threads sleep on a condition variable instead of polling.
+class JobSystem {
+  struct Entry {
+    Job job;
+    shared_ptr<JobCounter> counter;
+  };
+
+  struct JobQueue {
+    mutex entries_mutex;
+    deque<Entry> entries;
+  };
+
+  // One queue per worker plus the shared queue at the end.
+  vector<unique_ptr<JobQueue>> queues_;
+  vector<thread> workers_;
+
+  atomic<bool> terminate_;
+  atomic<int> num_queued_;
+  atomic<int> num_sleeping_;
+  mutex sleep_mutex_;
+  condition_variable wake_;
+
+  int GetQueueIndex();
+  void Push(Entry entry);
+  bool Pop(int queue_index, Entry& entry);
+  bool Steal(int queue_index, Entry& entry);
+  bool RunOne();
+  void Finish(shared_ptr<JobCounter> counter);
+  void WakeUp(bool all);
+  void WorkerLoop(int worker_index);
+
+ public:
+  // Uses one worker less than the number of cores by default, since the
+  // calling thread also runs jobs while it waits.
+  JobSystem(int num_workers = 0);
+  ~JobSystem();
+
+  int GetNumWorkers() { return workers_.size(); }
+
+  void Run(Job job, shared_ptr<JobCounter> counter = nullptr);
+
+  // Schedules the job once the dependency counter reaches zero.
+  void RunAfter(shared_ptr<JobCounter> dependency, Job job,
+    shared_ptr<JobCounter> counter = nullptr);
+
+  // Calls fn(i) for i in [begin, end) with one job per batch.
+  void ParallelFor(int begin, int end, int batch_size, function<void(int)> fn,
+    shared_ptr<JobCounter> counter);
+
+  // Runs queued jobs on the calling thread until the counter reaches zero.
+  void Wait(shared_ptr<JobCounter> counter);
+};
+
+void SetJobSystem(shared_ptr<JobSystem> job_system);
+shared_ptr<JobSystem> GetJobSystem();
+
+#endif // __JOB_SYSTEM_HPP__
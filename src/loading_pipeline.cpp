@@ -0,0 +1,152 @@
+#include "loading_pipeline.hpp"
+
+#include <chrono>
+
+bool IsMainThreadStage(LoadingStage stage) {
+  return stage == LOADING_UPLOAD || stage == LOADING_CREATE;
+}
+
+int LoadingProgress::GetNumTasks() const {
+  int total = 0;
+  for (int i = 0; i < NUM_LOADING_STAGES; i++) total += num_tasks[i];
+  return total;
+}
+
+int LoadingProgress::GetNumDone() const {
+  int total = 0;
+  for (int i = 0; i < NUM_LOADING_STAGES; i++) total += num_done[i];
+  return total;
+}
+
+float LoadingProgress::GetFraction() const {
+  int num_tasks = GetNumTasks();
+  if (num_tasks == 0) return 1.0f;
+  return float(GetNumDone()) / float(num_tasks);
+}
+
+LoadingPipeline::LoadingPipeline(shared_ptr<JobSystem> job_system)
+  : job_system_(job_system), jobs_(make_shared<JobCounter>()) {
+}
+
+// Worker tasks hold a pointer to the pipeline, so they have to finish
+// first. Main thread tasks that did not run are dropped.
+LoadingPipeline::~LoadingPipeline() {
+  job_system_->Wait(jobs_);
+}
+
+int LoadingPipeline::AddTask(LoadingStage stage, function<void()> fn,
+  const vector<int>& dependencies) {
+  lock_guard<mutex> lock(mutex_);
+  int task_id = tasks_.size();
+  tasks_.push_back(make_unique<Task>());
+  Task& task = *tasks_.back();
+  task.stage = stage;
+  task.fn = move(fn);
+
+  for (int dependency : dependencies) {
+    if (dependency < 0 || dependency >= task_id) {
+      throw runtime_error("Invalid loading task dependency");
+    }
+
+    Task& dependency_task = *tasks_[dependency];
+    if (dependency_task.done) continue;
+    dependency_task.dependents.push_back(task_id);
+    task.num_pending_dependencies++;
+  }
+
+  num_pending_++;
+  progress_.num_tasks[stage]++;
+  if (task.num_pending_dependencies == 0) Schedule(task_id);
+  return task_id;
+}
+
+int LoadingPipeline::AddBarrier(const vector<int>& dependencies) {
+  return AddTask(LOADING_CREATE, [] () {}, dependencies);
+}
+
+void LoadingPipeline::Schedule(int task_id) {
+  if (IsMainThreadStage(tasks_[task_id]->stage)) {
+    main_thread_tasks_.push_back(task_id);
+    main_thread_ready_.notify_all();
+    return;
+  }
+  job_system_->Run([this, task_id] () { Run(task_id); }, jobs_);
+}
+
+void LoadingPipeline::Run(int task_id) {
+  Task* task;
+  {
+    lock_guard<mutex> lock(mutex_);
+    if (error_) return;
+    task = tasks_[task_id].get();
+  }
+
+  try {
+    task->fn();
+  } catch (...) {
+    lock_guard<mutex> lock(mutex_);
+    if (!error_) error_ = current_exception();
+    main_thread_ready_.notify_all();
+    return;
+  }
+
+  lock_guard<mutex> lock(mutex_);
+  Complete(task_id);
+}
+
+void LoadingPipeline::Complete(int task_id) {
+  Task& task = *tasks_[task_id];
+  task.done = true;
+  task.fn = nullptr;
+  progress_.num_done[task.stage]++;
+
+  for (int dependent : task.dependents) {
+    if (--tasks_[dependent]->num_pending_dependencies == 0) {
+      Schedule(dependent);
+    }
+  }
+  task.dependents.clear();
+
+  if (--num_pending_ == 0) main_thread_ready_.notify_all();
+}
+
+bool LoadingPipeline::RunMainThreadTasks(double time_budget) {
+  auto start_time = chrono::steady_clock::now();
+  auto elapsed = [&start_time] () {
+    return chrono::duration<double>(
+      chrono::steady_clock::now() - start_time).count();
+  };
+
+  unique_lock<mutex> lock(mutex_);
+  main_thread_ready_.wait_for(lock, chrono::duration<double>(time_budget),
+    [this] () {
+      return !main_thread_tasks_.empty() || error_ || num_pending_ == 0;
+    });
+
+  while (!main_thread_tasks_.empty() && !error_) {
+    int task_id = main_thread_tasks_.front();
+    main_thread_tasks_.pop_front();
+
+    lock.unlock();
+    Run(task_id);
+    lock.lock();
+    if (elapsed() >= time_budget) break;
+  }
+
+  if (error_) rethrow_exception(error_);
+  return num_pending_ == 0;
+}
+
+void LoadingPipeline::Finish() {
+  while (!RunMainThreadTasks(0.1)) {}
+}
+
+bool LoadingPipeline::IsDone() {
+  lock_guard<mutex> lock(mutex_);
+  return num_pending_ == 0;
+}
+
+LoadingProgress LoadingPipeline::GetProgress() {
+  lock_guard<mutex> lock(mutex_);
+  return progress_;
+}
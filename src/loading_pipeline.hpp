@@ -0,0 +1,97 @@
+#ifndef __LOADING_PIPELINE_HPP__
+#define __LOADING_PIPELINE_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "job_system.hpp"
+
+using namespace std;
+
+// Read, parse and decode tasks run on the job system workers. Upload and
+// create tasks touch GL or the resource maps, so they only run on the thread
+// that calls RunMainThreadTasks.
+enum LoadingStage {
+  LOADING_READ = 0,
+  LOADING_PARSE,
+  LOADING_DECODE,
+  LOADING_UPLOAD,
+  LOADING_CREATE,
+  NUM_LOADING_STAGES
+};
+
+bool IsMainThreadStage(LoadingStage stage);
+
+struct LoadingProgress {
+  int num_tasks[NUM_LOADING_STAGES] = {};
+  int num_done[NUM_LOADING_STAGES] = {};
+
+  int GetNumTasks() const;
+  int GetNumDone() const;
+
+  // Between 0 and 1.
+  float GetFraction() const;
+};
+
+// Dependency graph of loading tasks. A task starts once all the tasks it
+// depends on are done. Tasks can be added from inside other tasks, also with
+// dependencies that are already done.
+//
+// The first exception thrown by a task is rethrown by RunMainThreadTasks.
+// Tasks that depend on a failed task never run.
+class LoadingPipeline {
+  struct Task {
+    LoadingStage stage;
+    function<void()> fn;
+    int num_pending_dependencies = 0;
+    vector<int> dependents;
+    bool done = false;
+  };
+
+  shared_ptr<JobSystem> job_system_;
+  shared_ptr<JobCounter> jobs_;
+
+  mutex mutex_;
+  condition_variable main_thread_ready_;
+  deque<unique_ptr<Task>> tasks_;
+  deque<int> main_thread_tasks_;
+  int num_pending_ = 0;
+  LoadingProgress progress_;
+  exception_ptr error_;
+
+  void Run(int task_id);
+
+  // Called with the mutex held.
+  void Schedule(int task_id);
+  void Complete(int task_id);
+
+ public:
+  LoadingPipeline(shared_ptr<JobSystem> job_system);
+  ~LoadingPipeline();
+
+  // Returns the id of the task, to be used as a dependency.
+  int AddTask(LoadingStage stage, function<void()> fn,
+    const vector<int>& dependencies = {});
+
+  // Empty create task that is done once all the dependencies are done, so
+  // later tasks can wait on a whole group through a single id.
+  int AddBarrier(const vector<int>& dependencies);
+
+  // Runs ready main thread tasks until the time budget in seconds is used
+  // up, at least one of them if any is ready. When none is ready, waits up
+  // to the budget for one. Returns true when every task is done.
+  bool RunMainThreadTasks(double time_budget);
+
+  // Runs everything to completion.
+  void Finish();
+
+  bool IsDone();
+  LoadingProgress GetProgress();
+};
+
+#endif // __LOADING_PIPELINE_HPP__
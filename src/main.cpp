@@ -9,6 +9,8 @@
 #include "engine.hpp"
 #include "monsters.hpp"
 
+#include <ctime>
+
 shared_ptr<Resources> resources = nullptr;
 shared_ptr<Renderer> renderer = nullptr;
 shared_ptr<TextEditor> text_editor = nullptr;
@@ -81,7 +83,41 @@ void InitOpenGl() {
   // glfwSetCursorPos(window_, 0, 0);
 }
 
-int main() {
+// Usage: main [--record <file>] [--replay <file>] [--hashes <file>]
+void InitReplay(int argc, char** argv) {
+  string record_file, replay_file, hashes_file;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const string arg = argv[i];
+    if (arg == "--record") {
+      record_file = argv[i+1];
+    } else if (arg == "--replay") {
+      replay_file = argv[i+1];
+    } else if (arg == "--hashes") {
+      hashes_file = argv[i+1];
+    }
+  }
+
+  unsigned int seed = (unsigned int) time(NULL);
+  shared_ptr<Replay> replay = nullptr;
+  if (!replay_file.empty()) {
+    replay = make_shared<Replay>(REPLAY_PLAYBACK, replay_file);
+    seed = replay->GetSeed();
+  } else if (!record_file.empty()) {
+    replay = make_shared<Replay>(REPLAY_RECORD, record_file, seed);
+  }
+
+  SeedRandom(seed);
+  if (!replay) return;
+
+  if (!hashes_file.empty()) {
+    replay->SetHashesFile(hashes_file);
+  }
+  SetClock(replay->GetClock());
+  SetReplay(replay);
+}
+
+int main(int argc, char** argv) {
+  InitReplay(argc, argv);
   InitOpenGl();
 
   const string resources_dir = "resources";
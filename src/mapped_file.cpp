@@ -0,0 +1,96 @@
+#include "mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw runtime_error("Could not open file " + filename);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw runtime_error("Could not stat file " + filename);
+  }
+
+  size_ = st.st_size;
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      throw runtime_error("Could not map file " + filename);
+    }
+    data_ = (const char*) data;
+  }
+
+  // The mapping keeps its own reference to the file.
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) munmap((void*) data_, size_);
+}
+
+namespace {
+
+// madvise needs ranges that start at a page boundary.
+void Advise(const char* data, size_t file_size, size_t offset, size_t size,
+  int advice) {
+  if (!data || offset >= file_size) return;
+  size = std::min(size, file_size - offset);
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t start = offset / page_size * page_size;
+  madvise((void*) (data + start), size + offset - start, advice);
+}
+
+} // namespace
+
+void MappedFile::Prefetch(size_t offset, size_t size) const {
+  Advise(data_, size_, offset, size, MADV_WILLNEED);
+}
+
+void MappedFile::Evict(size_t offset, size_t size) const {
+  Advise(data_, size_, offset, size, MADV_DONTNEED);
+}
+
+string ReplaceExtension(const string& filename, const string& extension) {
+  size_t dot = filename.find_last_of('.');
+  size_t slash = filename.find_last_of('/');
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    return filename + extension;
+  }
+  return filename.substr(0, dot) + extension;
+}
+
+void AtomicWriteFile(const string& filename,
+  const function<void(ostream&)>& write) {
+  const string tmp_filename = filename + ".tmp";
+  ofstream os(tmp_filename, ios::binary);
+  if (!os) throw runtime_error("Could not write " + tmp_filename);
+
+  try {
+    write(os);
+  } catch (...) {
+    os.close();
+    remove(tmp_filename.c_str());
+    throw;
+  }
+
+  os.close();
+  if (!os) {
+    remove(tmp_filename.c_str());
+    throw runtime_error("Could not write " + tmp_filename);
+  }
+  if (rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+    remove(tmp_filename.c_str());
+    throw runtime_error("Could not write " + filename);
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef __MAPPED_FILE_HPP__
+#define __MAPPED_FILE_HPP__
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// Read only memory mapping of a whole file. The pages are loaded by the OS
+// when they are first touched, so reading a small part of a big file only
+// costs the pages read. Throws if the file cannot be opened.
+class MappedFile {
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+
+ public:
+  MappedFile(const string& filename);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Hints for the OS to load a range ahead of use or to drop its pages. The
+  // mapping is read only, so dropped pages are read again when touched.
+  void Prefetch(size_t offset, size_t size) const;
+  void Evict(size_t offset, size_t size) const;
+};
+
+// "foo.png" with extension ".btex" is "foo.btex" in the same directory. Files
+// without an extension get it appended.
+string ReplaceExtension(const string& filename, const string& extension);
+
+// Writes to a file next to filename and renames it over filename, so a
+// failed or interrupted write never leaves a truncated file and a mapping of
+// the old file stays valid. Throws if the file can't be written.
+void AtomicWriteFile(const string& filename,
+  const function<void(ostream&)>& write);
+
+#endif // __MAPPED_FILE_HPP__
@@ -0,0 +1,463 @@
+#include "mesh_cache.hpp"
+#include "compressed_animation.hpp"
+#include "mapped_file.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t kMeshCacheMagic = 0x4853454d; // "MESH"
+const uint32_t kMeshCacheVersion = 1;
+const size_t kSectionAlignment = 16;
+
+enum MeshCacheSectionType {
+  SECTION_VERTICES = 0,
+  SECTION_UVS,
+  SECTION_NORMALS,
+  SECTION_TANGENTS,
+  SECTION_BITANGENTS,
+  SECTION_BONE_IDS,
+  SECTION_BONE_WEIGHTS,
+  SECTION_INDICES,
+  SECTION_POLYGON_SIZES,
+  SECTION_POLYGON_VERTICES,
+  SECTION_POLYGON_NORMALS,
+  SECTION_BONE_NAMES,
+  SECTION_BINDPOSES,
+  SECTION_ANIMATIONS,
+  SECTION_ANIMATION_NAMES,
+  SECTION_KEYFRAMES,
+  SECTION_TRANSFORMS,
+  NUM_SECTIONS
+};
+
+// Offset from the start of the file and size in bytes.
+struct MeshCacheSection {
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_size;
+  int64_t source_modification_time;
+  float bounding_sphere[4];
+  MeshCacheSection sections[NUM_SECTIONS];
+};
+
+struct MeshCacheAnimation {
+  uint32_t first_keyframe;
+  uint32_t num_keyframes;
+};
+
+struct MeshCacheKeyframe {
+  int32_t time;
+  float bounding_sphere[4];
+  uint32_t first_transform;
+  uint32_t num_transforms;
+};
+
+// Names are stored back to back, each followed by a null character.
+vector<char> JoinNames(const vector<string>& names) {
+  vector<char> chars;
+  for (const string& name : names) {
+    chars.insert(chars.end(), name.begin(), name.end());
+    chars.push_back('\0');
+  }
+  return chars;
+}
+
+vector<string> SplitNames(const vector<char>& chars, size_t num_names) {
+  vector<string> names;
+  size_t start = 0;
+  for (size_t i = 0; i < chars.size() && names.size() < num_names; i++) {
+    if (chars[i] != '\0') continue;
+    names.push_back(string(&chars[start], i - start));
+    start = i + 1;
+  }
+  if (names.size() != num_names) {
+    throw runtime_error("Invalid mesh cache names");
+  }
+  return names;
+}
+
+class SectionWriter {
+  MeshCacheHeader& header_;
+  string bytes_;
+
+ public:
+  SectionWriter(MeshCacheHeader& header) : header_(header) {
+    bytes_.resize(sizeof(MeshCacheHeader), '\0');
+  }
+
+  template <class T>
+  void Write(MeshCacheSectionType type, const vector<T>& v) {
+    bytes_.resize((bytes_.size() + kSectionAlignment - 1) /
+      kSectionAlignment * kSectionAlignment, '\0');
+    header_.sections[type].offset = bytes_.size();
+    header_.sections[type].size = v.size() * sizeof(T);
+    if (!v.empty()) {
+      bytes_.append((const char*) v.data(), v.size() * sizeof(T));
+    }
+  }
+
+  void Flush(ostream& os) {
+    memcpy(&bytes_[0], &header_, sizeof(MeshCacheHeader));
+    os.write(bytes_.data(), bytes_.size());
+  }
+};
+
+template <class T>
+void ReadSection(const char* bytes, size_t size, const MeshCacheHeader& header,
+  MeshCacheSectionType type, vector<T>& v) {
+  const MeshCacheSection& section = header.sections[type];
+  if (section.offset > size || section.size > size - section.offset ||
+    section.size % sizeof(T) != 0) {
+    throw runtime_error("Truncated mesh cache data");
+  }
+  v.resize(section.size / sizeof(T));
+  if (!v.empty()) memcpy(v.data(), bytes + section.offset, section.size);
+}
+
+// Key with all the attributes of a corner, for welding.
+string GetVertexKey(const MeshData& data, size_t i) {
+  string key;
+  auto append = [&key, i](const auto& v) {
+    if (i < v.size()) key.append((const char*) &v[i], sizeof(v[i]));
+  };
+  append(data.vertices);
+  append(data.uvs);
+  append(data.normals);
+  append(data.tangents);
+  append(data.bitangents);
+  append(data.bone_ids);
+  append(data.bone_weights);
+  return key;
+}
+
+template <class T>
+void Reorder(vector<T>& v, const vector<int>& corners) {
+  if (v.empty()) return;
+  vector<T> reordered;
+  reordered.reserve(corners.size());
+  for (int corner : corners) reordered.push_back(v[corner]);
+  v.swap(reordered);
+}
+
+} // namespace
+
+void WeldVertices(MeshData& data) {
+  // First corner with each key.
+  unordered_map<string, unsigned int> vertex_ids;
+  vector<int> corners;
+  data.indices.clear();
+  for (size_t i = 0; i < data.vertices.size(); i++) {
+    auto [it, inserted] = vertex_ids.emplace(GetVertexKey(data, i),
+      corners.size());
+    if (inserted) corners.push_back(i);
+    data.indices.push_back(it->second);
+  }
+
+  Reorder(data.vertices, corners);
+  Reorder(data.uvs, corners);
+  Reorder(data.normals, corners);
+  Reorder(data.tangents, corners);
+  Reorder(data.bitangents, corners);
+  Reorder(data.bone_ids, corners);
+  Reorder(data.bone_weights, corners);
+}
+
+void CreateMesh(const MeshData& data, Mesh& m) {
+  m.polygons = data.polygons;
+  m.num_indices = data.indices.size();
+  m.bounding_sphere = data.bounding_sphere;
+
+#ifndef HEADLESS
+  GLuint buffers[8];
+  glGenBuffers(8, buffers);
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+  glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(vec3),
+    data.vertices.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+  glBufferData(GL_ARRAY_BUFFER, data.uvs.size() * sizeof(vec2),
+    data.uvs.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[2]);
+  glBufferData(GL_ARRAY_BUFFER, data.normals.size() * sizeof(vec3),
+    data.normals.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[3]);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+    data.indices.size() * sizeof(unsigned int), data.indices.data(),
+    GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[4]);
+  glBufferData(GL_ARRAY_BUFFER, data.tangents.size() * sizeof(vec3),
+    data.tangents.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, buffers[5]);
+  glBufferData(GL_ARRAY_BUFFER, data.bitangents.size() * sizeof(vec3),
+    data.bitangents.data(), GL_STATIC_DRAW);
+
+  glGenVertexArrays(1, &m.vao_);
+  glBindVertexArray(m.vao_);
+
+  int num_slots = 6;
+  BindBuffer(buffers[0], 0, 3);
+  BindBuffer(buffers[1], 1, 2);
+  BindBuffer(buffers[2], 2, 3);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[3]);
+  BindBuffer(buffers[4], 3, 3);
+  BindBuffer(buffers[5], 4, 3);
+
+  if (!data.bone_ids.empty()) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[6]);
+    glBufferData(GL_ARRAY_BUFFER, data.bone_ids.size() * sizeof(ivec3),
+      data.bone_ids.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[7]);
+    glBufferData(GL_ARRAY_BUFFER, data.bone_weights.size() * sizeof(vec3),
+      data.bone_weights.data(), GL_STATIC_DRAW);
+
+    num_slots += 2;
+    BindBuffer(buffers[6], 5, 3);
+    BindBuffer(buffers[7], 6, 3);
+  }
+
+  glBindVertexArray(0);
+  for (int slot = 0; slot < num_slots; slot++) {
+    glDisableVertexAttribArray(slot);
+  }
+#endif
+
+  // Only the compressed tracks are kept in memory.
+  for (const Animation& animation : data.animations) {
+    Animation& mesh_animation = m.animations[animation.name];
+    mesh_animation.name = animation.name;
+    mesh_animation.compressed = make_shared<CompressedAnimation>(animation);
+  }
+
+  if (data.animations.empty()) return;
+  for (size_t i = 0; i < data.bone_names.size(); i++) {
+    if (data.bone_names[i].empty()) continue;
+    m.bones_to_ids[data.bone_names[i]] = i;
+    m.global_bindpose_inverse[i] = data.global_bindpose_inverse[i];
+  }
+}
+
+void SaveMeshData(ostream& os, const MeshData& data,
+  const MeshSource& source) {
+  MeshCacheHeader header;
+  memset(&header, 0, sizeof(MeshCacheHeader));
+  header.magic = kMeshCacheMagic;
+  header.version = kMeshCacheVersion;
+  header.source_size = source.size;
+  header.source_modification_time = source.modification_time;
+  header.bounding_sphere[0] = data.bounding_sphere.center.x;
+  header.bounding_sphere[1] = data.bounding_sphere.center.y;
+  header.bounding_sphere[2] = data.bounding_sphere.center.z;
+  header.bounding_sphere[3] = data.bounding_sphere.radius;
+
+  vector<uint32_t> polygon_sizes;
+  vector<vec3> polygon_vertices;
+  vector<vec3> polygon_normals;
+  for (const Polygon& polygon : data.polygons) {
+    polygon_sizes.push_back(polygon.vertices.size());
+    polygon_vertices.insert(polygon_vertices.end(), polygon.vertices.begin(),
+      polygon.vertices.end());
+    polygon_normals.push_back(polygon.normal);
+  }
+
+  vector<string> animation_names;
+  vector<MeshCacheAnimation> animations;
+  vector<MeshCacheKeyframe> keyframes;
+  vector<mat4> transforms;
+  for (const Animation& animation : data.animations) {
+    animation_names.push_back(animation.name);
+    animations.push_back({ uint32_t(keyframes.size()),
+      uint32_t(animation.keyframes.size()) });
+    for (const Keyframe& keyframe : animation.keyframes) {
+      const BoundingSphere& s = keyframe.bounding_sphere;
+      keyframes.push_back({ keyframe.time,
+        { s.center.x, s.center.y, s.center.z, s.radius },
+        uint32_t(transforms.size()), uint32_t(keyframe.transforms.size()) });
+      transforms.insert(transforms.end(), keyframe.transforms.begin(),
+        keyframe.transforms.end());
+    }
+  }
+
+  SectionWriter writer(header);
+  writer.Write(SECTION_VERTICES, data.vertices);
+  writer.Write(SECTION_UVS, data.uvs);
+  writer.Write(SECTION_NORMALS, data.normals);
+  writer.Write(SECTION_TANGENTS, data.tangents);
+  writer.Write(SECTION_BITANGENTS, data.bitangents);
+  writer.Write(SECTION_BONE_IDS, data.bone_ids);
+  writer.Write(SECTION_BONE_WEIGHTS, data.bone_weights);
+  writer.Write(SECTION_INDICES, data.indices);
+  writer.Write(SECTION_POLYGON_SIZES, polygon_sizes);
+  writer.Write(SECTION_POLYGON_VERTICES, polygon_vertices);
+  writer.Write(SECTION_POLYGON_NORMALS, polygon_normals);
+  writer.Write(SECTION_BONE_NAMES, JoinNames(data.bone_names));
+  writer.Write(SECTION_BINDPOSES, data.global_bindpose_inverse);
+  writer.Write(SECTION_ANIMATIONS, animations);
+  writer.Write(SECTION_ANIMATION_NAMES, JoinNames(animation_names));
+  writer.Write(SECTION_KEYFRAMES, keyframes);
+  writer.Write(SECTION_TRANSFORMS, transforms);
+  writer.Flush(os);
+}
+
+void LoadMeshData(const char* bytes, size_t size, MeshData& data) {
+  MeshCacheHeader header;
+  if (size < sizeof(MeshCacheHeader)) {
+    throw runtime_error("Invalid mesh cache data");
+  }
+  memcpy(&header, bytes, sizeof(MeshCacheHeader));
+  if (header.magic != kMeshCacheMagic) {
+    throw runtime_error("Invalid mesh cache data");
+  }
+  if (header.version != kMeshCacheVersion) {
+    throw runtime_error("Unsupported mesh cache version " +
+      to_string(header.version));
+  }
+
+  data.bounding_sphere = BoundingSphere(vec3(header.bounding_sphere[0],
+    header.bounding_sphere[1], header.bounding_sphere[2]),
+    header.bounding_sphere[3]);
+  ReadSection(bytes, size, header, SECTION_VERTICES, data.vertices);
+  ReadSection(bytes, size, header, SECTION_UVS, data.uvs);
+  ReadSection(bytes, size, header, SECTION_NORMALS, data.normals);
+  ReadSection(bytes, size, header, SECTION_TANGENTS, data.tangents);
+  ReadSection(bytes, size, header, SECTION_BITANGENTS, data.bitangents);
+  ReadSection(bytes, size, header, SECTION_BONE_IDS, data.bone_ids);
+  ReadSection(bytes, size, header, SECTION_BONE_WEIGHTS, data.bone_weights);
+  ReadSection(bytes, size, header, SECTION_INDICES, data.indices);
+  for (unsigned int index : data.indices) {
+    if (index >= data.vertices.size()) {
+      throw runtime_error("Invalid mesh cache index");
+    }
+  }
+
+  vector<uint32_t> polygon_sizes;
+  vector<vec3> polygon_vertices;
+  vector<vec3> polygon_normals;
+  ReadSection(bytes, size, header, SECTION_POLYGON_SIZES, polygon_sizes);
+  ReadSection(bytes, size, header, SECTION_POLYGON_VERTICES,
+    polygon_vertices);
+  ReadSection(bytes, size, header, SECTION_POLYGON_NORMALS, polygon_normals);
+  if (polygon_normals.size() != polygon_sizes.size()) {
+    throw runtime_error("Invalid mesh cache polygons");
+  }
+
+  data.polygons.resize(polygon_sizes.size());
+  size_t next_vertex = 0;
+  for (size_t i = 0; i < polygon_sizes.size(); i++) {
+    if (polygon_sizes[i] > polygon_vertices.size() - next_vertex) {
+      throw runtime_error("Invalid mesh cache polygons");
+    }
+    data.polygons[i].vertices.assign(
+      polygon_vertices.begin() + next_vertex,
+      polygon_vertices.begin() + next_vertex + polygon_sizes[i]);
+    data.polygons[i].normal = polygon_normals[i];
+    next_vertex += polygon_sizes[i];
+  }
+
+  vector<char> bone_names;
+  ReadSection(bytes, size, header, SECTION_BINDPOSES,
+    data.global_bindpose_inverse);
+  ReadSection(bytes, size, header, SECTION_BONE_NAMES, bone_names);
+  data.bone_names = SplitNames(bone_names,
+    data.global_bindpose_inverse.size());
+
+  vector<MeshCacheAnimation> animations;
+  vector<char> animation_names;
+  vector<MeshCacheKeyframe> keyframes;
+  vector<mat4> transforms;
+  ReadSection(bytes, size, header, SECTION_ANIMATIONS, animations);
+  ReadSection(bytes, size, header, SECTION_ANIMATION_NAMES, animation_names);
+  ReadSection(bytes, size, header, SECTION_KEYFRAMES, keyframes);
+  ReadSection(bytes, size, header, SECTION_TRANSFORMS, transforms);
+  vector<string> names = SplitNames(animation_names, animations.size());
+
+  data.animations.resize(animations.size());
+  for (size_t i = 0; i < animations.size(); i++) {
+    const MeshCacheAnimation& a = animations[i];
+    if (a.first_keyframe > keyframes.size() ||
+      a.num_keyframes > keyframes.size() - a.first_keyframe) {
+      throw runtime_error("Invalid mesh cache animation");
+    }
+
+    Animation& animation = data.animations[i];
+    animation.name = names[i];
+    animation.keyframes.resize(a.num_keyframes);
+    for (uint32_t j = 0; j < a.num_keyframes; j++) {
+      const MeshCacheKeyframe& k = keyframes[a.first_keyframe + j];
+      if (k.first_transform > transforms.size() ||
+        k.num_transforms > transforms.size() - k.first_transform) {
+        throw runtime_error("Invalid mesh cache keyframe");
+      }
+
+      Keyframe& keyframe = animation.keyframes[j];
+      keyframe.time = k.time;
+      keyframe.bounding_sphere = BoundingSphere(vec3(k.bounding_sphere[0],
+        k.bounding_sphere[1], k.bounding_sphere[2]), k.bounding_sphere[3]);
+      keyframe.transforms.assign(transforms.begin() + k.first_transform,
+        transforms.begin() + k.first_transform + k.num_transforms);
+    }
+  }
+}
+
+string GetMeshCachePath(const string& fbx_filename) {
+  return ReplaceExtension(fbx_filename, ".mesh");
+}
+
+bool GetMeshSource(const string& fbx_filename, MeshSource& source) {
+  struct stat st;
+  if (stat(fbx_filename.c_str(), &st) != 0) return false;
+  source.size = st.st_size;
+  source.modification_time = st.st_mtime;
+  return true;
+}
+
+bool LoadMeshCache(const string& fbx_filename, MeshData& data) {
+  const string cache_filename = GetMeshCachePath(fbx_filename);
+  struct stat st;
+  if (stat(cache_filename.c_str(), &st) != 0) return false;
+
+  // A truncated or corrupt cache is treated like a missing one, so the
+  // mesh is loaded from the FBX file instead.
+  try {
+    MappedFile file(cache_filename);
+    MeshCacheHeader header;
+    if (file.size() < sizeof(MeshCacheHeader)) return false;
+    memcpy(&header, file.data(), sizeof(MeshCacheHeader));
+    if (header.magic != kMeshCacheMagic) return false;
+    if (header.version != kMeshCacheVersion) return false;
+
+    MeshSource source;
+    if (GetMeshSource(fbx_filename, source)) {
+      if (header.source_size != source.size ||
+        header.source_modification_time != source.modification_time) {
+        return false;
+      }
+    }
+
+    LoadMeshData(file.data(), file.size(), data);
+  } catch (const exception& e) {
+    cout << "Invalid mesh cache " << cache_filename << ": " << e.what() 
+      << endl;
+    data = MeshData();
+    return false;
+  }
+  return true;
+}
+
+void SaveMeshCache(const string& fbx_filename, const MeshData& data) {
+  MeshSource source;
+  if (!GetMeshSource(fbx_filename, source)) {
+    throw runtime_error("Could not find " + fbx_filename);
+  }
+
+  AtomicWriteFile(GetMeshCachePath(fbx_filename), [&] (ostream& os) {
+    SaveMeshData(os, data, source);
+  });
+}
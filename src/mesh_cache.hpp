@@ -0,0 +1,65 @@
+#ifndef __MESH_CACHE_HPP__
+#define __MESH_CACHE_HPP__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+using namespace std;
+using namespace glm;
+
+// Everything a Mesh needs from an FBX file, ready to be uploaded. The
+// vertex arrays have one entry per unique vertex and are drawn with the
+// indices. Bone arrays are empty for static meshes.
+struct MeshData {
+  vector<vec3> vertices;
+  vector<vec2> uvs;
+  vector<vec3> normals;
+  vector<vec3> tangents;
+  vector<vec3> bitangents;
+  vector<ivec3> bone_ids;
+  vector<vec3> bone_weights;
+  vector<unsigned int> indices;
+
+  vector<Polygon> polygons;
+  BoundingSphere bounding_sphere;
+
+  // Indexed by bone id. Ids without a joint have an empty name.
+  vector<string> bone_names;
+  vector<mat4> global_bindpose_inverse;
+  vector<Animation> animations;
+};
+
+// Size and modification time of the FBX file a cache was cooked from.
+struct MeshSource {
+  uint64_t size = 0;
+  int64_t modification_time = 0;
+};
+
+// Turns vertex arrays with one entry per triangle corner and no indices
+// into unique vertices and indices, merging corners whose attributes are
+// all equal.
+void WeldVertices(MeshData& data);
+
+// Uploads the vertex arrays and fills the mesh. Without GL (HEADLESS)
+// only the CPU side data is filled.
+void CreateMesh(const MeshData& data, Mesh& m);
+
+// Binary format: a header with the source stamp and a table of sections,
+// followed by the sections. Sections are plain arrays aligned to 16 bytes,
+// so a mapped file can be read in place. LoadMeshData throws if the data
+// is not a valid cache with the current version.
+void SaveMeshData(ostream& os, const MeshData& data, const MeshSource& source);
+void LoadMeshData(const char* bytes, size_t size, MeshData& data);
+
+// The cache of "foo.fbx" is "foo.mesh" in the same directory.
+string GetMeshCachePath(const string& fbx_filename);
+bool GetMeshSource(const string& fbx_filename, MeshSource& source);
+
+// Returns false if the cache is missing, has an old version or was cooked
+// from a different FBX file. A cache without its FBX file is always used.
+bool LoadMeshCache(const string& fbx_filename, MeshData& data);
+void SaveMeshCache(const string& fbx_filename, const MeshData& data);
+
+#endif // __MESH_CACHE_HPP__
@@ -0,0 +1,56 @@
+#include "fbx_loader.hpp"
+
+// Converts every FBX file under a directory to the binary mesh cache that
+// Resources::LoadMeshes reads instead of the FBX file. Files whose cache is
+// up to date are skipped unless --force is given.
+//
+// Usage: mesh_cooker [directory] [--force]
+int main(int argc, char** argv) {
+  string directory = "resources";
+  bool force = false;
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "--force") {
+      force = true;
+    } else {
+      directory = argv[i];
+    }
+  }
+
+  if (!boost::filesystem::is_directory(directory)) {
+    cout << "Usage: mesh_cooker [directory] [--force]" << endl;
+    return 1;
+  }
+
+  double start_time = GetTime();
+  int num_cooked = 0, num_skipped = 0, num_failed = 0;
+  boost::filesystem::recursive_directory_iterator end_itr;
+  for (boost::filesystem::recursive_directory_iterator itr(directory);
+    itr != end_itr; ++itr) {
+    if (!is_regular_file(itr->path())) continue;
+    if (!boost::iends_with(itr->path().string(), ".fbx")) continue;
+
+    const string fbx_filename = itr->path().string();
+    try {
+      MeshData mesh_data;
+      if (!force && LoadMeshCache(fbx_filename, mesh_data)) {
+        num_skipped++;
+        continue;
+      }
+
+      FbxData data;
+      data.name = fbx_filename;
+      FbxLoad(fbx_filename, data);
+      BuildMeshData(data, mesh_data);
+      SaveMeshCache(fbx_filename, mesh_data);
+      num_cooked++;
+    } catch (const exception& e) {
+      cout << "Could not cook " << fbx_filename << ": " << e.what() << endl;
+      num_failed++;
+    }
+  }
+
+  cout << "Cooked " << num_cooked << " meshes, " << num_skipped 
+    << " up to date, " << num_failed << " failed in "
+    << GetTime() - start_time << " seconds" << endl;
+  return num_failed > 0 ? 1 : 0;
+}
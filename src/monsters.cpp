@@ -514,7 +514,7 @@ void Monsters::Spiderling(ObjPtr unit) {
       bool movement_obstructed = dungeon.IsMovementObstructed(unit->position, target->position, t);
       if (!movement_obstructed && distance_to_player > 30.0f && unit->can_jump) {
         if (unit->CanUseAbility("spider-jump")) {
-          unit->cooldowns["spider-jump"] = glfwGetTime() + 1;
+          unit->cooldowns["spider-jump"] = GetTime() + 1;
           unit->actions.push(make_shared<SpiderJumpAction>(target->position));
           break;
         }
@@ -799,7 +799,7 @@ void Monsters::Frog(ObjPtr unit) {
     unit->was_hit = false;
     unit->ClearActions();
     unit->actions.push(make_shared<ChangeStateAction>(FLEE));
-    unit->cooldowns["frog-jump"] = glfwGetTime() + 2;
+    unit->cooldowns["frog-jump"] = GetTime() + 2;
   }
 
   switch (unit->ai_state) {
@@ -819,9 +819,9 @@ void Monsters::Frog(ObjPtr unit) {
       unit->actions.push(make_shared<FrogJumpAction>(target->position));
       unit->actions.push(make_shared<ChangeStateAction>(FLEE));
       if (unit->GetAsset()->name == "red_frog") {
-        unit->cooldowns["frog-jump"] = glfwGetTime() + 3;
+        unit->cooldowns["frog-jump"] = GetTime() + 3;
       } else {
-        unit->cooldowns["frog-jump"] = glfwGetTime() + 5;
+        unit->cooldowns["frog-jump"] = GetTime() + 5;
       }
       break;
     } 
@@ -916,7 +916,7 @@ void Monsters::Goblin(ObjPtr unit) {
       } else {
         unit->ClearActions();
         unit->ai_state = DEFEND;
-        unit->state_changed_at = glfwGetTime();
+        unit->state_changed_at = GetTime();
       }
     }
   }
@@ -1025,7 +1025,7 @@ void Monsters::GoblinChieftain(ObjPtr unit) {
       } else {
         unit->ClearActions();
         unit->ai_state = DEFEND;
-        unit->state_changed_at = glfwGetTime();
+        unit->state_changed_at = GetTime();
       }
     }
   }
@@ -1041,7 +1041,7 @@ void Monsters::GoblinChieftain(ObjPtr unit) {
         if (distance_to_player < 25.0f) {
           unit->actions.push(make_shared<TakeAimAction>());
           unit->actions.push(make_shared<SweepAttackAction>());
-          unit->cooldowns["sweep_attack"] = glfwGetTime() + 2.0f;
+          unit->cooldowns["sweep_attack"] = GetTime() + 2.0f;
         } else {
           unit->actions.push(make_shared<MoveToPlayerAction>());
         }
@@ -1049,7 +1049,7 @@ void Monsters::GoblinChieftain(ObjPtr unit) {
         unit->ClearActions();
         unit->actions.push(make_shared<TakeAimAction>());
         unit->actions.push(make_shared<SweepAttackAction>());
-        unit->cooldowns["sweep_attack"] = glfwGetTime() + 2.0f;
+        unit->cooldowns["sweep_attack"] = GetTime() + 2.0f;
       } else if (next_action->type == ACTION_MOVE) {
         shared_ptr<MoveAction> move_action =  
           static_pointer_cast<MoveAction>(next_action);
@@ -1124,7 +1124,7 @@ void Monsters::Minotaur(ObjPtr unit) {
         if (distance_to_player < 25.0f) {
           unit->actions.push(make_shared<TakeAimAction>());
           unit->actions.push(make_shared<SweepAttackAction>());
-          unit->cooldowns["sweep_attack"] = glfwGetTime() + 2.0f;
+          unit->cooldowns["sweep_attack"] = GetTime() + 2.0f;
         } else {
           unit->actions.push(make_shared<MoveToPlayerAction>());
         }
@@ -1132,7 +1132,7 @@ void Monsters::Minotaur(ObjPtr unit) {
         unit->ClearActions();
         unit->actions.push(make_shared<TakeAimAction>());
         unit->actions.push(make_shared<SweepAttackAction>());
-        unit->cooldowns["sweep_attack"] = glfwGetTime() + 2.0f;
+        unit->cooldowns["sweep_attack"] = GetTime() + 2.0f;
       } else if (next_action->type == ACTION_MOVE) {
         shared_ptr<MoveAction> move_action =  
           static_pointer_cast<MoveAction>(next_action);
@@ -1199,7 +1199,7 @@ void Monsters::Skirmisher(ObjPtr unit) {
       } else {
         unit->ClearActions();
         unit->ai_state = DEFEND;
-        unit->state_changed_at = glfwGetTime();
+        unit->state_changed_at = GetTime();
       }
     }
   }
@@ -1310,7 +1310,7 @@ void Monsters::GlaiveMaster(ObjPtr unit) {
       } else {
         unit->ClearActions();
         unit->ai_state = DEFEND;
-        unit->state_changed_at = glfwGetTime();
+        unit->state_changed_at = GetTime();
       }
     }
   }
@@ -1544,7 +1544,7 @@ void Monsters::Lancet(ObjPtr unit) {
       } else {
         unit->ClearActions();
         unit->actions.push(make_shared<ChangeStateAction>(AI_ATTACK));
-        unit->cooldowns["spider-web"] = glfwGetTime() + 5;
+        unit->cooldowns["spider-web"] = GetTime() + 5;
       }
       break;
     }
@@ -1934,7 +1934,7 @@ void Monsters::ShooterBug(ObjPtr unit) {
       } else {
         unit->ClearActions();
         unit->ai_state = DEFEND;
-        unit->state_changed_at = glfwGetTime();
+        unit->state_changed_at = GetTime();
       }
     }
   }
@@ -2138,7 +2138,7 @@ void Monsters::ArrowTrap(ObjPtr unit) {
 
       resources_->CastMissile(unit, pos, MISSILE_HORN, 
         d, missile_speed);
-      unit->cooldowns["arrow-trap"] = glfwGetTime() + 5;
+      unit->cooldowns["arrow-trap"] = GetTime() + 5;
     }
   }
 }
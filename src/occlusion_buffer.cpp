@@ -0,0 +1,227 @@
+#include "occlusion_buffer.hpp"
+
+#include <algorithm>
+#include "simd.hpp"
+
+using namespace simd;
+
+namespace {
+
+// Pixel centers of the lanes relative to the first pixel.
+const float kLaneOffsets[kMaxLanes] = {
+  0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f
+};
+
+// Clips the polygon against the near plane (z = -w) in clip space.
+int ClipNear(const vec4* in, int num_in, vec4* out) {
+  int num_out = 0;
+  for (int i = 0; i < num_in; i++) {
+    const vec4& a = in[i];
+    const vec4& b = in[(i + 1) % num_in];
+    float da = a.z + a.w;
+    float db = b.z + b.w;
+    if (da >= 0.0f) out[num_out++] = a;
+    if ((da >= 0.0f) != (db >= 0.0f)) {
+      float t = da / (da - db);
+      out[num_out++] = a + (b - a) * t;
+    }
+  }
+  return num_out;
+}
+
+vec3 GetBoxCorner(const vec3& min, const vec3& max, int i) {
+  return vec3((i & 1) ? max.x : min.x, (i & 2) ? max.y : min.y,
+    (i & 4) ? max.z : min.z);
+}
+
+// Corner indices of the 12 triangles of a box.
+const int kBoxTriangles[36] = {
+  0, 1, 3, 0, 3, 2, // -z
+  4, 5, 7, 4, 7, 6, // +z
+  0, 1, 5, 0, 5, 4, // -y
+  2, 3, 7, 2, 7, 6, // +y
+  0, 2, 6, 0, 6, 4, // -x
+  1, 3, 7, 1, 7, 5  // +x
+};
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer(int width, int height) : width_(width),
+  height_(height) {
+  int w = width_, h = height_;
+  while (true) {
+    level_sizes_.push_back(ivec2(w, h));
+    levels_.push_back(vector<float>(w * h, 1.0f));
+    if (w == 1 && h == 1) break;
+    w = std::max(1, (w + 1) / 2);
+    h = std::max(1, (h + 1) / 2);
+  }
+}
+
+void OcclusionBuffer::Clear(const mat4& view_projection) {
+  view_projection_ = view_projection;
+  for (vector<float>& level : levels_) {
+    std::fill(level.begin(), level.end(), 1.0f);
+  }
+  metrics_ = OcclusionMetrics();
+}
+
+void OcclusionBuffer::RasterizeTriangle(const vec4& a, const vec4& b,
+  const vec4& c) {
+  // Screen space, with y going up like NDC.
+  vec3 v[3];
+  const vec4* clip[3] = { &a, &b, &c };
+  for (int i = 0; i < 3; i++) {
+    const vec4& p = *clip[i];
+    v[i] = vec3((p.x / p.w * 0.5f + 0.5f) * width_,
+      (p.y / p.w * 0.5f + 0.5f) * height_, p.z / p.w * 0.5f + 0.5f);
+  }
+
+  float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) -
+    (v[1].y - v[0].y) * (v[2].x - v[0].x);
+  if (area == 0.0f) return;
+  if (area < 0.0f) {
+    std::swap(v[1], v[2]);
+    area = -area;
+  }
+
+  int min_x = std::max(0, int(floor(std::min({ v[0].x, v[1].x, v[2].x }))));
+  int max_x = std::min(width_ - 1,
+    int(ceil(std::max({ v[0].x, v[1].x, v[2].x }))));
+  int min_y = std::max(0, int(floor(std::min({ v[0].y, v[1].y, v[2].y }))));
+  int max_y = std::min(height_ - 1,
+    int(ceil(std::max({ v[0].y, v[1].y, v[2].y }))));
+  if (min_x > max_x || min_y > max_y) return;
+
+  // Edge i is opposite to vertex i, so its function is the barycentric
+  // weight of vertex i times the area: e = dx * x + dy * y + c.
+  float edge_dx[3], edge_dy[3], edge_c[3];
+  for (int i = 0; i < 3; i++) {
+    const vec3& p = v[(i + 1) % 3];
+    const vec3& q = v[(i + 2) % 3];
+    edge_dx[i] = -(q.y - p.y);
+    edge_dy[i] = q.x - p.x;
+    edge_c[i] = -(edge_dx[i] * p.x + edge_dy[i] * p.y);
+  }
+
+  const float inv_area = 1.0f / area;
+  const Lanes zero = Broadcast(0.0f);
+  const Lanes lane_offsets = LoadLanes(kLaneOffsets);
+  const Lanes d0 = Broadcast(v[0].z * inv_area);
+  const Lanes d1 = Broadcast(v[1].z * inv_area);
+  const Lanes d2 = Broadcast(v[2].z * inv_area);
+
+  vector<float>& depth = levels_[0];
+  int start_x = min_x - min_x % kLanes;
+  for (int y = min_y; y <= max_y; y++) {
+    float py = y + 0.5f;
+    float* row = &depth[y * width_];
+    for (int x = start_x; x <= max_x; x += kLanes) {
+      Lanes px = Add(Broadcast(float(x)), lane_offsets);
+      Lanes e0 = Add(Mul(px, Broadcast(edge_dx[0])),
+        Broadcast(edge_dy[0] * py + edge_c[0]));
+      Lanes e1 = Add(Mul(px, Broadcast(edge_dx[1])),
+        Broadcast(edge_dy[1] * py + edge_c[1]));
+      Lanes e2 = Add(Mul(px, Broadcast(edge_dx[2])),
+        Broadcast(edge_dy[2] * py + edge_c[2]));
+      Lanes inside = And(And(LessEqual(zero, e0), LessEqual(zero, e1)),
+        LessEqual(zero, e2));
+      if (!MoveMask(inside)) continue;
+
+      Lanes d = Add(Add(Mul(e0, d0), Mul(e1, d1)), Mul(e2, d2));
+      Lanes old_d = LoadLanes(row + x);
+      StoreLanes(row + x, Select(inside, Min(d, old_d), old_d));
+    }
+  }
+  metrics_.num_triangles++;
+}
+
+void OcclusionBuffer::AddOccluder(const vector<vec3>& vertices,
+  const mat4& model_matrix) {
+  const mat4 MVP = view_projection_ * model_matrix;
+  for (size_t i = 0; i + 2 < vertices.size(); i += 3) {
+    vec4 triangle[3];
+    for (int j = 0; j < 3; j++) {
+      triangle[j] = MVP * vec4(vertices[i + j], 1.0f);
+    }
+
+    vec4 polygon[4];
+    int n = ClipNear(triangle, 3, polygon);
+    for (int j = 1; j + 1 < n; j++) {
+      RasterizeTriangle(polygon[0], polygon[j], polygon[j + 1]);
+    }
+  }
+  metrics_.num_occluders++;
+}
+
+void OcclusionBuffer::AddOccluderBox(const vec3& min, const vec3& max,
+  const mat4& model_matrix) {
+  vector<vec3> vertices;
+  for (int i = 0; i < 36; i++) {
+    vertices.push_back(GetBoxCorner(min, max, kBoxTriangles[i]));
+  }
+  AddOccluder(vertices, model_matrix);
+}
+
+void OcclusionBuffer::BuildHiZ() {
+  for (size_t level = 1; level < levels_.size(); level++) {
+    const vector<float>& src = levels_[level - 1];
+    const ivec2& src_size = level_sizes_[level - 1];
+    vector<float>& dst = levels_[level];
+    const ivec2& size = level_sizes_[level];
+    for (int y = 0; y < size.y; y++) {
+      int y0 = std::min(2 * y, src_size.y - 1);
+      int y1 = std::min(2 * y + 1, src_size.y - 1);
+      for (int x = 0; x < size.x; x++) {
+        int x0 = std::min(2 * x, src_size.x - 1);
+        int x1 = std::min(2 * x + 1, src_size.x - 1);
+        dst[y * size.x + x] = std::max(
+          std::max(src[y0 * src_size.x + x0], src[y0 * src_size.x + x1]),
+          std::max(src[y1 * src_size.x + x0], src[y1 * src_size.x + x1]));
+      }
+    }
+  }
+}
+
+bool OcclusionBuffer::IsVisible(const vec3& min, const vec3& max) {
+  metrics_.num_tested++;
+
+  vec2 screen_min = vec2(width_, height_);
+  vec2 screen_max = vec2(0, 0);
+  float min_depth = 1.0f;
+  for (int i = 0; i < 8; i++) {
+    vec4 p = view_projection_ * vec4(GetBoxCorner(min, max, i), 1.0f);
+    if (p.z < -p.w || p.w <= 0.0f) return true;
+
+    vec3 ndc = vec3(p.x / p.w, p.y / p.w, p.z / p.w);
+    vec2 s = vec2((ndc.x * 0.5f + 0.5f) * width_,
+      (ndc.y * 0.5f + 0.5f) * height_);
+    screen_min = vec2(std::min(screen_min.x, s.x), std::min(screen_min.y, s.y));
+    screen_max = vec2(std::max(screen_max.x, s.x), std::max(screen_max.y, s.y));
+    min_depth = std::min(min_depth, ndc.z * 0.5f + 0.5f);
+  }
+
+  int x0 = std::max(0, int(floor(screen_min.x)));
+  int y0 = std::max(0, int(floor(screen_min.y)));
+  int x1 = std::min(width_ - 1, int(floor(screen_max.x)));
+  int y1 = std::min(height_ - 1, int(floor(screen_max.y)));
+  if (x0 > x1 || y0 > y1) return true;
+
+  // Coarsest level where the box covers at most 2x2 texels.
+  int level = 0;
+  while (level + 1 < int(levels_.size()) &&
+    ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+    level++;
+  }
+
+  const vector<float>& depth = levels_[level];
+  int level_width = level_sizes_[level].x;
+  for (int y = y0 >> level; y <= y1 >> level; y++) {
+    for (int x = x0 >> level; x <= x1 >> level; x++) {
+      if (min_depth <= depth[y * level_width + x]) return true;
+    }
+  }
+
+  metrics_.num_occluded++;
+  return false;
+}
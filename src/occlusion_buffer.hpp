@@ -0,0 +1,64 @@
+#ifndef __OCCLUSION_BUFFER_HPP__
+#define __OCCLUSION_BUFFER_HPP__
+
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// The width must be a multiple of simd::kMaxLanes.
+const int kOcclusionBufferWidth = 256;
+const int kOcclusionBufferHeight = 128;
+
+struct OcclusionMetrics {
+  int num_occluders = 0;
+  int num_triangles = 0;
+  int num_tested = 0;
+  int num_occluded = 0;
+};
+
+// Low resolution depth buffer rasterized on the CPU from a few large
+// occluders, like dungeon walls. Bounding boxes are then tested against a
+// hierarchical Z pyramid where each texel keeps the farthest depth of the
+// four texels below it, so a box is hidden if its nearest depth is behind
+// the farthest occluder depth over the texels it covers.
+//
+// Depths are in [0, 1] like the GL depth buffer, and the buffer starts at
+// 1 (far). Boxes that cross the near plane are always visible.
+class OcclusionBuffer {
+  int width_;
+  int height_;
+  mat4 view_projection_;
+
+  // Level 0 is the depth buffer.
+  vector<vector<float>> levels_;
+  vector<ivec2> level_sizes_;
+  OcclusionMetrics metrics_;
+
+  void RasterizeTriangle(const vec4& a, const vec4& b, const vec4& c);
+
+ public:
+  OcclusionBuffer(int width = kOcclusionBufferWidth,
+    int height = kOcclusionBufferHeight);
+
+  // Starts a frame. Occluders and boxes are in world space.
+  void Clear(const mat4& view_projection);
+
+  // Triangle list, three vertices per triangle.
+  void AddOccluder(const vector<vec3>& vertices, const mat4& model_matrix);
+  void AddOccluderBox(const vec3& min, const vec3& max,
+    const mat4& model_matrix);
+
+  // Must be called after adding the occluders and before the tests.
+  void BuildHiZ();
+  bool IsVisible(const vec3& min, const vec3& max);
+
+  int GetWidth() { return width_; }
+  int GetHeight() { return height_; }
+  float GetDepth(int x, int y) { return levels_[0][y * width_ + x]; }
+  int GetNumLevels() { return levels_.size(); }
+  const OcclusionMetrics& GetMetrics() { return metrics_; }
+};
+
+#endif // __OCCLUSION_BUFFER_HPP__
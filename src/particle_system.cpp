@@ -0,0 +1,221 @@
+#include "particle_system.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include "simd.hpp"
+
+using namespace simd;
+
+namespace {
+
+const int kInitialCapacity = 1024;
+
+// Same constants as Resources::UpdateParticles.
+const float kGravity = 9.81f * 0.01f;
+const float kTimeStep = 0.01f;
+
+uint32_t FloatToSortKey(float f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(float));
+
+  // Makes negative floats sort before positive ones as unsigned ints.
+  return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+}
+
+} // namespace
+
+ParticleSystem::ParticleSystem(int max_particles)
+  : max_particles_(max_particles) {
+}
+
+int ParticleSystem::AddType(const string& name, int first_frame,
+  int num_frames, int keep_frame, int grid_size, bool moves) {
+  lock_guard<mutex> lock(mutex_);
+  int type = FindType(name);
+  if (type == -1) {
+    type = types_.size();
+    types_.push_back(Type());
+  }
+
+  types_[type] = { name, first_frame, std::max(1, num_frames),
+    std::max(1, keep_frame), std::max(1, grid_size), moves };
+  return type;
+}
+
+int ParticleSystem::FindType(const string& name) {
+  for (size_t i = 0; i < types_.size(); i++) {
+    if (types_[i].name == name) return i;
+  }
+  return -1;
+}
+
+int ParticleSystem::GetTypeIndex(const string& name) {
+  lock_guard<mutex> lock(mutex_);
+  return FindType(name);
+}
+
+int ParticleSystem::GetNumTypes() {
+  lock_guard<mutex> lock(mutex_);
+  return types_.size();
+}
+
+string ParticleSystem::GetTypeName(int type) {
+  lock_guard<mutex> lock(mutex_);
+  return types_[type].name;
+}
+
+void ParticleSystem::Grow() {
+  int capacity = std::max(kInitialCapacity, int(life_.size()) * 2);
+  capacity = std::min(capacity, max_particles_);
+  capacity = (capacity + kMaxLanes - 1) / kMaxLanes * kMaxLanes;
+  for (vector<float>* v : { &x_, &y_, &z_, &speed_x_, &speed_y_,
+    &speed_z_, &gravity_, &life_, &size_ }) {
+    v->resize(capacity, 0.0f);
+  }
+  color_.resize(capacity);
+  frame_.resize(capacity);
+  type_.resize(capacity);
+}
+
+bool ParticleSystem::Emit(int type, const vec3& position, const vec3& speed,
+  const vec4& color, float size, float life) {
+  lock_guard<mutex> lock(mutex_);
+  if (type < 0 || type >= int(types_.size())) return false;
+
+  if (num_particles_ >= max_particles_) {
+    metrics_.num_dropped++;
+    return false;
+  }
+  if (num_particles_ == int(life_.size())) Grow();
+
+  const bool moves = types_[type].moves;
+  int i = num_particles_++;
+  x_[i] = position.x;
+  y_[i] = position.y;
+  z_[i] = position.z;
+  speed_x_[i] = moves ? speed.x : 0.0f;
+  speed_y_[i] = moves ? speed.y : 0.0f;
+  speed_z_[i] = moves ? speed.z : 0.0f;
+  gravity_[i] = moves ? kGravity : 0.0f;
+  life_[i] = life;
+  size_[i] = size;
+  color_[i] = color;
+  frame_[i] = 0;
+  type_[i] = type;
+
+  metrics_.num_particles = num_particles_;
+  metrics_.max_particles = std::max(metrics_.max_particles, num_particles_);
+  return true;
+}
+
+void ParticleSystem::Remove(int i) {
+  int last = --num_particles_;
+  x_[i] = x_[last];
+  y_[i] = y_[last];
+  z_[i] = z_[last];
+  speed_x_[i] = speed_x_[last];
+  speed_y_[i] = speed_y_[last];
+  speed_z_[i] = speed_z_[last];
+  gravity_[i] = gravity_[last];
+  life_[i] = life_[last];
+  size_[i] = size_[last];
+  color_[i] = color_[last];
+  frame_[i] = frame_[last];
+  type_[i] = type_[last];
+}
+
+void ParticleSystem::Update() {
+  lock_guard<mutex> lock(mutex_);
+
+  // The padding after the last particle is updated too, it is never read.
+  const Lanes one = Broadcast(1.0f);
+  const Lanes time_step = Broadcast(kTimeStep);
+  for (int i = 0; i < num_particles_; i += kLanes) {
+    StoreLanes(&life_[i], Sub(LoadLanes(&life_[i]), one));
+
+    Lanes speed_y = Sub(LoadLanes(&speed_y_[i]), LoadLanes(&gravity_[i]));
+    StoreLanes(&speed_y_[i], speed_y);
+
+    StoreLanes(&x_[i], Add(LoadLanes(&x_[i]),
+      Mul(LoadLanes(&speed_x_[i]), time_step)));
+    StoreLanes(&y_[i], Add(LoadLanes(&y_[i]), Mul(speed_y, time_step)));
+    StoreLanes(&z_[i], Add(LoadLanes(&z_[i]),
+      Mul(LoadLanes(&speed_z_[i]), time_step)));
+  }
+
+  // Animation frames and dead particles. Going backwards, the particle
+  // moved into a removed slot has already been updated.
+  for (int i = num_particles_ - 1; i >= 0; i--) {
+    if (life_[i] < 0.0f) {
+      Remove(i);
+      continue;
+    }
+
+    const Type& type = types_[type_[i]];
+    if (int(life_[i]) % type.keep_frame == 0) frame_[i]++;
+    if (frame_[i] >= type.num_frames) frame_[i] = 0;
+  }
+  metrics_.num_particles = num_particles_;
+}
+
+void ParticleSystem::GetInstances(const vec3& camera_position,
+  vector<vector<ParticleInstance>>& instances) {
+  lock_guard<mutex> lock(mutex_);
+  if (instances.size() < types_.size()) instances.resize(types_.size());
+
+  for (int i = 0; i < num_particles_; i++) {
+    const Type& type = types_[type_[i]];
+    int index = frame_[i] + type.first_frame;
+    float tile_size = 1.0f / float(type.grid_size);
+
+    ParticleInstance instance;
+    instance.position = vec4(x_[i], y_[i], z_[i], size_[i]);
+    instance.color = color_[i];
+    instance.uv.x = int(index % type.grid_size) * tile_size + tile_size / 2;
+    instance.uv.y = (type.grid_size - int(index / type.grid_size) - 1) *
+      tile_size + tile_size / 2;
+
+    vec3 d = vec3(x_[i], y_[i], z_[i]) - camera_position;
+    instance.camera_distance = dot(d, d);
+    instances[type_[i]].push_back(instance);
+  }
+}
+
+void ParticleSystem::Clear() {
+  lock_guard<mutex> lock(mutex_);
+  num_particles_ = 0;
+  metrics_.num_particles = 0;
+}
+
+// LSD radix sort on the distance bits, a comparison sort is too slow for
+// 100k particles every frame.
+void SortParticleInstances(vector<ParticleInstance>& instances) {
+  const int n = instances.size();
+  if (n < 2) return;
+
+  thread_local vector<pair<uint32_t, int>> keys, tmp;
+  keys.resize(n);
+  tmp.resize(n);
+  for (int i = 0; i < n; i++) {
+    // Inverted for far to near.
+    keys[i] = { ~FloatToSortKey(instances[i].camera_distance), i };
+  }
+
+  for (int shift = 0; shift < 32; shift += 8) {
+    int offsets[257] = {};
+    for (int i = 0; i < n; i++) {
+      offsets[((keys[i].first >> shift) & 0xFF) + 1]++;
+    }
+    for (int i = 0; i < 256; i++) offsets[i + 1] += offsets[i];
+    for (int i = 0; i < n; i++) {
+      tmp[offsets[(keys[i].first >> shift) & 0xFF]++] = keys[i];
+    }
+    keys.swap(tmp);
+  }
+
+  thread_local vector<ParticleInstance> sorted;
+  sorted.resize(n);
+  for (int i = 0; i < n; i++) sorted[i] = instances[keys[i].second];
+  instances.swap(sorted);
+}
@@ -0,0 +1,101 @@
+#ifndef __PARTICLE_SYSTEM_HPP__
+#define __PARTICLE_SYSTEM_HPP__
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+const int kMaxEffectParticles = 131072;
+
+struct ParticleInstance {
+  vec4 position; // Position and size.
+  vec4 color;
+  vec2 uv;
+  float camera_distance;
+};
+
+struct ParticleSystemMetrics {
+  int num_particles = 0;
+  int max_particles = 0;
+  int num_dropped = 0;
+};
+
+// Particles for visual effects that don't collide and aren't attached to
+// objects. Unlike the Particle game objects, they are stored as separate
+// arrays of positions, speeds, lives, frames and types, so the update runs
+// over the live particles with SIMD and spawning a particle never touches
+// the heap once the arrays have grown. Live particles are kept packed at
+// the front of the arrays: the free slots are the tail, so a new particle
+// takes the first free slot and a dead one is replaced by the last live
+// particle.
+class ParticleSystem {
+  struct Type {
+    string name;
+    int first_frame;
+    int num_frames;
+    int keep_frame;
+    int grid_size;
+    bool moves;
+  };
+
+  int max_particles_;
+  int num_particles_ = 0;
+  vector<Type> types_;
+
+  // Padded to a multiple of simd::kMaxLanes.
+  vector<float> x_, y_, z_;
+  vector<float> speed_x_, speed_y_, speed_z_;
+  vector<float> gravity_;
+  vector<float> life_;
+  vector<float> size_;
+  vector<vec4> color_;
+  vector<int> frame_;
+  vector<int> type_;
+
+  ParticleSystemMetrics metrics_;
+  mutex mutex_;
+
+  void Grow();
+  void Remove(int i);
+  int FindType(const string& name);
+
+ public:
+  ParticleSystem(int max_particles = kMaxEffectParticles);
+
+  // Types that don't move ignore the speed given to Emit. Types are added
+  // from the AI job and the main thread, so the type queries lock too and
+  // return copies.
+  int AddType(const string& name, int first_frame, int num_frames,
+    int keep_frame, int grid_size, bool moves);
+  int GetTypeIndex(const string& name);
+  int GetNumTypes();
+  string GetTypeName(int type);
+
+  // Returns false if the system is full.
+  bool Emit(int type, const vec3& position, const vec3& speed,
+    const vec4& color, float size, float life);
+
+  // One simulation step, with the same units as Resources::UpdateParticles.
+  void Update();
+
+  // Appends the live particles to instances[type], indexed by type.
+  void GetInstances(const vec3& camera_position,
+    vector<vector<ParticleInstance>>& instances);
+
+  void Clear();
+
+  int GetNumParticles() { return num_particles_; }
+  vec3 GetPosition(int i) { return vec3(x_[i], y_[i], z_[i]); }
+  float GetLife(int i) { return life_[i]; }
+  int GetFrame(int i) { return frame_[i]; }
+  const ParticleSystemMetrics& GetMetrics() { return metrics_; }
+};
+
+// Sorts far to near, the order for alpha blending.
+void SortParticleInstances(vector<ParticleInstance>& instances);
+
+#endif // __PARTICLE_SYSTEM_HPP__
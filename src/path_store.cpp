@@ -0,0 +1,94 @@
+#include "path_store.hpp"
+
+PathStore::PathStore(int size, size_t memory_budget, CalculateFn calculate_fn)
+  : size_(size), memory_budget_(memory_budget), calculate_fn_(calculate_fn) {
+}
+
+shared_ptr<const FlowField> PathStore::Get(const ivec2& dest) {
+  const int key = GetKey(dest);
+  uint64_t generation;
+  {
+    lock_guard<mutex> lock(mutex_);
+    auto it = fields_.find(key);
+    if (it != fields_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second);
+      metrics_.hits++;
+      return *it->second;
+    }
+    metrics_.misses++;
+    generation = generation_;
+  }
+
+  // Calculated outside the lock so other destinations can be served in the
+  // meantime. If two threads miss on the same tile the first insert wins.
+  shared_ptr<const FlowField> field = calculate_fn_(dest);
+
+  lock_guard<mutex> lock(mutex_);
+
+  // The dungeon changed while calculating, so the field may be stale.
+  if (generation != generation_) return field;
+
+  auto it = fields_.find(key);
+  if (it != fields_.end()) {
+    return *it->second;
+  }
+  Insert(field);
+  return field;
+}
+
+void PathStore::Insert(shared_ptr<const FlowField> field) {
+  lru_.push_front(field);
+  fields_[GetKey(field->dest)] = lru_.begin();
+  metrics_.memory_usage += field->GetMemoryUsage();
+  metrics_.num_fields++;
+  Evict();
+}
+
+void PathStore::Evict() {
+  // Always keep the most recent field, even if it alone is over budget.
+  while (metrics_.memory_usage > memory_budget_ && lru_.size() > 1) {
+    shared_ptr<const FlowField> field = lru_.back();
+    lru_.pop_back();
+    fields_.erase(GetKey(field->dest));
+    metrics_.memory_usage -= field->GetMemoryUsage();
+    metrics_.num_fields--;
+    metrics_.evictions++;
+  }
+}
+
+void PathStore::Invalidate(const ivec2& tile, int radius) {
+  lock_guard<mutex> lock(mutex_);
+  generation_++;
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    const ivec2& dest = (*it)->dest;
+    if (abs(dest.x - tile.x) > radius || abs(dest.y - tile.y) > radius) {
+      ++it;
+      continue;
+    }
+
+    fields_.erase(GetKey(dest));
+    metrics_.memory_usage -= (*it)->GetMemoryUsage();
+    metrics_.num_fields--;
+    it = lru_.erase(it);
+  }
+}
+
+void PathStore::Clear() {
+  lock_guard<mutex> lock(mutex_);
+  generation_++;
+  lru_.clear();
+  fields_.clear();
+  metrics_.memory_usage = 0;
+  metrics_.num_fields = 0;
+}
+
+void PathStore::SetMemoryBudget(size_t memory_budget) {
+  lock_guard<mutex> lock(mutex_);
+  memory_budget_ = memory_budget;
+  Evict();
+}
+
+PathStoreMetrics PathStore::GetMetrics() {
+  lock_guard<mutex> lock(mutex_);
+  return metrics_;
+}
@@ -0,0 +1,92 @@
+#ifndef __PATH_STORE_HPP__
+#define __PATH_STORE_HPP__
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// Move code used for tiles that cannot reach the destination.
+const uint8_t kNoPathCode = 9;
+const float kNoPathDistance = 9999999;
+
+// Best move and distance towards one destination tile for every tile of a
+// size x size dungeon.
+struct FlowField {
+  ivec2 dest;
+  int size;
+  vector<uint8_t> codes;
+  vector<float> distances;
+
+  FlowField(const ivec2& dest, int size) : dest(dest), size(size),
+    codes(size * size, kNoPathCode), distances(size * size, kNoPathDistance) {}
+
+  uint8_t GetCode(const ivec2& tile) const {
+    return codes[tile.x * size + tile.y];
+  }
+
+  float GetDistance(const ivec2& tile) const {
+    return distances[tile.x * size + tile.y];
+  }
+
+  size_t GetMemoryUsage() const {
+    return sizeof(FlowField) + codes.size() * sizeof(uint8_t) +
+      distances.size() * sizeof(float);
+  }
+};
+
+struct PathStoreMetrics {
+  int hits = 0;
+  int misses = 0;
+  int evictions = 0;
+  int num_fields = 0;
+  size_t memory_usage = 0;
+};
+
+// LRU cache of flow fields keyed by destination tile. Fields are calculated
+// on demand and the least recently used ones are dropped once the memory
+// budget is exceeded.
+class PathStore {
+  typedef function<shared_ptr<FlowField>(const ivec2&)> CalculateFn;
+  typedef list<shared_ptr<const FlowField>> FieldList;
+
+  int size_;
+  size_t memory_budget_;
+  CalculateFn calculate_fn_;
+
+  mutex mutex_;
+  FieldList lru_;
+  unordered_map<int, FieldList::iterator> fields_;
+  PathStoreMetrics metrics_;
+
+  // Bumped by Invalidate and Clear, so fields calculated before them are
+  // not cached.
+  uint64_t generation_ = 0;
+
+  int GetKey(const ivec2& dest) { return dest.x * size_ + dest.y; }
+  void Insert(shared_ptr<const FlowField> field);
+  void Evict();
+
+ public:
+  PathStore(int size, size_t memory_budget, CalculateFn calculate_fn);
+
+  // Returns the flow field towards dest, calculating it on a miss. Safe to
+  // call from multiple threads.
+  shared_ptr<const FlowField> Get(const ivec2& dest);
+
+  // Drops fields whose destination is within radius tiles of tile.
+  void Invalidate(const ivec2& tile, int radius);
+  void Clear();
+
+  void SetMemoryBudget(size_t memory_budget);
+  size_t GetMemoryBudget() { return memory_budget_; }
+  PathStoreMetrics GetMetrics();
+};
+
+#endif // __PATH_STORE_HPP__
@@ -59,7 +59,7 @@ void Physics::RunPhysicsForObject(ObjPtr obj) {
   }
 
   // Stabilize items after a few seconds.
-  if (obj->IsItem() && glfwGetTime() > obj->created_at + 10) {
+  if (obj->IsItem() && GetTime() > obj->created_at + 10) {
     obj->physics_behavior = PHYSICS_FIXED;
     return;
   }
@@ -132,7 +132,7 @@ void Physics::RunPhysicsForObject(ObjPtr obj) {
     obj->torque *= 0.96;
   }
 
-  obj->updated_at = glfwGetTime();
+  obj->updated_at = GetTime();
 }
 
 void Physics::RunPhysicsInOctreeNode(shared_ptr<OctreeNode> node) {
@@ -141,13 +141,13 @@ void Physics::RunPhysicsInOctreeNode(shared_ptr<OctreeNode> node) {
   const vec3& player_pos = resources_->GetPlayer()->position;
   for (int i = 0; i < 3; i++) {
     if ((player_pos[i] - node->center[i]) > 
-      node->half_dimensions[i] + kMinDistance) {
+      node->loose_half_dimensions[i] + kMinDistance) {
       return;
     }
   }
 
   resources_->Lock();
-  for (auto [id, obj] : node->moving_objs) {
+  for (ObjPtr obj : node->moving_objs) {
     if (obj->type != GAME_OBJ_DEFAULT) continue;
     RunPhysicsForObject(obj);
   }
@@ -162,7 +162,7 @@ void Physics::RunPhysicsForMissiles(shared_ptr<OctreeNode> node) {
   if (!node) return;
 
   resources_->Lock();
-  for (auto [id, obj] : node->moving_objs) {
+  for (ObjPtr obj : node->moving_objs) {
     if (obj->type != GAME_OBJ_MISSILE) continue;
     RunPhysicsForObject(obj);
   }
@@ -42,7 +42,7 @@ bool PlayerInput::InteractWithItem(GLFWwindow* window, const Camera& c,
             door->state = DOOR_OPENING;
             if (door->dungeon_tile.x != -1) {
               resources_->GetDungeon().SetDoorOpen(door->dungeon_tile);
-              dungeon.CalculateAllPathsAsync(door->dungeon_tile);
+              dungeon.InvalidatePaths(door->dungeon_tile);
             }
             for (shared_ptr<Event> e : door->on_open_events) {
               shared_ptr<DoorEvent> door_event = static_pointer_cast<DoorEvent>(e);
@@ -52,7 +52,7 @@ bool PlayerInput::InteractWithItem(GLFWwindow* window, const Camera& c,
             door->state = DOOR_CLOSING;
             if (door->dungeon_tile.x != -1) {
               resources_->GetDungeon().SetDoorClosed(door->dungeon_tile);
-              dungeon.CalculateAllPathsAsync(door->dungeon_tile);
+              dungeon.InvalidatePaths(door->dungeon_tile);
             }
           }
         }
@@ -79,7 +79,7 @@ bool PlayerInput::InteractWithItem(GLFWwindow* window, const Camera& c,
           Dungeon& dungeon = resources_->GetDungeon();
           ivec2 tile = dungeon.GetDungeonTile(item->position);
           dungeon.UnsetFlag(tile, DLRG_SPELL_WALL);
-          dungeon.CalculateAllPathsAsync(tile);
+          dungeon.InvalidatePaths(tile);
           resources_->RemoveObject(item);
           resources_->CalculateCollisionData();
           resources_->GenerateOptimizedOctree();
@@ -228,8 +228,8 @@ void PlayerInput::EditTerrain(GLFWwindow* window, const Camera& c) {
     return;
   }
 
-  int state1 = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
-  int state2 = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
+  int state1 = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
+  int state2 = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
   int left_or_right = (state1 == GLFW_PRESS) ? 1 : 0;
   left_or_right = (state2 == GLFW_PRESS) ? -1 : left_or_right;
   if (left_or_right != 0) {
@@ -314,7 +314,7 @@ void PlayerInput::Build(GLFWwindow* window, const Camera& c) {
     TerrainPoint p = resources_->GetHeightMap().GetTerrainPoint(tile.x, tile.y);
     configs->new_building->position = vec3(tile.x, p.height, tile.y);
 
-    int state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
+    int state = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
     if (state == GLFW_PRESS) {
       resources_->SetGameState(STATE_GAME);
       ObjPtr player = resources_->GetPlayer();
@@ -406,7 +406,7 @@ void PlayerInput::PlaceObject(GLFWwindow* window, const Camera& c) {
     }
   }
 
-  int state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
+  int state = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT);
   if (state == GLFW_PRESS) {
     configs->place_object = false;
     configs->scale_object = false;
@@ -414,7 +414,7 @@ void PlayerInput::PlaceObject(GLFWwindow* window, const Camera& c) {
     return;
   }
 
-  state = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
+  state = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_LEFT);
   if (state == GLFW_PRESS) {
     resources_->SetGameState(STATE_GAME);
     if (configs->new_building->type == GAME_OBJ_DEFAULT) {
@@ -492,7 +492,7 @@ bool PlayerInput::UseItem(int position) {
 
       player->scepter = item_id;
       player->charges = 10;
-      player->scepter_timeout = glfwGetTime() + 30;
+      player->scepter_timeout = GetTime() + 30;
       StartDrawing();
       configs->active_items[position] = 0;
       obj->frame = 0;
@@ -715,7 +715,7 @@ bool PlayerInput::CastSpellOrUseItem() {
           player->mana += arcane_spell->mana_cost;
           obj->active_animation = "Armature|channel_ray";
           player->player_action = PLAYER_CHANNELING;
-          channel_until_ = glfwGetTime() + 1.0f;
+          channel_until_ = GetTime() + 1.0f;
           obj->frame = 0;
           scepter->frame = 0;
           animation_frame_ = 60;
@@ -776,7 +776,7 @@ bool PlayerInput::CastSpellOrUseItem() {
           TRANSITION_FINISH_ANIMATION);
 
         player->player_action = PLAYER_CHANNELING;
-        channel_until_ = glfwGetTime() + 5.0f;
+        channel_until_ = GetTime() + 5.0f;
         obj->frame = 0;
         scepter->frame = 0;
         animation_frame_ = 180;
@@ -965,7 +965,7 @@ void PlayerInput::ProcessPlayerCasting() {
           break;
         case 1: {
           resources_->CastWindslash(camera_);
-          player->cooldowns["windslash"] = glfwGetTime() + 10.0f;
+          player->cooldowns["windslash"] = GetTime() + 10.0f;
           break;
         }
         case 2:
@@ -1061,7 +1061,7 @@ void PlayerInput::ProcessPlayerShield() {
     p->associated_bone = bone_id;
     // player->AddTemporaryStatus(make_shared<ShieldStatus>(0.5f, 1));
     resources_->CastPush(player->position);
-    player->cooldowns["push"] = glfwGetTime() + 10.0f;
+    player->cooldowns["push"] = GetTime() + 10.0f;
   } 
 }
 
@@ -1196,10 +1196,10 @@ void PlayerInput::ProcessMovement() {
   float d = resources_->GetDeltaTime() / 0.016666f;
 
   int num_keys = 0;
-  if (glfwGetKey(window_, GLFW_KEY_W) == GLFW_PRESS) num_keys++;
-  if (glfwGetKey(window_, GLFW_KEY_A) == GLFW_PRESS) num_keys++;
-  if (glfwGetKey(window_, GLFW_KEY_S) == GLFW_PRESS) num_keys++;
-  if (glfwGetKey(window_, GLFW_KEY_D) == GLFW_PRESS) num_keys++;
+  if (GetInputKey(window_, GLFW_KEY_W) == GLFW_PRESS) num_keys++;
+  if (GetInputKey(window_, GLFW_KEY_A) == GLFW_PRESS) num_keys++;
+  if (GetInputKey(window_, GLFW_KEY_S) == GLFW_PRESS) num_keys++;
+  if (GetInputKey(window_, GLFW_KEY_D) == GLFW_PRESS) num_keys++;
  
   float player_speed = resources_->GetConfigs()->player_speed; 
   float jump_force = resources_->GetConfigs()->jump_force; 
@@ -1209,7 +1209,7 @@ void PlayerInput::ProcessMovement() {
     speed *= 0.707106781;
   }
 
-  float cur_time = glfwGetTime();
+  float cur_time = GetTime();
 
   vec3 right = glm::vec3(
     sin(player->rotation.y - 3.14f/2.0f), 
@@ -1224,7 +1224,7 @@ void PlayerInput::ProcessMovement() {
   );
 
   // Move forward.
-  if (glfwGetKey(window_, GLFW_KEY_W) == GLFW_PRESS) {
+  if (GetInputKey(window_, GLFW_KEY_W) == GLFW_PRESS) {
     if (cur_time < pressed_w_ && !holding_w_ && cur_time < started_holding_w_ + 0.3f) {
       player->can_jump = false;
       player->speed += front * speed * d * 20.0f;
@@ -1232,13 +1232,13 @@ void PlayerInput::ProcessMovement() {
       configs->jumped = true;
       pressed_w_ = 0.0f;
     } else if (!holding_w_) {
-      started_holding_w_ = glfwGetTime();
+      started_holding_w_ = GetTime();
       player->speed += front * speed * d;
-      pressed_w_ = glfwGetTime() + 0.3f;
+      pressed_w_ = GetTime() + 0.3f;
       holding_w_ = true;
     } else {
       player->speed += front * speed * d;
-      pressed_w_ = glfwGetTime() + 0.3f;
+      pressed_w_ = GetTime() + 0.3f;
       holding_w_ = true;
     }
   } else {
@@ -1246,7 +1246,7 @@ void PlayerInput::ProcessMovement() {
   }
 
   // Move backward.
-  if (glfwGetKey(window_, GLFW_KEY_S) == GLFW_PRESS) {
+  if (GetInputKey(window_, GLFW_KEY_S) == GLFW_PRESS) {
     if (cur_time < pressed_s_ && !holding_s_ && cur_time < started_holding_s_ + 0.3f) {
       player->can_jump = false;
       player->speed -= front * speed * d * 20.0f;
@@ -1254,13 +1254,13 @@ void PlayerInput::ProcessMovement() {
       configs->jumped = true;
       pressed_w_ = 0.0f;
     } else if (!holding_s_) {
-      started_holding_s_ = glfwGetTime();
+      started_holding_s_ = GetTime();
       player->speed -= front * speed * d;
-      pressed_s_ = glfwGetTime() + 0.3f;
+      pressed_s_ = GetTime() + 0.3f;
       holding_s_ = true;
     } else {
       player->speed -= front * speed * d;
-      pressed_s_ = glfwGetTime() + 0.3f;
+      pressed_s_ = GetTime() + 0.3f;
       holding_s_ = true;
     }
   } else {
@@ -1268,7 +1268,7 @@ void PlayerInput::ProcessMovement() {
   }
 
   // Strafe right.
-  if (glfwGetKey(window_, GLFW_KEY_D) == GLFW_PRESS) {
+  if (GetInputKey(window_, GLFW_KEY_D) == GLFW_PRESS) {
     if (cur_time < pressed_d_ && !holding_d_ && cur_time < started_holding_d_ + 0.3f) {
       player->can_jump = false;
       player->speed += right * speed * d * 20.0f;
@@ -1276,13 +1276,13 @@ void PlayerInput::ProcessMovement() {
       configs->jumped = true;
       pressed_d_ = 0.0f;
     } else if (!holding_d_) {
-      started_holding_d_ = glfwGetTime();
+      started_holding_d_ = GetTime();
       player->speed += right * speed * d;
-      pressed_d_ = glfwGetTime() + 0.3f;
+      pressed_d_ = GetTime() + 0.3f;
       holding_d_ = true;
     } else {
       player->speed += right * speed * d;
-      pressed_d_ = glfwGetTime() + 0.3f;
+      pressed_d_ = GetTime() + 0.3f;
       holding_d_ = true;
     }
   } else {
@@ -1290,7 +1290,7 @@ void PlayerInput::ProcessMovement() {
   }
 
   // Strafe left.
-  if (glfwGetKey(window_, GLFW_KEY_A) == GLFW_PRESS) {
+  if (GetInputKey(window_, GLFW_KEY_A) == GLFW_PRESS) {
     if (cur_time < pressed_a_ && !holding_a_ && cur_time < started_holding_a_ + 0.3f) {
       player->can_jump = false;
       player->speed -= right * speed * d * 20.0f;
@@ -1298,13 +1298,13 @@ void PlayerInput::ProcessMovement() {
       configs->jumped = true;
       pressed_a_ = 0.0f;
     } else if (!holding_a_) {
-      started_holding_a_ = glfwGetTime();
+      started_holding_a_ = GetTime();
       player->speed -= right * speed * d;
-      pressed_a_ = glfwGetTime() + 0.3f;
+      pressed_a_ = GetTime() + 0.3f;
       holding_a_ = true;
     } else {
       player->speed -= right * speed * d;
-      pressed_a_ = glfwGetTime() + 0.3f;
+      pressed_a_ = GetTime() + 0.3f;
       holding_a_ = true;
     }
   } else {
@@ -1399,8 +1399,8 @@ void PlayerInput::CastRandomSpell() {
 }
 
 Camera PlayerInput::ProcessInput(GLFWwindow* window) {
-  static double last_time = glfwGetTime();
-  double current_time = glfwGetTime();
+  static double last_time = GetTime();
+  double current_time = GetTime();
 
   shared_ptr<Player> player = resources_->GetPlayer();
   shared_ptr<Configs> configs = resources_->GetConfigs();
@@ -1424,10 +1424,10 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
 
   // Change orientation.
   double x_pos = 0, y_pos = 0;
-  int focused = glfwGetWindowAttrib(window, GLFW_FOCUSED);
+  int focused = IsInputFocused(window);
   if (focused) {
-    glfwGetCursorPos(window, &x_pos, &y_pos);
-    glfwSetCursorPos(window, 0, 0);
+    GetInputCursorPos(window, &x_pos, &y_pos);
+    SetInputCursorPos(window, 0, 0);
   }
 
   float mouse_sensitivity = 0.003f;
@@ -1440,23 +1440,23 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
     return c;
   }
 
-  lft_click_ = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
-  rgt_click_ = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
+  lft_click_ = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+  rgt_click_ = GetInputMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS;
 
   float player_speed = resources_->GetConfigs()->player_speed; 
   float jump_force = resources_->GetConfigs()->jump_force; 
 
   float d = resources_->GetDeltaTime() / 0.016666f;
   if (resources_->GetGameState() == STATE_INVENTORY) {
-    if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+    if (GetInputKey(window, GLFW_KEY_E) == GLFW_PRESS) {
       if (throttle_counter_ < 0) {
         inventory_->Disable();
-        glfwSetCursorPos(window, 0, 0);
+        SetInputCursorPos(window, 0, 0);
       }
       throttle_counter_ = 20;
     }
   } else {
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && false) { // This is disabled.
+    if (GetInputKey(window, GLFW_KEY_R) == GLFW_PRESS && false) { // This is disabled.
       if (throttle_counter_ < 0) {
         if (resources_->CanRest()) {
           float d = resources_->GetDeltaTime() / 0.016666f;
@@ -1486,7 +1486,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       }
 
       // Move up.
-      if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
         if (player->can_jump || configs->levitate) {
           player->can_jump = false;
           player->speed.y += jump_force;
@@ -1496,7 +1496,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
 
       // Move down.
       player->running = false;
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
         if (player->stamina > 0.0f) {
           if (configs->can_run) {
             player->running = true;
@@ -1504,7 +1504,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
         }
       }
 
-      if (glfwGetKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_RIGHT_SHIFT) == GLFW_PRESS) {
         player->speed.y -= jump_force;
       }
     }
@@ -1583,13 +1583,13 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
         } else {
           debounce_ = 20;
         }
-      } else if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_G) == GLFW_PRESS) {
         if (debounce_ < 0) {
           // resources_->CastParalysis(player, player->position + c.direction * 100.0f);
           resources_->CastBurningHands(c);
           debounce_ = 20;
         }
-      } else if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
+      } else if (GetInputKey(window, GLFW_KEY_H) == GLFW_PRESS) {
         if (debounce_ < 0) {
           resources_->CastBouncyBall(player, c.position, c.direction);
           // resources_->CastWindslash(c);
@@ -1624,45 +1624,45 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
 
   throttle_counter_--;
   bool interacted_with_item = false;
-  if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
+  if (GetInputKey(window, GLFW_KEY_E) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       if (InteractWithItem(window, c, true)) {
         interacted_with_item = true;
       }
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_F) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       inventory_->Enable(window, INVENTORY_SPELLBOOK);
       resources_->SetGameState(STATE_INVENTORY);
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_P) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       EditObject(window, c);
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_X) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       configs->place_axis = 0;
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       configs->place_axis = 1;
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       configs->place_axis = 2;
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_V) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       configs->place_axis = -1;
     }
     throttle_counter_ = 20;
-  } else if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_O) == GLFW_PRESS) {
     if (configs->new_building) {
       if (throttle_counter_ < 0) {
         if (configs->scale_object) {
@@ -1674,7 +1674,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       }
       throttle_counter_ = 20;
     }
-  } else if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1703,7 +1703,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       scepter->frame = 0;
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_0) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_0) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1713,8 +1713,8 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       UseItem(2);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS && 
-     glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_1) == GLFW_PRESS && 
+     GetInputKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1724,8 +1724,8 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       // SelectSpell(7);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS && 
-     glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_2) == GLFW_PRESS && 
+     GetInputKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1735,8 +1735,8 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       // SelectSpell(8);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS && 
-     glfwGetKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_3) == GLFW_PRESS && 
+     GetInputKey(window, GLFW_KEY_LEFT_ALT) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1745,7 +1745,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       UseItem(2);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_1) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1759,7 +1759,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       configs->selected_spell = 0;
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_2) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1769,7 +1769,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       configs->selected_tile = 2;
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_3) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1779,7 +1779,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       configs->selected_tile = 3;
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_4) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1788,7 +1788,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       SelectSpell(3);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_5) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1797,7 +1797,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       SelectSpell(4);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_6) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_6) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1806,7 +1806,7 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       SelectSpell(5);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_7) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_7) == GLFW_PRESS) {
     if (throttle_counter_ < 0) {
       player->scepter = -1;
       player->charges = 0;
@@ -1815,9 +1815,9 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
       SelectSpell(6);
     }
     throttle_counter_ = 5;
-  } else if (glfwGetKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_RIGHT_BRACKET) == GLFW_PRESS) {
     if (configs->place_object) {
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
         configs->new_building->scale += 0.01f;
         if (configs->new_building->type == GAME_OBJ_PARTICLE) {
           shared_ptr<Particle> p = static_pointer_cast<Particle>(configs->new_building);
@@ -1827,9 +1827,9 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
         configs->new_building->rotation_matrix *= rotate(mat4(1.0), -0.005f, vec3(0, 1, 0));
       }
     }
-  } else if (glfwGetKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_LEFT_BRACKET) == GLFW_PRESS) {
     if (configs->place_object) {
-      if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
+      if (GetInputKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
         configs->new_building->scale -= 0.01f;
         if (configs->new_building->type == GAME_OBJ_PARTICLE) {
           shared_ptr<Particle> p = static_pointer_cast<Particle>(configs->new_building);
@@ -1839,11 +1839,11 @@ Camera PlayerInput::ProcessInput(GLFWwindow* window) {
         configs->new_building->rotation_matrix *= rotate(mat4(1.0), 0.005f, vec3(0, 1, 0));
       }
     }
-  } else if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_M) == GLFW_PRESS) {
     if (configs->place_object) {
       configs->new_building->rotation_matrix *= rotate(mat4(1.0), -0.005f, vec3(1, 0, 0));
     }
-  } else if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
+  } else if (GetInputKey(window, GLFW_KEY_N) == GLFW_PRESS) {
     if (configs->place_object) {
       configs->new_building->rotation_matrix *= rotate(mat4(1.0), 0.005f, vec3(1, 0, 0));
     }
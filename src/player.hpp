@@ -3,6 +3,7 @@
 
 #include <random>
 #include "resources.hpp"
+#include "replay.hpp"
 #include "4d.hpp"
 #include "terrain.hpp"
 #include "inventory.hpp"
@@ -0,0 +1,99 @@
+#include "portal_visibility.hpp"
+
+#include <algorithm>
+
+namespace {
+
+void NormalizeRectPlane(vec4& plane) {
+  float mag = length(vec3(plane.x, plane.y, plane.z));
+  if (mag > 0.0f) plane = plane * (1.0f / mag);
+}
+
+} // namespace
+
+ScreenRect GetPortalRect(const vector<vec3>& triangles, const mat4& MVP,
+  const vec3& origin) {
+  ScreenRect rect(vec2(1, 1), vec2(-1, -1));
+  bool in_front = false, behind = false, too_close = false;
+  for (const vec3& v : triangles) {
+    vec4 p = MVP * vec4(v - origin, 1.0f);
+    if (p.w <= 0.0f) {
+      behind = true;
+      continue;
+    }
+    in_front = true;
+    if (p.z < -p.w) too_close = true;
+
+    vec2 ndc = vec2(p.x / p.w, p.y / p.w);
+    rect.min = vec2(std::min(rect.min.x, ndc.x), std::min(rect.min.y, ndc.y));
+    rect.max = vec2(std::max(rect.max.x, ndc.x), std::max(rect.max.y, ndc.y));
+  }
+
+  if (!in_front) return rect;
+
+  // A portal that wraps around the camera or crosses the near plane is too
+  // close to narrow the view, since the camera may be going through it.
+  if (behind || too_close) return ScreenRect();
+  return IntersectRects(rect, ScreenRect());
+}
+
+ScreenRect IntersectRects(const ScreenRect& a, const ScreenRect& b) {
+  return ScreenRect(
+    vec2(std::max(a.min.x, b.min.x), std::max(a.min.y, b.min.y)),
+    vec2(std::min(a.max.x, b.max.x), std::min(a.max.y, b.max.y)));
+}
+
+void GetFrustumPlanes(const mat4& MVP, const ScreenRect& rect,
+  vec4 planes[6]) {
+  for (int i = 4; i--;) planes[0][i] = MVP[i][0] - rect.min.x * MVP[i][3];
+  for (int i = 4; i--;) planes[1][i] = rect.max.x * MVP[i][3] - MVP[i][0];
+  for (int i = 4; i--;) planes[2][i] = MVP[i][1] - rect.min.y * MVP[i][3];
+  for (int i = 4; i--;) planes[3][i] = rect.max.y * MVP[i][3] - MVP[i][1];
+  for (int i = 4; i--;) planes[4][i] = MVP[i][3] + MVP[i][2];
+  for (int i = 4; i--;) planes[5][i] = MVP[i][3] - MVP[i][2];
+  for (int i = 0; i < 6; i++) {
+    NormalizeRectPlane(planes[i]);
+  }
+}
+
+void PortalVisibility::Visit(shared_ptr<PortalNode> node,
+  const ScreenRect& rect, const mat4& MVP, const vec3& origin) {
+  auto it = view_indices_.find(node->sector_id);
+  if (it == view_indices_.end()) {
+    view_indices_[node->sector_id] = sector_views_.size();
+    SectorView view;
+    view.node = node;
+    view.rect = rect;
+    sector_views_.push_back(view);
+  } else {
+    ScreenRect& view_rect = sector_views_[it->second].rect;
+    view_rect.min = glm::min(view_rect.min, rect.min);
+    view_rect.max = glm::max(view_rect.max, rect.max);
+  }
+
+  for (shared_ptr<PortalNode> child : node->children) {
+    metrics_.num_portals_tested++;
+    ScreenRect child_rect = IntersectRects(rect,
+      GetPortalRect(child->portal_triangles, MVP, origin));
+    if (child_rect.IsEmpty()) {
+      metrics_.num_portals_rejected++;
+      metrics_.num_objects_rejected += child->num_objects;
+      continue;
+    }
+    Visit(child, child_rect, MVP, origin);
+  }
+}
+
+const vector<SectorView>& PortalVisibility::Compute(
+  shared_ptr<PortalNode> root, const mat4& MVP, const vec3& origin) {
+  sector_views_.clear();
+  view_indices_.clear();
+  metrics_ = PortalMetrics();
+  if (!root) return sector_views_;
+
+  Visit(root, ScreenRect(), MVP, origin);
+  for (SectorView& view : sector_views_) {
+    GetFrustumPlanes(MVP, view.rect, view.frustum_planes);
+  }
+  return sector_views_;
+}
@@ -0,0 +1,94 @@
+#ifndef __PORTAL_VISIBILITY_HPP__
+#define __PORTAL_VISIBILITY_HPP__
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+struct Sector;
+struct Portal;
+struct StabbingTreeNode;
+
+// Rectangle in normalized device coordinates.
+struct ScreenRect {
+  vec2 min = vec2(-1, -1);
+  vec2 max = vec2(1, 1);
+
+  ScreenRect() {}
+  ScreenRect(vec2 min, vec2 max) : min(min), max(max) {}
+
+  bool IsEmpty() const { return min.x >= max.x || min.y >= max.y; }
+};
+
+// Copy of a stabbing tree node with the geometry of the portal that leads
+// into its sector. The sector, portal and stabbing tree pointers are only
+// carried for the caller.
+struct PortalNode {
+  int sector_id = -1;
+  shared_ptr<Sector> sector;
+  shared_ptr<Portal> portal;
+  shared_ptr<StabbingTreeNode> stabbing_tree_node;
+
+  // Triangle list in world space. Empty for the root.
+  vector<vec3> portal_triangles;
+
+  // Objects in the sector, for the rejected objects metric.
+  int num_objects = 0;
+  vector<shared_ptr<PortalNode>> children;
+};
+
+// A potentially visible sector and the part of the screen where it can be
+// seen, with the frustum planes through the edges of that rectangle.
+struct SectorView {
+  shared_ptr<PortalNode> node;
+  ScreenRect rect;
+  vec4 frustum_planes[6];
+};
+
+struct PortalMetrics {
+  int num_portals_tested = 0;
+  int num_portals_rejected = 0;
+  int num_objects_rejected = 0;
+};
+
+// Screen rectangle covered by the triangles after clipping them against
+// the near plane. MVP and origin are as in GetFrustumPlanes.
+ScreenRect GetPortalRect(const vector<vec3>& triangles, const mat4& MVP,
+  const vec3& origin);
+
+ScreenRect IntersectRects(const ScreenRect& a, const ScreenRect& b);
+
+// Same planes as ExtractFrustumPlanes, with the side planes moved to the
+// edges of the rectangle.
+void GetFrustumPlanes(const mat4& MVP, const ScreenRect& rect,
+  vec4 planes[6]);
+
+// Walks the stabbing tree from the camera sector, narrowing the screen
+// rectangle through each portal. Sectors whose portals fall outside the
+// rectangle of the sector that contains them are not visited. A sector
+// reached through several portals gets one view with the union of the
+// rectangles.
+//
+// MVP is the view projection matrix times a translation to origin, so the
+// planes are relative to origin like the ones from GetFrustumPlanes.
+class PortalVisibility {
+  vector<SectorView> sector_views_;
+  unordered_map<int, int> view_indices_;
+  PortalMetrics metrics_;
+
+  void Visit(shared_ptr<PortalNode> node, const ScreenRect& rect,
+    const mat4& MVP, const vec3& origin);
+
+ public:
+  const vector<SectorView>& Compute(shared_ptr<PortalNode> root,
+    const mat4& MVP, const vec3& origin);
+
+  const vector<SectorView>& GetSectorViews() { return sector_views_; }
+  const PortalMetrics& GetMetrics() { return metrics_; }
+};
+
+#endif // __PORTAL_VISIBILITY_HPP__
@@ -0,0 +1,155 @@
+#include "ray_packet.hpp"
+
+#include <algorithm>
+#include "simd.hpp"
+
+using namespace simd;
+
+namespace {
+
+const float kEpsilon = 1e-8f;
+
+// Directions with a zero component get a huge inverse instead of infinity,
+// so 0 * inverse is still 0 in the slab test.
+const float kMaxInverse = 1e30f;
+
+} // namespace
+
+void RayPacket::Load(const Ray* rays, int n) {
+  num_rays = std::max(0, std::min(n, kRayPacketSize));
+  const Ray unused_ray(vec3(0), vec3(1, 0, 0), 0.0f);
+  for (int i = 0; i < kRayPacketSize; i++) {
+    const Ray& ray = (i < num_rays) ? rays[i] : unused_ray;
+    ox[i] = ray.origin.x;
+    oy[i] = ray.origin.y;
+    oz[i] = ray.origin.z;
+    dx[i] = ray.direction.x;
+    dy[i] = ray.direction.y;
+    dz[i] = ray.direction.z;
+    inv_dx[i] = (dx[i] != 0.0f) ? 1.0f / dx[i] : kMaxInverse;
+    inv_dy[i] = (dy[i] != 0.0f) ? 1.0f / dy[i] : kMaxInverse;
+    inv_dz[i] = (dz[i] != 0.0f) ? 1.0f / dz[i] : kMaxInverse;
+    triangle[i] = -1;
+
+    // The max distance is converted to the ray parameter.
+    float d = length(ray.direction);
+    if (i >= num_rays) {
+      t[i] = -1.0f;
+    } else if (d == 0.0f || ray.distance >= numeric_limits<float>::max()) {
+      t[i] = numeric_limits<float>::max();
+    } else {
+      t[i] = ray.distance / d;
+    }
+  }
+}
+
+void RayPacket::Translate(const vec3& offset) {
+  for (int i = 0; i < kRayPacketSize; i++) {
+    ox[i] -= offset.x;
+    oy[i] -= offset.y;
+    oz[i] -= offset.z;
+  }
+}
+
+int IntersectRayPacketAABB(const RayPacket& packet, const vec3& min,
+  const vec3& max) {
+  const Lanes min_x = Broadcast(min.x), max_x = Broadcast(max.x);
+  const Lanes min_y = Broadcast(min.y), max_y = Broadcast(max.y);
+  const Lanes min_z = Broadcast(min.z), max_z = Broadcast(max.z);
+
+  int mask = 0;
+  for (int i = 0; i < kRayPacketSize; i += kLanes) {
+    Lanes t0 = Broadcast(0.0f);
+    Lanes t1 = LoadLanes(&packet.t[i]);
+
+    Lanes o = LoadLanes(&packet.ox[i]);
+    Lanes inv_d = LoadLanes(&packet.inv_dx[i]);
+    Lanes a = Mul(Sub(min_x, o), inv_d);
+    Lanes b = Mul(Sub(max_x, o), inv_d);
+    t0 = Max(t0, Min(a, b));
+    t1 = Min(t1, Max(a, b));
+
+    o = LoadLanes(&packet.oy[i]);
+    inv_d = LoadLanes(&packet.inv_dy[i]);
+    a = Mul(Sub(min_y, o), inv_d);
+    b = Mul(Sub(max_y, o), inv_d);
+    t0 = Max(t0, Min(a, b));
+    t1 = Min(t1, Max(a, b));
+
+    o = LoadLanes(&packet.oz[i]);
+    inv_d = LoadLanes(&packet.inv_dz[i]);
+    a = Mul(Sub(min_z, o), inv_d);
+    b = Mul(Sub(max_z, o), inv_d);
+    t0 = Max(t0, Min(a, b));
+    t1 = Min(t1, Max(a, b));
+
+    mask |= MoveMask(LessEqual(t0, t1)) << i;
+  }
+  return mask;
+}
+
+// Moller-Trumbore, both faces, as in Bvh::IntersectRayTriangle.
+int IntersectRayPacketTriangle(RayPacket& packet, const BvhTriangle& triangle,
+  int index) {
+  const vec3 e1 = triangle.b - triangle.a;
+  const vec3 e2 = triangle.c - triangle.a;
+  const Lanes e1x = Broadcast(e1.x), e1y = Broadcast(e1.y);
+  const Lanes e1z = Broadcast(e1.z);
+  const Lanes e2x = Broadcast(e2.x), e2y = Broadcast(e2.y);
+  const Lanes e2z = Broadcast(e2.z);
+  const Lanes ax = Broadcast(triangle.a.x), ay = Broadcast(triangle.a.y);
+  const Lanes az = Broadcast(triangle.a.z);
+  const Lanes zero = Broadcast(0.0f), one = Broadcast(1.0f);
+  const Lanes epsilon = Broadcast(kEpsilon);
+
+  int mask = 0;
+  for (int i = 0; i < kRayPacketSize; i += kLanes) {
+    Lanes dx = LoadLanes(&packet.dx[i]);
+    Lanes dy = LoadLanes(&packet.dy[i]);
+    Lanes dz = LoadLanes(&packet.dz[i]);
+
+    // pvec = cross(d, e2).
+    Lanes px = Sub(Mul(dy, e2z), Mul(dz, e2y));
+    Lanes py = Sub(Mul(dz, e2x), Mul(dx, e2z));
+    Lanes pz = Sub(Mul(dx, e2y), Mul(dy, e2x));
+    Lanes det = Add(Add(Mul(e1x, px), Mul(e1y, py)), Mul(e1z, pz));
+    Lanes abs_det = Max(det, Sub(zero, det));
+    Lanes inv_det = Div(one, det);
+
+    Lanes tx = Sub(LoadLanes(&packet.ox[i]), ax);
+    Lanes ty = Sub(LoadLanes(&packet.oy[i]), ay);
+    Lanes tz = Sub(LoadLanes(&packet.oz[i]), az);
+    Lanes u = Mul(Add(Add(Mul(tx, px), Mul(ty, py)), Mul(tz, pz)), inv_det);
+
+    // qvec = cross(tvec, e1).
+    Lanes qx = Sub(Mul(ty, e1z), Mul(tz, e1y));
+    Lanes qy = Sub(Mul(tz, e1x), Mul(tx, e1z));
+    Lanes qz = Sub(Mul(tx, e1y), Mul(ty, e1x));
+    Lanes v = Mul(Add(Add(Mul(dx, qx), Mul(dy, qy)), Mul(dz, qz)), inv_det);
+    Lanes t = Mul(Add(Add(Mul(e2x, qx), Mul(e2y, qy)), Mul(e2z, qz)),
+      inv_det);
+
+    // Comparisons with NaN are false, so degenerate lanes never hit.
+    Lanes closest_t = LoadLanes(&packet.t[i]);
+    Lanes hit = And(LessEqual(epsilon, abs_det), LessEqual(zero, u));
+    hit = And(hit, LessEqual(zero, v));
+    hit = And(hit, LessEqual(Add(u, v), one));
+    hit = And(hit, LessEqual(zero, t));
+    hit = And(hit, Less(t, closest_t));
+    StoreLanes(&packet.t[i], Select(hit, t, closest_t));
+
+    int hit_mask = MoveMask(hit);
+    for (int lane = 0; lane < kLanes; lane++) {
+      if (hit_mask & (1 << lane)) packet.triangle[i + lane] = index;
+    }
+    mask |= hit_mask << i;
+  }
+  return mask;
+}
+
+void IntersectRayPacketTriangles(RayPacket& packet,
+  const BvhTriangle* triangles, int num_triangles, int first_index) {
+  for (int i = 0; i < num_triangles; i++) {
+    IntersectRayPacketTriangle(packet, triangles[i], first_index + i);
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef __RAY_PACKET_HPP__
+#define __RAY_PACKET_HPP__
+
+#include <limits>
+#include <glm/glm.hpp>
+#include "bvh.hpp"
+
+using namespace std;
+using namespace glm;
+
+const int kRayPacketSize = 8;
+
+struct RayHit {
+  bool hit = false;
+
+  // Distance from the ray origin to q.
+  float t = 0.0f;
+  vec3 q = vec3(0);
+};
+
+// Up to kRayPacketSize rays in structure of arrays layout, so one box or
+// triangle can be tested against all of them with SIMD instructions. Each
+// ray keeps the parameter of its closest hit in t, which starts at the
+// ray's max distance and shrinks as hits are found. Unused lanes have a
+// negative t and never hit anything.
+struct alignas(32) RayPacket {
+  float ox[kRayPacketSize], oy[kRayPacketSize], oz[kRayPacketSize];
+  float dx[kRayPacketSize], dy[kRayPacketSize], dz[kRayPacketSize];
+  float inv_dx[kRayPacketSize], inv_dy[kRayPacketSize],
+    inv_dz[kRayPacketSize];
+  float t[kRayPacketSize];
+
+  // Index of the closest triangle hit or -1.
+  int triangle[kRayPacketSize];
+  int num_rays = 0;
+
+  void Load(const Ray* rays, int n);
+
+  // Moves the origins to the space of a mesh positioned at offset.
+  void Translate(const vec3& offset);
+
+  vec3 GetOrigin(int i) const { return vec3(ox[i], oy[i], oz[i]); }
+  vec3 GetDirection(int i) const { return vec3(dx[i], dy[i], dz[i]); }
+  vec3 GetHitPoint(int i) const {
+    return GetOrigin(i) + GetDirection(i) * t[i];
+  }
+};
+
+// Returns a bit mask of the rays that cross the box before their t.
+int IntersectRayPacketAABB(const RayPacket& packet, const vec3& min,
+  const vec3& max);
+
+// Shortens the rays that hit the triangle before their t and stores index
+// as their triangle. Returns the bit mask of these rays.
+int IntersectRayPacketTriangle(RayPacket& packet, const BvhTriangle& triangle,
+  int index);
+
+// Triangle list version, index first_index + i is stored for triangles[i].
+void IntersectRayPacketTriangles(RayPacket& packet,
+  const BvhTriangle* triangles, int num_triangles, int first_index = 0);
+
+#endif // __RAY_PACKET_HPP__
@@ -0,0 +1,69 @@
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+const int kPassBits = 2;
+const int kProgramBits = 8;
+const int kTextureBits = 12;
+const int kMeshBits = 14;
+const int kMaterialBits = 12;
+const int kDepthBits = 16;
+
+bool HaveSameState(const RenderCommand& a, const RenderCommand& b) {
+  return a.program == b.program && a.texture == b.texture &&
+    a.mesh == b.mesh && a.material == b.material;
+}
+
+} // namespace
+
+uint64_t MakeRenderSortKey(RenderPass pass, unsigned int program,
+  unsigned int texture, unsigned int mesh, int material, float depth,
+  float max_depth) {
+  const uint64_t max_depth_value = (uint64_t(1) << kDepthBits) - 1;
+  float d = (max_depth > 0.0f) ? depth / max_depth : 0.0f;
+  d = std::min(std::max(d, 0.0f), 1.0f);
+  uint64_t depth_value = uint64_t(d * max_depth_value);
+  if (pass == RENDER_PASS_TRANSPARENT) {
+    depth_value = max_depth_value - depth_value;
+  }
+
+  uint64_t key = uint64_t(pass) & ((1 << kPassBits) - 1);
+  key = (key << kProgramBits) | (program & ((1 << kProgramBits) - 1));
+  key = (key << kTextureBits) | (texture & ((1 << kTextureBits) - 1));
+  key = (key << kMeshBits) | (mesh & ((1 << kMeshBits) - 1));
+  key = (key << kMaterialBits) | (material & ((1 << kMaterialBits) - 1));
+  key = (key << kDepthBits) | depth_value;
+  return key;
+}
+
+void RenderQueue::Clear() {
+  commands_.clear();
+  batches_.clear();
+}
+
+void RenderQueue::Build(int max_instances) {
+  // Sorted by key, then by program, texture, mesh and material, so commands
+  // with the same state end up next to each other even when their ids
+  // wrapped to the same key bits.
+  std::sort(commands_.begin(), commands_.end(),
+    [](const RenderCommand& a, const RenderCommand& b) {
+      return tie(a.sort_key, a.program, a.texture, a.mesh, a.material) <
+        tie(b.sort_key, b.program, b.texture, b.mesh, b.material);
+    });
+
+  batches_.clear();
+  for (size_t i = 0; i < commands_.size(); i++) {
+    if (!batches_.empty()) {
+      RenderBatch& batch = batches_.back();
+      if (batch.count < max_instances &&
+        HaveSameState(commands_[batch.first], commands_[i])) {
+        batch.count++;
+        continue;
+      }
+    }
+    batches_.push_back({ int(i), 1 });
+  }
+}
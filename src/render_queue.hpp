@@ -0,0 +1,65 @@
+#ifndef __RENDER_QUEUE_HPP__
+#define __RENDER_QUEUE_HPP__
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// Instance buffers are sized for this many objects per draw call.
+const int kMaxInstancesPerBatch = 1024;
+
+enum RenderPass {
+  RENDER_PASS_OPAQUE = 0,
+  RENDER_PASS_TRANSPARENT
+};
+
+// One mesh of one object. The ids are GL names, but the queue only compares
+// them, so it works without a GL context.
+struct RenderCommand {
+  uint64_t sort_key;
+  unsigned int program;
+  unsigned int texture;
+  unsigned int mesh;
+  int material;
+  int num_indices;
+
+  // Index in the caller's object list and asset in the object's group.
+  int object;
+  int asset;
+};
+
+// Consecutive sorted commands with the same program, texture, mesh and
+// material, drawn with one instanced call.
+struct RenderBatch {
+  int first;
+  int count;
+};
+
+// Packs, from the most significant bits: pass, program, texture, mesh,
+// material and depth. Opaque commands go front to back and transparent
+// ones back to front. Ids that don't fit are wrapped, which only makes the
+// order less coherent: batches compare the full ids.
+uint64_t MakeRenderSortKey(RenderPass pass, unsigned int program,
+  unsigned int texture, unsigned int mesh, int material, float depth,
+  float max_depth);
+
+class RenderQueue {
+  vector<RenderCommand> commands_;
+  vector<RenderBatch> batches_;
+
+ public:
+  void Clear();
+  void Add(const RenderCommand& command) { commands_.push_back(command); }
+
+  // Sorts the commands and merges them into batches of at most
+  // max_instances commands.
+  void Build(int max_instances = kMaxInstancesPerBatch);
+
+  const vector<RenderCommand>& GetCommands() { return commands_; }
+  const vector<RenderBatch>& GetBatches() { return batches_; }
+  int GetNumCommands() { return commands_.size(); }
+  int GetNumBatches() { return batches_.size(); }
+};
+
+#endif // __RENDER_QUEUE_HPP__
@@ -1,7 +1,9 @@
 #include "renderer.hpp"
+#include <algorithm>
 #include "boost/filesystem.hpp"
 #include <boost/algorithm/string/predicate.hpp>
 #include "fbx_loader.hpp"
+#include "compressed_animation.hpp"
 
 namespace {
 
@@ -27,23 +29,27 @@ void ThrowError(First first, Args&& ...args) {
 
 const int kMaxDungeonTiles = 2048;
 
+const Symbol kOutsideSector("outside");
+
+// Size of the wall occluder relative to the wall mesh bounds.
+const float kWallOccluderScale = 0.9f;
+
+// Tiles drawn with instancing in each dungeon cell.
+const vector<char> kDungeonTiles { ' ', '+', '|', ')', 'o', '(', 'd', 'g', 'P', 'c', 's' };
+
 Renderer::Renderer(shared_ptr<Resources> asset_catalog, 
   shared_ptr<Draw2D> draw_2d, shared_ptr<Project4D> project_4d, 
   shared_ptr<Inventory> inventory, GLFWwindow* window, int window_width, 
   int window_height) : 
   resources_(asset_catalog), draw_2d_(draw_2d), project_4d_(project_4d),
   inventory_(inventory), window_(window), window_width_(window_width), 
-  window_height_(window_height) {
+  window_height_(window_height), visibility_culler_(GetJobSystem()) {
   cout << "Window width: " << window_width_ << endl;
   cout << "Window height: " << window_height_ << endl;
   Init();
 }
 
 Renderer::~Renderer() {
-  terminate_ = true;
-  for (int i = 0; i < kMaxThreads; i++) {
-    // find_threads_[i].join();
-  }
 }
 
 void Renderer::InitShadowFramebuffer() {
@@ -83,7 +89,33 @@ void Renderer::Init() {
 
   CreateParticleBuffers();
 
-  CreateThreads();
+  frame_uniforms_buffer_ = make_shared<UniformBuffer>(
+    GetDefaultUniformGlFunctions(), kFrameUniformsBinding, 
+    sizeof(FrameUniforms));
+  frame_uniforms_buffer_->BindToPrograms(GetUniformCache().GetPrograms(),
+    kFrameUniformsBlock);
+}
+
+void Renderer::UpdateFrameUniforms() {
+  if (!frame_uniforms_buffer_->IsUsed()) return;
+
+  shared_ptr<Configs> configs = resources_->GetConfigs();
+  bool outdoors = (configs->render_scene == "town");
+
+  frame_uniforms_.V = view_matrix_;
+  frame_uniforms_.P = projection_matrix_;
+  frame_uniforms_.VP = projection_matrix_ * view_matrix_;
+  for (int i = 0; i < 3; i++) {
+    frame_uniforms_.shadow_matrices[i] = GetShadowMatrix(true, i);
+  }
+  frame_uniforms_.camera_pos = vec4(camera_.position, 1.0f);
+  frame_uniforms_.player_pos = vec4(resources_->GetPlayer()->position, 1.0f);
+  frame_uniforms_.light_direction = vec4(configs->sun_position, 
+    configs->light_radius);
+  frame_uniforms_.lighting_color = vec4(1.0f);
+  frame_uniforms_.frame_params = vec4(u_time_, outdoors ? 1.0f : 0.0f, 
+    outdoors ? 0.0f : 1.0f, 0.0f);
+  frame_uniforms_buffer_->Update(&frame_uniforms_);
 }
 
 void Renderer::GetFrustumPlanes(vec4 frustum_planes[6]) {
@@ -94,128 +126,21 @@ void Renderer::GetFrustumPlanes(vec4 frustum_planes[6]) {
   ExtractFrustumPlanes(MVP, frustum_planes);
 }
 
-void Renderer::GetVisibleObjects(
-  shared_ptr<OctreeNode> octree_node) {
-  if (!octree_node) {
-    return;
-  }
-
-  AABB aabb;
-  aabb.point = octree_node->center - octree_node->half_dimensions;
-  aabb.dimensions = octree_node->half_dimensions * 2.0f;
-
-  vec3 closest = ClosestPtPointAABB(player_pos_, aabb);
-  if (resources_->GetConfigs()->render_scene != "town" && 
-      length(closest - player_pos_) > resources_->GetConfigs()->light_radius + 5) {
-   return;
-  }
-
-  // TODO: find better name for this function.
-  if (!CollideAABBFrustum(aabb, frustum_planes_, player_pos_)) {
-    return;
-  }
-
-  for (int i = 0; i < 8; i++) {
-    find_mutex_.lock();
-    find_tasks_.push(octree_node->children[i]);
-    find_mutex_.unlock();
-    // GetPotentiallyVisibleObjects(player_pos, octree_node->children[i]);
-  }
-
-  // TODO: remove far objects from octree. Store assets based on location.
-  for (auto& [id, obj] : octree_node->objects) {
-    switch (obj->type) {
-      case GAME_OBJ_DEFAULT:
-      case GAME_OBJ_REGION:
-      case GAME_OBJ_WAYPOINT:
-      case GAME_OBJ_DOOR:
-      case GAME_OBJ_ACTIONABLE:
-      case GAME_OBJ_DESTRUCTIBLE:
-        break;
-      case GAME_OBJ_MISSILE: {
-        if (obj->life > 0.0f || obj->scale_out > 0.0f) {
-          break;
-        } else {
-          continue;
-        }
-      }
-      case GAME_OBJ_PARTICLE: {
-        if (obj->Is3dParticle()) {
-          break;
-        } else {
-          continue;
-        }
-      }
-      default:
-        continue;
-    }
-
-    // if (obj->status == STATUS_DEAD) continue;
-    vector<vector<Polygon>> occluder_convex_hulls;
-    if (CullObject(obj, occluder_convex_hulls)) continue;
-    find_mutex_.lock();
-    if (!obj->IsDungeonPiece()) { 
-      visible_objects_.push_back(obj);
-    }
-    find_mutex_.unlock();
-  }
-
-  for (auto& [id, obj] : octree_node->moving_objs) {
-    switch (obj->type) {
-      case GAME_OBJ_DEFAULT:
-      case GAME_OBJ_REGION:
-      case GAME_OBJ_WAYPOINT:
-      case GAME_OBJ_DOOR:
-      case GAME_OBJ_ACTIONABLE:
-      case GAME_OBJ_DESTRUCTIBLE:
-        break;
-      case GAME_OBJ_MISSILE: {
-        if (obj->life > 0.0f || obj->scale_out > 0.0f) {
-          break;
-        } else {
-          continue;
-        }
-      }
-      case GAME_OBJ_PARTICLE: {
-        if (obj->Is3dParticle()) {
-          break;
-        } else {
-          continue;
-        }
-      }
-      default:
-        continue;
-    }
-
-    // if (obj->status == STATUS_DEAD) continue;
-    vector<vector<Polygon>> occluder_convex_hulls;
-    if (CullObject(obj, occluder_convex_hulls)) continue;
-    find_mutex_.lock();
-    if (!obj->IsDungeonPiece()) { 
-      visible_objects_.push_back(obj);
-    }
-    find_mutex_.unlock();
-  }
-}
-
 vector<shared_ptr<GameObject>> 
-Renderer::GetVisibleObjectsFromSector(shared_ptr<Sector> sector) {
-  find_mutex_.lock();
+Renderer::GetVisibleObjectsFromSector(shared_ptr<Sector> sector,
+  vec4 frustum_planes[6], const vec3& origin, bool camera_view) {
+  shared_ptr<Configs> configs = resources_->GetConfigs();
   visible_objects_.clear();
   player_pos_ = camera_.position;
-  find_tasks_.push(sector->octree_node);
-  find_mutex_.unlock();
 
-  // while (!find_tasks_.empty() || running_tasks_ > 0) {
-  //   this_thread::sleep_for(chrono::microseconds(200));
-  // }
-
-  // Sync.
-  while (!find_tasks_.empty()) {
-    shared_ptr<OctreeNode> node = find_tasks_.front();
-    find_tasks_.pop();
-    GetVisibleObjects(node);
+  CullParams params;
+  for (int i = 0; i < 6; i++) params.frustum_planes[i] = frustum_planes[i];
+  params.camera_pos = origin;
+  if (camera_view && configs->render_scene != "town") {
+    params.max_distance = configs->light_radius + 5;
   }
+  params.see_invisible = configs->see_invisible;
+  visibility_culler_.Cull(sector->octree_node, params, visible_objects_);
 
   // Sort from farthest to closest.
   std::sort(visible_objects_.begin(), visible_objects_.end(), 
@@ -226,64 +151,97 @@ Renderer::GetVisibleObjectsFromSector(shared_ptr<Sector> sector) {
   return visible_objects_;
 }
 
-bool Renderer::CullObject(shared_ptr<GameObject> obj, 
-  const vector<vector<Polygon>>& occluder_convex_hulls) {
-  if (obj->name == "hand-001") return true;
-  if (obj->name == "scepter-001") return true;
-  if (obj->name == "skydome") return true;
-  if (obj->name == "map-001") return true;
-  if (obj->never_cull) return false;
-  if (obj->IsInvisible() && !resources_->GetConfigs()->see_invisible) 
-    return true;
-  if (obj->always_cull)
-    return true;
-  if (obj->IsSecret() && resources_->GetConfigs()->see_invisible) 
-    return true;
-  // TODO: draw hand without object.
+void Renderer::AddDungeonOccluders() {
+  if (dungeon_wall_max_.x <= dungeon_wall_min_.x) return;
 
-  if (!obj->draw) {
-    return true;
+  shared_ptr<Configs> configs = resources_->GetConfigs();
+  Dungeon& dungeon = resources_->GetDungeon();
+  vec3 camera_tile = (camera_.position - kDungeonOffset) / 10.0f;
+  int radius = int(configs->light_radius / 10.0f) + 1;
+  int min_x = std::max(0, int(round(camera_tile.x)) - radius);
+  int max_x = std::min(kDungeonSize - 1, int(round(camera_tile.x)) + radius);
+  int min_z = std::max(0, int(round(camera_tile.z)) - radius);
+  int max_z = std::min(kDungeonSize - 1, int(round(camera_tile.z)) + radius);
+  for (int x = min_x; x <= max_x; x++) {
+    for (int z = min_z; z <= max_z; z++) {
+      char ascii_code = dungeon.GetTileAt(x, z).ascii_code;
+      if (ascii_code != '|' && ascii_code != '-') continue;
+
+      // Same transform as the wall tiles in CreateDungeonBuffers.
+      vec3 pos = kDungeonOffset + vec3(10.0f * x, 0, 10.0f * z);
+      mat4 ModelMatrix = translate(mat4(1.0), pos);
+      if (ascii_code == '-') {
+        ModelMatrix *= rotate(mat4(1.0), 1.57f, vec3(0, 1, 0));
+      }
+      occlusion_buffer_.AddOccluderBox(dungeon_wall_min_, dungeon_wall_max_,
+        ModelMatrix);
+    }
   }
+}
 
-  if (obj->Is3dParticle() && obj->life <= 0) {
-    return true;
+const vector<vec3>& Renderer::GetOccluderTriangles(
+  shared_ptr<GameAsset> asset) {
+  auto it = occluder_triangles_.find(asset->id);
+  if (it != occluder_triangles_.end()) return it->second;
+
+  vector<vec3>& triangles = occluder_triangles_[asset->id];
+  for (const Polygon& polygon : asset->occluder) {
+    for (int i = 1; i + 1 < polygon.vertices.size(); i++) {
+      triangles.push_back(polygon.vertices[0]);
+      triangles.push_back(polygon.vertices[i]);
+      triangles.push_back(polygon.vertices[i + 1]);
+    }
   }
+  return triangles;
+}
 
-  // Frustum cull.
-  BoundingSphere bounding_sphere = obj->GetTransformedBoundingSphere();
-  if (!CollideSphereFrustum(bounding_sphere, frustum_planes_, camera_.position)) {
-    return true;
-  }
+// Rasterizes the dungeon walls near the camera and the occluder hulls of
+// the visible assets, then hides the objects behind them.
+vector<ObjPtr> Renderer::CullOccludedObjects(const vector<ObjPtr>& objs) {
+  shared_ptr<Configs> configs = resources_->GetConfigs();
+  if (!configs->occlusion_culling) return objs;
 
-  // Distance cull.
-  obj->distance = length(camera_.position - obj->position);
-  if (resources_->GetConfigs()->render_scene != "town" && 
-      obj->distance > resources_->GetConfigs()->light_radius + 5) { 
-    return true;
+  occlusion_buffer_.Clear(projection_matrix_ * view_matrix_);
+  if (configs->render_scene != "town" && configs->draw_dungeon) {
+    AddDungeonOccluders();
   }
 
-  float size_in_camera = bounding_sphere.radius / obj->distance;
-  if (obj->type != GAME_OBJ_MISSILE && size_in_camera < 0.005f) {
-    return true;
+  for (ObjPtr obj : objs) {
+    if (!obj->asset_group) continue;
+    for (shared_ptr<GameAsset> asset : obj->asset_group->assets) {
+      if (asset->occluder.empty()) continue;
+      occlusion_buffer_.AddOccluder(GetOccluderTriangles(asset),
+        GetModelMatrix(obj, asset));
+    }
   }
 
-  // TODO: fix IsInConvexHull
-  // Occlusion cull.
-  // for (auto& ch : occluder_convex_hulls) {
-  //   if (IsInConvexHull(bounding_sphere, ch)) {
-  //   // if (IsInConvexHull(obj->aabb, ch)) {
-  //     return true;
-  //   }
-  // }
-  return false;
+  if (occlusion_buffer_.GetMetrics().num_occluders == 0) return objs;
+  occlusion_buffer_.BuildHiZ();
+
+  vector<ObjPtr> visible_objects;
+  for (ObjPtr obj : objs) {
+    if (obj->never_cull) {
+      visible_objects.push_back(obj);
+      continue;
+    }
+
+    BoundingSphere s = obj->GetTransformedBoundingSphere();
+    if (occlusion_buffer_.IsVisible(s.center - vec3(s.radius), 
+      s.center + vec3(s.radius))) {
+      visible_objects.push_back(obj);
+    }
+  }
+  return visible_objects;
 }
 
 vector<ObjPtr> Renderer::GetVisibleObjectsInSector(
-  shared_ptr<Sector> sector, vec4 frustum_planes[6]) {
+  shared_ptr<Sector> sector, vec4 frustum_planes[6], const vec3& origin,
+  bool camera_view) {
   vector<ObjPtr> visible_objects;
 
-  vector<shared_ptr<GameObject>> objs =
-    GetVisibleObjectsFromSector(sector);
+  vector<shared_ptr<GameObject>> objs = GetVisibleObjectsFromSector(sector,
+    frustum_planes, origin, camera_view);
+  if (camera_view) objs = CullOccludedObjects(objs);
 
   vector<shared_ptr<GameObject>> darkness_objs;
   vector<shared_ptr<GameObject>> transparent_objs;
@@ -293,9 +251,6 @@ vector<ObjPtr> Renderer::GetVisibleObjectsInSector(
   GLuint lake_shader = resources_->GetShader("mana_pool");
   GLuint region_shader = resources_->GetShader("region");
 
-  // Occlusion culling
-  // https://www.gamasutra.com/view/feature/2979/rendering_the_great_outdoors_fast_.php?print=1
-  vector<vector<Polygon>> occluder_convex_hulls;
   for (auto& obj : objs) {
     if (obj->IsPartiallyTransparent()) { 
       transparent_objs.push_back(obj);
@@ -324,62 +279,60 @@ vector<ObjPtr> Renderer::GetVisibleObjectsInSector(
   return visible_objects;
 }
 
-// Portal culling 
-// http://di.ubi.pt/~agomes/tjv/teoricas/07-culling.pdf
-vector<ObjPtr> Renderer::GetVisibleObjectsInPortal(shared_ptr<Portal> p, 
-  shared_ptr<StabbingTreeNode> node,
-  vec4 frustum_planes[6]) {
-  if (p->cave) return {};
-
-  BoundingSphere sphere = BoundingSphere(camera_.position, 2.5f);
-  bool in_frustum = false; 
-
-  const string mesh_name = p->GetAsset()->lod_meshes[0];
-  shared_ptr<Mesh> mesh = resources_->GetMeshByName(mesh_name);
-  if (!mesh) {
-    throw runtime_error(string("Mesh ") + mesh_name + " does not exist.");
-  }
-
-  cout << "Testing portal name" << p->name << endl;
-
-  for (auto& poly : mesh->polygons) {
-    vec3 portal_point = p->position + poly.vertices[0];
-    vec3 normal = poly.normal;
-
-    // if (TestSphereTriangleIntersection(sphere - p->position, poly.vertices)) {
-    //   in_frustum = true;
-    //   break;
-    // }
-
-    // if (dot(normalize(camera_.position - portal_point), normal) < 0.000001f) {
-    //   continue;
-    // }
-
-    if (CollideTriangleFrustum(poly.vertices, frustum_planes_,
-      camera_.position - p->position)) {
-      in_frustum = true;
-      break;
+shared_ptr<PortalNode> Renderer::BuildPortalTree(
+  shared_ptr<StabbingTreeNode> stabbing_tree_node) {
+  shared_ptr<Sector> sector = stabbing_tree_node->sector;
+  shared_ptr<PortalNode> node = make_shared<PortalNode>();
+  node->sector_id = sector->id;
+  node->sector = sector;
+  node->stabbing_tree_node = stabbing_tree_node;
+  node->num_objects = sector->objects.size();
+
+  for (auto& child : stabbing_tree_node->children) {
+    if (sector->portals.find(child->sector->id) == sector->portals.end()) {
+      throw runtime_error("Sector should have portal.");
     }
-  }
 
-  // TODO: check other types of culling.
-  if (!in_frustum) {
-    return {};
-  }
+    // Caves are drawn with the outside sector.
+    shared_ptr<Portal> p = sector->portals[child->sector->id];
+    if (p->cave) continue;
 
-  if (node->sector->name == "outside") {
-    const string mesh_name = p->mesh_name;
+    const string mesh_name = p->GetAsset()->lod_meshes[0];
     shared_ptr<Mesh> mesh = resources_->GetMeshByName(mesh_name);
     if (!mesh) {
       throw runtime_error(string("Mesh ") + mesh_name + " does not exist.");
     }
 
-    Polygon& poly = mesh->polygons[0];
-    terrain_clipping_point_ = poly.vertices[0] + p->position;
-    terrain_clipping_normal_ = poly.normal;
+    shared_ptr<PortalNode> child_node = BuildPortalTree(child);
+    child_node->portal = p;
+    for (const Polygon& poly : mesh->polygons) {
+      for (size_t i = 1; i + 1 < poly.vertices.size(); i++) {
+        child_node->portal_triangles.push_back(p->position + poly.vertices[0]);
+        child_node->portal_triangles.push_back(p->position + poly.vertices[i]);
+        child_node->portal_triangles.push_back(
+          p->position + poly.vertices[i + 1]);
+      }
+    }
+    node->children.push_back(child_node);
+  }
+  return node;
+}
+
+shared_ptr<PortalNode> Renderer::GetPortalTree(shared_ptr<Sector> sector) {
+  // Sectors or portals were reloaded.
+  int generation = resources_->GetSectorsGeneration();
+  if (generation != portal_trees_generation_) {
+    portal_trees_.clear();
+    portal_trees_generation_ = generation;
   }
 
-  return GetVisibleObjectsInStabbingTreeNode(node, frustum_planes);
+  auto it = portal_trees_.find(sector->id);
+  if (it != portal_trees_.end()) return it->second;
+  if (!sector->stabbing_tree) return nullptr;
+
+  shared_ptr<PortalNode> root = BuildPortalTree(sector->stabbing_tree);
+  portal_trees_[sector->id] = root;
+  return root;
 }
 
 vector<ObjPtr> Renderer::GetVisibleObjectsInCaves(
@@ -414,49 +367,51 @@ vector<ObjPtr> Renderer::GetVisibleObjectsInCaves(
   return visible_objects;
 }
 
-vector<ObjPtr> Renderer::GetVisibleObjectsInStabbingTreeNode(
-  shared_ptr<StabbingTreeNode> stabbing_tree_node, vec4 frustum_planes[6]) {
-  if (!stabbing_tree_node) return {};
-
-  vector<ObjPtr> visible_objects;
-  shared_ptr<Sector> sector = stabbing_tree_node->sector;
-  if (sector->name == "outside") {
-    vector<ObjPtr> objs = GetVisibleObjectsInCaves(stabbing_tree_node, 
-      frustum_planes);
-    visible_objects.insert(visible_objects.end(), objs.begin(), objs.end()); 
+// Portal culling 
+// http://di.ubi.pt/~agomes/tjv/teoricas/07-culling.pdf
+vector<ObjPtr> Renderer::GetVisibleObjects(const mat4& MVP,
+  const vec3& origin, bool camera_view) {
+  shared_ptr<Sector> sector = 
+    resources_->GetSector(camera_.position);
 
-    shared_ptr<Configs> configs = resources_->GetConfigs();
-    visible_objects.push_back(nullptr); // Means draw terrain.
+  if (!sector->occlude) {
+    sector = resources_->GetSectorByName(kOutsideSector);
   }
 
-  vector<ObjPtr> objs = GetVisibleObjectsInSector(sector, frustum_planes);
-  visible_objects.insert(visible_objects.end(), objs.begin(), objs.end());
+  vector<ObjPtr> visible_objects;
+  for (SectorView& view : portal_visibility_.Compute(GetPortalTree(sector),
+    MVP, origin)) {
+    shared_ptr<StabbingTreeNode> stabbing_tree_node = 
+      view.node->stabbing_tree_node;
+    shared_ptr<Sector> s = view.node->sector;
+    if (s->name == "outside") {
+      vector<ObjPtr> objs = GetVisibleObjectsInCaves(stabbing_tree_node, 
+        view.frustum_planes);
+      visible_objects.insert(visible_objects.end(), objs.begin(), objs.end()); 
+      visible_objects.push_back(nullptr); // Means draw terrain.
+
+      shared_ptr<Portal> p = view.node->portal;
+      if (p) {
+        const string mesh_name = p->mesh_name;
+        shared_ptr<Mesh> mesh = resources_->GetMeshByName(mesh_name);
+        if (!mesh) {
+          throw runtime_error(string("Mesh ") + mesh_name + 
+            " does not exist.");
+        }
 
-  for (auto& node : stabbing_tree_node->children) {
-    if (sector->portals.find(node->sector->id) == sector->portals.end()) {
-      throw runtime_error("Sector should have portal.");
+        Polygon& poly = mesh->polygons[0];
+        terrain_clipping_point_ = poly.vertices[0] + p->position;
+        terrain_clipping_normal_ = poly.normal;
+      }
     }
 
-    shared_ptr<Portal> p = sector->portals[node->sector->id];
-    vector<ObjPtr> objs = GetVisibleObjectsInPortal(p, node, 
-      frustum_planes);
+    vector<ObjPtr> objs = GetVisibleObjectsInSector(s, view.frustum_planes,
+      origin, camera_view);
     visible_objects.insert(visible_objects.end(), objs.begin(), objs.end());
   }
   return visible_objects;
 }
 
-vector<ObjPtr> Renderer::GetVisibleObjects(vec4 frustum_planes[6]) {
-  shared_ptr<Sector> sector = 
-    resources_->GetSector(camera_.position);
-
-  if (!sector->occlude) {
-    sector = resources_->GetSectorByName("outside");
-  }
-
-  return GetVisibleObjectsInStabbingTreeNode(sector->stabbing_tree, 
-    frustum_planes);
-}
-
 void Renderer::DrawOutside() {
   shared_ptr<Configs> configs = resources_->GetConfigs();
   if (configs->render_scene != "town" && configs->draw_dungeon) {
@@ -572,9 +527,7 @@ void Renderer::Draw3dParticle(shared_ptr<Particle> obj) {
     vector<mat4> joint_transforms;
     if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
       const Animation& animation = mesh->animations[obj->active_animation];
-      for (int i = 0; i < animation.keyframes[obj->animation_frame].transforms.size(); i++) {
-        joint_transforms.push_back(animation.keyframes[obj->animation_frame].transforms[i]);
-      }
+      SampleAnimation(animation, obj->animation_frame, joint_transforms);
     } else {
       ThrowError("Animation ", obj->active_animation, " for object ",
         obj->name, " and asset ", asset->name, " does not exist");
@@ -606,7 +559,7 @@ void Renderer::Draw3dParticle(shared_ptr<Particle> obj) {
   glUniform2fv(GetUniformId(program_id, "tile_pos"), 1, (float*) &particle->tile_pos);
   glUniform1f(GetUniformId(program_id, "tile_size"), particle->tile_size);
 
-  glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+  glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
   glDisable(GL_BLEND);
   glBindVertexArray(0);
 }
@@ -617,12 +570,7 @@ vector<mat4> Renderer::GetJointTransforms(ObjPtr obj, MeshPtr mesh) {
   if (!obj->transition_animation) {
     if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
       const Animation& animation = mesh->animations[obj->active_animation];
-    
-      if (animation.keyframes.size() > obj->frame) {
-        for (int i = 0; i < animation.keyframes[obj->frame].transforms.size(); i++) {
-          joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
-        }
-      }
+      SampleAnimation(animation, obj->frame, joint_transforms);
     } else {
       ThrowError("Animation ", obj->active_animation, " for object ",
         obj->name, " and asset ", obj->GetAsset()->name, " does not exist");
@@ -645,10 +593,9 @@ vector<mat4> Renderer::GetJointTransforms(ObjPtr obj, MeshPtr mesh) {
   // cout << "prev_animation: " << obj->prev_animation << endl;
   // cout << "cur_animation: " << obj->active_animation << endl;
 
-  int num_transforms = 0;
-  if (cur_animation.keyframes.size() > obj->frame) {
-    num_transforms = cur_animation.keyframes[obj->frame].transforms.size();
-  }
+  vector<mat4> cur_transforms;
+  SampleAnimation(cur_animation, obj->frame, cur_transforms);
+  int num_transforms = cur_transforms.size();
 
   for (int i = 0; i < num_transforms; i++) {
     switch (obj->transition_type) {
@@ -684,19 +631,18 @@ vector<mat4> Renderer::GetJointTransforms(ObjPtr obj, MeshPtr mesh) {
         // joint_transforms.push_back(joint_transform);
 
         float frame = obj->prev_animation_frame + obj->transition_frame;
-        mat4 joint_transform = prev_animation.keyframes[frame].transforms[i];
+        mat4 joint_transform = SampleAnimation(prev_animation, i, frame);
         joint_transforms.push_back(joint_transform);
         break;
       }
       case TRANSITION_FINISH_ANIMATION: {
         float frame = obj->prev_animation_frame + obj->transition_frame;
-        mat4 joint_transform = prev_animation.keyframes[frame].transforms[i];
+        mat4 joint_transform = SampleAnimation(prev_animation, i, frame);
         joint_transforms.push_back(joint_transform);
         break;
       }
       default: {
-        const Animation& animation = mesh->animations[obj->active_animation];
-        joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
+        joint_transforms.push_back(cur_transforms[i]);
         break;
       }
     }
@@ -717,9 +663,7 @@ vector<mat4> Renderer::GetJointTransformsForMerchant() {
   vector<mat4> joint_transforms;
   if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
     const Animation& animation = mesh->animations[obj->active_animation];
-    for (int i = 0; i < animation.keyframes[obj->frame].transforms.size(); i++) {
-      joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
-    }
+    SampleAnimation(animation, obj->frame, joint_transforms);
   } else {
     ThrowError("Animation ", obj->active_animation, " for object ",
       obj->name, " and asset ", obj->GetAsset()->name, " does not exist");
@@ -780,7 +724,7 @@ void Renderer::DrawFire(ObjPtr obj, shared_ptr<Mesh> mesh, GLuint program_id, GL
   mat4 VP = projection_matrix_ * view_matrix_;  
   glUniformMatrix4fv(GetUniformId(program_id, "VP"), 1, GL_FALSE, &VP[0][0]);
 
-  glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+  glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
 
   glDisable(GL_BLEND);
   glDepthMask(GL_TRUE);
@@ -789,6 +733,165 @@ void Renderer::DrawFire(ObjPtr obj, shared_ptr<Mesh> mesh, GLuint program_id, GL
 }
 
 // TODO: split into functions for each shader.
+shared_ptr<Mesh> Renderer::GetLodMesh(ObjPtr obj, 
+  shared_ptr<GameAsset> asset) {
+  int lod = glm::clamp(int(obj->distance / LOD_DISTANCE), 0, 4);
+  for (; lod >= 0; lod--) {
+    if (!asset->lod_meshes[lod].empty()) {
+      break;
+    }
+  }
+
+  const string mesh_name = asset->lod_meshes[lod];
+  shared_ptr<Mesh> mesh = resources_->GetMeshByName(mesh_name);
+  if (!mesh) {
+    throw runtime_error(string("Mesh ") + mesh_name + " does not exist.");
+  }
+  return mesh;
+}
+
+mat4 Renderer::GetModelMatrix(ObjPtr obj, shared_ptr<GameAsset> asset) {
+  mat4 ModelMatrix = translate(mat4(1.0), obj->position);
+  ModelMatrix = ModelMatrix * obj->rotation_matrix;
+
+  float scale = obj->scale * asset->scale;
+  if (obj->scale_in < 1.0f) {
+    scale = obj->scale * asset->scale * obj->scale_in;
+  } else if (obj->life <= 0.0f && obj->scale_out > 0.0f) {
+    scale = obj->scale * asset->scale * obj->scale_out;
+  }
+  return glm::scale(ModelMatrix, vec3(scale));
+}
+
+// Objects that DrawObject would draw with the plain object shader. Their
+// uniforms only depend on the asset and the model matrix, so they can be
+// drawn with the instanced version of the shader.
+bool Renderer::CanInstance(ObjPtr obj, int mode) {
+  GLuint instanced_program = resources_->GetShader("object_instanced");
+  if (!instanced_program) return false;
+  if (!frame_uniforms_buffer_->IsBound(instanced_program)) return false;
+  if (mode == 2 || mode == 3) return false;
+  if (obj->type != GAME_OBJ_DEFAULT) return false;
+  if (obj->IsCreature() || obj->Is3dParticle()) return false;
+
+  GLuint object_program = resources_->GetShader("object");
+  for (shared_ptr<GameAsset> asset : obj->asset_group->assets) {
+    if (asset->shader != object_program) return false;
+    if (asset->name == "grimmoire_pages") return false;
+  }
+  return true;
+}
+
+void Renderer::QueueObject(ObjPtr obj) {
+  GLuint program_id = resources_->GetShader("object_instanced");
+  int object_index = render_queue_objects_.size();
+  render_queue_objects_.push_back(obj);
+
+  const vector<shared_ptr<GameAsset>>& assets = obj->asset_group->assets;
+  for (int i = 0; i < assets.size(); i++) {
+    shared_ptr<GameAsset> asset = assets[i];
+    shared_ptr<Mesh> mesh = GetLodMesh(obj, asset);
+    GLuint texture_id = asset->textures.empty() ? 0 : asset->textures[0];
+
+    RenderCommand command;
+    command.sort_key = MakeRenderSortKey(RENDER_PASS_OPAQUE, program_id, 
+      texture_id, mesh->vao_, asset->id, obj->distance, FAR_CLIPPING);
+    command.program = program_id;
+    command.texture = texture_id;
+    command.mesh = mesh->vao_;
+    command.material = asset->id;
+    command.num_indices = mesh->num_indices;
+    command.object = object_index;
+    command.asset = i;
+    render_queue_.Add(command);
+  }
+}
+
+void Renderer::DrawRenderQueue() {
+  render_queue_.Build();
+
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS); 
+  glDepthMask(GL_TRUE);
+
+  if (!instance_vbo_) glGenBuffers(1, &instance_vbo_);
+
+  const vector<RenderCommand>& commands = render_queue_.GetCommands();
+  GLuint current_program = 0;
+  for (const RenderBatch& batch : render_queue_.GetBatches()) {
+    const RenderCommand& command = commands[batch.first];
+    GLuint program_id = command.program;
+    // The camera and lighting come from the frame uniforms.
+    if (program_id != current_program) {
+      current_program = program_id;
+      glUseProgram(program_id);
+    }
+
+    ObjPtr obj = render_queue_objects_[command.object];
+    shared_ptr<GameAsset> asset = obj->asset_group->assets[command.asset];
+    glUniform1f(GetUniformId(program_id, "normal_strength"), 
+      asset->normal_strength);
+    glUniform1f(GetUniformId(program_id, "specular_component"), 
+      asset->specular_component);
+    glUniform1f(GetUniformId(program_id, "metallic_component"), 
+      asset->metallic_component);
+    glUniform4fv(GetUniformId(program_id, "base_color"), 1,
+      (float*) &asset->base_color);
+
+    GLuint texture_id = command.texture;
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glUniform1i(GetUniformId(program_id, "texture_sampler"), 0);
+
+    glActiveTexture(GL_TEXTURE1);
+    if (asset->bump_map_id == 0) {
+      glBindTexture(GL_TEXTURE_2D, texture_id);
+      glUniform1i(GetUniformId(program_id, "enable_bump_map"), 0);
+    } else {
+      glBindTexture(GL_TEXTURE_2D, asset->bump_map_id);
+      glUniform1i(GetUniformId(program_id, "enable_bump_map"), 1);
+    }
+    glUniform1i(GetUniformId(program_id, "bump_map_sampler"), 1);
+
+    if (asset->specular_id != 0) {
+      glActiveTexture(GL_TEXTURE2);
+      glBindTexture(GL_TEXTURE_2D, asset->specular_id);
+      glUniform1i(GetUniformId(program_id, "specular_sampler"), 2);
+    }
+
+    instance_matrices_.clear();
+    for (int i = batch.first; i < batch.first + batch.count; i++) {
+      ObjPtr instance = render_queue_objects_[commands[i].object];
+      instance_matrices_.push_back(GetModelMatrix(instance, 
+        instance->asset_group->assets[commands[i].asset]));
+    }
+
+    glBindVertexArray(command.mesh);
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo_);
+    glBufferData(GL_ARRAY_BUFFER, instance_matrices_.size() * sizeof(mat4), 
+      &instance_matrices_[0], GL_STREAM_DRAW);
+
+    // The model matrix takes locations 7 to 10, after the bone attributes.
+    std::size_t vec4_size = sizeof(vec4);
+    for (int i = 0; i < 4; i++) {
+      glEnableVertexAttribArray(7 + i); 
+      glVertexAttribPointer(7 + i, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, 
+        (void*)(i * vec4_size));
+      glVertexAttribDivisor(7 + i, 1);
+    }
+
+    glDrawElementsInstanced(GL_TRIANGLES, command.num_indices, 
+      GL_UNSIGNED_INT, nullptr, batch.count);
+
+    // The mesh VAO is shared with the non instanced draws.
+    for (int i = 0; i < 4; i++) {
+      glVertexAttribDivisor(7 + i, 0);
+      glDisableVertexAttribArray(7 + i);
+    }
+  }
+  glBindVertexArray(0);
+}
+
 void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
   if (obj == nullptr) return;
 
@@ -816,19 +919,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
   }
 
   for (shared_ptr<GameAsset> asset : obj->asset_group->assets) {
-    int lod = glm::clamp(int(obj->distance / LOD_DISTANCE), 0, 4);
-    for (; lod >= 0; lod--) {
-      if (!asset->lod_meshes[lod].empty()) {
-        break;
-      }
-    }
-
-    const string mesh_name = asset->lod_meshes[lod];
-    shared_ptr<Mesh> mesh = resources_->GetMeshByName(mesh_name);
-    if (!mesh) {
-      throw runtime_error(string("Mesh ") + mesh_name + " does not exist.");
-    }
-
+    shared_ptr<Mesh> mesh = GetLodMesh(obj, asset);
     GLuint program_id = asset->shader;
 
     bool dying = (obj->IsCreature() && obj->life <= 0.0f);
@@ -863,25 +954,13 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
     glUseProgram(program_id);
 
     glBindVertexArray(mesh->vao_);
-    mat4 ModelMatrix = translate(mat4(1.0), obj->position);
-    ModelMatrix = ModelMatrix * obj->rotation_matrix;
-
-    float scale = obj->scale * asset->scale;
-    if (obj->scale_in < 1.0f) {
-      scale = obj->scale * asset->scale * obj->scale_in;
-    } else if (obj->life <= 0.0f && obj->scale_out > 0.0f) {
-      scale = obj->scale * asset->scale * obj->scale_out;
-    }
-
     glUniform1f(GetUniformId(program_id, "u_time"), u_time_);
 
-    ModelMatrix = glm::scale(ModelMatrix, vec3(scale));
-
+    mat4 ModelMatrix = GetModelMatrix(obj, asset);
     mat4 ModelViewMatrix = view_matrix_ * ModelMatrix;
     mat4 MVP = projection_matrix_ * ModelViewMatrix;
     glUniformMatrix4fv(GetUniformId(program_id, "MVP"), 1, GL_FALSE, &MVP[0][0]);
     glUniformMatrix4fv(GetUniformId(program_id, "M"), 1, GL_FALSE, &ModelMatrix[0][0]);
-    glUniformMatrix4fv(GetUniformId(program_id, "V"), 1, GL_FALSE, &view_matrix_[0][0]);
     mat3 ModelView3x3Matrix = mat3(ModelViewMatrix);
     glUniformMatrix3fv(GetUniformId(program_id, "MV3x3"), 1, GL_FALSE, &ModelView3x3Matrix[0][0]);
 
@@ -889,36 +968,41 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
     mat4 DepthMVP = shadow_matrix * ModelMatrix;
     glUniformMatrix4fv(GetUniformId(program_id, "DepthMVP"), 1, GL_FALSE, &DepthMVP[0][0]);
 
-    glUniform3fv(GetUniformId(program_id, "camera_pos"), 1,
-      (float*) &camera_.position);
+    // Programs with the frame uniforms block read these from the buffer.
+    if (!frame_uniforms_buffer_->IsBound(program_id)) {
+      glUniformMatrix4fv(GetUniformId(program_id, "V"), 1, GL_FALSE, &view_matrix_[0][0]);
 
-    glUniform3fv(GetUniformId(program_id, "light_direction"), 1,
-      (float*) &configs->sun_position);
+      glUniform3fv(GetUniformId(program_id, "camera_pos"), 1,
+        (float*) &camera_.position);
 
-    vec3 light_color = vec3(1, 1, 1);
-    glUniform3fv(GetUniformId(program_id, "lighting_color"), 1,
-      (float*) &light_color);
-    // if (obj->current_sector) {
-    //   glUniform3fv(GetUniformId(program_id, "lighting_color"), 1,
-    //     (float*) &obj->current_sector->lighting_color);
+      glUniform3fv(GetUniformId(program_id, "light_direction"), 1,
+        (float*) &configs->sun_position);
 
-    //   vec3 light_color = vec3(0.3);
-    //   glUniform3fv(GetUniformId(program_id, "lighting_color"), 1,
-    //     (float*) &light_color);
-    // }
+      vec3 light_color = vec3(1, 1, 1);
+      glUniform3fv(GetUniformId(program_id, "lighting_color"), 1,
+        (float*) &light_color);
+      // if (obj->current_sector) {
+      //   glUniform3fv(GetUniformId(program_id, "lighting_color"), 1,
+      //     (float*) &obj->current_sector->lighting_color);
 
-    glUniform1f(GetUniformId(program_id, "light_radius"), configs->light_radius);
+      //   vec3 light_color = vec3(0.3);
+      //   glUniform3fv(GetUniformId(program_id, "lighting_color"), 1,
+      //     (float*) &light_color);
+      // }
 
-    if (configs->render_scene != "town") {
-      glUniform1f(GetUniformId(program_id, "outdoors"), 0);
-      glUniform1f(GetUniformId(program_id, "in_dungeon"), 1);
-    } else {
-      glUniform1f(GetUniformId(program_id, "outdoors"), 1);
-      glUniform1f(GetUniformId(program_id, "in_dungeon"), 0);
-    }
+      glUniform1f(GetUniformId(program_id, "light_radius"), configs->light_radius);
 
-    glUniform3fv(GetUniformId(program_id, "player_pos"), 1,
-      (float*) &resources_->GetPlayer()->position);
+      if (configs->render_scene != "town") {
+        glUniform1f(GetUniformId(program_id, "outdoors"), 0);
+        glUniform1f(GetUniformId(program_id, "in_dungeon"), 1);
+      } else {
+        glUniform1f(GetUniformId(program_id, "outdoors"), 1);
+        glUniform1f(GetUniformId(program_id, "in_dungeon"), 0);
+      }
+
+      glUniform3fv(GetUniformId(program_id, "player_pos"), 1,
+        (float*) &resources_->GetPlayer()->position);
+    }
 
     glUniform1f(GetUniformId(program_id, "normal_strength"), 
       asset->normal_strength);
@@ -954,7 +1038,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
           light_color = asset->light_color;
           quadratic = asset->quadratic;
           if (asset->flickers) {
-            float noise = 0.125 * sin(glfwGetTime() * 4.0) + 0.1 * sin(glfwGetTime() * 10.0f) + 0.075 * sin(glfwGetTime() * 20.0f);
+            float noise = 0.125 * sin(GetTime() * 4.0) + 0.1 * sin(GetTime() * 10.0f) + 0.075 * sin(GetTime() * 20.0f);
             quadratic += 0.5 * asset->quadratic * noise;
           }
         }
@@ -1039,7 +1123,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
         glUniform1i(GetUniformId(program_id, "specular_sampler"), 2);
       }
 
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
     } else if (program_id == resources_->GetShader("animated_transparent_object")) {
       glDisable(GL_CULL_FACE);
       glEnable(GL_BLEND);
@@ -1047,15 +1131,12 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       vector<mat4> joint_transforms;
       if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
         const Animation& animation = mesh->animations[obj->active_animation];
-        if (obj->frame > animation.keyframes.size()) {
+        if (obj->frame >= GetNumFrames(animation)) {
           ThrowError("Frame ", obj->frame, " outside the scope of animation ",
           obj->active_animation, " for object ", obj->name, " which has ",
-          animation.keyframes.size(), " frames");
-        }
-
-        for (int i = 0; i < animation.keyframes[obj->frame].transforms.size(); i++) {
-          joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
+          GetNumFrames(animation), " frames");
         }
+        SampleAnimation(animation, obj->frame, joint_transforms);
       } else {
         ThrowError("Animation ", obj->active_animation, " for object ",
           obj->name, " and asset ", asset->name, " does not exist");
@@ -1068,7 +1149,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       glBindTexture(GL_TEXTURE_2D, texture_id);
       glUniform1i(GetUniformId(program_id, "texture_sampler"), 0);
 
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
       glDisable(GL_BLEND);
     } else if (program_id == resources_->GetShader("web")) {
       glDisable(GL_CULL_FACE);
@@ -1077,15 +1158,12 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       vector<mat4> joint_transforms;
       if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
         const Animation& animation = mesh->animations[obj->active_animation];
-        if (obj->frame > animation.keyframes.size()) {
+        if (obj->frame >= GetNumFrames(animation)) {
           ThrowError("Frame ", obj->frame, " outside the scope of animation ",
           obj->active_animation, " for object ", obj->name, " which has ",
-          animation.keyframes.size(), " frames");
-        }
-
-        for (int i = 0; i < animation.keyframes[obj->frame].transforms.size(); i++) {
-          joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
+          GetNumFrames(animation), " frames");
         }
+        SampleAnimation(animation, obj->frame, joint_transforms);
       } else {
         ThrowError("Animation ", obj->active_animation, " for object ",
           obj->name, " and asset ", asset->name, " does not exist");
@@ -1106,7 +1184,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       glUniform3fv(GetUniformId(program_id, "center"), 1,
         (float*) &obj->position);
 
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
       glDisable(GL_BLEND);
     } else if (program_id == resources_->GetShader("object") ||
                program_id == resources_->GetShader("outdoor_object")) {
@@ -1137,7 +1215,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
         glUniform1i(GetUniformId(program_id, "specular_sampler"), 2);
       }
 
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
     } else if (program_id == resources_->GetShader("transparent_object")) {
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -1146,7 +1224,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       glBindTexture(GL_TEXTURE_2D, texture_id);
       glUniform1i(GetUniformId(program_id, "texture_sampler"), 0);
 
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
       glDisable(GL_BLEND);
     } else if (program_id == resources_->GetShader("fire")) {
       DrawFire(obj, mesh, program_id, texture_id);
@@ -1155,18 +1233,18 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       glBindTexture(GL_TEXTURE_2D, texture_id);
       glUniform1i(GetUniformId(program_id, "texture_sampler"), 0);
 
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
     } else if (program_id == resources_->GetShader("hypercube")) {
       glDisable(GL_CULL_FACE);
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
       glDisable(GL_BLEND);
     } else if (program_id == resources_->GetShader("region")) {
       glDisable(GL_CULL_FACE);
       glEnable(GL_BLEND);
       glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
       glDisable(GL_BLEND);
     } else if (program_id == resources_->GetShader("mana_pool")) {
       glEnable(GL_BLEND);
@@ -1189,7 +1267,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       const vec3 player_pos = resources_->GetPlayer()->position;
       glUniform3fv(GetUniformId(program_id, "camera_position"), 1, (float*) &player_pos);
       glUniform1f(GetUniformId(program_id, "move_factor"), move_factor);
-      glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+      glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
       glDisable(GL_BLEND); 
     } else if (program_id == resources_->GetShader("death") ||
               program_id == resources_->GetShader("detect_monster")) {
@@ -1198,17 +1276,12 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
       Animation& animation = mesh->animations[obj->active_animation];
       if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
         const Animation& animation = mesh->animations[obj->active_animation];
-
-        if (animation.keyframes.size() > obj->frame) {
-          for (int i = 0; i < animation.keyframes[obj->frame].transforms.size(); i++) {
-            joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
-          }
-        }
+        SampleAnimation(animation, obj->frame, joint_transforms);
 
         glUniformMatrix4fv(GetUniformId(program_id, "joint_transforms"), 
           joint_transforms.size(), GL_FALSE, &joint_transforms[0][0][0]);
 
-        float dissolve_value = obj->frame / (float) animation.keyframes.size();
+        float dissolve_value = obj->frame / (float) GetNumFrames(animation);
         glUniform1f(GetUniformId(program_id, "dissolve_value"), dissolve_value);
 
         glDisable(GL_CULL_FACE);
@@ -1243,7 +1316,7 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
         glBindTexture(GL_TEXTURE_2D, resources_->GetTextureByName("dissolve"));
         glUniform1i(GetUniformId(program_id, "mask_sampler"), 3);
 
-        glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+        glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
         glDisable(GL_BLEND);
         glBindVertexArray(0);
       } else {
@@ -1272,10 +1345,15 @@ void Renderer::DrawObject(shared_ptr<GameObject> obj, int mode) {
 }
 
 void Renderer::DrawObjects(vector<ObjPtr> objs, int mode) {
+  render_queue_.Clear();
+  render_queue_objects_.clear();
+
   glDisable(GL_CULL_FACE);
   for (auto& obj : objs) {
     if (!obj) { // Terrain.
       DrawOutside();
+    } else if (CanInstance(obj, mode)) {
+      QueueObject(obj);
     } else if (obj->type == GAME_OBJ_PORTAL) {
       // TODO: to display particles inside the sector.
       // DrawParticles();
@@ -1286,6 +1364,7 @@ void Renderer::DrawObjects(vector<ObjPtr> objs, int mode) {
       DrawObject(obj, mode);
     }
   }
+  DrawRenderQueue();
 
   DrawParticles();
   glEnable(GL_CULL_FACE);
@@ -1307,6 +1386,7 @@ void Renderer::DrawHypercube() {
     vec3(0, 0, 1), // Look here.
     vec3(0, 1, 0)  // Up. 
   );
+  UpdateFrameUniforms();
 
   project_4d_->CreateHypercube(vec3(0, 0, 20), hypercube_rotation);
   hypercube_rotation[0] += 0.02;
@@ -1356,13 +1436,15 @@ void Renderer::Draw() {
     clear_color = vec3(0);
   }
   u_time_ += 0.01f;
+  UpdateFrameUniforms();
 
   glViewport(0, 0, window_width_, window_height_);
   glClearColor(clear_color.x, clear_color.y, clear_color.z, 1.0);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   GetFrustumPlanes(frustum_planes_);
-  vector<ObjPtr> objects = GetVisibleObjects(frustum_planes_);
+  vector<ObjPtr> objects = GetVisibleObjects(projection_matrix_ * 
+    view_matrix_ * translate(mat4(1.0), camera_.position), camera_.position);
 
   if (configs->render_scene != "town") {
     shared_ptr<Player> player = resources_->GetPlayer();
@@ -1482,13 +1564,7 @@ void Renderer::DrawObjectShadow(shared_ptr<GameObject> obj, int level) {
       vector<mat4> joint_transforms;
       if (mesh->animations.find(obj->active_animation) != mesh->animations.end()) {
         const Animation& animation = mesh->animations[obj->active_animation];
-       
-        if (animation.keyframes.size() > obj->frame) {
-          int n = animation.keyframes[obj->frame].transforms.size();
-          for (int i = 0; i < n; i++) {
-            joint_transforms.push_back(animation.keyframes[obj->frame].transforms[i]);
-          }
-        }
+        SampleAnimation(animation, obj->frame, joint_transforms);
       } else {
         ThrowError("Animation ", obj->active_animation, " for object ",
           obj->name, " and asset ", asset->name, " does not exist");
@@ -1498,7 +1574,7 @@ void Renderer::DrawObjectShadow(shared_ptr<GameObject> obj, int level) {
         joint_transforms.size(), GL_FALSE, &joint_transforms[0][0][0]);
     }
 
-    glDrawArrays(GL_TRIANGLES, 0, mesh->num_indices);
+    glDrawElements(GL_TRIANGLES, mesh->num_indices, GL_UNSIGNED_INT, nullptr);
   }
 }
 
@@ -1576,7 +1652,7 @@ void Renderer::DrawShadows() {
     mat4 ModelMatrix = translate(mat4(1.0), position);
     mat4 MVP = shadow_matrix * ModelMatrix;
     ExtractFrustumPlanes(MVP, frustum_planes_);
-    vector<ObjPtr> objects = GetVisibleObjects(frustum_planes_);
+    vector<ObjPtr> objects = GetVisibleObjects(MVP, position, false);
 
     glDisable(GL_CULL_FACE);
     for (auto& obj : objects) {
@@ -1690,7 +1766,7 @@ void Renderer::DrawStatusBars() {
       if (monster->status == STATUS_DEAD) num_dead++;
     }
 
-    float timer = configs->wave_reset_timer - glfwGetTime();
+    float timer = configs->wave_reset_timer - GetTime();
 
     string s = string("Wave ") + 
       boost::lexical_cast<string>(configs->current_wave) + ": " +
@@ -1701,14 +1777,14 @@ void Renderer::DrawStatusBars() {
       vec4(1, 1, 1, 1), 1.0, false, "avenir_light_oblique");
   }
 
-  float time_to_push = player->cooldowns["push"] - glfwGetTime();
+  float time_to_push = player->cooldowns["push"] - GetTime();
   time_to_push = (time_to_push < 0) ? 0 : time_to_push;
   string str = string("Push: ") + boost::lexical_cast<string>(float(
     time_to_push));
   draw_2d_->DrawText(str, 300, 900 - 750, 
     vec4(1, 1, 1, 1), 1.0, false, "avenir_light_oblique");
 
-  float time_to_windslash = player->cooldowns["windslash"] - glfwGetTime();
+  float time_to_windslash = player->cooldowns["windslash"] - GetTime();
   time_to_windslash = (time_to_windslash < 0) ? 0 : time_to_windslash;
   str = string("Windslash: ") + boost::lexical_cast<string>(float(
     time_to_windslash));
@@ -1775,7 +1851,7 @@ void Renderer::DrawScreenEffects() {
   DrawStatusBars();
 
   // Draw messages.
-  double cur_time = glfwGetTime();
+  double cur_time = GetTime();
   int num_msgs = configs->messages.size();
   for (int i = num_msgs-1, y = 0; i >= num_msgs - 5 && i >= 0; i--, y += 20) {
     const string& msg = get<0>(configs->messages[i]);
@@ -1878,11 +1954,11 @@ void Renderer::DrawMap() {
   const Animation& animation = mesh->animations[obj->active_animation];
   float d = resources_->GetDeltaTime() / 0.016666f;
   obj->frame += 1.0f * d * animation_speed;
-  if (obj->frame >= animation.keyframes.size()) {
+  if (obj->frame >= GetNumFrames(animation)) {
     if (obj->GetRepeatAnimation()) {
       obj->frame = 0;
     } else {
-      obj->frame = animation.keyframes.size() - 1;
+      obj->frame = GetNumFrames(animation) - 1;
     }
   }
 
@@ -1951,63 +2027,78 @@ void Renderer::CreateParticleBuffers() {
 }
 
 void Renderer::UpdateParticleBuffers() {
-  vector<shared_ptr<Particle>>& particle_container = resources_->GetParticleContainer();
-  for (int i = 0; i < kMaxParticles; i++) {
-    shared_ptr<Particle> p = particle_container[i];
-    if (!p->particle_type || p->life < 0) {
-      p->camera_distance = -1;
-      continue;
-    }
-    if (p->particle_type->behavior == PARTICLE_FIXED) {
-      p->camera_distance = 0;
-      continue;
-    }
-    p->camera_distance = length2(p->position - camera_.position);
-  }
-  std::sort(particle_container.begin(), particle_container.end());
-
   for (auto& [name, prd] : particle_render_data_) {
-    prd.count = 0;
+    prd.instances.clear();
   }
 
+  vector<shared_ptr<Particle>>& particle_container = resources_->GetParticleContainer();
   for (int i = 0; i < kMaxParticles; i++) {
     shared_ptr<Particle> p = particle_container[i];
     if (p->life < 0 || !p->particle_type) continue;
 
-    vec2 uv;
+    ParticleInstance instance;
     int index = p->frame + p->particle_type->first_frame;
 
     float tile_size = 1.0f / float(p->particle_type->grid_size);
-    uv.x = int(index % p->particle_type->grid_size) * tile_size + tile_size / 2;
-    uv.y = (p->particle_type->grid_size - int(index / p->particle_type->grid_size) - 1) * tile_size 
+    instance.uv.x = int(index % p->particle_type->grid_size) * tile_size + tile_size / 2;
+    instance.uv.y = (p->particle_type->grid_size - int(index / p->particle_type->grid_size) - 1) * tile_size 
       + tile_size / 2;
-
-    ParticleRenderData& prd = particle_render_data_[p->particle_type->name];
-    prd.particle_positions[prd.count] = vec4(p->position, p->size);
-    prd.particle_colors[prd.count] = p->color;
-    prd.particle_uvs[prd.count] = uv;
-    prd.count++;
+    instance.position = vec4(p->position, p->size);
+    instance.color = p->color;
+    instance.camera_distance = length2(p->position - camera_.position);
+    particle_render_data_[p->particle_type->name].instances.push_back(
+      instance);
+  }
+
+  // Effect particles are copied straight from the particle system arrays.
+  ParticleSystem& particle_system = resources_->GetParticleSystem();
+  particle_system.GetInstances(camera_.position, particle_system_instances_);
+  for (int type = 0; type < particle_system_instances_.size(); type++) {
+    vector<ParticleInstance>& instances = particle_system_instances_[type];
+    auto it = particle_render_data_.find(particle_system.GetTypeName(type));
+    if (it != particle_render_data_.end()) {
+      it->second.instances.insert(it->second.instances.end(), 
+        instances.begin(), instances.end());
+    }
+    instances.clear();
   }
 
   for (auto& [name, prd] : particle_render_data_) {
+    // Fixed particles are drawn in screen space, their order doesn't matter.
+    if (prd.type->behavior != PARTICLE_FIXED) {
+      SortParticleInstances(prd.instances);
+    }
+
+    prd.count = prd.instances.size();
+    prd.particle_positions.resize(prd.count);
+    prd.particle_colors.resize(prd.count);
+    prd.particle_uvs.resize(prd.count);
+    for (int i = 0; i < prd.count; i++) {
+      prd.particle_positions[i] = prd.instances[i].position;
+      prd.particle_colors[i] = prd.instances[i].color;
+      prd.particle_uvs[i] = prd.instances[i].uv;
+    }
+
+    while (prd.buffer_size < prd.count) prd.buffer_size *= 2;
+
     // Buffer orphaning.
     glBindBuffer(GL_ARRAY_BUFFER, prd.position_buffer);
-    glBufferData(GL_ARRAY_BUFFER, kMaxParticles * sizeof(vec4), NULL, 
+    glBufferData(GL_ARRAY_BUFFER, prd.buffer_size * sizeof(vec4), NULL, 
       GL_STREAM_DRAW); 
     glBufferSubData(GL_ARRAY_BUFFER, 0, prd.count * sizeof(vec4), 
-      &prd.particle_positions[0]);
+      prd.particle_positions.data());
     
     glBindBuffer(GL_ARRAY_BUFFER, prd.color_buffer);
-    glBufferData(GL_ARRAY_BUFFER, kMaxParticles * sizeof(vec4), NULL, 
+    glBufferData(GL_ARRAY_BUFFER, prd.buffer_size * sizeof(vec4), NULL, 
       GL_STREAM_DRAW); 
     glBufferSubData(GL_ARRAY_BUFFER, 0, prd.count * sizeof(vec4), 
-      &prd.particle_colors[0]);
+      prd.particle_colors.data());
 
     glBindBuffer(GL_ARRAY_BUFFER, prd.uv_buffer);
-    glBufferData(GL_ARRAY_BUFFER, kMaxParticles * sizeof(vec2), NULL, 
+    glBufferData(GL_ARRAY_BUFFER, prd.buffer_size * sizeof(vec2), NULL, 
       GL_STREAM_DRAW); 
     glBufferSubData(GL_ARRAY_BUFFER, 0, prd.count * sizeof(vec2), 
-      &prd.particle_uvs[0]);
+      prd.particle_uvs.data());
   }
 }
 
@@ -2062,43 +2153,10 @@ void Renderer::DrawParticles() {
   glBindVertexArray(0);
 }
 
-void Renderer::FindVisibleObjectsAsync() {
-  while (!terminate_) {
-    find_mutex_.lock();
-    if (find_tasks_.empty()) {
-      find_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(1));
-      continue;
-    }
-
-    shared_ptr<OctreeNode> node = find_tasks_.front();
-    find_tasks_.pop();
-    running_tasks_++;
-    find_mutex_.unlock();
-
-    GetVisibleObjects(node);
-
-    find_mutex_.lock();
-    running_tasks_--;
-    find_mutex_.unlock();
-  }
-}
-
-void Renderer::CreateThreads() {
-  for (int i = 0; i < kMaxThreads; i++) {
-    // find_threads_.push_back(thread(&Renderer::FindVisibleObjectsAsync, this));
-  }
-}
-
 // void Renderer::UpdateDungeonBufferMatrices() {
 // }
 
-void Renderer::CreateDungeonBuffers() {
-  double start_time = glfwGetTime();
-
-  // vector<char> instanced_tiles { ' ', '+', '|', ')', 'o', '(', 'd', 'g', 'P', 'c', 's', 'R' };
-  vector<char> instanced_tiles { ' ', '+', '|', ')', 'o', '(', 'd', 'g', 'P', 'c', 's' };
-
+void Renderer::LoadDungeonTileMeshes() {
   vector<string> model_names { 
     "resources/models_fbx/dungeon_floor.fbx", 
     "resources/models_fbx/dungeon_corner.fbx", 
@@ -2163,233 +2221,281 @@ void Renderer::CreateDungeonBuffers() {
     "metal_roughness",
   };
 
-  Dungeon& dungeon = resources_->GetDungeon();
+  // Tiles that share a model file share its data.
+  unordered_map<string, FbxData> models;
+  for (size_t i = 0; i < kDungeonTiles.size(); i++) {
+    char tile = kDungeonTiles[i];
+    if (models.find(model_names[i]) == models.end()) {
+      FbxLoad(model_names[i], models[model_names[i]]);
+    }
+    const FbxData& data = models[model_names[i]];
+
+    // Walls occlude with a box a bit smaller than their mesh, so
+    // decorations that stick out of the wall don't hide anything.
+    if (tile == '|' && !data.raw_mesh.vertices.empty()) {
+      vec3 min_v = data.raw_mesh.vertices[0];
+      vec3 max_v = data.raw_mesh.vertices[0];
+      for (const vec3& v : data.raw_mesh.vertices) {
+        min_v = glm::min(min_v, v);
+        max_v = glm::max(max_v, v);
+      }
+      vec3 center = (min_v + max_v) * 0.5f;
+      vec3 half_dimensions = (max_v - min_v) * 0.5f * kWallOccluderScale;
+      dungeon_wall_min_ = center - half_dimensions;
+      dungeon_wall_max_ = center + half_dimensions;
+    }
+
+    DungeonTileMesh& tile_mesh = dungeon_tile_meshes_[tile];
+    tile_mesh.texture = resources_->GetTextureByName(texture_names[i]);
+    tile_mesh.normal_texture = 
+      resources_->GetTextureByName(normal_texture_names[i]);
+    tile_mesh.specular_texture = 
+      resources_->GetTextureByName(specular_texture_names[i]);
+
+    vector<vec3> vertices;
+    vector<unsigned int> indices;
+    for (int i = 0; i < data.raw_mesh.indices.size(); i++) {
+      vertices.push_back(data.raw_mesh.vertices[data.raw_mesh.indices[i]]);
+      indices.push_back(i);
+    }
+    tile_mesh.num_indices = indices.size();
+
+    vector<vec3> tangents(vertices.size());
+    vector<vec3> bitangents(vertices.size());
+    for (int i = 0; i + 2 < vertices.size(); i += 3) {
+      vec3 delta_pos1 = vertices[i+1] - vertices[i+0];
+      vec3 delta_pos2 = vertices[i+2] - vertices[i+0];
+      vec2 delta_uv1 = data.raw_mesh.uvs[i+1] - data.raw_mesh.uvs[i+0];
+      vec2 delta_uv2 = data.raw_mesh.uvs[i+2] - data.raw_mesh.uvs[i+0];
+
+      float r = 1.0f / (delta_uv1.x * delta_uv2.y - delta_uv1.y * delta_uv2.x);
+      vec3 tangent = (delta_pos1 * delta_uv2.y - delta_pos2 * delta_uv1.y) * r;
+      vec3 bitangent = (delta_pos2 * delta_uv1.x - delta_pos1 * delta_uv2.x) * r;
+      tangents[i+0] = tangent;
+      tangents[i+1] = tangent;
+      tangents[i+2] = tangent;
+      bitangents[i+0] = bitangent;
+      bitangents[i+1] = bitangent;
+      bitangents[i+2] = bitangent;
+    }
 
-  vector<FbxData> models;
-  vector<GLuint> textures;
-  vector<GLuint> normal_textures;
-  vector<GLuint> specular_textures;
-  for (int tile = 0; tile < instanced_tiles.size(); tile++) {
-    FbxData data;
-    FbxLoad(model_names[tile], data);
+    glGenBuffers(1, &tile_mesh.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, tile_mesh.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), 
+      vertices.data(), GL_STATIC_DRAW);
 
-    models.push_back(data);
+    glGenBuffers(1, &tile_mesh.uv_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, tile_mesh.uv_buffer);
+    glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.uvs.size() * sizeof(vec2), 
+      data.raw_mesh.uvs.data(), GL_STATIC_DRAW);
 
-    textures.push_back(resources_->GetTextureByName(texture_names[tile]));
-    normal_textures.push_back(resources_->GetTextureByName(normal_texture_names[tile]));
-    specular_textures.push_back(resources_->GetTextureByName(specular_texture_names[tile]));
+    glGenBuffers(1, &tile_mesh.normal_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, tile_mesh.normal_buffer);
+    glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.normals.size() * sizeof(vec3), 
+      data.raw_mesh.normals.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &tile_mesh.tangent_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, tile_mesh.tangent_buffer);
+    glBufferData(GL_ARRAY_BUFFER, tangents.size() * sizeof(vec3), 
+      tangents.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &tile_mesh.bitangent_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, tile_mesh.bitangent_buffer);
+    glBufferData(GL_ARRAY_BUFFER, bitangents.size() * sizeof(vec3), 
+      bitangents.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &tile_mesh.element_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tile_mesh.element_buffer); 
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, 
+      indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
   }
+}
 
-  for (int cx = 0; cx < kDungeonCells; cx++) {
-    for (int cz = 0; cz < kDungeonCells; cz++) {
-      for (int i = 0; i < instanced_tiles.size(); i++) {
-        char tile = instanced_tiles[i];
-
-        if (!created_dungeon_buffers) {
-          glGenBuffers(1, &dungeon_render_data[cx][cz].vbos[tile]);
-          glGenBuffers(1, &dungeon_render_data[cx][cz].uvs[tile]);
-          glGenBuffers(1, &dungeon_render_data[cx][cz].normals[tile]);
-          glGenBuffers(1, &dungeon_render_data[cx][cz].element_buffers[tile]);
-          glGenBuffers(1, &dungeon_render_data[cx][cz].matrix_buffers[tile]);
-          glGenBuffers(1, &dungeon_render_data[cx][cz].tangent_buffers[tile]);
-          glGenBuffers(1, &dungeon_render_data[cx][cz].bitangent_buffers[tile]);
+void Renderer::GetDungeonTileMatrices(int cx, int cz, char tile,
+  vector<mat4>& model_matrices) {
+  Dungeon& dungeon = resources_->GetDungeon();
+
+  model_matrices.clear();
+  float y = 0;
+
+  int start_x = 14 * cx;
+  int end_x = start_x + 14;
+  int start_z = 14 * cz;
+  int end_z = start_z + 14;
+  for (int x = start_x; x < end_x; x++) {
+    for (int z = start_z; z < end_z; z++) {
+      float room_x = 10.0f * x;
+      float room_z = 10.0f * z;
+      vec3 pos = kDungeonOffset + vec3(room_x, y, room_z);
+
+      // char ascii_code = dungeon.AsciiCode(x, z);
+      const DungeonTile& dungeon_tile = dungeon.GetTileAt(x, z);
+      char ascii_code = dungeon_tile.ascii_code;
+
+      if (tile == '|') {
+        if (ascii_code != '|' && ascii_code != '-') continue;
+      } else if (tile == ')') {
+        if (ascii_code != '|' && ascii_code != '-' &&
+            ascii_code != 'd' && ascii_code != 'D') continue;
+      } else if (tile == 'o' || tile == '(') {
+        if (ascii_code != 'o' && ascii_code != 'O' && 
+          ascii_code != 'g' && ascii_code != 'G') continue;
+      } else if (tile == 'd') {
+        if (ascii_code != 'd' && ascii_code != 'D') continue;
+      } else if (tile == 'g') {
+        if (ascii_code != 'g' && ascii_code != 'G') continue;
+      } else if (tile == 'P') {
+        if (ascii_code != 'p' && ascii_code != 'P') continue;
+      } else if (tile == ' ') {
+        if (ascii_code != ' ' && resources_->GetConfigs()->render_scene == "arena") {
+          continue;
         }
+      } else if (tile == 'c') {
+      } else if (tile == 's') {
+      } else if (tile == '+') {
+        if (ascii_code != '+' && ascii_code != '^' && 
+            ascii_code != '/') continue;
+      } else if (dungeon_tile.monsters_and_objs == 'R' && tile == 'R') {
+      } else {
+        if (ascii_code != tile) continue;
+      }
+     
+      mat4 ModelMatrix = translate(mat4(1.0), pos);
 
-        const FbxData& data = models[i];
-        dungeon_render_data[cx][cz].textures[tile] = textures[i];
-        dungeon_render_data[cx][cz].normal_textures[tile] = normal_textures[i];
-        dungeon_render_data[cx][cz].specular_textures[tile] = specular_textures[i];
+      // Rotate.
+      if (ascii_code == '-' || ascii_code == 'O' || 
+        ascii_code == 'D' || ascii_code == 'G') {
+        ModelMatrix *= rotate(mat4(1.0), 1.57f, vec3(0, 1, 0));
+      }
 
-        vector<vec3> vertices;
-        vector<unsigned int> indices;
-        for (int i = 0; i < data.raw_mesh.indices.size(); i++) {
-          vertices.push_back(data.raw_mesh.vertices[data.raw_mesh.indices[i]]);
-          indices.push_back(i);
+      if (tile == 'c') {  
+        if (ascii_code != '<' && ascii_code != '\'' && 
+          !dungeon.IsChamber(x, z)) { // Not upstairs. Draw ceiling.
+          // Create ceiling.
+          mat4 ModelMatrix = translate(mat4(1.0), pos + vec3(0, dungeon_tile.ceiling_height, 0));
+          // mat4 ModelMatrix = translate(mat4(1.0), pos + vec3(0, 40, 0));
+          model_matrices.push_back(ModelMatrix);
         }
-        dungeon_render_data[cx][cz].num_indices[tile] = indices.size();
-
-        vector<vec3> tangents(vertices.size());
-        vector<vec3> bitangents(vertices.size());
-        for (int i = 0; i < vertices.size(); i += 3) {
-          vec3 delta_pos1 = vertices[i+1] - vertices[i+0];
-          vec3 delta_pos2 = vertices[i+2] - vertices[i+0];
-          vec2 delta_uv1 = data.raw_mesh.uvs[i+1] - data.raw_mesh.uvs[i+0];
-          vec2 delta_uv2 = data.raw_mesh.uvs[i+2] - data.raw_mesh.uvs[i+0];
-
-          float r = 1.0f / (delta_uv1.x * delta_uv2.y - delta_uv1.y * delta_uv2.x);
-          vec3 tangent = (delta_pos1 * delta_uv2.y - delta_pos2 * delta_uv1.y) * r;
-          vec3 bitangent = (delta_pos2 * delta_uv1.x - delta_pos1 * delta_uv2.x) * r;
-          tangents[i+0] = tangent;
-          tangents[i+1] = tangent;
-          tangents[i+2] = tangent;
-          bitangents[i+0] = bitangent;
-          bitangents[i+1] = bitangent;
-          bitangents[i+2] = bitangent;
+      } else if (tile == ' ') { 
+        if (dungeon_tile.floor_type == 0) {
+          model_matrices.push_back(ModelMatrix);
         }
-
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].vbos[tile]);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vec3), 
-          &vertices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].uvs[tile]);
-        glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.uvs.size() * sizeof(vec2), 
-          &data.raw_mesh.uvs[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].normals[tile]);
-        glBufferData(GL_ARRAY_BUFFER, data.raw_mesh.normals.size() * sizeof(vec3), 
-          &data.raw_mesh.normals[0], GL_STATIC_DRAW);
-
-        vector<mat4> model_matrices;
-        float y = 0;
-
-        int start_x = 14 * cx;
-        int end_x = start_x + 14;
-        int start_z = 14 * cz;
-        int end_z = start_z + 14;
-        for (int x = start_x; x < end_x; x++) {
-          for (int z = start_z; z < end_z; z++) {
-            float room_x = 10.0f * x;
-            float room_z = 10.0f * z;
-            vec3 pos = kDungeonOffset + vec3(room_x, y, room_z);
-
-            // char ascii_code = dungeon.AsciiCode(x, z);
-            const DungeonTile& dungeon_tile = dungeon.GetTileAt(x, z);
-            char ascii_code = dungeon_tile.ascii_code;
-
-            if (tile == '|') {
-              if (ascii_code != '|' && ascii_code != '-') continue;
-            } else if (tile == ')') {
-              if (ascii_code != '|' && ascii_code != '-' &&
-                  ascii_code != 'd' && ascii_code != 'D') continue;
-            } else if (tile == 'o' || tile == '(') {
-              if (ascii_code != 'o' && ascii_code != 'O' && 
-                ascii_code != 'g' && ascii_code != 'G') continue;
-            } else if (tile == 'd') {
-              if (ascii_code != 'd' && ascii_code != 'D') continue;
-            } else if (tile == 'g') {
-              if (ascii_code != 'g' && ascii_code != 'G') continue;
-            } else if (tile == 'P') {
-              if (ascii_code != 'p' && ascii_code != 'P') continue;
-            } else if (tile == ' ') {
-              if (ascii_code != ' ' && resources_->GetConfigs()->render_scene == "arena") {
-                continue;
-              }
-            } else if (tile == 'c') {
-            } else if (tile == 's') {
-            } else if (tile == '+') {
-              if (ascii_code != '+' && ascii_code != '^' && 
-                  ascii_code != '/') continue;
-            } else if (dungeon_tile.monsters_and_objs == 'R' && tile == 'R') {
-            } else {
-              if (ascii_code != tile) continue;
-            }
-           
-            mat4 ModelMatrix = translate(mat4(1.0), pos);
-
-            // Rotate.
-            if (ascii_code == '-' || ascii_code == 'O' || 
-              ascii_code == 'D' || ascii_code == 'G') {
-              ModelMatrix *= rotate(mat4(1.0), 1.57f, vec3(0, 1, 0));
-            }
-
-            if (tile == 'c') {  
-              if (ascii_code != '<' && ascii_code != '\'' && 
-                !resources_->GetDungeon().IsChamber(x, z)) { // Not upstairs. Draw ceiling.
-                // Create ceiling.
-                mat4 ModelMatrix = translate(mat4(1.0), pos + vec3(0, dungeon_tile.ceiling_height, 0));
-                // mat4 ModelMatrix = translate(mat4(1.0), pos + vec3(0, 40, 0));
-                model_matrices.push_back(ModelMatrix);
-              }
-            } else if (tile == ' ') { 
-              if (dungeon_tile.floor_type == 0) {
-                model_matrices.push_back(ModelMatrix);
-              }
-            } else if (tile == 's') {  
-              if (dungeon_tile.floor_type == 1) {
-                model_matrices.push_back(ModelMatrix);
-              }
-            } else {
-              model_matrices.push_back(ModelMatrix);
-            }
-          }
+      } else if (tile == 's') {  
+        if (dungeon_tile.floor_type == 1) {
+          model_matrices.push_back(ModelMatrix);
         }
-        dungeon_render_data[cx][cz].num_objs[tile] = model_matrices.size();
-
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].matrix_buffers[tile]);
-        glBufferData(GL_ARRAY_BUFFER, model_matrices.size() * sizeof(mat4), 
-          &model_matrices[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].tangent_buffers[tile]);
-        glBufferData(GL_ARRAY_BUFFER, tangents.size() * sizeof(vec3), 
-          &tangents[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].bitangent_buffers[tile]);
-        glBufferData(GL_ARRAY_BUFFER, bitangents.size() * sizeof(vec3), 
-          &bitangents[0], GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dungeon_render_data[cx][cz].element_buffers[tile]); 
-        glBufferData(
-          GL_ELEMENT_ARRAY_BUFFER, 
-          indices.size() * sizeof(unsigned int), 
-          &indices[0], 
-          GL_STATIC_DRAW
-        );
+      } else {
+        model_matrices.push_back(ModelMatrix);
+      }
+    }
+  }
+}
 
-        glGenVertexArrays(1, &dungeon_render_data[cx][cz].vaos[tile]);
-        glBindVertexArray(dungeon_render_data[cx][cz].vaos[tile]);
+void Renderer::CreateDungeonBufferVao(int cx, int cz, char tile) {
+  const DungeonTileMesh& tile_mesh = dungeon_tile_meshes_[tile];
+  DungeonRenderData& render_data = dungeon_render_data[cx][cz];
+
+  glGenBuffers(1, &render_data.matrix_buffers[tile]);
+  glGenVertexArrays(1, &render_data.vaos[tile]);
+  glBindVertexArray(render_data.vaos[tile]);
+
+  BindBuffer(tile_mesh.vbo, 0, 3);
+  glVertexAttribDivisor(0, 0); // Always reuse the same vertices.
+  BindBuffer(tile_mesh.uv_buffer, 1, 2);
+  glVertexAttribDivisor(1, 0); // Always reuse the same vertices.
+  BindBuffer(tile_mesh.normal_buffer, 2, 3);
+  glVertexAttribDivisor(2, 0); // Always reuse the same vertices.
+
+  std::size_t vec4_size = sizeof(vec4);
+  glEnableVertexAttribArray(3); 
+  glBindBuffer(GL_ARRAY_BUFFER, render_data.matrix_buffers[tile]);
+  glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)0);
+  glVertexAttribDivisor(3, 1);
+  glEnableVertexAttribArray(4); 
+  glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)(1 * vec4_size));
+  glVertexAttribDivisor(4, 1);
+  glEnableVertexAttribArray(5); 
+  glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)(2 * vec4_size));
+  glVertexAttribDivisor(5, 1);
+  glEnableVertexAttribArray(6); 
+  glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)(3 * vec4_size));
+  glVertexAttribDivisor(6, 1);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tile_mesh.element_buffer);
+  glVertexAttribDivisor(7, 0); // Always reuse the same vertices.
+
+  BindBuffer(tile_mesh.tangent_buffer, 8, 3);
+  glVertexAttribDivisor(8, 0); // Always reuse the same vertices.
+
+  BindBuffer(tile_mesh.bitangent_buffer, 9, 3);
+  glVertexAttribDivisor(9, 0); // Always reuse the same vertices.
+
+  glBindVertexArray(0);
+  int num_slots = 8;
+  for (int slot = 0; slot < num_slots; slot++) {
+    glDisableVertexAttribArray(slot);
+  }
+}
 
-        BindBuffer(dungeon_render_data[cx][cz].vbos[tile], 0, 3);
-        glVertexAttribDivisor(0, 0); // Always reuse the same vertices.
-        BindBuffer(dungeon_render_data[cx][cz].uvs[tile], 1, 2);
-        glVertexAttribDivisor(1, 0); // Always reuse the same vertices.
-        BindBuffer(dungeon_render_data[cx][cz].normals[tile], 2, 3);
-        glVertexAttribDivisor(2, 0); // Always reuse the same vertices.
-
-        std::size_t vec4_size = sizeof(vec4);
-        glEnableVertexAttribArray(3); 
-        glBindBuffer(GL_ARRAY_BUFFER, dungeon_render_data[cx][cz].matrix_buffers[tile]);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)0);
-        glVertexAttribDivisor(3, 1);
-        glEnableVertexAttribArray(4); 
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)(1 * vec4_size));
-        glVertexAttribDivisor(4, 1);
-        glEnableVertexAttribArray(5); 
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)(2 * vec4_size));
-        glVertexAttribDivisor(5, 1);
-        glEnableVertexAttribArray(6); 
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4_size, (void*)(3 * vec4_size));
-        glVertexAttribDivisor(6, 1);
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, dungeon_render_data[cx][cz].element_buffers[tile]);
-        glVertexAttribDivisor(7, 0); // Always reuse the same vertices.
-
-        BindBuffer(dungeon_render_data[cx][cz].tangent_buffers[tile], 8, 3);
-        glVertexAttribDivisor(8, 0); // Always reuse the same vertices.
-
-        BindBuffer(dungeon_render_data[cx][cz].bitangent_buffers[tile], 9, 3);
-        glVertexAttribDivisor(9, 0); // Always reuse the same vertices.
+// Only the instance buffers whose matrices changed since the last call are
+// uploaded again, so opening a door or destroying a wall touches one or two
+// buffers instead of all of them.
+void Renderer::CreateDungeonBuffers() {
+  double start_time = GetTime();
 
-        glBindVertexArray(0);
-        int num_slots = 8;
-        for (int slot = 0; slot < num_slots; slot++) {
-          glDisableVertexAttribArray(slot);
+  if (dungeon_tile_meshes_.empty()) {
+    LoadDungeonTileMeshes();
+  }
+
+  int num_updated = 0;
+  vector<mat4> model_matrices;
+  for (int cx = 0; cx < kDungeonCells; cx++) {
+    for (int cz = 0; cz < kDungeonCells; cz++) {
+      DungeonRenderData& render_data = dungeon_render_data[cx][cz];
+      for (char tile : kDungeonTiles) {
+        bool created = render_data.vaos.find(tile) != render_data.vaos.end();
+        if (!created) {
+          CreateDungeonBufferVao(cx, cz, tile);
+        }
+
+        GetDungeonTileMatrices(cx, cz, tile, model_matrices);
+        vector<mat4>& uploaded = render_data.model_matrices[tile];
+        if (created && model_matrices.size() == uploaded.size() &&
+          std::equal(model_matrices.begin(), model_matrices.end(), 
+          uploaded.begin())) {
+          continue;
         }
+
+        uploaded = model_matrices;
+        render_data.num_objs[tile] = uploaded.size();
+        glBindBuffer(GL_ARRAY_BUFFER, render_data.matrix_buffers[tile]);
+        glBufferData(GL_ARRAY_BUFFER, uploaded.size() * sizeof(mat4), 
+          uploaded.data(), GL_STATIC_DRAW);
+        num_updated++;
       }
     }
   }
-  created_dungeon_buffers = true;
-
-  double elapsed_time = glfwGetTime() - start_time;
-  cout << "CreateDungeonBuffers took " << elapsed_time << " seconds" << endl;
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  double elapsed_time = GetTime() - start_time;
+  dungeon_buffer_metrics_.num_rebuilds++;
+  dungeon_buffer_metrics_.num_buffers_updated = num_updated;
+  dungeon_buffer_metrics_.num_buffers = 
+    kDungeonCells * kDungeonCells * kDungeonTiles.size();
+  dungeon_buffer_metrics_.last_rebuild_time = elapsed_time;
+  dungeon_buffer_metrics_.total_rebuild_time += elapsed_time;
+  cout << "CreateDungeonBuffers took " << elapsed_time << " seconds (" 
+    << num_updated << " of " << dungeon_buffer_metrics_.num_buffers 
+    << " instance buffers updated)" << endl;
 }
 
 void Renderer::DrawDungeonTiles() {
+  if (dungeon_tile_meshes_.empty()) return;
+
   shared_ptr<Configs> configs = resources_->GetConfigs();
   Dungeon& dungeon = resources_->GetDungeon();
 
   int num_culled = 0;
-  // vector<char> instanced_tiles { ' ', '+', '|', ')', 'o', '(', 'd', 'g', 'P', 'c', 's', 'R' };
-  vector<char> instanced_tiles { ' ', '+', '|', ')', 'o', '(', 'd', 'g', 'P', 'c', 's' };
   for (int cx = 0; cx < kDungeonCells; cx++) {
     for (int cz = 0; cz < kDungeonCells; cz++) {
       float size = 140.0f;
@@ -2413,9 +2519,7 @@ void Renderer::DrawDungeonTiles() {
         continue;
       }
 
-      for (int i = 0; i < instanced_tiles.size(); i++) {
-        char tile = instanced_tiles[i];
-
+      for (char tile : kDungeonTiles) {
         if (tile == 'c' && resources_->GetConfigs()->render_scene == "arena") {
           continue;
         }
@@ -2423,19 +2527,20 @@ void Renderer::DrawDungeonTiles() {
         GLuint program_id = resources_->GetShader("dungeon");
         glUseProgram(program_id);
 
+        const DungeonTileMesh& tile_mesh = dungeon_tile_meshes_[tile];
         glBindVertexArray(dungeon_render_data[cx][cz].vaos[tile]);
         glDisable(GL_CULL_FACE);
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, dungeon_render_data[cx][cz].textures[tile]);
+        glBindTexture(GL_TEXTURE_2D, tile_mesh.texture);
         glUniform1i(GetUniformId(program_id, "texture_sampler"), 0);
 
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, dungeon_render_data[cx][cz].normal_textures[tile]);
+        glBindTexture(GL_TEXTURE_2D, tile_mesh.normal_texture);
         glUniform1i(GetUniformId(program_id, "bump_map_sampler"), 1);
 
         glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, dungeon_render_data[cx][cz].specular_textures[tile]);
+        glBindTexture(GL_TEXTURE_2D, tile_mesh.specular_texture);
         glUniform1i(GetUniformId(program_id, "specular_sampler"), 2);
 
         int draw_diffuse = boost::lexical_cast<int>(resources_->GetGameFlag("dungeon_draw_diffuse"));
@@ -2482,7 +2587,7 @@ void Renderer::DrawDungeonTiles() {
         glUniform1f(GetUniformId(program_id, "light_radius"), configs->light_radius);
 
         glDrawElementsInstanced(
-          GL_TRIANGLES, dungeon_render_data[cx][cz].num_indices[tile], 
+          GL_TRIANGLES, tile_mesh.num_indices, 
           GL_UNSIGNED_INT, 0, dungeon_render_data[cx][cz].num_objs[tile]
         );
         glBindVertexArray(0);
@@ -8,6 +8,10 @@
 #include "2d.hpp"
 #include "4d.hpp"
 #include "inventory.hpp"
+#include "render_queue.hpp"
+#include "visibility_culling.hpp"
+#include "occlusion_buffer.hpp"
+#include "portal_visibility.hpp"
 
 using namespace std;
 using namespace glm;
@@ -33,10 +37,14 @@ struct ParticleRenderData {
   GLuint color_buffer;
   GLuint uv_buffer;
 
+  // Game object and particle system particles, sorted far to near.
+  vector<ParticleInstance> instances;
+
   int count = 0;
-  vec4 particle_positions[kMaxParticles];
-  vec4 particle_colors[kMaxParticles];
-  vec2 particle_uvs[kMaxParticles];
+  int buffer_size = kMaxParticles;
+  vector<vec4> particle_positions;
+  vector<vec4> particle_colors;
+  vector<vec2> particle_uvs;
 };
 
 struct CascadedShadowMap {
@@ -45,21 +53,38 @@ struct CascadedShadowMap {
   BoundingSphere bounding_sphere = BoundingSphere(vec3(0.0), 100);
 };
 
+// Geometry and textures of a dungeon tile, loaded once and shared by the
+// instance buffers of all cells.
+struct DungeonTileMesh {
+  GLuint vbo = 0;
+  GLuint uv_buffer = 0;
+  GLuint normal_buffer = 0;
+  GLuint element_buffer = 0;
+  GLuint tangent_buffer = 0;
+  GLuint bitangent_buffer = 0;
+  GLuint texture = 0;
+  GLuint normal_texture = 0;
+  GLuint specular_texture = 0;
+  unsigned int num_indices = 0;
+};
+
 struct DungeonRenderData {
   unordered_map<char, GLuint> vaos;
-  unordered_map<char, GLuint> vbos;
-  unordered_map<char, GLuint> uvs;
-  unordered_map<char, GLuint> normals;
-  unordered_map<char, GLuint> element_buffers;
   unordered_map<char, GLuint> matrix_buffers;
-  unordered_map<char, GLuint> tangent_buffers;
-  unordered_map<char, GLuint> bitangent_buffers;
-  unordered_map<char, GLuint> textures;
-  unordered_map<char, GLuint> normal_textures;
-  unordered_map<char, GLuint> specular_textures;
-  unordered_map<char, unsigned int> num_indices;
   unordered_map<char, unsigned int> num_objs;
-  mat4 model_matrices[1024];
+
+  // Last uploaded instances, to skip the buffers that didn't change.
+  unordered_map<char, vector<mat4>> model_matrices;
+};
+
+struct DungeonBufferMetrics {
+  int num_rebuilds = 0;
+  int num_buffers = 0;
+
+  // Instance buffers uploaded by the last rebuild.
+  int num_buffers_updated = 0;
+  double last_rebuild_time = 0.0;
+  double total_rebuild_time = 0.0;
 };
 
 // struct WeaveRenderData {
@@ -97,7 +122,6 @@ class Renderer {
   vec3 terrain_clipping_point_;
   vec3 terrain_clipping_normal_;
   vec3 player_pos_;
-  bool created_dungeon_buffers = false;
   quat current_head_rotation_ = quat(0, 0, 0, 0);
 
   vector<GLuint> shadow_framebuffers_ { 0, 0, 0 };
@@ -105,16 +129,34 @@ class Renderer {
 
   float u_time_ = 0.0f;
 
-  // Parallelism. 
-  bool terminate_ = false;
-  const int kMaxThreads = 16;
-  vector<thread> find_threads_;
-  mutex find_mutex_;
-  queue<shared_ptr<OctreeNode>> find_tasks_;
-  int running_tasks_ = 0;
+  // Objects drawn with instancing, indexed by the render commands.
+  RenderQueue render_queue_;
+  vector<ObjPtr> render_queue_objects_;
+  vector<mat4> instance_matrices_;
+  GLuint instance_vbo_ = 0;
+
+  // Camera, shadow and light data shared by all programs.
+  shared_ptr<UniformBuffer> frame_uniforms_buffer_;
+  FrameUniforms frame_uniforms_;
+
+  VisibilityCuller visibility_culler_;
   vector<ObjPtr> visible_objects_;
 
+  // Software occlusion culling.
+  OcclusionBuffer occlusion_buffer_;
+  vec3 dungeon_wall_min_ = vec3(0);
+  vec3 dungeon_wall_max_ = vec3(0);
+  unordered_map<int, vector<vec3>> occluder_triangles_;
+
+  // Portal trees indexed by the id of the sector where the camera is. They
+  // are rebuilt when the sectors generation changes.
+  PortalVisibility portal_visibility_;
+  unordered_map<int, shared_ptr<PortalNode>> portal_trees_;
+  int portal_trees_generation_ = -1;
+
+  unordered_map<char, DungeonTileMesh> dungeon_tile_meshes_;
   DungeonRenderData dungeon_render_data[kDungeonCells][kDungeonCells];
+  DungeonBufferMetrics dungeon_buffer_metrics_;
 
   // http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-16-shadow-mapping/
   // https://devansh.space/cascaded-shadow-maps
@@ -123,24 +165,36 @@ class Renderer {
   // Particles code.
   GLuint particle_vbo_;
   unordered_map<string, ParticleRenderData> particle_render_data_;
+  vector<vector<ParticleInstance>> particle_system_instances_;
 
   void CreateParticleBuffers();
+  void UpdateFrameUniforms();
+  shared_ptr<Mesh> GetLodMesh(ObjPtr obj, shared_ptr<GameAsset> asset);
+  mat4 GetModelMatrix(ObjPtr obj, shared_ptr<GameAsset> asset);
+  bool CanInstance(ObjPtr obj, int mode);
+  void QueueObject(ObjPtr obj);
+  void DrawRenderQueue();
   void UpdateParticleBuffers();
   void DrawParticles();
 
+  void LoadDungeonTileMeshes();
+  void GetDungeonTileMatrices(int cx, int cz, char tile,
+    vector<mat4>& model_matrices);
+  void CreateDungeonBufferVao(int cx, int cz, char tile);
   void CreateDungeonBuffers();
   void DrawDungeonTiles();
 
-  bool CullObject(shared_ptr<GameObject> obj, 
-    const vector<vector<Polygon>>& occluder_convex_hulls);
   void DrawObjectShadow(ObjPtr obj, int level);
   void Draw3dParticle(shared_ptr<Particle> obj);
   void DrawFire(ObjPtr obj, shared_ptr<Mesh> mesh, GLuint program_id, GLuint texture_id);
   void DrawObject(ObjPtr obj, int mode = 0);
 
-  void GetVisibleObjects(shared_ptr<OctreeNode> octree_node);
   vector<shared_ptr<GameObject>> 
-    GetVisibleObjectsFromSector(shared_ptr<Sector> sector);
+    GetVisibleObjectsFromSector(shared_ptr<Sector> sector,
+    vec4 frustum_planes[6], const vec3& origin, bool camera_view);
+  void AddDungeonOccluders();
+  const vector<vec3>& GetOccluderTriangles(shared_ptr<GameAsset> asset);
+  vector<ObjPtr> CullOccludedObjects(const vector<ObjPtr>& objs);
 
   // TODO: move.
   shared_ptr<GameObject> CreateMeshFromConvexHull(const ConvexHull& ch);
@@ -161,19 +215,22 @@ class Renderer {
   vector<ObjPtr> GetVisibleObjectsInCaves(
     shared_ptr<StabbingTreeNode> stabbing_tree_node, vec4 frustum_planes[6]);
   vector<ObjPtr> GetVisibleObjectsInSector(
-    shared_ptr<Sector> sector, vec4 frustum_planes[6]);
-  vector<ObjPtr> GetVisibleObjectsInPortal(shared_ptr<Portal> p, 
-    shared_ptr<StabbingTreeNode> node, vec4 frustum_planes[6]);
-  vector<ObjPtr> GetVisibleObjectsInStabbingTreeNode(
-    shared_ptr<StabbingTreeNode> stabbing_tree_node, vec4 frustum_planes[6]);
-  vector<ObjPtr> GetVisibleObjects(vec4 frustum_planes[6]);
+    shared_ptr<Sector> sector, vec4 frustum_planes[6], const vec3& origin,
+    bool camera_view);
+  shared_ptr<PortalNode> BuildPortalTree(
+    shared_ptr<StabbingTreeNode> stabbing_tree_node);
+  shared_ptr<PortalNode> GetPortalTree(shared_ptr<Sector> sector);
+
+  // MVP is the view projection matrix times a translation to origin. The
+  // shadow pass passes camera_view = false to skip occlusion culling, which
+  // only works from the camera.
+  vector<ObjPtr> GetVisibleObjects(const mat4& MVP, const vec3& origin,
+    bool camera_view = true);
 
   // DrawObjects.
   void DrawOutside();
   void DrawObjects(vector<ObjPtr> objs, int mode = 0);
   void DrawHand();
-  void FindVisibleObjectsAsync();
-  void CreateThreads();
   vector<mat4> GetJointTransforms(ObjPtr obj, MeshPtr mesh);
   vector<mat4> GetJointTransformsForMerchant();
 
@@ -191,6 +248,19 @@ class Renderer {
   shared_ptr<Terrain> terrain() { return terrain_; }
   void DrawMap();
   void DrawScreenEffects();
+
+  const CullMetrics& GetCullMetrics() {
+    return visibility_culler_.GetMetrics();
+  }
+  const OcclusionMetrics& GetOcclusionMetrics() {
+    return occlusion_buffer_.GetMetrics();
+  }
+  const PortalMetrics& GetPortalMetrics() {
+    return portal_visibility_.GetMetrics();
+  }
+  const DungeonBufferMetrics& GetDungeonBufferMetrics() {
+    return dungeon_buffer_metrics_;
+  }
 };
 
 #endif
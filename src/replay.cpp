@@ -0,0 +1,259 @@
+#include "replay.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+const char kReplayMagic[4] = { 'W', 'Z', 'R', 'P' };
+
+// Every key the game polls. Keys outside this list read as released while a
+// replay is active.
+const int kReplayKeys[] = {
+  GLFW_KEY_0, GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4, GLFW_KEY_5,
+  GLFW_KEY_6, GLFW_KEY_7, GLFW_KEY_8, GLFW_KEY_9,
+  GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_E, GLFW_KEY_F, GLFW_KEY_G, GLFW_KEY_H,
+  GLFW_KEY_I, GLFW_KEY_M, GLFW_KEY_N, GLFW_KEY_O, GLFW_KEY_P, GLFW_KEY_Q,
+  GLFW_KEY_R, GLFW_KEY_S, GLFW_KEY_V, GLFW_KEY_W, GLFW_KEY_X, GLFW_KEY_Y,
+  GLFW_KEY_Z,
+  GLFW_KEY_SPACE, GLFW_KEY_TAB, GLFW_KEY_ENTER, GLFW_KEY_ESCAPE,
+  GLFW_KEY_LEFT_SHIFT, GLFW_KEY_RIGHT_SHIFT, GLFW_KEY_LEFT_ALT,
+  GLFW_KEY_LEFT_BRACKET, GLFW_KEY_RIGHT_BRACKET
+};
+const int kNumReplayKeys = sizeof(kReplayKeys) / sizeof(int);
+
+const uint8_t kButtonLeft = 1;
+const uint8_t kButtonRight = 2;
+const uint8_t kButtonFocused = 4;
+
+shared_ptr<Replay> gReplay = nullptr;
+
+double WallTime() {
+  return chrono::duration<double>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template<typename T>
+void Write(fstream& file, const T& value) {
+  file.write((const char*) &value, sizeof(T));
+}
+
+template<typename T>
+bool Read(fstream& file, T& value) {
+  file.read((char*) &value, sizeof(T));
+  return file.gcount() == sizeof(T);
+}
+
+} // namespace
+
+Replay::Replay(ReplayMode mode, const string& filename, unsigned int seed,
+  double step) : mode_(mode), seed_(seed) {
+  if (mode_ == REPLAY_RECORD) {
+    file_.open(filename, ios::out | ios::binary | ios::trunc);
+    if (!file_.is_open()) {
+      throw runtime_error(string("Could not open replay file: ") + filename);
+    }
+    WriteHeader(step);
+  } else {
+    file_.open(filename, ios::in | ios::binary);
+    if (!file_.is_open()) {
+      throw runtime_error(string("Could not open replay file: ") + filename);
+    }
+    if (!ReadHeader(step)) {
+      throw runtime_error(string("Invalid replay file: ") + filename);
+    }
+  }
+  clock_ = make_shared<FixedStepClock>(step);
+}
+
+Replay::~Replay() {
+  file_.close();
+}
+
+void Replay::WriteHeader(double step) {
+  file_.write(kReplayMagic, 4);
+  Write(file_, (uint32_t) kReplayVersion);
+  Write(file_, (uint32_t) seed_);
+  Write(file_, step);
+}
+
+bool Replay::ReadHeader(double& step) {
+  char magic[4];
+  file_.read(magic, 4);
+  if (file_.gcount() != 4) return false;
+  for (int i = 0; i < 4; i++) {
+    if (magic[i] != kReplayMagic[i]) return false;
+  }
+
+  uint32_t version, seed;
+  if (!Read(file_, version) || version != kReplayVersion) return false;
+  if (!Read(file_, seed)) return false;
+  if (!Read(file_, step)) return false;
+  seed_ = seed;
+  return true;
+}
+
+void Replay::SetHashesFile(const string& filename) {
+  hashes_file_.open(filename);
+}
+
+void Replay::CaptureFrame(GLFWwindow* window) {
+  frame_ = InputFrame();
+  for (int i = 0; i < kNumReplayKeys; i++) {
+    if (glfwGetKey(window, kReplayKeys[i]) == GLFW_PRESS) {
+      frame_.keys |= (uint64_t(1) << i);
+    }
+  }
+
+  if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+    frame_.buttons |= kButtonLeft;
+  }
+  if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
+    frame_.buttons |= kButtonRight;
+  }
+  if (glfwGetWindowAttrib(window, GLFW_FOCUSED)) {
+    frame_.buttons |= kButtonFocused;
+  }
+
+  double x_pos, y_pos;
+  glfwGetCursorPos(window, &x_pos, &y_pos);
+  frame_.cursor_x = x_pos;
+  frame_.cursor_y = y_pos;
+}
+
+bool Replay::ReadFrame() {
+  InputFrame frame;
+  if (!Read(file_, frame.keys)) return false;
+  if (!Read(file_, frame.buttons)) return false;
+  if (!Read(file_, frame.cursor_x)) return false;
+  if (!Read(file_, frame.cursor_y)) return false;
+  if (!Read(file_, recorded_hash_)) return false;
+  frame_ = frame;
+  return true;
+}
+
+bool Replay::BeginFrame(GLFWwindow* window) {
+  if (mode_ == REPLAY_RECORD) {
+    CaptureFrame(window);
+  } else if (!ReadFrame()) {
+    return false;
+  }
+
+  captured_frame_ = frame_;
+  clock_->Tick();
+  frame_start_ = WallTime();
+  return true;
+}
+
+void Replay::EndFrame(uint64_t state_hash) {
+  double frame_time = WallTime() - frame_start_;
+  total_frame_time_ += frame_time;
+
+  if (mode_ == REPLAY_RECORD) {
+    Write(file_, captured_frame_.keys);
+    Write(file_, captured_frame_.buttons);
+    Write(file_, captured_frame_.cursor_x);
+    Write(file_, captured_frame_.cursor_y);
+    Write(file_, state_hash);
+  } else {
+    if (state_hash != recorded_hash_ && first_desync_ == -1) {
+      first_desync_ = num_frames_;
+      cout << "Replay desync at frame " << num_frames_ << endl;
+    }
+
+    if (hashes_file_.is_open()) {
+      hashes_file_ << num_frames_ << " " << hex << state_hash << dec << " "
+        << frame_time * 1000.0 << endl;
+    }
+  }
+  num_frames_++;
+}
+
+void Replay::PrintSummary() {
+  cout << "Replay frames: " << num_frames_ << endl;
+  if (num_frames_ > 0) {
+    cout << "Replay average: " << 1000.0 * total_frame_time_ / num_frames_
+      << " ms / frame" << endl;
+  }
+
+  if (mode_ == REPLAY_PLAYBACK) {
+    if (first_desync_ == -1) {
+      cout << "Replay in sync" << endl;
+    } else {
+      cout << "Replay desynced at frame " << first_desync_ << endl;
+    }
+  }
+}
+
+int Replay::GetKey(int key) {
+  for (int i = 0; i < kNumReplayKeys; i++) {
+    if (kReplayKeys[i] != key) continue;
+    return (frame_.keys & (uint64_t(1) << i)) ? GLFW_PRESS : GLFW_RELEASE;
+  }
+  return GLFW_RELEASE;
+}
+
+int Replay::GetMouseButton(int button) {
+  switch (button) {
+    case GLFW_MOUSE_BUTTON_LEFT:
+      return (frame_.buttons & kButtonLeft) ? GLFW_PRESS : GLFW_RELEASE;
+    case GLFW_MOUSE_BUTTON_RIGHT:
+      return (frame_.buttons & kButtonRight) ? GLFW_PRESS : GLFW_RELEASE;
+    default:
+      return GLFW_RELEASE;
+  }
+}
+
+void Replay::GetCursorPos(double* x_pos, double* y_pos) {
+  *x_pos = frame_.cursor_x;
+  *y_pos = frame_.cursor_y;
+}
+
+void Replay::SetCursorPos(double x_pos, double y_pos) {
+  frame_.cursor_x = x_pos;
+  frame_.cursor_y = y_pos;
+}
+
+bool Replay::IsFocused() {
+  return frame_.buttons & kButtonFocused;
+}
+
+void SetReplay(shared_ptr<Replay> replay) {
+  gReplay = replay;
+}
+
+shared_ptr<Replay> GetReplay() {
+  return gReplay;
+}
+
+int GetInputKey(GLFWwindow* window, int key) {
+  if (gReplay) return gReplay->GetKey(key);
+  return glfwGetKey(window, key);
+}
+
+int GetInputMouseButton(GLFWwindow* window, int button) {
+  if (gReplay) return gReplay->GetMouseButton(button);
+  return glfwGetMouseButton(window, button);
+}
+
+void GetInputCursorPos(GLFWwindow* window, double* x_pos, double* y_pos) {
+  if (gReplay) {
+    gReplay->GetCursorPos(x_pos, y_pos);
+    return;
+  }
+  glfwGetCursorPos(window, x_pos, y_pos);
+}
+
+void SetInputCursorPos(GLFWwindow* window, double x_pos, double y_pos) {
+  if (gReplay) {
+    gReplay->SetCursorPos(x_pos, y_pos);
+    if (gReplay->GetMode() == REPLAY_PLAYBACK) return;
+  }
+  glfwSetCursorPos(window, x_pos, y_pos);
+}
+
+bool IsInputFocused(GLFWwindow* window) {
+  if (gReplay) return gReplay->IsFocused();
+  return glfwGetWindowAttrib(window, GLFW_FOCUSED);
+}
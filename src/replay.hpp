@@ -0,0 +1,91 @@
+#ifndef __REPLAY_HPP__
+#define __REPLAY_HPP__
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <GLFW/glfw3.h>
+#include "clock.hpp"
+
+using namespace std;
+
+const int kReplayVersion = 1;
+
+enum ReplayMode {
+  REPLAY_RECORD = 0,
+  REPLAY_PLAYBACK
+};
+
+// Player input for one frame. Keys are stored as a bitmask over
+// kReplayKeys.
+struct InputFrame {
+  uint64_t keys = 0;
+  uint8_t buttons = 0;
+  float cursor_x = 0.0f;
+  float cursor_y = 0.0f;
+};
+
+// Records the RNG seed, the timestep and the player input of every frame to
+// a binary log, or plays a log back. Each frame also stores a hash of the
+// game state after it ran, so a replay can report the first desync.
+//
+// Log layout: "WZRP", version (u32), seed (u32), step (f64), followed by
+// one record per frame: keys (u64), buttons (u8), cursor x, y (f32),
+// state hash (u64).
+class Replay {
+  ReplayMode mode_;
+  fstream file_;
+  ofstream hashes_file_;
+  unsigned int seed_ = 0;
+  shared_ptr<FixedStepClock> clock_;
+
+  InputFrame frame_;
+  InputFrame captured_frame_;
+  uint64_t recorded_hash_ = 0;
+  int num_frames_ = 0;
+  int first_desync_ = -1;
+  double frame_start_ = 0.0;
+  double total_frame_time_ = 0.0;
+
+  void WriteHeader(double step);
+  bool ReadHeader(double& step);
+  void CaptureFrame(GLFWwindow* window);
+  bool ReadFrame();
+
+ public:
+  Replay(ReplayMode mode, const string& filename, unsigned int seed = 0,
+    double step = 1.0 / 60.0);
+  ~Replay();
+
+  ReplayMode GetMode() { return mode_; }
+  unsigned int GetSeed() { return seed_; }
+  shared_ptr<FixedStepClock> GetClock() { return clock_; }
+
+  // Writes "frame hash frame_ms" lines for every replayed frame.
+  void SetHashesFile(const string& filename);
+
+  // Ticks the clock and captures (or reads back) the input for the next
+  // frame. Returns false when a replay runs out of frames.
+  bool BeginFrame(GLFWwindow* window);
+  void EndFrame(uint64_t state_hash);
+  void PrintSummary();
+
+  int GetKey(int key);
+  int GetMouseButton(int button);
+  void GetCursorPos(double* x_pos, double* y_pos);
+  void SetCursorPos(double x_pos, double y_pos);
+  bool IsFocused();
+};
+
+void SetReplay(shared_ptr<Replay> replay);
+shared_ptr<Replay> GetReplay();
+
+// Input functions used by the game instead of GLFW. They go straight to GLFW
+// unless a replay is recording or playing back.
+int GetInputKey(GLFWwindow* window, int key);
+int GetInputMouseButton(GLFWwindow* window, int button);
+void GetInputCursorPos(GLFWwindow* window, double* x_pos, double* y_pos);
+void SetInputCursorPos(GLFWwindow* window, double x_pos, double y_pos);
+bool IsInputFocused(GLFWwindow* window);
+
+#endif // __REPLAY_HPP__
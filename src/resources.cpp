@@ -1,25 +1,56 @@
 #include "resources.hpp"
 #include "debug.hpp"
+#include "compressed_animation.hpp"
+#include "texture_cache.hpp"
 #include <fstream>
 #include <boost/algorithm/string.hpp>
 
+namespace {
+
+// Interned once, these are looked up every frame.
+const Symbol kOutsideSector("outside");
+const Symbol kFallFloorCallback("fall_floor");
+const Symbol kRestoreFloorCallback("restore_floor");
+
+// Main thread time for uploads between progress reports while loading,
+// about one frame.
+const double kLoadingFrameBudget = 1.0 / 60.0;
+
+// XML files in the order of the directory iterator. Files in subdirectories
+// come where their subdirectory is found.
+void GetXmlFiles(const string& directory, bool recursive, 
+  vector<string>& xml_files) {
+  boost::filesystem::path p (directory);
+  boost::filesystem::directory_iterator end_itr;
+  for (boost::filesystem::directory_iterator itr(p); itr != end_itr; ++itr) {
+    if (!is_regular_file(itr->path())) {
+      if (recursive) GetXmlFiles(itr->path().string(), recursive, xml_files);
+      continue;
+    }
+
+    string current_file = itr->path().leaf().string();
+    if (!boost::ends_with(current_file, ".xml")) {
+      continue;
+    }
+    xml_files.push_back(directory + "/" + current_file);
+  }
+}
+
+} // namespace
+
 Resources::Resources(const string& resources_dir, 
   const string& shaders_dir, GLFWwindow* window) : directory_(resources_dir), 
   shaders_dir_(shaders_dir),
   resources_dir_(resources_dir),
-  height_map_(resources_dir + "/height_map.dat"),
-  configs_(make_shared<Configs>()), window_(window) {
+  height_map_(resources_dir + "/height_map.hmap"),
+  configs_(make_shared<Configs>()), window_(window),
+  job_system_(GetJobSystem()), texture_jobs_(make_shared<JobCounter>()) {
 
-  CreateThreads();
   Init();
 }
 
 Resources::~Resources() {
-  terminate_ = true;
-  for (int i = 0; i < kMaxThreads; i++) {
-    load_mesh_threads_[i].join();
-    load_asset_threads_[i].join();
-  }
+  job_system_->Wait(texture_jobs_);
 }
 
 void Resources::CreateOutsideSector() {
@@ -28,7 +59,9 @@ void Resources::CreateOutsideSector() {
   new_sector->octree_node = outside_octree_;
   new_sector->stabbing_tree = make_shared<StabbingTreeNode>(new_sector);
   sectors_[new_sector->name] = new_sector;
+  sectors_by_symbol_[Symbol(new_sector->name)] = new_sector;
   new_sector->id = id_counter_++;
+  sectors_generation_++;
 }
 
 void Resources::Init() {
@@ -47,10 +80,7 @@ void Resources::Init() {
 
   player_ = CreatePlayer(this);
 
-  LoadShaders(shaders_dir_);
-  LoadMeshes(directory_ + "/assets");
-  LoadTextures(directory_ + "/assets");
-  LoadAssets(directory_ + "/assets");
+  LoadResources(directory_ + "/assets");
 
   dungeon_.LoadLevelDataFromXml(directory_ + "/assets/dungeon.xml");
 
@@ -107,6 +137,7 @@ void Resources::LoadShaders(const std::string& directory) {
       if (shaders_.find(prefix) == shaders_.end()) {
         cout << prefix << endl;
         shaders_[prefix] = LoadShader(directory, prefix);
+        GetUniformCache().AddProgram(shaders_[prefix]);
       }
     }
   }
@@ -118,9 +149,7 @@ void Resources::LoadMeshesFromAssetFile(pugi::xml_node xml) {
     const string& fbx_filename = xml_mesh.text().get();
     string name = xml_mesh.attribute("name").value();
 
-    mesh_mutex_.lock();
     mesh_loading_tasks_.push({ name, fbx_filename });
-    mesh_mutex_.unlock();
   }
 
   for (pugi::xml_node asset_xml = xml.child("asset"); asset_xml; 
@@ -131,18 +160,14 @@ void Resources::LoadMeshesFromAssetFile(pugi::xml_node xml) {
       pugi::xml_node lod = mesh_xml.child(s.c_str());
       if (lod) {
         const string name = lod.text().get();
-        mesh_mutex_.lock();
         mesh_loading_tasks_.push({ name, "resources/models_fbx/" + name + ".fbx" });
-        mesh_mutex_.unlock(); 
       }
     }
 
     const pugi::xml_node& collision_hull_xml = asset_xml.child("collision-hull");
     if (collision_hull_xml) {
       const string name = collision_hull_xml.text().get();
-      mesh_mutex_.lock();
       mesh_loading_tasks_.push({ name, "resources/models_fbx/" + name + ".fbx" });
-      mesh_mutex_.unlock(); 
     }
 
     const pugi::xml_node& skeleton_xml = asset_xml.child("skeleton");
@@ -150,9 +175,7 @@ void Resources::LoadMeshesFromAssetFile(pugi::xml_node xml) {
       for (pugi::xml_node bone_xml = skeleton_xml.child("bone"); bone_xml; 
         bone_xml = bone_xml.next_sibling("bone")) {
         const string name = bone_xml.text().get();
-        mesh_mutex_.lock();
         mesh_loading_tasks_.push({ name, "resources/models_fbx/" + name + ".fbx" });
-        mesh_mutex_.unlock(); 
       }
     }
   }
@@ -167,18 +190,14 @@ void Resources::LoadMeshesFromAssetFile(pugi::xml_node xml) {
         pugi::xml_node lod = mesh_xml.child(s.c_str());
         if (lod) {
           const string name = lod.text().get();
-          mesh_mutex_.lock();
           mesh_loading_tasks_.push({ name, "resources/models_fbx/" + name + ".fbx" });
-          mesh_mutex_.unlock();
         }
       }
 
       const pugi::xml_node& collision_hull_xml = asset_xml.child("collision-hull");
       if (collision_hull_xml) {
         const string name = collision_hull_xml.text().get();
-        mesh_mutex_.lock();
         mesh_loading_tasks_.push({ name, "resources/models_fbx/" + name + ".fbx" });
-        mesh_mutex_.unlock(); 
       }
 
       const pugi::xml_node& skeleton_xml = asset_xml.child("skeleton");
@@ -186,9 +205,7 @@ void Resources::LoadMeshesFromAssetFile(pugi::xml_node xml) {
         for (pugi::xml_node bone_xml = skeleton_xml.child("bone"); bone_xml; 
           bone_xml = bone_xml.next_sibling("bone")) {
           const string name = bone_xml.text().get();
-          mesh_mutex_.lock();
           mesh_loading_tasks_.push({ name, "resources/models_fbx/" + name + ".fbx" });
-          mesh_mutex_.unlock(); 
         }
       }
     }
@@ -197,17 +214,68 @@ void Resources::LoadMeshesFromAssetFile(pugi::xml_node xml) {
   while (!mesh_loading_tasks_.empty()) {
     auto [name, fbx_filename] = mesh_loading_tasks_.front();
     mesh_loading_tasks_.pop();
+    LoadMesh(name, fbx_filename);
+  }
+}    
 
-    if (meshes_.find(name) != meshes_.end()) {
-      continue;
-    }
+void Resources::LoadMesh(const string& name, const string& fbx_filename) {
+  if (meshes_.find(name) != meshes_.end()) {
+    return;
+  }
 
+  if (!loading_pipeline_) {
+    // The cooked mesh is used when it is newer than the FBX.
     shared_ptr<Mesh> mesh = make_shared<Mesh>();
-    FbxData data;
-    LoadFbxData(fbx_filename, *mesh, data, false);
+    MeshData mesh_data;
+    if (LoadMeshCache(fbx_filename, mesh_data)) {
+      CreateMesh(mesh_data, *mesh);
+      num_cached_meshes_++;
+    } else {
+      FbxData data;
+      LoadFbxData(fbx_filename, *mesh, data, false);
+    }
     meshes_[name] = mesh;
+    meshes_by_symbol_[Symbol(name)] = mesh;
+    return;
   }
-}    
+
+  auto it = mesh_tasks_.find(name);
+  if (it != mesh_tasks_.end()) {
+    loading_dependencies_.push_back(it->second);
+    return;
+  }
+
+  shared_ptr<MeshData> mesh_data = make_shared<MeshData>();
+  shared_ptr<bool> cached = make_shared<bool>(false);
+  int decode = loading_pipeline_->AddTask(LOADING_DECODE, 
+    [this, fbx_filename, mesh_data, cached] () {
+    if (LoadMeshCache(fbx_filename, *mesh_data)) {
+      *cached = true;
+      return;
+    }
+
+    FbxData data;
+    data.name = fbx_filename;
+    {
+      // FBX imports are not thread safe.
+      lock_guard<mutex> lock(fbx_mutex_);
+      FbxLoad(fbx_filename, data);
+    }
+    BuildMeshData(data, *mesh_data);
+  });
+
+  int upload = loading_pipeline_->AddTask(LOADING_UPLOAD, 
+    [this, name, mesh_data, cached] () {
+    shared_ptr<Mesh> mesh = make_shared<Mesh>();
+    CreateMesh(*mesh_data, *mesh);
+    if (*cached) num_cached_meshes_++;
+    meshes_[name] = mesh;
+    meshes_by_symbol_[Symbol(name)] = mesh;
+  }, { decode });
+
+  mesh_tasks_[name] = upload;
+  loading_dependencies_.push_back(upload);
+}
 
 void Resources::LoadMeshesFromDir(const std::string& directory) {
   boost::filesystem::path p (directory);
@@ -238,15 +306,58 @@ void Resources::LoadMeshesFromDir(const std::string& directory) {
 
 // TODO: lazy loading.
 void Resources::LoadMeshes(const std::string& directory) {
-  double start_time = glfwGetTime();
+  double start_time = GetTime();
 
   LoadMeshesFromDir(directory);
 
-  double elapsed_time = glfwGetTime() - start_time;
-  cout << "Load meshes took " << elapsed_time << " seconds" << endl;
+  double elapsed_time = GetTime() - start_time;
+  cout << "Load meshes took " << elapsed_time << " seconds (" 
+    << num_cached_meshes_ << " from the mesh cache)" << endl;
+}
+
+void Resources::QueueTextureLoad(const string& texture_filename,
+  GLuint texture_id) {
+  if (!loading_pipeline_) {
+    job_system_->Run([this, texture_filename, texture_id] () {
+      LoadTextureAsync(texture_filename.c_str(), texture_id, window_);
+    }, texture_jobs_);
+    return;
+  }
+
+  // Assets list the same textures many times.
+  auto it = texture_tasks_.find(texture_id);
+  if (it != texture_tasks_.end()) {
+    loading_dependencies_.push_back(it->second);
+    return;
+  }
+
+  // The cooked texture is used when it was compressed from this image, and
+  // cooked again when the image changed.
+  shared_ptr<TextureImage> image = make_shared<TextureImage>();
+  shared_ptr<CompressedTexture> texture = make_shared<CompressedTexture>();
+  int decode = loading_pipeline_->AddTask(LOADING_DECODE, 
+    [texture_filename, image, texture] () {
+    if (LoadOrCookTextureCache(texture_filename, *texture)) return;
+    DecodeTexture(texture_filename.c_str(), *image);
+  });
+
+  int upload = loading_pipeline_->AddTask(LOADING_UPLOAD, 
+    [this, image, texture, texture_id] () {
+    if (!texture->levels.empty()) {
+      UploadCompressedTexture(*texture, texture_id);
+      num_cached_textures_++;
+      return;
+    }
+    if (image->pixels.empty()) return;
+    UploadTexture(*image, texture_id);
+  }, { decode });
+
+  texture_tasks_[texture_id] = upload;
+  loading_dependencies_.push_back(upload);
 }
 
 void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
+#ifndef HEADLESS
   for (pugi::xml_node xml_texture = xml.child("texture"); xml_texture; 
     xml_texture = xml_texture.next_sibling("texture")) {
     const string& texture_filename = xml_texture.text().get();
@@ -257,9 +368,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
       glGenTextures(1, &texture_id);
       AddTexture(name, texture_id);
       AddTexture(texture_filename, texture_id);
-      texture_mutex_.lock();
-      texture_loading_tasks_.push({ texture_filename });
-      texture_mutex_.unlock();
+      QueueTextureLoad(texture_filename, texture_id);
     }
   }
 
@@ -274,9 +383,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
         AddTexture(texture_filename, texture_id);
       }
 
-      texture_mutex_.lock();
-      texture_loading_tasks_.push({ texture_filename });
-      texture_mutex_.unlock();
+      QueueTextureLoad(texture_filename, texture_id);
     }
 
     // Normal map.
@@ -289,9 +396,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
         AddTexture(texture_filename, texture_id);
       }
 
-      texture_mutex_.lock();
-      texture_loading_tasks_.push({ texture_filename });
-      texture_mutex_.unlock();
+      QueueTextureLoad(texture_filename, texture_id);
     }
 
     // Specular.
@@ -304,9 +409,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
         AddTexture(texture_filename, texture_id);
       }
 
-      texture_mutex_.lock();
-      texture_loading_tasks_.push({ texture_filename });
-      texture_mutex_.unlock();
+      QueueTextureLoad(texture_filename, texture_id);
     }
   }
 
@@ -323,9 +426,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
           AddTexture(texture_filename, texture_id);
         }
 
-        texture_mutex_.lock();
-        texture_loading_tasks_.push({ texture_filename });
-        texture_mutex_.unlock();
+        QueueTextureLoad(texture_filename, texture_id);
       }
 
       // Normal map.
@@ -338,9 +439,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
           AddTexture(texture_filename, texture_id);
         }
 
-        texture_mutex_.lock();
-        texture_loading_tasks_.push({ texture_filename });
-        texture_mutex_.unlock();
+        QueueTextureLoad(texture_filename, texture_id);
       }
 
       // Specular.
@@ -353,9 +452,7 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
           AddTexture(texture_filename, texture_id);
         }
 
-        texture_mutex_.lock();
-        texture_loading_tasks_.push({ texture_filename });
-        texture_mutex_.unlock();
+        QueueTextureLoad(texture_filename, texture_id);
       }
     }
   }
@@ -380,10 +477,9 @@ void Resources::LoadTexturesFromAssetFile(pugi::xml_node xml) {
       AddTexture(texture_filename, texture_id);
     }
 
-    texture_mutex_.lock();
-    texture_loading_tasks_.push({ texture_filename });
-    texture_mutex_.unlock();
+    QueueTextureLoad(texture_filename, texture_id);
   }
+#endif
 }    
 
 void Resources::LoadTexturesFromDir(const std::string& directory) {
@@ -414,17 +510,16 @@ void Resources::LoadTexturesFromDir(const std::string& directory) {
 }
 
 void Resources::LoadTextures(const std::string& directory) {
-  double start_time = glfwGetTime();
+  double start_time = GetTime();
 
   LoadTexturesFromDir(directory);
 
-  // Async.
-  while (!texture_loading_tasks_.empty() || running_texture_loading_tasks_ > 0) {
-    this_thread::sleep_for(chrono::microseconds(200));
-  }
+  job_system_->Wait(texture_jobs_);
+#ifndef HEADLESS
   glfwMakeContextCurrent(window_);
+#endif
 
-  double elapsed_time = glfwGetTime() - start_time;
+  double elapsed_time = GetTime() - start_time;
   cout << "Load textures took " << elapsed_time << " seconds" << endl;
 }
 
@@ -522,21 +617,19 @@ void Resources::LoadAssetFile(const std::string& xml_filename) {
   }
 
   cout << "Loading asset: " << xml_filename << endl;
-  const pugi::xml_node& xml = doc.child("xml");
+  LoadAssetXml(doc.child("xml"));
+}
 
+void Resources::LoadAssetXml(const pugi::xml_node& xml) {
   // No need for this to be async.
   for (pugi::xml_node asset_xml = xml.child("asset"); asset_xml; 
     asset_xml = asset_xml.next_sibling("asset")) {
-    asset_mutex_.lock();
     asset_loading_tasks_.push(asset_xml);
-    asset_mutex_.unlock();
   }
 
   for (pugi::xml_node asset_group_xml = xml.child("asset-group"); asset_group_xml; 
     asset_group_xml = asset_group_xml.next_sibling("asset-group")) {
-    asset_mutex_.lock();
     asset_loading_tasks_.push(asset_group_xml);
-    asset_mutex_.unlock();
   }
 
   while (!asset_loading_tasks_.empty()) {
@@ -787,7 +880,7 @@ void Resources::LoadSpell(const pugi::xml_node& spell_xml) {
 }
 
 void Resources::LoadAssets(const std::string& directory) {
-  double start_time = glfwGetTime();
+  double start_time = GetTime();
 
   boost::filesystem::path p (directory);
   boost::filesystem::directory_iterator end_itr;
@@ -800,10 +893,111 @@ void Resources::LoadAssets(const std::string& directory) {
     LoadAssetFile(directory + "/" + current_file);
   }
 
-  double elapsed_time = glfwGetTime() - start_time;
+  double elapsed_time = GetTime() - start_time;
   cout << "Load assets took " << elapsed_time << " seconds" << endl;
 }
 
+// Same as LoadShaders, LoadMeshes, LoadTextures and LoadAssets in a row, as
+// a graph of loading tasks. XML files, meshes and textures are read and
+// decoded on the workers while the uploads run here. Assets can use meshes
+// and textures listed in any file, so the first asset file waits on every
+// upload, and each asset file waits on the one before it, so assets are
+// created in the same order as in LoadAssets.
+void Resources::LoadResources(const string& directory) {
+  double start_time = GetTime();
+
+  vector<string> xml_files;
+  GetXmlFiles(directory, true, xml_files);
+
+  // Only the files at the top of the directory have assets.
+  vector<string> asset_files;
+  GetXmlFiles(directory, false, asset_files);
+  unordered_set<string> is_asset_file(asset_files.begin(), asset_files.end());
+
+  loading_pipeline_ = make_shared<LoadingPipeline>(job_system_);
+  LoadingPipeline& pipeline = *loading_pipeline_;
+
+  // Assets look up their shaders, so scheduling waits on the shaders as well
+  // as on the parsed files.
+  vector<int> scheduling_dependencies;
+#ifndef HEADLESS
+  scheduling_dependencies.push_back(pipeline.AddTask(LOADING_UPLOAD, [this] () {
+    LoadShaders(shaders_dir_);
+  }));
+#endif
+
+  vector<shared_ptr<pugi::xml_document>> docs;
+  for (const string& xml_filename : xml_files) {
+    shared_ptr<string> contents = make_shared<string>();
+    int read = pipeline.AddTask(LOADING_READ, [xml_filename, contents] () {
+      ifstream xml_file(xml_filename, ios::binary);
+      if (!xml_file.good()) {
+        throw runtime_error(string("Could not load xml file: ") + xml_filename);
+      }
+      contents->assign(istreambuf_iterator<char>(xml_file), 
+        istreambuf_iterator<char>());
+    });
+
+    shared_ptr<pugi::xml_document> doc = make_shared<pugi::xml_document>();
+    docs.push_back(doc);
+    scheduling_dependencies.push_back(pipeline.AddTask(LOADING_PARSE, 
+      [xml_filename, contents, doc] () {
+      if (!doc->load_buffer(contents->data(), contents->size())) {
+        throw runtime_error(string("Could not load xml file: ") + xml_filename);
+      }
+      contents->clear();
+    }, { read }));
+  }
+
+  // Meshes and textures are only known once every file is parsed.
+  pipeline.AddTask(LOADING_CREATE, [this, xml_files, docs, is_asset_file] () {
+    loading_dependencies_.clear();
+    for (int i = 0; i < xml_files.size(); i++) {
+      const pugi::xml_node& xml = docs[i]->child("xml");
+      LoadMeshesFromAssetFile(xml);
+      LoadTexturesFromAssetFile(xml);
+    }
+
+    int previous_asset_file = loading_pipeline_->AddBarrier(
+      loading_dependencies_);
+    for (int i = 0; i < xml_files.size(); i++) {
+      const string& xml_filename = xml_files[i];
+      if (is_asset_file.find(xml_filename) == is_asset_file.end()) continue;
+
+      shared_ptr<pugi::xml_document> doc = docs[i];
+      previous_asset_file = loading_pipeline_->AddTask(LOADING_CREATE, 
+        [this, xml_filename, doc] () {
+        cout << "Loading asset: " << xml_filename << endl;
+        LoadAssetXml(doc->child("xml"));
+      }, { previous_asset_file });
+    }
+  }, scheduling_dependencies);
+
+  int reported_percent = -1;
+  while (!pipeline.RunMainThreadTasks(kLoadingFrameBudget)) {
+    LoadingProgress progress = pipeline.GetProgress();
+    int percent = int(progress.GetFraction() * 100.0f);
+    if (percent / 10 == reported_percent / 10) continue;
+    reported_percent = percent;
+    cout << "Loading resources: " << percent << "% (" 
+      << progress.GetNumDone() << " of " << progress.GetNumTasks() 
+      << " tasks)" << endl;
+  }
+
+  LoadingProgress progress = pipeline.GetProgress();
+  loading_pipeline_ = nullptr;
+  mesh_tasks_.clear();
+  texture_tasks_.clear();
+  loading_dependencies_.clear();
+
+  double elapsed_time = GetTime() - start_time;
+  cout << "Load resources took " << elapsed_time << " seconds (" 
+    << xml_files.size() << " xml files, " 
+    << progress.num_done[LOADING_DECODE] << " meshes and textures, " 
+    << num_cached_meshes_ << " meshes from the mesh cache, "
+    << num_cached_textures_ << " textures from the texture cache)" << endl;
+}
+
 void Resources::LoadObjects(const std::string& directory) {
   boost::filesystem::path p (directory);
   boost::filesystem::directory_iterator end_itr;
@@ -833,7 +1027,7 @@ void Resources::LoadObjects(const std::string& directory) {
   cout << "Finished calculating collision data" << endl;
 
   shared_ptr<OctreeNode> outside_octree = 
-    GetSectorByName("outside")->octree_node;
+    GetSectorByName(kOutsideSector)->octree_node;
   for (const auto& [name, s] : sectors_) {
     for (const auto& [next_sector_id, portal] : s->portals) {
       InsertObjectIntoOctree(s->octree_node, portal, 0);
@@ -853,7 +1047,8 @@ const vector<vec3> kOctreeNodeOffsets = {
   vec3(+1, +1, +1), // 1 1 1 < 5
 };
 
-const vector<int> kOctreeToQuadTreeIndex = { 0, 1, 0, 1, 4, 5, 4, 5 };
+// Loose bounds are this many times larger than the node.
+const float kOctreeLooseness = 2.0f;
 
 void Resources::CreateOctree(shared_ptr<OctreeNode> octree_node, int depth) {
   if (depth > max_octree_depth_) return;
@@ -875,6 +1070,10 @@ void Resources::CreateOctree(shared_ptr<OctreeNode> octree_node, int depth) {
     octree_node->children[index] = make_shared<OctreeNode>(new_pos, 
       new_half_dimensions);
     octree_node->children[index]->parent = octree_node;
+    if (use_loose_octree_) {
+      octree_node->children[index]->loose_half_dimensions = 
+        new_half_dimensions * kOctreeLooseness;
+    }
     CreateOctree(octree_node->children[index], depth + 1);
     counter++;
   }
@@ -915,30 +1114,41 @@ void Resources::InsertObjectIntoOctree(shared_ptr<OctreeNode> octree_node,
   } else {
     // Straddling, or no child node to descend into, so link object into list 
     // at this node.
-    object->octree_node = octree_node;
-    if (object->IsLight()) {
-      octree_node->lights[object->id] = object;
-    }
+    LinkObjectToOctreeNode(octree_node, object);
+  }
+}
 
-    if (object->IsCreature()) {
-      octree_node->creatures[object->id] = object;
-    }
+void Resources::InsertMovingObjectIntoLooseOctree(ObjPtr object) {
+  LinkObjectToOctreeNode(FindLooseOctreeNode(GetOctreeRoot(), 
+    object->GetTransformedBoundingSphere(), max_octree_depth_, use_quadtree_),
+    object);
+}
 
-    if (object->IsItem()) {
-      octree_node->items[object->id] = object;
-    }
+void Resources::LinkObjectToOctreeNode(shared_ptr<OctreeNode> octree_node, 
+  ObjPtr object) {
+  object->octree_node = octree_node;
+  if (object->IsLight()) {
+    octree_node->lights.insert(object.get());
+  }
 
-    if (object->type == GAME_OBJ_REGION) {
-      octree_node->regions[object->id] = static_pointer_cast<Region>(object);
-    }
+  if (object->IsCreature()) {
+    octree_node->creatures.insert(object.get());
+  }
 
-    if (object->IsMovingObject()) {
-      octree_node->moving_objs[object->id] = object;
-    } else if (object->type == GAME_OBJ_SECTOR) {
-      octree_node->sectors.push_back(static_pointer_cast<Sector>(object));
-    } else {
-      octree_node->objects[object->id] = object;
-    }
+  if (object->IsItem()) {
+    octree_node->items.insert(object.get());
+  }
+
+  if (object->type == GAME_OBJ_REGION) {
+    octree_node->regions[object->id] = static_pointer_cast<Region>(object);
+  }
+
+  if (object->IsMovingObject()) {
+    octree_node->moving_objs.insert(object.get());
+  } else if (object->type == GAME_OBJ_SECTOR) {
+    octree_node->sectors.push_back(static_pointer_cast<Sector>(object));
+  } else {
+    octree_node->objects.insert(object.get());
   }
 }
 
@@ -950,6 +1160,8 @@ void Resources::AddGameObject(ObjPtr game_obj) {
   }
 
   objects_[game_obj->name] = game_obj;
+  game_obj->name_symbol = Symbol(game_obj->name);
+  objects_by_symbol_[game_obj->name_symbol] = game_obj;
   game_obj->id = id_counter_++;
 
   if (game_obj->IsMovingObject()) {
@@ -1005,6 +1217,11 @@ void Resources::InitParticles() {
     AddGameObject(p);
   }
 
+  // Popped from the back, so the first slots are used first as before.
+  free_particles_.clear();
+  is_particle_free_.assign(kMaxParticles, true);
+  for (int i = kMaxParticles - 1; i >= 0; i--) free_particles_.push_back(i);
+
   for (int i = 0; i < kMax3dParticles; i++) {
     vector<vec3> vertices;
     vector<vec2> uvs;
@@ -1025,9 +1242,11 @@ void Resources::InitParticles() {
 
 void Resources::Cleanup() {
   // TODO: cleanup VBOs.
+#ifndef HEADLESS
   for (auto it : shaders_) {
     glDeleteProgram(it.second);
   }
+#endif
 }
 
 // shared_ptr<Missile> Resources::CreateMissileFromAssetGroup(
@@ -1089,25 +1308,21 @@ void Resources::UpdateObjectPosition(ObjPtr obj, bool lock) {
     return; 
   }
 
+  // A moving object stays in its node while it is inside the loose bounds
+  // and doesn't fit in the child it would descend into.
+  octree_updates_++;
+  bool relocate = true;
+  if (use_loose_octree_ && obj->octree_node && obj->IsMovingObject()) {
+    relocate = NeedsLooseOctreeRelocation(*obj->octree_node,
+      obj->GetTransformedBoundingSphere(), use_quadtree_);
+  }
+
   // Clear position data.
-  if (obj->octree_node) {
-    obj->octree_node->objects.erase(obj->id);
-    if (obj->IsMovingObject()) {
-      obj->octree_node->moving_objs.erase(obj->id);
-    }
-    if (obj->IsCreature()) {
-      obj->octree_node->creatures.erase(obj->id);
-    }
-    if (obj->IsLight()) {
-      obj->octree_node->lights.erase(obj->id);
-    }
-    if (obj->IsItem()) {
-      obj->octree_node->items.erase(obj->id);
-    }
+  if (relocate && obj->octree_node) {
     if (obj->IsRegion()) {
       obj->octree_node->regions.erase(obj->id);
     }
-    obj->octree_node = nullptr;
+    obj->UnlinkFromOctree();
   }
 
   // Update sector.
@@ -1165,16 +1380,27 @@ void Resources::UpdateObjectPosition(ObjPtr obj, bool lock) {
   obj->current_region = region;
 
   // Update position into octree.
-  InsertObjectIntoOctree(GetOctreeRoot(), obj, 0);
+  if (!relocate) {
+    // Relinking is O(1) and updates the lists if the object changed type.
+    shared_ptr<OctreeNode> octree_node = obj->octree_node;
+    obj->UnlinkFromOctree();
+    LinkObjectToOctreeNode(octree_node, obj);
+  } else if (use_loose_octree_ && obj->IsMovingObject()) {
+    octree_relocations_++;
+    InsertMovingObjectIntoLooseOctree(obj);
+  } else {
+    octree_relocations_++;
+    InsertObjectIntoOctree(GetOctreeRoot(), obj, 0);
+  }
 
-  shared_ptr<OctreeNode> octree_node = obj->octree_node;
-  double time = glfwGetTime();
+  shared_ptr<OctreeNode> octree_node = relocate ? obj->octree_node : nullptr;
+  double time = GetTime();
   while (octree_node) {
     octree_node->updated_at = time;
     octree_node = octree_node->parent;
   }
 
-  obj->updated_at = glfwGetTime();
+  obj->updated_at = GetTime();
   if (lock) mutex_.unlock(); 
 }
 
@@ -1204,7 +1430,7 @@ shared_ptr<Sector> Resources::GetSectorAux(
 }
 
 shared_ptr<Sector> Resources::GetSector(vec3 position) {
-  shared_ptr<Sector> outside = GetSectorByName("outside");
+  shared_ptr<Sector> outside = GetSectorByName(kOutsideSector);
   shared_ptr<Sector> s = GetSectorAux(outside->octree_node, position);
   if (s) return s;
   return outside;
@@ -1239,10 +1465,11 @@ shared_ptr<Region> Resources::GetRegion(vec3 position) {
 
 // TODO: move to particle file.
 int Resources::FindUnusedParticle(){
-  for (int i = 0; i < kMaxParticles; i++) {
-    if (particle_container_[i]->life < 0) {
-      return i;
-    }
+  while (!free_particles_.empty()) {
+    int i = free_particles_.back();
+    free_particles_.pop_back();
+    is_particle_free_[i] = false;
+    if (particle_container_[i]->life < 0) return i;
   }
 
   return 0; // All particles are taken, override the first one
@@ -1273,43 +1500,40 @@ shared_ptr<Particle> Resources::CreateOneParticle(vec3 pos, float life,
 // TODO: move to particle file.
 void Resources::CreateParticleEffect(int num_particles, vec3 pos, vec3 normal, 
   vec3 color, float size, float life, float spread, const string& type) {
+  // Effects don't collide and aren't attached to anything, so they go to
+  // the particle system instead of the particle game objects.
+  int type_index = particle_system_.GetTypeIndex(type);
+  if (type_index == -1) {
+    shared_ptr<ParticleType> particle_type = GetParticleTypeByName(type);
+    if (!particle_type) return;
+
+    // Fireball particles only set their target position, they never moved.
+    bool moves = particle_type->behavior == PARTICLE_FALL && 
+      type != "fireball";
+    type_index = particle_system_.AddType(type, particle_type->first_frame,
+      particle_type->num_frames, particle_type->keep_frame,
+      particle_type->grid_size, moves);
+  }
+
   for (int i = 0; i < num_particles; i++) {
-    int particle_index = FindUnusedParticle();
-    shared_ptr<Particle> p = particle_container_[particle_index];
-
-    p->frame = 0;
-    p->life = life;
-    p->position = pos;
-    p->target_position = pos;
-    p->color = vec4(color, 0.0f);
-    p->associated_obj = nullptr;
-    p->associated_bone = -1;
-
-    p->particle_type = GetParticleTypeByName(type);
+    float particle_size = size;
     if (size < 0) {
-      p->size = (rand() % 1000) / 500.0f + 0.1f;
-    } else {
-      p->size = size;
+      particle_size = Random(0, 1000) / 500.0f + 0.1f;
     }
     
     vec3 main_direction = normal * 5.0f;
     vec3 rand_direction = glm::vec3(
-      (rand() % 2000 - 1000.0f) / 1000.0f,
-      (rand() % 2000 - 1000.0f) / 1000.0f,
-      (rand() % 2000 - 1000.0f) / 1000.0f
+      (Random(0, 2000) - 1000.0f) / 1000.0f,
+      (Random(0, 2000) - 1000.0f) / 1000.0f,
+      (Random(0, 2000) - 1000.0f) / 1000.0f
     );
-    p->speed = main_direction + rand_direction * spread;
-
-    int r = Random(0, 4);
-    // if (type == "fireball" && r == 0) {
-    //   p->collision_type_ = COL_QUICK_SPHERE;
-    //   p->bounding_sphere = BoundingSphere(vec3(0), 1.0f);
-    //   UpdateObjectPosition(p);
-    //   p->physics_behavior = PHYSICS_NORMAL;
-    // } else {
-      p->collision_type_ = COL_NONE;
-      p->physics_behavior = PHYSICS_NONE;
-    // }
+    vec3 speed = main_direction + rand_direction * spread;
+
+    // Unused, but keeps the random sequence of replays.
+    Random(0, 4);
+
+    particle_system_.Emit(type_index, pos, speed, vec4(color, 0.0f), 
+      particle_size, life);
   }
 } 
 
@@ -1386,6 +1610,11 @@ void Resources::UpdateParticles() {
     } else if (p->life <= 0 && p->scale_out > 0.0f) {
       p->scale_out -= 0.05f;
     } else if (--p->life < 0) {
+      if (!is_particle_free_[i]) {
+        is_particle_free_[i] = true;
+        free_particles_.push_back(i);
+      }
+
       // TODO: p->Reset();
       p->scale_in = 1.0f;
       p->scale_out = 0.0f;
@@ -1520,7 +1749,7 @@ void Resources::UpdateParticles() {
       const Animation& animation = mesh->animations[p->active_animation];
 
       p->animation_frame += 1.0f * d * p->animation_speed;
-      if (p->animation_frame >= animation.keyframes.size()) {
+      if (p->animation_frame >= GetNumFrames(animation)) {
         p->animation_frame = 0;
       }
 
@@ -1529,12 +1758,15 @@ void Resources::UpdateParticles() {
         bs.center = vec3(0);
 
         vec3 v = mesh->polygons[0].vertices[0];
-        bs.radius = animation.keyframes[p->animation_frame].transforms[0][0][0];
+        bs.radius = SampleAnimation(animation, 0, p->animation_frame)[0][0];
         p->bounding_sphere = bs;
       }
     }
   }
   Unlock();
+
+  // Has its own lock.
+  particle_system_.Update();
 }
 
 void Resources::UpdateMissiles() {
@@ -1599,7 +1831,15 @@ void Resources::UpdateMissiles() {
 }
 
 void Resources::UpdateFrameStart() {
-  frame_start_ = glfwGetTime();
+  frame_start_ = GetTime();
+
+  ObjPtr player = GetPlayer();
+  if (player) {
+    height_map_.StreamTiles(vec2(player->position.x, player->position.z));
+  }
+
+  octree_metrics_.num_updates = octree_updates_.exchange(0);
+  octree_metrics_.num_relocations = octree_relocations_.exchange(0);
 }
 
 void Resources::UpdateCooldowns() {
@@ -1646,7 +1886,7 @@ vector<ObjPtr> Resources::GenerateOptimizedOctreeAux(
 
   vector<ObjPtr> all_objs = top_objs;
   vector<ObjPtr> bot_objs;
-  for (auto [id, obj] : octree_node->objects) {
+  for (ObjPtr obj : octree_node->objects) {
     if ((obj->type != GAME_OBJ_DEFAULT && obj->type != GAME_OBJ_ACTIONABLE
          && obj->type != GAME_OBJ_DOOR && obj->type != GAME_OBJ_DESTRUCTIBLE) || 
       obj->GetAsset()->physics_behavior != PHYSICS_FIXED) {
@@ -1738,17 +1978,19 @@ void ClearOctree(shared_ptr<OctreeNode> octree_node) {
 
 void Resources::GenerateOptimizedOctree() {
   // TODO: should have octree root without querying outside sector.
-  shared_ptr<OctreeNode> octree = GetSectorByName("outside")->octree_node;
+  shared_ptr<OctreeNode> octree = GetSectorByName(kOutsideSector)->octree_node;
   GenerateOptimizedOctreeAux(octree, {});
+  static_objects_version_++;
   // PrintOctree(octree);
 }
 
 shared_ptr<OctreeNode> Resources::GetOctreeRoot() {
-  return GetSectorByName("outside")->octree_node;
+  return GetSectorByName(kOutsideSector)->octree_node;
 }
 
 void Resources::DeleteAsset(shared_ptr<GameAsset> asset) {
   assets_.erase(asset->name);
+  assets_by_symbol_.erase(Symbol::Find(asset->name));
 }
 
 unordered_map<int, ItemData>& Resources::GetItemData() { return item_data_; }
@@ -1756,21 +1998,10 @@ unordered_map<int, EquipmentData>& Resources::GetEquipmentData() { return equipm
 unordered_map<int, shared_ptr<ArcaneSpellData>>& Resources::GetArcaneSpellData() { return arcane_spell_data_; }
 
 void Resources::DeleteObject(ObjPtr obj) {
-  if (obj->octree_node) {
-    obj->octree_node->objects.erase(obj->id);
-    if (obj->IsMovingObject()) {
-      obj->octree_node->moving_objs.erase(obj->id);
-    }
-    if (obj->IsCreature()) {
-      obj->octree_node->creatures.erase(obj->id);
-    }
-    if (obj->IsLight()) {
-      obj->octree_node->lights.erase(obj->id);
-    }
-    obj->octree_node = nullptr;
-  }
+  obj->UnlinkFromOctree();
 
   objects_.erase(obj->name);
+  objects_by_symbol_.erase(obj->name_symbol);
 }
 
 void Resources::RemoveObject(ObjPtr obj) {
@@ -1779,24 +2010,10 @@ void Resources::RemoveObject(ObjPtr obj) {
   }
 
   // Clear position data.
-  if (obj->octree_node) {
-    obj->octree_node->objects.erase(obj->id);
-    if (obj->IsMovingObject()) {
-      obj->octree_node->moving_objs.erase(obj->id);
-    }
-    if (obj->IsCreature()) {
-      obj->octree_node->creatures.erase(obj->id);
-    }
-    if (obj->IsLight()) {
-      obj->octree_node->lights.erase(obj->id);
-    }
-    if (obj->IsItem()) {
-      obj->octree_node->items.erase(obj->id);
-    }
-    obj->octree_node = nullptr;
-  }
+  obj->UnlinkFromOctree();
 
   objects_.erase(obj->name);
+  objects_by_symbol_.erase(obj->name_symbol);
 
   for (int i = 0; i < creatures_.size(); i++) {
     if (creatures_[i]->id == obj->id) {
@@ -1994,8 +2211,8 @@ ObjPtr CollideRayAgainstObjectsAux(
 ) {
   if (!node) return nullptr;
 
-  AABB aabb = AABB(node->center - node->half_dimensions, 
-    node->half_dimensions * 2.0f);
+  AABB aabb = AABB(node->center - node->loose_half_dimensions, 
+    node->loose_half_dimensions * 2.0f);
 
   // Not used.
   float t;
@@ -2006,7 +2223,7 @@ ObjPtr CollideRayAgainstObjectsAux(
   }
 
   ObjPtr closest_obj = nullptr;
-  for (auto& [id, obj] : node->objects) {
+  for (ObjPtr obj : node->objects) {
     if (obj->type != GAME_OBJ_DEFAULT && obj->type != GAME_OBJ_WAYPOINT) continue;
     if (obj->status == STATUS_DEAD) continue;
     if (obj->name == "hand-001") continue;
@@ -2030,7 +2247,7 @@ ObjPtr CollideRayAgainstObjectsAux(
     }
   }
 
-  for (auto& [id, obj] : node->moving_objs) {
+  for (ObjPtr obj : node->moving_objs) {
     if (obj->type != GAME_OBJ_DEFAULT && obj->type != GAME_OBJ_WAYPOINT) continue;
     if (obj->status == STATUS_DEAD) continue;
     if (obj->name == "hand-001") continue;
@@ -2076,7 +2293,7 @@ ObjPtr CollideRayAgainstObjectsAux(
 }
 
 ObjPtr Resources::CollideRayAgainstObjects(vec3 position, vec3 direction) {
-  shared_ptr<OctreeNode> root = GetSectorByName("outside")->octree_node;
+  shared_ptr<OctreeNode> root = GetSectorByName(kOutsideSector)->octree_node;
   return CollideRayAgainstObjectsAux(root, position, direction);
 }
 
@@ -2292,23 +2509,25 @@ bool IntersectRayObject(ObjPtr obj, const vec3& position, const vec3& direction,
       return false;
     }
     case COL_PERFECT: {
-      if (obj->aabb_tree) {
-        if (IntersectRayAABBTree(position, direction, obj->aabb_tree, tmin, 
-          q, obj->position)) {
-          return true;
-        }
-      } else {
-        if (!obj->asset_group) return false;
-        for (int i = 0; i < obj->asset_group->assets.size(); i++) {
-          shared_ptr<GameAsset> asset = obj->asset_group->assets[i];
-          if (!asset) continue;
-          if (IntersectRayAABBTree(position, direction, asset->aabb_tree, tmin, 
-            q, obj->position)) {
-            return true;
-          }
+      if (obj->bvh) {
+        return obj->bvh->IntersectRay(position, direction, tmin, q,
+          obj->position);
+      }
+
+      if (!obj->asset_group) return false;
+      bool hit = false;
+      for (shared_ptr<GameAsset> asset : obj->asset_group->assets) {
+        if (!asset || !asset->bvh) continue;
+        float t;
+        vec3 asset_q;
+        if (asset->bvh->IntersectRay(position, direction, t, asset_q, 
+          obj->position) && (!hit || t < tmin)) {
+          tmin = t;
+          q = asset_q;
+          hit = true;
         }
       }
-      return false;
+      return hit;
     }
     case COL_QUICK_SPHERE: {
       BoundingSphere s = obj->GetTransformedBoundingSphere();
@@ -2325,13 +2544,33 @@ bool IntersectRayObject(ObjPtr obj, const vec3& position, const vec3& direction,
   }
 }
 
+// Which moving objects can be hit in each intersect mode.
+bool IsIntersectableMovingObject(ObjPtr item, IntersectMode mode) {
+  switch (mode) {
+    case INTERSECT_PLAYER:
+      return item->IsPlayer();
+    case INTERSECT_EDIT:
+    case INTERSECT_ALL:
+      return item->IsCreature() || item->IsDestructible();
+    case INTERSECT_ITEMS:
+      return item->IsNpc();
+    default:
+      return false;
+  }
+}
+
+bool IsIgnoredByRays(ObjPtr item) {
+  return item->name == "hand-001" || item->name == "scepter-001" ||
+    item->name == "map-001" || item->name == "waypoint-001";
+}
+
 ObjPtr Resources::IntersectRayObjectsAux(shared_ptr<OctreeNode> node,
   const vec3& position, const vec3& direction, float max_distance, 
   IntersectMode mode, float& t, vec3& q) {
   if (!node) return nullptr;
 
-  AABB aabb = AABB(node->center - node->half_dimensions, 
-    node->half_dimensions * 2.0f);
+  AABB aabb = AABB(node->center - node->loose_half_dimensions, 
+    node->loose_half_dimensions * 2.0f);
 
   // Checks if the ray intersect the current node.
   if (!IntersectRayAABB(position, direction, aabb, t, q)) {
@@ -2348,26 +2587,9 @@ ObjPtr Resources::IntersectRayObjectsAux(shared_ptr<OctreeNode> node,
 
   if (mode == INTERSECT_ALL || mode == INTERSECT_EDIT ||
     mode == INTERSECT_PLAYER || mode == INTERSECT_ITEMS) {
-    for (auto& [id, item] : node->moving_objs) {
+    for (ObjPtr item : node->moving_objs) {
       if (item->status == STATUS_DEAD) continue;
-      switch (mode) {
-        case INTERSECT_PLAYER: {
-          if (!item->IsPlayer()) continue;
-          break;
-        }
-        case INTERSECT_EDIT:
-        case INTERSECT_ALL: {
-          if (!item->IsCreature() && !item->IsDestructible()) continue;
-          break;
-        }
-        case INTERSECT_ITEMS: {
-          if (!item->IsNpc()) continue;
-          break;
-        }
-        default: {
-          continue;
-        }
-      }
+      if (!IsIntersectableMovingObject(item, mode)) continue;
 
       float distance = length(position - item->position);
       if (distance > max_distance) continue;
@@ -2399,15 +2621,12 @@ ObjPtr Resources::IntersectRayObjectsAux(shared_ptr<OctreeNode> node,
     }
   }
 
-  unordered_map<int, ObjPtr>* objs;
+  ObjectList* objs;
   if (mode == INTERSECT_ITEMS) objs = &node->items;
   else objs = &node->objects;
-  for (auto& [id, item] : *objs) {
+  for (ObjPtr item : *objs) {
     if (item->status == STATUS_DEAD) continue;
-    if (item->name == "hand-001") continue;
-    if (item->name == "scepter-001") continue;
-    if (item->name == "map-001") continue;
-    if (item->name == "waypoint-001") continue;
+    if (IsIgnoredByRays(item)) continue;
  
     float distance = length(position - item->position);
     if (distance > max_distance) continue;
@@ -2463,11 +2682,128 @@ ObjPtr Resources::IntersectRayObjectsAux(shared_ptr<OctreeNode> node,
 ObjPtr Resources::IntersectRayObjects(const vec3& position, 
   const vec3& direction, float max_distance, IntersectMode mode, float& t, 
   vec3& q) {
-  shared_ptr<OctreeNode> root = GetSectorByName("outside")->octree_node;
+  shared_ptr<OctreeNode> root = GetSectorByName(kOutsideSector)->octree_node;
   return IntersectRayObjectsAux(root, position, direction, max_distance, 
     mode, t, q);
 }
 
+// Tests every ray of the packet that may hit the object and keeps the
+// closest hits in the packet.
+void IntersectRayPacketObject(ObjPtr item, RayPacket& packet,
+  ObjPtr* objs) {
+  BoundingSphere s = item->GetTransformedBoundingSphere();
+  int mask = IntersectRayPacketAABB(packet, s.center - vec3(s.radius),
+    s.center + vec3(s.radius));
+  if (!mask) return;
+
+  if (item->GetCollisionType() == COL_PERFECT) {
+    vector<shared_ptr<Bvh>> bvhs;
+    if (item->bvh) {
+      bvhs.push_back(item->bvh);
+    } else if (item->asset_group) {
+      for (shared_ptr<GameAsset> asset : item->asset_group->assets) {
+        if (asset && asset->bvh) bvhs.push_back(asset->bvh);
+      }
+    }
+
+    // The mesh is tested in its own space, so the packet is translated.
+    RayPacket local_packet = packet;
+    local_packet.Translate(item->position);
+    for (shared_ptr<Bvh> bvh : bvhs) bvh->IntersectRays(local_packet);
+    for (int i = 0; i < packet.num_rays; i++) {
+      if (local_packet.t[i] < packet.t[i]) {
+        packet.t[i] = local_packet.t[i];
+        objs[i] = item;
+      }
+    }
+    return;
+  }
+
+  // Other collision types are cheap enough to test one ray at a time.
+  for (int i = 0; i < packet.num_rays; i++) {
+    if (!(mask & (1 << i))) continue;
+
+    float t;
+    vec3 q;
+    vec3 p = packet.GetOrigin(i);
+    vec3 d = packet.GetDirection(i);
+    if (!IntersectRayObject(item, p, d, t, q)) continue;
+
+    float ray_t = length(q - p) / length(d);
+    if (ray_t < packet.t[i]) {
+      packet.t[i] = ray_t;
+      objs[i] = item;
+    }
+  }
+}
+
+void Resources::IntersectRayPacketObjectsAux(shared_ptr<OctreeNode> node,
+  RayPacket& packet, IntersectMode mode, ObjPtr* objs) {
+  if (!node) return;
+
+  // Rays are shortened as hits are found, so nodes behind the closest hits
+  // are skipped.
+  if (!IntersectRayPacketAABB(packet, 
+    node->center - node->loose_half_dimensions,
+    node->center + node->loose_half_dimensions)) {
+    return;
+  }
+
+  if (mode == INTERSECT_ALL || mode == INTERSECT_EDIT ||
+    mode == INTERSECT_PLAYER || mode == INTERSECT_ITEMS) {
+    for (ObjPtr item : node->moving_objs) {
+      if (item->status == STATUS_DEAD) continue;
+      if (!IsIntersectableMovingObject(item, mode)) continue;
+      IntersectRayPacketObject(item, packet, objs);
+    }
+  }
+
+  ObjectList* node_objs;
+  if (mode == INTERSECT_ITEMS) node_objs = &node->items;
+  else node_objs = &node->objects;
+  for (ObjPtr item : *node_objs) {
+    if (item->status == STATUS_DEAD) continue;
+    if (IsIgnoredByRays(item)) continue;
+    IntersectRayPacketObject(item, packet, objs);
+  }
+
+  if (mode == INTERSECT_ALL || mode == INTERSECT_PLAYER) {
+    for (const auto& sorted_obj : node->static_objects) {
+      IntersectRayPacketObject(sorted_obj.obj, packet, objs);
+    }
+  }
+
+  for (int i = 0; i < 8; i++) {
+    IntersectRayPacketObjectsAux(node->children[i], packet, mode, objs);
+  }
+}
+
+void Resources::IntersectRaysObjects(const vector<Ray>& rays,
+  IntersectMode mode, vector<ObjPtr>& objs, vector<RayHit>& hits) {
+  objs.assign(rays.size(), nullptr);
+  hits.assign(rays.size(), RayHit());
+
+  shared_ptr<OctreeNode> root = GetSectorByName(kOutsideSector)->octree_node;
+  RayPacket packet;
+  for (size_t i = 0; i < rays.size(); i += kRayPacketSize) {
+    packet.Load(&rays[i], rays.size() - i);
+    IntersectRayPacketObjectsAux(root, packet, mode, &objs[i]);
+
+    // As in IntersectRayObjectsAux, the player is always tested.
+    if (mode == INTERSECT_PLAYER && player_) {
+      IntersectRayPacketObject(player_, packet, &objs[i]);
+    }
+
+    for (int j = 0; j < packet.num_rays; j++) {
+      if (!objs[i + j]) continue;
+      RayHit& hit = hits[i + j];
+      hit.hit = true;
+      hit.q = packet.GetHitPoint(j);
+      hit.t = length(hit.q - rays[i + j].origin);
+    }
+  }
+}
+
 struct CompareObjects { 
   bool operator()(const tuple<ObjPtr, float>& t1, 
     const tuple<ObjPtr, float>& t2) { 
@@ -2485,8 +2821,8 @@ void GetKClosestLightPointsAux(shared_ptr<OctreeNode> node,
 
   bool debug = false;
 
-  AABB aabb = AABB(node->center - node->half_dimensions, 
-    node->half_dimensions * 2.0f);
+  AABB aabb = AABB(node->center - node->loose_half_dimensions, 
+    node->loose_half_dimensions * 2.0f);
   vec3 closest_point = ClosestPtPointAABB(position, aabb);
 
   float min_distance_to_node = length(position - closest_point);
@@ -2517,7 +2853,7 @@ void GetKClosestLightPointsAux(shared_ptr<OctreeNode> node,
     }
   }
 
-  unordered_map<int, ObjPtr>* objs;
+  ObjectList* objs;
   switch (mode) {
     case 1: {
       objs = &node->lights;
@@ -2528,7 +2864,7 @@ void GetKClosestLightPointsAux(shared_ptr<OctreeNode> node,
     }
   }
 
-  for (auto& [id, light] : *objs) {
+  for (ObjPtr light : *objs) {
     float distance2 = length(position - light->position);
     if (distance2 > max_distance) continue;
 
@@ -2570,7 +2906,7 @@ void GetKClosestLightPointsAux(shared_ptr<OctreeNode> node,
 
 vector<ObjPtr> Resources::GetKClosestLightPoints(const vec3& position, int k, 
   int mode, float max_distance) {
-  shared_ptr<OctreeNode> root = GetSectorByName("outside")->octree_node;
+  shared_ptr<OctreeNode> root = GetSectorByName(kOutsideSector)->octree_node;
 
   ObjMaxHeap obj_heap;
   GetKClosestLightPointsAux(root, obj_heap, position, k, mode, max_distance);
@@ -2688,6 +3024,41 @@ shared_ptr<Mesh> Resources::GetMeshByName(const string& name) {
   return meshes_[name];
 }
 
+shared_ptr<GameAsset> Resources::GetAssetByName(Symbol name) {
+  auto it = assets_by_symbol_.find(name);
+  if (it == assets_by_symbol_.end()) {
+    ThrowError("Asset ", name.GetName(), " does not exist.");
+  }
+  return it->second;
+}
+
+shared_ptr<GameAssetGroup> Resources::GetAssetGroupByName(Symbol name) {
+  auto it = asset_groups_by_symbol_.find(name);
+  if (it == asset_groups_by_symbol_.end()) return nullptr;
+  return it->second;
+}
+
+ObjPtr Resources::GetObjectByName(Symbol name) {
+  auto it = objects_by_symbol_.find(name);
+  if (it == objects_by_symbol_.end()) {
+    cout << "Object " << name.GetName() << " does not exist" << endl;
+    return nullptr;
+  }
+  return it->second;
+}
+
+shared_ptr<Sector> Resources::GetSectorByName(Symbol name) {
+  auto it = sectors_by_symbol_.find(name);
+  if (it == sectors_by_symbol_.end()) return nullptr;
+  return it->second;
+}
+
+shared_ptr<Mesh> Resources::GetMeshByName(Symbol name) {
+  auto it = meshes_by_symbol_.find(name);
+  if (it == meshes_by_symbol_.end()) return nullptr;
+  return it->second;
+}
+
 GLuint Resources::GetTextureByName(const string& name) {
   // Segfault when loading from terrain.
   if (textures_.find(name) == textures_.end()) {
@@ -2966,6 +3337,7 @@ void Resources::AddAsset(shared_ptr<GameAsset> asset) {
   }
  
   assets_[asset->name] = asset;
+  assets_by_symbol_[Symbol(asset->name)] = asset;
   asset->id = id_counter_++;
 }
 
@@ -2977,6 +3349,7 @@ void Resources::AddAssetGroup(shared_ptr<GameAssetGroup> asset_group) {
   // }
   
   asset_groups_[asset_group->name] = asset_group;
+  asset_groups_by_symbol_[Symbol(asset_group->name)] = asset_group;
   asset_group->id = id_counter_++;
 }
 
@@ -2986,6 +3359,7 @@ shared_ptr<Mesh> Resources::AddMesh(const string& name, const Mesh& mesh) {
   }
   meshes_[name] = make_shared<Mesh>();
   *meshes_[name] = mesh;
+  meshes_by_symbol_[Symbol(name)] = meshes_[name];
   return meshes_[name];
 }
 
@@ -2998,7 +3372,7 @@ void Resources::AddRegion(const string& name, ObjPtr region) {
 }
 
 string Resources::GetRandomName() {
-  double time = glfwGetTime();
+  double time = GetTime();
   return "id-" + boost::lexical_cast<string>(++id_counter_) + "" +
     boost::lexical_cast<string>(time);
 }
@@ -3021,6 +3395,7 @@ void Resources::LoadSectors(const std::string& xml_filename) {
   }
 
   cout << "Loading sectors from: " << xml_filename << endl;
+  sectors_generation_++;
   const pugi::xml_node& xml = doc.child("xml");
   for (pugi::xml_node sector = xml.child("sector"); sector; 
     sector = sector.next_sibling("sector")) {
@@ -3033,6 +3408,7 @@ void Resources::LoadSectors(const std::string& xml_filename) {
         ThrowError("Sector with name ", new_sector->name, " already exists.");
       }
       sectors_[new_sector->name] = new_sector;
+      sectors_by_symbol_[Symbol(new_sector->name)] = new_sector;
       new_sector->id = id_counter_++;
     }
 
@@ -3149,6 +3525,7 @@ void Resources::LoadPortals(const std::string& xml_filename) {
   }
 
   cout << "Loading portals from: " << xml_filename << endl;
+  sectors_generation_++;
   const pugi::xml_node& xml = doc.child("xml");
   for (pugi::xml_node sector_xml = xml.child("sector"); sector_xml; 
     sector_xml = sector_xml.next_sibling("sector")) {
@@ -3176,13 +3553,13 @@ void Resources::LoadPortals(const std::string& xml_filename) {
 }
 
 void Resources::AddMessage(const string& msg) {
-  double time = glfwGetTime() + 10.0f;
+  double time = GetTime() + 10.0f;
   configs_->messages.push_back({ msg, time });
 }
 
 void Resources::ProcessMessages() {
   return;
-  double cur_time = glfwGetTime();
+  double cur_time = GetTime();
   while (!configs_->messages.empty() && 
     get<1>(*configs_->messages.begin()) < cur_time) {
     configs_->messages.erase(configs_->messages.begin());
@@ -3197,20 +3574,19 @@ void Resources::ProcessNpcs() {
 void Resources::ProcessCallbacks() {
   Lock();
 
-  double current_time = glfwGetTime();
+  double current_time = GetTime();
   while (!callbacks_.empty()) {
     Callback c = callbacks_.top();
     if (c.next_time > current_time) break;
 
     Unlock();
-    string s = c.function_name;
 
-    if (s == "fall_floor") {
+    if (c.function == kFallFloorCallback) {
       cout << "falling floor" << endl;
       ObjPtr hanging_floor = GetObjectByName(c.args[0]);
       hanging_floor->physics_behavior = PHYSICS_NORMAL;
       SetCallback("restore_floor", c.args, 10, false);
-    } else if (s == "restore_floor") {
+    } else if (c.function == kRestoreFloorCallback) {
       cout << "restoring floor" << endl;
       ObjPtr hanging_floor = GetObjectByName(c.args[0]);
       hanging_floor->physics_behavior = PHYSICS_FLY;
@@ -3219,12 +3595,12 @@ void Resources::ProcessCallbacks() {
       hanging_floor->interacted_with_falling_floor = false;
     }
 
-    // script_manager_->CallStrFn(s);
+    // script_manager_->CallStrFn(c.function_name);
     Lock();
 
     callbacks_.pop();
     if (c.periodic) {
-      c.next_time = glfwGetTime() + c.period;
+      c.next_time = GetTime() + c.period;
       callbacks_.push(c);
     }
   }
@@ -3317,7 +3693,7 @@ void Resources::RunScriptFn(const string& script_fn_name) {
 void Resources::SetCallback(string script_name, vector<string> args, 
   float seconds, bool periodic) {
   Lock();
-  double time = glfwGetTime() + seconds;
+  double time = GetTime() + seconds;
   callbacks_.push(Callback(script_name, args, time, seconds, periodic));
   Unlock();
 }
@@ -3585,11 +3961,11 @@ void Resources::UpdateAnimationFrames() {
           obj->frame += 1.0f * d;
         }
 
-        if (obj->frame >= animation.keyframes.size()) {
+        if (obj->frame >= GetNumFrames(animation)) {
           if (obj->GetRepeatAnimation()) {
             obj->frame = 0;
           } else {
-            obj->frame = animation.keyframes.size() - 1;
+            obj->frame = GetNumFrames(animation) - 1;
           }
         }
       }
@@ -3643,7 +4019,7 @@ void Resources::ProcessEvents() {
 }
 
 void Resources::ProcessTempStatus() {
-  double cur_time = glfwGetTime();
+  double cur_time = GetTime();
   for (auto& [name, obj] : objects_) {
     if (!obj->IsCreature()) continue;
 
@@ -4092,6 +4468,7 @@ void Resources::DeleteAllObjects() {
       continue;
     }
     ++it;
+    objects_by_symbol_.erase(Symbol::Find(name));
     objects_.erase(name);
   }
   creatures_.clear();
@@ -4101,11 +4478,15 @@ void Resources::DeleteAllObjects() {
   lights_.clear();
   missiles_.clear();
   particle_container_.clear();
+  free_particles_.clear();
+  is_particle_free_.clear();
+  particle_system_.Clear();
   regions_.clear();
   npcs_.clear();
   monster_groups_.clear();
 
   ClearOctree(GetOctreeRoot());
+  static_objects_version_++;
   moving_objects_.push_back(GetPlayer());
   UpdateObjectPosition(GetPlayer(), false);
   CreateOutsideSector();
@@ -4224,10 +4605,10 @@ void Resources::CreateRandomMonster(const vec3& pos) {
 }
 
 void Resources::CreateDungeon(bool generate_dungeon) {
-  double start_time = glfwGetTime();
+  double start_time = GetTime();
 
   if (generate_dungeon) {
-    double time = glfwGetTime();
+    double time = GetTime();
     int random_num = (int(time / 0.0001f) * 7919) % 1000000000;
     dungeon_.GenerateDungeon(configs_->dungeon_level, random_num);
   }
@@ -4568,7 +4949,7 @@ void Resources::CreateDungeon(bool generate_dungeon) {
     configs_->update_renderer = true;
   }
 
-  double elapsed_time = glfwGetTime() - start_time;
+  double elapsed_time = GetTime() - start_time;
   cout << "Create dungeon took " << elapsed_time << " seconds" << endl;
 }
 
@@ -4708,18 +5089,18 @@ void Resources::SaveGame() {
 
 void Resources::LoadGame(const string& config_filename, 
   bool calculate_crystals) {
-  double start_time = glfwGetTime();
+  double start_time = GetTime();
   DeleteAllObjects();
   LoadConfig(directory_ + "/" + config_filename);
-  double elapsed_time = glfwGetTime() - start_time;
+  double elapsed_time = GetTime() - start_time;
   cout << "Load config took " << elapsed_time << " seconds" << endl;
 
-  start_time = glfwGetTime();
+  start_time = GetTime();
   // LoadCollisionData(directory_ + "/objects/collision_data.xml");
   CalculateCollisionData();
   GenerateOptimizedOctree();
   cout << ">>>>>>>>>>>>>>>> 2" << endl;
-  elapsed_time = glfwGetTime() - start_time;
+  elapsed_time = GetTime() - start_time;
   cout << "Calculate collision took " << elapsed_time << " seconds" << endl;
 }
 
@@ -5346,9 +5727,9 @@ ObjPtr Resources::CreateSpeedLines(ObjPtr obj) {
   ObjPtr o = Create3dParticleEffect("spell_shot_particle_lines", obj->position);
   shared_ptr<Particle> p = static_pointer_cast<Particle>(o);
 
-  float f = (rand() % 10000) / 500.0f + 0.1f;
+  float f = Random(0, 10000) / 500.0f + 0.1f;
   p->rotation_matrix = obj->rotation_matrix * rotate(mat4(1.0), f, vec3(1, 0, 0));
-  p->frame = (rand() % 50);
+  p->frame = Random(0, 50);
   p->collision_type_ = COL_NONE;
   p->bounding_sphere = BoundingSphere(vec3(0), 1.0f);
   return p;  
@@ -5361,16 +5742,16 @@ void Resources::CreateSparks(const vec3& position, const vec3& direction) {
     ObjPtr o = Create3dParticleEffect("particle_spark", position);
     shared_ptr<Particle> p = static_pointer_cast<Particle>(o);
 
-    float f = (rand() % 400) / 500.0f - 0.4f;
+    float f = Random(0, 400) / 500.0f - 0.4f;
     p->rotation_matrix = mat4_cast(target) * rotate(mat4(1.0), f, vec3(0, 1, 0));
 
-    f = (rand() % 1000) / 500.0f - 0.5f;
+    f = Random(0, 1000) / 500.0f - 0.5f;
     p->rotation_matrix = p->rotation_matrix * rotate(mat4(1.0), f, vec3(0, 0, 1));
 
     p->collision_type_ = COL_NONE;
     p->bounding_sphere = BoundingSphere(vec3(0), 1.0f);
 
-    p->scale = (rand() % 20) / 100.0f + 0.1f;
+    p->scale = Random(0, 20) / 100.0f + 0.1f;
   } 
 }
 
@@ -5490,29 +5871,57 @@ vec3 Resources::GetTrapRayCollision(ObjPtr owner, const vec3& position,
   return dungeon_.GetTilePosition(tile);
 }
 
-void Resources::CastMagmaRay(ObjPtr owner, const vec3& position, 
-  const vec3& direction, int bone_id) {
-  const float magma_damage = boost::lexical_cast<float>(
-    GetGameFlag("magma_ray_damage"));
-  vec3 right = normalize(cross(direction, vec3(0, 1, 0)));
-  vec3 up = cross(right, direction);
-
-  vec3 pos = position; 
+vec3 Resources::GetMagmaRayOrigin(ObjPtr owner, int bone_id) {
   if (owner->IsPlayer()) {
     ObjPtr hand = GetObjectByName("hand-001");
     BoundingSphere s = hand->GetBoneBoundingSphereByBoneName("indx_tip");
-    pos = s.center;
+    return s.center;
+  }
+  BoundingSphere s = owner->GetBoneBoundingSphere(bone_id); // 10, 14, 6, 1.
+  return s.center;
+}
+
+void Resources::CastMagmaRay(ObjPtr owner, const vec3&, 
+  const vec3& direction, int bone_id) {
+  vec3 pos = GetMagmaRayOrigin(owner, bone_id);
+  vec3 normal = normalize(direction);
+
+  float other_t = 0;
+  vec3 q;
+  ObjPtr obj;
+  if (owner->IsPlayer()) {
+    obj = IntersectRayObjects(pos, normal, 100, INTERSECT_ALL, other_t, q);
   } else {
-    BoundingSphere s = owner->GetBoneBoundingSphere(bone_id); // 10, 14, 6, 1.
-    pos = s.center;
+    obj = IntersectRayObjects(pos, normal, 100, INTERSECT_PLAYER, other_t, q);
   }
+  ShootMagmaRay(owner, pos, normal, obj, other_t);
+}
 
-  vec3 p2 = pos + direction * 3000.0f;
-  vec3 normal = normalize(p2 - pos);
+void Resources::CastMagmaRays(ObjPtr owner, const vector<vec3>& directions,
+  const vector<int>& bones) {
+  vector<Ray> rays;
+  for (size_t i = 0; i < directions.size(); i++) {
+    rays.push_back(Ray(GetMagmaRayOrigin(owner, bones[i]),
+      normalize(directions[i]), 100));
+  }
+
+  vector<ObjPtr> objs;
+  vector<RayHit> hits;
+  IntersectRaysObjects(rays, owner->IsPlayer() ? INTERSECT_ALL : 
+    INTERSECT_PLAYER, objs, hits);
+  for (size_t i = 0; i < rays.size(); i++) {
+    ShootMagmaRay(owner, rays[i].origin, rays[i].direction, objs[i],
+      hits[i].t);
+  }
+}
+
+void Resources::ShootMagmaRay(ObjPtr owner, const vec3& pos, 
+  const vec3& normal, ObjPtr obj, float other_t) {
+  const float magma_damage = boost::lexical_cast<float>(
+    GetGameFlag("magma_ray_damage"));
 
   float t = 99999999999.9f;
   vec3 q;
-  ObjPtr obj;
   vec3 end = normal * 50.0f;
 
   bool collided_dungeon = false;
@@ -5522,13 +5931,6 @@ void Resources::CastMagmaRay(ObjPtr owner, const vec3& position,
     collided_dungeon = true;
   } 
 
-  float other_t = 0;
-  if (owner->IsPlayer()) {
-    obj = IntersectRayObjects(pos, normal, 100, INTERSECT_ALL, other_t, q);
-  } else {
-    obj = IntersectRayObjects(pos, normal, 100, INTERSECT_PLAYER, other_t, q);
-  }
-
   bool collided_obj = false;
   if (obj) {
     if (!collided_dungeon || other_t < t) {
@@ -6112,12 +6514,12 @@ void Resources::CastImpFire(ObjPtr owner, const vec3& pos,
 shared_ptr<Missile> Resources::CastSpellShot(const Camera& camera, float speed) {
   shared_ptr<Missile> obj = GetUnusedMissile();
   
-  configs_->attacked_at = glfwGetTime();
+  configs_->attacked_at = GetTime();
   for (auto monster : configs_->wave_monsters) {
     monster->saw_player_attack = true;
   }
 
-  configs_->attacked_at = glfwGetTime();
+  configs_->attacked_at = GetTime();
 
   obj->UpdateAsset("spell_shot");
   obj->CalculateCollisionData();
@@ -6215,12 +6617,12 @@ void Resources::CastShotgun(ObjPtr owner, const vec3& pos,
 
     shared_ptr<Missile> obj = GetUnusedMissile();
     
-    configs_->attacked_at = glfwGetTime();
+    configs_->attacked_at = GetTime();
     for (auto monster : configs_->wave_monsters) {
       monster->saw_player_attack = true;
     }
 
-    configs_->attacked_at = glfwGetTime();
+    configs_->attacked_at = GetTime();
 
     obj->UpdateAsset("spell_shot");
     obj->CalculateCollisionData();
@@ -6276,7 +6678,7 @@ void Resources::CastWormBreed(ObjPtr worm) {
   vec3 pos = s.center;
 
   ObjPtr obj = CreateGameObjFromAsset(this, "blood_worm", pos);
-  obj->cooldowns["breed"] = glfwGetTime() + 99999999;
+  obj->cooldowns["breed"] = GetTime() + 99999999;
 
   float x = Random(0, 11) * .05f;
   float z = Random(0, 11) * .05f;
@@ -6414,126 +6816,6 @@ Camera Resources::GetCamera() {
   return c;
 }
 
-// Load meshes took 9.53833 seconds.
-void Resources::LoadMeshesAsync() {
-  return;
-  while (!terminate_) {
-    mesh_mutex_.lock();
-    if (mesh_loading_tasks_.empty()) {
-      mesh_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(100));
-      continue;
-    }
-
-    auto [name, fbx_filename] = mesh_loading_tasks_.front();
-    mesh_loading_tasks_.pop();
-    running_mesh_loading_tasks_++;
-    mesh_mutex_.unlock();
-
-    shared_ptr<Mesh> mesh = make_shared<Mesh>();
-    FbxData data;
-    LoadFbxData(fbx_filename, *mesh, data, false);
-    if (meshes_.find(name) != meshes_.end()) {
-      ThrowError("Mesh with name ", name, " already exists Resources::146");
-    }
-
-    mesh_mutex_.lock();
-    meshes_[name] = mesh;
-    running_mesh_loading_tasks_--;
-    mesh_mutex_.unlock();
-  }
-}
-
-// Load assets took 5.51015 seconds.
-void Resources::LoadAssetsAsync() {
-  return;
-  while (!terminate_) {
-    asset_mutex_.lock();
-    if (asset_loading_tasks_.empty()) {
-      asset_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(100));
-      continue;
-    }
-
-    auto asset_group_xml = asset_loading_tasks_.front();
-    asset_loading_tasks_.pop();
-    running_asset_loading_tasks_++;
-    asset_mutex_.unlock();
-
-    if (string(asset_group_xml.name()) == "asset") {
-      shared_ptr<GameAsset> asset = CreateAsset(this, asset_group_xml);
-    
-      CreateAssetGroupForSingleAsset(this, asset);
-    } else {
-      shared_ptr<GameAssetGroup> asset_group = make_shared<GameAssetGroup>();
-
-      vector<Polygon> polygons;
-      int i = 0;
-      for (pugi::xml_node asset_xml = asset_group_xml.child("asset"); asset_xml; 
-        asset_xml = asset_xml.next_sibling("asset")) {
-
-        shared_ptr<GameAsset> asset = CreateAsset(this, asset_xml);
-        asset->index = i;
-        asset_group->assets.push_back(asset);
-
-        const string mesh_name = asset->lod_meshes[0];
-        shared_ptr<Mesh> mesh = GetMeshByName(mesh_name);
-        if (!mesh) {
-          ThrowError("Collision hull ", mesh_name, " does not exist.");
-        }
-
-        polygons.insert(
-          polygons.begin(), mesh->polygons.begin(), mesh->polygons.end());
-        i++;
-      }
-      asset_group->bounding_sphere = GetAssetBoundingSphere(polygons);
-
-      string name = asset_group_xml.attribute("name").value();
-      asset_group->name = name;
-      asset_groups_[name] = asset_group;
-      asset_group->id = id_counter_++;
-      AddAssetGroup(asset_group);
-    }
-
-    asset_mutex_.lock();
-    running_asset_loading_tasks_--;
-    asset_mutex_.unlock();
-  }
-}
-
-void Resources::LoadTexturesAsync() {
-  while (!terminate_) {
-    texture_mutex_.lock();
-    if (texture_loading_tasks_.empty()) {
-      texture_mutex_.unlock();
-      this_thread::sleep_for(chrono::milliseconds(100));
-      continue;
-    }
-
-    string texture_filename = texture_loading_tasks_.front();
-    texture_loading_tasks_.pop();
-    running_texture_loading_tasks_++;
-    texture_mutex_.unlock();
-
-    GLuint texture_id = GetTextureByName(texture_filename);
-    if (texture_id != 0) {
-      LoadTextureAsync(texture_filename.c_str(), texture_id, window_);
-    }
-
-    texture_mutex_.lock();
-    running_texture_loading_tasks_--;
-    texture_mutex_.unlock();
-  }
-}
-
-void Resources::CreateThreads() {
-  for (int i = 0; i < kMaxThreads; i++) {
-    load_mesh_threads_.push_back(thread(&Resources::LoadMeshesAsync, this));
-    load_asset_threads_.push_back(thread(&Resources::LoadAssetsAsync, this));
-    load_texture_threads_.push_back(thread(&Resources::LoadTexturesAsync, this));
-  }
-}
-
 vector<ObjPtr> Resources::GetMonstersInGroup(int monster_group) {
   if (monster_groups_.find(monster_group) == monster_groups_.end()) return {};
   return monster_groups_[monster_group];
@@ -6572,7 +6854,7 @@ bool Resources::CastSpellWall(ObjPtr owner, const vec3& position) {
   GenerateOptimizedOctree();
 
   dungeon_.SetFlag(tile, DLRG_SPELL_WALL);
-  dungeon_.CalculateAllPathsAsync(tile);
+  dungeon_.InvalidatePaths(tile);
   return true;
 }
 
@@ -6631,7 +6913,7 @@ void Resources::DestroyDoor(ObjPtr obj) {
   door->state = DOOR_DESTROYING;
   if (door->dungeon_tile.x != -1) {
     dungeon_.SetDoorOpen(door->dungeon_tile);
-    dungeon_.CalculateAllPathsAsync(door->dungeon_tile);
+    dungeon_.InvalidatePaths(door->dungeon_tile);
   }
 }
 
@@ -6807,11 +7089,11 @@ void Resources::ProcessArenaEvents() {
 
   if (!configs_->wave_monsters.empty()) {
     configs_->wave_monsters.clear();
-    configs_->wave_reset_timer = glfwGetTime() + 5.0f;
+    configs_->wave_reset_timer = GetTime() + 5.0f;
     return;
   }
 
-  if (glfwGetTime() < configs_->wave_reset_timer) return;
+  if (GetTime() < configs_->wave_reset_timer) return;
 
   Wave wave = dungeon_.GetWave(++configs_->current_wave);
 
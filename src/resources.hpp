@@ -9,7 +9,13 @@
 #include "space_partition.hpp"
 #include "height_map.hpp"
 #include "dungeon.hpp"
+#include "job_system.hpp"
+#include "loading_pipeline.hpp"
+#include "ray_packet.hpp"
+#include "particle_system.hpp"
+#include "uniform_cache.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <exception>
 #include <iostream>
@@ -100,6 +106,7 @@ struct Configs {
   vec3 scale_pivot = vec3(0);
   vec3 scale_dimensions = vec3(10, 10, 10);
   bool draw_dungeon = true;
+  bool occlusion_culling = true;
   int item_matrix[10][5] = {
     { 18, 19, 20, 21, 0 },
     {   0, 0,  0,  0, 0 },
@@ -366,13 +373,14 @@ struct Npc {
 
 struct Callback {
   string function_name;
+  Symbol function;
   float next_time;
   float period;
   bool periodic = false;
   vector<string> args;
 
   Callback(string function_name, vector<string> args,float next_time, float period, bool periodic = false)
-    : function_name(function_name), args(args), next_time(next_time), period(period), periodic(periodic) {}
+    : function_name(function_name), function(function_name), args(args), next_time(next_time), period(period), periodic(periodic) {}
 };
 
 class CompareCallbacks {
@@ -400,6 +408,13 @@ class Resources {
   unordered_map<int, vector<ObjPtr>> monster_groups_;
   std::default_random_engine generator_;
   bool use_quadtree_ = true;
+
+  // Moving objects are inserted with loose bounds and only relocated when
+  // they leave them.
+  bool use_loose_octree_ = true;
+  atomic<int> octree_updates_ { 0 };
+  atomic<int> octree_relocations_ { 0 };
+  OctreeMetrics octree_metrics_;
   GLFWwindow* window_;
   int random_item_id = kRandomItemOffset;
 
@@ -425,6 +440,18 @@ class Resources {
   unordered_map<string, shared_ptr<GameAssetGroup>> asset_groups_;
   unordered_map<string, shared_ptr<Sector>> sectors_;
   unordered_map<string, shared_ptr<GameObject>> objects_;
+
+  // Same as above by interned name, for lookups in hot paths.
+  unordered_map<Symbol, shared_ptr<Mesh>> meshes_by_symbol_;
+  unordered_map<Symbol, shared_ptr<GameAsset>> assets_by_symbol_;
+  unordered_map<Symbol, shared_ptr<GameAssetGroup>> asset_groups_by_symbol_;
+  unordered_map<Symbol, shared_ptr<Sector>> sectors_by_symbol_;
+  unordered_map<Symbol, shared_ptr<GameObject>> objects_by_symbol_;
+
+  // Incremented when sectors or portals are loaded, so caches built from
+  // the stabbing trees know when to rebuild.
+  atomic<int> sectors_generation_ { 0 };
+
   unordered_map<string, shared_ptr<GameObject>> consumed_consumables_;
   unordered_map<string, shared_ptr<Waypoint>> waypoints_;
   unordered_map<string, shared_ptr<Waypoint>> spawn_points_;
@@ -454,6 +481,9 @@ class Resources {
   ObjPtr decoy_ = nullptr;
   shared_ptr<OctreeNode> outside_octree_;
 
+  // Changes whenever the static objects in the octree are regenerated.
+  int static_objects_version_ = 0;
+
   // Events.
   vector<shared_ptr<Event>> events_;
   vector<shared_ptr<DieEvent>> on_unit_die_events_;
@@ -462,23 +492,23 @@ class Resources {
   // Thread and mutexes.
   mutex mutex_;
 
-  bool terminate_ = false;
-  const int kMaxThreads = 16;
+  shared_ptr<JobSystem> job_system_;
+  shared_ptr<JobCounter> texture_jobs_;
 
-  mutex mesh_mutex_;
-  int running_mesh_loading_tasks_= 0;
+  // Worklists for LoadMeshes and LoadAssetFile.
   queue<tuple<string, string>> mesh_loading_tasks_;
-  vector<thread> load_mesh_threads_;
-
-  mutex asset_mutex_;
-  int running_asset_loading_tasks_= 0;
+  int num_cached_meshes_ = 0;
+  int num_cached_textures_ = 0;
   queue<pugi::xml_node> asset_loading_tasks_;
-  vector<thread> load_asset_threads_;
 
-  mutex texture_mutex_;
-  int running_texture_loading_tasks_= 0;
-  queue<string> texture_loading_tasks_;
-  vector<thread> load_texture_threads_;
+  // Only set inside LoadResources. Meshes and textures become loading tasks,
+  // and the upload tasks of the file being scheduled are collected in
+  // loading_dependencies_.
+  shared_ptr<LoadingPipeline> loading_pipeline_;
+  unordered_map<string, int> mesh_tasks_;
+  unordered_map<GLuint, int> texture_tasks_;
+  vector<int> loading_dependencies_;
+  mutex fbx_mutex_;
 
   unordered_map<int, ItemData> item_data_ {
     { 0, { 0, "", "", "", "", 0, 0, false, ITEM_DEFAULT, "", ivec2(1, 1) } },
@@ -541,7 +571,9 @@ class Resources {
   void LoadTextures(const std::string& directory);
   void LoadNpcs(const string& xml_filename);
   void LoadAssetFile(const string& xml_filename);
+  void LoadAssetXml(const pugi::xml_node& xml);
   void LoadAssets(const string& directory);
+  void LoadResources(const string& directory);
   void LoadConfig(const string& xml_filename);
   void LoadObjects(const string& directory);
   void LoadPortals(const string& xml_filename);
@@ -562,6 +594,9 @@ class Resources {
   // TODO: move to particle.
   int last_used_particle_ = 0;
   vector<shared_ptr<Particle>> particle_container_;
+  vector<int> free_particles_;
+  vector<bool> is_particle_free_;
+  ParticleSystem particle_system_;
 
   // TODO: move to space partition.
   vector<shared_ptr<GameObject>> GenerateOptimizedOctreeAux(
@@ -580,6 +615,7 @@ class Resources {
   void LoadAssetTextures(pugi::xml_node asset_xml, shared_ptr<GameAsset> asset);
   void LoadParticleTypes(pugi::xml_node xml);
   void LoadMeshesFromAssetFile(pugi::xml_node xml);
+  void LoadMesh(const string& name, const string& fbx_filename);
   void CreateOctree(shared_ptr<OctreeNode> octree_node, int depth = 0);
   OctreeCount CountOctreeNodesAux(shared_ptr<OctreeNode> octree_node, int depth);
   void GenerateStoreItems();
@@ -615,6 +651,7 @@ class Resources {
   // Getters
   double GetFrameStart();
   vector<shared_ptr<Particle>>& GetParticleContainer();
+  ParticleSystem& GetParticleSystem() { return particle_system_; }
   shared_ptr<Player> GetPlayer();
   ObjPtr GetDecoy();
   shared_ptr<Mesh> GetMesh(ObjPtr obj);
@@ -629,10 +666,19 @@ class Resources {
   unordered_map<string, string>& GetScripts();
   unordered_map<string, shared_ptr<Waypoint>>& GetWaypoints();
   unordered_map<string, shared_ptr<Sector>> GetSectors();
+  int GetSectorsGeneration() { return sectors_generation_; }
   shared_ptr<GameAsset> GetAssetByName(const string& name);
   shared_ptr<GameAssetGroup> GetAssetGroupByName(const string& name);
   shared_ptr<GameObject> GetObjectByName(const string& name);
   shared_ptr<Sector> GetSectorByName(const string& name);
+
+  // Lookups by interned name. Unlike the string versions, they never hash
+  // the name.
+  shared_ptr<GameAsset> GetAssetByName(Symbol name);
+  shared_ptr<GameAssetGroup> GetAssetGroupByName(Symbol name);
+  shared_ptr<GameObject> GetObjectByName(Symbol name);
+  shared_ptr<Sector> GetSectorByName(Symbol name);
+  shared_ptr<Mesh> GetMeshByName(Symbol name);
   shared_ptr<Region> GetRegionByName(const string& name);
   shared_ptr<Waypoint> GetWaypointByName(const string& name);
   shared_ptr<ParticleType> GetParticleTypeByName(const string& name);
@@ -658,6 +704,7 @@ class Resources {
   bool CollideRayAgainstTerrain(vec3 start, vec3 end, ivec2& tile);
   ObjPtr CollideRayAgainstObjects(vec3 position, vec3 direction);
   shared_ptr<OctreeNode> GetOctreeRoot();
+  int GetStaticObjectsVersion() { return static_objects_version_; }
 
   // TODO: move to particle / missiles.
   void CastMagicMissile(const Camera& camera, int level = 0);
@@ -669,6 +716,11 @@ class Resources {
     const vec3& direction);
   void CastMagmaRay(ObjPtr owner, const vec3& position, 
     const vec3& direction, int bone = -1);
+
+  // Same as CastMagmaRay for the rays of several bones, which are tested
+  // against the objects in one ray packet.
+  void CastMagmaRays(ObjPtr owner, const vector<vec3>& directions,
+    const vector<int>& bones);
   void CastHeal(ObjPtr owner);
   void CastFlash(const vec3& position);
   void CastPush(const vec3& position);
@@ -715,6 +767,21 @@ class Resources {
   ObjPtr IntersectRayObjects(const vec3& position, 
     const vec3& direction, float max_distance, 
     IntersectMode mode, float& t, vec3& q);
+  void IntersectRayPacketObjectsAux(shared_ptr<OctreeNode> node,
+    RayPacket& packet, IntersectMode mode, ObjPtr* objs);
+
+  vec3 GetMagmaRayOrigin(ObjPtr owner, int bone_id);
+
+  // Damages obj if the ray hit it at other_t before any wall and draws the
+  // ray up to the first thing it hit.
+  void ShootMagmaRay(ObjPtr owner, const vec3& pos, const vec3& normal,
+    ObjPtr obj, float other_t);
+
+  // Batched IntersectRayObjects. The rays are tested in packets of
+  // kRayPacketSize against the octree and the collision meshes. objs[i] is
+  // the closest object hit by rays[i] or nullptr.
+  void IntersectRaysObjects(const vector<Ray>& rays, IntersectMode mode,
+    vector<ObjPtr>& objs, vector<RayHit>& hits);
   vector<ObjPtr> GetKClosestLightPoints(const vec3& position, int k, int mode,
     float max_distance=50);
   shared_ptr<Sector> GetSectorAux(shared_ptr<OctreeNode> octree_node, 
@@ -726,6 +793,9 @@ class Resources {
   void CalculateAllClosestLightPoints();
   void InsertObjectIntoOctree(shared_ptr<OctreeNode> octree_node, 
     shared_ptr<GameObject> object, int depth);
+  void InsertMovingObjectIntoLooseOctree(shared_ptr<GameObject> object);
+  void LinkObjectToOctreeNode(shared_ptr<OctreeNode> octree_node, 
+    shared_ptr<GameObject> object);
 
   void Lock() { mutex_.lock(); }
   void Unlock() { mutex_.unlock(); }
@@ -796,6 +866,10 @@ class Resources {
   void DeleteAllObjects();
 
   bool UseQuadtree() { return use_quadtree_; }
+  bool UseLooseOctree() { return use_loose_octree_; }
+
+  // Counters of the last complete frame.
+  const OctreeMetrics& GetOctreeMetrics() { return octree_metrics_; }
   void SaveGame();
   void LoadGame(const string& config_filename, bool calculate_crystals = true);
   int CountGold();
@@ -826,10 +900,7 @@ class Resources {
   Camera GetCamera();
   void RestartGame();
 
-  void CreateThreads();
-  void LoadMeshesAsync();
-  void LoadTexturesAsync();
-  void LoadAssetsAsync();
+  void QueueTextureLoad(const string& texture_filename, GLuint texture_id);
   FbxManager* GetSdkManager();
   double GetDeltaTime() { return delta_time_; }
 
@@ -0,0 +1,63 @@
+#include "simulation.hpp"
+#include "monsters.hpp"
+
+// Runs the game simulation on a fixed timestep without creating a window or
+// an OpenGL context.
+//
+// Usage: wizard_sim [num_frames] [step_in_seconds] [seed] [hashes_file]
+//
+// With a hashes file, writes "frame hash" for every simulated frame so two
+// builds can be compared frame by frame.
+int main(int argc, char** argv) {
+  int num_frames = 600;
+  double step = 1.0 / 60.0;
+  unsigned int seed = 0;
+  string hashes_file;
+  try {
+    if (argc > 1) num_frames = boost::lexical_cast<int>(argv[1]);
+    if (argc > 2) step = boost::lexical_cast<double>(argv[2]);
+    if (argc > 3) seed = boost::lexical_cast<unsigned int>(argv[3]);
+    if (argc > 4) hashes_file = argv[4];
+  } catch(boost::bad_lexical_cast const& e) {
+    cout << "Usage: wizard_sim [num_frames] [step_in_seconds] [seed] "
+      "[hashes_file]" << endl;
+    return 1;
+  }
+
+  SeedRandom(seed);
+
+  shared_ptr<FixedStepClock> clock = make_shared<FixedStepClock>(step);
+  SetClock(clock);
+
+  const string resources_dir = "resources";
+  const string shaders_dir = "shaders";
+
+  shared_ptr<Resources> resources = make_shared<Resources>(resources_dir,
+    shaders_dir, nullptr);
+  shared_ptr<Physics> physics = make_shared<Physics>(resources);
+  shared_ptr<CollisionResolver> collision_resolver =
+    make_shared<CollisionResolver>(resources);
+  shared_ptr<Monsters> monsters = make_shared<Monsters>(resources);
+  shared_ptr<AI> ai = make_shared<AI>(resources, monsters);
+
+  resources->LoadGame("config.xml", false);
+
+  Simulation simulation(resources, collision_resolver, ai, physics);
+  simulation.LoadArena("dungeons/dungeon1.txt");
+
+  ofstream hashes;
+  if (!hashes_file.empty()) {
+    hashes.open(hashes_file);
+  }
+
+  for (int i = 0; i < num_frames; i++) {
+    simulation.Step(clock);
+    if (hashes.is_open()) {
+      hashes << i << " " << hex << simulation.GetStateHash() << dec << endl;
+    }
+  }
+
+  simulation.PrintMetrics();
+  cout << "State hash: " << hex << simulation.GetStateHash() << dec << endl;
+  return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef __SIMD_HPP__
+#define __SIMD_HPP__
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// A few operations over kLanes floats at once. Loops written against these
+// step over their arrays kLanes at a time: eight floats with AVX when it is
+// enabled at compile time, four with SSE2 and one in the scalar fallback.
+// Arrays should be padded to a multiple of kMaxLanes. Loads and stores do
+// not need aligned memory.
+namespace simd {
+
+const int kMaxLanes = 8;
+
+#if defined(__AVX__)
+
+typedef __m256 Lanes;
+const int kLanes = 8;
+
+inline Lanes LoadLanes(const float* p) { return _mm256_loadu_ps(p); }
+inline void StoreLanes(float* p, Lanes a) { _mm256_storeu_ps(p, a); }
+inline Lanes Broadcast(float v) { return _mm256_set1_ps(v); }
+inline Lanes Add(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+inline Lanes Mul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+inline Lanes Div(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+inline Lanes Min(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+inline Lanes Max(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+inline Lanes Less(Lanes a, Lanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+inline Lanes LessEqual(Lanes a, Lanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+}
+inline Lanes And(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+inline Lanes Select(Lanes mask, Lanes a, Lanes b) {
+  return _mm256_blendv_ps(b, a, mask);
+}
+inline int MoveMask(Lanes mask) { return _mm256_movemask_ps(mask); }
+inline Lanes Floor(Lanes a) { return _mm256_floor_ps(a); }
+
+#elif defined(__SSE2__)
+
+typedef __m128 Lanes;
+const int kLanes = 4;
+
+inline Lanes LoadLanes(const float* p) { return _mm_loadu_ps(p); }
+inline void StoreLanes(float* p, Lanes a) { _mm_storeu_ps(p, a); }
+inline Lanes Broadcast(float v) { return _mm_set1_ps(v); }
+inline Lanes Add(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+inline Lanes Sub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+inline Lanes Mul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+inline Lanes Div(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+inline Lanes Min(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+inline Lanes Max(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+inline Lanes Less(Lanes a, Lanes b) { return _mm_cmplt_ps(a, b); }
+inline Lanes LessEqual(Lanes a, Lanes b) { return _mm_cmple_ps(a, b); }
+inline Lanes And(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+inline Lanes Select(Lanes mask, Lanes a, Lanes b) {
+  return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+inline int MoveMask(Lanes mask) { return _mm_movemask_ps(mask); }
+
+// SSE2 has no floor. Truncates and steps down where that rounded up, which
+// is exact for |a| < 2^31.
+inline Lanes Floor(Lanes a) {
+  Lanes t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+  return _mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(a, t), _mm_set1_ps(1.0f)));
+}
+
+#else
+
+typedef float Lanes;
+const int kLanes = 1;
+
+// Masks are 1 or 0.
+inline Lanes LoadLanes(const float* p) { return *p; }
+inline void StoreLanes(float* p, Lanes a) { *p = a; }
+inline Lanes Broadcast(float v) { return v; }
+inline Lanes Add(Lanes a, Lanes b) { return a + b; }
+inline Lanes Sub(Lanes a, Lanes b) { return a - b; }
+inline Lanes Mul(Lanes a, Lanes b) { return a * b; }
+inline Lanes Div(Lanes a, Lanes b) { return a / b; }
+inline Lanes Min(Lanes a, Lanes b) { return std::min(a, b); }
+inline Lanes Max(Lanes a, Lanes b) { return std::max(a, b); }
+inline Lanes Less(Lanes a, Lanes b) { return (a < b) ? 1.0f : 0.0f; }
+inline Lanes LessEqual(Lanes a, Lanes b) { return (a <= b) ? 1.0f : 0.0f; }
+inline Lanes And(Lanes a, Lanes b) { return a * b; }
+inline Lanes Select(Lanes mask, Lanes a, Lanes b) {
+  return (mask != 0.0f) ? a : b;
+}
+inline int MoveMask(Lanes mask) { return (mask != 0.0f) ? 1 : 0; }
+inline Lanes Floor(Lanes a) { return std::floor(a); }
+
+#endif
+
+} // namespace simd
+
+#endif // __SIMD_HPP__
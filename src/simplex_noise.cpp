@@ -25,8 +25,10 @@
  */
 
 #include "simplex_noise.hpp"
+#include "simd.hpp"
 
 #include <cstdint>  // int32_t/uint8_t
+#include <vector>
 
 /**
  * Computes the largest integer value not greater than the float one
@@ -269,6 +271,127 @@ float SimplexNoise::noise(float x, float y) {
 }
 
 
+/**
+ * Gradients of the 2D grad() function as (gx, gy), so that
+ * grad(hash, x, y) == gx * x + gy * y for every 8-bits hash value.
+ *
+ * The factors are 1 or 2 with a sign, so the products are exact and the sum
+ * is bit-identical to grad().
+ */
+struct Gradient2D {
+    float gx[256];
+    float gy[256];
+
+    Gradient2D() {
+        for (int32_t hash = 0; hash < 256; hash++) {
+            int32_t h = hash & 0x3F;
+            float u = (h & 1) ? -1.0f : 1.0f;
+            float v = (h & 2) ? -2.0f : 2.0f;
+            gx[hash] = h < 4 ? u : v;
+            gy[hash] = h < 4 ? v : u;
+        }
+    }
+};
+
+static const Gradient2D gradients2D;
+
+/**
+ * Contribution of one corner of the simplex to the noise of several points.
+ */
+static inline simd::Lanes corner(simd::Lanes x, simd::Lanes y,
+                                 const float* gx, const float* gy) {
+    using namespace simd;
+    const Lanes zero = Broadcast(0.0f);
+    Lanes t = Sub(Sub(Broadcast(0.5f), Mul(x, x)), Mul(y, y));
+    Lanes outside = Less(t, zero);
+    t = Mul(t, t);
+    Lanes grad = Add(Mul(LoadLanes(gx), x), Mul(LoadLanes(gy), y));
+    return Select(outside, zero, Mul(Mul(t, t), grad));
+}
+
+/**
+ * 2D Perlin simplex noise of count points
+ *
+ *  Same operations as the scalar version, in the same order, on kLanes points
+ * at once. Only the permutation table lookups are done one point at a time,
+ * since SSE2 and AVX have no gather. The last points that don't fill all the
+ * lanes use the scalar version.
+ *
+ * @param[in] x     x float coordinates
+ * @param[in] y     y float coordinates
+ * @param[in] count number of points
+ * @param[out] out  noise values, the same as noise(x[i], y[i])
+ */
+void SimplexNoise::noise(const float* x, const float* y, size_t count,
+                         float* out) {
+    using namespace simd;
+
+    const Lanes F2 = Broadcast(0.366025403f);
+    const Lanes G2 = Broadcast(0.211324865f);
+    const Lanes G2x2 = Broadcast(2.0f * 0.211324865f);
+    const Lanes zero = Broadcast(0.0f);
+    const Lanes one = Broadcast(1.0f);
+
+    float fi[kMaxLanes], fj[kMaxLanes], fi1[kMaxLanes];
+    float gx0[kMaxLanes], gy0[kMaxLanes];
+    float gx1[kMaxLanes], gy1[kMaxLanes];
+    float gx2[kMaxLanes], gy2[kMaxLanes];
+
+    size_t k = 0;
+    for (; k + kLanes <= count; k += kLanes) {
+        Lanes vx = LoadLanes(x + k);
+        Lanes vy = LoadLanes(y + k);
+
+        // Skew, find the cell and unskew its origin. The cell coordinates
+        // are small integers, so their sum as floats is exact.
+        Lanes s = Mul(Add(vx, vy), F2);
+        Lanes i = Floor(Add(vx, s));
+        Lanes j = Floor(Add(vy, s));
+        Lanes t = Mul(Add(i, j), G2);
+        Lanes x0 = Sub(vx, Sub(i, t));
+        Lanes y0 = Sub(vy, Sub(j, t));
+
+        // Lower triangle when x0 > y0.
+        Lanes lower = Less(y0, x0);
+        Lanes i1 = Select(lower, one, zero);
+        Lanes j1 = Select(lower, zero, one);
+
+        Lanes x1 = Add(Sub(x0, i1), G2);
+        Lanes y1 = Add(Sub(y0, j1), G2);
+        Lanes x2 = Add(Sub(x0, one), G2x2);
+        Lanes y2 = Add(Sub(y0, one), G2x2);
+
+        StoreLanes(fi, i);
+        StoreLanes(fj, j);
+        StoreLanes(fi1, i1);
+        for (int l = 0; l < kLanes; l++) {
+            int32_t ii = static_cast<int32_t>(fi[l]);
+            int32_t jj = static_cast<int32_t>(fj[l]);
+            int32_t ii1 = static_cast<int32_t>(fi1[l]);
+            int32_t jj1 = 1 - ii1;
+            uint8_t h0 = hash(ii + hash(jj));
+            uint8_t h1 = hash(ii + ii1 + hash(jj + jj1));
+            uint8_t h2 = hash(ii + 1 + hash(jj + 1));
+            gx0[l] = gradients2D.gx[h0];
+            gy0[l] = gradients2D.gy[h0];
+            gx1[l] = gradients2D.gx[h1];
+            gy1[l] = gradients2D.gy[h1];
+            gx2[l] = gradients2D.gx[h2];
+            gy2[l] = gradients2D.gy[h2];
+        }
+
+        Lanes n0 = corner(x0, y0, gx0, gy0);
+        Lanes n1 = corner(x1, y1, gx1, gy1);
+        Lanes n2 = corner(x2, y2, gx2, gy2);
+        StoreLanes(out + k, Mul(Broadcast(45.23065f), Add(Add(n0, n1), n2)));
+    }
+
+    for (; k < count; k++) {
+        out[k] = noise(x[k], y[k]);
+    }
+}
+
+
 /**
  * Fractal/Fractional Brownian Motion (fBm) summation of 1D Perlin Simplex noise
  *
@@ -319,3 +442,44 @@ float SimplexNoise::fractal(size_t octaves, float x, float y) const {
 
     return (output / denom);
 }
+
+/**
+ * Fractal/Fractional Brownian Motion (fBm) summation of 2D Perlin Simplex noise
+ * of count points, with the batch noise
+ *
+ * @param[in] octaves   number of fraction of noise to sum
+ * @param[in] x         x float coordinates
+ * @param[in] y         y float coordinates
+ * @param[in] count     number of points
+ * @param[out] out      noise values, the same as fractal(octaves, x[i], y[i])
+ */
+void SimplexNoise::fractal(size_t octaves, const float* x, const float* y,
+                           size_t count, float* out) const {
+    std::vector<float> u(count), v(count), n(count);
+    float denom = 0.f;
+    float frequency = mFrequency;
+    float amplitude = mAmplitude;
+
+    for (size_t k = 0; k < count; k++) {
+        out[k] = 0.f;
+    }
+
+    for (size_t i = 0; i < octaves; i++) {
+        for (size_t k = 0; k < count; k++) {
+            u[k] = x[k] * frequency;
+            v[k] = y[k] * frequency;
+        }
+        noise(u.data(), v.data(), count, n.data());
+        for (size_t k = 0; k < count; k++) {
+            out[k] += (amplitude * n[k]);
+        }
+        denom += amplitude;
+
+        frequency *= mLacunarity;
+        amplitude *= mPersistence;
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        out[k] = out[k] / denom;
+    }
+}
@@ -20,10 +20,14 @@ public:
     static float noise(float x);
     // 2D Perlin simplex noise
     static float noise(float x, float y);
+    // 2D Perlin simplex noise of count points, several at once with SIMD
+    static void noise(const float* x, const float* y, size_t count, float* out);
 
     // Fractal/Fractional Brownian Motion (fBm) noise summation
     float fractal(size_t octaves, float x) const;
     float fractal(size_t octaves, float x, float y) const;
+    void fractal(size_t octaves, const float* x, const float* y, size_t count,
+                 float* out) const;
 
     /**
      * Constructor of to initialize a fractal noise summation
@@ -0,0 +1,130 @@
+#include "simulation.hpp"
+
+namespace {
+
+double WallTime() {
+  return chrono::duration<double>(
+    chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+const uint64_t kFnvOffset = 14695981039346656037ull;
+const uint64_t kFnvPrime = 1099511628211ull;
+
+template<typename T>
+void HashValue(uint64_t& hash, const T& value) {
+  const unsigned char* bytes = (const unsigned char*) &value;
+  for (size_t i = 0; i < sizeof(T); i++) {
+    hash ^= bytes[i];
+    hash *= kFnvPrime;
+  }
+}
+
+} // namespace
+
+Simulation::Simulation(
+  shared_ptr<Resources> resources,
+  shared_ptr<CollisionResolver> collision_resolver,
+  shared_ptr<AI> ai,
+  shared_ptr<Physics> physics
+) : resources_(resources),
+    collision_resolver_(collision_resolver),
+    ai_(ai),
+    physics_(physics) {
+}
+
+void Simulation::Step() {
+  double start_time = WallTime();
+  physics_->Run();
+
+  double physics_end = WallTime();
+  collision_resolver_->Collide();
+
+  double collision_end = WallTime();
+  ai_->Run();
+
+  double ai_end = WallTime();
+  resources_->RunPeriodicEvents();
+
+  double end_time = WallTime();
+  metrics_.physics += physics_end - start_time;
+  metrics_.collision += collision_end - physics_end;
+  metrics_.ai += ai_end - collision_end;
+  metrics_.periodic_events += end_time - ai_end;
+  metrics_.frames++;
+}
+
+void Simulation::Step(shared_ptr<FixedStepClock> clock) {
+  clock->Tick();
+  resources_->SetDeltaTime(clock->GetStep());
+  Step();
+}
+
+void Simulation::Run(shared_ptr<FixedStepClock> clock, int num_frames) {
+  for (int i = 0; i < num_frames; i++) {
+    Step(clock);
+  }
+}
+
+uint64_t Simulation::GetStateHash() {
+  // Objects are combined with a sum so the result does not depend on the
+  // iteration order of the object map.
+  uint64_t state_hash = 0;
+  for (auto& [name, obj] : resources_->GetObjects()) {
+    uint64_t hash = kFnvOffset;
+    HashValue(hash, obj->id);
+    HashValue(hash, obj->position.x);
+    HashValue(hash, obj->position.y);
+    HashValue(hash, obj->position.z);
+    HashValue(hash, obj->life);
+
+    queue<shared_ptr<Action>> actions = obj->actions;
+    HashValue(hash, int(actions.size()));
+    while (!actions.empty()) {
+      HashValue(hash, actions.front()->type);
+      actions.pop();
+    }
+    state_hash += hash;
+  }
+  return state_hash;
+}
+
+void Simulation::LoadArena(const string& filename) {
+  shared_ptr<Configs> configs = resources_->GetConfigs();
+  Dungeon& dungeon = resources_->GetDungeon();
+  if (!dungeon.LoadDungeonFromFile(filename)) {
+    throw runtime_error(string("Could not load arena: ") + filename);
+  }
+
+  resources_->ChangeDungeonLevel(0);
+  resources_->DeleteAllObjects();
+  resources_->CreateDungeon(false);
+  vec3 pos = dungeon.GetTilePosition(ivec2(6, 6));
+  configs->wave_reset_timer = GetTime() + 5.0f;
+
+  resources_->GetPlayer()->ChangePosition(pos);
+  configs->render_scene = "arena";
+  resources_->CalculateCollisionData();
+  resources_->GenerateOptimizedOctree();
+
+  configs->wave_monsters.clear();
+  configs->current_wave = -1;
+
+  for (int i = 0; i < 11; i++) {
+    resources_->LearnSpell(i);
+  }
+}
+
+void Simulation::PrintMetrics() {
+  if (metrics_.frames == 0) return;
+
+  double total = metrics_.physics + metrics_.collision + metrics_.ai +
+    metrics_.periodic_events;
+  double ms = 1000.0 / double(metrics_.frames);
+  cout << "Frames: " << metrics_.frames << endl;
+  cout << "Physics: " << metrics_.physics * ms << " ms / frame" << endl;
+  cout << "Collision: " << metrics_.collision * ms << " ms / frame" << endl;
+  cout << "AI: " << metrics_.ai * ms << " ms / frame" << endl;
+  cout << "Periodic events: " << metrics_.periodic_events * ms
+    << " ms / frame" << endl;
+  cout << "Total: " << total * ms << " ms / frame" << endl;
+}
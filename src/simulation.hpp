@@ -0,0 +1,55 @@
+#ifndef __SIMULATION_HPP__
+#define __SIMULATION_HPP__
+
+#include "resources.hpp"
+#include "collision_resolver.hpp"
+#include "ai.hpp"
+#include "physics.hpp"
+
+struct SimulationMetrics {
+  int frames = 0;
+  double physics = 0.0;
+  double collision = 0.0;
+  double ai = 0.0;
+  double periodic_events = 0.0;
+};
+
+// Runs the game simulation (physics, collision, AI and periodic events)
+// without touching the renderer, so it can be stepped by the engine loop or
+// by a headless fixed-timestep driver.
+class Simulation {
+  shared_ptr<Resources> resources_;
+  shared_ptr<CollisionResolver> collision_resolver_;
+  shared_ptr<AI> ai_;
+  shared_ptr<Physics> physics_;
+
+  SimulationMetrics metrics_;
+
+ public:
+  Simulation(
+    shared_ptr<Resources> resources,
+    shared_ptr<CollisionResolver> collision_resolver,
+    shared_ptr<AI> ai,
+    shared_ptr<Physics> physics
+  );
+
+  // One simulation frame at the current clock time.
+  void Step();
+
+  // Advances the clock by one tick and steps the simulation.
+  void Step(shared_ptr<FixedStepClock> clock);
+
+  void Run(shared_ptr<FixedStepClock> clock, int num_frames);
+
+  // Hash of every object's position, life and pending actions. Two runs with
+  // the same seed and input should produce the same hash on every frame.
+  uint64_t GetStateHash();
+
+  void LoadArena(const string& filename);
+
+  const SimulationMetrics& GetMetrics() { return metrics_; }
+  void ClearMetrics() { metrics_ = SimulationMetrics(); }
+  void PrintMetrics();
+};
+
+#endif // __SIMULATION_HPP__
@@ -0,0 +1,59 @@
+#include "game_object.hpp"
+#include "space_partition.hpp"
+
+namespace {
+
+int GetChildIndex(const OctreeNode& octree_node, const vec3& center,
+  bool use_quadtree) {
+  int index = 0;
+  for (int i = 0; i < 3; i++) {
+    if (center[i] > octree_node.center[i]) {
+      index |= (1 << i); // ZYX
+    }
+  }
+  return use_quadtree ? kOctreeToQuadTreeIndex[index] : index;
+}
+
+} // namespace
+
+bool FitsInLooseOctreeNode(const OctreeNode& octree_node,
+  const BoundingSphere& bounding_sphere, bool use_quadtree) {
+  for (int i = 0; i < 3; i++) {
+    if (i == 1 && use_quadtree) continue;
+    float delta = abs(bounding_sphere.center[i] - octree_node.center[i]);
+    if (delta + bounding_sphere.radius >
+      octree_node.loose_half_dimensions[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+shared_ptr<OctreeNode> FindLooseOctreeNode(shared_ptr<OctreeNode> root,
+  const BoundingSphere& bounding_sphere, int max_depth, bool use_quadtree) {
+  shared_ptr<OctreeNode> octree_node = root;
+  for (int depth = 0; depth < max_depth; depth++) {
+    int index = GetChildIndex(*octree_node, bounding_sphere.center,
+      use_quadtree);
+    shared_ptr<OctreeNode> child = octree_node->children[index];
+    if (!child || !FitsInLooseOctreeNode(*child, bounding_sphere,
+      use_quadtree)) {
+      break;
+    }
+    octree_node = child;
+  }
+  return octree_node;
+}
+
+bool NeedsLooseOctreeRelocation(const OctreeNode& octree_node,
+  const BoundingSphere& bounding_sphere, bool use_quadtree) {
+  if (!FitsInLooseOctreeNode(octree_node, bounding_sphere, use_quadtree)) {
+    return true;
+  }
+
+  int index = GetChildIndex(octree_node, bounding_sphere.center,
+    use_quadtree);
+  shared_ptr<OctreeNode> child = octree_node.children[index];
+  return child && FitsInLooseOctreeNode(*child, bounding_sphere,
+    use_quadtree);
+}
@@ -25,11 +25,146 @@ struct SortedStaticObj {
     : obj(obj), start(start), end(end) {}
 };
 
+// Intrusive doubly linked list of the objects in an octree node. The links
+// are stored in the objects, so linking and unlinking an object is O(1)
+// and never allocates.
+//
+// Iterating takes a snapshot of strong references to the objects, so the
+// loop body can unlink, relocate or drop any object of the list, not only
+// the current one. Objects unlinked from the list before the loop reaches
+// them are skipped, and objects that are being destroyed are left out. The
+// snapshot buffers are reused per thread, so iterating doesn't allocate
+// once they have grown.
+class ObjectList {
+  typedef vector<shared_ptr<GameObject>> Snapshot;
+
+  OctreeListType type_;
+  GameObject* head_ = nullptr;
+  int size_ = 0;
+
+  static vector<unique_ptr<Snapshot>>& GetSnapshotPool() {
+    static thread_local vector<unique_ptr<Snapshot>> pool;
+    return pool;
+  }
+
+ public:
+  class iterator {
+    const ObjectList* list_ = nullptr;
+    unique_ptr<Snapshot> objs_;
+    size_t i_ = 0;
+
+    bool AtEnd() const { return !objs_ || i_ >= objs_->size(); }
+
+    void SkipUnlinked() {
+      while (!AtEnd() && !list_->contains((*objs_)[i_].get())) i_++;
+    }
+
+   public:
+    iterator() {}
+
+    iterator(const ObjectList* list) : list_(list) {
+      vector<unique_ptr<Snapshot>>& pool = GetSnapshotPool();
+      if (pool.empty()) {
+        objs_ = make_unique<Snapshot>();
+      } else {
+        objs_ = move(pool.back());
+        pool.pop_back();
+      }
+
+      for (GameObject* obj = list->head_; obj;
+        obj = obj->octree_links[list->type_].next) {
+        shared_ptr<GameObject> strong_ref = obj->weak_from_this().lock();
+        if (strong_ref) objs_->push_back(move(strong_ref));
+      }
+    }
+
+    iterator(iterator&&) = default;
+    iterator(const iterator&) = delete;
+    iterator& operator=(const iterator&) = delete;
+
+    ~iterator() {
+      if (!objs_) return;
+      objs_->clear();
+      GetSnapshotPool().push_back(move(objs_));
+    }
+
+    shared_ptr<GameObject> operator*() const { return (*objs_)[i_]; }
+
+    iterator& operator++() {
+      i_++;
+      SkipUnlinked();
+      return *this;
+    }
+
+    bool operator!=(const iterator& other) const {
+      return AtEnd() != other.AtEnd(); 
+    }
+  };
+
+  ObjectList(OctreeListType type) : type_(type) {}
+  ObjectList(const ObjectList&) = delete;
+  ObjectList& operator=(const ObjectList&) = delete;
+  ~ObjectList() { clear(); }
+
+  void insert(GameObject* obj) {
+    OctreeLink& link = obj->octree_links[type_];
+    if (link.list == this) return;
+    if (link.list) link.list->erase(obj);
+
+    link.list = this;
+    link.prev = nullptr;
+    link.next = head_;
+    if (head_) head_->octree_links[type_].prev = obj;
+    head_ = obj;
+    size_++;
+  }
+
+  void erase(GameObject* obj) {
+    OctreeLink& link = obj->octree_links[type_];
+    if (link.list != this) return;
+
+    if (link.prev) link.prev->octree_links[type_].next = link.next;
+    else head_ = link.next;
+    if (link.next) link.next->octree_links[type_].prev = link.prev;
+    link = OctreeLink();
+    size_--;
+  }
+
+  bool contains(const GameObject* obj) const {
+    return obj->octree_links[type_].list == this;
+  }
+
+  void clear() {
+    while (head_) erase(head_);
+  }
+
+  iterator begin() const { return iterator(this); }
+  iterator end() const { return iterator(); }
+  int size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+};
+
+// Child index of an octree node for each octant when the octree is a
+// quadtree, which ignores the y axis.
+const int kOctreeToQuadTreeIndex[8] = { 0, 1, 0, 1, 4, 5, 4, 5 };
+
+struct OctreeMetrics {
+  // Calls to UpdateObjectPosition.
+  int num_updates = 0;
+
+  // Updates that had to reinsert the object in the octree.
+  int num_relocations = 0;
+};
+
 struct OctreeNode {
   shared_ptr<OctreeNode> parent = nullptr;
 
   vec3 center;
   vec3 half_dimensions;
+
+  // Bounds of the moving objects in the node for the loose octree. Same as
+  // half_dimensions when it is disabled.
+  vec3 loose_half_dimensions;
   shared_ptr<OctreeNode> children[8] {
     nullptr, nullptr, nullptr, nullptr, 
     nullptr, nullptr, nullptr, nullptr };
@@ -45,21 +180,37 @@ struct OctreeNode {
   vector<shared_ptr<GameObject>> down_pass, up_pass;
 
   // TODO: this should probably be removed.
-  unordered_map<int, shared_ptr<GameObject>> objects;
+  ObjectList objects { OCTREE_OBJECTS };
 
   vector<SortedStaticObj> static_objects;
-  unordered_map<int, shared_ptr<GameObject>> moving_objs;
-  unordered_map<int, shared_ptr<GameObject>> creatures;
-  unordered_map<int, shared_ptr<GameObject>> lights;
-  unordered_map<int, shared_ptr<GameObject>> items;
+  ObjectList moving_objs { OCTREE_MOVING_OBJS };
+  ObjectList creatures { OCTREE_CREATURES };
+  ObjectList lights { OCTREE_LIGHTS };
+  ObjectList items { OCTREE_ITEMS };
 
   vector<shared_ptr<Sector>> sectors;
   unordered_map<int, shared_ptr<Region>> regions;
 
   OctreeNode() {}
   OctreeNode(vec3 center, vec3 half_dimensions) : center(center), 
-    half_dimensions(half_dimensions) {}
+    half_dimensions(half_dimensions), 
+    loose_half_dimensions(half_dimensions) {}
 };
 
+// Loose octree placement of moving objects. A quadtree ignores the y axis.
+bool FitsInLooseOctreeNode(const OctreeNode& octree_node,
+  const BoundingSphere& bounding_sphere, bool use_quadtree);
+
+// Deepest node under root whose loose bounds contain the sphere. The child
+// is chosen by the sphere center alone, so an object only stays up in the
+// tree when it is larger than the child nodes.
+shared_ptr<OctreeNode> FindLooseOctreeNode(shared_ptr<OctreeNode> root,
+  const BoundingSphere& bounding_sphere, int max_depth, bool use_quadtree);
+
+// Whether an object in octree_node has to move to another node: it left
+// the loose bounds, or it now fits in the child it would descend into.
+bool NeedsLooseOctreeRelocation(const OctreeNode& octree_node,
+  const BoundingSphere& bounding_sphere, bool use_quadtree);
+
 #endif // __SPACE_PARTITION_HPP__
 
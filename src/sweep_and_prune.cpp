@@ -0,0 +1,253 @@
+#include "sweep_and_prune.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <stdexcept>
+
+namespace {
+
+// Committing more proxies than this at once rebuilds the endpoint lists.
+const int kMaxIncrementalInserts = 32;
+
+} // namespace
+
+uint64_t SweepAndPrune::GetPairKey(int handle1, int handle2) {
+  if (handle1 > handle2) swap(handle1, handle2);
+  return (uint64_t(handle1) << 32) | uint32_t(handle2);
+}
+
+bool SweepAndPrune::Overlaps(int handle1, int handle2) {
+  const Proxy& a = proxies_[handle1];
+  const Proxy& b = proxies_[handle2];
+  for (int axis = 0; axis < 3; axis++) {
+    if (a.min[axis] > b.max[axis] || b.min[axis] > a.max[axis]) return false;
+  }
+  return true;
+}
+
+void SweepAndPrune::AddPair(int handle1, int handle2) {
+  if (handle1 == handle2) return;
+  if (proxies_[handle1].fixed && proxies_[handle2].fixed) return;
+  pairs_.insert(GetPairKey(handle1, handle2));
+}
+
+void SweepAndPrune::RemovePair(int handle1, int handle2) {
+  pairs_.erase(GetPairKey(handle1, handle2));
+}
+
+void SweepAndPrune::SortDown(int axis, int index) {
+  vector<Endpoint>& endpoints = endpoints_[axis];
+  Endpoint endpoint = endpoints[index];
+  const int handle = endpoint.GetProxy();
+
+  for (; index > 0 && IsBefore(endpoint, endpoints[index - 1]); index--) {
+    const Endpoint& prev = endpoints[index - 1];
+    const int other = prev.GetProxy();
+    if (!endpoint.IsMax() && prev.IsMax()) {
+      // Min passed a max: the boxes may start overlapping.
+      if (Overlaps(handle, other)) AddPair(handle, other);
+    } else if (endpoint.IsMax() && !prev.IsMax()) {
+      // Max passed a min: the boxes may stop overlapping.
+      if (!Overlaps(handle, other)) RemovePair(handle, other);
+    }
+
+    endpoints[index] = prev;
+    proxies_[other].endpoints[axis][prev.IsMax()] = index;
+    metrics_.num_swaps++;
+  }
+
+  endpoints[index] = endpoint;
+  proxies_[handle].endpoints[axis][endpoint.IsMax()] = index;
+}
+
+void SweepAndPrune::SortUp(int axis, int index) {
+  vector<Endpoint>& endpoints = endpoints_[axis];
+  Endpoint endpoint = endpoints[index];
+  const int handle = endpoint.GetProxy();
+
+  const int last = endpoints.size() - 1;
+  for (; index < last && IsBefore(endpoints[index + 1], endpoint); index++) {
+    const Endpoint& next = endpoints[index + 1];
+    const int other = next.GetProxy();
+    if (endpoint.IsMax() && !next.IsMax()) {
+      if (Overlaps(handle, other)) AddPair(handle, other);
+    } else if (!endpoint.IsMax() && next.IsMax()) {
+      if (!Overlaps(handle, other)) RemovePair(handle, other);
+    }
+
+    endpoints[index] = next;
+    proxies_[other].endpoints[axis][next.IsMax()] = index;
+    metrics_.num_swaps++;
+  }
+
+  endpoints[index] = endpoint;
+  proxies_[handle].endpoints[axis][endpoint.IsMax()] = index;
+}
+
+void SweepAndPrune::UpdateEndpoints(int handle) {
+  Proxy& proxy = proxies_[handle];
+  for (int axis = 0; axis < 3; axis++) {
+    Endpoint& min_endpoint = endpoints_[axis][proxy.endpoints[axis][0]];
+    Endpoint& max_endpoint = endpoints_[axis][proxy.endpoints[axis][1]];
+    const float old_min = min_endpoint.value;
+    const float old_max = max_endpoint.value;
+    min_endpoint.value = proxy.min[axis];
+    max_endpoint.value = proxy.max[axis];
+
+    // Growing first, then shrinking, so a min never has to pass its own max.
+    if (proxy.min[axis] < old_min) SortDown(axis, proxy.endpoints[axis][0]);
+    if (proxy.max[axis] > old_max) SortUp(axis, proxy.endpoints[axis][1]);
+    if (proxy.min[axis] > old_min) SortUp(axis, proxy.endpoints[axis][0]);
+    if (proxy.max[axis] < old_max) SortDown(axis, proxy.endpoints[axis][1]);
+  }
+}
+
+int SweepAndPrune::AddProxy(int id, const vec3& min, const vec3& max,
+  bool fixed) {
+  int handle;
+  if (free_proxies_.empty()) {
+    handle = proxies_.size();
+    proxies_.push_back(Proxy());
+  } else {
+    handle = free_proxies_.back();
+    free_proxies_.pop_back();
+  }
+
+  Proxy& proxy = proxies_[handle];
+  proxy.id = id;
+  proxy.used = true;
+  proxy.fixed = fixed;
+  proxy.pending = true;
+  proxy.min = min;
+  proxy.max = max;
+  pending_proxies_.push_back(handle);
+  metrics_.num_proxies++;
+  return handle;
+}
+
+void SweepAndPrune::RemoveProxy(int handle) {
+  Proxy& proxy = proxies_[handle];
+  if (!proxy.used) throw runtime_error("Invalid broadphase proxy");
+
+  if (proxy.pending) {
+    pending_proxies_.erase(find(pending_proxies_.begin(),
+      pending_proxies_.end(), handle));
+  } else {
+    // Moving the box out to infinity removes its pairs on the way and leaves
+    // its endpoints at the end of the lists.
+    proxy.min = proxy.max = vec3(FLT_MAX);
+    UpdateEndpoints(handle);
+    for (int axis = 0; axis < 3; axis++) {
+      vector<Endpoint>& endpoints = endpoints_[axis];
+      const int size = endpoints.size();
+      if (endpoints[size - 1].GetProxy() != handle ||
+          endpoints[size - 2].GetProxy() != handle) {
+        throw runtime_error("Broadphase endpoints out of order");
+      }
+      endpoints.resize(size - 2);
+    }
+  }
+
+  proxy = Proxy();
+  free_proxies_.push_back(handle);
+  metrics_.num_proxies--;
+}
+
+void SweepAndPrune::UpdateProxy(int handle, const vec3& min,
+  const vec3& max) {
+  Proxy& proxy = proxies_[handle];
+  proxy.min = min;
+  proxy.max = max;
+  if (!proxy.pending) UpdateEndpoints(handle);
+}
+
+void SweepAndPrune::InsertPending() {
+  for (int handle : pending_proxies_) {
+    Proxy& proxy = proxies_[handle];
+    proxy.pending = false;
+
+    // Endpoints start at infinity and sort down into place.
+    for (int axis = 0; axis < 3; axis++) {
+      vector<Endpoint>& endpoints = endpoints_[axis];
+      proxy.endpoints[axis][0] = endpoints.size();
+      endpoints.push_back({ FLT_MAX, uint32_t(handle << 1) });
+      proxy.endpoints[axis][1] = endpoints.size();
+      endpoints.push_back({ FLT_MAX, uint32_t(handle << 1) | 1 });
+    }
+    UpdateEndpoints(handle);
+  }
+  pending_proxies_.clear();
+}
+
+void SweepAndPrune::Rebuild() {
+  for (int axis = 0; axis < 3; axis++) {
+    vector<Endpoint>& endpoints = endpoints_[axis];
+    endpoints.clear();
+    for (size_t handle = 0; handle < proxies_.size(); handle++) {
+      const Proxy& proxy = proxies_[handle];
+      if (!proxy.used) continue;
+      endpoints.push_back({ proxy.min[axis], uint32_t(handle << 1) });
+      endpoints.push_back({ proxy.max[axis], uint32_t(handle << 1) | 1 });
+    }
+
+    sort(endpoints.begin(), endpoints.end(), IsBefore);
+    for (size_t i = 0; i < endpoints.size(); i++) {
+      proxies_[endpoints[i].GetProxy()].endpoints[axis][endpoints[i].IsMax()] =
+        i;
+    }
+  }
+
+  for (int handle : pending_proxies_) proxies_[handle].pending = false;
+  pending_proxies_.clear();
+
+  // A single sweep along x finds all the pairs.
+  pairs_.clear();
+  vector<int> active;
+  for (const Endpoint& endpoint : endpoints_[0]) {
+    const int handle = endpoint.GetProxy();
+    if (endpoint.IsMax()) {
+      auto it = find(active.begin(), active.end(), handle);
+      *it = active.back();
+      active.pop_back();
+      continue;
+    }
+
+    for (int other : active) {
+      if (Overlaps(handle, other)) AddPair(handle, other);
+    }
+    active.push_back(handle);
+  }
+  metrics_.num_rebuilds++;
+}
+
+void SweepAndPrune::Commit() {
+  if (pending_proxies_.empty()) return;
+  if (pending_proxies_.size() > kMaxIncrementalInserts) {
+    Rebuild();
+  } else {
+    InsertPending();
+  }
+}
+
+void SweepAndPrune::GetPairs(vector<pair<int, int>>& pairs) {
+  pairs.clear();
+  pairs.reserve(pairs_.size());
+  for (uint64_t key : pairs_) {
+    pairs.push_back({ proxies_[key >> 32].id,
+      proxies_[key & 0xFFFFFFFF].id });
+  }
+}
+
+void SweepAndPrune::Clear() {
+  for (int axis = 0; axis < 3; axis++) endpoints_[axis].clear();
+  proxies_.clear();
+  free_proxies_.clear();
+  pending_proxies_.clear();
+  pairs_.clear();
+  metrics_ = SweepAndPruneMetrics();
+}
+
+SweepAndPruneMetrics SweepAndPrune::GetMetrics() {
+  metrics_.num_pairs = pairs_.size();
+  return metrics_;
+}
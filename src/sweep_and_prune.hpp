@@ -0,0 +1,91 @@
+#ifndef __SWEEP_AND_PRUNE_HPP__
+#define __SWEEP_AND_PRUNE_HPP__
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+struct SweepAndPruneMetrics {
+  int num_proxies = 0;
+  int num_pairs = 0;
+  int num_swaps = 0;
+  int num_rebuilds = 0;
+};
+
+// Incremental sweep and prune broadphase. Every proxy keeps its min and max
+// endpoints in a sorted list per axis. Moving a proxy insertion sorts its
+// endpoints into place and, since only swaps between a min and a max endpoint
+// can change whether two boxes overlap, the overlapping pairs are updated as
+// the swaps happen. With temporal coherence most updates move few endpoints.
+// Pairs of fixed proxies are never reported.
+class SweepAndPrune {
+  struct Endpoint {
+    float value;
+    // Proxy handle shifted left by one, the lowest bit set for max endpoints.
+    uint32_t data;
+
+    int GetProxy() const { return data >> 1; }
+    bool IsMax() const { return data & 1; }
+  };
+
+  struct Proxy {
+    int id = -1;
+    bool used = false;
+    bool fixed = false;
+    bool pending = false;
+    vec3 min;
+    vec3 max;
+
+    // Indices of the min and max endpoints in each axis list.
+    int endpoints[3][2];
+  };
+
+  vector<Endpoint> endpoints_[3];
+  vector<Proxy> proxies_;
+  vector<int> free_proxies_;
+  vector<int> pending_proxies_;
+  unordered_set<uint64_t> pairs_;
+  SweepAndPruneMetrics metrics_;
+
+  // Endpoints with equal values sort min before max, so touching boxes
+  // overlap in the same way as in Overlaps.
+  static bool IsBefore(const Endpoint& a, const Endpoint& b) {
+    return a.value < b.value ||
+      (a.value == b.value && !a.IsMax() && b.IsMax());
+  }
+
+  uint64_t GetPairKey(int handle1, int handle2);
+  bool Overlaps(int handle1, int handle2);
+  void AddPair(int handle1, int handle2);
+  void RemovePair(int handle1, int handle2);
+
+  void SortDown(int axis, int index);
+  void SortUp(int axis, int index);
+  void UpdateEndpoints(int handle);
+  void InsertPending();
+  void Rebuild();
+
+ public:
+  // Returns a handle for the proxy. The proxy takes part in pairs after the
+  // next Commit.
+  int AddProxy(int id, const vec3& min, const vec3& max, bool fixed = false);
+  void RemoveProxy(int handle);
+  void UpdateProxy(int handle, const vec3& min, const vec3& max);
+
+  // Inserts the proxies added since the last commit. A few are sorted into
+  // place, many at once rebuild the lists from scratch.
+  void Commit();
+
+  // Ids of the overlapping pairs.
+  void GetPairs(vector<pair<int, int>>& pairs);
+
+  int GetId(int handle) { return proxies_[handle].id; }
+  void Clear();
+  SweepAndPruneMetrics GetMetrics();
+};
+
+#endif // __SWEEP_AND_PRUNE_HPP__
@@ -0,0 +1,66 @@
+#include "symbol.hpp"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+struct SymbolTable {
+  mutex names_mutex;
+
+  // A deque never moves its elements, so references returned by GetName
+  // stay valid while other threads intern new names.
+  deque<string> names = { "" };
+  unordered_map<string, uint32_t> ids = { { "", 0 } };
+};
+
+// Function local so symbols can be created during static initialization.
+SymbolTable& GetSymbolTable() {
+  static SymbolTable table;
+  return table;
+}
+
+} // namespace
+
+Symbol::Symbol(const string& name) {
+  SymbolTable& table = GetSymbolTable();
+  lock_guard<mutex> lock(table.names_mutex);
+  auto it = table.ids.find(name);
+  if (it != table.ids.end()) {
+    id_ = it->second;
+    return;
+  }
+
+  id_ = table.names.size();
+  table.names.push_back(name);
+  table.ids[name] = id_;
+}
+
+const string& Symbol::GetName() const {
+  SymbolTable& table = GetSymbolTable();
+  lock_guard<mutex> lock(table.names_mutex);
+  return table.names[id_];
+}
+
+string GetSymbolName(uint32_t id) {
+  SymbolTable& table = GetSymbolTable();
+  lock_guard<mutex> lock(table.names_mutex);
+  if (id >= table.names.size()) return "";
+  return table.names[id];
+}
+
+Symbol Symbol::Find(const string& name) {
+  SymbolTable& table = GetSymbolTable();
+  lock_guard<mutex> lock(table.names_mutex);
+  Symbol symbol;
+  auto it = table.ids.find(name);
+  if (it != table.ids.end()) symbol.id_ = it->second;
+  return symbol;
+}
+
+int GetNumSymbols() {
+  SymbolTable& table = GetSymbolTable();
+  lock_guard<mutex> lock(table.names_mutex);
+  return table.names.size();
+}
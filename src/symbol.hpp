@@ -0,0 +1,54 @@
+#ifndef __SYMBOL_HPP__
+#define __SYMBOL_HPP__
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+using namespace std;
+
+// Interned string. Every distinct name is stored once in a global table and
+// a symbol is just its 32-bit index, so comparing and hashing symbols never
+// touches the characters. Interning locks the table, so symbols for hot
+// paths should be created at load time or kept in constants.
+class Symbol {
+  uint32_t id_ = 0;
+
+ public:
+  // The empty string.
+  Symbol() {}
+  explicit Symbol(const string& name);
+  explicit Symbol(const char* name) : Symbol(string(name)) {}
+
+  uint32_t GetId() const { return id_; }
+  bool empty() const { return id_ == 0; }
+
+  // Reverse lookup, mostly for debugging.
+  const string& GetName() const;
+
+  // Returns the symbol of name without interning it, or the empty symbol if
+  // name was never interned.
+  static Symbol Find(const string& name);
+
+  bool operator==(const Symbol& other) const { return id_ == other.id_; }
+  bool operator!=(const Symbol& other) const { return id_ != other.id_; }
+  bool operator<(const Symbol& other) const { return id_ < other.id_; }
+};
+
+// Returns the name of the symbol with this id or an empty string if the id
+// was never assigned.
+string GetSymbolName(uint32_t id);
+
+int GetNumSymbols();
+
+namespace std {
+
+template<> struct hash<Symbol> {
+  size_t operator()(const Symbol& symbol) const {
+    return hash<uint32_t>()(symbol.GetId());
+  }
+};
+
+} // namespace std
+
+#endif // __SYMBOL_HPP__
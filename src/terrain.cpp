@@ -388,7 +388,7 @@ void Terrain::AddPointLightsToProgram(shared_ptr<Clipmap> clipmap,
         light_color = asset->light_color;
         quadratic = asset->quadratic;
         if (asset->flickers) {
-          float noise = 0.125 * sin(glfwGetTime() * 4.0) + 0.1 * sin(glfwGetTime() * 10.0f) + 0.075 * sin(glfwGetTime() * 20.0f);
+          float noise = 0.125 * sin(GetTime() * 4.0) + 0.1 * sin(GetTime() * 10.0f) + 0.075 * sin(GetTime() * 20.0f);
           quadratic += 0.5 * asset->quadratic * noise;
         }
       }
@@ -87,24 +87,24 @@ bool TextEditor::ProcessDefaultInput(int key, int scancode, int action,
       if (cursor_col_ >= content_[cursor_row_].size()) cursor_col_ = content_[cursor_row_].size() - 1;
       if (cursor_col_ > 0) cursor_col_--;
       if (cursor_col_ < 0) cursor_col_ = 0;
-      repeat_wait = glfwGetTime() + 0.5;
+      repeat_wait = GetTime() + 0.5;
       return true;
     case GLFW_KEY_J: 
       if (mode == 1) return true;
       if (cursor_row_ < content_.size() - 1) cursor_row_++;
       if (cursor_row_ >= start_line + 30) start_line++; 
-      repeat_wait = glfwGetTime() + 0.5;
+      repeat_wait = GetTime() + 0.5;
       return true;
     case GLFW_KEY_K: 
       if (mode == 1) return true;
       if (cursor_row_ > 0) cursor_row_--;
       if (cursor_row_ < start_line) start_line--; 
-      repeat_wait = glfwGetTime() + 0.5;
+      repeat_wait = GetTime() + 0.5;
       return true;
     case GLFW_KEY_L: 
       if (mode == 1) return true;
       if (content_.size() > 0 && cursor_col_ < content_[cursor_row_].size() - 1) cursor_col_++;
-      repeat_wait = glfwGetTime() + 0.5;
+      repeat_wait = GetTime() + 0.5;
       return true;
     case GLFW_KEY_I: {
       if (!editable) return true;
@@ -403,7 +403,7 @@ void TextEditor::Draw(int win_x, int win_y) {
   draw_2d_->DrawRectangle(win_x-1, kWindowHeight - 99, win_x + 602, 602, vec3(1, 0.69, 0.23));
   draw_2d_->DrawRectangle(win_x, kWindowHeight - 100, win_x + 600, 600, vec3(0.3));
 
-  double current_time = glfwGetTime();
+  double current_time = GetTime();
   vector<string> lines = content_;
 
   int digits = 0;
@@ -0,0 +1,247 @@
+#include "texture_cache.hpp"
+#include "mapped_file.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+const uint32_t kTextureCacheMagic = 0x58455442; // "BTEX"
+const uint32_t kTextureCacheVersion = 2;
+const size_t kLevelAlignment = 16;
+const int kMaxTextureLevels = 16;
+
+// Offset from the start of the file and size in bytes.
+struct TextureCacheLevel {
+  uint32_t width;
+  uint32_t height;
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct TextureCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint32_t format;
+  uint32_t usage;
+  uint32_t num_levels;
+  uint32_t padding;
+  TextureCacheLevel levels[kMaxTextureLevels];
+};
+
+enum TextureCacheState {
+  TEXTURE_CACHE_MISSING = 0,
+  TEXTURE_CACHE_STALE,
+  TEXTURE_CACHE_VALID
+};
+
+} // namespace
+
+uint64_t HashFile(const string& filename) {
+  MappedFile file(filename);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  const unsigned char* bytes = (const unsigned char*) file.data();
+  for (size_t i = 0; i < file.size(); i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+void SaveTextureData(ostream& os, const CompressedTexture& texture,
+  uint64_t source_hash) {
+  if (texture.levels.size() > kMaxTextureLevels) {
+    throw runtime_error("Too many texture levels");
+  }
+
+  TextureCacheHeader header;
+  memset(&header, 0, sizeof(TextureCacheHeader));
+  header.magic = kTextureCacheMagic;
+  header.version = kTextureCacheVersion;
+  header.source_hash = source_hash;
+  header.format = texture.format;
+  header.usage = texture.usage;
+  header.num_levels = texture.levels.size();
+
+  string bytes(sizeof(TextureCacheHeader), '\0');
+  for (size_t i = 0; i < texture.levels.size(); i++) {
+    const TextureLevel& level = texture.levels[i];
+    bytes.resize((bytes.size() + kLevelAlignment - 1) / kLevelAlignment *
+      kLevelAlignment, '\0');
+    header.levels[i].width = level.width;
+    header.levels[i].height = level.height;
+    header.levels[i].offset = bytes.size();
+    header.levels[i].size = level.data.size();
+    bytes.append((const char*) level.data.data(), level.data.size());
+  }
+
+  memcpy(&bytes[0], &header, sizeof(TextureCacheHeader));
+  os.write(bytes.data(), bytes.size());
+}
+
+uint64_t LoadTextureData(const char* bytes, size_t size,
+  CompressedTexture& texture) {
+  TextureCacheHeader header;
+  if (size < sizeof(TextureCacheHeader)) {
+    throw runtime_error("Invalid texture cache data");
+  }
+  memcpy(&header, bytes, sizeof(TextureCacheHeader));
+  if (header.magic != kTextureCacheMagic) {
+    throw runtime_error("Invalid texture cache data");
+  }
+  if (header.version != kTextureCacheVersion) {
+    throw runtime_error("Unsupported texture cache version " +
+      to_string(header.version));
+  }
+  if (header.format >= NUM_TEXTURE_FORMATS ||
+    header.usage >= NUM_TEXTURE_USAGES ||
+    header.num_levels > kMaxTextureLevels) {
+    throw runtime_error("Invalid texture cache data");
+  }
+
+  texture.format = TextureFormat(header.format);
+  texture.usage = TextureUsage(header.usage);
+  texture.levels.resize(header.num_levels);
+  for (uint32_t i = 0; i < header.num_levels; i++) {
+    const TextureCacheLevel& entry = header.levels[i];
+    if (entry.offset > size || entry.size > size - entry.offset ||
+      entry.size != GetLevelSize(texture.format, entry.width, entry.height)) {
+      throw runtime_error("Truncated texture cache data");
+    }
+
+    TextureLevel& level = texture.levels[i];
+    level.width = entry.width;
+    level.height = entry.height;
+    level.data.assign(bytes + entry.offset, bytes + entry.offset + entry.size);
+  }
+  return header.source_hash;
+}
+
+string GetTextureCachePath(const string& filename) {
+  return ReplaceExtension(filename, ".btex");
+}
+
+namespace {
+
+// A stale cache only sets the usage of the texture.
+TextureCacheState ReadTextureCache(const string& filename,
+  CompressedTexture& texture) {
+  const string cache_filename = GetTextureCachePath(filename);
+  struct stat st;
+  if (stat(cache_filename.c_str(), &st) != 0) return TEXTURE_CACHE_MISSING;
+
+  try {
+    MappedFile file(cache_filename);
+    TextureCacheHeader header;
+    if (file.size() < sizeof(TextureCacheHeader)) {
+      return TEXTURE_CACHE_MISSING;
+    }
+    memcpy(&header, file.data(), sizeof(TextureCacheHeader));
+    if (header.magic != kTextureCacheMagic ||
+      header.version != kTextureCacheVersion ||
+      header.usage >= NUM_TEXTURE_USAGES) {
+      return TEXTURE_CACHE_MISSING;
+    }
+
+    // Hashing is much cheaper than decoding, and unlike the modification
+    // time it survives copies and checkouts.
+    if (stat(filename.c_str(), &st) == 0 &&
+      header.source_hash != HashFile(filename)) {
+      texture = CompressedTexture();
+      texture.usage = TextureUsage(header.usage);
+      return TEXTURE_CACHE_STALE;
+    }
+
+    LoadTextureData(file.data(), file.size(), texture);
+  } catch (const exception& e) {
+    cout << "Invalid texture cache " << cache_filename << ": " << e.what()
+      << endl;
+    texture = CompressedTexture();
+    return TEXTURE_CACHE_MISSING;
+  }
+  return TEXTURE_CACHE_VALID;
+}
+
+} // namespace
+
+bool LoadTextureCache(const string& filename, CompressedTexture& texture) {
+  if (ReadTextureCache(filename, texture) == TEXTURE_CACHE_VALID) return true;
+  texture = CompressedTexture();
+  return false;
+}
+
+bool LoadOrCookTextureCache(const string& filename,
+  CompressedTexture& texture) {
+  switch (ReadTextureCache(filename, texture)) {
+    case TEXTURE_CACHE_VALID: return true;
+    case TEXTURE_CACHE_MISSING: return false;
+    default: break;
+  }
+
+  // The image changed since it was cooked, so it is cooked again for the
+  // same usage instead of being uploaded uncompressed until the next run of
+  // the cooker.
+  TextureImage image;
+  if (!DecodeTexture(filename.c_str(), image)) return false;
+  CookTexture(image, texture.usage, texture);
+  try {
+    SaveTextureCache(filename, texture);
+  } catch (const exception& e) {
+    cout << "Could not save texture cache for " << filename << ": "
+      << e.what() << endl;
+  }
+  return true;
+}
+
+void SaveTextureCache(const string& filename,
+  const CompressedTexture& texture) {
+  const uint64_t source_hash = HashFile(filename);
+  AtomicWriteFile(GetTextureCachePath(filename), [&] (ostream& os) {
+    SaveTextureData(os, texture, source_hash);
+  });
+}
+
+GLuint UploadCompressedTexture(const CompressedTexture& texture,
+  GLuint texture_id) {
+#ifndef HEADLESS
+  if (texture_id == 0) {
+    glGenTextures(1, &texture_id);
+  }
+  glBindTexture(GL_TEXTURE_2D, texture_id);
+
+  GLenum internal_format;
+  switch (texture.format) {
+    case TEXTURE_BC1: internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+    case TEXTURE_BC3: internal_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+    case TEXTURE_BC5: internal_format = GL_COMPRESSED_RG_RGTC2; break;
+    default: internal_format = GL_RGBA; break;
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (size_t i = 0; i < texture.levels.size(); i++) {
+    const TextureLevel& level = texture.levels[i];
+    if (texture.format == TEXTURE_RGBA8) {
+      glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, level.width, level.height, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, level.data.data());
+    } else {
+      glCompressedTexImage2D(GL_TEXTURE_2D, i, internal_format, level.width,
+        level.height, 0, level.data.size(), level.data.data());
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+  // Trilinear filtering over the cooked mip chain.
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+    GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+    texture.levels.empty() ? 0 : texture.levels.size() - 1);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+#endif
+  return texture_id;
+}
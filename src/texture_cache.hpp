@@ -0,0 +1,43 @@
+#ifndef __TEXTURE_CACHE_HPP__
+#define __TEXTURE_CACHE_HPP__
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include "texture_compression.hpp"
+
+using namespace std;
+
+// 64 bit FNV-1a of the bytes of a file. Throws if the file can't be read.
+uint64_t HashFile(const string& filename);
+
+// Binary format: a header with the hash of the source image, the format, the
+// usage and a table of levels, followed by the levels aligned to 16 bytes.
+// LoadTextureData throws if the data is not a valid cache with the current
+// version and returns the source hash.
+void SaveTextureData(ostream& os, const CompressedTexture& texture,
+  uint64_t source_hash);
+uint64_t LoadTextureData(const char* bytes, size_t size,
+  CompressedTexture& texture);
+
+// The cache of "foo.png" is "foo.btex" in the same directory.
+string GetTextureCachePath(const string& filename);
+
+// Returns false if the cache is missing, has an old version or was cooked
+// from a different image. A cache without its image is always used.
+bool LoadTextureCache(const string& filename, CompressedTexture& texture);
+
+// Like LoadTextureCache, but a cache cooked from an older version of the
+// image is cooked again for the usage it was cooked for and saved. Returns
+// false if there is no cache to go by, so the image is used as it is.
+bool LoadOrCookTextureCache(const string& filename,
+  CompressedTexture& texture);
+void SaveTextureCache(const string& filename,
+  const CompressedTexture& texture);
+
+// Uploads every level, so no mipmaps are generated. Needs a current GL
+// context and creates the texture if texture_id is 0.
+GLuint UploadCompressedTexture(const CompressedTexture& texture,
+  GLuint texture_id);
+
+#endif // __TEXTURE_CACHE_HPP__
@@ -0,0 +1,408 @@
+#include "texture_compression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+namespace {
+
+void WriteUint16(unsigned char* bytes, uint16_t v) {
+  bytes[0] = v & 0xff;
+  bytes[1] = v >> 8;
+}
+
+uint16_t ReadUint16(const unsigned char* bytes) {
+  return bytes[0] | (bytes[1] << 8);
+}
+
+uint16_t PackRgb565(const float* rgb) {
+  int r = std::clamp(int(rgb[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+  int g = std::clamp(int(rgb[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+  int b = std::clamp(int(rgb[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+  return (r << 11) | (g << 5) | b;
+}
+
+void UnpackRgb565(uint16_t c, int* rgb) {
+  int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Colors of a BC1 block. With color0 <= color1 the block has three colors
+// and transparent black, except in BC3 where it always has four.
+void GetColorPalette(uint16_t c0, uint16_t c1, bool four_colors,
+  int palette[4][4]) {
+  UnpackRgb565(c0, palette[0]);
+  UnpackRgb565(c1, palette[1]);
+  palette[0][3] = palette[1][3] = 255;
+  for (int i = 0; i < 3; i++) {
+    if (four_colors || c0 > c1) {
+      palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+      palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+    } else {
+      palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+      palette[3][i] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = (four_colors || c0 > c1) ? 255 : 0;
+}
+
+// Values of a BC4 block, the alpha of BC3 and each channel of BC5.
+void GetChannelPalette(int a0, int a1, int palette[8]) {
+  palette[0] = a0;
+  palette[1] = a1;
+  if (a0 > a1) {
+    for (int i = 1; i <= 6; i++) {
+      palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+    }
+  } else {
+    for (int i = 1; i <= 4; i++) {
+      palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+    }
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+}
+
+// Endpoints on the principal axis of the colors, found by power iteration
+// on their covariance, and the closest of the four colors for each pixel.
+void EncodeColorBlock(const unsigned char* rgba, unsigned char* block) {
+  float mean[3] = { 0, 0, 0 };
+  for (int i = 0; i < 16; i++) {
+    for (int j = 0; j < 3; j++) mean[j] += rgba[i * 4 + j] / 16.0f;
+  }
+
+  float covariance[3][3] = {};
+  for (int i = 0; i < 16; i++) {
+    float d[3];
+    for (int j = 0; j < 3; j++) d[j] = rgba[i * 4 + j] - mean[j];
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) covariance[j][k] += d[j] * d[k];
+    }
+  }
+
+  float axis[3] = { 1, 1, 1 };
+  for (int iteration = 0; iteration < 8; iteration++) {
+    float v[3];
+    for (int j = 0; j < 3; j++) {
+      v[j] = covariance[j][0] * axis[0] + covariance[j][1] * axis[1] +
+        covariance[j][2] * axis[2];
+    }
+    float max_v = std::max({ std::abs(v[0]), std::abs(v[1]),
+      std::abs(v[2]) });
+    if (max_v < 1e-6f) break;
+    for (int j = 0; j < 3; j++) axis[j] = v[j] / max_v;
+  }
+  float axis_length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] +
+    axis[2] * axis[2]);
+  for (int j = 0; j < 3; j++) axis[j] /= axis_length;
+
+  float min_t = numeric_limits<float>::max();
+  float max_t = -numeric_limits<float>::max();
+  for (int i = 0; i < 16; i++) {
+    float t = 0;
+    for (int j = 0; j < 3; j++) t += (rgba[i * 4 + j] - mean[j]) * axis[j];
+    min_t = std::min(min_t, t);
+    max_t = std::max(max_t, t);
+  }
+
+  float e0[3], e1[3];
+  for (int j = 0; j < 3; j++) {
+    e0[j] = mean[j] + axis[j] * max_t;
+    e1[j] = mean[j] + axis[j] * min_t;
+  }
+  uint16_t c0 = PackRgb565(e0);
+  uint16_t c1 = PackRgb565(e1);
+  if (c0 < c1) std::swap(c0, c1);
+
+  // Equal endpoints leave every index at the first color.
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    int palette[4][4];
+    GetColorPalette(c0, c1, true, palette);
+    for (int i = 0; i < 16; i++) {
+      int best = 0, best_distance = numeric_limits<int>::max();
+      for (int k = 0; k < 4; k++) {
+        int distance = 0;
+        for (int j = 0; j < 3; j++) {
+          int d = rgba[i * 4 + j] - palette[k][j];
+          distance += d * d;
+        }
+        if (distance < best_distance) {
+          best = k;
+          best_distance = distance;
+        }
+      }
+      indices |= uint32_t(best) << (2 * i);
+    }
+  }
+
+  WriteUint16(block, c0);
+  WriteUint16(block + 2, c1);
+  for (int i = 0; i < 4; i++) block[4 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+void DecodeColorBlock(const unsigned char* block, bool four_colors,
+  unsigned char* rgba) {
+  uint16_t c0 = ReadUint16(block);
+  uint16_t c1 = ReadUint16(block + 2);
+  int palette[4][4];
+  GetColorPalette(c0, c1, four_colors, palette);
+
+  uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+    (uint32_t(block[7]) << 24);
+  for (int i = 0; i < 16; i++) {
+    int index = (indices >> (2 * i)) & 3;
+    for (int j = 0; j < 4; j++) rgba[i * 4 + j] = palette[index][j];
+  }
+}
+
+// The endpoints are the extremes of the channel, in the order that gives
+// six interpolated values.
+void EncodeChannelBlock(const unsigned char* rgba, int channel,
+  unsigned char* block) {
+  int lo = 255, hi = 0;
+  for (int i = 0; i < 16; i++) {
+    lo = std::min(lo, int(rgba[i * 4 + channel]));
+    hi = std::max(hi, int(rgba[i * 4 + channel]));
+  }
+
+  uint64_t indices = 0;
+  if (hi != lo) {
+    int palette[8];
+    GetChannelPalette(hi, lo, palette);
+    for (int i = 0; i < 16; i++) {
+      int best = 0, best_distance = numeric_limits<int>::max();
+      for (int k = 0; k < 8; k++) {
+        int distance = std::abs(rgba[i * 4 + channel] - palette[k]);
+        if (distance < best_distance) {
+          best = k;
+          best_distance = distance;
+        }
+      }
+      indices |= uint64_t(best) << (3 * i);
+    }
+  }
+
+  block[0] = hi;
+  block[1] = lo;
+  for (int i = 0; i < 6; i++) block[2 + i] = (indices >> (8 * i)) & 0xff;
+}
+
+void DecodeChannelBlock(const unsigned char* block, int channel,
+  unsigned char* rgba) {
+  int palette[8];
+  GetChannelPalette(block[0], block[1], palette);
+
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; i++) indices |= uint64_t(block[2 + i]) << (8 * i);
+  for (int i = 0; i < 16; i++) {
+    rgba[i * 4 + channel] = palette[(indices >> (3 * i)) & 7];
+  }
+}
+
+void ToRgba(const TextureImage& image, TextureImage& rgba) {
+  rgba.width = image.width;
+  rgba.height = image.height;
+  rgba.num_channels = 4;
+  if (image.num_channels == 4) {
+    rgba.pixels = image.pixels;
+    return;
+  }
+
+  const int num_pixels = image.width * image.height;
+  rgba.pixels.resize(num_pixels * 4);
+  for (int i = 0; i < num_pixels; i++) {
+    for (int j = 0; j < 3; j++) {
+      rgba.pixels[i * 4 + j] = image.pixels[i * image.num_channels + j];
+    }
+    rgba.pixels[i * 4 + 3] = 255;
+  }
+}
+
+} // namespace
+
+int GetBlockSize(TextureFormat format) {
+  switch (format) {
+    case TEXTURE_RGBA8: return 4;
+    case TEXTURE_BC1: return 8;
+    case TEXTURE_BC3: return 16;
+    case TEXTURE_BC5: return 16;
+    default: break;
+  }
+  throw runtime_error("Invalid texture format");
+}
+
+size_t GetLevelSize(TextureFormat format, int width, int height) {
+  if (format == TEXTURE_RGBA8) return size_t(width) * height * 4;
+  return size_t((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(format);
+}
+
+void EncodeBC1Block(const unsigned char* rgba, unsigned char* block) {
+  EncodeColorBlock(rgba, block);
+}
+
+void EncodeBC3Block(const unsigned char* rgba, unsigned char* block) {
+  EncodeChannelBlock(rgba, 3, block);
+  EncodeColorBlock(rgba, block + 8);
+}
+
+void EncodeBC5Block(const unsigned char* rgba, unsigned char* block) {
+  EncodeChannelBlock(rgba, 0, block);
+  EncodeChannelBlock(rgba, 1, block + 8);
+}
+
+void DecodeBC1Block(const unsigned char* block, unsigned char* rgba) {
+  DecodeColorBlock(block, false, rgba);
+}
+
+void DecodeBC3Block(const unsigned char* block, unsigned char* rgba) {
+  DecodeColorBlock(block + 8, true, rgba);
+  DecodeChannelBlock(block, 3, rgba);
+}
+
+void DecodeBC5Block(const unsigned char* block, unsigned char* rgba) {
+  for (int i = 0; i < 16; i++) {
+    rgba[i * 4 + 2] = 0;
+    rgba[i * 4 + 3] = 255;
+  }
+  DecodeChannelBlock(block, 0, rgba);
+  DecodeChannelBlock(block + 8, 1, rgba);
+}
+
+void GenerateMipmaps(const TextureImage& image, vector<TextureImage>& levels) {
+  levels.clear();
+  levels.push_back(TextureImage());
+  ToRgba(image, levels.back());
+
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    const TextureImage& src = levels.back();
+    TextureImage dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize(dst.width * dst.height * 4);
+    for (int y = 0; y < dst.height; y++) {
+      int y0 = std::min(2 * y, src.height - 1);
+      int y1 = std::min(2 * y + 1, src.height - 1);
+      for (int x = 0; x < dst.width; x++) {
+        int x0 = std::min(2 * x, src.width - 1);
+        int x1 = std::min(2 * x + 1, src.width - 1);
+        for (int j = 0; j < 4; j++) {
+          int sum = src.pixels[(y0 * src.width + x0) * 4 + j] +
+            src.pixels[(y0 * src.width + x1) * 4 + j] +
+            src.pixels[(y1 * src.width + x0) * 4 + j] +
+            src.pixels[(y1 * src.width + x1) * 4 + j];
+          dst.pixels[(y * dst.width + x) * 4 + j] = (sum + 2) / 4;
+        }
+      }
+    }
+    levels.push_back(move(dst));
+  }
+}
+
+TextureFormat ChooseTextureFormat(const TextureImage& image,
+  TextureUsage usage) {
+  if (usage == TEXTURE_USAGE_NORMAL_MAP) return TEXTURE_BC5;
+
+  if (image.num_channels == 4) {
+    for (size_t i = 3; i < image.pixels.size(); i += 4) {
+      if (image.pixels[i] != 255) return TEXTURE_BC3;
+    }
+  }
+  return TEXTURE_BC1;
+}
+
+void CompressTexture(const TextureImage& image, TextureFormat format,
+  CompressedTexture& texture) {
+  vector<TextureImage> mipmaps;
+  GenerateMipmaps(image, mipmaps);
+
+  texture.format = format;
+  texture.levels.clear();
+  for (const TextureImage& mipmap : mipmaps) {
+    TextureLevel level;
+    level.width = mipmap.width;
+    level.height = mipmap.height;
+    if (format == TEXTURE_RGBA8) {
+      level.data = mipmap.pixels;
+      texture.levels.push_back(move(level));
+      continue;
+    }
+
+    level.data.resize(GetLevelSize(format, level.width, level.height));
+    const int block_size = GetBlockSize(format);
+    const int num_blocks_x = (level.width + 3) / 4;
+    const int num_blocks_y = (level.height + 3) / 4;
+    unsigned char rgba[64];
+    for (int by = 0; by < num_blocks_y; by++) {
+      for (int bx = 0; bx < num_blocks_x; bx++) {
+        // Blocks past the edge of small levels repeat the last pixels.
+        for (int i = 0; i < 16; i++) {
+          int x = std::min(bx * 4 + i % 4, level.width - 1);
+          int y = std::min(by * 4 + i / 4, level.height - 1);
+          for (int j = 0; j < 4; j++) {
+            rgba[i * 4 + j] = mipmap.pixels[(y * level.width + x) * 4 + j];
+          }
+        }
+
+        unsigned char* block =
+          &level.data[(by * num_blocks_x + bx) * block_size];
+        switch (format) {
+          case TEXTURE_BC1: EncodeBC1Block(rgba, block); break;
+          case TEXTURE_BC3: EncodeBC3Block(rgba, block); break;
+          case TEXTURE_BC5: EncodeBC5Block(rgba, block); break;
+          default: throw runtime_error("Invalid texture format");
+        }
+      }
+    }
+    texture.levels.push_back(move(level));
+  }
+}
+
+void CookTexture(const TextureImage& image, TextureUsage usage,
+  CompressedTexture& texture) {
+  CompressTexture(image, ChooseTextureFormat(image, usage), texture);
+  texture.usage = usage;
+}
+
+void DecompressLevel(const CompressedTexture& texture, int level_index,
+  TextureImage& image) {
+  const TextureLevel& level = texture.levels[level_index];
+  image.width = level.width;
+  image.height = level.height;
+  image.num_channels = 4;
+  if (texture.format == TEXTURE_RGBA8) {
+    image.pixels = level.data;
+    return;
+  }
+
+  image.pixels.resize(level.width * level.height * 4);
+  const int block_size = GetBlockSize(texture.format);
+  const int num_blocks_x = (level.width + 3) / 4;
+  const int num_blocks_y = (level.height + 3) / 4;
+  unsigned char rgba[64];
+  for (int by = 0; by < num_blocks_y; by++) {
+    for (int bx = 0; bx < num_blocks_x; bx++) {
+      const unsigned char* block =
+        &level.data[(by * num_blocks_x + bx) * block_size];
+      switch (texture.format) {
+        case TEXTURE_BC1: DecodeBC1Block(block, rgba); break;
+        case TEXTURE_BC3: DecodeBC3Block(block, rgba); break;
+        case TEXTURE_BC5: DecodeBC5Block(block, rgba); break;
+        default: throw runtime_error("Invalid texture format");
+      }
+
+      for (int i = 0; i < 16; i++) {
+        int x = bx * 4 + i % 4;
+        int y = by * 4 + i / 4;
+        if (x >= level.width || y >= level.height) continue;
+        for (int j = 0; j < 4; j++) {
+          image.pixels[(y * level.width + x) * 4 + j] = rgba[i * 4 + j];
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#ifndef __TEXTURE_COMPRESSION_HPP__
+#define __TEXTURE_COMPRESSION_HPP__
+
+#include <string>
+#include <vector>
+#include "util.hpp"
+
+using namespace std;
+
+enum TextureFormat {
+  TEXTURE_RGBA8 = 0,
+  TEXTURE_BC1,
+  TEXTURE_BC3,
+  TEXTURE_BC5,
+  NUM_TEXTURE_FORMATS
+};
+
+// What the shaders read from a texture, which picks its format.
+enum TextureUsage {
+  TEXTURE_USAGE_COLOR = 0,
+  TEXTURE_USAGE_NORMAL_MAP,
+  NUM_TEXTURE_USAGES
+};
+
+// One mip level. Block compressed levels are 4x4 blocks row by row, starting
+// at the bottom like the pixels of a TextureImage.
+struct TextureLevel {
+  int width = 0;
+  int height = 0;
+  vector<unsigned char> data;
+};
+
+struct CompressedTexture {
+  TextureFormat format = TEXTURE_RGBA8;
+  TextureUsage usage = TEXTURE_USAGE_COLOR;
+  vector<TextureLevel> levels;
+};
+
+// Bytes per 4x4 block, or per pixel for RGBA8.
+int GetBlockSize(TextureFormat format);
+
+// Size of a level in bytes.
+size_t GetLevelSize(TextureFormat format, int width, int height);
+
+// Block encoders take the 16 RGBA pixels of a block row by row. BC1 drops
+// alpha, BC3 keeps it and BC5 only keeps red and green.
+void EncodeBC1Block(const unsigned char* rgba, unsigned char* block);
+void EncodeBC3Block(const unsigned char* rgba, unsigned char* block);
+void EncodeBC5Block(const unsigned char* rgba, unsigned char* block);
+
+// Decoders, as the GPU would sample the blocks.
+void DecodeBC1Block(const unsigned char* block, unsigned char* rgba);
+void DecodeBC3Block(const unsigned char* block, unsigned char* rgba);
+void DecodeBC5Block(const unsigned char* block, unsigned char* rgba);
+
+// Box filtered mip chain down to 1x1. The first level is the image itself,
+// with RGB images expanded to RGBA.
+void GenerateMipmaps(const TextureImage& image, vector<TextureImage>& levels);
+
+// Normal maps are BC5, since the shaders rebuild z from red and green.
+// Images with transparent pixels are BC3 and the rest BC1.
+TextureFormat ChooseTextureFormat(const TextureImage& image,
+  TextureUsage usage);
+
+void CompressTexture(const TextureImage& image, TextureFormat format,
+  CompressedTexture& texture);
+
+// Compresses the image to the format chosen for its usage.
+void CookTexture(const TextureImage& image, TextureUsage usage,
+  CompressedTexture& texture);
+void DecompressLevel(const CompressedTexture& texture, int level,
+  TextureImage& image);
+
+#endif // __TEXTURE_COMPRESSION_HPP__
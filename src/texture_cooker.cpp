@@ -0,0 +1,115 @@
+#include "texture_cache.hpp"
+#include "job_system.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+
+namespace {
+
+string GetCanonicalPath(const string& filename) {
+  boost::system::error_code error;
+  boost::filesystem::path path =
+    boost::filesystem::canonical(filename, error);
+  return error ? filename : path.string();
+}
+
+// Textures used as a bump map by some asset. The shaders only read their
+// red and green channels.
+void FindNormalMaps(const string& directory,
+  unordered_set<string>& normal_maps) {
+  boost::filesystem::recursive_directory_iterator end_itr;
+  for (boost::filesystem::recursive_directory_iterator itr(directory);
+    itr != end_itr; ++itr) {
+    if (!is_regular_file(itr->path())) continue;
+    if (!boost::ends_with(itr->path().string(), ".xml")) continue;
+
+    pugi::xml_document doc;
+    if (!doc.load_file(itr->path().string().c_str())) continue;
+
+    const pugi::xml_node& xml = doc.child("xml");
+    for (pugi::xml_node asset_xml = xml.child("asset"); asset_xml;
+      asset_xml = asset_xml.next_sibling("asset")) {
+      const pugi::xml_node& bump_map_xml = asset_xml.child("bump-map");
+      if (!bump_map_xml) continue;
+      normal_maps.insert(GetCanonicalPath(bump_map_xml.text().get()));
+    }
+  }
+}
+
+} // namespace
+
+// Compresses every PNG and TGA file under a directory to the texture cache
+// that Resources::LoadResources uploads instead of decoding the image. Files
+// whose cache is up to date are skipped unless --force is given.
+//
+// Usage: texture_cooker [directory] [--force]
+int main(int argc, char** argv) {
+  string directory = "resources";
+  bool force = false;
+  for (int i = 1; i < argc; i++) {
+    if (string(argv[i]) == "--force") {
+      force = true;
+    } else {
+      directory = argv[i];
+    }
+  }
+
+  if (!boost::filesystem::is_directory(directory)) {
+    cout << "Usage: texture_cooker [directory] [--force]" << endl;
+    return 1;
+  }
+
+  double start_time = GetTime();
+  unordered_set<string> normal_maps;
+  FindNormalMaps(directory, normal_maps);
+
+  vector<string> filenames;
+  boost::filesystem::recursive_directory_iterator end_itr;
+  for (boost::filesystem::recursive_directory_iterator itr(directory);
+    itr != end_itr; ++itr) {
+    if (!is_regular_file(itr->path())) continue;
+    const string filename = itr->path().string();
+    if (boost::ends_with(filename, ".png") ||
+      boost::ends_with(filename, ".tga")) {
+      filenames.push_back(filename);
+    }
+  }
+
+  // Compression is by far the slowest part, one job per image.
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>();
+  shared_ptr<JobCounter> counter = make_shared<JobCounter>();
+  atomic<int> num_cooked(0), num_skipped(0), num_failed(0);
+  mutex output_mutex;
+  job_system->ParallelFor(0, filenames.size(), 1, [&] (int i) {
+    const string& filename = filenames[i];
+    try {
+      // A texture that became a bump map, or stopped being one, needs
+      // another format.
+      TextureUsage usage = normal_maps.count(GetCanonicalPath(filename)) > 0 ?
+        TEXTURE_USAGE_NORMAL_MAP : TEXTURE_USAGE_COLOR;
+      CompressedTexture texture;
+      if (!force && LoadTextureCache(filename, texture) &&
+        texture.usage == usage) {
+        num_skipped++;
+        return;
+      }
+
+      TextureImage image;
+      DecodeTexture(filename.c_str(), image);
+      CookTexture(image, usage, texture);
+      SaveTextureCache(filename, texture);
+      num_cooked++;
+    } catch (const exception& e) {
+      lock_guard<mutex> lock(output_mutex);
+      cout << "Could not cook " << filename << ": " << e.what() << endl;
+      num_failed++;
+    }
+  }, counter);
+  job_system->Wait(counter);
+
+  cout << "Cooked " << num_cooked << " textures, " << num_skipped 
+    << " up to date, " << num_failed << " failed in "
+    << GetTime() - start_time << " seconds" << endl;
+  return num_failed > 0 ? 1 : 0;
+}
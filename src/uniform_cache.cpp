@@ -0,0 +1,153 @@
+#include <iostream>
+#include "uniform_cache.hpp"
+
+namespace {
+
+// Array uniforms are reported as "name[0]".
+string RemoveArraySuffix(const string& name) {
+  if (name.size() < 3 || name.compare(name.size() - 3, 3, "[0]") != 0) {
+    return name;
+  }
+  return name.substr(0, name.size() - 3);
+}
+
+} // namespace
+
+UniformGlFunctions GetDefaultUniformGlFunctions() {
+  UniformGlFunctions gl;
+#ifdef HEADLESS
+  gl.get_program_iv = [](GLuint, GLenum, GLint* params) { *params = 0; };
+  gl.get_active_uniform = [](GLuint, GLuint, GLsizei, GLsizei* length,
+    GLint*, GLenum*, GLchar*) { *length = 0; };
+  gl.get_uniform_location = [](GLuint, const GLchar*) { return GLint(0); };
+  gl.get_uniform_block_index = [](GLuint, const GLchar*) {
+    return GLuint(GL_INVALID_INDEX);
+  };
+  gl.uniform_block_binding = [](GLuint, GLuint, GLuint) {};
+  gl.gen_buffers = [](GLsizei n, GLuint* buffers) {
+    for (int i = 0; i < n; i++) buffers[i] = 0;
+  };
+  gl.bind_buffer = [](GLenum, GLuint) {};
+  gl.buffer_data = [](GLenum, GLsizeiptr, const void*, GLenum) {};
+  gl.buffer_sub_data = [](GLenum, GLintptr, GLsizeiptr, const void*) {};
+  gl.bind_buffer_base = [](GLenum, GLuint, GLuint) {};
+#else
+  // Wrapped in lambdas because GLEW only loads the pointers after init.
+  gl.get_program_iv = [](GLuint program, GLenum name, GLint* params) {
+    glGetProgramiv(program, name, params);
+  };
+  gl.get_active_uniform = [](GLuint program, GLuint index, GLsizei buf_size,
+    GLsizei* length, GLint* size, GLenum* type, GLchar* name) {
+    glGetActiveUniform(program, index, buf_size, length, size, type, name);
+  };
+  gl.get_uniform_location = [](GLuint program, const GLchar* name) {
+    return glGetUniformLocation(program, name);
+  };
+  gl.get_uniform_block_index = [](GLuint program, const GLchar* name) {
+    return glGetUniformBlockIndex(program, name);
+  };
+  gl.uniform_block_binding = [](GLuint program, GLuint index,
+    GLuint binding) {
+    glUniformBlockBinding(program, index, binding);
+  };
+  gl.gen_buffers = [](GLsizei n, GLuint* buffers) {
+    glGenBuffers(n, buffers);
+  };
+  gl.bind_buffer = [](GLenum target, GLuint buffer) {
+    glBindBuffer(target, buffer);
+  };
+  gl.buffer_data = [](GLenum target, GLsizeiptr size, const void* data,
+    GLenum usage) {
+    glBufferData(target, size, data, usage);
+  };
+  gl.buffer_sub_data = [](GLenum target, GLintptr offset, GLsizeiptr size,
+    const void* data) {
+    glBufferSubData(target, offset, size, data);
+  };
+  gl.bind_buffer_base = [](GLenum target, GLuint index, GLuint buffer) {
+    glBindBufferBase(target, index, buffer);
+  };
+#endif
+  return gl;
+}
+
+void UniformCache::AddProgram(GLuint program_id) {
+  if (locations_.find(program_id) == locations_.end()) {
+    programs_.push_back(program_id);
+  }
+  unordered_map<string, GLint>& locations = locations_[program_id];
+
+  GLint num_uniforms = 0, max_length = 0;
+  gl_.get_program_iv(program_id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+  gl_.get_program_iv(program_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+  vector<GLchar> buffer(max_length + 1);
+  for (int i = 0; i < num_uniforms; i++) {
+    GLsizei length = 0;
+    GLint size;
+    GLenum type;
+    gl_.get_active_uniform(program_id, i, buffer.size(), &length, &size,
+      &type, buffer.data());
+    string name(buffer.data(), length);
+
+    // Uniforms inside blocks have no location.
+    GLint location = gl_.get_uniform_location(program_id, name.c_str());
+    if (location == -1) continue;
+
+    locations[name] = location;
+    locations[RemoveArraySuffix(name)] = location;
+  }
+}
+
+GLint UniformCache::GetLocation(GLuint program_id, const string& name) {
+  auto program_it = locations_.find(program_id);
+  if (program_it == locations_.end()) {
+    AddProgram(program_id);
+    program_it = locations_.find(program_id);
+  }
+
+  unordered_map<string, GLint>& locations = program_it->second;
+  auto it = locations.find(name);
+  if (it != locations.end()) return it->second;
+
+  GLint location = gl_.get_uniform_location(program_id, name.c_str());
+  locations[name] = location;
+  if (location == -1) {
+    missing_uniforms_.push_back({ program_id, name });
+    cout << "Missing uniform " << name << " in program " << program_id
+      << endl;
+  }
+  return location;
+}
+
+UniformCache& GetUniformCache() {
+  static UniformCache uniform_cache(GetDefaultUniformGlFunctions());
+  return uniform_cache;
+}
+
+UniformBuffer::UniformBuffer(const UniformGlFunctions& gl, GLuint binding,
+  int size) : gl_(gl), binding_(binding), size_(size) {
+  gl_.gen_buffers(1, &buffer_id_);
+  gl_.bind_buffer(GL_UNIFORM_BUFFER, buffer_id_);
+  gl_.buffer_data(GL_UNIFORM_BUFFER, size_, nullptr, GL_DYNAMIC_DRAW);
+  gl_.bind_buffer_base(GL_UNIFORM_BUFFER, binding_, buffer_id_);
+}
+
+int UniformBuffer::BindToPrograms(const vector<GLuint>& programs,
+  const string& block_name) {
+  programs_.clear();
+  for (GLuint program_id : programs) {
+    GLuint index = gl_.get_uniform_block_index(program_id,
+      block_name.c_str());
+    if (index == GL_INVALID_INDEX) continue;
+    gl_.uniform_block_binding(program_id, index, binding_);
+    programs_.insert(program_id);
+  }
+  return programs_.size();
+}
+
+void UniformBuffer::Update(const void* data) {
+  if (programs_.empty()) return;
+  gl_.bind_buffer(GL_UNIFORM_BUFFER, buffer_id_);
+  gl_.buffer_sub_data(GL_UNIFORM_BUFFER, 0, size_, data);
+}
@@ -0,0 +1,121 @@
+#ifndef __UNIFORM_CACHE_HPP__
+#define __UNIFORM_CACHE_HPP__
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+using namespace std;
+using namespace glm;
+
+// The GL calls used by the uniform cache and the uniform buffers. Tests
+// replace them with fakes, so they run without a GL context.
+struct UniformGlFunctions {
+  function<void(GLuint, GLenum, GLint*)> get_program_iv;
+  function<void(GLuint, GLuint, GLsizei, GLsizei*, GLint*, GLenum*, GLchar*)>
+    get_active_uniform;
+  function<GLint(GLuint, const GLchar*)> get_uniform_location;
+  function<GLuint(GLuint, const GLchar*)> get_uniform_block_index;
+  function<void(GLuint, GLuint, GLuint)> uniform_block_binding;
+  function<void(GLsizei, GLuint*)> gen_buffers;
+  function<void(GLenum, GLuint)> bind_buffer;
+  function<void(GLenum, GLsizeiptr, const void*, GLenum)> buffer_data;
+  function<void(GLenum, GLintptr, GLsizeiptr, const void*)> buffer_sub_data;
+  function<void(GLenum, GLuint, GLuint)> bind_buffer_base;
+};
+
+// Calls the real GL functions, or does nothing in HEADLESS builds.
+UniformGlFunctions GetDefaultUniformGlFunctions();
+
+struct MissingUniform {
+  GLuint program_id;
+  string name;
+};
+
+// Uniform locations by program and name. Programs are reflected when they
+// are added, so looking up a location never calls glGetUniformLocation for
+// the active uniforms. Other names, like array elements, are asked to GL
+// once and cached, and names that don't exist are recorded as missing and
+// logged the first time they are looked up.
+class UniformCache {
+  UniformGlFunctions gl_;
+  unordered_map<GLuint, unordered_map<string, GLint>> locations_;
+  vector<GLuint> programs_;
+  vector<MissingUniform> missing_uniforms_;
+
+ public:
+  UniformCache(const UniformGlFunctions& gl) : gl_(gl) {}
+
+  void AddProgram(GLuint program_id);
+  GLint GetLocation(GLuint program_id, const string& name);
+
+  const vector<GLuint>& GetPrograms() { return programs_; }
+  const vector<MissingUniform>& GetMissingUniforms() {
+    return missing_uniforms_;
+  }
+};
+
+UniformCache& GetUniformCache();
+
+// Per frame data in std140 layout, shared by all programs that declare:
+//
+// layout(std140) uniform FrameUniforms {
+//   mat4 V;
+//   mat4 P;
+//   mat4 VP;
+//   mat4 shadow_matrices[3];
+//   vec4 camera_pos;
+//   vec4 player_pos;
+//   vec4 light_direction; // w is the light radius.
+//   vec4 lighting_color;
+//   vec4 frame_params; // Time, outdoors and in dungeon.
+// };
+struct FrameUniforms {
+  mat4 V;
+  mat4 P;
+  mat4 VP;
+  mat4 shadow_matrices[3];
+  vec4 camera_pos;
+  vec4 player_pos;
+  vec4 light_direction;
+  vec4 lighting_color;
+  vec4 frame_params;
+};
+
+static_assert(sizeof(FrameUniforms) == 6 * 64 + 5 * 16,
+  "FrameUniforms must match the std140 layout.");
+
+const GLuint kFrameUniformsBinding = 0;
+const string kFrameUniformsBlock = "FrameUniforms";
+
+// Uniform buffer object attached to a binding point. Programs are linked to
+// the binding point through the name of their uniform block.
+class UniformBuffer {
+  UniformGlFunctions gl_;
+  GLuint binding_;
+  GLuint buffer_id_ = 0;
+  int size_;
+  unordered_set<GLuint> programs_;
+
+ public:
+  UniformBuffer(const UniformGlFunctions& gl, GLuint binding, int size);
+
+  // Returns the number of programs that declare the block.
+  int BindToPrograms(const vector<GLuint>& programs,
+    const string& block_name);
+
+  // Does nothing when no program declares the block.
+  void Update(const void* data);
+  bool IsUsed() { return !programs_.empty(); }
+
+  // Programs that declare the block read these values from the buffer
+  // instead of their own uniforms.
+  bool IsBound(GLuint program_id) { return programs_.count(program_id) > 0; }
+  GLuint GetBufferId() { return buffer_id_; }
+};
+
+#endif // __UNIFORM_CACHE_HPP__
@@ -1,20 +1,33 @@
 #include "util.hpp"
+#include "uniform_cache.hpp"
+#include "compressed_animation.hpp"
 #include <tga.h>
 #include <boost/algorithm/string/replace.hpp>
+#include <random>
 
 mutex gTextureMutex;
+mutex gRandomMutex;
+mt19937 gRandomEngines[NUM_RANDOM_STREAMS];
+thread_local RandomStream tRandomStream = RANDOM_SIMULATION;
+thread_local mt19937* tRandomEngine = nullptr;
 
-GLuint GetUniformId(GLuint program_id, string name) {
-  return glGetUniformLocation(program_id, name.c_str());
+GLuint GetUniformId(GLuint program_id, const string& name) {
+#ifdef HEADLESS
+  return 0;
+#else
+  return GetUniformCache().GetLocation(program_id, name);
+#endif
 }
 
 void BindBuffer(const GLuint& buffer_id, int slot, int dimension) {
+#ifndef HEADLESS
   glEnableVertexAttribArray(slot);
   glBindBuffer(GL_ARRAY_BUFFER, buffer_id);
   glVertexAttribPointer(slot, dimension, GL_FLOAT, GL_FALSE, 0, (void*) 0);
+#endif
 }
 
-GLuint LoadPng(const char* file_name, GLuint texture_id, GLFWwindow* window) {
+void DecodePng(const char* file_name, TextureImage& image) {
   FILE* fp = fopen(file_name, "rb");
   if (!fp) {
     printf("[read_png_file] File %s could not be opened for reading", file_name);
@@ -74,49 +87,26 @@ GLuint LoadPng(const char* file_name, GLuint texture_id, GLFWwindow* window) {
       PNG_COLOR_TYPE_RGBA, png_get_color_type(png_ptr, info_ptr));
   }
 
-  unsigned char* data = new unsigned char[width * height * 4];
+  image.width = width;
+  image.height = height;
+  image.num_channels = 4;
+  image.pixels.resize(width * height * 4);
   for (int y = 0; y < height; y++) {
     png_byte* row = row_pointers[y];
     for (int x = 0; x < width; x++) {
       png_byte* ptr = &(row[x*4]);
       for (int i = 0; i < 4; i++) {
-        data[((height - y - 1)*height+x)*4+i] = ptr[i];
+        image.pixels[((height - y - 1)*width+x)*4+i] = ptr[i];
       }
     }
     delete[] row_pointers[y];
   }
   delete[] row_pointers;
 
-  gTextureMutex.lock();
-  if (window) glfwMakeContextCurrent(window);
-
-  // Create one OpenGL texture
-  if (texture_id == 0) {
-    glGenTextures(1, &texture_id);
-  }
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-  
-  // OpenGL has now copied the data. Free our own version
-  delete[] data;
-
   png_destroy_read_struct(&png_ptr, &info_ptr, NULL);
-  
-  // Trilinear filtering.
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glGenerateMipmap(GL_TEXTURE_2D);
-
-  glBindTexture(GL_TEXTURE_2D, 0);
-
-  gTextureMutex.unlock();
-
-  return texture_id;
 }
 
-GLuint LoadTga(const char* file_name, GLuint texture_id, GLFWwindow* window) {
+void DecodeTga(const char* file_name, TextureImage& image) {
   TGA *in = TGAOpen(file_name, "r");
   TGAData data;
   bzero(&data, sizeof(data));
@@ -127,35 +117,73 @@ GLuint LoadTga(const char* file_name, GLuint texture_id, GLFWwindow* window) {
     throw runtime_error(TGAStrError(in));
   }
 
-  const int width = in->hdr.width;
-  const int height = in->hdr.height;
+  image.width = in->hdr.width;
+  image.height = in->hdr.height;
+  image.num_channels = (in->hdr.depth == 24) ? 3 : 4;
+  image.pixels.assign(data.img_data, 
+    data.img_data + image.width * image.height * image.num_channels);
 
-  gTextureMutex.lock();
-  if (window) glfwMakeContextCurrent(window);
+  TGAFreeTGAData(&data);
+  TGAClose(in);
+}
 
+bool DecodeTexture(const char* file_name, TextureImage& image) {
+  if (boost::ends_with(file_name, ".png")) {
+    DecodePng(file_name, image);
+  } else if (boost::ends_with(file_name, ".tga")) {
+    DecodeTga(file_name, image);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+GLuint UploadTexture(const TextureImage& image, GLuint texture_id) {
+#ifndef HEADLESS
   // Create one OpenGL texture
   if (texture_id == 0) {
     glGenTextures(1, &texture_id);
   }
   glBindTexture(GL_TEXTURE_2D, texture_id);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, 
-    GL_UNSIGNED_BYTE, (char*) data.img_data);
+  GLenum format = (image.num_channels == 3) ? GL_RGB : GL_RGBA;
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, 
+    format, GL_UNSIGNED_BYTE, image.pixels.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
-  TGAFreeTGAData(&data);
-  TGAClose(in);
-  
   // Trilinear filtering.
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   glGenerateMipmap(GL_TEXTURE_2D);
+
   glBindTexture(GL_TEXTURE_2D, 0);
+#endif
+  return texture_id;
+}
 
-  gTextureMutex.unlock();
+// Decoding happens outside the lock, only the upload switches the context.
+GLuint UploadTexture(const TextureImage& image, GLuint texture_id,
+  GLFWwindow* window) {
+#ifndef HEADLESS
+  lock_guard<mutex> lock(gTextureMutex);
+  if (window) glfwMakeContextCurrent(window);
+#endif
+  return UploadTexture(image, texture_id);
+}
 
-  return texture_id;
+GLuint LoadPng(const char* file_name, GLuint texture_id, GLFWwindow* window) {
+  TextureImage image;
+  DecodePng(file_name, image);
+  return UploadTexture(image, texture_id, window);
+}
+
+GLuint LoadTga(const char* file_name, GLuint texture_id, GLFWwindow* window) {
+  TextureImage image;
+  DecodeTga(file_name, image);
+  return UploadTexture(image, texture_id, window);
 }
 
 GLuint LoadTexture(const char* file_name, GLuint texture_id) {
@@ -177,6 +205,9 @@ void LoadTextureAsync(const char* file_name, GLuint texture_id,
 }
 
 GLuint LoadShader(const std::string& directory, const std::string& name) {
+#ifdef HEADLESS
+  return 0;
+#else
   GLint result = GL_FALSE;
   int info_log_length;
   vector<GLuint> shader_ids;
@@ -223,6 +254,7 @@ GLuint LoadShader(const std::string& directory, const std::string& name) {
     glDeleteShader(shader_id);
   }
   return program_id;
+#endif
 }
 
 ostream& operator<<(ostream& os, const vec2& v) {
@@ -435,6 +467,11 @@ vector<vec3> GetAllVerticesFromPolygon(const vector<Polygon>& polygons) {
 
 Mesh CreateMesh(GLuint shader_id, vector<vec3>& vertices, vector<vec2>& uvs, 
   vector<unsigned int>& indices) {
+#ifdef HEADLESS
+  Mesh m;
+  m.num_indices = indices.size();
+  return m;
+#else
   Mesh m;
   glGenBuffers(1, &m.vertex_buffer);
   glGenBuffers(1, &m.uv_buffer);
@@ -501,10 +538,16 @@ Mesh CreateMesh(GLuint shader_id, vector<vec3>& vertices, vector<vec2>& uvs,
     glDisableVertexAttribArray(slot);
   }
   return m;
+#endif
 }
 
 void UpdateMesh(Mesh& m, vector<vec3>& vertices, vector<vec2>& uvs, 
   vector<unsigned int>& indices, GLFWwindow* window) {
+#ifdef HEADLESS
+  if (!indices.empty()) {
+    m.num_indices = indices.size();
+  }
+#else
   gTextureMutex.lock();
   if (window) glfwMakeContextCurrent(window);
 
@@ -568,6 +611,7 @@ void UpdateMesh(Mesh& m, vector<vec3>& vertices, vector<vec2>& uvs,
     glDisableVertexAttribArray(slot);
   }
   gTextureMutex.unlock();
+#endif
 }
 
 Mesh CreateMeshFromConvexHull(const ConvexHull& ch) {
@@ -1128,31 +1172,22 @@ string LoadStringFromXmlOr(const pugi::xml_node& node, const string& name, const
 }
 
 mat4 GetBoneTransform(Mesh& mesh, const string& animation_name, 
-  int bone_id, int frame) {
-  if (mesh.animations.find(animation_name) == mesh.animations.end()) {
+  int bone_id, float frame) {
+  // Hashes the name once, this runs for every bone of every animated object.
+  auto it = mesh.animations.find(animation_name);
+  if (it == mesh.animations.end()) {
     return mat4(1.0f);
     // throw runtime_error(string("Animation ") + animation_name + 
     //   " does not exist in Util:868");
   }
 
-  const Animation& animation = mesh.animations[animation_name];
-  if (frame >= animation.keyframes.size()) {
-    return mat4(1.0f);
-    // throw runtime_error(string("Frame outside scope") + 
-    //   " does not exist in Util:875");
-  }
-
-  if (bone_id >= animation.keyframes[frame].transforms.size()) {
-    return mat4(1.0f);
-    // throw runtime_error(string("Bone id does not exist") + " in Util:879");
-  }
-
-  return animation.keyframes[frame].transforms[bone_id];
+  // Same sample as the rendered pose.
+  return SampleAnimation(it->second, bone_id, frame);
 }
 
 int GetNumFramesInAnimation(Mesh& mesh, const string& animation_name) {
   const Animation& animation = mesh.animations[animation_name];
-  return animation.keyframes.size();
+  return GetNumFrames(animation);
 }
 
 bool MeshHasAnimation(Mesh& mesh, const string& animation_name) {
@@ -1375,10 +1410,56 @@ Mesh CreateSphere(float dome_radius, int num_circles, int num_points_in_circle)
   return CreateMesh(0, vertices, uvs, indices);
 }
 
+ScopedRandomStream::ScopedRandomStream(RandomStream stream) 
+  : prev_stream_(tRandomStream) {
+  tRandomStream = stream;
+}
+
+ScopedRandomStream::~ScopedRandomStream() {
+  tRandomStream = prev_stream_;
+}
+
+ScopedRandomEngine::ScopedRandomEngine(unsigned int seed, unsigned int job)
+  : prev_engine_(tRandomEngine) {
+  seed_seq job_seed { seed, job };
+  engine_.seed(job_seed);
+  tRandomEngine = &engine_;
+}
+
+ScopedRandomEngine::~ScopedRandomEngine() {
+  tRandomEngine = prev_engine_;
+}
+
+unsigned int NextRandomSeed(RandomStream stream) {
+  gRandomMutex.lock();
+  unsigned int seed = gRandomEngines[stream]();
+  gRandomMutex.unlock();
+  return seed;
+}
+
+void SeedRandom(unsigned int seed) {
+  gRandomMutex.lock();
+  gRandomEngines[RANDOM_SIMULATION].seed(seed);
+  for (int i = RANDOM_SIMULATION + 1; i < NUM_RANDOM_STREAMS; i++) {
+    seed_seq stream_seed { seed, (unsigned int) i };
+    gRandomEngines[i].seed(stream_seed);
+  }
+  gRandomMutex.unlock();
+}
+
 int Random(int low, int high) {
   if (high == 0) return 0;
   if (low == high) return low;
-  return low + (rand() % (high - low));
+
+  unsigned int r;
+  if (tRandomEngine) {
+    r = (*tRandomEngine)();
+  } else {
+    gRandomMutex.lock();
+    r = gRandomEngines[tRandomStream]();
+    gRandomMutex.unlock();
+  }
+  return low + int(r % (unsigned int) abs(high - low));
 }
 
 int RandomEven(int low, int high) {
@@ -6,6 +6,7 @@
 #include <exception>
 #include <memory>
 #include <queue>
+#include <random>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -30,6 +31,7 @@
 #include <boost/lexical_cast.hpp>  
 #include <boost/algorithm/string/predicate.hpp>
 #include "pugixml.hpp"
+#include "clock.hpp"
 
 #define GRAVITY 0.016
 
@@ -378,9 +380,14 @@ struct Keyframe {
   vector<mat4> transforms;
 };
 
+class CompressedAnimation;
+
+// Baked joint transforms for every frame. Meshes keep their animations
+// compressed, with no keyframes. Use SampleAnimation to read either.
 struct Animation {
   string name;
   vector<Keyframe> keyframes;
+  shared_ptr<CompressedAnimation> compressed;
 };
 
 struct SphereTreeNode {
@@ -521,8 +528,28 @@ const vector<int> kLevelUps { 10, 25, 45, 70, 100, 140, 200, 280, 380, 500 };
 const int kDungeonSize = 84;
 const int kDungeonCells = 6;
 
-GLuint GetUniformId(GLuint program_id, string name);
+GLuint GetUniformId(GLuint program_id, const string& name);
 void BindBuffer(const GLuint& buffer_id, int slot, int dimension);
+
+// Pixels of a decoded texture, with the first row at the bottom as GL
+// expects. PNGs are always RGBA, TGAs keep their depth.
+struct TextureImage {
+  int width = 0;
+  int height = 0;
+  int num_channels = 4;
+  vector<unsigned char> pixels;
+};
+
+// Decoding doesn't touch GL, so it can run on any thread. DecodeTexture
+// returns false for formats other than PNG and TGA. UploadTexture needs a
+// current context and creates the texture if texture_id is 0. With a window
+// it takes the texture lock and makes the window context current.
+void DecodePng(const char* file_name, TextureImage& image);
+void DecodeTga(const char* file_name, TextureImage& image);
+bool DecodeTexture(const char* file_name, TextureImage& image);
+GLuint UploadTexture(const TextureImage& image, GLuint texture_id);
+GLuint UploadTexture(const TextureImage& image, GLuint texture_id,
+  GLFWwindow* window);
 GLuint LoadPng(const char* file_name, GLuint texture_id, GLFWwindow* window = nullptr);
 GLuint LoadTga(const char* file_name, GLuint texture_id, GLFWwindow* window = nullptr);
 GLuint LoadTexture(const char* file_name, GLuint texture_id = 0);
@@ -646,7 +673,7 @@ bool LoadBoolFromXmlOr(const pugi::xml_node& node, const string& name, bool def)
 string LoadStringFromXmlOr(const pugi::xml_node& node, const string& name, const string& def);
 
 mat4 GetBoneTransform(Mesh& mesh, const string& animation_name, 
-  int bone_id, int frame);
+  int bone_id, float frame);
 
 int GetNumFramesInAnimation(Mesh& mesh, const string& animation_name);
 
@@ -673,6 +700,44 @@ void CreateCube(vector<vec3>& vertices, vector<vec2>& uvs,
   vector<unsigned int>& indices, vector<Polygon>& polygons,
   vec3 dimensions);
 
+// All gameplay randomness goes through Random so a session can be replayed
+// from its seed.
+//
+// The AI job runs alongside the simulation thread, so it draws from its own
+// stream. Each stream is seeded from the session seed and its sequence only
+// depends on the order of its own draws, not on thread interleaving.
+enum RandomStream {
+  RANDOM_SIMULATION = 0,
+  RANDOM_AI,
+  RANDOM_COLLISION,
+  NUM_RANDOM_STREAMS
+};
+
+// Makes Random draw from a stream on this thread while in scope.
+class ScopedRandomStream {
+  RandomStream prev_stream_;
+
+ public:
+  ScopedRandomStream(RandomStream stream);
+  ~ScopedRandomStream();
+};
+
+// Makes Random draw from a private engine on this thread while in scope.
+// Parallel jobs seed it from a per frame seed and their job index, so their
+// draws don't depend on which worker runs them or in what order.
+class ScopedRandomEngine {
+  mt19937 engine_;
+  mt19937* prev_engine_;
+
+ public:
+  ScopedRandomEngine(unsigned int seed, unsigned int job);
+  ~ScopedRandomEngine();
+};
+
+// Draws a seed for a ScopedRandomEngine from a stream.
+unsigned int NextRandomSeed(RandomStream stream);
+
+void SeedRandom(unsigned int seed);
 int Random(int low, int high);
 int RandomEven(int low, int high);
 bool IsNaN(const vec3& v);
@@ -0,0 +1,318 @@
+#include "visibility_culling.hpp"
+
+#include <chrono>
+#include "simd.hpp"
+
+using namespace simd;
+
+namespace {
+
+const Symbol kHandObject("hand-001");
+const Symbol kScepterObject("scepter-001");
+const Symbol kSkydomeObject("skydome");
+const Symbol kMapObject("map-001");
+
+// Objects smaller than this fraction of their distance are not drawn.
+const float kMinSizeInCamera = 0.005f;
+
+enum ObjectCull {
+  OBJECT_HIDDEN = 0,
+  OBJECT_TEST,
+  OBJECT_VISIBLE
+};
+
+// Checks that don't depend on the camera.
+ObjectCull GetObjectCull(GameObject* obj, const CullParams& params) {
+  switch (obj->type) {
+    case GAME_OBJ_DEFAULT:
+    case GAME_OBJ_REGION:
+    case GAME_OBJ_WAYPOINT:
+    case GAME_OBJ_DOOR:
+    case GAME_OBJ_ACTIONABLE:
+    case GAME_OBJ_DESTRUCTIBLE:
+      break;
+    case GAME_OBJ_MISSILE: {
+      if (obj->life > 0.0f || obj->scale_out > 0.0f) break;
+      return OBJECT_HIDDEN;
+    }
+    case GAME_OBJ_PARTICLE: {
+      if (obj->Is3dParticle()) break;
+      return OBJECT_HIDDEN;
+    }
+    default:
+      return OBJECT_HIDDEN;
+  }
+
+  // Dungeon pieces are drawn from the dungeon render data.
+  if (obj->IsDungeonPiece()) return OBJECT_HIDDEN;
+
+  if (obj->name_symbol == kHandObject) return OBJECT_HIDDEN;
+  if (obj->name_symbol == kScepterObject) return OBJECT_HIDDEN;
+  if (obj->name_symbol == kSkydomeObject) return OBJECT_HIDDEN;
+  if (obj->name_symbol == kMapObject) return OBJECT_HIDDEN;
+  if (obj->never_cull) return OBJECT_VISIBLE;
+  if (obj->IsInvisible() && !params.see_invisible) return OBJECT_HIDDEN;
+  if (obj->always_cull) return OBJECT_HIDDEN;
+  if (obj->IsSecret() && params.see_invisible) return OBJECT_HIDDEN;
+  if (!obj->draw) return OBJECT_HIDDEN;
+  if (obj->Is3dParticle() && obj->life <= 0) return OBJECT_HIDDEN;
+  return OBJECT_TEST;
+}
+
+AABB GetLooseAABB(const OctreeNode* node) {
+  return AABB(node->center - node->loose_half_dimensions,
+    node->loose_half_dimensions * 2.0f);
+}
+
+} // namespace
+
+void SpherePacket::Add(const BoundingSphere& sphere) {
+  x[num_spheres] = sphere.center.x;
+  y[num_spheres] = sphere.center.y;
+  z[num_spheres] = sphere.center.z;
+  radius[num_spheres] = sphere.radius;
+  num_spheres++;
+}
+
+void AABBPacket::Add(const AABB& aabb) {
+  min_x[num_boxes] = aabb.point.x;
+  min_y[num_boxes] = aabb.point.y;
+  min_z[num_boxes] = aabb.point.z;
+  max_x[num_boxes] = aabb.point.x + aabb.dimensions.x;
+  max_y[num_boxes] = aabb.point.y + aabb.dimensions.y;
+  max_z[num_boxes] = aabb.point.z + aabb.dimensions.z;
+  num_boxes++;
+}
+
+int CollideSpherePacketFrustum(const SpherePacket& packet,
+  const vec4 planes[6], const vec3& camera_pos) {
+  const Lanes zero = Broadcast(0.0f);
+  const Lanes true_mask = Less(zero, Broadcast(1.0f));
+  int mask = 0;
+  for (int i = 0; i < packet.num_spheres; i += kLanes) {
+    Lanes x = Sub(LoadLanes(&packet.x[i]), Broadcast(camera_pos.x));
+    Lanes y = Sub(LoadLanes(&packet.y[i]), Broadcast(camera_pos.y));
+    Lanes z = Sub(LoadLanes(&packet.z[i]), Broadcast(camera_pos.z));
+    Lanes radius = LoadLanes(&packet.radius[i]);
+
+    Lanes outside = zero;
+    for (int j = 0; j < 6; j++) {
+      const vec4& p = planes[j];
+      Lanes dist = Add(Add(Mul(x, Broadcast(p.x)), Mul(y, Broadcast(p.y))),
+        Mul(z, Broadcast(p.z)));
+      dist = Add(Add(dist, Broadcast(p.w)), radius);
+      outside = Select(Less(dist, zero), true_mask, outside);
+    }
+    mask |= (~MoveMask(outside) & ((1 << kLanes) - 1)) << i;
+  }
+  return mask & ((1 << packet.num_spheres) - 1);
+}
+
+int CollideAABBPacketFrustum(const AABBPacket& packet, const vec4 planes[6],
+  const vec3& camera_pos, float max_distance) {
+  const Lanes zero = Broadcast(0.0f);
+  const Lanes true_mask = Less(zero, Broadcast(1.0f));
+  const Lanes cam_x = Broadcast(camera_pos.x);
+  const Lanes cam_y = Broadcast(camera_pos.y);
+  const Lanes cam_z = Broadcast(camera_pos.z);
+
+  int mask = 0;
+  for (int i = 0; i < packet.num_boxes; i += kLanes) {
+    Lanes min_x = LoadLanes(&packet.min_x[i]);
+    Lanes min_y = LoadLanes(&packet.min_y[i]);
+    Lanes min_z = LoadLanes(&packet.min_z[i]);
+    Lanes max_x = LoadLanes(&packet.max_x[i]);
+    Lanes max_y = LoadLanes(&packet.max_y[i]);
+    Lanes max_z = LoadLanes(&packet.max_z[i]);
+
+    // Boxes that contain the camera are always visible.
+    Lanes contains = And(LessEqual(min_x, cam_x), LessEqual(cam_x, max_x));
+    contains = And(contains,
+      And(LessEqual(min_y, cam_y), LessEqual(cam_y, max_y)));
+    contains = And(contains,
+      And(LessEqual(min_z, cam_z), LessEqual(cam_z, max_z)));
+
+    // The vertex farthest along the plane normal is outside only if the
+    // whole box is.
+    Lanes outside = zero;
+    for (int j = 0; j < 6; j++) {
+      const vec4& p = planes[j];
+      Lanes x = Sub((p.x < 0) ? min_x : max_x, cam_x);
+      Lanes y = Sub((p.y < 0) ? min_y : max_y, cam_y);
+      Lanes z = Sub((p.z < 0) ? min_z : max_z, cam_z);
+      Lanes dist = Add(Add(Mul(x, Broadcast(p.x)), Mul(y, Broadcast(p.y))),
+        Mul(z, Broadcast(p.z)));
+      dist = Add(dist, Broadcast(p.w));
+      outside = Select(Less(dist, zero), true_mask, outside);
+    }
+    outside = Select(contains, zero, outside);
+
+    if (max_distance >= 0.0f) {
+      Lanes dx = Sub(Min(Max(cam_x, min_x), max_x), cam_x);
+      Lanes dy = Sub(Min(Max(cam_y, min_y), max_y), cam_y);
+      Lanes dz = Sub(Min(Max(cam_z, min_z), max_z), cam_z);
+      Lanes dist2 = Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz));
+      Lanes too_far = Less(Broadcast(max_distance * max_distance), dist2);
+      outside = Select(too_far, true_mask, outside);
+    }
+    mask |= (~MoveMask(outside) & ((1 << kLanes) - 1)) << i;
+  }
+  return mask & ((1 << packet.num_boxes) - 1);
+}
+
+VisibilityCuller::VisibilityCuller(shared_ptr<JobSystem> job_system,
+  int split_depth) : job_system_(job_system),
+  cull_jobs_(make_shared<JobCounter>()), split_depth_(split_depth) {}
+
+int VisibilityCuller::CullChildren(OctreeNode* node) {
+  AABBPacket packet;
+  int indices[8];
+  for (int i = 0; i < 8; i++) {
+    if (!node->children[i]) continue;
+    indices[packet.num_boxes] = i;
+    packet.Add(GetLooseAABB(node->children[i].get()));
+  }
+
+  int mask = CollideAABBPacketFrustum(packet, params_.frustum_planes,
+    params_.camera_pos, params_.max_distance);
+
+  int children_mask = 0;
+  for (int i = 0; i < packet.num_boxes; i++) {
+    if (mask & (1 << i)) children_mask |= 1 << indices[i];
+  }
+  return children_mask;
+}
+
+void VisibilityCuller::CullCandidates(JobOutput& output) {
+  const vec3& camera_pos = params_.camera_pos;
+  SpherePacket packet;
+  const int num_candidates = output.candidates.size();
+  for (int start = 0; start < num_candidates; start += kBoundsPacketSize) {
+    int end = std::min(start + kBoundsPacketSize, num_candidates);
+    packet.Clear();
+    for (int i = start; i < end; i++) {
+      packet.Add(output.candidates[i]->GetTransformedBoundingSphere());
+    }
+
+    int mask = CollideSpherePacketFrustum(packet, params_.frustum_planes,
+      camera_pos);
+    for (int i = 0; i < packet.num_spheres; i++) {
+      if (!(mask & (1 << i))) continue;
+
+      ObjPtr obj = output.candidates[start + i];
+      obj->distance = length(camera_pos - obj->position);
+      if (params_.max_distance >= 0.0f &&
+        obj->distance > params_.max_distance) continue;
+
+      float size_in_camera = packet.radius[i] / obj->distance;
+      if (obj->type != GAME_OBJ_MISSILE &&
+        size_in_camera < kMinSizeInCamera) continue;
+      output.visible.push_back(obj);
+    }
+  }
+  output.candidates.clear();
+}
+
+void VisibilityCuller::CullObjectList(ObjectList& objs,
+  JobOutput& output) {
+  for (ObjPtr obj : objs) {
+    switch (GetObjectCull(obj.get(), params_)) {
+      case OBJECT_HIDDEN:
+        break;
+      case OBJECT_TEST:
+        output.candidates.push_back(obj);
+        break;
+      case OBJECT_VISIBLE:
+        output.visible.push_back(obj);
+        break;
+    }
+  }
+}
+
+void VisibilityCuller::CullObjects(OctreeNode* node, JobOutput& output) {
+  output.num_nodes++;
+  CullObjectList(node->objects, output);
+  CullObjectList(node->moving_objs, output);
+  output.num_tested += output.candidates.size();
+  CullCandidates(output);
+}
+
+void VisibilityCuller::CullSubtree(OctreeNode* node, JobOutput& output) {
+  CullObjects(node, output);
+  int mask = CullChildren(node);
+  for (int i = 0; i < 8; i++) {
+    if (mask & (1 << i)) CullSubtree(node->children[i].get(), output);
+  }
+}
+
+void VisibilityCuller::Split(shared_ptr<OctreeNode> node, int depth,
+  vector<shared_ptr<OctreeNode>>& shallow_nodes,
+  vector<shared_ptr<OctreeNode>>& subtrees) {
+  if (depth >= split_depth_) {
+    subtrees.push_back(node);
+    return;
+  }
+
+  shallow_nodes.push_back(node);
+  int mask = CullChildren(node.get());
+  for (int i = 0; i < 8; i++) {
+    if (mask & (1 << i)) {
+      Split(node->children[i], depth + 1, shallow_nodes, subtrees);
+    }
+  }
+}
+
+void VisibilityCuller::Cull(shared_ptr<OctreeNode> root,
+  const CullParams& params, vector<ObjPtr>& visible) {
+  auto start_time = chrono::steady_clock::now();
+  metrics_ = CullMetrics();
+  if (!root) return;
+
+  params_ = params;
+  AABBPacket packet;
+  packet.Add(GetLooseAABB(root.get()));
+  if (!CollideAABBPacketFrustum(packet, params_.frustum_planes,
+    params_.camera_pos, params_.max_distance)) {
+    return;
+  }
+
+  vector<shared_ptr<OctreeNode>> shallow_nodes, subtrees;
+  Split(root, 0, shallow_nodes, subtrees);
+
+  // The last output is for the shallow nodes.
+  while (outputs_.size() < subtrees.size() + 1) {
+    outputs_.push_back(make_unique<JobOutput>());
+  }
+  for (size_t i = 0; i <= subtrees.size(); i++) {
+    outputs_[i]->visible.clear();
+    outputs_[i]->num_nodes = 0;
+    outputs_[i]->num_tested = 0;
+  }
+
+  for (size_t i = 0; i < subtrees.size(); i++) {
+    OctreeNode* node = subtrees[i].get();
+    JobOutput* output = outputs_[i].get();
+    job_system_->Run([this, node, output]() {
+      CullSubtree(node, *output);
+    }, cull_jobs_);
+  }
+
+  JobOutput& shallow_output = *outputs_[subtrees.size()];
+  for (shared_ptr<OctreeNode> node : shallow_nodes) {
+    CullObjects(node.get(), shallow_output);
+  }
+  job_system_->Wait(cull_jobs_);
+
+  metrics_.num_jobs = subtrees.size();
+  for (size_t i = 0; i <= subtrees.size(); i++) {
+    const JobOutput& output = *outputs_[i];
+    visible.insert(visible.end(), output.visible.begin(),
+      output.visible.end());
+    metrics_.num_nodes += output.num_nodes;
+    metrics_.num_tested += output.num_tested;
+    metrics_.num_visible += output.visible.size();
+  }
+
+  metrics_.cull_time = chrono::duration<double>(
+    chrono::steady_clock::now() - start_time).count();
+}
@@ -0,0 +1,108 @@
+#ifndef __VISIBILITY_CULLING_HPP__
+#define __VISIBILITY_CULLING_HPP__
+
+#include <memory>
+#include <vector>
+#include <glm/glm.hpp>
+#include "collision.hpp"
+#include "game_object.hpp"
+#include "space_partition.hpp"
+#include "job_system.hpp"
+
+using namespace std;
+using namespace glm;
+
+const int kBoundsPacketSize = 8;
+
+// Up to kBoundsPacketSize bounding spheres in structure of arrays layout, so
+// they can be tested against the frustum planes with SIMD instructions.
+struct alignas(32) SpherePacket {
+  float x[kBoundsPacketSize] = {}, y[kBoundsPacketSize] = {},
+    z[kBoundsPacketSize] = {};
+  float radius[kBoundsPacketSize] = {};
+  int num_spheres = 0;
+
+  void Clear() { num_spheres = 0; }
+  void Add(const BoundingSphere& sphere);
+};
+
+// Up to kBoundsPacketSize boxes, one for each child of an octree node.
+struct alignas(32) AABBPacket {
+  float min_x[kBoundsPacketSize] = {}, min_y[kBoundsPacketSize] = {},
+    min_z[kBoundsPacketSize] = {};
+  float max_x[kBoundsPacketSize] = {}, max_y[kBoundsPacketSize] = {},
+    max_z[kBoundsPacketSize] = {};
+  int num_boxes = 0;
+
+  void Clear() { num_boxes = 0; }
+  void Add(const AABB& aabb);
+};
+
+// Same tests as CollideSphereFrustum and CollideAABBFrustum, where the
+// planes are relative to camera_pos. Return the bit mask of the bounds that
+// are not completely outside the frustum. Boxes farther than max_distance
+// from the camera are also rejected, unless max_distance is negative.
+int CollideSpherePacketFrustum(const SpherePacket& packet,
+  const vec4 planes[6], const vec3& camera_pos);
+int CollideAABBPacketFrustum(const AABBPacket& packet, const vec4 planes[6],
+  const vec3& camera_pos, float max_distance);
+
+struct CullParams {
+  vec4 frustum_planes[6];
+  vec3 camera_pos;
+
+  // Negative to disable distance culling, like in the town.
+  float max_distance = -1.0f;
+  bool see_invisible = false;
+};
+
+struct CullMetrics {
+  int num_jobs = 0;
+  int num_nodes = 0;
+  int num_tested = 0;
+  int num_visible = 0;
+  double cull_time = 0;
+};
+
+// Finds the objects in an octree that may be visible from the camera. The
+// first levels of the tree are walked on the calling thread and every
+// subtree below split_depth becomes a job. Jobs test the children of a node
+// and the bounding spheres of its objects in packets and write to their own
+// output list, so nothing is locked until the lists are merged.
+class VisibilityCuller {
+  struct JobOutput {
+    vector<ObjPtr> visible;
+    vector<ObjPtr> candidates;
+    int num_nodes = 0;
+    int num_tested = 0;
+  };
+
+  shared_ptr<JobSystem> job_system_;
+  shared_ptr<JobCounter> cull_jobs_;
+  int split_depth_;
+
+  // Only valid during Cull.
+  CullParams params_;
+  vector<unique_ptr<JobOutput>> outputs_;
+  CullMetrics metrics_;
+
+  void Split(shared_ptr<OctreeNode> node, int depth,
+    vector<shared_ptr<OctreeNode>>& shallow_nodes,
+    vector<shared_ptr<OctreeNode>>& subtrees);
+  int CullChildren(OctreeNode* node);
+  void CullObjects(OctreeNode* node, JobOutput& output);
+  void CullObjectList(ObjectList& objs, JobOutput& output);
+  void CullCandidates(JobOutput& output);
+  void CullSubtree(OctreeNode* node, JobOutput& output);
+
+ public:
+  VisibilityCuller(shared_ptr<JobSystem> job_system, int split_depth = 2);
+
+  // Appends the visible objects to visible, in no particular order.
+  void Cull(shared_ptr<OctreeNode> root, const CullParams& params,
+    vector<ObjPtr>& visible);
+
+  const CullMetrics& GetMetrics() { return metrics_; }
+};
+
+#endif // __VISIBILITY_CULLING_HPP__
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <chrono>
+#include "fbx_loader.hpp"
+#include "compressed_animation.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+// Compresses the animations of every animated FBX file under a directory
+// and compares the memory and the cost of sampling a pose against the
+// baked keyframes. Baked poses snap to the frame, compressed poses are
+// sampled between frames.
+//
+// Usage: animation_benchmark [directory] [num_samples]
+namespace {
+
+// Keeps the sampling loops from being optimized away.
+volatile float sink = 0.0f;
+
+double Now() {
+  return duration<double, micro>(
+    steady_clock::now().time_since_epoch()).count();
+}
+
+struct AnimationStats {
+  size_t baked_bytes = 0;
+  size_t compressed_bytes = 0;
+  long long num_keys = 0;
+  long long num_baked_keys = 0;
+  double compress_us = 0;
+  double baked_sample_us = 0;
+  double compressed_sample_us = 0;
+  float max_error = 0;
+  int num_animations = 0;
+
+  void Add(const AnimationStats& s) {
+    baked_bytes += s.baked_bytes;
+    compressed_bytes += s.compressed_bytes;
+    num_keys += s.num_keys;
+    num_baked_keys += s.num_baked_keys;
+    compress_us += s.compress_us;
+    baked_sample_us += s.baked_sample_us;
+    compressed_sample_us += s.compressed_sample_us;
+    max_error = std::max(max_error, s.max_error);
+    num_animations += s.num_animations;
+  }
+};
+
+float GetMaxDifference(const mat4& a, const mat4& b) {
+  float d = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) d = std::max(d, abs(a[i][j] - b[i][j]));
+  }
+  return d;
+}
+
+AnimationStats RunAnimation(const Animation& animation, int num_samples) {
+  AnimationStats stats;
+  if (animation.keyframes.empty()) return stats;
+  stats.num_animations = 1;
+  stats.baked_bytes = GetBakedMemoryUsage(animation);
+
+  double start = Now();
+  CompressedAnimation compressed(animation);
+  stats.compress_us = Now() - start;
+  stats.compressed_bytes = compressed.GetMemoryUsage();
+  stats.num_keys = compressed.GetNumKeys();
+  stats.num_baked_keys = 3LL * compressed.GetNumJoints() *
+    compressed.GetNumFrames();
+
+  vector<mat4> transforms;
+  for (int frame = 0; frame < compressed.GetNumFrames(); frame++) {
+    compressed.Sample(frame, transforms);
+    const vector<mat4>& baked = animation.keyframes[frame].transforms;
+    for (int joint = 0; joint < baked.size(); joint++) {
+      stats.max_error = std::max(stats.max_error,
+        GetMaxDifference(transforms[joint], baked[joint]));
+    }
+  }
+
+  // Same sequence of times for both, a bit more than a frame apart.
+  float num_frames = compressed.GetNumFrames();
+  float checksum = 0.0f;
+  start = Now();
+  for (int i = 0; i < num_samples; i++) {
+    float frame = fmod(i * 1.37f, num_frames);
+    SampleAnimation(animation, frame, transforms);
+    checksum += transforms.empty() ? 0.0f : transforms[0][3][0];
+  }
+  stats.baked_sample_us = (Now() - start) / num_samples;
+
+  start = Now();
+  for (int i = 0; i < num_samples; i++) {
+    float frame = fmod(i * 1.37f, num_frames);
+    compressed.Sample(frame, transforms);
+    checksum += transforms.empty() ? 0.0f : transforms[0][3][0];
+  }
+  stats.compressed_sample_us = (Now() - start) / num_samples;
+
+  sink = checksum;
+  return stats;
+}
+
+void PrintStats(const string& name, const AnimationStats& s) {
+  cout << name << "\t" << s.num_animations << "\t" << s.baked_bytes / 1024
+    << "\t" << s.compressed_bytes / 1024 << "\t"
+    << double(s.baked_bytes) / std::max(size_t(1), s.compressed_bytes)
+    << "\t" << double(s.num_keys) / std::max(1LL, s.num_baked_keys) << "\t"
+    << s.max_error << "\t" << s.compress_us / 1000.0 << "\t"
+    << s.baked_sample_us / std::max(1, s.num_animations) << "\t"
+    << s.compressed_sample_us / std::max(1, s.num_animations) << endl;
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  const string directory = (argc > 1) ? argv[1] : "resources/models_fbx";
+  int num_samples = (argc > 2) ? atoi(argv[2]) : 1000;
+
+  cout << "mesh\tanims\tbaked_kb\tcompressed_kb\tratio\tkeys_kept\t"
+    "max_error\tcompress_ms\tbaked_sample_us\tcompressed_sample_us" << endl;
+
+  AnimationStats total;
+  boost::filesystem::recursive_directory_iterator end_itr;
+  for (boost::filesystem::recursive_directory_iterator itr(directory);
+    itr != end_itr; ++itr) {
+    if (!is_regular_file(itr->path())) continue;
+    if (!boost::iends_with(itr->path().string(), ".fbx")) continue;
+
+    const string fbx_filename = itr->path().string();
+    MeshData mesh_data;
+    if (!LoadMeshCache(fbx_filename, mesh_data)) {
+      FbxData data;
+      data.name = fbx_filename;
+      FbxLoad(fbx_filename, data);
+      mesh_data.animations = data.raw_mesh.animations;
+    }
+    if (mesh_data.animations.empty()) continue;
+
+    AnimationStats mesh_stats;
+    for (const Animation& animation : mesh_data.animations) {
+      mesh_stats.Add(RunAnimation(animation, num_samples));
+    }
+    PrintStats(itr->path().stem().string(), mesh_stats);
+    total.Add(mesh_stats);
+  }
+  PrintStats("total", total);
+  return 0;
+}
@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include "sweep_and_prune.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+// Measures the time to find collision pairs for an increasing number of
+// moving objects over a dense grid of static boxes. The sweep and prune
+// broadphase is compared with the previous method, which scanned a list of
+// static objects sorted along one axis for every moving object.
+//
+// Usage: broadphase_benchmark [num_frames]
+namespace {
+
+const int kGridSize = 100;
+const float kGridSpacing = 2.0f;
+const float kWorldSize = kGridSize * kGridSpacing;
+const float kRadius = 1.0f;
+
+struct StaticBox {
+  float start, end;
+  vec3 min, max;
+};
+
+struct MovingObj {
+  vec3 position;
+  vec3 speed;
+  int handle;
+};
+
+double Now() {
+  return duration<double, micro>(
+    steady_clock::now().time_since_epoch()).count();
+}
+
+bool Overlaps(const vec3& min1, const vec3& max1, const vec3& min2,
+  const vec3& max2) {
+  for (int axis = 0; axis < 3; axis++) {
+    if (min1[axis] > max2[axis] || min2[axis] > max1[axis]) return false;
+  }
+  return true;
+}
+
+void Move(MovingObj& obj, mt19937& rng) {
+  uniform_real_distribution<float> turn(-0.1f, 0.1f);
+  obj.speed = obj.speed + vec3(turn(rng), 0.0f, turn(rng));
+  obj.position = obj.position + obj.speed;
+  for (int axis : { 0, 2 }) {
+    if (obj.position[axis] < 0.0f || obj.position[axis] > kWorldSize) {
+      obj.speed[axis] = -obj.speed[axis];
+    }
+  }
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  int num_frames = (argc > 1) ? atoi(argv[1]) : 100;
+
+  // Static boxes lie on the ground, moving objects walk over them.
+  vector<StaticBox> static_boxes;
+  for (int x = 0; x < kGridSize; x++) {
+    for (int z = 0; z < kGridSize; z++) {
+      vec3 min = vec3(x * kGridSpacing, 0.0f, z * kGridSpacing);
+      vec3 max = min + vec3(1.5f, 1.5f, 1.5f);
+      static_boxes.push_back({ min.x, max.x, min, max });
+    }
+  }
+  sort(static_boxes.begin(), static_boxes.end(),
+    [] (const StaticBox& a, const StaticBox& b) { return a.start < b.start; });
+
+  cout << "Static boxes: " << static_boxes.size() << endl;
+  cout << "objects\tsap_us\tscan_us\tpairs\tswaps" << endl;
+  for (int num_objs : { 100, 250, 500, 1000, 2500, 5000 }) {
+    mt19937 rng(num_objs);
+    uniform_real_distribution<float> position(0.0f, kWorldSize);
+    uniform_real_distribution<float> speed(-0.5f, 0.5f);
+
+    SweepAndPrune broadphase;
+    for (int i = 0; i < static_boxes.size(); i++) {
+      broadphase.AddProxy(i, static_boxes[i].min, static_boxes[i].max, true);
+    }
+
+    vector<MovingObj> objs(num_objs);
+    for (int i = 0; i < num_objs; i++) {
+      objs[i].position = vec3(position(rng), 1.0f, position(rng));
+      objs[i].speed = vec3(speed(rng), 0.0f, speed(rng));
+      objs[i].handle = broadphase.AddProxy(static_boxes.size() + i,
+        objs[i].position - vec3(kRadius), objs[i].position + vec3(kRadius));
+    }
+    broadphase.Commit();
+
+    double sap_time = 0, scan_time = 0;
+    size_t num_pairs = 0;
+    int initial_swaps = broadphase.GetMetrics().num_swaps;
+    vector<pair<int, int>> pairs;
+    vector<pair<int, int>> scan_pairs;
+    for (int frame = 0; frame < num_frames; frame++) {
+      for (MovingObj& obj : objs) Move(obj, rng);
+
+      double start = Now();
+      for (MovingObj& obj : objs) {
+        broadphase.UpdateProxy(obj.handle, obj.position - vec3(kRadius),
+          obj.position + vec3(kRadius));
+      }
+      broadphase.Commit();
+      broadphase.GetPairs(pairs);
+      sap_time += Now() - start;
+      num_pairs += pairs.size();
+
+      // Moving against static only, the moving pairs came from the octree.
+      start = Now();
+      scan_pairs.clear();
+      for (int i = 0; i < objs.size(); i++) {
+        vec3 min = objs[i].position - vec3(kRadius);
+        vec3 max = objs[i].position + vec3(kRadius);
+        for (int j = 0; j < static_boxes.size(); j++) {
+          const StaticBox& box = static_boxes[j];
+          if (box.start > max.x) break;
+          if (box.end < min.x) continue;
+          if (Overlaps(min, max, box.min, box.max)) {
+            scan_pairs.push_back({ i, j });
+          }
+        }
+      }
+      scan_time += Now() - start;
+    }
+
+    cout << num_objs << "\t" << sap_time / num_frames << "\t"
+         << scan_time / num_frames << "\t" << num_pairs / num_frames << "\t"
+         << (broadphase.GetMetrics().num_swaps - initial_swaps) / num_frames
+         << endl;
+  }
+  return 0;
+}
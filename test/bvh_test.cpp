@@ -0,0 +1,138 @@
+#include <random>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "bvh.hpp"
+
+using namespace std;
+
+namespace {
+
+vector<Polygon> CreateRandomTriangles(int num_triangles, mt19937& rng) {
+  uniform_real_distribution<float> position(-50.0f, 50.0f);
+  uniform_real_distribution<float> offset(-2.0f, 2.0f);
+
+  vector<Polygon> polygons;
+  for (int i = 0; i < num_triangles; i++) {
+    vec3 a = vec3(position(rng), position(rng), position(rng));
+    Polygon polygon;
+    polygon.vertices = { a, a + vec3(offset(rng), offset(rng), offset(rng)),
+      a + vec3(offset(rng), offset(rng), offset(rng)) };
+    polygon.normal = vec3(0, 1, 0);
+    polygons.push_back(polygon);
+  }
+  return polygons;
+}
+
+bool IntersectRayTriangle(const vec3& p, const vec3& d, const Polygon& polygon,
+  float& t) {
+  const vector<vec3>& v = polygon.vertices;
+  vec3 e1 = v[1] - v[0];
+  vec3 e2 = v[2] - v[0];
+  vec3 pvec = cross(d, e2);
+  float det = dot(e1, pvec);
+  if (abs(det) < 1e-8f) return false;
+  vec3 tvec = p - v[0];
+  float u = dot(tvec, pvec) / det;
+  vec3 qvec = cross(tvec, e1);
+  float w = dot(d, qvec) / det;
+  if (u < 0.0f || w < 0.0f || u + w > 1.0f) return false;
+  t = dot(e2, qvec) / det;
+  return t >= 0.0f;
+}
+
+TEST(Bvh, RayQueryMatchesBruteForce) {
+  mt19937 rng(7);
+  vector<Polygon> polygons = CreateRandomTriangles(2000, rng);
+  Bvh bvh(polygons);
+  ASSERT_EQ(bvh.GetNumTriangles(), 2000);
+
+  uniform_real_distribution<float> position(-60.0f, 60.0f);
+  const vec3 base_position = vec3(10, 0, -5);
+  int num_hits = 0;
+  for (int i = 0; i < 500; i++) {
+    vec3 p = vec3(position(rng), position(rng), position(rng));
+    vec3 target = vec3(position(rng), position(rng), position(rng)) * 0.5f;
+    vec3 d = normalize(target - p);
+
+    float expected_t = numeric_limits<float>::max();
+    for (const Polygon& polygon : polygons) {
+      float t;
+      if (IntersectRayTriangle(p - base_position, d, polygon, t)) {
+        expected_t = std::min(expected_t, t);
+      }
+    }
+
+    float t;
+    vec3 q;
+    bool hit = bvh.IntersectRay(p, d, t, q, base_position);
+    ASSERT_EQ(hit, expected_t != numeric_limits<float>::max());
+    if (hit) {
+      num_hits++;
+      EXPECT_NEAR(t, expected_t, 1e-3f);
+      EXPECT_NEAR(length(q - (p + d * expected_t)), 0.0f, 1e-3f);
+    }
+  }
+  EXPECT_GT(num_hits, 0);
+}
+
+TEST(Bvh, SphereQueryFindsAllTouchingTriangles) {
+  mt19937 rng(11);
+  vector<Polygon> polygons = CreateRandomTriangles(1000, rng);
+  Bvh bvh(polygons);
+
+  uniform_real_distribution<float> position(-50.0f, 50.0f);
+  for (int i = 0; i < 200; i++) {
+    BoundingSphere s(vec3(position(rng), position(rng), position(rng)), 8.0f);
+    vector<int> triangles;
+    bvh.FindTriangles(s, triangles);
+
+    // Every triangle with a vertex inside the sphere must be returned.
+    int expected = 0;
+    for (const Polygon& polygon : polygons) {
+      for (const vec3& v : polygon.vertices) {
+        if (length(v - s.center) < s.radius) {
+          expected++;
+          break;
+        }
+      }
+    }
+    EXPECT_GE(triangles.size(), expected);
+
+    for (int triangle : triangles) {
+      const BvhTriangle& t = bvh.GetTriangle(triangle);
+      vec3 min = glm::min(t.a, glm::min(t.b, t.c));
+      vec3 max = glm::max(t.a, glm::max(t.b, t.c));
+      vec3 closest = glm::max(min, glm::min(s.center, max));
+      EXPECT_LE(length(closest - s.center), s.radius + 1e-4f);
+    }
+  }
+}
+
+TEST(Bvh, SaveAndLoad) {
+  mt19937 rng(3);
+  Bvh bvh(CreateRandomTriangles(300, rng));
+
+  stringstream ss;
+  bvh.Save(ss);
+
+  Bvh loaded;
+  loaded.Load(ss);
+  ASSERT_EQ(loaded.GetNumNodes(), bvh.GetNumNodes());
+  ASSERT_EQ(loaded.GetNumTriangles(), bvh.GetNumTriangles());
+
+  float t1, t2;
+  vec3 q1, q2;
+  vec3 p = vec3(-100, 0, 0);
+  vec3 d = vec3(1, 0, 0);
+  ASSERT_EQ(bvh.IntersectRay(p, d, t1, q1), loaded.IntersectRay(p, d, t2, q2));
+
+  stringstream bad("not a bvh");
+  EXPECT_THROW(loaded.Load(bad), runtime_error);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,40 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "clock.hpp"
+
+using namespace std;
+
+namespace {
+
+TEST(FixedStepClock, ShouldOnlyAdvanceOnTick) {
+  shared_ptr<FixedStepClock> clock = make_shared<FixedStepClock>(0.5, 10.0);
+  EXPECT_DOUBLE_EQ(10.0, clock->GetTime());
+  EXPECT_DOUBLE_EQ(10.0, clock->GetTime());
+
+  clock->Tick();
+  EXPECT_DOUBLE_EQ(10.5, clock->GetTime());
+
+  clock->Tick();
+  clock->Tick();
+  EXPECT_DOUBLE_EQ(11.5, clock->GetTime());
+}
+
+TEST(FixedStepClock, ShouldDriveGlobalTime) {
+  shared_ptr<Clock> old_clock = GetClock();
+
+  shared_ptr<FixedStepClock> clock = make_shared<FixedStepClock>(0.25);
+  SetClock(clock);
+  EXPECT_DOUBLE_EQ(0.0, GetTime());
+
+  clock->Tick();
+  EXPECT_DOUBLE_EQ(0.25, GetTime());
+
+  SetClock(old_clock);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,129 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "compressed_animation.hpp"
+
+using namespace std;
+
+namespace {
+
+const int kNumFrames = 48;
+
+mat4 MakeTransform(const vec3& translation, const quat& rotation,
+  float scale) {
+  mat4 m = mat4_cast(rotation);
+  m[0] = m[0] * scale;
+  m[1] = m[1] * scale;
+  m[2] = m[2] * scale;
+  m[3] = vec4(translation, 1.0f);
+  return m;
+}
+
+// Joint 0 does not move, joint 1 turns and slides at a constant speed and
+// joint 2 wobbles.
+Animation CreateAnimation() {
+  Animation animation;
+  animation.name = "walk";
+  for (int frame = 0; frame < kNumFrames; frame++) {
+    float t = float(frame) / (kNumFrames - 1);
+    Keyframe keyframe;
+    keyframe.time = frame;
+    keyframe.transforms.push_back(MakeTransform(vec3(0, 1, 0), quat(), 1.0f));
+    keyframe.transforms.push_back(MakeTransform(vec3(2.0f * t, 0, 0),
+      angleAxis(1.5f * t, vec3(0, 1, 0)), 1.0f));
+    keyframe.transforms.push_back(MakeTransform(
+      vec3(0, 0.3f * sin(6.0f * t), 0),
+      angleAxis(0.5f * sin(9.0f * t), normalize(vec3(1, 1, 0))),
+      1.0f + 0.2f * t));
+    animation.keyframes.push_back(keyframe);
+  }
+  return animation;
+}
+
+float GetMaxDifference(const mat4& a, const mat4& b) {
+  float d = 0.0f;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) d = std::max(d, abs(a[i][j] - b[i][j]));
+  }
+  return d;
+}
+
+TEST(CompressedAnimation, QuantizedQuatsKeepTheRotation) {
+  mt19937 rng(42);
+  normal_distribution<float> dist;
+  for (int i = 0; i < 1000; i++) {
+    quat q = normalize(quat(dist(rng), dist(rng), dist(rng), dist(rng)));
+    quat r = DequantizeQuat(QuantizeQuat(q));
+    EXPECT_GT(abs(dot(q, r)), 0.99999f);
+  }
+}
+
+TEST(CompressedAnimation, SamplesWithinTolerance) {
+  Animation animation = CreateAnimation();
+  CompressedAnimation compressed(animation);
+  ASSERT_EQ(compressed.GetNumFrames(), kNumFrames);
+  ASSERT_EQ(compressed.GetNumJoints(), 3);
+
+  for (int frame = 0; frame < kNumFrames; frame++) {
+    for (int joint = 0; joint < 3; joint++) {
+      EXPECT_LT(GetMaxDifference(compressed.Sample(joint, frame),
+        animation.keyframes[frame].transforms[joint]), 0.005f);
+    }
+  }
+
+  // The still joint needs one key per track and the linear one a few.
+  EXPECT_LT(compressed.GetNumKeys(), 3 * 3 * kNumFrames / 2);
+  EXPECT_LT(compressed.GetMemoryUsage(), GetBakedMemoryUsage(animation) / 4);
+}
+
+TEST(CompressedAnimation, InterpolatesBetweenFrames) {
+  Animation animation;
+  for (int frame = 0; frame < 2; frame++) {
+    Keyframe keyframe;
+    keyframe.time = frame;
+    keyframe.transforms.push_back(MakeTransform(vec3(frame, 0, 0), quat(),
+      1.0f));
+    animation.keyframes.push_back(keyframe);
+  }
+
+  // Baked animations snap to the frame.
+  EXPECT_EQ(SampleAnimation(animation, 0, 0.5f)[3][0], 0.0f);
+
+  animation.compressed = make_shared<CompressedAnimation>(animation);
+  animation.keyframes.clear();
+  EXPECT_EQ(GetNumFrames(animation), 2);
+  EXPECT_NEAR(SampleAnimation(animation, 0, 0.5f)[3][0], 0.5f, 1e-5f);
+  EXPECT_NEAR(SampleAnimation(animation, 0, 5.0f)[3][0], 1.0f, 1e-5f);
+
+  vector<mat4> transforms;
+  SampleAnimation(animation, 0.25f, transforms);
+  ASSERT_EQ(transforms.size(), 1);
+  EXPECT_NEAR(transforms[0][3][0], 0.25f, 1e-5f);
+  EXPECT_EQ(SampleAnimation(animation, 1, 0.0f)[3][0], 0.0f);
+}
+
+TEST(CompressedAnimation, KeepsShearedJointsBaked) {
+  Animation animation = CreateAnimation();
+  for (int frame = 0; frame < kNumFrames; frame++) {
+    animation.keyframes[frame].transforms[1][1][0] = 0.5f;
+  }
+
+  CompressedAnimation compressed(animation);
+  for (int frame = 0; frame < kNumFrames; frame++) {
+    EXPECT_LT(GetMaxDifference(compressed.Sample(1, frame),
+      animation.keyframes[frame].transforms[1]), 1e-6f);
+    EXPECT_LT(GetMaxDifference(compressed.Sample(2, frame),
+      animation.keyframes[frame].transforms[2]), 0.005f);
+  }
+
+  mat4 m = compressed.Sample(1, 10.5f);
+  EXPECT_EQ(m[1][0], 0.5f);
+  EXPECT_NEAR(m[3][0], (animation.keyframes[10].transforms[1][3][0] +
+    animation.keyframes[11].transforms[1][3][0]) / 2.0f, 1e-5f);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
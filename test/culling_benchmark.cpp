@@ -0,0 +1,138 @@
+#include <iostream>
+#include <chrono>
+#include "simulation.hpp"
+#include "monsters.hpp"
+#include "visibility_culling.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+// Replays camera paths over the arena used by wizard_sim and measures the
+// time to cull the outside sector octree. A split depth of zero runs the
+// whole traversal as a single job, which is the serial baseline.
+//
+// Usage: culling_benchmark [num_frames] [resources_dir]
+namespace {
+
+const float kAspectRatio = 16.0f / 9.0f;
+const float kCameraHeight = 10.0f;
+const float kOrbitRadius = 30.0f;
+
+struct CameraPose {
+  vec3 position;
+  vec3 direction;
+};
+
+double Now() {
+  return duration<double, micro>(
+    steady_clock::now().time_since_epoch()).count();
+}
+
+// Turns around the player looking outwards.
+vector<CameraPose> GetOrbitPath(const vec3& center, int num_frames) {
+  vector<CameraPose> path;
+  for (int i = 0; i < num_frames; i++) {
+    float angle = 2.0f * 3.14159f * i / num_frames;
+    vec3 direction = vec3(cos(angle), -0.2f, sin(angle));
+    vec3 position = center + vec3(0, kCameraHeight, 0) - direction *
+      kOrbitRadius;
+    path.push_back({ position, normalize(direction) });
+  }
+  return path;
+}
+
+// Flies in a straight line through the octree bounds looking forward.
+vector<CameraPose> GetFlyoverPath(shared_ptr<OctreeNode> root,
+  int num_frames) {
+  vector<CameraPose> path;
+  vec3 start = root->center - root->half_dimensions * vec3(0.9f, 0, 0.9f);
+  vec3 end = root->center + root->half_dimensions * vec3(0.9f, 0, 0.9f);
+  start.y = end.y = root->center.y + kCameraHeight;
+  vec3 direction = normalize(end - start - vec3(0, kCameraHeight, 0));
+  for (int i = 0; i < num_frames; i++) {
+    float t = float(i) / num_frames;
+    path.push_back({ start + (end - start) * t, direction });
+  }
+  return path;
+}
+
+CullParams GetCullParams(const CameraPose& pose, shared_ptr<Configs> configs) {
+  mat4 projection = glm::perspective(glm::radians(FIELD_OF_VIEW),
+    kAspectRatio, NEAR_CLIPPING, FAR_CLIPPING);
+  mat4 view = glm::lookAt(pose.position, pose.position + pose.direction,
+    vec3(0, 1, 0));
+
+  // Same planes as Renderer::GetFrustumPlanes, relative to the camera.
+  mat4 MVP = projection * view * translate(mat4(1.0), pose.position);
+
+  CullParams params;
+  ExtractFrustumPlanes(MVP, params.frustum_planes);
+  params.camera_pos = pose.position;
+  if (configs->render_scene != "town") {
+    params.max_distance = configs->light_radius + 5;
+  }
+  params.see_invisible = configs->see_invisible;
+  return params;
+}
+
+void RunPath(const string& name, const vector<CameraPose>& path,
+  shared_ptr<OctreeNode> root, shared_ptr<Configs> configs) {
+  for (int split_depth : { 0, 1, 2, 3 }) {
+    VisibilityCuller culler(GetJobSystem(), split_depth);
+    vector<ObjPtr> visible;
+
+    double total_time = 0, max_time = 0;
+    long long num_visible = 0, num_tested = 0, num_jobs = 0;
+    for (const CameraPose& pose : path) {
+      CullParams params = GetCullParams(pose, configs);
+      visible.clear();
+
+      double start = Now();
+      culler.Cull(root, params, visible);
+      double time = Now() - start;
+
+      total_time += time;
+      max_time = std::max(max_time, time);
+      num_visible += visible.size();
+      num_tested += culler.GetMetrics().num_tested;
+      num_jobs += culler.GetMetrics().num_jobs;
+    }
+
+    int n = path.size();
+    cout << name << "\t" << split_depth << "\t" << total_time / n << "\t"
+      << max_time << "\t" << num_jobs / n << "\t" << num_tested / n << "\t"
+      << num_visible / n << endl;
+  }
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  int num_frames = (argc > 1) ? atoi(argv[1]) : 360;
+  const string resources_dir = (argc > 2) ? argv[2] : "resources";
+  const string shaders_dir = "shaders";
+
+  shared_ptr<Resources> resources = make_shared<Resources>(resources_dir,
+    shaders_dir, nullptr);
+  shared_ptr<Physics> physics = make_shared<Physics>(resources);
+  shared_ptr<CollisionResolver> collision_resolver =
+    make_shared<CollisionResolver>(resources);
+  shared_ptr<Monsters> monsters = make_shared<Monsters>(resources);
+  shared_ptr<AI> ai = make_shared<AI>(resources, monsters);
+
+  resources->LoadGame("config.xml", false);
+
+  Simulation simulation(resources, collision_resolver, ai, physics);
+  simulation.LoadArena("dungeons/dungeon1.txt");
+
+  shared_ptr<Sector> sector = resources->GetSectorByName("outside");
+  shared_ptr<OctreeNode> root = sector->octree_node;
+  shared_ptr<Configs> configs = resources->GetConfigs();
+
+  cout << "Workers: " << GetJobSystem()->GetNumWorkers() << endl;
+  cout << "path\tsplit\tavg_us\tmax_us\tjobs\ttested\tvisible" << endl;
+  RunPath("orbit", GetOrbitPath(resources->GetPlayer()->position,
+    num_frames), root, configs);
+  RunPath("flyover", GetFlyoverPath(root, num_frames), root, configs);
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <cstdint>
+#include <cstring>
+#include "gtest/gtest.h"
+#include "frame_arena.hpp"
+
+using namespace std;
+
+namespace {
+
+struct Counted {
+  int* num_alive;
+  int value;
+
+  Counted(int* num_alive, int value) : num_alive(num_alive), value(value) {
+    (*num_alive)++;
+  }
+  ~Counted() { (*num_alive)--; }
+};
+
+TEST(FrameArena, ResetReusesMemory) {
+  FrameArena arena(1024);
+  void* first = arena.Allocate(100, 8);
+  arena.Allocate(100, 8);
+  EXPECT_EQ(arena.GetMetrics().num_allocations, 2);
+  EXPECT_EQ(arena.GetMetrics().memory_usage, 200);
+
+  arena.Reset();
+  EXPECT_EQ(arena.GetMetrics().num_allocations, 0);
+  EXPECT_EQ(arena.GetMetrics().memory_usage, 0);
+  EXPECT_EQ(arena.GetMetrics().max_allocations, 2);
+  EXPECT_EQ(arena.GetMetrics().max_memory_usage, 200);
+
+  EXPECT_EQ(arena.Allocate(100, 8), first);
+  EXPECT_EQ(arena.GetMetrics().capacity, 1024);
+}
+
+TEST(FrameArena, ResetCallsDestructors) {
+  int num_alive = 0;
+  FrameArena arena;
+  Counted* a = arena.New<Counted>(&num_alive, 1);
+  Counted* b = arena.New<Counted>(&num_alive, 2);
+  EXPECT_EQ(a->value, 1);
+  EXPECT_EQ(b->value, 2);
+  EXPECT_EQ(num_alive, 2);
+
+  arena.Reset();
+  EXPECT_EQ(num_alive, 0);
+
+  arena.New<Counted>(&num_alive, 3);
+  EXPECT_EQ(num_alive, 1);
+}
+
+TEST(FrameArena, AlignsAllocations) {
+  FrameArena arena(1024);
+  for (size_t alignment : { 1, 4, 8, 16, 32, 64, 128 }) {
+    arena.Allocate(1, 1);
+    void* ptr = arena.Allocate(24, alignment);
+    EXPECT_EQ((uintptr_t) ptr % alignment, 0u) << "alignment " << alignment;
+  }
+
+  // A fresh chunk also has to be aligned.
+  FrameArena small_arena(16);
+  void* ptr = small_arena.Allocate(64, 256);
+  EXPECT_EQ((uintptr_t) ptr % 256, 0u);
+}
+
+TEST(FrameArena, GrowsPastTheFirstChunk) {
+  FrameArena arena(256);
+  vector<char*> ptrs;
+  for (int i = 0; i < 10; i++) {
+    char* ptr = (char*) arena.Allocate(100, 8);
+    memset(ptr, i, 100);
+    ptrs.push_back(ptr);
+  }
+  EXPECT_GE(arena.GetMetrics().capacity, 1000);
+
+  // Earlier allocations are not overwritten by later ones.
+  for (int i = 0; i < 10; i++) {
+    for (int j = 0; j < 100; j++) ASSERT_EQ(ptrs[i][j], i);
+  }
+
+  // Larger than a chunk.
+  char* big = (char*) arena.Allocate(1000, 8);
+  memset(big, 1, 1000);
+
+  // After a reset the existing chunks are reused without growing.
+  size_t capacity = arena.GetMetrics().capacity;
+  arena.Reset();
+  for (int i = 0; i < 10; i++) arena.Allocate(100, 8);
+  arena.Allocate(1000, 8);
+  EXPECT_EQ(arena.GetMetrics().capacity, capacity);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
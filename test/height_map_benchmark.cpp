@@ -0,0 +1,124 @@
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include "height_map.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+// Compares height queries per second with and without the height cache, at
+// points of the map without noise, in the ring blended with noise and
+// outside the map. Queries are spread around a walking position, like the
+// physics queries around the player. Without a height map file, a random
+// one is written to the current directory.
+//
+// Usage: height_map_benchmark [height_map.hmap] [num_queries]
+namespace {
+
+// Keeps the query loops from being optimized away.
+volatile float sink = 0.0f;
+
+double Now() {
+  return duration<double>(steady_clock::now().time_since_epoch()).count();
+}
+
+void CreateHeightMap(const string& filename) {
+  vector<unsigned char> points(size_t(kHeightMapSize) * kHeightMapSize * 3);
+  for (int y = 0; y < kHeightMapSize; y++) {
+    for (int x = 0; x < kHeightMapSize; x++) {
+      float h = 20.0f * sin(x * 0.01f) * cos(y * 0.013f);
+      unsigned short compressed_h = int(h * 32) + 8192;
+      unsigned char* point = &points[(size_t(y) * kHeightMapSize + x) * 3];
+      point[0] = compressed_h >> 8;
+      point[1] = compressed_h & 255;
+      point[2] = (x / 64 + y / 64) % 4;
+    }
+  }
+  SaveTiledHeightMap(filename, points.data(), kHeightMapSize);
+}
+
+// Positions within a few meters of a path that crosses several cache tiles.
+vector<vec2> CreateQueries(vec2 start, int num_queries) {
+  mt19937 generator(1);
+  uniform_real_distribution<float> offset(-8.0f, 8.0f);
+  vector<vec2> positions;
+  for (int i = 0; i < num_queries; i++) {
+    vec2 center = start + vec2(i * 0.001f, i * 0.0005f);
+    positions.push_back(center + vec2(offset(generator), offset(generator)));
+  }
+  return positions;
+}
+
+double RunQueries(HeightMap& height_map, const vector<vec2>& positions) {
+  float checksum = 0.0f;
+  double start = Now();
+  for (const vec2& pos : positions) {
+    vec3 normal;
+    checksum += height_map.GetTerrainHeight(pos, &normal) + normal.y;
+  }
+  double elapsed = Now() - start;
+  sink = checksum;
+  return positions.size() / elapsed;
+}
+
+double RunBatchedQueries(HeightMap& height_map,
+  const vector<vec2>& positions) {
+  const int kBatchSize = 256;
+  vector<vec2> batch;
+  vector<float> heights;
+  float checksum = 0.0f;
+  double start = Now();
+  for (int i = 0; i < positions.size(); i += kBatchSize) {
+    batch.assign(positions.begin() + i, positions.begin() +
+      std::min(i + kBatchSize, int(positions.size())));
+    height_map.GetTerrainHeights(batch, heights);
+    checksum += heights[0];
+  }
+  double elapsed = Now() - start;
+  sink = checksum;
+  return positions.size() / elapsed;
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  string filename = (argc > 1) ? argv[1] : "";
+  int num_queries = (argc > 2) ? atoi(argv[2]) : 1000000;
+
+  bool remove_file = false;
+  if (filename.empty()) {
+    filename = "height_map_benchmark.hmap";
+    CreateHeightMap(filename);
+    remove_file = true;
+  }
+  HeightMap height_map(filename);
+
+  const int half_size = height_map.GetSize() / 2;
+  vector<pair<string, vec2>> locations {
+    { "center", vec2(11768, 7687) },
+    { "blended", vec2(kWorldCenter.x + half_size * 0.7f, kWorldCenter.z) },
+    { "outside", vec2(kWorldCenter.x + half_size * 1.5f, kWorldCenter.z) },
+  };
+
+  cout << "location\tuncached_qps\tcold_qps\twarm_qps\tbatched_qps\t"
+    "speedup" << endl;
+  for (const auto& [name, start] : locations) {
+    vector<vec2> positions = CreateQueries(start, num_queries);
+
+    height_map.EnableCache(false);
+    double uncached = RunQueries(height_map, positions);
+
+    // The first run bakes the tiles.
+    height_map.EnableCache(true);
+    double cold = RunQueries(height_map, positions);
+    double warm = RunQueries(height_map, positions);
+    double batched = RunBatchedQueries(height_map, positions);
+
+    cout << name << "\t" << uncached << "\t" << cold << "\t" << warm << "\t"
+      << batched << "\t" << warm / uncached << endl;
+  }
+
+  if (remove_file) remove(filename.c_str());
+  return 0;
+}
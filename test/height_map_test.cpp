@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <vector>
+#include "gtest/gtest.h"
+#include "height_map.hpp"
+
+using namespace std;
+
+namespace {
+
+const int kSize = 1000;
+
+// A map of 4x4 tiles, the last ones only partially covered. Heights go
+// from 0 to 99 along the diagonals.
+vector<unsigned char> CreatePoints() {
+  vector<unsigned char> points(kSize * kSize * 3);
+  for (int y = 0; y < kSize; y++) {
+    for (int x = 0; x < kSize; x++) {
+      unsigned short h = ((x + y) % 100) * 32 + 8192;
+      unsigned char* point = &points[(y * kSize + x) * 3];
+      point[0] = h >> 8;
+      point[1] = h & 255;
+      point[2] = x % 4;
+    }
+  }
+  return points;
+}
+
+// World coordinates of a point of the map.
+ivec2 GetWorldCoords(int hm_x, int hm_y) {
+  return ivec2(hm_x + kWorldCenter.x - kSize / 2,
+    hm_y + kWorldCenter.z - kSize / 2);
+}
+
+TEST(HeightMap, ReadsPointsFromTiles) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  HeightMap height_map(filename);
+  EXPECT_EQ(height_map.GetSize(), kSize);
+  for (int hm_y : { 0, 255, 256, 700, 999 }) {
+    for (int hm_x : { 0, 255, 256, 511, 999 }) {
+      ivec2 pos = GetWorldCoords(hm_x, hm_y);
+      EXPECT_EQ(height_map.GetTerrainPoint(pos.x, pos.y, false).tile,
+        hm_x % 4);
+    }
+  }
+
+  // Close to the noise center the heights are not blended with noise.
+  ivec2 pos = ivec2(11768, 7700);
+  ivec2 hm = pos - GetWorldCoords(0, 0);
+  EXPECT_FLOAT_EQ(height_map.GetTerrainPoint(pos.x, pos.y).height,
+    (hm.x + hm.y) % 100);
+  remove(filename.c_str());
+}
+
+TEST(HeightMap, MaxHeightBoundsTheTerrain) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  HeightMap height_map(filename);
+  for (int hm_y = -20; hm_y < kSize + 20; hm_y += 37) {
+    for (int hm_x = -20; hm_x < kSize + 20; hm_x += 41) {
+      vec2 pos = vec2(GetWorldCoords(hm_x, hm_y)) + vec2(0.3f, 0.6f);
+      EXPECT_LE(height_map.GetTerrainHeight(pos.x, pos.y),
+        height_map.GetMaxTerrainHeight(pos));
+    }
+  }
+  remove(filename.c_str());
+}
+
+TEST(HeightMap, SavesEditedPoints) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  ivec2 pos = ivec2(11768, 7700);
+  {
+    HeightMap height_map(filename);
+    TerrainPoint p = height_map.GetTerrainPoint(pos.x, pos.y);
+    p.height = 500.0f;
+    p.tile = 2;
+    height_map.SetTerrainPoint(pos.x, pos.y, p);
+    EXPECT_FLOAT_EQ(height_map.GetTerrainPoint(pos.x, pos.y).height, 500.0f);
+    EXPECT_GE(height_map.GetMaxTerrainHeight(vec2(pos)), 500.0f);
+    height_map.Save();
+    EXPECT_FLOAT_EQ(height_map.GetTerrainPoint(pos.x, pos.y).height, 500.0f);
+  }
+
+  HeightMap height_map(filename);
+  TerrainPoint p = height_map.GetTerrainPoint(pos.x, pos.y);
+  EXPECT_FLOAT_EQ(p.height, 500.0f);
+  EXPECT_EQ(p.tile, 2);
+  EXPECT_GE(height_map.GetMaxTerrainHeight(vec2(pos)), 500.0f);
+  remove(filename.c_str());
+}
+
+TEST(HeightMap, StreamsTilesAroundThePosition) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  HeightMap height_map(filename);
+  EXPECT_EQ(height_map.GetNumResidentTiles(), 0);
+  height_map.StreamTiles(vec2(GetWorldCoords(300, 300)), 1);
+  EXPECT_EQ(height_map.GetNumResidentTiles(), 9);
+  height_map.StreamTiles(vec2(GetWorldCoords(10, 10)), 1);
+  EXPECT_EQ(height_map.GetNumResidentTiles(), 4);
+  height_map.StreamTiles(vec2(GetWorldCoords(-2000, 10)), 1);
+  EXPECT_EQ(height_map.GetNumResidentTiles(), 0);
+  remove(filename.c_str());
+}
+
+TEST(HeightMap, CachedHeightsMatchTheNoise) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  // Inside the map, in the blended ring and outside the map.
+  vector<vec2> positions;
+  for (int i = 0; i < 500; i++) {
+    positions.push_back(vec2(11500 + i * 2.37f, 7700 + i * 1.61f));
+  }
+
+  HeightMap height_map(filename);
+  height_map.EnableCache(false);
+  vector<float> expected;
+  vector<vec3> expected_normals;
+  for (const vec2& pos : positions) {
+    vec3 normal;
+    expected.push_back(height_map.GetTerrainHeight(pos, &normal));
+    expected_normals.push_back(normal);
+  }
+
+  height_map.EnableCache(true);
+  vector<float> heights;
+  vector<vec3> normals;
+  height_map.GetTerrainHeights(positions, heights, &normals);
+  ASSERT_EQ(heights.size(), positions.size());
+  for (int i = 0; i < positions.size(); i++) {
+    EXPECT_FLOAT_EQ(heights[i], expected[i]);
+    EXPECT_FLOAT_EQ(normals[i].x, expected_normals[i].x);
+
+    vec3 normal;
+    EXPECT_FLOAT_EQ(height_map.GetTerrainHeight(positions[i], &normal),
+      expected[i]);
+    EXPECT_FLOAT_EQ(normal.y, expected_normals[i].y);
+  }
+  EXPECT_GT(height_map.GetNumCacheTiles(), 0);
+  remove(filename.c_str());
+}
+
+TEST(HeightMap, EditsInvalidateTheCache) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  // On the border of two cache tiles.
+  HeightMap height_map(filename);
+  ivec2 pos = ivec2(11776, 7744);
+  height_map.GetTerrainHeight(pos.x - 1.5f, pos.y - 0.5f);
+  height_map.GetTerrainHeight(pos.x + 0.5f, pos.y + 0.5f);
+
+  TerrainPoint p = height_map.GetTerrainPoint(pos.x, pos.y);
+  p.height = 300.0f;
+  height_map.SetTerrainPoint(pos.x, pos.y, p);
+  EXPECT_FLOAT_EQ(height_map.GetTerrainHeight(pos.x, pos.y), 300.0f);
+  EXPECT_FLOAT_EQ(height_map.GetTerrainPoint(pos.x, pos.y).height, 300.0f);
+
+  // The normal of the previous point depends on this one.
+  vec3 normal;
+  height_map.GetTerrainHeight(vec2(pos.x - 0.9f, pos.y + 0.05f), &normal);
+  EXPECT_LT(normal.x, -0.5f);
+  remove(filename.c_str());
+}
+
+TEST(HeightMap, RepeatedEditsKeepTheCacheBounded) {
+  const string filename = "height_map_test.hmap";
+  vector<unsigned char> points = CreatePoints();
+  SaveTiledHeightMap(filename, points.data(), kSize);
+
+  // In the middle of a cache tile, so each edit invalidates only that one.
+  // More edits than the cache holds, like painting in the editor.
+  HeightMap height_map(filename);
+  ivec2 pos = ivec2(11776 + 32, 7744 + 32);
+  for (int i = 0; i < kMaxHeightCacheTiles + 10; i++) {
+    TerrainPoint p = height_map.GetTerrainPoint(pos.x, pos.y);
+    p.height = 100.0f + i % 2;
+    height_map.SetTerrainPoint(pos.x, pos.y, p);
+    EXPECT_FLOAT_EQ(height_map.GetTerrainHeight(pos.x, pos.y), 
+      100.0f + i % 2);
+  }
+  EXPECT_EQ(height_map.GetNumCacheTiles(), 1);
+  remove(filename.c_str());
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
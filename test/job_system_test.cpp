@@ -0,0 +1,59 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "job_system.hpp"
+
+using namespace std;
+
+namespace {
+
+TEST(JobSystem, ShouldWaitForNestedJobs) {
+  JobSystem job_system(4);
+  shared_ptr<JobCounter> counter = make_shared<JobCounter>();
+
+  // Binary tree of depth 8 where every job starts its own children.
+  atomic<int> num_jobs(0);
+  function<void(int)> spawn = [&] (int depth) {
+    num_jobs++;
+    if (depth == 8) return;
+    for (int i = 0; i < 2; i++) {
+      job_system.Run([&, depth] () { spawn(depth + 1); }, counter);
+    }
+  };
+
+  job_system.Run([&] () { spawn(0); }, counter);
+  job_system.Wait(counter);
+  EXPECT_EQ(511, num_jobs);
+  EXPECT_TRUE(counter->IsDone());
+}
+
+TEST(JobSystem, ShouldRunAfterDependency) {
+  JobSystem job_system(4);
+  shared_ptr<JobCounter> dependency = make_shared<JobCounter>();
+  shared_ptr<JobCounter> counter = make_shared<JobCounter>();
+
+  atomic<int> sum(0);
+  int sum_after = -1;
+  job_system.ParallelFor(0, 1000, 7, [&] (int i) { sum += i; }, dependency);
+  job_system.RunAfter(dependency, [&] () { sum_after = sum; }, counter);
+  job_system.Wait(counter);
+
+  EXPECT_EQ(499500, sum_after);
+}
+
+TEST(JobSystem, ShouldRunImmediatelyWhenDependencyIsDone) {
+  JobSystem job_system(1);
+  shared_ptr<JobCounter> dependency = make_shared<JobCounter>();
+  shared_ptr<JobCounter> counter = make_shared<JobCounter>();
+
+  bool ran = false;
+  job_system.RunAfter(dependency, [&] () { ran = true; }, counter);
+  job_system.Wait(counter);
+  EXPECT_TRUE(ran);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
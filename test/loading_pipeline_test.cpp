@@ -0,0 +1,165 @@
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "gtest/gtest.h"
+#include "loading_pipeline.hpp"
+
+using namespace std;
+
+namespace {
+
+TEST(LoadingPipeline, ShouldRunTasksAfterTheirDependencies) {
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>(4);
+  LoadingPipeline pipeline(job_system);
+
+  // Ten meshes decoded in parallel, each uploaded after its decode and one
+  // asset created after all the uploads.
+  vector<int> decoded(10, 0);
+  vector<int> uploaded(10, 0);
+  vector<int> uploads;
+  bool created = false;
+  for (int i = 0; i < 10; i++) {
+    int decode = pipeline.AddTask(LOADING_DECODE, [&, i] () {
+      decoded[i] = 1;
+    });
+    uploads.push_back(pipeline.AddTask(LOADING_UPLOAD, [&, i] () {
+      EXPECT_EQ(1, decoded[i]);
+      uploaded[i] = 1;
+    }, { decode }));
+  }
+  pipeline.AddTask(LOADING_CREATE, [&] () {
+    for (int i = 0; i < 10; i++) EXPECT_EQ(1, uploaded[i]);
+    created = true;
+  }, uploads);
+
+  pipeline.Finish();
+  EXPECT_TRUE(created);
+  EXPECT_TRUE(pipeline.IsDone());
+
+  LoadingProgress progress = pipeline.GetProgress();
+  EXPECT_EQ(21, progress.GetNumTasks());
+  EXPECT_EQ(21, progress.GetNumDone());
+  EXPECT_EQ(10, progress.num_done[LOADING_DECODE]);
+  EXPECT_FLOAT_EQ(1.0f, progress.GetFraction());
+}
+
+TEST(LoadingPipeline, ShouldRunUploadsOnTheMainThread) {
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>(4);
+  LoadingPipeline pipeline(job_system);
+
+  const thread::id main_thread = this_thread::get_id();
+  atomic<int> num_wrong_thread(0);
+  for (int i = 0; i < 20; i++) {
+    int decode = pipeline.AddTask(LOADING_DECODE, [] () {});
+    pipeline.AddTask(LOADING_UPLOAD, [&] () {
+      if (this_thread::get_id() != main_thread) num_wrong_thread++;
+    }, { decode });
+  }
+  pipeline.Finish();
+  EXPECT_EQ(0, num_wrong_thread);
+}
+
+TEST(LoadingPipeline, ShouldStopAtTheTimeBudget) {
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>(1);
+  LoadingPipeline pipeline(job_system);
+
+  int num_uploads = 0;
+  for (int i = 0; i < 5; i++) {
+    pipeline.AddTask(LOADING_UPLOAD, [&] () { num_uploads++; });
+  }
+
+  // A budget of zero runs one ready task per call.
+  EXPECT_FALSE(pipeline.RunMainThreadTasks(0.0));
+  EXPECT_EQ(1, num_uploads);
+  EXPECT_FALSE(pipeline.RunMainThreadTasks(0.0));
+  EXPECT_EQ(2, num_uploads);
+
+  pipeline.Finish();
+  EXPECT_EQ(5, num_uploads);
+}
+
+TEST(LoadingPipeline, ShouldAddTasksFromInsideTasks) {
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>(2);
+  LoadingPipeline pipeline(job_system);
+
+  atomic<int> num_decoded(0);
+  bool created = false;
+  int parse = pipeline.AddTask(LOADING_PARSE, [&] () {
+    vector<int> decodes;
+    for (int i = 0; i < 8; i++) {
+      decodes.push_back(pipeline.AddTask(LOADING_DECODE, [&] () {
+        num_decoded++;
+      }));
+    }
+    pipeline.AddTask(LOADING_CREATE, [&] () {
+      created = num_decoded == 8;
+    }, decodes);
+  });
+
+  // Depending on a task that may already be done.
+  bool after_parse = false;
+  pipeline.AddTask(LOADING_CREATE, [&] () { after_parse = true; }, { parse });
+
+  pipeline.Finish();
+  EXPECT_TRUE(created);
+  EXPECT_TRUE(after_parse);
+}
+
+TEST(LoadingPipeline, ShouldRethrowErrorsOnTheMainThread) {
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>(2);
+  LoadingPipeline pipeline(job_system);
+
+  bool uploaded = false;
+  int decode = pipeline.AddTask(LOADING_DECODE, [] () {
+    throw runtime_error("Couldn't open png file");
+  });
+  pipeline.AddTask(LOADING_UPLOAD, [&] () { uploaded = true; }, { decode });
+
+  EXPECT_THROW(pipeline.Finish(), runtime_error);
+  EXPECT_FALSE(uploaded);
+}
+
+TEST(LoadingPipeline, ShouldCreateAssetsAfterUploadsOfOtherFiles) {
+  shared_ptr<JobSystem> job_system = make_shared<JobSystem>(4);
+  LoadingPipeline pipeline(job_system);
+
+  // Like LoadResources: the asset of the first file uses a mesh listed in
+  // the second file, whose decode is slow.
+  vector<int> uploaded(2, 0);
+  vector<int> uploads;
+  for (int i = 0; i < 2; i++) {
+    int decode = pipeline.AddTask(LOADING_DECODE, [i] () {
+      if (i == 1) this_thread::sleep_for(chrono::milliseconds(50));
+    });
+    uploads.push_back(pipeline.AddTask(LOADING_UPLOAD, [&, i] () {
+      uploaded[i] = 1;
+    }, { decode }));
+  }
+
+  vector<int> created;
+  int previous_asset_file = pipeline.AddBarrier(uploads);
+  for (int i = 0; i < 2; i++) {
+    previous_asset_file = pipeline.AddTask(LOADING_CREATE, [&, i] () {
+      EXPECT_EQ(1, uploaded[1 - i]);
+      created.push_back(i);
+    }, { previous_asset_file });
+  }
+
+  pipeline.Finish();
+  EXPECT_EQ(vector<int>({ 0, 1 }), created);
+
+  // A barrier on tasks that are already done is done right away.
+  bool after_barrier = false;
+  int barrier = pipeline.AddBarrier(uploads);
+  pipeline.AddTask(LOADING_CREATE, [&] () { after_barrier = true; },
+    { barrier });
+  pipeline.Finish();
+  EXPECT_TRUE(after_barrier);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
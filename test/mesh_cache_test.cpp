@@ -0,0 +1,178 @@
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "mesh_cache.hpp"
+
+using namespace std;
+
+namespace {
+
+// Two triangles of a quad, one entry per corner like BuildMeshData before
+// welding. The diagonal corners are shared.
+MeshData CreateQuad() {
+  MeshData data;
+  vec3 a = vec3(0, 0, 0), b = vec3(1, 0, 0), c = vec3(1, 0, 1);
+  vec3 d = vec3(0, 0, 1);
+  data.vertices = { a, b, c, a, c, d };
+  for (const vec3& v : data.vertices) {
+    data.uvs.push_back(vec2(v.x, v.z));
+    data.normals.push_back(vec3(0, 1, 0));
+    data.tangents.push_back(vec3(1, 0, 0));
+    data.bitangents.push_back(vec3(0, 0, 1));
+  }
+
+  Polygon polygon;
+  polygon.vertices = { a, b, c };
+  polygon.normal = vec3(0, 1, 0);
+  data.polygons.push_back(polygon);
+  polygon.vertices = { a, c, d };
+  data.polygons.push_back(polygon);
+  data.bounding_sphere = BoundingSphere(vec3(0.5f, 0, 0.5f), 0.75f);
+  return data;
+}
+
+void AddSkeleton(MeshData& data) {
+  for (size_t i = 0; i < data.vertices.size(); i++) {
+    data.bone_ids.push_back(ivec3(0, 2, -1));
+    data.bone_weights.push_back(vec3(0.5f, 0.5f, 0));
+  }
+  data.bone_names = { "root", "", "hand" };
+  data.global_bindpose_inverse = { mat4(1.0), mat4(1.0), mat4(2.0) };
+
+  Animation animation;
+  animation.name = "walk";
+  for (int i = 0; i < 2; i++) {
+    Keyframe keyframe;
+    keyframe.time = i;
+    keyframe.bounding_sphere = BoundingSphere(vec3(i), 1.0f);
+    keyframe.transforms = { mat4(1.0), mat4(1.0), mat4(float(i + 1)) };
+    animation.keyframes.push_back(keyframe);
+  }
+  data.animations.push_back(animation);
+}
+
+TEST(MeshCache, WeldVerticesMergesEqualCorners) {
+  MeshData data = CreateQuad();
+  vector<vec3> corners = data.vertices;
+  WeldVertices(data);
+
+  EXPECT_EQ(data.vertices.size(), 4);
+  EXPECT_EQ(data.uvs.size(), 4);
+  EXPECT_EQ(data.tangents.size(), 4);
+  ASSERT_EQ(data.indices.size(), 6);
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(data.vertices[data.indices[i]], corners[i]);
+  }
+
+  // Corners with the same position and a different normal stay apart.
+  data = CreateQuad();
+  data.normals[3] = vec3(0, -1, 0);
+  WeldVertices(data);
+  EXPECT_EQ(data.vertices.size(), 5);
+}
+
+TEST(MeshCache, SaveAndLoad) {
+  MeshData data = CreateQuad();
+  AddSkeleton(data);
+  WeldVertices(data);
+
+  MeshSource source;
+  source.size = 123;
+  stringstream ss;
+  SaveMeshData(ss, data, source);
+  const string bytes = ss.str();
+
+  MeshData loaded;
+  LoadMeshData(bytes.data(), bytes.size(), loaded);
+  EXPECT_EQ(loaded.vertices, data.vertices);
+  EXPECT_EQ(loaded.indices, data.indices);
+  EXPECT_EQ(loaded.bone_ids.size(), data.bone_ids.size());
+  EXPECT_EQ(loaded.bone_names, data.bone_names);
+  ASSERT_EQ(loaded.polygons.size(), 2);
+  EXPECT_EQ(loaded.polygons[1].vertices, data.polygons[1].vertices);
+  EXPECT_EQ(loaded.bounding_sphere.radius, 0.75f);
+
+  ASSERT_EQ(loaded.animations.size(), 1);
+  EXPECT_EQ(loaded.animations[0].name, "walk");
+  ASSERT_EQ(loaded.animations[0].keyframes.size(), 2);
+  EXPECT_EQ(loaded.animations[0].keyframes[1].time, 1);
+  EXPECT_EQ(loaded.animations[0].keyframes[1].transforms[2][0][0], 2.0f);
+  EXPECT_EQ(loaded.global_bindpose_inverse[2][1][1], 2.0f);
+}
+
+TEST(MeshCache, RejectsInvalidData) {
+  MeshData data = CreateQuad();
+  WeldVertices(data);
+  stringstream ss;
+  SaveMeshData(ss, data, MeshSource());
+  string bytes = ss.str();
+
+  MeshData loaded;
+  EXPECT_THROW(LoadMeshData(bytes.data(), 10, loaded), runtime_error);
+  EXPECT_THROW(LoadMeshData(bytes.data(), bytes.size() - 8, loaded),
+    runtime_error);
+  bytes[4] = 99; // Version.
+  EXPECT_THROW(LoadMeshData(bytes.data(), bytes.size(), loaded),
+    runtime_error);
+}
+
+TEST(MeshCache, CacheIsUsedOnlyWhileUpToDate) {
+  const string fbx_filename = "mesh_cache_test.fbx";
+  ofstream(fbx_filename) << "fbx";
+  EXPECT_EQ(GetMeshCachePath(fbx_filename), "mesh_cache_test.mesh");
+
+  MeshData data = CreateQuad();
+  WeldVertices(data);
+  MeshData loaded;
+  EXPECT_FALSE(LoadMeshCache(fbx_filename, loaded));
+  SaveMeshCache(fbx_filename, data);
+  EXPECT_TRUE(LoadMeshCache(fbx_filename, loaded));
+  EXPECT_EQ(loaded.indices, data.indices);
+
+  // A different source size means the FBX changed.
+  ofstream(fbx_filename) << "changed fbx";
+  EXPECT_FALSE(LoadMeshCache(fbx_filename, loaded));
+
+  // Without the FBX the cache is all there is.
+  remove(fbx_filename.c_str());
+  EXPECT_TRUE(LoadMeshCache(fbx_filename, loaded));
+  remove(GetMeshCachePath(fbx_filename).c_str());
+}
+
+TEST(MeshCache, CorruptCacheIsNotUsed) {
+  const string fbx_filename = "mesh_cache_corrupt_test.fbx";
+  const string cache_filename = GetMeshCachePath(fbx_filename);
+  ofstream(fbx_filename) << "fbx";
+
+  MeshData data = CreateQuad();
+  WeldVertices(data);
+  SaveMeshCache(fbx_filename, data);
+  ifstream tmp_file(cache_filename + ".tmp");
+  EXPECT_FALSE(tmp_file.good());
+
+  // Truncated after the header, like a save that crashed.
+  ifstream is(cache_filename, ios::binary);
+  string bytes((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+  is.close();
+  ofstream(cache_filename, ios::binary).write(bytes.data(), 
+    bytes.size() / 2);
+
+  MeshData loaded;
+  EXPECT_FALSE(LoadMeshCache(fbx_filename, loaded));
+  EXPECT_TRUE(loaded.vertices.empty());
+
+  // Saving again replaces it.
+  SaveMeshCache(fbx_filename, data);
+  EXPECT_TRUE(LoadMeshCache(fbx_filename, loaded));
+  EXPECT_EQ(loaded.indices, data.indices);
+  remove(fbx_filename.c_str());
+  remove(cache_filename.c_str());
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include "gtest/gtest.h"
+#include "occlusion_buffer.hpp"
+
+namespace {
+
+// Camera at the origin looking down -z.
+mat4 GetViewProjection() {
+  mat4 projection = glm::perspective(glm::radians(45.0f), 2.0f, 1.0f,
+    1000.0f);
+  mat4 view = glm::lookAt(vec3(0, 0, 0), vec3(0, 0, -1), vec3(0, 1, 0));
+  return projection * view;
+}
+
+// Wall 20 units in front of the camera.
+void AddWall(OcclusionBuffer& buffer) {
+  buffer.AddOccluderBox(vec3(-5, -10, -21), vec3(5, 10, -20), mat4(1.0));
+  buffer.BuildHiZ();
+}
+
+TEST(OcclusionBuffer, EmptyBufferHidesNothing) {
+  OcclusionBuffer buffer;
+  buffer.Clear(GetViewProjection());
+  buffer.BuildHiZ();
+  EXPECT_TRUE(buffer.IsVisible(vec3(-1, -1, -50), vec3(1, 1, -48)));
+  EXPECT_EQ(buffer.GetDepth(0, 0), 1.0f);
+}
+
+TEST(OcclusionBuffer, WallHidesBoxesBehindIt) {
+  OcclusionBuffer buffer;
+  buffer.Clear(GetViewProjection());
+  AddWall(buffer);
+
+  // Center of the screen is covered by the wall.
+  float depth = buffer.GetDepth(buffer.GetWidth() / 2,
+    buffer.GetHeight() / 2);
+  EXPECT_LT(depth, 1.0f);
+
+  EXPECT_FALSE(buffer.IsVisible(vec3(-1, -1, -50), vec3(1, 1, -48)));
+  EXPECT_FALSE(buffer.IsVisible(vec3(-10, -5, -300), vec3(10, 5, -100)));
+  EXPECT_EQ(buffer.GetMetrics().num_tested, 2);
+  EXPECT_EQ(buffer.GetMetrics().num_occluded, 2);
+}
+
+TEST(OcclusionBuffer, BoxesInFrontOrBesideTheWallAreVisible) {
+  OcclusionBuffer buffer;
+  buffer.Clear(GetViewProjection());
+  AddWall(buffer);
+
+  // In front of the wall.
+  EXPECT_TRUE(buffer.IsVisible(vec3(-1, -1, -12), vec3(1, 1, -10)));
+
+  // Behind the wall but sticking out of its right side.
+  EXPECT_TRUE(buffer.IsVisible(vec3(15, -1, -42), vec3(30, 1, -40)));
+
+  // Crossing the near plane.
+  EXPECT_TRUE(buffer.IsVisible(vec3(-1, -1, -50), vec3(1, 1, 5)));
+}
+
+TEST(OcclusionBuffer, ClipsOccludersAgainstTheNearPlane) {
+  OcclusionBuffer buffer;
+  buffer.Clear(GetViewProjection());
+
+  // Floor that starts behind the camera and goes far away.
+  buffer.AddOccluderBox(vec3(-50, -3, -500), vec3(50, -2, 10), mat4(1.0));
+  buffer.BuildHiZ();
+  EXPECT_GT(buffer.GetMetrics().num_triangles, 0);
+
+  // The bottom rows are covered, the top ones are not.
+  EXPECT_LT(buffer.GetDepth(buffer.GetWidth() / 2, 0), 1.0f);
+  EXPECT_EQ(buffer.GetDepth(buffer.GetWidth() / 2,
+    buffer.GetHeight() - 1), 1.0f);
+
+  // Under the floor.
+  EXPECT_FALSE(buffer.IsVisible(vec3(-1, -10, -60), vec3(1, -8, -58)));
+  // Over the floor.
+  EXPECT_TRUE(buffer.IsVisible(vec3(-1, 0, -60), vec3(1, 2, -58)));
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,122 @@
+#include <thread>
+#include "gtest/gtest.h"
+#include "particle_system.hpp"
+
+using namespace std;
+
+namespace {
+
+TEST(ParticleSystem, UpdateMatchesScalarIntegration) {
+  ParticleSystem particle_system;
+  int fall = particle_system.AddType("fall", 0, 4, 1, 4, true);
+  int fixed = particle_system.AddType("fixed", 0, 4, 1, 4, false);
+
+  // Enough particles to cover full and partial SIMD steps.
+  for (int i = 0; i < 21; i++) {
+    ASSERT_TRUE(particle_system.Emit((i % 2) ? fall : fixed, vec3(i, 0, 0),
+      vec3(1, 2, 3), vec4(1), 1.0f, 100.0f));
+  }
+
+  vector<vec3> positions(21), speeds(21);
+  for (int i = 0; i < 21; i++) {
+    positions[i] = vec3(i, 0, 0);
+    speeds[i] = (i % 2) ? vec3(1, 2, 3) : vec3(0);
+  }
+
+  for (int step = 0; step < 10; step++) {
+    particle_system.Update();
+    for (int i = 0; i < 21; i++) {
+      if (i % 2) speeds[i].y -= 9.81f * 0.01f;
+      positions[i] = positions[i] + speeds[i] * 0.01f;
+    }
+  }
+
+  ASSERT_EQ(particle_system.GetNumParticles(), 21);
+  for (int i = 0; i < 21; i++) {
+    EXPECT_NEAR(length(particle_system.GetPosition(i) - positions[i]), 0.0f,
+      1e-4f);
+    EXPECT_EQ(particle_system.GetLife(i), 90.0f);
+  }
+}
+
+TEST(ParticleSystem, DeadParticlesAreRemoved) {
+  ParticleSystem particle_system(16);
+  int type = particle_system.AddType("spark", 0, 3, 1, 4, false);
+  for (int i = 0; i < 16; i++) {
+    particle_system.Emit(type, vec3(i), vec3(0), vec4(1), 1.0f, i % 4);
+  }
+
+  // Full.
+  EXPECT_FALSE(particle_system.Emit(type, vec3(0), vec3(0), vec4(1), 1.0f,
+    10.0f));
+  EXPECT_EQ(particle_system.GetMetrics().num_dropped, 1);
+
+  // A particle with life l is removed by update l + 1.
+  particle_system.Update();
+  EXPECT_EQ(particle_system.GetNumParticles(), 12);
+  particle_system.Update();
+  particle_system.Update();
+  EXPECT_EQ(particle_system.GetNumParticles(), 4);
+  for (int i = 0; i < particle_system.GetNumParticles(); i++) {
+    EXPECT_EQ(particle_system.GetLife(i), 0.0f);
+    EXPECT_EQ(int(particle_system.GetPosition(i).x) % 4, 3);
+    EXPECT_LT(particle_system.GetFrame(i), 3);
+  }
+
+  particle_system.Update();
+  EXPECT_EQ(particle_system.GetNumParticles(), 0);
+  EXPECT_TRUE(particle_system.Emit(type, vec3(0), vec3(0), vec4(1), 1.0f,
+    10.0f));
+}
+
+TEST(ParticleSystem, InstancesAreSortedFarToNear) {
+  ParticleSystem particle_system;
+  int type = particle_system.AddType("spark", 0, 1, 1, 1, false);
+  for (int i = 0; i < 1000; i++) {
+    float x = (i * 7919) % 1000 - 500.0f;
+    particle_system.Emit(type, vec3(x, 0, 0), vec3(0), vec4(1), 1.0f, 10.0f);
+  }
+
+  vector<vector<ParticleInstance>> instances;
+  particle_system.GetInstances(vec3(100, 0, 0), instances);
+  ASSERT_EQ(instances.size(), 1);
+  ASSERT_EQ(instances[0].size(), 1000);
+
+  SortParticleInstances(instances[0]);
+  for (int i = 1; i < instances[0].size(); i++) {
+    EXPECT_GE(instances[0][i - 1].camera_distance,
+      instances[0][i].camera_distance);
+  }
+}
+
+TEST(ParticleSystem, TypesCanBeAddedWhileQueried) {
+  ParticleSystem particle_system;
+  particle_system.AddType("type-0", 0, 1, 1, 1, false);
+
+  // Like the AI job adding effect types while the renderer reads names.
+  thread adder([&particle_system] () {
+    for (int i = 1; i < 200; i++) {
+      string name = "type-" + to_string(i);
+      if (particle_system.GetTypeIndex(name) == -1) {
+        particle_system.AddType(name, 0, 1, 1, 1, false);
+      }
+    }
+  });
+  for (int i = 0; i < 200; i++) {
+    int num_types = particle_system.GetNumTypes();
+    EXPECT_EQ(particle_system.GetTypeName(num_types - 1),
+      "type-" + to_string(num_types - 1));
+  }
+  adder.join();
+
+  EXPECT_EQ(particle_system.GetNumTypes(), 200);
+  EXPECT_EQ(particle_system.AddType("type-7", 0, 1, 1, 1, false), 7);
+  EXPECT_EQ(particle_system.GetNumTypes(), 200);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
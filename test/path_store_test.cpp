@@ -0,0 +1,107 @@
+#include <iostream>
+#include "gtest/gtest.h"
+#include "path_store.hpp"
+
+using namespace std;
+
+namespace {
+
+const int kSize = 8;
+
+class PathStoreTest : public ::testing::Test {
+ protected:
+  int num_calculated_ = 0;
+
+  shared_ptr<FlowField> Calculate(const ivec2& dest) {
+    num_calculated_++;
+    shared_ptr<FlowField> flow_field = make_shared<FlowField>(dest, kSize);
+    flow_field->distances[dest.x * kSize + dest.y] = 0.0f;
+    flow_field->codes[dest.x * kSize + dest.y] = 4;
+    return flow_field;
+  }
+
+  size_t FieldSize() {
+    return FlowField(ivec2(0, 0), kSize).GetMemoryUsage();
+  }
+};
+
+TEST_F(PathStoreTest, ShouldCalculateOnlyOnMiss) {
+  PathStore store(kSize, 10 * FieldSize(),
+    [this] (const ivec2& dest) { return Calculate(dest); });
+
+  shared_ptr<const FlowField> field = store.Get(ivec2(2, 3));
+  EXPECT_EQ(4, field->GetCode(ivec2(2, 3)));
+  EXPECT_FLOAT_EQ(0.0f, field->GetDistance(ivec2(2, 3)));
+  EXPECT_EQ(kNoPathCode, field->GetCode(ivec2(0, 0)));
+
+  store.Get(ivec2(2, 3));
+  EXPECT_EQ(1, num_calculated_);
+
+  PathStoreMetrics metrics = store.GetMetrics();
+  EXPECT_EQ(1, metrics.hits);
+  EXPECT_EQ(1, metrics.misses);
+  EXPECT_EQ(1, metrics.num_fields);
+}
+
+TEST_F(PathStoreTest, ShouldEvictLeastRecentlyUsed) {
+  PathStore store(kSize, 2 * FieldSize(),
+    [this] (const ivec2& dest) { return Calculate(dest); });
+
+  store.Get(ivec2(0, 0));
+  store.Get(ivec2(1, 1));
+  store.Get(ivec2(0, 0));
+  store.Get(ivec2(2, 2));
+  EXPECT_EQ(3, num_calculated_);
+
+  // (1, 1) was the least recently used.
+  store.Get(ivec2(0, 0));
+  EXPECT_EQ(3, num_calculated_);
+  store.Get(ivec2(1, 1));
+  EXPECT_EQ(4, num_calculated_);
+
+  PathStoreMetrics metrics = store.GetMetrics();
+  EXPECT_EQ(2, metrics.num_fields);
+  EXPECT_LE(metrics.memory_usage, 2 * FieldSize());
+}
+
+TEST_F(PathStoreTest, ShouldInvalidateNearbyDestinations) {
+  PathStore store(kSize, 10 * FieldSize(),
+    [this] (const ivec2& dest) { return Calculate(dest); });
+
+  store.Get(ivec2(0, 0));
+  store.Get(ivec2(7, 7));
+  store.Invalidate(ivec2(1, 1), 2);
+  EXPECT_EQ(1, store.GetMetrics().num_fields);
+
+  store.Get(ivec2(7, 7));
+  EXPECT_EQ(2, num_calculated_);
+  store.Get(ivec2(0, 0));
+  EXPECT_EQ(3, num_calculated_);
+}
+
+TEST_F(PathStoreTest, ShouldNotCacheFieldsInvalidatedWhileCalculating) {
+  PathStore* store_ptr = nullptr;
+  PathStore store(kSize, 10 * FieldSize(), [&] (const ivec2& dest) {
+    // Another thread edits the dungeon in the meantime.
+    if (num_calculated_ == 0) store_ptr->Invalidate(dest, 0);
+    return Calculate(dest);
+  });
+  store_ptr = &store;
+
+  shared_ptr<const FlowField> field = store.Get(ivec2(3, 3));
+  EXPECT_EQ(4, field->GetCode(ivec2(3, 3)));
+  EXPECT_EQ(0, store.GetMetrics().num_fields);
+
+  store.Get(ivec2(3, 3));
+  EXPECT_EQ(2, num_calculated_);
+  store.Get(ivec2(3, 3));
+  EXPECT_EQ(2, num_calculated_);
+  EXPECT_EQ(1, store.GetMetrics().num_fields);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <chrono>
+#include "util.hpp"
+#include "dungeon.hpp"
+
+using namespace std;
+using namespace std::chrono;
+
+// Compares flow field queries against the hierarchical planner on random
+// pairs of clear tiles. Usage: pathfinding_benchmark [num_levels] [num_pairs]
+namespace {
+
+double Now() {
+  return duration<double, micro>(
+    steady_clock::now().time_since_epoch()).count();
+}
+
+ivec2 GetRandomClearTile(Dungeon& dungeon) {
+  while (true) {
+    ivec2 tile(Random(0, kDungeonSize), Random(0, kDungeonSize));
+    if (dungeon.IsTileClear(tile)) return tile;
+  }
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  int num_levels = (argc > 1) ? atoi(argv[1]) : 5;
+  int num_pairs = (argc > 2) ? atoi(argv[2]) : 200;
+
+  Dungeon dungeon;
+  dungeon.LoadLevelDataFromXml("resources/assets/dungeon.xml");
+
+  double cold_time = 0, warm_time = 0, build_time = 0;
+  double next_tile_time = 0, path_time = 0;
+  int num_queries = 0, flow_field_paths = 0, hpa_paths = 0;
+  size_t path_store_memory = 0, hpa_memory = 0;
+  for (int level = 0; level < num_levels; level++) {
+    SeedRandom(level + 1);
+    dungeon.GenerateDungeon(0, level + 1);
+
+    HpaMetrics hpa_metrics = dungeon.GetPlanner().GetMetrics();
+    build_time += hpa_metrics.build_time * 1000000.0;
+    hpa_memory = std::max(hpa_memory, hpa_metrics.memory_usage);
+
+    PathStore& path_store = dungeon.GetPathStore();
+    HpaPlanner& planner = dungeon.GetPlanner();
+    for (int i = 0; i < num_pairs; i++) {
+      ivec2 source = GetRandomClearTile(dungeon);
+      ivec2 dest = GetRandomClearTile(dungeon);
+
+      double start = Now();
+      shared_ptr<const FlowField> field = path_store.Get(dest);
+      cold_time += Now() - start;
+
+      start = Now();
+      field = path_store.Get(dest);
+      warm_time += Now() - start;
+      if (field->GetCode(source) != kNoPathCode) flow_field_paths++;
+
+      start = Now();
+      planner.GetNextTile(source, dest);
+      next_tile_time += Now() - start;
+
+      start = Now();
+      vector<ivec2> path = planner.GetPath(source, dest);
+      path_time += Now() - start;
+      if (!path.empty()) hpa_paths++;
+
+      num_queries++;
+    }
+
+    path_store_memory = std::max(path_store_memory,
+      path_store.GetMetrics().memory_usage);
+    dungeon.ClearPaths();
+  }
+
+  // The old tables held a move code and a distance for every pair of tiles.
+  size_t table_memory = size_t(kDungeonSize) * kDungeonSize * kDungeonSize *
+    kDungeonSize * (sizeof(int) + sizeof(float));
+
+  cout << "Queries: " << num_queries << " over " << num_levels << " levels"
+       << endl;
+  cout << "Paths found - flow field: " << flow_field_paths << ", hpa: "
+       << hpa_paths << endl;
+  cout << "Flow field cold: " << cold_time / num_queries << " us" << endl;
+  cout << "Flow field warm: " << warm_time / num_queries << " us" << endl;
+  cout << "HPA build: " << build_time / num_levels << " us" << endl;
+  cout << "HPA next tile: " << next_tile_time / num_queries << " us" << endl;
+  cout << "HPA full path: " << path_time / num_queries << " us" << endl;
+  cout << "Memory - tables: " << table_memory / 1024 << " KB, path store: "
+       << path_store_memory / 1024 << " KB, hpa: " << hpa_memory / 1024
+       << " KB" << endl;
+  return 0;
+}
@@ -0,0 +1,114 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include "gtest/gtest.h"
+#include "portal_visibility.hpp"
+
+namespace {
+
+// Camera at the origin looking down -z.
+mat4 GetMVP() {
+  mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 1.0f,
+    1000.0f);
+  mat4 view = glm::lookAt(vec3(0, 0, 0), vec3(0, 0, -1), vec3(0, 1, 0));
+  return projection * view;
+}
+
+// Square portal facing the camera.
+shared_ptr<PortalNode> MakeNode(int sector_id, vec3 center, float size,
+  int num_objects) {
+  shared_ptr<PortalNode> node = make_shared<PortalNode>();
+  node->sector_id = sector_id;
+  node->num_objects = num_objects;
+  vec3 a = center + vec3(-size, -size, 0), b = center + vec3(size, -size, 0);
+  vec3 c = center + vec3(size, size, 0), d = center + vec3(-size, size, 0);
+  node->portal_triangles = { a, b, c, a, c, d };
+  return node;
+}
+
+bool IsInside(const vec3& p, const vec4 planes[6]) {
+  for (int i = 0; i < 6; i++) {
+    if (dot(p, vec3(planes[i].x, planes[i].y, planes[i].z)) + planes[i].w <
+      0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Sector 0 has a door to sector 1 ahead and a door to sector 4 behind the
+// camera. Sector 1 has a door to sector 3 seen through the first door and
+// a door to sector 2 far to the right, out of view.
+shared_ptr<PortalNode> MakeSectorGraph() {
+  shared_ptr<PortalNode> root = make_shared<PortalNode>();
+  root->sector_id = 0;
+  shared_ptr<PortalNode> sector1 = MakeNode(1, vec3(0, 0, -10), 1.0f, 10);
+  shared_ptr<PortalNode> sector2 = MakeNode(2, vec3(30, 0, -20), 1.0f, 5);
+  shared_ptr<PortalNode> sector3 = MakeNode(3, vec3(0.6f, 0, -20), 0.4f, 7);
+  shared_ptr<PortalNode> sector4 = MakeNode(4, vec3(0, 0, 10), 1.0f, 3);
+  sector1->children = { sector2, sector3 };
+  root->children = { sector1, sector4 };
+  return root;
+}
+
+TEST(PortalVisibility, VisitsSectorsSeenThroughPortals) {
+  PortalVisibility portal_visibility;
+  const vector<SectorView>& views = portal_visibility.Compute(
+    MakeSectorGraph(), GetMVP(), vec3(0));
+
+  ASSERT_EQ(views.size(), 3);
+  EXPECT_EQ(views[0].node->sector_id, 0);
+  EXPECT_EQ(views[1].node->sector_id, 1);
+  EXPECT_EQ(views[2].node->sector_id, 3);
+
+  const PortalMetrics& metrics = portal_visibility.GetMetrics();
+  EXPECT_EQ(metrics.num_portals_tested, 4);
+  EXPECT_EQ(metrics.num_portals_rejected, 2);
+  EXPECT_EQ(metrics.num_objects_rejected, 8);
+}
+
+TEST(PortalVisibility, NarrowsTheFrustumThroughEachPortal) {
+  PortalVisibility portal_visibility;
+  const vector<SectorView>& views = portal_visibility.Compute(
+    MakeSectorGraph(), GetMVP(), vec3(0));
+  ASSERT_EQ(views.size(), 3);
+
+  // The camera sector sees the whole screen.
+  EXPECT_EQ(views[0].rect.min.x, -1.0f);
+  EXPECT_EQ(views[0].rect.max.y, 1.0f);
+
+  // Sector 3 is seen through the overlap of both doors.
+  const ScreenRect& rect1 = views[1].rect;
+  const ScreenRect& rect3 = views[2].rect;
+  EXPECT_GT(rect3.min.x, rect1.min.x);
+  EXPECT_LE(rect3.max.x, rect1.max.x);
+  EXPECT_GT(rect3.min.x, 0.0f);
+
+  vec3 through_doors = vec3(1.0f, 0.0f, -50.0f);
+  vec3 beside_doors = vec3(-10.0f, 0.0f, -50.0f);
+  EXPECT_TRUE(IsInside(through_doors, views[0].frustum_planes));
+  EXPECT_TRUE(IsInside(beside_doors, views[0].frustum_planes));
+  EXPECT_TRUE(IsInside(through_doors, views[2].frustum_planes));
+  EXPECT_FALSE(IsInside(beside_doors, views[1].frustum_planes));
+  EXPECT_FALSE(IsInside(beside_doors, views[2].frustum_planes));
+  EXPECT_FALSE(IsInside(vec3(0, 0, 50), views[0].frustum_planes));
+}
+
+TEST(PortalVisibility, PortalsNextToTheCameraDoNotNarrowTheView) {
+  // Door crossing the near plane, as when walking through it.
+  shared_ptr<PortalNode> root = make_shared<PortalNode>();
+  root->sector_id = 0;
+  root->children = { MakeNode(1, vec3(0, 0, -0.5f), 2.0f, 1) };
+
+  PortalVisibility portal_visibility;
+  const vector<SectorView>& views = portal_visibility.Compute(root, GetMVP(),
+    vec3(0));
+  ASSERT_EQ(views.size(), 2);
+  EXPECT_EQ(views[1].rect.min.x, -1.0f);
+  EXPECT_EQ(views[1].rect.max.x, 1.0f);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+#include <random>
+#include "gtest/gtest.h"
+#include "ray_packet.hpp"
+
+using namespace std;
+
+namespace {
+
+vector<Polygon> CreateRandomTriangles(int num_triangles, mt19937& rng) {
+  uniform_real_distribution<float> position(-50.0f, 50.0f);
+  uniform_real_distribution<float> offset(-3.0f, 3.0f);
+
+  vector<Polygon> polygons;
+  for (int i = 0; i < num_triangles; i++) {
+    vec3 a = vec3(position(rng), position(rng), position(rng));
+    Polygon polygon;
+    polygon.vertices = { a, a + vec3(offset(rng), offset(rng), offset(rng)),
+      a + vec3(offset(rng), offset(rng), offset(rng)) };
+    polygon.normal = vec3(0, 1, 0);
+    polygons.push_back(polygon);
+  }
+  return polygons;
+}
+
+TEST(RayPacket, BvhPacketMatchesSingleRays) {
+  mt19937 rng(5);
+  Bvh bvh(CreateRandomTriangles(3000, rng));
+
+  uniform_real_distribution<float> position(-60.0f, 60.0f);
+  uniform_real_distribution<float> distance(20.0f, 200.0f);
+  const vec3 base_position = vec3(3, -2, 8);
+
+  // The last packet is not full.
+  vector<Ray> rays;
+  for (int i = 0; i < 1001; i++) {
+    vec3 origin = vec3(position(rng), position(rng), position(rng));
+    vec3 target = vec3(position(rng), position(rng), position(rng)) * 0.5f;
+    rays.push_back(Ray(origin, normalize(target - origin), distance(rng)));
+  }
+
+  int num_hits = 0;
+  RayPacket packet;
+  for (int i = 0; i < rays.size(); i += kRayPacketSize) {
+    packet.Load(&rays[i], rays.size() - i);
+    packet.Translate(base_position);
+    bvh.IntersectRays(packet);
+
+    for (int j = 0; j < packet.num_rays; j++) {
+      const Ray& ray = rays[i + j];
+      float t;
+      vec3 q;
+      bool hit = bvh.IntersectRay(ray.origin, ray.direction, t, q,
+        base_position) && t <= ray.distance;
+      ASSERT_EQ(packet.triangle[j] != -1, hit);
+      if (!hit) continue;
+
+      num_hits++;
+      EXPECT_NEAR(packet.t[j], t, 1e-3f);
+      EXPECT_NEAR(length(packet.GetHitPoint(j) + base_position - q), 0.0f,
+        1e-3f);
+    }
+  }
+  EXPECT_GT(num_hits, 0);
+}
+
+TEST(RayPacket, AABBMask) {
+  vector<Ray> rays = {
+    Ray(vec3(-10, 0, 0), vec3(1, 0, 0), 100.0f),
+    Ray(vec3(-10, 5, 0), vec3(1, 0, 0), 100.0f),
+    Ray(vec3(-10, 0, 0), vec3(1, 0, 0), 5.0f),
+    Ray(vec3(0, 0, 0), vec3(0, 1, 0), 100.0f),
+    Ray(vec3(0, -10, 0), vec3(0, 0, 1), 100.0f),
+  };
+
+  RayPacket packet;
+  packet.Load(rays.data(), rays.size());
+  int mask = IntersectRayPacketAABB(packet, vec3(-1), vec3(1));
+
+  // Rays 1 and 4 miss, ray 2 is too short and ray 3 starts inside the box.
+  // The lanes after ray 4 are unused.
+  EXPECT_EQ(mask, 0b01001);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include "render_queue.hpp"
+
+namespace {
+
+RenderCommand MakeCommand(RenderPass pass, unsigned int program,
+  unsigned int texture, unsigned int mesh, float depth, int object) {
+  RenderCommand command;
+  command.sort_key = MakeRenderSortKey(pass, program, texture, mesh, 0,
+    depth, 100.0f);
+  command.program = program;
+  command.texture = texture;
+  command.mesh = mesh;
+  command.material = 0;
+  command.num_indices = 36;
+  command.object = object;
+  command.asset = 0;
+  return command;
+}
+
+TEST(RenderQueue, SortsByStateAndMergesInstances) {
+  RenderQueue queue;
+  queue.Add(MakeCommand(RENDER_PASS_OPAQUE, 2, 1, 1, 10.0f, 0));
+  queue.Add(MakeCommand(RENDER_PASS_OPAQUE, 1, 5, 3, 50.0f, 1));
+  queue.Add(MakeCommand(RENDER_PASS_OPAQUE, 1, 5, 3, 20.0f, 2));
+  queue.Add(MakeCommand(RENDER_PASS_OPAQUE, 1, 4, 3, 90.0f, 3));
+  queue.Build();
+
+  const vector<RenderCommand>& commands = queue.GetCommands();
+  ASSERT_EQ(queue.GetNumCommands(), 4);
+  EXPECT_EQ(commands[0].object, 3);
+  EXPECT_EQ(commands[1].object, 2);
+  EXPECT_EQ(commands[2].object, 1);
+  EXPECT_EQ(commands[3].object, 0);
+
+  const vector<RenderBatch>& batches = queue.GetBatches();
+  ASSERT_EQ(queue.GetNumBatches(), 3);
+  EXPECT_EQ(batches[0].first, 0);
+  EXPECT_EQ(batches[0].count, 1);
+  EXPECT_EQ(batches[1].first, 1);
+  EXPECT_EQ(batches[1].count, 2);
+  EXPECT_EQ(batches[2].first, 3);
+  EXPECT_EQ(batches[2].count, 1);
+}
+
+TEST(RenderQueue, SplitsBatchesAtMaxInstances) {
+  RenderQueue queue;
+  for (int i = 0; i < 10; i++) {
+    queue.Add(MakeCommand(RENDER_PASS_OPAQUE, 1, 1, 1, float(i), i));
+  }
+  queue.Build(4);
+
+  const vector<RenderBatch>& batches = queue.GetBatches();
+  ASSERT_EQ(queue.GetNumBatches(), 3);
+  EXPECT_EQ(batches[0].count, 4);
+  EXPECT_EQ(batches[1].count, 4);
+  EXPECT_EQ(batches[2].first, 8);
+  EXPECT_EQ(batches[2].count, 2);
+
+  queue.Clear();
+  EXPECT_EQ(queue.GetNumCommands(), 0);
+  EXPECT_EQ(queue.GetNumBatches(), 0);
+}
+
+TEST(RenderQueue, DrawsTransparentBackToFrontAfterOpaque) {
+  RenderQueue queue;
+  queue.Add(MakeCommand(RENDER_PASS_TRANSPARENT, 1, 1, 1, 10.0f, 0));
+  queue.Add(MakeCommand(RENDER_PASS_TRANSPARENT, 1, 1, 1, 80.0f, 1));
+  queue.Add(MakeCommand(RENDER_PASS_OPAQUE, 9, 9, 9, 60.0f, 2));
+  queue.Build();
+
+  const vector<RenderCommand>& commands = queue.GetCommands();
+  EXPECT_EQ(commands[0].object, 2);
+  EXPECT_EQ(commands[1].object, 1);
+  EXPECT_EQ(commands[2].object, 0);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,89 @@
+#include <random>
+#include <vector>
+#include "gtest/gtest.h"
+#include "simplex_noise.hpp"
+
+using namespace std;
+
+namespace {
+
+// Counts that are not a multiple of the number of lanes also go through
+// the scalar tail.
+void ExpectBatchMatchesScalar(const vector<float>& x, const vector<float>& y) {
+  vector<float> out(x.size());
+  SimplexNoise::noise(x.data(), y.data(), x.size(), out.data());
+  for (int i = 0; i < x.size(); i++) {
+    EXPECT_FLOAT_EQ(out[i], SimplexNoise::noise(x[i], y[i]))
+      << "at (" << x[i] << ", " << y[i] << ")";
+  }
+}
+
+// The terrain is generated from the noise, so its values must not change.
+// Near rather than equal, since FMA contraction changes the last bits.
+TEST(SimplexNoise, ScalarValuesArePinned) {
+  EXPECT_NEAR(SimplexNoise::noise(0.0f, 0.0f), 0.0f, 1e-5f);
+  EXPECT_NEAR(SimplexNoise::noise(0.5f, 0.25f), -0.365308404f, 1e-5f);
+  EXPECT_NEAR(SimplexNoise::noise(-3.7f, 12.1f), 0.88614589f, 1e-5f);
+  EXPECT_NEAR(SimplexNoise::noise(1234.5f, -678.25f), -0.395813793f, 1e-5f);
+  EXPECT_NEAR(SimplexNoise::noise(2000.3f, 2001.7f), 0.534467757f, 1e-5f);
+}
+
+TEST(SimplexNoise, BatchMatchesScalar) {
+  mt19937 generator(1);
+  uniform_real_distribution<float> coord(-50.0f, 50.0f);
+  for (int count : { 0, 1, 3, 4, 7, 8, 9, 31, 1000 }) {
+    vector<float> x, y;
+    for (int i = 0; i < count; i++) {
+      x.push_back(coord(generator));
+      y.push_back(coord(generator));
+    }
+    ExpectBatchMatchesScalar(x, y);
+  }
+}
+
+TEST(SimplexNoise, BatchMatchesScalarOnCellBorders) {
+  vector<float> x, y;
+  for (int i = -20; i <= 20; i++) {
+    for (int j = -20; j <= 20; j++) {
+      x.push_back(i * 0.5f);
+      y.push_back(j * 0.25f);
+    }
+  }
+  ExpectBatchMatchesScalar(x, y);
+}
+
+TEST(SimplexNoise, BatchMatchesScalarFarFromTheOrigin) {
+  // The terrain noise is sampled around 1000 and 2000.
+  mt19937 generator(2);
+  uniform_real_distribution<float> coord(-3000.0f, 3000.0f);
+  vector<float> x, y;
+  for (int i = 0; i < 997; i++) {
+    x.push_back(coord(generator));
+    y.push_back(coord(generator));
+  }
+  ExpectBatchMatchesScalar(x, y);
+}
+
+TEST(SimplexNoise, BatchFractalMatchesScalar) {
+  SimplexNoise noise(0.1f, 2.0f, 2.0f, 0.5f);
+  mt19937 generator(3);
+  uniform_real_distribution<float> coord(-200.0f, 200.0f);
+  vector<float> x, y;
+  for (int i = 0; i < 101; i++) {
+    x.push_back(coord(generator));
+    y.push_back(coord(generator));
+  }
+
+  vector<float> out(x.size());
+  noise.fractal(4, x.data(), y.data(), x.size(), out.data());
+  for (int i = 0; i < x.size(); i++) {
+    EXPECT_FLOAT_EQ(out[i], noise.fractal(4, x[i], y[i]));
+  }
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,201 @@
+#include <vector>
+#include "gtest/gtest.h"
+#include "game_object.hpp"
+#include "space_partition.hpp"
+
+using namespace std;
+
+namespace {
+
+vector<shared_ptr<GameObject>> CreateObjects(ObjectList& list, int n) {
+  vector<shared_ptr<GameObject>> objs;
+  for (int i = 0; i < n; i++) {
+    objs.push_back(make_shared<GameObject>(nullptr));
+    objs.back()->id = i;
+    list.insert(objs.back().get());
+  }
+  return objs;
+}
+
+// A two level octree with loose bounds twice as large as the nodes.
+shared_ptr<OctreeNode> CreateOctree() {
+  shared_ptr<OctreeNode> root = make_shared<OctreeNode>(vec3(0),
+    vec3(100));
+  root->loose_half_dimensions = vec3(200);
+  for (int i = 0; i < 8; i++) {
+    vec3 offset = vec3((i & 1) ? 50 : -50, (i & 2) ? 50 : -50,
+      (i & 4) ? 50 : -50);
+    root->children[i] = make_shared<OctreeNode>(offset, vec3(50));
+    root->children[i]->loose_half_dimensions = vec3(100);
+  }
+  return root;
+}
+
+TEST(ObjectList, IteratesAllObjects) {
+  ObjectList list(OCTREE_MOVING_OBJS);
+  vector<shared_ptr<GameObject>> objs = CreateObjects(list, 10);
+  EXPECT_EQ(list.size(), 10);
+
+  vector<int> visited(10, 0);
+  for (ObjPtr obj : list) visited[obj->id]++;
+  for (int i = 0; i < 10; i++) EXPECT_EQ(visited[i], 1);
+
+  list.erase(objs[3].get());
+  EXPECT_FALSE(list.contains(objs[3].get()));
+  EXPECT_EQ(list.size(), 9);
+
+  // Objects are in one list of each type.
+  ObjectList other(OCTREE_MOVING_OBJS);
+  other.insert(objs[4].get());
+  EXPECT_FALSE(list.contains(objs[4].get()));
+  EXPECT_EQ(list.size(), 8);
+}
+
+TEST(ObjectList, CanUnlinkOtherObjectsInTheLoop) {
+  ObjectList list(OCTREE_CREATURES);
+  vector<shared_ptr<GameObject>> objs = CreateObjects(list, 10);
+
+  // The first visited object unlinks all the others, including the next.
+  int num_visited = 0;
+  for (ObjPtr obj : list) {
+    num_visited++;
+    for (auto& other : objs) {
+      if (other != obj) list.erase(other.get());
+    }
+  }
+  EXPECT_EQ(num_visited, 1);
+  EXPECT_EQ(list.size(), 1);
+}
+
+TEST(ObjectList, CanRelocateObjectsInTheLoop) {
+  ObjectList list(OCTREE_MOVING_OBJS);
+  ObjectList other(OCTREE_MOVING_OBJS);
+  vector<shared_ptr<GameObject>> objs = CreateObjects(list, 10);
+  vector<shared_ptr<GameObject>> other_objs = CreateObjects(other, 5);
+
+  // Moving the next object to another list does not continue the loop over
+  // the other list.
+  int num_visited = 0;
+  for (ObjPtr obj : list) {
+    num_visited++;
+    ObjPtr next;
+    for (auto& o : objs) {
+      if (o != obj && list.contains(o.get())) next = o;
+    }
+    if (next) other.insert(next.get());
+    other.insert(obj.get());
+  }
+  EXPECT_EQ(num_visited, 5);
+  EXPECT_TRUE(list.empty());
+  EXPECT_EQ(other.size(), 15);
+}
+
+TEST(ObjectList, CanDropObjectsInTheLoop) {
+  ObjectList list(OCTREE_ITEMS);
+  vector<shared_ptr<GameObject>> objs = CreateObjects(list, 10);
+  vector<weak_ptr<GameObject>> weak_objs(objs.begin(), objs.end());
+
+  int num_visited = 0;
+  for (ObjPtr obj : list) {
+    num_visited++;
+    for (auto& other : objs) {
+      if (other && other != obj) {
+        list.erase(other.get());
+        other.reset();
+      }
+    }
+  }
+  EXPECT_EQ(num_visited, 1);
+
+  objs.clear();
+  for (auto& weak_obj : weak_objs) EXPECT_TRUE(weak_obj.expired());
+  EXPECT_TRUE(list.empty());
+}
+
+TEST(ObjectList, NestedLoops) {
+  ObjectList list(OCTREE_LIGHTS);
+  vector<shared_ptr<GameObject>> objs = CreateObjects(list, 20);
+  int num_pairs = 0;
+  for (ObjPtr obj1 : list) {
+    for (ObjPtr obj2 : list) {
+      if (obj1->id < obj2->id) num_pairs++;
+    }
+  }
+  EXPECT_EQ(num_pairs, 20 * 19 / 2);
+}
+
+TEST(LooseOctree, FindsTheDeepestFittingNode) {
+  shared_ptr<OctreeNode> root = CreateOctree();
+  EXPECT_EQ(FindLooseOctreeNode(root, BoundingSphere(vec3(10, 10, 10), 1),
+    1, false), root->children[7]);
+  EXPECT_EQ(FindLooseOctreeNode(root, BoundingSphere(vec3(-10, 10, 10), 1),
+    1, false), root->children[6]);
+  EXPECT_EQ(FindLooseOctreeNode(root, BoundingSphere(vec3(10, 10, 10), 1),
+    0, false), root);
+
+  // Larger than the children.
+  EXPECT_EQ(FindLooseOctreeNode(root, BoundingSphere(vec3(0), 80), 1,
+    false), root);
+
+  // A quadtree ignores the height.
+  BoundingSphere high = BoundingSphere(vec3(10, 500, 10), 1);
+  EXPECT_FALSE(FitsInLooseOctreeNode(*root, high, false));
+  EXPECT_TRUE(FitsInLooseOctreeNode(*root, high, true));
+  EXPECT_EQ(FindLooseOctreeNode(root, high, 1, true),
+    root->children[kOctreeToQuadTreeIndex[7]]);
+}
+
+TEST(LooseOctree, RelocatesOnlyWhenLeavingTheLooseBounds) {
+  shared_ptr<OctreeNode> root = CreateOctree();
+  shared_ptr<OctreeNode> node = root->children[7];
+
+  // Past the node bounds, but inside the loose bounds.
+  EXPECT_FALSE(NeedsLooseOctreeRelocation(*node,
+    BoundingSphere(vec3(10, 10, 10), 1), false));
+  EXPECT_FALSE(NeedsLooseOctreeRelocation(*node,
+    BoundingSphere(vec3(-20, 10, 10), 1), false));
+  EXPECT_TRUE(NeedsLooseOctreeRelocation(*node,
+    BoundingSphere(vec3(-60, 10, 10), 1), false));
+
+  // An object that shrinks fits in a child of the root.
+  EXPECT_FALSE(NeedsLooseOctreeRelocation(*root,
+    BoundingSphere(vec3(0), 80), false));
+  EXPECT_TRUE(NeedsLooseOctreeRelocation(*root,
+    BoundingSphere(vec3(0), 1), false));
+}
+
+TEST(LooseOctree, RelocatesObjectsWhileIterating) {
+  shared_ptr<OctreeNode> root = CreateOctree();
+  vector<shared_ptr<GameObject>> objs =
+    CreateObjects(root->moving_objs, 16);
+  for (int i = 0; i < 16; i++) {
+    objs[i]->position = vec3((i & 1) ? 30 : -30, (i & 2) ? 30 : -30,
+      (i & 4) ? 30 : -30);
+    objs[i]->octree_node = root;
+  }
+
+  // Like Physics moving objects down the tree in a loop over a node.
+  int num_visited = 0;
+  for (ObjPtr obj : root->moving_objs) {
+    num_visited++;
+    BoundingSphere sphere(obj->position, 1);
+    ASSERT_TRUE(NeedsLooseOctreeRelocation(*obj->octree_node, sphere,
+      false));
+    shared_ptr<OctreeNode> node = FindLooseOctreeNode(root, sphere, 1,
+      false);
+    node->moving_objs.insert(obj.get());
+    obj->octree_node = node;
+  }
+  EXPECT_EQ(num_visited, 16);
+  EXPECT_TRUE(root->moving_objs.empty());
+  for (int i = 0; i < 8; i++) {
+    EXPECT_EQ(root->children[i]->moving_objs.size(), 2);
+  }
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
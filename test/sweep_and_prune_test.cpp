@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include "gtest/gtest.h"
+#include "sweep_and_prune.hpp"
+
+using namespace std;
+
+namespace {
+
+struct Box {
+  int id;
+  int handle;
+  bool fixed;
+  vec3 min, max;
+};
+
+vector<pair<int, int>> BruteForcePairs(const vector<Box>& boxes) {
+  vector<pair<int, int>> pairs;
+  for (size_t i = 0; i < boxes.size(); i++) {
+    for (size_t j = i + 1; j < boxes.size(); j++) {
+      const Box& a = boxes[i];
+      const Box& b = boxes[j];
+      if (a.fixed && b.fixed) continue;
+
+      bool overlaps = true;
+      for (int axis = 0; axis < 3; axis++) {
+        if (a.min[axis] > b.max[axis] || b.min[axis] > a.max[axis]) {
+          overlaps = false;
+        }
+      }
+      if (overlaps) pairs.push_back({ std::min(a.id, b.id),
+        std::max(a.id, b.id) });
+    }
+  }
+  sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+vector<pair<int, int>> GetSortedPairs(SweepAndPrune& broadphase) {
+  vector<pair<int, int>> pairs;
+  broadphase.GetPairs(pairs);
+  for (auto& [id1, id2] : pairs) {
+    if (id1 > id2) swap(id1, id2);
+  }
+  sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+Box RandomBox(mt19937& rng, int id, bool fixed) {
+  uniform_real_distribution<float> position(0.0f, 50.0f);
+  uniform_real_distribution<float> size(0.5f, 4.0f);
+  Box box;
+  box.id = id;
+  box.fixed = fixed;
+  box.min = vec3(position(rng), position(rng), position(rng));
+  box.max = box.min + vec3(size(rng), size(rng), size(rng));
+  return box;
+}
+
+TEST(SweepAndPruneTest, ShouldReportTouchingBoxes) {
+  SweepAndPrune broadphase;
+  broadphase.AddProxy(1, vec3(0, 0, 0), vec3(1, 1, 1));
+  broadphase.AddProxy(2, vec3(1, 0, 0), vec3(2, 1, 1));
+  broadphase.AddProxy(3, vec3(3, 0, 0), vec3(4, 1, 1), true);
+  broadphase.AddProxy(4, vec3(3, 0, 0), vec3(4, 1, 1), true);
+  broadphase.Commit();
+
+  vector<pair<int, int>> expected { { 1, 2 } };
+  EXPECT_EQ(expected, GetSortedPairs(broadphase));
+}
+
+TEST(SweepAndPruneTest, ShouldMatchBruteForceWhileMoving) {
+  mt19937 rng(7);
+  uniform_real_distribution<float> step(-1.0f, 1.0f);
+
+  // The first batch is rebuilt, the rest is inserted incrementally.
+  SweepAndPrune broadphase;
+  vector<Box> boxes;
+  for (int i = 0; i < 200; i++) {
+    boxes.push_back(RandomBox(rng, i, i % 2 == 0));
+    boxes.back().handle = broadphase.AddProxy(i, boxes.back().min,
+      boxes.back().max, boxes.back().fixed);
+  }
+  broadphase.Commit();
+  EXPECT_EQ(BruteForcePairs(boxes), GetSortedPairs(broadphase));
+
+  int next_id = boxes.size();
+  for (int frame = 0; frame < 50; frame++) {
+    for (Box& box : boxes) {
+      if (box.fixed) continue;
+      vec3 offset(step(rng), step(rng), step(rng));
+      box.min = box.min + offset;
+      box.max = box.max + offset;
+      broadphase.UpdateProxy(box.handle, box.min, box.max);
+    }
+
+    int i = uniform_int_distribution<int>(0, boxes.size() - 1)(rng);
+    broadphase.RemoveProxy(boxes[i].handle);
+    boxes.erase(boxes.begin() + i);
+
+    boxes.push_back(RandomBox(rng, next_id++, false));
+    boxes.back().handle = broadphase.AddProxy(boxes.back().id,
+      boxes.back().min, boxes.back().max);
+    broadphase.Commit();
+
+    ASSERT_EQ(BruteForcePairs(boxes), GetSortedPairs(broadphase));
+  }
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,61 @@
+#include <thread>
+#include <unordered_map>
+#include "gtest/gtest.h"
+#include "symbol.hpp"
+
+using namespace std;
+
+namespace {
+
+TEST(Symbol, InternsNamesOnce) {
+  Symbol a("symbol-test-a");
+  Symbol b(string("symbol-test-b"));
+  EXPECT_NE(a, b);
+  EXPECT_EQ(a, Symbol("symbol-test-a"));
+  EXPECT_EQ(a.GetName(), "symbol-test-a");
+  EXPECT_EQ(GetSymbolName(b.GetId()), "symbol-test-b");
+
+  EXPECT_TRUE(Symbol().empty());
+  EXPECT_EQ(Symbol(""), Symbol());
+  EXPECT_EQ(GetSymbolName(GetNumSymbols()), "");
+}
+
+TEST(Symbol, FindDoesNotIntern) {
+  int num_symbols = GetNumSymbols();
+  EXPECT_TRUE(Symbol::Find("symbol-test-missing").empty());
+  EXPECT_EQ(GetNumSymbols(), num_symbols);
+
+  Symbol c("symbol-test-c");
+  EXPECT_EQ(Symbol::Find("symbol-test-c"), c);
+}
+
+TEST(Symbol, ThreadsGetTheSameIds) {
+  const int kNumNames = 1000;
+  vector<vector<Symbol>> symbols(4, vector<Symbol>(kNumNames));
+  vector<thread> threads;
+  for (int t = 0; t < symbols.size(); t++) {
+    threads.push_back(thread([&symbols, t]() {
+      for (int i = 0; i < kNumNames; i++) {
+        symbols[t][i] = Symbol("symbol-test-" + to_string(i));
+      }
+    }));
+  }
+  for (thread& t : threads) t.join();
+
+  unordered_map<Symbol, int> indices;
+  for (int i = 0; i < kNumNames; i++) {
+    for (int t = 1; t < symbols.size(); t++) {
+      ASSERT_EQ(symbols[t][i], symbols[0][i]);
+    }
+    EXPECT_EQ(symbols[0][i].GetName(), "symbol-test-" + to_string(i));
+    indices[symbols[0][i]] = i;
+  }
+  EXPECT_EQ(indices.size(), kNumNames);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,251 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "texture_cache.hpp"
+
+using namespace std;
+
+namespace {
+
+// Smooth gradient, like most of the textures in the game.
+TextureImage CreateGradient(int width, int height, bool transparent) {
+  TextureImage image;
+  image.width = width;
+  image.height = height;
+  image.pixels.resize(width * height * 4);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      unsigned char* pixel = &image.pixels[(y * width + x) * 4];
+      pixel[0] = x * 255 / std::max(1, width - 1);
+      pixel[1] = y * 255 / std::max(1, height - 1);
+      pixel[2] = 128;
+      pixel[3] = transparent ? (x + y) * 255 / (width + height - 2) : 255;
+    }
+  }
+  return image;
+}
+
+int GetMaxError(const TextureImage& a, const TextureImage& b, int channel) {
+  int max_error = 0;
+  for (size_t i = channel; i < a.pixels.size(); i += 4) {
+    max_error = std::max(max_error, abs(a.pixels[i] - b.pixels[i]));
+  }
+  return max_error;
+}
+
+// Uncompressed 32 bit TGA.
+void WriteTga(const string& filename, const TextureImage& image) {
+  unsigned char header[18] = { 0 };
+  header[2] = 2;
+  header[12] = image.width & 0xff;
+  header[13] = image.width >> 8;
+  header[14] = image.height & 0xff;
+  header[15] = image.height >> 8;
+  header[16] = 32;
+  header[17] = 8;
+
+  ofstream os(filename, ios::binary);
+  os.write((const char*) header, sizeof(header));
+  for (size_t i = 0; i < image.pixels.size(); i += 4) {
+    const unsigned char bgra[4] = { image.pixels[i + 2], image.pixels[i + 1],
+      image.pixels[i], image.pixels[i + 3] };
+    os.write((const char*) bgra, 4);
+  }
+}
+
+TEST(TextureCompression, LevelSizes) {
+  EXPECT_EQ(GetLevelSize(TEXTURE_BC1, 256, 256), 64 * 64 * 8);
+  EXPECT_EQ(GetLevelSize(TEXTURE_BC3, 256, 256), 64 * 64 * 16);
+  EXPECT_EQ(GetLevelSize(TEXTURE_BC5, 2, 1), 16);
+  EXPECT_EQ(GetLevelSize(TEXTURE_RGBA8, 3, 5), 3 * 5 * 4);
+
+  TextureImage image = CreateGradient(16, 4, false);
+  CompressedTexture texture;
+  CompressTexture(image, TEXTURE_BC1, texture);
+  ASSERT_EQ(texture.levels.size(), 5);
+  EXPECT_EQ(texture.levels[1].width, 8);
+  EXPECT_EQ(texture.levels[1].height, 2);
+  EXPECT_EQ(texture.levels[4].width, 1);
+  EXPECT_EQ(texture.levels[4].height, 1);
+  for (const TextureLevel& level : texture.levels) {
+    EXPECT_EQ(level.data.size(),
+      GetLevelSize(TEXTURE_BC1, level.width, level.height));
+  }
+}
+
+TEST(TextureCompression, SolidBlocksAreExact) {
+  unsigned char rgba[64];
+  for (int i = 0; i < 16; i++) {
+    rgba[i * 4 + 0] = 255;
+    rgba[i * 4 + 1] = 0;
+    rgba[i * 4 + 2] = 255;
+    rgba[i * 4 + 3] = 255;
+  }
+
+  unsigned char block[16];
+  unsigned char decoded[64];
+  EncodeBC1Block(rgba, block);
+  DecodeBC1Block(block, decoded);
+  for (int i = 0; i < 64; i++) EXPECT_EQ(decoded[i], rgba[i]);
+
+  EncodeBC3Block(rgba, block);
+  DecodeBC3Block(block, decoded);
+  for (int i = 0; i < 64; i++) EXPECT_EQ(decoded[i], rgba[i]);
+}
+
+TEST(TextureCompression, GradientsStayClose) {
+  TextureImage image = CreateGradient(64, 64, true);
+  TextureImage decoded;
+
+  CompressedTexture texture;
+  CompressTexture(image, TEXTURE_BC1, texture);
+  DecompressLevel(texture, 0, decoded);
+  for (int j = 0; j < 3; j++) EXPECT_LE(GetMaxError(image, decoded, j), 12);
+
+  CompressTexture(image, TEXTURE_BC3, texture);
+  DecompressLevel(texture, 0, decoded);
+  for (int j = 0; j < 4; j++) EXPECT_LE(GetMaxError(image, decoded, j), 12);
+
+  // BC5 keeps red and green at a higher precision.
+  CompressTexture(image, TEXTURE_BC5, texture);
+  DecompressLevel(texture, 0, decoded);
+  for (int j = 0; j < 2; j++) EXPECT_LE(GetMaxError(image, decoded, j), 4);
+  EXPECT_EQ(decoded.pixels[2], 0);
+  EXPECT_EQ(decoded.pixels[3], 255);
+}
+
+TEST(TextureCompression, ChoosesFormatByContent) {
+  EXPECT_EQ(ChooseTextureFormat(CreateGradient(4, 4, false),
+    TEXTURE_USAGE_COLOR), TEXTURE_BC1);
+  EXPECT_EQ(ChooseTextureFormat(CreateGradient(4, 4, true),
+    TEXTURE_USAGE_COLOR), TEXTURE_BC3);
+  EXPECT_EQ(ChooseTextureFormat(CreateGradient(4, 4, true),
+    TEXTURE_USAGE_NORMAL_MAP), TEXTURE_BC5);
+}
+
+TEST(TextureCache, SaveAndLoad) {
+  CompressedTexture texture;
+  CookTexture(CreateGradient(32, 8, true), TEXTURE_USAGE_NORMAL_MAP, texture);
+  stringstream ss;
+  SaveTextureData(ss, texture, 1234);
+  string bytes = ss.str();
+
+  CompressedTexture loaded;
+  EXPECT_EQ(LoadTextureData(bytes.data(), bytes.size(), loaded), 1234);
+  EXPECT_EQ(loaded.format, TEXTURE_BC5);
+  EXPECT_EQ(loaded.usage, TEXTURE_USAGE_NORMAL_MAP);
+  ASSERT_EQ(loaded.levels.size(), texture.levels.size());
+  for (size_t i = 0; i < loaded.levels.size(); i++) {
+    EXPECT_EQ(loaded.levels[i].width, texture.levels[i].width);
+    EXPECT_EQ(loaded.levels[i].height, texture.levels[i].height);
+    EXPECT_EQ(loaded.levels[i].data, texture.levels[i].data);
+  }
+}
+
+TEST(TextureCache, RejectsInvalidData) {
+  CompressedTexture texture;
+  CompressTexture(CreateGradient(8, 8, false), TEXTURE_BC1, texture);
+  stringstream ss;
+  SaveTextureData(ss, texture, 0);
+  string bytes = ss.str();
+
+  CompressedTexture loaded;
+  EXPECT_THROW(LoadTextureData(bytes.data(), 10, loaded), runtime_error);
+  EXPECT_THROW(LoadTextureData(bytes.data(), bytes.size() - 4, loaded),
+    runtime_error);
+  bytes[4] = 99; // Version.
+  EXPECT_THROW(LoadTextureData(bytes.data(), bytes.size(), loaded),
+    runtime_error);
+}
+
+TEST(TextureCache, CacheIsUsedOnlyWhileUpToDate) {
+  const string png_filename = "texture_cache_test.png";
+  ofstream(png_filename) << "png";
+  EXPECT_EQ(GetTextureCachePath(png_filename), "texture_cache_test.btex");
+
+  CompressedTexture texture;
+  CompressTexture(CreateGradient(4, 4, false), TEXTURE_BC1, texture);
+  CompressedTexture loaded;
+  EXPECT_FALSE(LoadTextureCache(png_filename, loaded));
+  SaveTextureCache(png_filename, texture);
+  EXPECT_TRUE(LoadTextureCache(png_filename, loaded));
+  EXPECT_EQ(loaded.levels[0].data, texture.levels[0].data);
+
+  // Same size, different bytes.
+  ofstream(png_filename) << "pnh";
+  EXPECT_FALSE(LoadTextureCache(png_filename, loaded));
+
+  // Without the image the cache is all there is.
+  remove(png_filename.c_str());
+  EXPECT_TRUE(LoadTextureCache(png_filename, loaded));
+  remove(GetTextureCachePath(png_filename).c_str());
+}
+
+TEST(TextureCache, CorruptCacheIsNotUsed) {
+  const string png_filename = "texture_cache_corrupt_test.png";
+  const string cache_filename = GetTextureCachePath(png_filename);
+  ofstream(png_filename) << "png";
+
+  CompressedTexture texture;
+  CompressTexture(CreateGradient(16, 16, false), TEXTURE_BC1, texture);
+  SaveTextureCache(png_filename, texture);
+  ifstream tmp_file(cache_filename + ".tmp");
+  EXPECT_FALSE(tmp_file.good());
+
+  // Truncated in the middle of the levels, like a save that crashed.
+  ifstream is(cache_filename, ios::binary);
+  string bytes((istreambuf_iterator<char>(is)), istreambuf_iterator<char>());
+  is.close();
+  ofstream(cache_filename, ios::binary).write(bytes.data(), 
+    bytes.size() - 8);
+
+  CompressedTexture loaded;
+  EXPECT_FALSE(LoadTextureCache(png_filename, loaded));
+  EXPECT_TRUE(loaded.levels.empty());
+
+  // Saving again replaces it.
+  SaveTextureCache(png_filename, texture);
+  EXPECT_TRUE(LoadTextureCache(png_filename, loaded));
+  EXPECT_EQ(loaded.levels[0].data, texture.levels[0].data);
+  remove(png_filename.c_str());
+  remove(cache_filename.c_str());
+}
+
+TEST(TextureCache, StaleCacheIsCookedAgain) {
+  const string tga_filename = "texture_cache_stale_test.tga";
+  TextureImage image = CreateGradient(4, 4, false);
+  WriteTga(tga_filename, image);
+
+  // Cooked as a normal map from an older version of the image.
+  CompressedTexture texture;
+  CookTexture(image, TEXTURE_USAGE_NORMAL_MAP, texture);
+  SaveTextureCache(tga_filename, texture);
+  WriteTga(tga_filename, CreateGradient(8, 8, false));
+
+  CompressedTexture loaded;
+  EXPECT_FALSE(LoadTextureCache(tga_filename, loaded));
+  ASSERT_TRUE(LoadOrCookTextureCache(tga_filename, loaded));
+  EXPECT_EQ(loaded.usage, TEXTURE_USAGE_NORMAL_MAP);
+  EXPECT_EQ(loaded.format, TEXTURE_BC5);
+  ASSERT_FALSE(loaded.levels.empty());
+  EXPECT_EQ(loaded.levels[0].width, 8);
+
+  // The new cache is saved.
+  CompressedTexture saved;
+  EXPECT_TRUE(LoadTextureCache(tga_filename, saved));
+  EXPECT_EQ(saved.levels[0].data, loaded.levels[0].data);
+  remove(tga_filename.c_str());
+  remove(GetTextureCachePath(tga_filename).c_str());
+
+  // Without a cache the image is decoded as it is.
+  EXPECT_FALSE(LoadOrCookTextureCache(tga_filename, loaded));
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,184 @@
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+#include "gtest/gtest.h"
+#include "uniform_cache.hpp"
+
+using namespace std;
+
+namespace {
+
+// Fake GL with one program per entry, each with a list of active uniforms.
+struct FakeGl {
+  unordered_map<GLuint, vector<string>> uniforms;
+  unordered_map<GLuint, vector<string>> blocks;
+  int num_location_calls = 0;
+  vector<tuple<GLuint, GLuint, GLuint>> block_bindings;
+  vector<char> buffer;
+  int num_buffer_updates = 0;
+
+  UniformGlFunctions GetFunctions() {
+    UniformGlFunctions gl;
+    gl.get_program_iv = [this](GLuint program, GLenum name, GLint* params) {
+      if (name == GL_ACTIVE_UNIFORMS) {
+        *params = uniforms[program].size();
+      } else if (name == GL_ACTIVE_UNIFORM_MAX_LENGTH) {
+        *params = 64;
+      }
+    };
+    gl.get_active_uniform = [this](GLuint program, GLuint index,
+      GLsizei buf_size, GLsizei* length, GLint* size, GLenum* type,
+      GLchar* name) {
+      const string& s = uniforms[program][index];
+      *length = snprintf(name, buf_size, "%s", s.c_str());
+      *size = 1;
+      *type = GL_FLOAT;
+    };
+    gl.get_uniform_location = [this](GLuint program, const GLchar* name) {
+      num_location_calls++;
+      const vector<string>& names = uniforms[program];
+      for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) return GLint(i * 10);
+        if (names[i] == string(name) + "[0]") return GLint(i * 10);
+
+        // Elements after the first in an array.
+        string prefix = names[i].substr(0, names[i].size() - 2);
+        if (names[i].size() > 3 && string(name).find(prefix) == 0) {
+          return GLint(i * 10 + name[prefix.size()] - '0');
+        }
+      }
+      return GLint(-1);
+    };
+    gl.get_uniform_block_index = [this](GLuint program, const GLchar* name) {
+      const vector<string>& names = blocks[program];
+      for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) return GLuint(i);
+      }
+      return GLuint(GL_INVALID_INDEX);
+    };
+    gl.uniform_block_binding = [this](GLuint program, GLuint index,
+      GLuint binding) {
+      block_bindings.push_back({ program, index, binding });
+    };
+    gl.gen_buffers = [](GLsizei n, GLuint* buffers) {
+      for (int i = 0; i < n; i++) buffers[i] = 7 + i;
+    };
+    gl.bind_buffer = [](GLenum, GLuint) {};
+    gl.buffer_data = [this](GLenum, GLsizeiptr size, const void*, GLenum) {
+      buffer.resize(size);
+    };
+    gl.buffer_sub_data = [this](GLenum, GLintptr offset, GLsizeiptr size,
+      const void* data) {
+      num_buffer_updates++;
+      memcpy(&buffer[offset], data, size);
+    };
+    gl.bind_buffer_base = [](GLenum, GLuint, GLuint) {};
+    return gl;
+  }
+};
+
+TEST(UniformCache, ReflectsProgramsOnce) {
+  FakeGl fake_gl;
+  fake_gl.uniforms[1] = { "MVP", "texture_sampler", "joint_transforms[0]" };
+  fake_gl.uniforms[2] = { "V" };
+
+  UniformCache cache(fake_gl.GetFunctions());
+  cache.AddProgram(1);
+  cache.AddProgram(2);
+  int num_location_calls = fake_gl.num_location_calls;
+
+  for (int i = 0; i < 10; i++) {
+    EXPECT_EQ(cache.GetLocation(1, "MVP"), 0);
+    EXPECT_EQ(cache.GetLocation(1, "texture_sampler"), 10);
+    EXPECT_EQ(cache.GetLocation(1, "joint_transforms"), 20);
+    EXPECT_EQ(cache.GetLocation(1, "joint_transforms[0]"), 20);
+    EXPECT_EQ(cache.GetLocation(2, "V"), 0);
+  }
+  EXPECT_EQ(fake_gl.num_location_calls, num_location_calls);
+
+  // Other array elements are asked once.
+  EXPECT_EQ(cache.GetLocation(1, "joint_transforms[3]"), 23);
+  EXPECT_EQ(cache.GetLocation(1, "joint_transforms[3]"), 23);
+  EXPECT_EQ(fake_gl.num_location_calls, num_location_calls + 1);
+  EXPECT_EQ(cache.GetPrograms().size(), 2);
+}
+
+TEST(UniformCache, ReportsMissingUniforms) {
+  FakeGl fake_gl;
+  fake_gl.uniforms[1] = { "MVP" };
+
+  UniformCache cache(fake_gl.GetFunctions());
+  cache.AddProgram(1);
+  EXPECT_EQ(cache.GetLocation(1, "shadow_matrix0"), -1);
+  EXPECT_EQ(cache.GetLocation(1, "shadow_matrix0"), -1);
+
+  // Programs that were never added are reflected on first use.
+  fake_gl.uniforms[3] = { "M" };
+  EXPECT_EQ(cache.GetLocation(3, "M"), 0);
+  EXPECT_EQ(cache.GetLocation(3, "u_time"), -1);
+
+  const vector<MissingUniform>& missing = cache.GetMissingUniforms();
+  ASSERT_EQ(missing.size(), 2);
+  EXPECT_EQ(missing[0].program_id, 1);
+  EXPECT_EQ(missing[0].name, "shadow_matrix0");
+  EXPECT_EQ(missing[1].program_id, 3);
+  EXPECT_EQ(missing[1].name, "u_time");
+}
+
+TEST(UniformBuffer, BindsProgramsWithTheBlock) {
+  FakeGl fake_gl;
+  fake_gl.blocks[1] = { "Other", kFrameUniformsBlock };
+  fake_gl.blocks[3] = { kFrameUniformsBlock };
+
+  UniformBuffer buffer(fake_gl.GetFunctions(), kFrameUniformsBinding, 
+    sizeof(FrameUniforms));
+  EXPECT_EQ(buffer.BindToPrograms({ 1, 2, 3 }, kFrameUniformsBlock), 2);
+  EXPECT_TRUE(buffer.IsBound(1));
+  EXPECT_FALSE(buffer.IsBound(2));
+  EXPECT_TRUE(buffer.IsBound(3));
+  ASSERT_EQ(fake_gl.block_bindings.size(), 2);
+  EXPECT_EQ(fake_gl.block_bindings[0], make_tuple(1, 1, 
+    kFrameUniformsBinding));
+  EXPECT_EQ(fake_gl.block_bindings[1], make_tuple(3, 0, 
+    kFrameUniformsBinding));
+
+  // std140 offsets of the block members.
+  FrameUniforms uniforms;
+  uniforms.camera_pos = vec4(1, 2, 3, 1);
+  uniforms.frame_params = vec4(5, 1, 0, 0);
+  buffer.Update(&uniforms);
+  ASSERT_EQ(fake_gl.buffer.size(), 464);
+  const float* data = (const float*) fake_gl.buffer.data();
+  EXPECT_EQ(data[384 / 4 + 1], 2.0f);
+  EXPECT_EQ(data[448 / 4], 5.0f);
+  EXPECT_EQ(fake_gl.num_buffer_updates, 1);
+}
+
+TEST(UniformBuffer, SkipsUpdatesWithoutPrograms) {
+  FakeGl fake_gl;
+  fake_gl.blocks[1] = { "Other" };
+
+  UniformBuffer buffer(fake_gl.GetFunctions(), kFrameUniformsBinding, 
+    sizeof(FrameUniforms));
+  EXPECT_EQ(buffer.BindToPrograms({ 1, 2 }, kFrameUniformsBlock), 0);
+  EXPECT_FALSE(buffer.IsUsed());
+
+  FrameUniforms uniforms;
+  buffer.Update(&uniforms);
+  EXPECT_EQ(fake_gl.num_buffer_updates, 0);
+
+  // Shaders reloaded with the block.
+  fake_gl.blocks[2] = { kFrameUniformsBlock };
+  EXPECT_EQ(buffer.BindToPrograms({ 1, 2 }, kFrameUniformsBlock), 1);
+  EXPECT_TRUE(buffer.IsUsed());
+  buffer.Update(&uniforms);
+  EXPECT_EQ(fake_gl.num_buffer_updates, 1);
+}
+
+} // End of namespace
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
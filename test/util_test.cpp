@@ -147,6 +147,52 @@ TEST(RotateMatrix, ShouldSucceeed) {
   EXPECT_THAT(result[3], ElementsAre(22, 1, 13));
 }
 
+TEST(RandomStream, StreamsDoNotInterleave) {
+  SeedRandom(42);
+  vector<int> simulation_draws;
+  for (int i = 0; i < 10; i++) simulation_draws.push_back(Random(0, 1000));
+
+  // Draws from the AI stream between the simulation draws do not change
+  // the simulation sequence.
+  SeedRandom(42);
+  vector<int> ai_draws;
+  for (int i = 0; i < 10; i++) {
+    {
+      ScopedRandomStream random_stream(RANDOM_AI);
+      ai_draws.push_back(Random(0, 1000));
+    }
+    EXPECT_EQ(Random(0, 1000), simulation_draws[i]);
+  }
+  EXPECT_NE(ai_draws, simulation_draws);
+
+  SeedRandom(42);
+  ScopedRandomStream random_stream(RANDOM_AI);
+  for (int i = 0; i < 10; i++) EXPECT_EQ(Random(0, 1000), ai_draws[i]);
+}
+
+TEST(RandomStream, JobEnginesDoNotDependOnJobOrder) {
+  SeedRandom(42);
+  unsigned int seed = NextRandomSeed(RANDOM_COLLISION);
+  vector<int> job_draws[4];
+  for (int job = 0; job < 4; job++) {
+    ScopedRandomEngine random_engine(seed, job);
+    for (int i = 0; i < 10; i++) job_draws[job].push_back(Random(0, 1000));
+  }
+  EXPECT_NE(job_draws[0], job_draws[1]);
+
+  // Running the jobs in reverse and drawing from the simulation stream in
+  // between gives the same draws.
+  SeedRandom(42);
+  EXPECT_EQ(NextRandomSeed(RANDOM_COLLISION), seed);
+  for (int job = 3; job >= 0; job--) {
+    Random(0, 1000);
+    ScopedRandomEngine random_engine(seed, job);
+    for (int i = 0; i < 10; i++) {
+      EXPECT_EQ(Random(0, 1000), job_draws[job][i]);
+    }
+  }
+}
+
 } // End of namespace
 
 int main(int argc, char **argv) {